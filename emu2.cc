@@ -9,6 +9,19 @@
 #include <condition_variable>
 #include <limits>
 #include <unordered_map>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <array>
+#include <vector>
+#include <algorithm>
+#if defined(__unix__)
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <errno.h>
+#endif
 
 /* Preprocessor Utilities                                                  {{{1
  * ============================================================================
@@ -118,6 +131,95 @@ _MEMU_BEGIN_NS(memu)
 #  define EMU_TRACE 0
 #endif
 
+// If set, the caches of exception state (ExecPriCache, PendingSet,
+// ExcPriTable, IntrCheck and the active exception count) are checked against
+// a full rescan each time they are used. This is slow, so it is off by
+// default, including in builds without NDEBUG.
+#ifndef EMU_VERIFY_CACHES
+#  define EMU_VERIFY_CACHES 0
+#endif
+
+// Number of entries in the decoded instruction cache. Must be a power of two,
+// or zero to disable the cache. The cache bypasses the decoders and therefore
+// their TRACEI output, so it is disabled by default when tracing.
+#ifndef DECODE_CACHE_SIZE
+#  if EMU_TRACE
+#    define DECODE_CACHE_SIZE 0
+#  else
+#    define DECODE_CACHE_SIZE 4096
+#  endif
+#endif
+
+#if DECODE_CACHE_SIZE & (DECODE_CACHE_SIZE-1)
+#  error DECODE_CACHE_SIZE must be a power of two
+#endif
+
+// Size of the pages in which cached code is tracked for invalidation (see
+// CodeWatch), as a power of two.
+#ifndef CODE_PAGE_SHIFT
+#  define CODE_PAGE_SHIFT 10
+#endif
+
+// Size of the pages by which PageRouterDevice maps devices, as a power of two
+// no greater than 20.
+#ifndef ROUTER_PAGE_SHIFT
+#  define ROUTER_PAGE_SHIFT 12
+#endif
+
+#if ROUTER_PAGE_SHIFT > 20
+#  error ROUTER_PAGE_SHIFT must not exceed 20
+#endif
+
+// Size of the pages in which writes to host memory are tracked (see DirtyMap),
+// as a power of two.
+#ifndef DIRTY_PAGE_SHIFT
+#  define DIRTY_PAGE_SHIFT 12
+#endif
+
+// Number of entries in the instruction fetch attribute cache. Must be a power
+// of two, or zero to disable the cache.
+#ifndef FETCH_CACHE_SIZE
+#  define FETCH_CACHE_SIZE 64
+#endif
+
+#if FETCH_CACHE_SIZE & (FETCH_CACHE_SIZE-1)
+#  error FETCH_CACHE_SIZE must be a power of two
+#endif
+
+// Number of entries in the address translation cache used for data accesses.
+// Must be a power of two, or zero to disable the cache.
+#ifndef TLB_SIZE
+#  define TLB_SIZE 64
+#endif
+
+#if TLB_SIZE & (TLB_SIZE-1)
+#  error TLB_SIZE must be a power of two
+#endif
+
+// Block engine (ExecEngine_Block) parameters. BLOCK_CACHE_SIZE is the number of
+// blocks which can be looked up by address and must be a power of two.
+// BLOCK_ARENA_SIZE is the total number of instructions held by all blocks and
+// BLOCK_MAX_INSTRS the number held by any one block. BLOCK_CHAIN_MAX limits
+// the number of blocks run by a single call to TopLevel.
+#define BLOCK_CACHE_SIZE    1024
+#define BLOCK_ARENA_SIZE    16384
+#define BLOCK_MAX_INSTRS    32
+#define BLOCK_CHAIN_MAX     64
+
+// JIT engine (ExecEngine_JIT) parameters. A block is translated to native
+// code once it has run JIT_THRESHOLD times. JIT_CODE_SIZE is the size of the
+// buffer holding the translated code, in bytes. The JIT is only available on
+// x86-64 Linux; elsewhere ExecEngine_JIT behaves as ExecEngine_Block.
+#ifndef JIT_SUPPORTED
+#  if defined(__x86_64__) && defined(__linux__)
+#    define JIT_SUPPORTED 1
+#  else
+#    define JIT_SUPPORTED 0
+#  endif
+#endif
+#define JIT_THRESHOLD       16
+#define JIT_CODE_SIZE       (4*1024*1024)
+
 
 /* Simulator Debugging and Tracing Utilities {{{2
  * =========================================
@@ -142,6 +244,11 @@ struct EmuTraceBlock {
 
 #define ASSERT(Cond)    do { if unlikely (!(Cond)) { printf("assertion fail on line %u: %s\n", __LINE__, #Cond); abort(); } } while(0)
 #define UNREACHABLE()   do { printf("assertion fail on line %u: unreachable\n", __LINE__); abort(); } while(0)
+#if EMU_VERIFY_CACHES
+#  define VERIFY_CACHE(Cond) ASSERT(Cond)
+#else
+#  define VERIFY_CACHE(Cond) do {} while(0)
+#endif
 
 #if ENFORCE_SOFT_BITS
 #  define CHECK01(BitsOff, BitsOn)                                          \
@@ -207,11 +314,16 @@ using phys_t = uint32_t;
 
 #define THROW_UNPREDICTABLE() do { TRACE("W: unpredictable on %u\n", __LINE__); throw Exception(ExceptionType::UNPREDICTABLE); } while (0)
 #define THROW_UNDEFINED()     do { TRACE("W: undefined on %u\n", __LINE__); throw Exception(ExceptionType::UNDEFINED); } while (0)
-#define UNDEFINED_DEC() do { printf("W:         UNDEFINED %u\n", __LINE__); THROW_UNDEFINED(); } while (0)
-#define TODO_DEC()      do { printf("W: %08x  TODO insn on line %u\n", pc, __LINE__); UNDEFINED_DEC(); } while (0)
+// The decoders are silent while probed by CheckDecodeTable.
+#define UNDEFINED_DEC() do { if (!_dc.probe) printf("W:         UNDEFINED %u\n", __LINE__); THROW_UNDEFINED(); } while (0)
+#define TODO_DEC()      do { if (!_dc.probe) printf("W: %08x  TODO insn on line %u\n", pc, __LINE__); UNDEFINED_DEC(); } while (0)
   // For CONSTRAINED UNPREDICTABLE which we choose to implement as UNDEFINED
 #define CUNPREDICTABLE_UNDEFINED() UNDEFINED_DEC()
 #define CUNPREDICTABLE_UNALIGNED() do { _ThrowUnaligned(); } while (0)
+// Used after calling a function which may terminate the current instruction
+// via _RaiseFault rather than by throwing. The instruction must then have no
+// further effect.
+#define RETURN_IF_TERMINATED() do { if unlikely (_s.instrTerminated) return; } while (0)
 // QUIET_UNPREDICTABLE is used for circumstances where UNPREDICTABLE occurs but
 // it is not feasible or desirable to raise an exception. Currently it is a
 // no-op besides trace output. In the future we might count the number of
@@ -751,6 +863,7 @@ struct MemoryAttributes {
   DeviceType  device;
   uint8_t     innerAttrs, outerAttrs, innerHints, outerHints;
   bool        ns, innerTransient, outerTransient, shareable, outerShareable;
+  uint32_t    lsFlags;  // LS_FLAG__* implied by the above other than ns; see _MemAttrFlags.
 };
 
 enum AccType {
@@ -838,6 +951,25 @@ struct CpuState {
   bool pcChanged;                 // (*) Used to override next instruction address, e.g. when branching.
   uint8_t nextInstrITState;       // (*) Used only if itStateChanged is set. New ITSTATE.
   uint32_t nextInstrAddr;         // (*) Used only if pcChanged is set. Branch target address.
+  bool instrTerminated;           // (*) The current instruction was terminated by a fault without throwing; see _RaiseFault.
+
+  // Implementation-specific state. Decoded form of the ITSTATE held in the
+  // IT/ICI bits of xpsr, which the simulator keeps in step with them. These
+  // are re-derived from xpsr by InvalidateCaches, which Visit calls after
+  // visiting the state, so they need not be serialized.
+  uint8_t itstate;                // ITSTATE.
+  uint8_t itCond;                 // Default condition for the current instruction (0b1110 outside an IT block).
+
+  // Implementation-specific state. Flag-setting data-processing instructions
+  // record their result, carry and overflow here rather than updating the
+  // NZCV bits of xpsr; lazyFlags holds the XPSR__N/Z/C/V bits which are stale
+  // in xpsr. The flags are folded back into xpsr when next read and at the end
+  // of each TopLevel call, so lazyFlags is always zero between calls and none
+  // of these need be serialized.
+  uint32_t lazyFlags;             // (*)
+  uint32_t lazyResult;            // (*)
+  bool     lazyCarry;             // (*)
+  bool     lazyOverflow;          // (*)
 
   // Information about the current instruction.
   uint32_t thisInstr;             // (*) instruction encoding
@@ -1036,6 +1168,30 @@ static inline uint32_t MaskBySize(uint32_t v, int size) {
   return v & BITS(0, 8*size-1);
 }
 
+enum :uint32_t {
+  HOST_REGION__READ   = BIT(0), // Loads (other than instruction fetches).
+  HOST_REGION__WRITE  = BIT(1), // Stores.
+  HOST_REGION__EXEC   = BIT(2), // Instruction fetches.
+};
+
+struct DirtyMap;
+struct CodeWatch;
+struct CodeWatchList;
+
+// A range of physical memory backed by host memory, which holds the bytes of
+// the range in order. See IDevice::GetHostRegions. If dirty is set, the
+// simulator records its stores to the range there. If watches is set, the
+// simulator reports its stores to the range to the CodeWatches of the other
+// simulators listed there.
+struct HostRegion {
+  phys_t          base;
+  uint32_t        len;
+  uint8_t        *ptr;
+  uint32_t        perms;              // HOST_REGION__*
+  DirtyMap       *dirty   = nullptr;
+  CodeWatchList  *watches = nullptr;
+};
+
 struct IDevice {
   // Load/store. addr is a physical address. size must be in {1,2,4} and
   // specifies the size of the load/store in bytes. flags are LS_FLAG__*.
@@ -1047,7701 +1203,11409 @@ struct IDevice {
   virtual int Load(phys_t addr, int size, uint32_t flags, uint32_t &v) = 0;
   virtual int Store(phys_t addr, int size, uint32_t flags, uint32_t v) = 0;
 
+  // Burst load/store of count consecutive words from addr, which is word
+  // aligned, using the same flags for each word. These are used for LDM/STM,
+  // exception stacking and the like once the addresses have been validated.
+  // Words are transferred in ascending order; returns the number transferred
+  // before the first error/BusFault, i.e. count on success. The defaults call
+  // Load/Store for each word.
+  virtual int LoadBurst(phys_t addr, int count, uint32_t flags, uint32_t *v) {
+    for (int i=0; i<count; ++i)
+      if (Load(addr + 4*i, 4, flags, v[i]))
+        return i;
+
+    return count;
+  }
+
+  virtual int StoreBurst(phys_t addr, int count, uint32_t flags, const uint32_t *v) {
+    for (int i=0; i<count; ++i)
+      if (Store(addr + 4*i, 4, flags, v[i]))
+        return i;
+
+    return count;
+  }
+
   virtual std::tuple<bool, bool, bool, uint8_t, bool> IDAUCheck(uint32_t addr) {
     return {false, true, true, 0, false};
   }
 
   // DEBUG_PIN__*
   virtual uint32_t DebugPins() const { return 0; }
+
+  // Each Simulator using this device attaches its CodeWatch on construction
+  // and detaches it on destruction. A device which modifies memory other than
+  // in response to Store (e.g. by DMA) should report each modification to
+  // every attached CodeWatch via NotifyWrite.
+  virtual void AttachCodeWatch(CodeWatch *cw) {}
+  virtual void DetachCodeWatch(CodeWatch *cw) {}
+
+  // Called by a Simulator after Store or StoreBurst has written the given
+  // bytes. A device which keeps the attached CodeWatches should report the
+  // write to each of them other than writer, which is the storing
+  // simulator's own, so that other simulators sharing the memory discard any
+  // code they have cached from it.
+  virtual void NotifyStore(phys_t addr, uint32_t len, const CodeWatch *writer) {}
+
+  // A RAM-like device may append to regions any ranges for which Load and
+  // Store, for the kinds of access given by HOST_REGION__*, do nothing but
+  // read and write host memory, regardless of flags. The simulator performs
+  // such accesses directly, once they have passed the SAU/MPU checks, rather
+  // than calling Load or Store. Each Simulator calls this on construction and
+  // from InvalidateCaches, which must be called if the regions change; the
+  // host memory must remain valid until then.
+  virtual void GetHostRegions(std::vector<HostRegion> &regions) {}
 };
 
-/* SimpleSimulatorConfig {{{2
- * --------------------
- * SimpleSimulatorConfig implements the SimulatorConfig concept. Any object can
- * be used so long as it can be copied and it supports the methods shown below.
- *
- * A static implementation with constexpr methods could be used to enable
- * compile-time removal of branches unrelated to the chosen profile.
+/* CodeWatch {{{3
+ * ---------
+ * Tracks the pages of physical memory (of 2**CODE_PAGE_SHIFT bytes) from
+ * which a Simulator has cached decoded instructions, and collects writes to
+ * those pages made other than via that simulator. The simulator discards any
+ * cached instructions affected by such writes before it next executes an
+ * instruction. Writes to pages without cached code cost only a bitmap test.
+ * NotifyWrite may be called from any thread.
  */
-struct SimpleSimulatorConfig {
-  constexpr SimpleSimulatorConfig() = default;
+struct CodeWatch {
+  CodeWatch() :_pages(new std::atomic<uint64_t>[NUM_WORDS]()) {}
 
-  template<typename T>
-  constexpr SimpleSimulatorConfig(const T &o) {
-    main            = o.HaveMainExt();
-    security        = o.HaveSecurityExt();
-    fpb             = o.HaveFPB();
-    dwt             = o.HaveDWT();
-    itm             = o.HaveITM();
-    fpExt           = o.HaveFPExt();
-    sysTick         = o.SysTick();
-    haltingDebug    = o.HaveHaltingDebug();
-    dspExt          = o.HaveDSPExt();
-    numMpuRegionS   = o.NumMpuRegionS();
-    numMpuRegionNS  = o.NumMpuRegionNS();
-    numSauRegion    = o.NumSauRegion();
-    maxExc          = o.MaxExc();
-    initialVtor     = o.InitialVtor();
-    isaVersion      = o.IsaVersion();
-    systIntFreq     = o.SystIntFreq();
-    systExtFreq     = o.SystExtFreq();
-    priorityBits    = o.PriorityBits();
-    mmfarBfarMerged = o.MmfarBFarMerged();
+  // Returns true if any of the given bytes is in a page holding cached code.
+  bool IsWatched(phys_t addr, uint32_t len) const {
+    uint64_t last = (uint64_t(addr) + len - 1) >> CODE_PAGE_SHIFT;
+    for (uint64_t p = addr >> CODE_PAGE_SHIFT; p <= last; ++p)
+      if (_pages[p/64].load(std::memory_order_relaxed) & (uint64_t(1) << (p%64)))
+        return true;
+
+    return false;
   }
 
-  bool HaveMainExt() const { return this->main; }
-  bool HaveSecurityExt() const { return this->security; }
-  bool HaveFPB() const { return this->fpb; }
-  bool HaveDWT() const { return this->dwt; }
-  bool HaveITM() const { return this->itm; }
-  bool HaveFPExt() const { return this->fpExt; }
-  int SysTick() const { return this->sysTick; }
-  bool HaveHaltingDebug() const { return this->haltingDebug; }
-  bool HaveDSPExt() const { return this->dspExt; }
-  uint8_t NumMpuRegionS() const { return this->numMpuRegionS; }
-  uint8_t NumMpuRegionNS() const { return this->numMpuRegionNS; }
-  uint8_t NumSauRegion() const { return this->numSauRegion; }
-  int MaxExc() const { return this->maxExc; }
-  uint32_t InitialVtor() const { return this->initialVtor; }
-  int IsaVersion() const { return this->isaVersion; }
-  uint64_t SystIntFreq() const { return this->systIntFreq; }
-  uint64_t SystExtFreq() const { return this->systExtFreq; }
-  uint8_t PriorityBits() const { return this->priorityBits; }
-  bool MmfarBfarMerged() const { return this->mmfarBfarMerged; }
+  // Reports that the given bytes were modified other than via the simulator.
+  void NotifyWrite(phys_t addr, uint32_t len) {
+    if (!len || !IsWatched(addr, len))
+      return;
 
-  // -----------------------------------------
-  bool      main            = true;         // Whether the simulated CPU supports the Main extension.
-  bool      security        = true;         // Whether the simulated CPU supports the Security extension.
-  bool      fpb             = true;         // Whether the simulated CPU supports the Flash Patch extension.
-  bool      dwt             = true;         // Whether the simulated CPU supports the DWT extension.
-  bool      itm             = true;         // Whether the simulated CPU supports the ITM extension.
-  bool      fpExt           = true;         // Whether the simulated CPU supports the floating point extension.
-  int       sysTick         = 2;            // Whether the simulated CPU supports the SysTick feature. 1=Single, 2=Dual
-  bool      haltingDebug    = true;         // Whether the simulated CPU supports the halting debug feature.
-  bool      dspExt          = false;        // Whether the simulated CPU supports the DSP extension.
-  uint8_t   numMpuRegionS   = NUM_MPU_REGION_S;   // Number of MPU regions supported. 0 for no MPU.
-  uint8_t   numMpuRegionNS  = NUM_MPU_REGION_NS;  // May not exceed NUM_MPU_REGION_{S,NS}.
-  uint8_t   numSauRegion    = NUM_SAU_REGION;     // May not exceed NUM_SAU_REGION. 0 for no SAU.
-  //uint32_t  cpuid           = 0xFFFF'FFFF;// Specifies the value of the CPUID register.
-  int       maxExc          = NUM_EXC-1;    // Maximum number of exceptions supported.
-  uint32_t  initialVtor     = 0;            // Initial VTOR value
-  int       isaVersion      = 8;            // ISA version (7 or 8)
-  uint64_t  systIntFreq     = 100'000'000;  // SysTick frequency when CLKSOURCE=1 (PE).
-  uint64_t  systExtFreq     = 0;            // SysTick frequency when CLKSOURCE=0 (external). 0 to disable.
-  uint8_t   priorityBits    = 8;            // Number of priority bits [3, 8]. Ignored for !main.
-  bool      mmfarBfarMerged = false;        // Are MMFAR, BFAR merged?
-};
+    std::lock_guard<std::mutex> lk(_m);
+    _pending.push_back({addr, len});
+    _hasPending.store(true, std::memory_order_release);
+  }
 
-/* CortexMConfigBase {{{2
- * -----------------
- */
-struct CortexMConfigBase {
-  constexpr bool HaveSecurityExt() const { return false; }
-  constexpr bool HaveFPExt() const { return false; }
-  constexpr bool HaveDSPExt() const { return false; }
-  constexpr bool HaveHaltingDebug() const { return debug; }
-  constexpr uint8_t NumMpuRegionS() const { return 0; }
-  constexpr uint8_t NumMpuRegionNS() const { return numMpuRegion; }
-  constexpr uint8_t NumSauRegion() const { return 0; }
-  constexpr uint32_t InitialVtor() const { return initialVtor; }
-  constexpr uint64_t SystIntFreq() const { return systIntFreq; }
-  constexpr uint64_t SystExtFreq() const { return systExtFreq; }
-  constexpr bool MmfarBfarMerged() const { return true; }
+  // The following are used by the simulator.
 
-  bool      debug         = true;
-  bool      dwt           = true;
-  int       sysTick       = 2;
-  uint8_t   numMpuRegion  = NUM_MPU_REGION_NS;
-  int       maxExc        = NUM_EXC-1;
-  uint32_t  initialVtor   = 0;
-  uint64_t  systIntFreq   = 100'000'000;
-  uint64_t  systExtFreq   = 0;
-};
+  // Marks the pages containing the given bytes as holding cached code.
+  void Watch(phys_t addr, uint32_t len) {
+    uint64_t last = (uint64_t(addr) + len - 1) >> CODE_PAGE_SHIFT;
+    for (uint64_t p = addr >> CODE_PAGE_SHIFT; p <= last; ++p) {
+      uint64_t bit = uint64_t(1) << (p%64);
+      if (!(_pages[p/64].load(std::memory_order_relaxed) & bit))
+        _pages[p/64].fetch_or(bit, std::memory_order_relaxed);
+    }
+  }
 
-/* CortexM0pConfig {{{2
- * ---------------
- */
-struct CortexM0pConfig :CortexMConfigBase {
-  constexpr bool HaveMainExt() const { return false; }
-  constexpr int IsaVersion() const { return 6; }
-  constexpr int SysTick() const { return sysTick > 1 ? 1 : sysTick; }
-  constexpr uint8_t PriorityBits() const { return 2; }
-  constexpr int MaxExc() const { return maxExc > 48 ? 48 : maxExc; }
-  constexpr bool HaveFPB() const { return false; }
-  constexpr bool HaveDWT() const { return debug && dwt; }
-  constexpr bool HaveITM() const { return false; }
-};
+  // Unmarks all pages and discards any pending writes. Used once all cached
+  // code has been discarded.
+  void Clear() {
+    std::lock_guard<std::mutex> lk(_m);
+    for (size_t i=0; i<NUM_WORDS; ++i)
+      _pages[i].store(0, std::memory_order_relaxed);
+    _pending.clear();
+    _hasPending.store(false, std::memory_order_relaxed);
+  }
 
-/* CortexM3M4ConfigBase {{{2
- * --------------------
- */
-struct CortexM3M4ConfigBase :CortexMConfigBase {
-  constexpr bool HaveMainExt() const { return true; }
-  constexpr int IsaVersion() { return 7; }
-  constexpr int SysTick() const { return sysTick > 1 ? 1 : sysTick; }
-  constexpr uint8_t PriorityBits() const { return priorityBits < 3 ? 3 : priorityBits; }
-  constexpr int MaxExc() const { return maxExc > 255 ? 255 : maxExc; }
-  constexpr bool HaveFPB() const { return debug && fpb; }
-  constexpr bool HaveDWT() const { return debug && (dwt || itm); }
-  constexpr bool HaveITM() const { return itm; }
+  bool HasPending() const { return _hasPending.load(std::memory_order_acquire); }
 
-  bool      fpb           = true;
-  bool      itm           = true;
-  uint8_t   priorityBits  = 8;
-};
+  // Calls f(addr, len) for each write reported since the last call.
+  template<typename F>
+  void TakePending(F f) {
+    std::lock_guard<std::mutex> lk(_m);
+    for (auto [addr, len] : _pending)
+      f(addr, len);
+    _pending.clear();
+    _hasPending.store(false, std::memory_order_relaxed);
+  }
 
-/* CortexM3Config {{{2
- * --------------
- */
-struct CortexM3Config :CortexM3M4ConfigBase {
+private:
+  static constexpr size_t NUM_WORDS = (size_t(1) << (32 - CODE_PAGE_SHIFT)) / 64;
+
+  std::unique_ptr<std::atomic<uint64_t>[]>  _pages;
+  std::mutex                                _m;
+  std::vector<std::pair<phys_t, uint32_t>>  _pending;     // protected by _m
+  std::atomic<bool>                         _hasPending{};
 };
 
-/* CortexM4Config {{{2
- * --------------
+/* CodeWatchList {{{3
+ * -------------
+ * The CodeWatches attached to a device, for devices which report writes to
+ * them. Attach and Detach must not be called while any simulator using the
+ * device is storing to it.
  */
-struct CortexM4Config :CortexM3M4ConfigBase {
-  constexpr bool HaveFPExt() const { return fpExt; }
-  constexpr bool HaveDSPExt() const { return dspExt; }
+struct CodeWatchList {
+  void Attach(CodeWatch *cw) {
+    _watches.push_back(cw);
+  }
 
-  bool      fpExt         = false;
-  bool      dspExt        = false;
-};
+  void Detach(CodeWatch *cw) {
+    _watches.erase(std::remove(_watches.begin(), _watches.end(), cw), _watches.end());
+  }
 
-/* CortexM23Config {{{2
- * ---------------
- */
-struct CortexM23Config :CortexMConfigBase {
-  constexpr bool HaveMainExt() const { return false; }
-  constexpr bool HaveSecurityExt() const { return security; }
-  constexpr int IsaVersion() { return 8; }
-  constexpr int SysTick() const { return (sysTick > 1 && !HaveSecurityExt()) ? 1 : sysTick; }
-  constexpr uint8_t PriorityBits() const { return 2; }
-  constexpr int MaxExc() const { return maxExc > 255 ? 255 : maxExc; }
-  constexpr bool HaveFPB() const { return debug && fpb; }
-  constexpr bool HaveDWT() const { return debug && (dwt || itm); }
-  constexpr bool HaveITM() const { return itm; }
+  // Reports a write to every CodeWatch other than except. Each costs only a
+  // bitmap test unless the write hits a page holding cached code.
+  void NotifyWrite(phys_t addr, uint32_t len, const CodeWatch *except=nullptr) {
+    for (auto *cw : _watches)
+      if (cw != except)
+        cw->NotifyWrite(addr, len);
+  }
 
-  bool      security      = true;
-  bool      fpb           = true;
-  bool      itm           = true;
+  auto begin() const { return _watches.begin(); }
+  auto end() const { return _watches.end(); }
+
+private:
+  std::vector<CodeWatch*> _watches;
 };
 
-/* CortexM33Config {{{2
- * ---------------
+/* DirtyMap {{{3
+ * --------
+ * Records which pages (of 2**DIRTY_PAGE_SHIFT bytes) of a block of host memory
+ * have been written. A device publishing the memory as host regions attaches
+ * the map to them so that stores made directly by the simulator are recorded,
+ * and marks the pages its own Store writes. Pages are identified by their
+ * byte offset from the start of the block. Writing costs a bitmap test in the
+ * common case of an already dirty page. All methods may be called from any
+ * thread.
  */
-struct CortexM33Config :CortexMConfigBase {
-  constexpr bool HaveMainExt() const { return true; }
-  constexpr bool HaveSecurityExt() const { return security; }
-  constexpr int IsaVersion() { return 8; }
-  constexpr int SysTick() const { return (sysTick > 1 && !HaveSecurityExt()) ? 1 : sysTick; }
-  constexpr uint8_t PriorityBits() const { return priorityBits < 3 ? 3 : priorityBits; }
-  constexpr int MaxExc() const { return maxExc > 496 ? 496 : maxExc; }
-  constexpr bool HaveFPB() const { return debug && fpb; }
-  constexpr bool HaveDWT() const { return debug && (dwt || itm); }
-  constexpr bool HaveITM() const { return itm; }
-  constexpr bool HaveFPExt() const { return fpExt; }
-  constexpr bool HaveDSPExt() const { return dspExt; }
+struct DirtyMap {
+  static constexpr size_t PAGE_SIZE = size_t(1) << DIRTY_PAGE_SHIFT;
+
+  DirtyMap(const uint8_t *base, size_t len)
+    :_base(base), _numWords(((len + PAGE_SIZE - 1) / PAGE_SIZE + 63) / 64),
+     _pages(new std::atomic<uint64_t>[_numWords]()) {}
+
+  // Marks the pages containing the given bytes, which must be in the block.
+  void Mark(const uint8_t *p, size_t len) {
+    size_t last = (p - _base + len - 1) >> DIRTY_PAGE_SHIFT;
+    for (size_t pg = (p - _base) >> DIRTY_PAGE_SHIFT; pg <= last; ++pg) {
+      uint64_t bit = uint64_t(1) << (pg%64);
+      if (!(_pages[pg/64].load(std::memory_order_relaxed) & bit))
+        _pages[pg/64].fetch_or(bit, std::memory_order_relaxed);
+    }
+  }
 
-  bool      security      = true;
-  bool      fpb           = true;
-  bool      itm           = true;
-  uint8_t   priorityBits  = 8;
-  bool      fpExt         = false;
-  bool      dspExt        = false;
-};
+  bool IsDirty(size_t offset) const {
+    size_t pg = offset >> DIRTY_PAGE_SHIFT;
+    return !!(_pages[pg/64].load(std::memory_order_relaxed) & (uint64_t(1) << (pg%64)));
+  }
 
-/* DeadlineCaller {{{2
- * ==============
- * Simple utility class which calls a specified callback on another thread at a
- * specified deadline.
- */
-struct DeadlineCaller {
-  using time_point = std::chrono::steady_clock::time_point;
+  // Calls f(offset) for each dirty page, in ascending order.
+  template<typename F>
+  void ForEach(F f) const {
+    for (size_t i=0; i<_numWords; ++i)
+      for (uint64_t w = _pages[i].load(std::memory_order_relaxed); w; w &= w - 1)
+        f((i*64 + CTZL(w)) << DIRTY_PAGE_SHIFT);
+  }
 
-  DeadlineCaller() {}
+  // As for ForEach, but also clears the pages reported.
+  template<typename F>
+  void Take(F f) {
+    for (size_t i=0; i<_numWords; ++i)
+      if (_pages[i].load(std::memory_order_relaxed))
+        for (uint64_t w = _pages[i].exchange(0, std::memory_order_relaxed); w; w &= w - 1)
+          f((i*64 + CTZL(w)) << DIRTY_PAGE_SHIFT);
+  }
 
-  // Can be safely destroyed at any time. Any callback will be cancelled.
-  ~DeadlineCaller() {
-    {
-      std::unique_lock lk{_m};
-      _teardown = true;
-      _cb       = nullptr;
-    }
-    _cv.notify_all();
-    if (_t.joinable())
-      _t.join();
+  void Clear() {
+    for (size_t i=0; i<_numWords; ++i)
+      _pages[i].store(0, std::memory_order_relaxed);
   }
 
-  /* Start {{{3
-   * -----
-   * Set a new deadline. If there is an existing deadline pending it is
-   * cancelled. The function f will be called at or after the deadline and will
-   * be passed the opaque value arg. Passing a default-constructed time_point
-   * or a null f has the same effect as calling stop.
-   */
-  void Start(time_point deadline, void (*f)(void *arg), void *arg) {
-    if (!deadline.time_since_epoch().count() || !f) {
-      Stop();
-      return;
-    }
+private:
+  const uint8_t                            *_base;
+  size_t                                    _numWords;
+  std::unique_ptr<std::atomic<uint64_t>[]>  _pages;
+};
 
-    _EnsureThread();
+/* PageRouterDevice {{{2
+ * ================
+ * An IDevice which routes each access to the device mapped at its address.
+ * Devices are mapped in pages of 2**ROUTER_PAGE_SHIFT bytes via a two-level
+ * table of 1 MiB sections, each divided into pages. Sections with nothing
+ * mapped share a single table, so resolving an address is always two indexed
+ * loads. Accesses to unmapped pages go to the fallback device given on
+ * construction, or are BusFaults if there is none.
+ *
+ * Pages of a device which lie within one of its host regions (see
+ * IDevice::GetHostRegions) are accessed directly, and the router publishes
+ * those regions in turn. Host memory can also be mapped without a device by
+ * MapHost. Stores to it are reported to the CodeWatches attached to the
+ * router, as are stores to a device's host region which names no
+ * CodeWatchList of its own. Mappings may be changed at any time, after which
+ * InvalidateCaches must be called on any Simulator using the router.
+ */
+struct PageRouterDevice :IDevice {
+  explicit PageRouterDevice(IDevice *fallback=nullptr)
+    :_fallback(fallback ? fallback : &_noDevice), _empty(new Page[PAGES_PER_SECTION]) {
+    for (size_t i=0; i<PAGES_PER_SECTION; ++i)
+      _empty[i] = {_fallback, nullptr, 0, nullptr, nullptr};
+    for (auto &s : _sections)
+      s = _empty.get();
+    if (fallback)
+      _AddDevice(fallback);
+  }
+
+  /* Map {{{3
+   * ---
+   * Maps [base, base+len) to dev, replacing any existing mapping. base and len
+   * must be multiples of the page size. dev must outlive the mapping.
+   */
+  void Map(phys_t base, uint32_t len, IDevice *dev) {
+    std::vector<HostRegion> regions;
+    dev->GetHostRegions(regions);
+
+    _ForEachPage(base, len, [&](phys_t addr, Page &pg) {
+      pg = {dev, nullptr, 0, nullptr, nullptr};
+      for (auto &r : regions)
+        if (addr - r.base < r.len && PAGE_SIZE <= r.len - (addr - r.base)) {
+          pg.host    = r.ptr + (addr - r.base);
+          pg.perms   = r.perms;
+          pg.dirty   = r.dirty;
+          pg.watches = r.watches ? r.watches : &_watches;
+          break;
+        }
+    });
 
-    {
-      std::unique_lock lk{_m};
-      _deadline = deadline;
-      _cb       = f;
-      _cbArg    = arg;
-    }
-    _cv.notify_all();
+    _AddDevice(dev);
   }
 
-  /* Stop {{{3
-   * ----
-   * Cancel any existing deadline, if any.
+  /* MapHost {{{3
+   * -------
+   * Maps [base, base+len) to the host memory at ptr, replacing any existing
+   * mapping. Accesses not permitted by perms (HOST_REGION__*) are BusFaults.
+   * If dirty is given, stores are recorded there.
    */
-  void Stop() {
-    std::unique_lock lk{_m};
-    _cb = nullptr;
+  void MapHost(phys_t base, uint32_t len, uint8_t *ptr, uint32_t perms, DirtyMap *dirty=nullptr) {
+    _ForEachPage(base, len, [&](phys_t addr, Page &pg) {
+      pg = {&_noDevice, ptr + (addr - base), perms, dirty, &_watches};
+    });
   }
 
-private:
-  void _EnsureThread() {
-    if (_t.joinable())
-      return;
-
-    _t = std::thread{[this]() { _TMain(); }};
+  /* Unmap {{{3
+   * -----
+   */
+  void Unmap(phys_t base, uint32_t len) {
+    _ForEachPage(base, len, [&](phys_t addr, Page &pg) {
+      pg = {_fallback, nullptr, 0, nullptr, nullptr};
+    });
   }
 
-  /* _TMain {{{3
-   * ------
+  /* IDevice {{{3
+   * -------
    */
-  void _TMain() {
-    std::unique_lock lk{_m};
-    for (;;) {
-      if (_teardown)
-        break;
+  int Load(phys_t addr, int size, uint32_t flags, uint32_t &v) override {
+    const Page &pg = _sections[addr >> 20][GETBITS(addr, ROUTER_PAGE_SHIFT, 19)];
+    uint32_t perm = GETBITSM(flags, LS_FLAG__ATYPE__MASK) == LS_FLAG__ATYPE__IFETCH ? HOST_REGION__EXEC : HOST_REGION__READ;
+    if (pg.perms & perm) {
+      v = 0;
+      memcpy(&v, pg.host + (addr & (PAGE_SIZE-1)), size);
+      return 0;
+    }
 
-      if (_cb)
-        _cv.wait_until(lk, _deadline);
-      else
-        _cv.wait(lk);
+    return pg.dev->Load(addr, size, flags, v);
+  }
 
-      if (_cb && std::chrono::steady_clock::now() >= _deadline) {
-        auto cb    = _cb;
-        auto cbArg = _cbArg;
-        _cb = nullptr;
-        lk.unlock();
-        cb(cbArg);
-        lk.lock();
-      }
+  int Store(phys_t addr, int size, uint32_t flags, uint32_t v) override {
+    const Page &pg = _sections[addr >> 20][GETBITS(addr, ROUTER_PAGE_SHIFT, 19)];
+    if (pg.perms & HOST_REGION__WRITE) {
+      uint8_t *p = pg.host + (addr & (PAGE_SIZE-1));
+      memcpy(p, &v, size);
+      if (pg.dirty)
+        pg.dirty->Mark(p, size);
+      return 0;
     }
-  } // }}}3
 
-private:
-  std::mutex                  _m;
-  std::condition_variable_any _cv;                // protected by _m
-  time_point                  _deadline;          //
-  bool                        _teardown{};        //
-  void                      (*_cb)(void *arg){};  //
-  void                       *_cbArg;             //
-  std::thread                 _t;
-};
+    return pg.dev->Store(addr, size, flags, v);
+  }
 
-/* ISysTickDevice {{{2
- * ==============
- * ISysTickDevice implements the SysTickDevice concept.
- */
-struct ISysTickDevice {
-  /* SysTickSetConfig {{{3
-   * ----------------
-   * Called whenever the configuration of a SysTick timer is updated; whenever
-   * the CSR, RVR or CVR is written. freq is in Hz. tickInt is the value of
-   * REG_SYST_CSR__TICKINT. The reload value is updated to the given value
-   * which must be in range [0, 2**24-1]. If curValue is -1, it is not updated,
-   * else it is set to the given value.
-   */
-  virtual void SysTickSetConfig(bool enable, bool tickInt, uint64_t freq, uint32_t reloadValue, int curValue) = 0;
+  // Bursts are split at page boundaries.
+  int LoadBurst(phys_t addr, int count, uint32_t flags, uint32_t *v) override {
+    uint32_t perm = GETBITSM(flags, LS_FLAG__ATYPE__MASK) == LS_FLAG__ATYPE__IFETCH ? HOST_REGION__EXEC : HOST_REGION__READ;
+    for (int done=0; done < count; ) {
+      phys_t      a   = addr + 4*done;
+      int         n   = std::min(count - done, int((PAGE_SIZE - (a & (PAGE_SIZE-1)))/4));
+      const Page &pg  = _sections[a >> 20][GETBITS(a, ROUTER_PAGE_SHIFT, 19)];
+      if (pg.perms & perm)
+        memcpy(v + done, pg.host + (a & (PAGE_SIZE-1)), 4*n);
+      else {
+        int got = pg.dev->LoadBurst(a, n, flags, v + done);
+        if (got < n)
+          return done + got;
+      }
 
-  /* SysTickGetConfig {{{3
-   * ----------------
-   * Retrieves {enable, tickInt, freq, reloadValue}.
-   */
-  virtual std::tuple<bool, bool, uint64_t, uint32_t> SysTickGetConfig() = 0;
+      done += n;
+    }
 
-  /* SysTickGetCurrent {{{3
-   * -----------------
-   * Gets the current value of the timer. The value must be less than 2**24.
-   * The value counts down.
-   */
-  virtual uint32_t SysTickGetCurrent() = 0;
+    return count;
+  }
 
-  /* SysTickGetCountFlag {{{3
-   * -------------------
-   * Gets and optionally clears the count flag.
-   */
-  virtual bool SysTickGetCountFlag(bool clear) = 0;
+  int StoreBurst(phys_t addr, int count, uint32_t flags, const uint32_t *v) override {
+    for (int done=0; done < count; ) {
+      phys_t      a   = addr + 4*done;
+      int         n   = std::min(count - done, int((PAGE_SIZE - (a & (PAGE_SIZE-1)))/4));
+      const Page &pg  = _sections[a >> 20][GETBITS(a, ROUTER_PAGE_SHIFT, 19)];
+      if (pg.perms & HOST_REGION__WRITE) {
+        uint8_t *p = pg.host + (a & (PAGE_SIZE-1));
+        memcpy(p, v + done, 4*n);
+        if (pg.dirty)
+          pg.dirty->Mark(p, 4*n);
+      } else {
+        int got = pg.dev->StoreBurst(a, n, flags, v + done);
+        if (got < n)
+          return done + got;
+      }
 
-  /* SysTickGetIntrFlag {{{3
-   * ------------------
-   * Gets and optionally clears the interrupt pending flag. tickInt must have been enabled.
-   */
-  virtual bool SysTickGetIntrFlag(bool clear) = 0;
+      done += n;
+    }
 
-  /* SysTickSetCallback {{{3
-   * ------------------
-   * Sets a callback to be called on an unspecified thread whenever the tick
-   * interrupt occurs. Both tickInt and the timer itself must be enabled. To
-   * disable the callback after enabling it, pass nullptr.
-   *
-   * As a special case, when f is specified as nullptr, the method must only
-   * return once it is guaranteed that no call to the old callback function is
-   * currently taking place or will take place in the future. Changes from one
-   * non-nullptr value of f to another non-nullptr value of f do not require
-   * the implementation to offer this guarantee.
-   */
-  virtual void SysTickSetCallback(void (*f)(void *arg), void *arg) = 0;
-};
+    return count;
+  }
 
-/* SysTickDevice_Real {{{2
- * ==================
- * This is a SysTick emulator which uses real-world time to model the timer. We
- * use a system monotonic clock for this purpose.
- *
- * We implement the emulation as follows. There are two ways of expressing time
- * used by this implementation: Epoch time and SysTick time. Our internal
- * representation is Epoch time and we convert to SysTick time whenever queries
- * are made against us (e.g. when SYST_CVR is read).
- *
- * Epoch time denotes time as the amount of time since an epoch. The epoch used
- * is not the UNIX epoch but the time at which the SysTick emulator was last
- * reconfigured in a way that affects the process of conversion between Epoch
- * and SysTick time. The idea is that between any two such reconfiguration
- * events, there is a fixed, linear (albeit modular) correspondance between
- * Epoch and SysTick time. This means we don't have to perform any periodic
- * computations to "maintain" the timer, and we consume no CPU time just
- * tracking the advancement of time.
- *
- * Suppose there are two reconfiguration events C-1 and C-2. The passage of
- * time might look like this:
- *
- *    Time (t) --->
- *
- *      C-1                                                    C-2
- *       |                                                      |
- *       |                                                      |
- *      E=t                                                    E=t'
- *
- * At C-1 the epoch E is set to the current time t. For any subsequent reading
- * of t (prior to event C-2) we can thus determine the amount of time which has
- * passed since C-1. There is a linear albeit modular correspondance between
- * the current value of (t-E) and the current value of the SysTick timer for
- * this entire period between C-1 and C-2. The SysTick timer is a down-counter,
- * therefore this produces a pattern like this:
- *
- *         SYST_RVR
- *            |\    \
- *            | \    \
- *            |  \    \
- *   SYST_CVR |   \    \
- *            |    \    \
- *            |-----------
- *                   t -->
- *
- * We represent the number of clock cycles since the current epoch E as an
- * unsigned 64-bit integer. The fastest Cortex-M, the Cortex-M7, can run at up
- * to 600 MHz; in this case we would be able to count clock cycles for about
- * 975 years before facing an overflow.
- */
-struct SysTickDevice_Real final :ISysTickDevice {
-  void SysTickSetConfig(bool enable, bool tickInt, uint64_t freq, uint32_t reloadValue, int curValue) override {
-    std::unique_lock lk{_m};
+  // Publishes each run of pages mapped to contiguous host memory with the same
+  // permissions, dirty map and CodeWatchList as a single region.
+  void GetHostRegions(std::vector<HostRegion> &regions) override {
+    HostRegion cur{};
+    auto flush = [&]() {
+      if (cur.len)
+        regions.push_back(cur);
+      cur = {};
+    };
 
-    if (enable != _enable || reloadValue != _reload || freq != _freq || (curValue >= 0 && curValue < BIT(24))) {
-      assert(freq);
+    for (size_t s=0; s<NUM_SECTIONS; ++s) {
+      if (_sections[s] == _empty.get()) {
+        flush();
+        continue;
+      }
 
-      // The device has been changed from being enabled to not enabled or vice
-      // versa; or the reload value has been changed; or the frequency has been
-      // changed; or the current value has been set directly. In any case this
-      // means our linear correspondance between Epoch and SysTick time has now
-      // changed, so we need to begin a new epoch.
-      //
-      // Note that the SysTick SYST_CVR register itself clears to zero whenever
-      // it is written, rather than to the written value, but we implement the
-      // setting of arbitrary current values in this class itself.
-      uint32_t newInitialCur = (curValue >= 0 && curValue < BIT(24)) ? curValue : SysTickGetCurrent();
+      for (size_t i=0; i<PAGES_PER_SECTION; ++i) {
+        const Page &pg = _sections[s][i];
+        if (cur.len && pg.host == cur.ptr + cur.len && pg.perms == cur.perms && pg.dirty == cur.dirty && pg.watches == cur.watches) {
+          cur.len += PAGE_SIZE;
+          continue;
+        }
 
-      _epoch      = std::chrono::steady_clock::now();
-      _enable     = enable;
-      _freq       = freq;
-      _reload     = reloadValue;
-      _initialCur = newInitialCur;
+        flush();
+        if (pg.perms)
+          cur = {phys_t((s << 20) | (i << ROUTER_PAGE_SHIFT)), PAGE_SIZE, pg.host, pg.perms, pg.dirty, pg.watches};
+      }
     }
 
-    _tickInt = tickInt;
-    _XUpdateCallback();
+    flush();
   }
 
-  std::tuple<bool, bool, uint64_t, uint32_t> SysTickGetConfig() override {
-    return {_enable, _tickInt, _freq, _reload};
+  void AttachCodeWatch(CodeWatch *cw) override {
+    _watches.Attach(cw);
+    for (auto *dev : _devs)
+      dev->AttachCodeWatch(cw);
   }
 
-  uint32_t SysTickGetCurrent() override {
-    auto [cur, _] = _GetCurrentAndEra();
-    return cur;
+  void DetachCodeWatch(CodeWatch *cw) override {
+    _watches.Detach(cw);
+    for (auto *dev : _devs)
+      dev->DetachCodeWatch(cw);
   }
 
-  bool SysTickGetCountFlag(bool clear) override {
-    auto [_, era] = _GetCurrentAndEra();
-
-    bool eraChanged = (_lastCountFlagEra != era);
-    if (clear)
-      _lastCountFlagEra = era;
+  // Stores are split at page boundaries, as for bursts.
+  void NotifyStore(phys_t addr, uint32_t len, const CodeWatch *writer) override {
+    while (len) {
+      uint32_t    n   = std::min(len, PAGE_SIZE - (addr & (PAGE_SIZE-1)));
+      const Page &pg  = _sections[addr >> 20][GETBITS(addr, ROUTER_PAGE_SHIFT, 19)];
+      if (pg.perms & HOST_REGION__WRITE)
+        pg.watches->NotifyWrite(addr, n, writer);
+      else
+        pg.dev->NotifyStore(addr, n, writer);
 
-    return eraChanged;
+      addr += n;
+      len  -= n;
+    }
   }
 
-  bool SysTickGetIntrFlag(bool clear) override {
-    auto [_, era] = _GetCurrentAndEra();
-
-    bool intr = (_lastIntrEra != era);
-    if (clear)
-      _lastIntrEra = era;
-
-    return _tickInt && intr;
-  }
+private:
+  static constexpr uint32_t PAGE_SIZE         = uint32_t(1) << ROUTER_PAGE_SHIFT;
+  static constexpr size_t   PAGES_PER_SECTION = size_t(1) << (20 - ROUTER_PAGE_SHIFT);
+  static constexpr size_t   NUM_SECTIONS      = size_t(1) << 12;
+
+  struct Page {
+    IDevice       *dev;     // Device handling accesses not made via host.
+    uint8_t       *host;    // Host memory holding the page, if perms is nonzero.
+    uint32_t       perms;   // HOST_REGION__*
+    DirtyMap      *dirty;   // Records stores to host, if set.
+    CodeWatchList *watches; // Receives stores to host, if perms is nonzero.
+  };
 
-  void SysTickSetCallback(void (*f)(void *arg), void *arg) override {
-    std::unique_lock lk{_m};
+  struct NoDevice final :IDevice {
+    int Load(phys_t addr, int size, uint32_t flags, uint32_t &v) override { return 1; }
+    int Store(phys_t addr, int size, uint32_t flags, uint32_t v) override { return 1; }
+  };
 
-    _cb     = f;
-    _cbArg  = arg;
+  template<typename F>
+  void _ForEachPage(phys_t base, uint32_t len, F f) {
+    ASSERT(!(base % PAGE_SIZE) && !(len % PAGE_SIZE));
+    for (uint64_t addr = base; addr < uint64_t(base) + len; addr += PAGE_SIZE) {
+      size_t s = addr >> 20;
+      if (_sections[s] == _empty.get()) {
+        _tables[s].reset(new Page[PAGES_PER_SECTION]);
+        std::copy(_empty.get(), _empty.get() + PAGES_PER_SECTION, _tables[s].get());
+        _sections[s] = _tables[s].get();
+      }
 
-    if (!_cb) {
-      // If we are clearing the callback, ensure that _TCallback()
-      // has not already loaded old values of (_cb, _cbArg) and is about
-      // to call them. When SysTickSetCallback is called with a nullptr cb,
-      // it is guaranteed that no further calls to the old callback will
-      // occur once it returns.
-      std::unique_lock lk2{_mfull};
-      return;
+      f(phys_t(addr), _sections[s][GETBITS(addr, ROUTER_PAGE_SHIFT, 19)]);
     }
+  }
 
-    auto [_, era] = _GetCurrentAndEra();
-    _lastCbEra = era;
+  void _AddDevice(IDevice *dev) {
+    if (std::find(_devs.begin(), _devs.end(), dev) != _devs.end())
+      return;
 
-    _XUpdateCallback();
+    _devs.push_back(dev);
+    for (auto *cw : _watches)
+      dev->AttachCodeWatch(cw);
   }
 
-  template<typename Visitor>
-  void Visit(Visitor &v) {
-    v("enable", _enable)
-     ("tickInt", _tickInt)
-     ("freq", _freq)
-     ("reload", _reload)
-     ("initialCur", _initialCur)
-     ("epoch", _epoch)
-     ("lastCountFlagEra", _lastCountFlagEra)
-     ("lastIntrEra", _lastIntrEra)
-     ("lastCbEra", _lastCbEra);
-  }
+  NoDevice                            _noDevice;
+  IDevice                            *_fallback;
+  std::unique_ptr<Page[]>             _empty;
+  std::array<Page*, NUM_SECTIONS>     _sections;
+  std::unique_ptr<Page[]>             _tables[NUM_SECTIONS];
+  std::vector<IDevice*>               _devs;     // Every device ever mapped.
+  CodeWatchList                       _watches;
+};
 
-private:
-  using time_point = std::chrono::steady_clock::time_point;
-  // Functions beginning _X might be called on any thread (i.e., on the thread
-  // driving this object or the callback thread). Functions beginning _T are
-  // called only on our callback thread.
-  //
-  // Retrieve the number of virtual SysTick clock cycles which have occured
-  // since the last epoch. This is determined by _epoch, the current time, and
-  // _freq, our SysTick frequency in Hz. Implemented using fixed point
-  // arithmetic to ensure perfect precision.
-  uint64_t _GetClockCyclesSinceEpoch() {
-    auto now = std::chrono::steady_clock::now();
-    auto d   = _enable ? now - _epoch : decltype(now - _epoch){};
+#if defined(__unix__)
+/* MappedMemoryDevice {{{2
+ * ==================
+ * A RAM or flash device whose memory is obtained with mmap, so that creating
+ * one costs the same regardless of its size. The memory starts out as an
+ * anonymous zero-filled mapping, whose pages are only allocated when written.
+ * An image file can be mapped over the start of it with MapFile without being
+ * read or copied. By default the file is mapped privately, so its pages are
+ * shared via the page cache, including with other devices mapping the same
+ * file, until written; with MAPPED_FILE__SHARED, writes go to the file.
+ *
+ * perms (HOST_REGION__*) gives the accesses the simulated core may make.
+ * Stores to a device without HOST_REGION__WRITE, such as flash, are
+ * BusFaults. The host may modify the memory via GetBuf regardless.
+ *
+ * TakeSnapshot and RestoreSnapshot (Linux only) return the memory to an
+ * earlier state at a cost proportional to the pages touched since, rather
+ * than to the size of the memory.
+ */
+enum :uint32_t {
+  MAPPED_FILE__SHARED = BIT(0), // Writes are made to the file.
+};
 
-    // We temporarily convert to a nanosecond representation here to find the
-    // number of nanoseconds to add to the integral number of seconds. This
-    // limits the duration d to be about 292 years assuming a signed 64-bit
-    // representation.
-    uint64_t ds  = std::chrono::duration_cast<std::chrono::seconds>(d).count(); // integer seconds since epoch
-    uint64_t dns = (std::chrono::duration_cast<std::chrono::nanoseconds>(d) % std::chrono::nanoseconds(1'000'000'000)).count(); // remainder in ns
+struct MappedMemoryDevice :IDevice {
+  MappedMemoryDevice(phys_t base, uint32_t len,
+                     uint32_t perms = HOST_REGION__READ | HOST_REGION__WRITE | HOST_REGION__EXEC)
+    :_base(base), _len(len), _perms(perms), _mapLen(_RoundToPage(len)),
+     _buf(_MapAnonymous(_mapLen)), _dirty(_buf, len) {}
 
-    return ds*_freq + (dns*_freq)/1'000'000'000; // number of clock cycles since epoch
+  ~MappedMemoryDevice() {
+    munmap(_buf, _mapLen);
+    if (_snapFd >= 0)
+      close(_snapFd);
   }
 
-  // Retrieve the current value of the current value register, as well as an
-  // era value. The current value counts down from 2**24-1. The era value
-  // increases by one every time the current value wraps, and thus allows us to
-  // determine when to report that the count flag is set.
-  std::tuple<uint32_t, uint64_t> _GetCurrentAndEra() {
-    uint64_t cycles = _GetClockCyclesSinceEpoch() + (_reload - _initialCur);
+  MappedMemoryDevice(const MappedMemoryDevice &) = delete;
+  MappedMemoryDevice &operator=(const MappedMemoryDevice &) = delete;
 
-    uint32_t cur = _reload - (cycles % (_reload+1));
-    uint64_t era = cycles / (_reload+1);
+  phys_t GetBase() const { return _base; }
+  uint32_t GetLen() const { return _len; }
+  uint8_t *GetBuf() { return _buf; }
 
-    return {cur, era};
-  }
+  // Pages written by the simulator or via Store, as offsets from GetBase.
+  // Writes made via GetBuf, MapFile or RestoreSnapshot are not recorded.
+  DirtyMap &GetDirtyMap() { return _dirty; }
 
-  // Determine the deadline at which the era will change.
-  time_point _XGetDeadline() { // must hold lock
-    if (!_enable || !_tickInt || !_cb)
-      return {};
+  /* MapFile {{{3
+   * -------
+   * Maps the file at path, or the open file fd, over the start of the memory,
+   * replacing its contents. Memory beyond the end of the file is zero. flags
+   * is a combination of MAPPED_FILE__*. Returns 0 or a negated errno value.
+   */
+  int MapFile(const char *path, uint32_t flags=0) {
+    int fd = open(path, (flags & MAPPED_FILE__SHARED) ? O_RDWR : O_RDONLY);
+    if (fd < 0)
+      return -errno;
 
-    //(era+1)*(_reload+1) - (_reload - _initialCur) = ((DLINE - _epoch) AS seconds)*_freq + (((DLINE - _epoch) AS ns)*_freq)/1'000'000'000;
-    //((era+1)*(_reload+1) - (_reload - _initialCur)) = ((DLINE - epoch) AS seconds)*_freq; // logical
-    //((era+1)*(_reload+1) - (_reload - _initialCur))/_freq = (DLINE - epoch) AS seconds; // logical
-    //FromSeconds(((era+1)*(_reload+1) - (_reload - _initialCur))/_freq) = (DLINE - epoch); // logical
-    //FromSeconds(((era+1)*(_reload+1) - (_reload - _initialCur))/_freq) + epoch = DLINE; // logical
+    int rc = MapFile(fd, flags);
+    close(fd);
+    return rc;
+  }
 
-    uint64_t nsSinceEpoch = ((_lastCbEra+1)*(_reload+1) - (_reload - _initialCur))*1'000'000'000/_freq;
+  int MapFile(int fd, uint32_t flags=0) {
+    struct stat st;
+    if (fstat(fd, &st) < 0)
+      return -errno;
 
-    return _epoch + std::chrono::nanoseconds(nsSinceEpoch);
-  }
+    if (uint64_t(st.st_size) > _len)
+      return -EFBIG;
 
-  // Functions beginning _X might be called on any thread (i.e., on the thread
-  // driving this object or the callback thread).
-  void _XUpdateCallback() { // must hold lock
-    _dc.Start(_XGetDeadline(), [](void *arg) { static_cast<SysTickDevice_Real*>(arg)->_TCallback(); }, this);
-  }
+    size_t len = _RoundToPage(st.st_size);
+    if (!len)
+      return 0;
 
-  // Functions beginning _T are called on our callback thread.
-  void _TCallback() {
-    // Additional lock for the entire _TCallback() call which we do not unlock
-    // during the cb() invocation. This allows us to ensure that a _TCallback()
-    // call is not in progress during a clearing of the callback function
-    // (SysTickSetCallback(nullptr, nullptr)). If SysTickSetCallback(nullptr, nullptr) is in progress
-    // when we start executing _TCallback(), it may have already acquired _m
-    // and will then wait forever for _mfull, so we need to use a deadlock
-    // avoidance algorithm here.
-    std::unique_lock lk2{_mfull, std::defer_lock};
-    std::unique_lock lk {_m,     std::defer_lock};
-    std::lock(lk2, lk);
-    auto cb     = _cb;
-    auto cbArg  = _cbArg;
+    void *p = mmap(_buf, len, PROT_READ|PROT_WRITE,
+                   ((flags & MAPPED_FILE__SHARED) ? MAP_SHARED : MAP_PRIVATE) | MAP_FIXED, fd, 0);
+    if (p == MAP_FAILED)
+      return -errno;
 
-    if (cb) {
-      lk.unlock();
-      cb(cbArg);
-      lk.lock();
+    _watches.NotifyWrite(_base, uint32_t(std::min<size_t>(len, _len)));
 
-      ++_lastCbEra;
-      _XUpdateCallback();
-    }
+    return 0;
   }
 
-private:
-  // Mutex.
-  std::mutex  _m, _mfull;
+#if defined(__linux__)
+  /* TakeSnapshot {{{3
+   * ------------
+   * Copies the memory to an anonymous file, replacing any previous snapshot,
+   * and maps the file privately in place of the memory, so that pages are
+   * shared with the snapshot until written. Any file mapped with
+   * MAPPED_FILE__SHARED no longer receives writes. Returns 0 or a negated
+   * errno value.
+   */
+  int TakeSnapshot() {
+    int fd = memfd_create("memu-snapshot", MFD_CLOEXEC);
+    if (fd < 0)
+      return -errno;
+
+    if (ftruncate(fd, _mapLen) < 0)
+      return _CloseWithError(fd);
+
+    // Pages which are entirely zero are left as holes.
+    size_t pageSize = sysconf(_SC_PAGESIZE);
+    for (size_t off=0; off < _mapLen; off += pageSize) {
+      const uint8_t *p = _buf + off;
+      if (!p[0] && !memcmp(p, p + 1, pageSize - 1))
+        continue;
 
-  // Values updated by SetConfig.
-  bool        _enable{}, _tickInt{};
-  uint64_t    _freq{};
-  uint32_t    _reload{};
-  uint32_t    _initialCur{};
-  time_point  _epoch{};
+      for (size_t done=0; done < pageSize; ) {
+        ssize_t n = pwrite(fd, p + done, pageSize - done, off + done);
+        if (n < 0 && errno != EINTR)
+          return _CloseWithError(fd);
+        if (n > 0)
+          done += n;
+      }
+    }
 
-  // Internal data.
-  uint64_t    _lastCountFlagEra{}, _lastIntrEra{}, _lastCbEra{};
+    void *p = mmap(_buf, _mapLen, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_FIXED, fd, 0);
+    if (p == MAP_FAILED)
+      return _CloseWithError(fd);
 
-  // Callback handling.
-  DeadlineCaller  _dc;
-  void          (*_cb)(void *arg){};
-  void           *_cbArg{};
-};
+    if (_snapFd >= 0)
+      close(_snapFd);
 
-/* IntrBox {{{2
- * =======
- * An interrupt box is used to manage the delivery of external and NMI
- * interrupts to the Simulator. SysTick is handled internally by the simulator.
- *
- * The Simulator itself is not thread-safe and access to it must be
- * synchronized. This utility enables easy threaded delivery of external
- * interrupts and NMI events to the Simulator and allows WFI to be implemented
- * by a top-level loop.
- *
- * When using this class, it is essential that TriggerNMI and TriggerExtInt
- * always be called using this class and the equivalent methods on the
- * Simulator class not be called directly, as IntrBox needs to know about these
- * events so it can cause its WaitForInterrupt method to return. Unlike the
- * equivalent methods on the simulator class, these methods can be called from
- * arbitrary threads.
- *
- * If you want to access the simulator from multiple threads, you can use the
- * mutex accessed via the GetMutex() method to synchronize such access.
- */
-template<typename Sim>
-struct IntrBox {
-  IntrBox(Sim &sim) :_sim(sim) {
-    int numSysTick = _sim.GetNumSysTick();
-    if (numSysTick)
-      _sim.GetSysTick(false).SysTickSetCallback([](void *arg) { static_cast<IntrBox*>(arg)->_TCallback(false); }, this);
-    if (numSysTick == 2)
-      _sim.GetSysTick(true).SysTickSetCallback([](void *arg) { static_cast<IntrBox*>(arg)->_TCallback(true); }, this);
+    _snapFd = fd;
+    return 0;
   }
 
-  ~IntrBox() {
-    std::unique_lock lk{_m};
+  /* RestoreSnapshot {{{3
+   * ---------------
+   * Returns the memory to the state captured by the last TakeSnapshot by
+   * discarding the pages written since, which are then shared with the
+   * snapshot again. Returns 0 or a negated errno value.
+   */
+  int RestoreSnapshot() {
+    if (_snapFd < 0)
+      return -EINVAL;
 
-    int numSysTick = _sim.GetNumSysTick();
-    if (numSysTick)
-      _sim.GetSysTick(false).SysTickSetCallback(nullptr, nullptr);
-    if (numSysTick == 2)
-      _sim.GetSysTick(true).SysTickSetCallback(nullptr, nullptr);
+    if (madvise(_buf, _mapLen, MADV_DONTNEED) < 0)
+      return -errno;
+
+    _watches.NotifyWrite(_base, _len);
+
+    return 0;
   }
+#endif
 
-  // Waits for an interrupt condition. Returns immediately if the simulator
-  // already has an exception which it can (but for the fact that PRIMASK might
-  // be set) take immediately. Otherwise, returns whenever an exception next
-  // occurs, which could be SysTick, or a call to TriggerNMI or TriggerExtInt
-  // on this class.
-  void WaitForInterrupt() {
-    std::unique_lock lk{_m};
+  /* IDevice {{{3
+   * -------
+   */
+  int Load(phys_t addr, int size, uint32_t flags, uint32_t &v) override {
+    if (!(_perms & (HOST_REGION__READ | HOST_REGION__EXEC)) || addr - _base >= _len || uint32_t(size) > _len - (addr - _base))
+      return 1;
 
-    for (;;) {
-      if (_sim.IsExceptionPending(/*ignorePrimask=*/true))
-        return;
+    v = 0;
+    memcpy(&v, _buf + (addr - _base), size);
+    TRACE("L%2d 0x%08x -> 0x%x\n", size, addr, v);
+    return 0;
+  }
 
-      _cv.wait(lk);
-    }
+  int Store(phys_t addr, int size, uint32_t flags, uint32_t v) override {
+    if (!(_perms & HOST_REGION__WRITE) || addr - _base >= _len || uint32_t(size) > _len - (addr - _base))
+      return 1;
+
+    memcpy(_buf + (addr - _base), &v, size);
+    _dirty.Mark(_buf + (addr - _base), size);
+    TRACE("S%2d 0x%08x <- 0x%x\n", size, addr, v);
+    return 0;
   }
 
-  // Inject an NMI. Unlike the equivalent method on Sim, can be called from any
-  // thread.
-  void TriggerNMI() {
-    std::unique_lock lk{_m};
-    _sim.TriggerNMI();
-    _XWakeupEvent();
+  int LoadBurst(phys_t addr, int count, uint32_t flags, uint32_t *v) override {
+    if (!(_perms & (HOST_REGION__READ | HOST_REGION__EXEC)) || addr - _base >= _len)
+      return 0;
+
+    int n = int(std::min<uint32_t>(count, (_len - (addr - _base))/4));
+    memcpy(v, _buf + (addr - _base), 4*n);
+    return n;
   }
 
-  // Inject an external interrupt. Unlike the equivalent method on Sim,
-  // can be called from any thread.
-  void TriggerExtInt(uint32_t intrNo, bool setNotClear=true) {
-    std::unique_lock lk{_m};
-    _sim.TriggerExtInt(intrNo, setNotClear);
-    if (setNotClear)
-      _XWakeupEvent();
+  int StoreBurst(phys_t addr, int count, uint32_t flags, const uint32_t *v) override {
+    if (!(_perms & HOST_REGION__WRITE) || addr - _base >= _len)
+      return 0;
+
+    int n = int(std::min<uint32_t>(count, (_len - (addr - _base))/4));
+    memcpy(_buf + (addr - _base), v, 4*n);
+    if (n)
+      _dirty.Mark(_buf + (addr - _base), 4*n);
+    return n;
   }
 
-  // Trigger a generic WFI wakeup event. This is useful for waking up from WFI
-  // in the event of a non-interrupt wakeup event (e.g. reset, implementation
-  // defined wakeup events, etc.)
-  // May be called from any thread.
-  void WakeupEvent() {
-    std::unique_lock lk{_m};
-    _XWakeupEvent();
+  // Accesses made directly by the simulator are not traced.
+  void GetHostRegions(std::vector<HostRegion> &regions) override {
+    if (!EMU_TRACE)
+      regions.push_back({_base, _len, _buf, _perms, &_dirty, &_watches});
   }
 
-  // Accesses a mutex which can be used to synchronize access to Simulator.
-  std::mutex &GetMutex() { return _m; }
+  void AttachCodeWatch(CodeWatch *cw) override {
+    _watches.Attach(cw);
+  }
 
-private:
-  void _XWakeupEvent() { // can be called on any thread, must hold lock
-    _cv.notify_all();
+  void DetachCodeWatch(CodeWatch *cw) override {
+    _watches.Detach(cw);
   }
 
-  // Called on SysTick callback thread only.
-  void _TCallback(bool ns) {
-    std::unique_lock lk{_m};
-    _XWakeupEvent();
+  void NotifyStore(phys_t addr, uint32_t len, const CodeWatch *writer) override {
+    _watches.NotifyWrite(addr, len, writer);
   }
 
 private:
-  Sim &_sim;
-  std::mutex              _m;
-  std::condition_variable _cv;
-};
+  phys_t                  _base;
+  uint32_t                _len;
+  uint32_t                _perms;     // HOST_REGION__*
+  size_t                  _mapLen;    // _len rounded up to the host page size.
+  uint8_t                *_buf;
+  DirtyMap                _dirty;
+  int                     _snapFd = -1;
+  CodeWatchList           _watches;
 
-/* Internal Helpers: MonitorState {{{2
- * ==============================
- */
-template<typename T>
-static inline T SatSub(T x, T y) {
-  T r;
-  if (__builtin_sub_overflow(x, y, &r))
-    return std::numeric_limits<T>::min();
-  else
-    return r;
-}
+  static size_t _RoundToPage(size_t len) {
+    size_t pageSize = sysconf(_SC_PAGESIZE);
+    return (len + pageSize - 1) & ~(pageSize - 1);
+  }
 
-template<typename T>
-static inline T SatAdd(T x, T y) {
-  T r;
-  if (__builtin_add_overflow(x, y, &r))
-    return std::numeric_limits<T>::max();
-  else
-    return r;
-}
+  static uint8_t *_MapAnonymous(size_t len) {
+    void *p = mmap(nullptr, len, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED)
+      throw std::bad_alloc();
 
-struct MonitorState {
-  bool ContainsAny(phys_t a, uint32_t sz) {
-    ASSERT(sz);
-    return size && a >= SatSub<phys_t>(addr, sz-1) && a <= SatAdd<phys_t>(addr, size-1);
+    return static_cast<uint8_t *>(p);
   }
 
-  bool ContainsAll(phys_t a, uint32_t sz) {
-    ASSERT(sz);
-    return size && a >= addr && SatAdd<phys_t>(a, sz-1) <= SatAdd<phys_t>(addr, size-1);
+  static int _CloseWithError(int fd) {
+    int err = errno;
+    close(fd);
+    return -err;
   }
+};
+#endif
 
-  template<typename Visitor>
-  void Visit(Visitor &v) {
-    v SZ_FIELD(addr) SZ_FIELD(size);
-  }
+/* ExecEngine {{{2
+ * ----------
+ * Selects how Simulator::TopLevel executes instructions.
+ */
+enum ExecEngine {
+  // Fetch, decode and execute one instruction per call to TopLevel, exactly as
+  // described by the pseudocode. This is the reference implementation.
+  ExecEngine_Interp,
+  // Execute recorded basic blocks, checking for interrupts only at block
+  // boundaries. See "Block Engine" below.
+  ExecEngine_Block,
+  // As for ExecEngine_Block, but frequently run blocks are translated to
+  // native code. See "JIT" below.
+  ExecEngine_JIT,
+  // As for ExecEngine_Block, but blocks are run as threaded code. See
+  // _RunBlockThreaded.
+  ExecEngine_Threaded,
+};
 
-  phys_t    addr{};
-  uint32_t  size{}; // zero: open access state, nonzero: exclusive access state
+#if JIT_SUPPORTED
+/* X64Emitter {{{2
+ * ----------
+ * Minimal x86-64 machine code emitter used by ExecEngine_JIT. Only the handful
+ * of instruction forms the JIT needs are provided. Registers are given by
+ * their encoding number (EAX=0, ECX=1, EDX=2, EBX=3, ESI=6, EDI=7), and
+ * memory operands are always [RBX+disp32].
+ */
+struct X64Emitter {
+  enum :uint8_t { EAX=0, ECX=1, EDX=2, EBX=3, ESI=6, EDI=7 };
+
+  // Condition codes for Setcc.
+  enum :uint8_t { CC_O=0x0, CC_B=0x2, CC_AE=0x3, CC_E=0x4, CC_S=0x8 };
+
+  // ALU operations, given as the opcode of "op r/m32, r32". The opcode of
+  // "op EAX, imm32" is this plus 4.
+  enum :uint8_t { OP_ADD=0x01, OP_OR=0x09, OP_AND=0x21, OP_SUB=0x29, OP_XOR=0x31, OP_CMP=0x39 };
+
+  explicit X64Emitter(uint8_t *p) :p(p) {}
+
+  void Byte(uint8_t x) { *p++ = x; }
+  void Imm32(uint32_t x) { memcpy(p, &x, 4); p += 4; }
+  void Imm64(uint64_t x) { memcpy(p, &x, 8); p += 8; }
+
+  void PushRBX() { Byte(0x53); }
+  void PopRBX() { Byte(0x5B); }
+  void Ret() { Byte(0xC3); }
+
+  // MOV r64, imm64 (r in RAX..RDI, or R8 if r8).
+  void MovImm64(uint8_t r, uint64_t x, bool r8=false) { Byte(r8 ? 0x49 : 0x48); Byte(0xB8+r); Imm64(x); }
+  // MOV r32, imm32
+  void MovImm32(uint8_t r, uint32_t x) { Byte(0xB8+r); Imm32(x); }
+  // MOV RDI, RBX
+  void MovRDIRBX() { Byte(0x48); Byte(0x89); Byte(0xDF); }
+  // CALL RAX
+  void CallRAX() { Byte(0xFF); Byte(0xD0); }
+  // TEST EAX, EAX
+  void TestEAX() { Byte(0x85); Byte(0xC0); }
+  // JZ rel8
+  void JzRel8(int8_t rel) { Byte(0x74); Byte(uint8_t(rel)); }
+
+  // MOV r32, [RBX+disp]
+  void Load(uint8_t r, int32_t disp) { Byte(0x8B); Byte(0x83 | (r<<3)); Imm32(disp); }
+  // MOV [RBX+disp], r32
+  void Store(int32_t disp, uint8_t r) { Byte(0x89); Byte(0x83 | (r<<3)); Imm32(disp); }
+  // op EAX, ECX
+  void AluRR(uint8_t op) { Byte(op); Byte(0xC8); }
+  // op EAX, imm32
+  void AluImm(uint8_t op, uint32_t x) { Byte(op+4); Imm32(x); }
+  // AND/OR dword [RBX+disp], imm32
+  void AndMem(int32_t disp, uint32_t x) { Byte(0x81); Byte(0xA3); Imm32(disp); Imm32(x); }
+  void OrMem(int32_t disp, uint32_t x) { Byte(0x81); Byte(0x8B); Imm32(disp); Imm32(x); }
+  // AND r32, imm32
+  void AndImm(uint8_t r, uint32_t x) { Byte(0x81); Byte(0xE0 | r); Imm32(x); }
+  // OR r32, r32
+  void Or(uint8_t dst, uint8_t src) { Byte(0x09); Byte(0xC0 | (src<<3) | dst); }
+  // SHL r32, imm8
+  void Shl(uint8_t r, uint8_t n) { Byte(0xC1); Byte(0xE0 | r); Byte(n); }
+  // SETcc r8 (REX is always emitted so that r=ESI/EDI select SIL/DIL)
+  void Setcc(uint8_t cc, uint8_t r) { Byte(0x40); Byte(0x0F); Byte(0x90 | cc); Byte(0xC0 | r); }
+  // MOVZX r32, r8 (low byte of the same register)
+  void Movzx8(uint8_t r) { Byte(0x40); Byte(0x0F); Byte(0xB6); Byte(0xC0 | (r<<3) | r); }
+
+  uint8_t *p;
 };
+#endif
 
-/* GlobalMonitor {{{2
- * =============
- * Implements an ARMv8-M global monitor to be shared between PEs.
- *
- * ALL methods of this class are non-thread-safe and require locking the mutex
- * by calling Lock() and holding the std::unique_lock returned by it, before
- * attempting to use any other method of this class. This locking is done
- * outside of GlobalMonitor to provide flexibility in usage patterns (e.g.,
- * calling IsExclusive followed by ClearExclusiveByAddress while processing a
- * STREX, which must be done atomically).
+/* SimpleSimulatorConfig {{{2
+ * --------------------
+ * SimpleSimulatorConfig implements the SimulatorConfig concept. Any object can
+ * be used so long as it can be copied and it supports the methods shown below.
  *
- * For simplicity the mutex used is a recursive mutex, so nested Lock calls can
- * be made. This simplifies our simulator code.
- * 
- * TODO § B7.3 R_HLHS: If the global monitor is not implemented for an address
- * range or memory type: ... (BusFault, etc.)
+ * A static implementation with constexpr methods could be used to enable
+ * compile-time removal of branches unrelated to the chosen profile.
  */
-struct GlobalMonitor {
-  using lock_type = std::unique_lock<std::recursive_mutex>;
+struct SimpleSimulatorConfig {
+  constexpr SimpleSimulatorConfig() = default;
 
-  GlobalMonitor(bool checkAddresses=true) :_checkAddresses(checkAddresses) {}
-  ~GlobalMonitor() { Lock(); }
+  template<typename T>
+  constexpr SimpleSimulatorConfig(const T &o) {
+    main            = o.HaveMainExt();
+    security        = o.HaveSecurityExt();
+    fpb             = o.HaveFPB();
+    dwt             = o.HaveDWT();
+    itm             = o.HaveITM();
+    fpExt           = o.HaveFPExt();
+    sysTick         = o.SysTick();
+    haltingDebug    = o.HaveHaltingDebug();
+    dspExt          = o.HaveDSPExt();
+    numMpuRegionS   = o.NumMpuRegionS();
+    numMpuRegionNS  = o.NumMpuRegionNS();
+    numSauRegion    = o.NumSauRegion();
+    maxExc          = o.MaxExc();
+    initialVtor     = o.InitialVtor();
+    isaVersion      = o.IsaVersion();
+    systIntFreq     = o.SystIntFreq();
+    systExtFreq     = o.SystExtFreq();
+    priorityBits    = o.PriorityBits();
+    mmfarBfarMerged = o.MmfarBFarMerged();
+    engine          = o.Engine();
+  }
 
-  lock_type Lock() { return lock_type{_m}; }
+  bool HaveMainExt() const { return this->main; }
+  bool HaveSecurityExt() const { return this->security; }
+  bool HaveFPB() const { return this->fpb; }
+  bool HaveDWT() const { return this->dwt; }
+  bool HaveITM() const { return this->itm; }
+  bool HaveFPExt() const { return this->fpExt; }
+  int SysTick() const { return this->sysTick; }
+  bool HaveHaltingDebug() const { return this->haltingDebug; }
+  bool HaveDSPExt() const { return this->dspExt; }
+  uint8_t NumMpuRegionS() const { return this->numMpuRegionS; }
+  uint8_t NumMpuRegionNS() const { return this->numMpuRegionNS; }
+  uint8_t NumSauRegion() const { return this->numSauRegion; }
+  int MaxExc() const { return this->maxExc; }
+  uint32_t InitialVtor() const { return this->initialVtor; }
+  int IsaVersion() const { return this->isaVersion; }
+  uint64_t SystIntFreq() const { return this->systIntFreq; }
+  uint64_t SystExtFreq() const { return this->systExtFreq; }
+  uint8_t PriorityBits() const { return this->priorityBits; }
+  bool MmfarBfarMerged() const { return this->mmfarBfarMerged; }
+  ExecEngine Engine() const { return this->engine; }
 
-  // Mark a range covering at least [addr, addr+size) as belonging to the
-  // specified PE.
-  void MarkExclusive(phys_t addr, int procID, uint32_t size) {
-    auto &s = _states[procID];
+  // -----------------------------------------
+  bool      main            = true;         // Whether the simulated CPU supports the Main extension.
+  bool      security        = true;         // Whether the simulated CPU supports the Security extension.
+  bool      fpb             = true;         // Whether the simulated CPU supports the Flash Patch extension.
+  bool      dwt             = true;         // Whether the simulated CPU supports the DWT extension.
+  bool      itm             = true;         // Whether the simulated CPU supports the ITM extension.
+  bool      fpExt           = true;         // Whether the simulated CPU supports the floating point extension.
+  int       sysTick         = 2;            // Whether the simulated CPU supports the SysTick feature. 1=Single, 2=Dual
+  bool      haltingDebug    = true;         // Whether the simulated CPU supports the halting debug feature.
+  bool      dspExt          = false;        // Whether the simulated CPU supports the DSP extension.
+  uint8_t   numMpuRegionS   = NUM_MPU_REGION_S;   // Number of MPU regions supported. 0 for no MPU.
+  uint8_t   numMpuRegionNS  = NUM_MPU_REGION_NS;  // May not exceed NUM_MPU_REGION_{S,NS}.
+  uint8_t   numSauRegion    = NUM_SAU_REGION;     // May not exceed NUM_SAU_REGION. 0 for no SAU.
+  //uint32_t  cpuid           = 0xFFFF'FFFF;// Specifies the value of the CPUID register.
+  int       maxExc          = NUM_EXC-1;    // Maximum number of exceptions supported.
+  uint32_t  initialVtor     = 0;            // Initial VTOR value
+  int       isaVersion      = 8;            // ISA version (7 or 8)
+  uint64_t  systIntFreq     = 100'000'000;  // SysTick frequency when CLKSOURCE=1 (PE).
+  uint64_t  systExtFreq     = 0;            // SysTick frequency when CLKSOURCE=0 (external). 0 to disable.
+  uint8_t   priorityBits    = 8;            // Number of priority bits [3, 8]. Ignored for !main.
+  bool      mmfarBfarMerged = false;        // Are MMFAR, BFAR merged?
+  ExecEngine engine         = ExecEngine_Interp; // Execution engine used by TopLevel.
+};
 
-    // § B7.3.1 R_MPKM: "A Load-Exclusive instruction by one PE has no effect
-    // on the global monitor state for any other PE." We do not call
-    // _ClearExclusiveByAddress here.
+/* CortexMConfigBase {{{2
+ * -----------------
+ */
+struct CortexMConfigBase {
+  constexpr bool HaveSecurityExt() const { return false; }
+  constexpr bool HaveFPExt() const { return false; }
+  constexpr bool HaveDSPExt() const { return false; }
+  constexpr bool HaveHaltingDebug() const { return debug; }
+  constexpr uint8_t NumMpuRegionS() const { return 0; }
+  constexpr uint8_t NumMpuRegionNS() const { return numMpuRegion; }
+  constexpr uint8_t NumSauRegion() const { return 0; }
+  constexpr uint32_t InitialVtor() const { return initialVtor; }
+  constexpr uint64_t SystIntFreq() const { return systIntFreq; }
+  constexpr uint64_t SystExtFreq() const { return systExtFreq; }
+  constexpr bool MmfarBfarMerged() const { return true; }
+  constexpr ExecEngine Engine() const { return engine; }
 
-    s.addr = addr;
-    s.size = size;
-  }
+  bool      debug         = true;
+  bool      dwt           = true;
+  int       sysTick       = 2;
+  uint8_t   numMpuRegion  = NUM_MPU_REGION_NS;
+  int       maxExc        = NUM_EXC-1;
+  uint32_t  initialVtor   = 0;
+  uint64_t  systIntFreq   = 100'000'000;
+  uint64_t  systExtFreq   = 0;
+  ExecEngine engine       = ExecEngine_Interp;
+};
 
-  // Clear global exclusive monitor for all PEs except the one specified.
-  void ClearExclusiveByAddress(phys_t addr, int exceptProcID, uint32_t size) {
-    for (auto &x :_states)
-      if (x.first != exceptProcID && x.second.ContainsAny(addr, size))
-        x.second.size = 0;
-  }
+/* CortexM0pConfig {{{2
+ * ---------------
+ */
+struct CortexM0pConfig :CortexMConfigBase {
+  constexpr bool HaveMainExt() const { return false; }
+  constexpr int IsaVersion() const { return 6; }
+  constexpr int SysTick() const { return sysTick > 1 ? 1 : sysTick; }
+  constexpr uint8_t PriorityBits() const { return 2; }
+  constexpr int MaxExc() const { return maxExc > 48 ? 48 : maxExc; }
+  constexpr bool HaveFPB() const { return false; }
+  constexpr bool HaveDWT() const { return debug && dwt; }
+  constexpr bool HaveITM() const { return false; }
+};
 
-  // Is there a global record for an extent of address space covering at least
-  // [addr, addr+size) marked as belong to the specified PE?
-  bool IsExclusive(phys_t addr, int procID, uint32_t size) {
-    auto &s = _states[procID];
+/* CortexM3M4ConfigBase {{{2
+ * --------------------
+ */
+struct CortexM3M4ConfigBase :CortexMConfigBase {
+  constexpr bool HaveMainExt() const { return true; }
+  constexpr int IsaVersion() { return 7; }
+  constexpr int SysTick() const { return sysTick > 1 ? 1 : sysTick; }
+  constexpr uint8_t PriorityBits() const { return priorityBits < 3 ? 3 : priorityBits; }
+  constexpr int MaxExc() const { return maxExc > 255 ? 255 : maxExc; }
+  constexpr bool HaveFPB() const { return debug && fpb; }
+  constexpr bool HaveDWT() const { return debug && (dwt || itm); }
+  constexpr bool HaveITM() const { return itm; }
 
-    // § B7.3.1 R_MFGC: [...] "If no address is marked as exclusive access for
-    // the requesting PE, the store does not succeed."
-    if (!s.size)
-      return false;
+  bool      fpb           = true;
+  bool      itm           = true;
+  uint8_t   priorityBits  = 8;
+};
 
-    // "If the address accessed is marked for exclusive access in the global
-    // monitor state machine for any other PE than that state machine
-    // transitions to Open Access state."
-    // This is handled automatically in MemA_with_priv_security; successful
-    // stores call ClearExclusiveByAddress on shareable memory (i.e., on memory
-    // where the global monitor, i.e. this method, was consulted).
+/* CortexM3Config {{{2
+ * --------------
+ */
+struct CortexM3Config :CortexM3M4ConfigBase {
+};
 
-    // § B7.3.1 R_MFGC: [...] "If a different physical address is marked as
-    // exclusive access for the requesting PE, it is implementation defined
-    // whether the store succeeds or not."
-    if (!_checkAddresses)
-      return true;
+/* CortexM4Config {{{2
+ * --------------
+ */
+struct CortexM4Config :CortexM3M4ConfigBase {
+  constexpr bool HaveFPExt() const { return fpExt; }
+  constexpr bool HaveDSPExt() const { return dspExt; }
 
-    // § B7.3.1 R_MFGC: [...] "The store is guaranteed to succeed only if
-    // the physical address accessed is marked as exclusive access for the
-    // requesting PE and both the local monitor and the global monitor state
-    // machines for the requesting PE are in the exclusive access state."
-    return s.ContainsAll(addr, size);
-  }
+  bool      fpExt         = false;
+  bool      dspExt        = false;
+};
 
-  template<typename Visitor>
-  void Visit(Visitor &v) {
-    v("states", _states);
-  }
+/* CortexM23Config {{{2
+ * ---------------
+ */
+struct CortexM23Config :CortexMConfigBase {
+  constexpr bool HaveMainExt() const { return false; }
+  constexpr bool HaveSecurityExt() const { return security; }
+  constexpr int IsaVersion() { return 8; }
+  constexpr int SysTick() const { return (sysTick > 1 && !HaveSecurityExt()) ? 1 : sysTick; }
+  constexpr uint8_t PriorityBits() const { return 2; }
+  constexpr int MaxExc() const { return maxExc > 255 ? 255 : maxExc; }
+  constexpr bool HaveFPB() const { return debug && fpb; }
+  constexpr bool HaveDWT() const { return debug && (dwt || itm); }
+  constexpr bool HaveITM() const { return itm; }
 
-private:
-  // We maintain one _State for each processor ID; "only a single outstanding
-  // exclusive access to shareable memory for each PE" is supported by the ISA.
-  // The range represented is [addr, addr+size). If size is zero, this record
-  // is currently invalid, meaning that the entry for that PE is in the "Open
-  // Access" state. If size is nonzero, the entry for that PE is in the
-  // "Exclusive Access" state.
-  std::recursive_mutex                  _m;
-  std::unordered_map<int, MonitorState> _states;
-  bool                                  _checkAddresses;
+  bool      security      = true;
+  bool      fpb           = true;
+  bool      itm           = true;
 };
 
-/* Simulator {{{2
- * =========
+/* CortexM33Config {{{2
+ * ---------------
  */
-template<typename Device=IDevice, typename SimulatorConfig=SimpleSimulatorConfig, typename SysTickDevice=SysTickDevice_Real, typename GlobalMonitor=GlobalMonitor>
-struct Simulator {
-  Simulator(Device &dev, GlobalMonitor &gm, const SimulatorConfig &cfg=SimulatorConfig(), int procID=0) :_dev(dev), _cfg(cfg), _procID(procID), _lm(IMPL_DEF_LOCAL_MON_CHECK_ADDR), _gm(gm) {
-    ASSERT(cfg.MaxExc() < NUM_EXC);
-    ASSERT(cfg.MaxExc() <= _MaxExceptionNum());
+struct CortexM33Config :CortexMConfigBase {
+  constexpr bool HaveMainExt() const { return true; }
+  constexpr bool HaveSecurityExt() const { return security; }
+  constexpr int IsaVersion() { return 8; }
+  constexpr int SysTick() const { return (sysTick > 1 && !HaveSecurityExt()) ? 1 : sysTick; }
+  constexpr uint8_t PriorityBits() const { return priorityBits < 3 ? 3 : priorityBits; }
+  constexpr int MaxExc() const { return maxExc > 496 ? 496 : maxExc; }
+  constexpr bool HaveFPB() const { return debug && fpb; }
+  constexpr bool HaveDWT() const { return debug && (dwt || itm); }
+  constexpr bool HaveITM() const { return itm; }
+  constexpr bool HaveFPExt() const { return fpExt; }
+  constexpr bool HaveDSPExt() const { return dspExt; }
 
-    ASSERT(cfg.IsaVersion() >= 7 && cfg.IsaVersion() <= 8);
-    if (_HaveSecurityExt())
-      ASSERT(cfg.IsaVersion() >= 8);
+  bool      security      = true;
+  bool      fpb           = true;
+  bool      itm           = true;
+  uint8_t   priorityBits  = 8;
+  bool      fpExt         = false;
+  bool      dspExt        = false;
+};
 
-    if (_HaveMainExt()) {
-      if (_HaveSecurityExt())
-        ASSERT(cfg.SysTick() == 2);
-      else
-        ASSERT(cfg.SysTick() == 1);
-    }
+/* DeadlineCaller {{{2
+ * ==============
+ * Simple utility class which calls a specified callback on another thread at a
+ * specified deadline.
+ */
+struct DeadlineCaller {
+  using time_point = std::chrono::steady_clock::time_point;
 
-    ASSERT(cfg.NumMpuRegionS() <= NUM_MPU_REGION_S);
-    ASSERT(cfg.NumMpuRegionNS() <= NUM_MPU_REGION_NS);
-    ASSERT(cfg.NumSauRegion() <= NUM_SAU_REGION);
+  DeadlineCaller() {}
 
-    _ColdReset();
+  // Can be safely destroyed at any time. Any callback will be cancelled.
+  ~DeadlineCaller() {
+    {
+      std::unique_lock lk{_m};
+      _teardown = true;
+      _cb       = nullptr;
+    }
+    _cv.notify_all();
+    if (_t.joinable())
+      _t.join();
   }
 
-  /* Public Functions {{{3
-   * ================
-   */
-
-  /* TopLevel {{{4
-   * --------
-   * Steps the core by one iteration, (potentially) executing one instruction.
+  /* Start {{{3
+   * -----
+   * Set a new deadline. If there is an existing deadline pending it is
+   * cancelled. The function f will be called at or after the deadline and will
+   * be passed the opaque value arg. Passing a default-constructed time_point
+   * or a null f has the same effect as calling stop.
    */
-  void TopLevel() { _TopLevel(); }
+  void Start(time_point deadline, void (*f)(void *arg), void *arg) {
+    if (!deadline.time_since_epoch().count() || !f) {
+      Stop();
+      return;
+    }
 
-  /* ColdReset {{{4
-   * ---------
-   * Performs a cold reset of the core.
-   */
-  void ColdReset() { _ColdReset(); }
+    _EnsureThread();
 
-  /* IsLockedUp {{{4
-   * ----------
-   * Returns true iff the core is in locked up state.
-   */
-  bool IsLockedUp() {
-    return GETBITSM(InternalLoad32(REG_DHCSR), REG_DHCSR__S_LOCKUP);
+    {
+      std::unique_lock lk{_m};
+      _deadline = deadline;
+      _cb       = f;
+      _cbArg    = arg;
+    }
+    _cv.notify_all();
   }
 
-#if 0
-  /* IsHalted {{{4
-   * --------
-   * Returns true iff the core is in the halted (debug) state.
+  /* Stop {{{3
+   * ----
+   * Cancel any existing deadline, if any.
    */
-  bool IsHalted() const {
-    return GETBITSM(InternalLoad32(REG_DHCSR), REG_DHCSR__S_HALT);
+  void Stop() {
+    std::unique_lock lk{_m};
+    _cb = nullptr;
   }
-#endif
-
-  /* GetExitCause {{{4
-   * ------------
-   * After each return from TopLevel, which processes (at most) one
-   * instruction, the exit cause value is set to one of EXIT_CAUSE__*, which
-   * indicates whether the last instruction processed was an "interesting"
-   * instruction; that is, an instruction which may be grounds for changing the
-   * control flow of the loop calling TopLevel() (e.g., WFI, WFE). If the
-   * last instruction executed was not "interesting", this is set to zero.
-   */
-  uint32_t GetExitCause() const { return _s.exitCause; }
 
-  /* GetLastInstruction {{{4
-   * ------------------
-   * Returns the encoding of the last executed instruction. The second return
-   * value is the length of the instruction in bytes. If the core is locked up,
-   * returns {0, 0}.
-   */
-  std::tuple<uint32_t, int> GetLastInstruction() const { return {_s.thisInstr, _s.thisInstrLength}; }
+private:
+  void _EnsureThread() {
+    if (_t.joinable())
+      return;
 
-  /* TriggerNMI {{{4
-   * ----------
-   * Externally trigger an NMI exception as pending.
-   */
-  void TriggerNMI() {
-    _SetPending(NMI, true, true);
+    _t = std::thread{[this]() { _TMain(); }};
   }
 
-  /* TriggerExtInt {{{4
-   * -------------
-   * Externally trigger (or untrigger) an external interrupt. intrNo is the
-   * external interrupt number; 16 will be added to it to get the exception
-   * number, so this numbering starts at zero, not 16.
+  /* _TMain {{{3
+   * ------
    */
-  void TriggerExtInt(uint32_t intrNo, bool setNotClear=true) {
-    ASSERT(16+intrNo < _cfg.MaxExc());
-    _SetPending(16+intrNo, true, setNotClear);
-  }
+  void _TMain() {
+    std::unique_lock lk{_m};
+    for (;;) {
+      if (_teardown)
+        break;
 
-  /* DebugLoad {{{4
-   * ---------
-   * Performs a debug load from the simulated core's memory map, similar to an
-   * access performed via a Cortex-M debug D-AHB slave as might be typically
-   * used over JTAG.
-   *
-   * size:  1, 2 or 4. Width of transfer in bytes.
-   * hprot: Value of HPROT[0:6] as it would appear on an AHB-Lite bus. Bit 6
-   *   should be set for Non-Secure transfers and cleared for Secure transfers.
-   *   The result is placed in the low bits of v. Accesses are always little
-   *   endian and must be aligned. Returns nonzero on bus error.
-   */
-  int DebugLoad(phys_t addr, int size, uint32_t hprot, uint32_t &v) {
-    ASSERT(size == 4 || size == 2 || size == 1);
-    if (addr % size)
-      return -1;
+      if (_cb)
+        _cv.wait_until(lk, _deadline);
+      else
+        _cv.wait(lk);
 
-    AddressDescriptor ad{};
-    ad.memAttrs.ns      = !!(hprot & BIT(6));
-    ad.physAddr         = addr;
-    ad.accAttrs.isPriv  = true;
-    ad.accAttrs.accType = AccType_NORMAL;
+      if (_cb && std::chrono::steady_clock::now() >= _deadline) {
+        auto cb    = _cb;
+        auto cbArg = _cbArg;
+        _cb = nullptr;
+        lk.unlock();
+        cb(cbArg);
+        lk.lock();
+      }
+    }
+  } // }}}3
 
-    return _Load(ad, size, v);
-  }
+private:
+  std::mutex                  _m;
+  std::condition_variable_any _cv;                // protected by _m
+  time_point                  _deadline;          //
+  bool                        _teardown{};        //
+  void                      (*_cb)(void *arg){};  //
+  void                       *_cbArg;             //
+  std::thread                 _t;
+};
 
-  /* DebugStore {{{4
-   * ----------
-   * Performs a debug store to the simulated core's memory map, similar to an
-   * access performed via a Cortex-M debug D-AHB slave as might be typically
-   * used over JTAG. See DebugLoad for arguments. Returns nonzero on bus error.
+/* ISysTickDevice {{{2
+ * ==============
+ * ISysTickDevice implements the SysTickDevice concept.
+ */
+struct ISysTickDevice {
+  /* SysTickSetConfig {{{3
+   * ----------------
+   * Called whenever the configuration of a SysTick timer is updated; whenever
+   * the CSR, RVR or CVR is written. freq is in Hz. tickInt is the value of
+   * REG_SYST_CSR__TICKINT. The reload value is updated to the given value
+   * which must be in range [0, 2**24-1]. If curValue is -1, it is not updated,
+   * else it is set to the given value.
    */
-  int DebugStore(phys_t addr, int size, uint32_t hprot, uint32_t v) {
-    ASSERT(size == 4 || size == 2 || size == 1);
-    if (addr % size)
-      return -1;
-
-    AddressDescriptor ad{};
-    ad.memAttrs.ns      = !!(hprot & BIT(6));
-    ad.physAddr         = addr;
-    ad.accAttrs.isPriv  = true;
-    ad.accAttrs.accType = AccType_NORMAL;
-
-    return _Store(ad, size, v);
-  }
+  virtual void SysTickSetConfig(bool enable, bool tickInt, uint64_t freq, uint32_t reloadValue, int curValue) = 0;
 
-  /* GetCpuState {{{4
-   * -----------
+  /* SysTickGetConfig {{{3
+   * ----------------
+   * Retrieves {enable, tickInt, freq, reloadValue}.
    */
-  CpuState &GetCpuState() { return _s; }
+  virtual std::tuple<bool, bool, uint64_t, uint32_t> SysTickGetConfig() = 0;
 
-  /* GetCpuNest {{{4
-   * ----------
+  /* SysTickGetCurrent {{{3
+   * -----------------
+   * Gets the current value of the timer. The value must be less than 2**24.
+   * The value counts down.
    */
-  CpuNest &GetCpuNest() { return _n; }
+  virtual uint32_t SysTickGetCurrent() = 0;
 
-  /* Visit {{{4
-   * -----
-   * Visit state objects contained in this simulator.
+  /* SysTickGetCountFlag {{{3
+   * -------------------
+   * Gets and optionally clears the count flag.
    */
-  template<typename Visitor>
-  void Visit(Visitor &v) {
-    v("cpu", _s)
-     ("nest", _n)
-     ("cfg", _cfg)
-     ("procID", _procID)
-     ("lm", _lm)
-     ("gm", _gm);
-    if (GetNumSysTick())
-      v("systick", _sysTickS);
-    if (GetNumSysTick() > 1)
-      v("systickNS", _sysTickNS);
-  }
+  virtual bool SysTickGetCountFlag(bool clear) = 0;
 
-  /* GetNumSysTick {{{4
-   * -------------
-   * Returns the number of SysTick timers implemented. Return value is in range
-   * [0,2].
+  /* SysTickGetIntrFlag {{{3
+   * ------------------
+   * Gets and optionally clears the interrupt pending flag. tickInt must have been enabled.
    */
-  int GetNumSysTick() { return _HaveSysTick(); }
+  virtual bool SysTickGetIntrFlag(bool clear) = 0;
 
-  /* GetSysTick {{{4
-   * ----------
-   * Retrieves the specified SysTick device. If no SysTick is implemented, or
-   * only one SysTick is implemented and ns is true, the behaviour is
-   * undefined.
+  /* SysTickGetIntrDeadline {{{3
+   * ----------------------
+   * Returns a time on the steady clock before which SysTickGetIntrFlag cannot
+   * return true, assuming the configuration is not changed in the meantime.
+   * Returns time_point::max() if it cannot return true at all. Returning an
+   * earlier time than necessary is permitted but causes SysTickGetIntrFlag to
+   * be called more often. The default returns time_point::min(), so that
+   * implementations which do not override it are polled on every check.
    */
-  SysTickDevice &GetSysTick(bool ns) { return _SystResolve(ns); }
+  virtual std::chrono::steady_clock::time_point SysTickGetIntrDeadline() {
+    return std::chrono::steady_clock::time_point::min();
+  }
 
-  /* IsExceptionPending {{{4
+  /* SysTickSetCallback {{{3
    * ------------------
-   * Determines if an exception is pending to be taken immediately. If
-   * ignorePrimask is true, the value of PRIMASK is ignored; that is, PRIMASK
-   * is treated as though it is zero. Other priority criteria are still
-   * checked. Setting ignorePrimask to true is useful for implementing the WFI
-   * wakeup criterion.
-   */
-  bool IsExceptionPending(bool ignorePrimask) {
-    auto [canTakeExc, _1, _2] = _PendingExceptionDetails(ignorePrimask);
-    return canTakeExc;
-  }
-
-private:
-  /* Memory-Mapped Register Implementation {{{3
-   * =====================================
-   */
-
-  /* _NestReset {{{4
-   * ----------
+   * Sets a callback to be called on an unspecified thread whenever the tick
+   * interrupt occurs. Both tickInt and the timer itself must be enabled. To
+   * disable the callback after enabling it, pass nullptr.
+   *
+   * As a special case, when f is specified as nullptr, the method must only
+   * return once it is guaranteed that no call to the old callback function is
+   * currently taking place or will take place in the future. Changes from one
+   * non-nullptr value of f to another non-nullptr value of f do not require
+   * the implementation to offer this guarantee.
    */
-  void _NestReset() {
-    _n = CpuNest();
+  virtual void SysTickSetCallback(void (*f)(void *arg), void *arg) = 0;
+};
 
-    // REG_DWT_CTRL
-    if (_HaveDWT()) {
-      _n.dwtCtrl = PUTBITSM(REG_DWT_CTRL__NUMCOMP, NUM_DWT_COMP);
-      if (!_HaveMainExt())
-        _n.dwtCtrl |= REG_DWT_CTRL__NOTRCPKT | REG_DWT_CTRL__NOCYCCNT | REG_DWT_CTRL__NOPRFCNT;
-    }
+/* SysTickDevice_Real {{{2
+ * ==================
+ * This is a SysTick emulator which uses real-world time to model the timer. We
+ * use a system monotonic clock for this purpose.
+ *
+ * We implement the emulation as follows. There are two ways of expressing time
+ * used by this implementation: Epoch time and SysTick time. Our internal
+ * representation is Epoch time and we convert to SysTick time whenever queries
+ * are made against us (e.g. when SYST_CVR is read).
+ *
+ * Epoch time denotes time as the amount of time since an epoch. The epoch used
+ * is not the UNIX epoch but the time at which the SysTick emulator was last
+ * reconfigured in a way that affects the process of conversion between Epoch
+ * and SysTick time. The idea is that between any two such reconfiguration
+ * events, there is a fixed, linear (albeit modular) correspondance between
+ * Epoch and SysTick time. This means we don't have to perform any periodic
+ * computations to "maintain" the timer, and we consume no CPU time just
+ * tracking the advancement of time.
+ *
+ * Suppose there are two reconfiguration events C-1 and C-2. The passage of
+ * time might look like this:
+ *
+ *    Time (t) --->
+ *
+ *      C-1                                                    C-2
+ *       |                                                      |
+ *       |                                                      |
+ *      E=t                                                    E=t'
+ *
+ * At C-1 the epoch E is set to the current time t. For any subsequent reading
+ * of t (prior to event C-2) we can thus determine the amount of time which has
+ * passed since C-1. There is a linear albeit modular correspondance between
+ * the current value of (t-E) and the current value of the SysTick timer for
+ * this entire period between C-1 and C-2. The SysTick timer is a down-counter,
+ * therefore this produces a pattern like this:
+ *
+ *         SYST_RVR
+ *            |\    \
+ *            | \    \
+ *            |  \    \
+ *   SYST_CVR |   \    \
+ *            |    \    \
+ *            |-----------
+ *                   t -->
+ *
+ * We represent the number of clock cycles since the current epoch E as an
+ * unsigned 64-bit integer. The fastest Cortex-M, the Cortex-M7, can run at up
+ * to 600 MHz; in this case we would be able to count clock cycles for about
+ * 975 years before facing an overflow.
+ */
+struct SysTickDevice_Real final :ISysTickDevice {
+  void SysTickSetConfig(bool enable, bool tickInt, uint64_t freq, uint32_t reloadValue, int curValue) override {
+    std::unique_lock lk{_m};
 
-    // REG_DWT_FUNCTIONn
-    if (_HaveDWT()) {
-      for (size_t i=0; i<NUM_DWT_COMP; ++i) {
-        uint32_t id;
-        switch (i) {
-          case 0:
-            id = (_n.dwtCtrl & REG_DWT_CTRL__NOCYCCNT) ? 0b01010 /* IA DA DA+V */ : 0b01011 /* CC IA DA DA+V */;
-            break;
-          default:
-            id = 0b11110 /* IA IAL DA DAL DV LDV DA+V */;
-            break;
-        }
-        _n.dwtFunction[i] = PUTBITSM(REG_DWT_FUNCTION__ID, id);
-      }
-    }
+    if (enable != _enable || reloadValue != _reload || freq != _freq || (curValue >= 0 && curValue < BIT(24))) {
+      assert(freq);
 
-    // REG_FP_CTRL
-    _n.fpCtrl =
-        PUTBITSM(REG_FP_CTRL__REV, 1)
-      | PUTBITSM(REG_FP_CTRL__NUM_CODE_LO, GETBITS(NUM_FPB_COMP,0,3))
-      | PUTBITSM(REG_FP_CTRL__NUM_CODE_HI, GETBITS(NUM_FPB_COMP,4,6));
+      // The device has been changed from being enabled to not enabled or vice
+      // versa; or the reload value has been changed; or the frequency has been
+      // changed; or the current value has been set directly. In any case this
+      // means our linear correspondance between Epoch and SysTick time has now
+      // changed, so we need to begin a new epoch.
+      //
+      // Note that the SysTick SYST_CVR register itself clears to zero whenever
+      // it is written, rather than to the written value, but we implement the
+      // setting of arbitrary current values in this class itself.
+      uint32_t newInitialCur = (curValue >= 0 && curValue < BIT(24)) ? curValue : SysTickGetCurrent();
 
-    // REG_FPCCR
-    _n.fpccrS  = REG_FPCCR__S | REG_FPCCR__LSPEN | REG_FPCCR__ASPEN;
-    _n.fpccrNS = REG_FPCCR__ASPEN;
+      _epoch      = std::chrono::steady_clock::now();
+      _enable     = enable;
+      _freq       = freq;
+      _reload     = reloadValue;
+      _initialCur = newInitialCur;
+    }
 
-    // REG_VTOR
-    _n.vtorS  = _cfg.InitialVtor();
-    _n.vtorNS = _cfg.InitialVtor();
+    _tickInt = tickInt;
+    _XUpdateCallback();
   }
 
-  /* NestAccessType {{{4
-   * --------------
-   */
-  enum NestAccessType {
-    NAT_SW,         // Load/store from software running on core
-    NAT_Internal,   // Core's internal logic is accessing register
-    NAT_External,   // JTAG, etc.
-  };
-
-  /* _NestCheckRegDWT {{{4
-   * ----------------
-   */
-  bool _NestCheckRegDWT(NestAccessType nat) {
-    return _HaveDWT() && (nat != NAT_SW || IMPL_DEF_BASELINE_NO_SW_ACCESS_DWT || _HaveMainExt());
+  std::tuple<bool, bool, uint64_t, uint32_t> SysTickGetConfig() override {
+    return {_enable, _tickInt, _freq, _reload};
   }
 
-  /* _NestCheckRegFPB {{{4
-   * ----------------
-   */
-  bool _NestCheckRegFPB(NestAccessType nat) {
-    return _HaveFPB() && (nat != NAT_SW || IMPL_DEF_BASELINE_NO_SW_ACCESS_FPB || _HaveMainExt());
+  uint32_t SysTickGetCurrent() override {
+    auto [cur, _] = _GetCurrentAndEra();
+    return cur;
   }
 
-  /* _NestPrioBits {{{4
-   * -------------
-   */
-  uint8_t _NestPrioBits() {
-    uint8_t numBits;
+  bool SysTickGetCountFlag(bool clear) override {
+    auto [_, era] = _GetCurrentAndEra();
 
-    if (_HaveMainExt()) {
-      numBits = _cfg.PriorityBits();
-      ASSERT(numBits >= 3);
-    } else
-      numBits = 2;
+    bool eraChanged = (_lastCountFlagEra != era);
+    if (clear)
+      _lastCountFlagEra = era;
 
-    return numBits;
+    return eraChanged;
   }
 
-  /* _NestMaskPrio {{{4
-   * -------------
-   */
-  uint8_t _NestMaskPrio(uint8_t m) {
-    return m & BITS((8-_NestPrioBits()),7);
-  }
+  bool SysTickGetIntrFlag(bool clear) override {
+    auto [_, era] = _GetCurrentAndEra();
 
-  /* _NestAccessClassify {{{4
-   * -------------------
-   * {targetNS, targetRAZWI, targetFault}
-   */
-  std::tuple<bool,bool,bool> _NestAccessClassify(phys_t addr, bool isPriv, bool isSecure) {
-    bool isAltSpace = !!(addr & 0x2'0000);
-    uint8_t code =
-      (((uint32_t)isSecure  ) << 2)
-    | (((uint32_t)isPriv    ) << 1)
-    | (((uint32_t)isAltSpace) << 0)
-      ;
+    bool intr = (_lastIntrEra != era);
+    if (clear)
+      _lastIntrEra = era;
 
-    bool targetNS     = false;
-    bool targetRAZWI  = false;
-    bool targetFault  = false;
-    bool isStir       = ((addr & ~0x2'0000U) == 0xE000'EF00);
+    return _tickInt && intr;
+  }
 
-    // RAZ/WI: Read as Zero, Writes Ignored
-    // RES0:   Should be Zero or Preserved (SBZP)
-    //
-    //                                        SE                          !SE
-    //                                        --------------------------  --------------------------
-    // SECURE     PRIV  ACCESS TO 0xE000_xxxx Secure space                Secure space
-    // SECURE     PRIV  ACCESS TO 0xE002_xxxx Non-Secure space            RAZ/WI
-    // SECURE     NPRIV ACCESS TO 0xE000_xxxx BusFault (STIR: Secure sp)  BusFault (STIR: Secure sp)
-    // SECURE     NPRIV ACCESS TO 0xE002_xxxx BusFault                    BusFault
-    // NON-SECURE PRIV  ACCESS TO 0xE000_xxxx Non-Secure space            Secure space
-    // NON-SECURE PRIV  ACCESS TO 0xE002_xxxx RES0                        RAZ/WI
-    // NON-SECURE NPRIV ACCESS TO 0xE000_xxxx BusFault (STIR: NS sp)      BusFault (STIR: Secure sp)
-    // NON-SECURE NPRIV ACCESS TO 0xE002_xxxx BusFault                    BusFault
-    //
-    // INTERNAL         ACCESS TO 0xE000_xxxx Secure space                Secure space
-    // INTERNAL         ACCESS TO 0xE002_xxxx Non-Secure space            UNREACHABLE
+  std::chrono::steady_clock::time_point SysTickGetIntrDeadline() override {
+    if (!_enable || !_tickInt)
+      return time_point::max();
 
-    //       SPA    S=Secure?  P=Privileged?  A=Alt Space?
-    switch (code) {
-      case 0b110: targetNS = false; break;
-      case 0b111: if (_HaveSecurityExt()) targetNS = true; else targetRAZWI = true; break;
-      case 0b100: if (isStir) targetNS = false; else targetFault = true ; break;
-      case 0b101: targetFault = true; break; // ?
-      case 0b010: targetNS = _HaveSecurityExt(); break;
-      case 0b011: targetRAZWI = true; break;
-      case 0b000: if (isStir) targetNS = _HaveSecurityExt(); else targetFault = true; break;
-      case 0b001: targetFault = true; break;
-    }
+    // The era changes when the number of cycles since the epoch reaches this.
+    uint64_t cycles = (_lastIntrEra+1)*(_reload+1) - (_reload - _initialCur);
 
-    return {targetNS, targetRAZWI, targetFault};
+    // Split off whole seconds so that the conversion to nanoseconds cannot
+    // overflow, and round up so the deadline is never early.
+    uint64_t ns = (cycles/_freq)*1'000'000'000 + ((cycles%_freq)*1'000'000'000 + _freq - 1)/_freq;
+    return _epoch + std::chrono::nanoseconds(ns);
   }
 
-  /* _NestLoad32 {{{4
-   * -----------
-   * Returns nonzero for BusFault.
-   */
-  int _NestLoad32(phys_t addr, bool isPriv, bool isSecure, uint32_t &v) {
-    auto [targetNS, targetRAZWI, targetFault] = _NestAccessClassify(addr, isPriv, isSecure);
+  void SysTickSetCallback(void (*f)(void *arg), void *arg) override {
+    std::unique_lock lk{_m};
 
-    if (targetFault)
-      return -1;
+    _cb     = f;
+    _cbArg  = arg;
 
-    if (targetRAZWI)
-      v = 0;
-    else if (targetNS)
-      v = _NestLoad32Actual(addr |  0x2'0000U, NAT_SW);
-    else
-      v = _NestLoad32Actual(addr & ~0x2'0000U, NAT_SW);
+    if (!_cb) {
+      // If we are clearing the callback, ensure that _TCallback()
+      // has not already loaded old values of (_cb, _cbArg) and is about
+      // to call them. When SysTickSetCallback is called with a nullptr cb,
+      // it is guaranteed that no further calls to the old callback will
+      // occur once it returns.
+      std::unique_lock lk2{_mfull};
+      return;
+    }
 
-    return 0;
-  }
+    auto [_, era] = _GetCurrentAndEra();
+    _lastCbEra = era;
 
-  /* _NestLoad32Actual {{{4
-   * -----------------
-   */
-  uint32_t _NestLoad32Actual(phys_t addr, NestAccessType nat) {
-    phys_t baddr    = addr & ~0x2'0000U;
-    bool   isNS     = !!(addr &  0x2'0000U);
-    if (isNS)
-      ASSERT(_HaveSecurityExt());
-
-    switch (addr) {
-      case REG_DWT_CTRL:      return _NestCheckRegDWT(nat) ? _n.dwtCtrl : 0; // Res0
-
-      case REG_DWT_COMP( 0):
-      case REG_DWT_COMP( 1):
-      case REG_DWT_COMP( 2):
-      case REG_DWT_COMP( 3):
-      case REG_DWT_COMP( 4):
-      case REG_DWT_COMP( 5):
-      case REG_DWT_COMP( 6):
-      case REG_DWT_COMP( 7):
-      case REG_DWT_COMP( 8):
-      case REG_DWT_COMP( 9):
-      case REG_DWT_COMP(10):
-      case REG_DWT_COMP(11):
-      case REG_DWT_COMP(12):
-      case REG_DWT_COMP(13):
-      case REG_DWT_COMP(14):
-        return _NestCheckRegDWT(nat) ? _n.dwtComp[(addr - REG_DWT_COMP(0))/16] : 0; // Res0
-
-      case REG_DWT_FUNCTION( 0):
-      case REG_DWT_FUNCTION( 1):
-      case REG_DWT_FUNCTION( 2):
-      case REG_DWT_FUNCTION( 3):
-      case REG_DWT_FUNCTION( 4):
-      case REG_DWT_FUNCTION( 5):
-      case REG_DWT_FUNCTION( 6):
-      case REG_DWT_FUNCTION( 7):
-      case REG_DWT_FUNCTION( 8):
-      case REG_DWT_FUNCTION( 9):
-      case REG_DWT_FUNCTION(10):
-      case REG_DWT_FUNCTION(11):
-      case REG_DWT_FUNCTION(12):
-      case REG_DWT_FUNCTION(13):
-      case REG_DWT_FUNCTION(14):
-        if (_NestCheckRegDWT(nat)) {
-          uint32_t n = (addr - REG_DWT_FUNCTION(0))/16;
-          uint32_t v = _n.dwtFunction[n];
-          if (nat != NAT_Internal)
-            _n.dwtFunction[n] &= ~REG_DWT_FUNCTION__MATCHED;
-          return v;
-        } else
-          return 0; // Res0
-
-      case REG_FP_CTRL:       return _NestCheckRegFPB(nat) ? _n.fpCtrl : 0;
-
-      case REG_CPPWR_S:       return _HaveMainExt() ? _n.cppwrS  : 0;
-      case REG_CPPWR_NS:      return _HaveMainExt() ? _n.cppwrNS : 0;
-
-      case REG_CFSR_S:        return _HaveMainExt() ? _n.cfsrS   : 0;
-      case REG_CFSR_NS:       return _HaveMainExt() ? _n.cfsrNS  : 0;
-      case REG_HFSR_S:        return _HaveMainExt() ? _n.hfsrS   : 0;
-      case REG_HFSR_NS:       return _HaveMainExt() ? _n.hfsrNS  : 0;
-      case REG_DFSR_S:        return _HaveMainExt() || _HaveHaltingDebug() ? _n.dfsrS  : 0;
-      case REG_DFSR_NS:       return _HaveMainExt() || _HaveHaltingDebug() ? _n.dfsrNS : 0;
+    _XUpdateCallback();
+  }
 
-      case REG_MMFAR_S:
-        if (!_HaveMainExt())
-          return 0;
-        if (_cfg.MmfarBfarMerged() && !(_n.cfsrS & REG_CFSR__MMFSR__MMARVALID))
-          return 0;
-        return _n.mmfarS;
-      case REG_MMFAR_NS:
-        if (!_HaveMainExt())
-          return 0;
-        if (_cfg.MmfarBfarMerged() && !(_n.cfsrNS & REG_CFSR__MMFSR__MMARVALID))
-          return 0;
-        return _n.mmfarNS;
+  template<typename Visitor>
+  void Visit(Visitor &v) {
+    v("enable", _enable)
+     ("tickInt", _tickInt)
+     ("freq", _freq)
+     ("reload", _reload)
+     ("initialCur", _initialCur)
+     ("epoch", _epoch)
+     ("lastCountFlagEra", _lastCountFlagEra)
+     ("lastIntrEra", _lastIntrEra)
+     ("lastCbEra", _lastCbEra);
+  }
 
-      case REG_BFAR_S:
-        if (!_HaveMainExt())
-          return 0;
-        if (_cfg.MmfarBfarMerged() && !(_n.cfsrS & REG_CFSR__BFSR__BFARVALID))
-          return 0;
-        return _n.bfarS;
-      case REG_BFAR_NS:
-        if (!_HaveMainExt())
-          return 0;
-        if (_cfg.MmfarBfarMerged() && !(_n.cfsrNS & REG_CFSR__BFSR__BFARVALID))
-          return 0;
-        return _n.bfarNS;
+private:
+  using time_point = std::chrono::steady_clock::time_point;
+  // Functions beginning _X might be called on any thread (i.e., on the thread
+  // driving this object or the callback thread). Functions beginning _T are
+  // called only on our callback thread.
+  //
+  // Retrieve the number of virtual SysTick clock cycles which have occured
+  // since the last epoch. This is determined by _epoch, the current time, and
+  // _freq, our SysTick frequency in Hz. Implemented using fixed point
+  // arithmetic to ensure perfect precision.
+  uint64_t _GetClockCyclesSinceEpoch() {
+    auto now = std::chrono::steady_clock::now();
+    auto d   = _enable ? now - _epoch : decltype(now - _epoch){};
 
-      case REG_SHPR1_S:       return _HaveMainExt() ? _n.shpr1S  : 0;
-      case REG_SHPR1_NS:      return _HaveMainExt() ? _n.shpr1NS : 0;
-      case REG_SHPR2_S:       return _n.shpr2S;
-      case REG_SHPR2_NS:      return _n.shpr2NS;
-      case REG_SHPR3_S:       return _n.shpr3S;
-      case REG_SHPR3_NS:      return _n.shpr3NS;
+    // We temporarily convert to a nanosecond representation here to find the
+    // number of nanoseconds to add to the integral number of seconds. This
+    // limits the duration d to be about 292 years assuming a signed 64-bit
+    // representation.
+    uint64_t ds  = std::chrono::duration_cast<std::chrono::seconds>(d).count(); // integer seconds since epoch
+    uint64_t dns = (std::chrono::duration_cast<std::chrono::nanoseconds>(d) % std::chrono::nanoseconds(1'000'000'000)).count(); // remainder in ns
 
-      case REG_CCR_S:         return (_n.ccrS  & 0b1110000011100011011) | BIT(0) | BIT(9);
-      case REG_CCR_NS:        return (_n.ccrNS & 0b1110000011100011011) | BIT(0) | BIT(9);
+    return ds*_freq + (dns*_freq)/1'000'000'000; // number of clock cycles since epoch
+  }
 
-      case REG_SCR_S:         return _n.scrS;
-      case REG_SCR_NS:        return _n.scrNS;
+  // Retrieve the current value of the current value register, as well as an
+  // era value. The current value counts down from 2**24-1. The era value
+  // increases by one every time the current value wraps, and thus allows us to
+  // determine when to report that the count flag is set.
+  std::tuple<uint32_t, uint64_t> _GetCurrentAndEra() {
+    uint64_t cycles = _GetClockCyclesSinceEpoch() + (_reload - _initialCur);
 
-      case REG_AIRCR_S: {
-        uint32_t v = CHGBITSM(_n.aircrS , REG_AIRCR__VECTKEY, 0xFA05);
-        return v;
-      }
-      case REG_AIRCR_NS: {
-        uint32_t v = CHGBITSM(_n.aircrNS, REG_AIRCR__VECTKEY, 0xFA05);
-        if (_n.aircrS & REG_AIRCR__SYSRESETREQS)
-          v &= ~REG_AIRCR__SYSRESETREQ;
-        v = CHGBITSM(v, REG_AIRCR__BFHFNMINS, GETBITSM(_n.aircrS, REG_AIRCR__BFHFNMINS));
-        return v;
-      }
+    uint32_t cur = _reload - (cycles % (_reload+1));
+    uint64_t era = cycles / (_reload+1);
 
-      case REG_CPACR_S:       return _n.cpacrS;
-      case REG_CPACR_NS:      return _n.cpacrNS;
+    return {cur, era};
+  }
 
-      case REG_NSACR:         return _n.nsacr;
+  // Determine the deadline at which the era will change.
+  time_point _XGetDeadline() { // must hold lock
+    if (!_enable || !_tickInt || !_cb)
+      return {};
 
-      case REG_MPU_TYPE_S:    return PUTBITSM(_NumMpuRegionS(),  REG_MPU_TYPE__DREGION);
-      case REG_MPU_TYPE_NS:   return PUTBITSM(_NumMpuRegionNS(), REG_MPU_TYPE__DREGION);
+    //(era+1)*(_reload+1) - (_reload - _initialCur) = ((DLINE - _epoch) AS seconds)*_freq + (((DLINE - _epoch) AS ns)*_freq)/1'000'000'000;
+    //((era+1)*(_reload+1) - (_reload - _initialCur)) = ((DLINE - epoch) AS seconds)*_freq; // logical
+    //((era+1)*(_reload+1) - (_reload - _initialCur))/_freq = (DLINE - epoch) AS seconds; // logical
+    //FromSeconds(((era+1)*(_reload+1) - (_reload - _initialCur))/_freq) = (DLINE - epoch); // logical
+    //FromSeconds(((era+1)*(_reload+1) - (_reload - _initialCur))/_freq) + epoch = DLINE; // logical
 
-      case REG_MPU_CTRL_S:    return _n.mpuCtrlS;
-      case REG_MPU_CTRL_NS:   return _n.mpuCtrlNS;
+    uint64_t nsSinceEpoch = ((_lastCbEra+1)*(_reload+1) - (_reload - _initialCur))*1'000'000'000/_freq;
 
-      case REG_MPU_RNR_S:     return _n.mpuRnrS;
-      case REG_MPU_RNR_NS:    return _n.mpuRnrNS;
+    return _epoch + std::chrono::nanoseconds(nsSinceEpoch);
+  }
 
-      case REG_MPU_MAIR0_S:   return _n.mpuMair0S;
-      case REG_MPU_MAIR0_NS:  return _n.mpuMair0NS;
-      case REG_MPU_MAIR1_S:   return _n.mpuMair1S;
-      case REG_MPU_MAIR1_NS:  return _n.mpuMair1NS;
+  // Functions beginning _X might be called on any thread (i.e., on the thread
+  // driving this object or the callback thread).
+  void _XUpdateCallback() { // must hold lock
+    _dc.Start(_XGetDeadline(), [](void *arg) { static_cast<SysTickDevice_Real*>(arg)->_TCallback(); }, this);
+  }
 
-      case REG_MPU_RBAR_S:    return _n.mpuRnrS  < _NumMpuRegionS()  ? _n.mpuRbarS [_n.mpuRnrS ] : 0;
-      case REG_MPU_RBAR_A1_S: return _n.mpuRnrS+1< _NumMpuRegionS()  ? _n.mpuRbarS [_n.mpuRnrS+1] : 0;
-      case REG_MPU_RBAR_A2_S: return _n.mpuRnrS+2< _NumMpuRegionS()  ? _n.mpuRbarS [_n.mpuRnrS+2] : 0;
-      case REG_MPU_RBAR_A3_S: return _n.mpuRnrS+3< _NumMpuRegionS()  ? _n.mpuRbarS [_n.mpuRnrS+3] : 0;
-      case REG_MPU_RBAR_NS:   return _n.mpuRnrNS < _NumMpuRegionNS() ? _n.mpuRbarNS[_n.mpuRnrNS ] : 0;
-      case REG_MPU_RBAR_A1_NS:return _n.mpuRnrNS+1<_NumMpuRegionNS() ? _n.mpuRbarNS[_n.mpuRnrNS+1] : 0;
-      case REG_MPU_RBAR_A2_NS:return _n.mpuRnrNS+2<_NumMpuRegionNS() ? _n.mpuRbarNS[_n.mpuRnrNS+2] : 0;
-      case REG_MPU_RBAR_A3_NS:return _n.mpuRnrNS+3<_NumMpuRegionNS() ? _n.mpuRbarNS[_n.mpuRnrNS+3] : 0;
+  // Functions beginning _T are called on our callback thread.
+  void _TCallback() {
+    // Additional lock for the entire _TCallback() call which we do not unlock
+    // during the cb() invocation. This allows us to ensure that a _TCallback()
+    // call is not in progress during a clearing of the callback function
+    // (SysTickSetCallback(nullptr, nullptr)). If SysTickSetCallback(nullptr, nullptr) is in progress
+    // when we start executing _TCallback(), it may have already acquired _m
+    // and will then wait forever for _mfull, so we need to use a deadlock
+    // avoidance algorithm here.
+    std::unique_lock lk2{_mfull, std::defer_lock};
+    std::unique_lock lk {_m,     std::defer_lock};
+    std::lock(lk2, lk);
+    auto cb     = _cb;
+    auto cbArg  = _cbArg;
 
-      case REG_MPU_RLAR_S:    return _n.mpuRnrS  < _NumMpuRegionS()  ? _n.mpuRlarS [_n.mpuRnrS ] : 0;
-      case REG_MPU_RLAR_A1_S: return _n.mpuRnrS+1< _NumMpuRegionS()  ? _n.mpuRlarS [_n.mpuRnrS+1] : 0;
-      case REG_MPU_RLAR_A2_S: return _n.mpuRnrS+2< _NumMpuRegionS()  ? _n.mpuRlarS [_n.mpuRnrS+2] : 0;
-      case REG_MPU_RLAR_A3_S: return _n.mpuRnrS+3< _NumMpuRegionS()  ? _n.mpuRlarS [_n.mpuRnrS+3] : 0;
-      case REG_MPU_RLAR_NS:   return _n.mpuRnrNS < _NumMpuRegionNS() ? _n.mpuRlarNS[_n.mpuRnrNS] : 0;
-      case REG_MPU_RLAR_A1_NS:return _n.mpuRnrNS+1< _NumMpuRegionNS() ? _n.mpuRlarNS[_n.mpuRnrNS+1] : 0;
-      case REG_MPU_RLAR_A2_NS:return _n.mpuRnrNS+2< _NumMpuRegionNS() ? _n.mpuRlarNS[_n.mpuRnrNS+2] : 0;
-      case REG_MPU_RLAR_A3_NS:return _n.mpuRnrNS+3< _NumMpuRegionNS() ? _n.mpuRlarNS[_n.mpuRnrNS+3] : 0;
+    if (cb) {
+      lk.unlock();
+      cb(cbArg);
+      lk.lock();
 
-      case REG_SAU_CTRL:      return _n.sauCtrl;
-      case REG_SAU_TYPE:      return PUTBITSM(_NumSauRegion(), REG_SAU_TYPE__SREGION);
-      case REG_SAU_RNR:       return _n.sauRnr;
-      case REG_SAU_RBAR:      return _n.sauRnr < _NumSauRegion() ? _n.sauRbar[_n.sauRnr] : 0;
-      case REG_SAU_RLAR:      return _n.sauRnr < _NumSauRegion() ? _n.sauRlar[_n.sauRnr] : 0;
+      ++_lastCbEra;
+      _XUpdateCallback();
+    }
+  }
 
-      case REG_SFSR_S:        return _HaveMainExt() ? _n.sfsr : 0;
-      case REG_SFAR_S:        return _HaveMainExt() ? _n.sfar : 0;
+private:
+  // Mutex.
+  std::mutex  _m, _mfull;
 
-      case REG_VTOR_S:        return _n.vtorS;
-      case REG_VTOR_NS:       return _n.vtorNS;
+  // Values updated by SetConfig.
+  bool        _enable{}, _tickInt{};
+  uint64_t    _freq{};
+  uint32_t    _reload{};
+  uint32_t    _initialCur{};
+  time_point  _epoch{};
 
-      case REG_DAUTHCTRL:     return (_HaveMainExt() || _HaveHaltingDebug()) && _HaveSecurityExt() ? _n.dauthCtrl : 0;
+  // Internal data.
+  uint64_t    _lastCountFlagEra{}, _lastIntrEra{}, _lastCbEra{};
 
-      case REG_FPCCR_S:
-        return _n.fpccrS;
+  // Callback handling.
+  DeadlineCaller  _dc;
+  void          (*_cb)(void *arg){};
+  void           *_cbArg{};
+};
 
-      case REG_FPCCR_NS: {
-        uint32_t secureOnlyMask = REG_FPCCR__S | REG_FPCCR__SFRDY | REG_FPCCR__TS | REG_FPCCR__CLRONRETS | REG_FPCCR__LSPENS;
-        if (_n.demcr & REG_DEMCR__SDME)
-          secureOnlyMask |= REG_FPCCR__MONRDY;
-        uint32_t bankedBitsMask = REG_FPCCR__LSPACT | REG_FPCCR__USER | REG_FPCCR__THREAD
-          | REG_FPCCR__MMRDY | REG_FPCCR__SPLIMVIOL | REG_FPCCR__UFRDY | REG_FPCCR__ASPEN;
+/* IntrBox {{{2
+ * =======
+ * An interrupt box is used to manage the delivery of external and NMI
+ * interrupts to the Simulator. SysTick is handled internally by the simulator.
+ *
+ * The Simulator itself is not thread-safe and access to it must be
+ * synchronized. This utility enables easy threaded delivery of external
+ * interrupts and NMI events to the Simulator and allows WFI to be implemented
+ * by a top-level loop.
+ *
+ * When using this class, it is essential that TriggerNMI and TriggerExtInt
+ * always be called using this class and the equivalent methods on the
+ * Simulator class not be called directly, as IntrBox needs to know about these
+ * events so it can cause its WaitForInterrupt method to return. Unlike the
+ * equivalent methods on the simulator class, these methods can be called from
+ * arbitrary threads.
+ *
+ * If you want to access the simulator from multiple threads, you can use the
+ * mutex accessed via the GetMutex() method to synchronize such access.
+ */
+template<typename Sim>
+struct IntrBox {
+  IntrBox(Sim &sim) :_sim(sim) {
+    int numSysTick = _sim.GetNumSysTick();
+    if (numSysTick)
+      _sim.GetSysTick(false).SysTickSetCallback([](void *arg) { static_cast<IntrBox*>(arg)->_TCallback(false); }, this);
+    if (numSysTick == 2)
+      _sim.GetSysTick(true).SysTickSetCallback([](void *arg) { static_cast<IntrBox*>(arg)->_TCallback(true); }, this);
+  }
+
+  ~IntrBox() {
+    std::unique_lock lk{_m};
+
+    int numSysTick = _sim.GetNumSysTick();
+    if (numSysTick)
+      _sim.GetSysTick(false).SysTickSetCallback(nullptr, nullptr);
+    if (numSysTick == 2)
+      _sim.GetSysTick(true).SysTickSetCallback(nullptr, nullptr);
+  }
+
+  // Waits for an interrupt condition. Returns immediately if the simulator
+  // already has an exception which it can (but for the fact that PRIMASK might
+  // be set) take immediately. Otherwise, returns whenever an exception next
+  // occurs, which could be SysTick, or a call to TriggerNMI or TriggerExtInt
+  // on this class.
+  void WaitForInterrupt() {
+    std::unique_lock lk{_m};
+
+    for (;;) {
+      if (_sim.IsExceptionPending(/*ignorePrimask=*/true))
+        return;
+
+      _cv.wait(lk);
+    }
+  }
+
+  // Inject an NMI. Unlike the equivalent method on Sim, can be called from any
+  // thread.
+  void TriggerNMI() {
+    std::unique_lock lk{_m};
+    _sim.TriggerNMI();
+    _XWakeupEvent();
+  }
+
+  // Inject an external interrupt. Unlike the equivalent method on Sim,
+  // can be called from any thread.
+  void TriggerExtInt(uint32_t intrNo, bool setNotClear=true) {
+    std::unique_lock lk{_m};
+    _sim.TriggerExtInt(intrNo, setNotClear);
+    if (setNotClear)
+      _XWakeupEvent();
+  }
+
+  // Trigger a generic WFI wakeup event. This is useful for waking up from WFI
+  // in the event of a non-interrupt wakeup event (e.g. reset, implementation
+  // defined wakeup events, etc.)
+  // May be called from any thread.
+  void WakeupEvent() {
+    std::unique_lock lk{_m};
+    _XWakeupEvent();
+  }
+
+  // Accesses a mutex which can be used to synchronize access to Simulator.
+  std::mutex &GetMutex() { return _m; }
+
+private:
+  void _XWakeupEvent() { // can be called on any thread, must hold lock
+    _cv.notify_all();
+  }
+
+  // Called on SysTick callback thread only.
+  void _TCallback(bool ns) {
+    std::unique_lock lk{_m};
+    _XWakeupEvent();
+  }
+
+private:
+  Sim &_sim;
+  std::mutex              _m;
+  std::condition_variable _cv;
+};
+
+/* Internal Helpers: MonitorState {{{2
+ * ==============================
+ */
+template<typename T>
+static inline T SatSub(T x, T y) {
+  T r;
+  if (__builtin_sub_overflow(x, y, &r))
+    return std::numeric_limits<T>::min();
+  else
+    return r;
+}
+
+template<typename T>
+static inline T SatAdd(T x, T y) {
+  T r;
+  if (__builtin_add_overflow(x, y, &r))
+    return std::numeric_limits<T>::max();
+  else
+    return r;
+}
+
+struct MonitorState {
+  bool ContainsAny(phys_t a, uint32_t sz) {
+    ASSERT(sz);
+    return size && a >= SatSub<phys_t>(addr, sz-1) && a <= SatAdd<phys_t>(addr, size-1);
+  }
+
+  bool ContainsAll(phys_t a, uint32_t sz) {
+    ASSERT(sz);
+    return size && a >= addr && SatAdd<phys_t>(a, sz-1) <= SatAdd<phys_t>(addr, size-1);
+  }
+
+  template<typename Visitor>
+  void Visit(Visitor &v) {
+    v SZ_FIELD(addr) SZ_FIELD(size);
+  }
+
+  phys_t    addr{};
+  uint32_t  size{}; // zero: open access state, nonzero: exclusive access state
+};
+
+/* GlobalMonitor {{{2
+ * =============
+ * Implements an ARMv8-M global monitor to be shared between PEs.
+ *
+ * ALL methods of this class are non-thread-safe and require locking the mutex
+ * by calling Lock() and holding the std::unique_lock returned by it, before
+ * attempting to use any other method of this class. This locking is done
+ * outside of GlobalMonitor to provide flexibility in usage patterns (e.g.,
+ * calling IsExclusive followed by ClearExclusiveByAddress while processing a
+ * STREX, which must be done atomically).
+ *
+ * For simplicity the mutex used is a recursive mutex, so nested Lock calls can
+ * be made. This simplifies our simulator code.
+ * 
+ * TODO § B7.3 R_HLHS: If the global monitor is not implemented for an address
+ * range or memory type: ... (BusFault, etc.)
+ */
+struct GlobalMonitor {
+  using lock_type = std::unique_lock<std::recursive_mutex>;
+
+  GlobalMonitor(bool checkAddresses=true) :_checkAddresses(checkAddresses) {}
+  ~GlobalMonitor() { Lock(); }
+
+  lock_type Lock() { return lock_type{_m}; }
+
+  // Mark a range covering at least [addr, addr+size) as belonging to the
+  // specified PE.
+  void MarkExclusive(phys_t addr, int procID, uint32_t size) {
+    auto &s = _states[procID];
+
+    // § B7.3.1 R_MPKM: "A Load-Exclusive instruction by one PE has no effect
+    // on the global monitor state for any other PE." We do not call
+    // _ClearExclusiveByAddress here.
+
+    s.addr = addr;
+    s.size = size;
+  }
+
+  // Clear global exclusive monitor for all PEs except the one specified.
+  void ClearExclusiveByAddress(phys_t addr, int exceptProcID, uint32_t size) {
+    for (auto &x :_states)
+      if (x.first != exceptProcID && x.second.ContainsAny(addr, size))
+        x.second.size = 0;
+  }
+
+  // Is there a global record for an extent of address space covering at least
+  // [addr, addr+size) marked as belong to the specified PE?
+  bool IsExclusive(phys_t addr, int procID, uint32_t size) {
+    auto &s = _states[procID];
+
+    // § B7.3.1 R_MFGC: [...] "If no address is marked as exclusive access for
+    // the requesting PE, the store does not succeed."
+    if (!s.size)
+      return false;
+
+    // "If the address accessed is marked for exclusive access in the global
+    // monitor state machine for any other PE than that state machine
+    // transitions to Open Access state."
+    // This is handled automatically in MemA_with_priv_security; successful
+    // stores call ClearExclusiveByAddress on shareable memory (i.e., on memory
+    // where the global monitor, i.e. this method, was consulted).
+
+    // § B7.3.1 R_MFGC: [...] "If a different physical address is marked as
+    // exclusive access for the requesting PE, it is implementation defined
+    // whether the store succeeds or not."
+    if (!_checkAddresses)
+      return true;
+
+    // § B7.3.1 R_MFGC: [...] "The store is guaranteed to succeed only if
+    // the physical address accessed is marked as exclusive access for the
+    // requesting PE and both the local monitor and the global monitor state
+    // machines for the requesting PE are in the exclusive access state."
+    return s.ContainsAll(addr, size);
+  }
+
+  template<typename Visitor>
+  void Visit(Visitor &v) {
+    v("states", _states);
+  }
+
+private:
+  // We maintain one _State for each processor ID; "only a single outstanding
+  // exclusive access to shareable memory for each PE" is supported by the ISA.
+  // The range represented is [addr, addr+size). If size is zero, this record
+  // is currently invalid, meaning that the entry for that PE is in the "Open
+  // Access" state. If size is nonzero, the entry for that PE is in the
+  // "Exclusive Access" state.
+  std::recursive_mutex                  _m;
+  std::unordered_map<int, MonitorState> _states;
+  bool                                  _checkAddresses;
+};
+
+/* Simulator {{{2
+ * =========
+ */
+template<typename Device=IDevice, typename SimulatorConfig=SimpleSimulatorConfig, typename SysTickDevice=SysTickDevice_Real, typename GlobalMonitor=GlobalMonitor>
+struct Simulator {
+  Simulator(Device &dev, GlobalMonitor &gm, const SimulatorConfig &cfg=SimulatorConfig(), int procID=0) :_dev(dev), _cfg(cfg), _procID(procID), _lm(IMPL_DEF_LOCAL_MON_CHECK_ADDR), _gm(gm) {
+    ASSERT(cfg.MaxExc() < NUM_EXC);
+    ASSERT(cfg.MaxExc() <= _MaxExceptionNum());
+
+    ASSERT(cfg.IsaVersion() >= 7 && cfg.IsaVersion() <= 8);
+    if (_HaveSecurityExt())
+      ASSERT(cfg.IsaVersion() >= 8);
+
+    if (_HaveMainExt()) {
+      if (_HaveSecurityExt())
+        ASSERT(cfg.SysTick() == 2);
+      else
+        ASSERT(cfg.SysTick() == 1);
+    }
+
+    ASSERT(cfg.NumMpuRegionS() <= NUM_MPU_REGION_S);
+    ASSERT(cfg.NumMpuRegionNS() <= NUM_MPU_REGION_NS);
+    ASSERT(cfg.NumSauRegion() <= NUM_SAU_REGION);
+
+    if constexpr (std::is_base_of_v<IDevice, Device>)
+      _dev.AttachCodeWatch(&_cw);
+
+    _LoadHostRegions();
+    _ColdReset();
+  }
+
+  ~Simulator() {
+    if constexpr (std::is_base_of_v<IDevice, Device>)
+      _dev.DetachCodeWatch(&_cw);
+  }
+
+  /* Public Functions {{{3
+   * ================
+   */
+
+  /* TopLevel {{{4
+   * --------
+   * Steps the core by one iteration, (potentially) executing one instruction.
+   * With ExecEngine_Block or ExecEngine_JIT, an iteration may execute a number
+   * of blocks.
+   * Returns the number of instructions processed.
+   */
+  int TopLevel() {
+    if unlikely (_cw.HasPending())
+      _cw.TakePending([this](phys_t addr, uint32_t len) { _InvalidateCode(addr, len); });
+
+    int n = 1;
+    if (_cfg.Engine() != ExecEngine_Interp)
+      n = _TopLevelBlock();
+    else
+      _TopLevel();
+
+    // Leave xpsr complete for the caller; see CpuState::lazyFlags.
+    _SyncFlags();
+    return n;
+  }
+
+  /* ColdReset {{{4
+   * ---------
+   * Performs a cold reset of the core.
+   */
+  void ColdReset() {
+    InvalidateCaches();
+    _ColdReset();
+  }
+
+  /* InvalidateCaches {{{4
+   * ----------------
+   * Discards all decoded instructions and re-derives any state cached from
+   * CpuState. This must be called after modifying the state returned by
+   * GetCpuState or GetCpuNest, or after the device's host regions change (see
+   * IDevice::GetHostRegions). It may also be called after modifying code
+   * memory other than via the simulator, though reporting the modification
+   * via GetCodeWatch discards only the affected instructions.
+   */
+  void InvalidateCaches() {
+    _SyncFlags();
+    _SyncITSTATE();
+    _UpdateMAIRTables();
+    _LoadHostRegions();
+    _UpdateActiveMap();
+    _InvalidateExcPriorities();
+
+    if constexpr (DECODE_CACHE_SIZE > 0)
+      for (size_t i=0; i<DECODE_CACHE_SIZE; ++i)
+        _dc.entries[i].pc = DI_INVALID_PC;
+
+    _FlushFetchAttrs();
+    _FlushTlb();
+    _FlushBlocks();
+    _cw.Clear();
+  }
+
+  /* CheckDecodeTable {{{4
+   * ----------------
+   * Verifies that every entry of the 16-bit decode table leads to the same
+   * result as the decoder tree, in and out of IT blocks, in both security
+   * states and with APSR.C clear and set. Intended for testing. Returns false
+   * (after printing the first mismatch) if any entry differs. Requires the
+   * decoded instruction cache.
+   */
+  bool CheckDecodeTable() {
+    if constexpr (DECODE_CACHE_SIZE == 0)
+      return true;
+
+    _SyncFlags();
+    uint32_t      xpsr      = _s.xpsr;
+    SecurityState curState  = _s.curState;
+    bool ok = true;
+    for (SecurityState state : {SecurityState_Secure, SecurityState_NonSecure}) {
+      if (state == SecurityState_Secure && !_HaveSecurityExt())
+        continue;
+
+      _s.curState = state;
+      for (bool carry : {false, true}) {
+        _s.xpsr = CHGBITSM(xpsr, XPSR__C, carry);
+        for (uint8_t itstate : {0x00, 0x04, 0x08}) {
+          _PutITSTATE(itstate);
+
+          // Stop before the 32-bit prefixes (0b11101, 0b11110, 0b11111).
+          for (uint32_t instr=0; ok && instr<0xE800; ++instr) {
+            ProbeResult a = _ProbeDecode(&Simulator::_DecodeExecute16, instr);
+            ProbeResult b = _ProbeDecode(_LookUpDecoder16(instr), instr);
+            if (a.exc != b.exc || a.di.handler != b.di.handler
+                || a.di.condOverride != b.di.condOverride || a.di.flags != b.di.flags
+                || memcmp(a.di.ops, b.di.ops, sizeof(a.di.ops))) {
+              printf("decode table mismatch: instr=0x%04x itstate=0x%02x secure=%d carry=%d\n",
+                instr, itstate, state == SecurityState_Secure, carry);
+              ok = false;
+            }
+          }
+        }
+      }
+    }
+
+    _s.curState = curState;
+    _s.xpsr     = xpsr;
+    _SyncITSTATE();
+    _s.curCondOverride = -1;
+    return ok;
+  }
+
+  /* IsLockedUp {{{4
+   * ----------
+   * Returns true iff the core is in locked up state.
+   */
+  bool IsLockedUp() {
+    return GETBITSM(InternalLoad32(REG_DHCSR), REG_DHCSR__S_LOCKUP);
+  }
+
+#if 0
+  /* IsHalted {{{4
+   * --------
+   * Returns true iff the core is in the halted (debug) state.
+   */
+  bool IsHalted() const {
+    return GETBITSM(InternalLoad32(REG_DHCSR), REG_DHCSR__S_HALT);
+  }
+#endif
+
+  /* GetExitCause {{{4
+   * ------------
+   * After each return from TopLevel, which processes (at most) one
+   * instruction (or, with ExecEngine_Block/JIT, one chain of blocks), the exit
+   * cause value is set to one of EXIT_CAUSE__*, which indicates whether the last instruction processed was an "interesting"
+   * instruction; that is, an instruction which may be grounds for changing the
+   * control flow of the loop calling TopLevel() (e.g., WFI, WFE). If the
+   * last instruction executed was not "interesting", this is set to zero.
+   */
+  uint32_t GetExitCause() const { return _s.exitCause; }
+
+  /* GetLastInstruction {{{4
+   * ------------------
+   * Returns the encoding of the last executed instruction. The second return
+   * value is the length of the instruction in bytes. If the core is locked up,
+   * returns {0, 0}.
+   */
+  std::tuple<uint32_t, int> GetLastInstruction() const { return {_s.thisInstr, _s.thisInstrLength}; }
+
+  /* TriggerNMI {{{4
+   * ----------
+   * Externally trigger an NMI exception as pending.
+   */
+  void TriggerNMI() {
+    _SetPending(NMI, true, true);
+  }
+
+  /* TriggerExtInt {{{4
+   * -------------
+   * Externally trigger (or untrigger) an external interrupt. intrNo is the
+   * external interrupt number; 16 will be added to it to get the exception
+   * number, so this numbering starts at zero, not 16.
+   */
+  void TriggerExtInt(uint32_t intrNo, bool setNotClear=true) {
+    ASSERT(16+intrNo < _cfg.MaxExc());
+    _SetPending(16+intrNo, true, setNotClear);
+  }
+
+  /* DebugLoad {{{4
+   * ---------
+   * Performs a debug load from the simulated core's memory map, similar to an
+   * access performed via a Cortex-M debug D-AHB slave as might be typically
+   * used over JTAG.
+   *
+   * size:  1, 2 or 4. Width of transfer in bytes.
+   * hprot: Value of HPROT[0:6] as it would appear on an AHB-Lite bus. Bit 6
+   *   should be set for Non-Secure transfers and cleared for Secure transfers.
+   *   The result is placed in the low bits of v. Accesses are always little
+   *   endian and must be aligned. Returns nonzero on bus error.
+   */
+  int DebugLoad(phys_t addr, int size, uint32_t hprot, uint32_t &v) {
+    ASSERT(size == 4 || size == 2 || size == 1);
+    if (addr % size)
+      return -1;
+
+    AddressDescriptor ad{};
+    ad.memAttrs.ns      = !!(hprot & BIT(6));
+    ad.physAddr         = addr;
+    ad.accAttrs.isPriv  = true;
+    ad.accAttrs.accType = AccType_NORMAL;
+
+    return _Load(ad, size, v);
+  }
+
+  /* DebugStore {{{4
+   * ----------
+   * Performs a debug store to the simulated core's memory map, similar to an
+   * access performed via a Cortex-M debug D-AHB slave as might be typically
+   * used over JTAG. See DebugLoad for arguments. Returns nonzero on bus error.
+   */
+  int DebugStore(phys_t addr, int size, uint32_t hprot, uint32_t v) {
+    ASSERT(size == 4 || size == 2 || size == 1);
+    if (addr % size)
+      return -1;
+
+    AddressDescriptor ad{};
+    ad.memAttrs.ns      = !!(hprot & BIT(6));
+    ad.physAddr         = addr;
+    ad.accAttrs.isPriv  = true;
+    ad.accAttrs.accType = AccType_NORMAL;
+
+    return _Store(ad, size, v);
+  }
+
+  /* DebugLoadBurst {{{4
+   * --------------
+   * Performs count consecutive debug loads of words, as for DebugLoad, using
+   * burst transfers where possible. addr must be word aligned. Returns nonzero
+   * on bus error, in which case the contents of v are UNKNOWN.
+   */
+  int DebugLoadBurst(phys_t addr, int count, uint32_t hprot, uint32_t *v) {
+    if (addr % 4)
+      return -1;
+
+    AddressDescriptor ad{};
+    ad.memAttrs.ns      = !!(hprot & BIT(6));
+    ad.accAttrs.isPriv  = true;
+    ad.accAttrs.accType = AccType_NORMAL;
+
+    for (int done=0; done < count; ) {
+      ad.physAddr = addr + 4*done;
+      int n = std::min(count - done, int(32 - (ad.physAddr & 31))/4);
+      if (_LoadBurst(ad, n, v + done) < n)
+        return -1;
+
+      done += n;
+    }
+
+    return 0;
+  }
+
+  /* DebugStoreBurst {{{4
+   * ---------------
+   * Performs count consecutive debug stores of words, as for DebugStore, using
+   * burst transfers where possible. See DebugLoadBurst for arguments. Returns
+   * nonzero on bus error, in which case some of the words may have been stored.
+   */
+  int DebugStoreBurst(phys_t addr, int count, uint32_t hprot, const uint32_t *v) {
+    if (addr % 4)
+      return -1;
+
+    AddressDescriptor ad{};
+    ad.memAttrs.ns      = !!(hprot & BIT(6));
+    ad.accAttrs.isPriv  = true;
+    ad.accAttrs.accType = AccType_NORMAL;
+
+    for (int done=0; done < count; ) {
+      ad.physAddr = addr + 4*done;
+      int n = std::min(count - done, int(32 - (ad.physAddr & 31))/4);
+      if (_StoreBurst(ad, n, v + done) < n)
+        return -1;
+
+      done += n;
+    }
+
+    return 0;
+  }
+
+  /* GetCodeWatch {{{4
+   * ------------
+   * Memory containing code which is modified other than via the simulator
+   * must be reported to the simulator via NotifyWrite on this object (or by
+   * calling InvalidateCaches).
+   */
+  CodeWatch &GetCodeWatch() { return _cw; }
+
+  /* GetCpuState {{{4
+   * -----------
+   */
+  CpuState &GetCpuState() { _SyncFlags(); return _s; }
+
+  /* GetCpuNest {{{4
+   * ----------
+   */
+  CpuNest &GetCpuNest() { return _n; }
+
+  /* TakeSnapshot {{{4
+   * ------------
+   * Captures the CPU and nest state so that the simulator can be returned to
+   * it by RestoreSnapshot, e.g. to run many tests from the same state after
+   * booting once. Memory is not included; see
+   * MappedMemoryDevice::TakeSnapshot.
+   */
+  struct Snapshot {
+    CpuState  s;
+    CpuNest   n;
+  };
+
+  void TakeSnapshot(Snapshot &snap) {
+    _SyncFlags();
+    snap.s = _s;
+    snap.n = _n;
+  }
+
+  /* RestoreSnapshot {{{4
+   * ---------------
+   * Returns to the state captured by TakeSnapshot. Any exclusive access is
+   * cleared and all cached state is discarded as by InvalidateCaches.
+   */
+  void RestoreSnapshot(const Snapshot &snap) {
+    _s = snap.s;
+    _n = snap.n;
+    _lm.ClearExclusive();
+    InvalidateCaches();
+  }
+
+  /* Visit {{{4
+   * -----
+   * Visit state objects contained in this simulator. Lazily-evaluated flags
+   * are folded into xpsr first, and all cached state is re-derived afterwards
+   * as by InvalidateCaches, so the visitor may both save and load state.
+   */
+  template<typename Visitor>
+  void Visit(Visitor &v) {
+    _SyncFlags();
+    v("cpu", _s)
+     ("nest", _n)
+     ("cfg", _cfg)
+     ("procID", _procID)
+     ("lm", _lm)
+     ("gm", _gm);
+    if (GetNumSysTick())
+      v("systick", _sysTickS);
+    if (GetNumSysTick() > 1)
+      v("systickNS", _sysTickNS);
+    InvalidateCaches();
+  }
+
+  /* GetNumSysTick {{{4
+   * -------------
+   * Returns the number of SysTick timers implemented. Return value is in range
+   * [0,2].
+   */
+  int GetNumSysTick() { return _HaveSysTick(); }
+
+  /* GetSysTick {{{4
+   * ----------
+   * Retrieves the specified SysTick device. If no SysTick is implemented, or
+   * only one SysTick is implemented and ns is true, the behaviour is
+   * undefined.
+   */
+  SysTickDevice &GetSysTick(bool ns) { return _SystResolve(ns); }
+
+  /* IsExceptionPending {{{4
+   * ------------------
+   * Determines if an exception is pending to be taken immediately. If
+   * ignorePrimask is true, the value of PRIMASK is ignored; that is, PRIMASK
+   * is treated as though it is zero. Other priority criteria are still
+   * checked. Setting ignorePrimask to true is useful for implementing the WFI
+   * wakeup criterion.
+   */
+  bool IsExceptionPending(bool ignorePrimask) {
+    auto [canTakeExc, _1, _2] = _PendingExceptionDetails(ignorePrimask);
+    return canTakeExc;
+  }
+
+private:
+  /* Memory-Mapped Register Implementation {{{3
+   * =====================================
+   */
+
+  /* _NestReset {{{4
+   * ----------
+   */
+  void _NestReset() {
+    _n = CpuNest();
+
+    // REG_DWT_CTRL
+    if (_HaveDWT()) {
+      _n.dwtCtrl = PUTBITSM(REG_DWT_CTRL__NUMCOMP, NUM_DWT_COMP);
+      if (!_HaveMainExt())
+        _n.dwtCtrl |= REG_DWT_CTRL__NOTRCPKT | REG_DWT_CTRL__NOCYCCNT | REG_DWT_CTRL__NOPRFCNT;
+    }
+
+    // REG_DWT_FUNCTIONn
+    if (_HaveDWT()) {
+      for (size_t i=0; i<NUM_DWT_COMP; ++i) {
+        uint32_t id;
+        switch (i) {
+          case 0:
+            id = (_n.dwtCtrl & REG_DWT_CTRL__NOCYCCNT) ? 0b01010 /* IA DA DA+V */ : 0b01011 /* CC IA DA DA+V */;
+            break;
+          default:
+            id = 0b11110 /* IA IAL DA DAL DV LDV DA+V */;
+            break;
+        }
+        _n.dwtFunction[i] = PUTBITSM(REG_DWT_FUNCTION__ID, id);
+      }
+    }
+
+    // REG_FP_CTRL
+    _n.fpCtrl =
+        PUTBITSM(REG_FP_CTRL__REV, 1)
+      | PUTBITSM(REG_FP_CTRL__NUM_CODE_LO, GETBITS(NUM_FPB_COMP,0,3))
+      | PUTBITSM(REG_FP_CTRL__NUM_CODE_HI, GETBITS(NUM_FPB_COMP,4,6));
+
+    // REG_FPCCR
+    _n.fpccrS  = REG_FPCCR__S | REG_FPCCR__LSPEN | REG_FPCCR__ASPEN;
+    _n.fpccrNS = REG_FPCCR__ASPEN;
+
+    // REG_VTOR
+    _n.vtorS  = _cfg.InitialVtor();
+    _n.vtorNS = _cfg.InitialVtor();
+  }
+
+  /* NestAccessType {{{4
+   * --------------
+   */
+  enum NestAccessType {
+    NAT_SW,         // Load/store from software running on core
+    NAT_Internal,   // Core's internal logic is accessing register
+    NAT_External,   // JTAG, etc.
+  };
+
+  /* _NestCheckRegDWT {{{4
+   * ----------------
+   */
+  bool _NestCheckRegDWT(NestAccessType nat) {
+    return _HaveDWT() && (nat != NAT_SW || IMPL_DEF_BASELINE_NO_SW_ACCESS_DWT || _HaveMainExt());
+  }
+
+  /* _NestCheckRegFPB {{{4
+   * ----------------
+   */
+  bool _NestCheckRegFPB(NestAccessType nat) {
+    return _HaveFPB() && (nat != NAT_SW || IMPL_DEF_BASELINE_NO_SW_ACCESS_FPB || _HaveMainExt());
+  }
+
+  /* _NestPrioBits {{{4
+   * -------------
+   */
+  uint8_t _NestPrioBits() {
+    uint8_t numBits;
+
+    if (_HaveMainExt()) {
+      numBits = _cfg.PriorityBits();
+      ASSERT(numBits >= 3);
+    } else
+      numBits = 2;
+
+    return numBits;
+  }
+
+  /* _NestMaskPrio {{{4
+   * -------------
+   */
+  uint8_t _NestMaskPrio(uint8_t m) {
+    return m & BITS((8-_NestPrioBits()),7);
+  }
+
+  /* _NestAccessClassify {{{4
+   * -------------------
+   * {targetNS, targetRAZWI, targetFault}
+   */
+  std::tuple<bool,bool,bool> _NestAccessClassify(phys_t addr, bool isPriv, bool isSecure) {
+    bool isAltSpace = !!(addr & 0x2'0000);
+    uint8_t code =
+      (((uint32_t)isSecure  ) << 2)
+    | (((uint32_t)isPriv    ) << 1)
+    | (((uint32_t)isAltSpace) << 0)
+      ;
+
+    bool targetNS     = false;
+    bool targetRAZWI  = false;
+    bool targetFault  = false;
+    bool isStir       = ((addr & ~0x2'0000U) == 0xE000'EF00);
+
+    // RAZ/WI: Read as Zero, Writes Ignored
+    // RES0:   Should be Zero or Preserved (SBZP)
+    //
+    //                                        SE                          !SE
+    //                                        --------------------------  --------------------------
+    // SECURE     PRIV  ACCESS TO 0xE000_xxxx Secure space                Secure space
+    // SECURE     PRIV  ACCESS TO 0xE002_xxxx Non-Secure space            RAZ/WI
+    // SECURE     NPRIV ACCESS TO 0xE000_xxxx BusFault (STIR: Secure sp)  BusFault (STIR: Secure sp)
+    // SECURE     NPRIV ACCESS TO 0xE002_xxxx BusFault                    BusFault
+    // NON-SECURE PRIV  ACCESS TO 0xE000_xxxx Non-Secure space            Secure space
+    // NON-SECURE PRIV  ACCESS TO 0xE002_xxxx RES0                        RAZ/WI
+    // NON-SECURE NPRIV ACCESS TO 0xE000_xxxx BusFault (STIR: NS sp)      BusFault (STIR: Secure sp)
+    // NON-SECURE NPRIV ACCESS TO 0xE002_xxxx BusFault                    BusFault
+    //
+    // INTERNAL         ACCESS TO 0xE000_xxxx Secure space                Secure space
+    // INTERNAL         ACCESS TO 0xE002_xxxx Non-Secure space            UNREACHABLE
+
+    //       SPA    S=Secure?  P=Privileged?  A=Alt Space?
+    switch (code) {
+      case 0b110: targetNS = false; break;
+      case 0b111: if (_HaveSecurityExt()) targetNS = true; else targetRAZWI = true; break;
+      case 0b100: if (isStir) targetNS = false; else targetFault = true ; break;
+      case 0b101: targetFault = true; break; // ?
+      case 0b010: targetNS = _HaveSecurityExt(); break;
+      case 0b011: targetRAZWI = true; break;
+      case 0b000: if (isStir) targetNS = _HaveSecurityExt(); else targetFault = true; break;
+      case 0b001: targetFault = true; break;
+    }
+
+    return {targetNS, targetRAZWI, targetFault};
+  }
+
+  /* _NestLoad32 {{{4
+   * -----------
+   * Returns nonzero for BusFault.
+   */
+  int _NestLoad32(phys_t addr, bool isPriv, bool isSecure, uint32_t &v) {
+    auto [targetNS, targetRAZWI, targetFault] = _NestAccessClassify(addr, isPriv, isSecure);
+
+    if (targetFault)
+      return -1;
+
+    if (targetRAZWI)
+      v = 0;
+    else if (targetNS)
+      v = _NestLoad32Actual(addr |  0x2'0000U, NAT_SW);
+    else
+      v = _NestLoad32Actual(addr & ~0x2'0000U, NAT_SW);
+
+    return 0;
+  }
+
+  /* _NestLoad32Actual {{{4
+   * -----------------
+   */
+  uint32_t _NestLoad32Actual(phys_t addr, NestAccessType nat) {
+    phys_t baddr    = addr & ~0x2'0000U;
+    bool   isNS     = !!(addr &  0x2'0000U);
+    if (isNS)
+      ASSERT(_HaveSecurityExt());
+
+    switch (addr) {
+      case REG_DWT_CTRL:      return _NestCheckRegDWT(nat) ? _n.dwtCtrl : 0; // Res0
+
+      case REG_DWT_COMP( 0):
+      case REG_DWT_COMP( 1):
+      case REG_DWT_COMP( 2):
+      case REG_DWT_COMP( 3):
+      case REG_DWT_COMP( 4):
+      case REG_DWT_COMP( 5):
+      case REG_DWT_COMP( 6):
+      case REG_DWT_COMP( 7):
+      case REG_DWT_COMP( 8):
+      case REG_DWT_COMP( 9):
+      case REG_DWT_COMP(10):
+      case REG_DWT_COMP(11):
+      case REG_DWT_COMP(12):
+      case REG_DWT_COMP(13):
+      case REG_DWT_COMP(14):
+        return _NestCheckRegDWT(nat) ? _n.dwtComp[(addr - REG_DWT_COMP(0))/16] : 0; // Res0
+
+      case REG_DWT_FUNCTION( 0):
+      case REG_DWT_FUNCTION( 1):
+      case REG_DWT_FUNCTION( 2):
+      case REG_DWT_FUNCTION( 3):
+      case REG_DWT_FUNCTION( 4):
+      case REG_DWT_FUNCTION( 5):
+      case REG_DWT_FUNCTION( 6):
+      case REG_DWT_FUNCTION( 7):
+      case REG_DWT_FUNCTION( 8):
+      case REG_DWT_FUNCTION( 9):
+      case REG_DWT_FUNCTION(10):
+      case REG_DWT_FUNCTION(11):
+      case REG_DWT_FUNCTION(12):
+      case REG_DWT_FUNCTION(13):
+      case REG_DWT_FUNCTION(14):
+        if (_NestCheckRegDWT(nat)) {
+          uint32_t n = (addr - REG_DWT_FUNCTION(0))/16;
+          uint32_t v = _n.dwtFunction[n];
+          if (nat != NAT_Internal)
+            _n.dwtFunction[n] &= ~REG_DWT_FUNCTION__MATCHED;
+          return v;
+        } else
+          return 0; // Res0
+
+      case REG_FP_CTRL:       return _NestCheckRegFPB(nat) ? _n.fpCtrl : 0;
+
+      case REG_CPPWR_S:       return _HaveMainExt() ? _n.cppwrS  : 0;
+      case REG_CPPWR_NS:      return _HaveMainExt() ? _n.cppwrNS : 0;
+
+      case REG_CFSR_S:        return _HaveMainExt() ? _n.cfsrS   : 0;
+      case REG_CFSR_NS:       return _HaveMainExt() ? _n.cfsrNS  : 0;
+      case REG_HFSR_S:        return _HaveMainExt() ? _n.hfsrS   : 0;
+      case REG_HFSR_NS:       return _HaveMainExt() ? _n.hfsrNS  : 0;
+      case REG_DFSR_S:        return _HaveMainExt() || _HaveHaltingDebug() ? _n.dfsrS  : 0;
+      case REG_DFSR_NS:       return _HaveMainExt() || _HaveHaltingDebug() ? _n.dfsrNS : 0;
+
+      case REG_MMFAR_S:
+        if (!_HaveMainExt())
+          return 0;
+        if (_cfg.MmfarBfarMerged() && !(_n.cfsrS & REG_CFSR__MMFSR__MMARVALID))
+          return 0;
+        return _n.mmfarS;
+      case REG_MMFAR_NS:
+        if (!_HaveMainExt())
+          return 0;
+        if (_cfg.MmfarBfarMerged() && !(_n.cfsrNS & REG_CFSR__MMFSR__MMARVALID))
+          return 0;
+        return _n.mmfarNS;
+
+      case REG_BFAR_S:
+        if (!_HaveMainExt())
+          return 0;
+        if (_cfg.MmfarBfarMerged() && !(_n.cfsrS & REG_CFSR__BFSR__BFARVALID))
+          return 0;
+        return _n.bfarS;
+      case REG_BFAR_NS:
+        if (!_HaveMainExt())
+          return 0;
+        if (_cfg.MmfarBfarMerged() && !(_n.cfsrNS & REG_CFSR__BFSR__BFARVALID))
+          return 0;
+        return _n.bfarNS;
+
+      case REG_SHPR1_S:       return _HaveMainExt() ? _n.shpr1S  : 0;
+      case REG_SHPR1_NS:      return _HaveMainExt() ? _n.shpr1NS : 0;
+      case REG_SHPR2_S:       return _n.shpr2S;
+      case REG_SHPR2_NS:      return _n.shpr2NS;
+      case REG_SHPR3_S:       return _n.shpr3S;
+      case REG_SHPR3_NS:      return _n.shpr3NS;
+
+      case REG_CCR_S:         return (_n.ccrS  & 0b1110000011100011011) | BIT(0) | BIT(9);
+      case REG_CCR_NS:        return (_n.ccrNS & 0b1110000011100011011) | BIT(0) | BIT(9);
+
+      case REG_SCR_S:         return _n.scrS;
+      case REG_SCR_NS:        return _n.scrNS;
+
+      case REG_AIRCR_S: {
+        uint32_t v = CHGBITSM(_n.aircrS , REG_AIRCR__VECTKEY, 0xFA05);
+        return v;
+      }
+      case REG_AIRCR_NS: {
+        uint32_t v = CHGBITSM(_n.aircrNS, REG_AIRCR__VECTKEY, 0xFA05);
+        if (_n.aircrS & REG_AIRCR__SYSRESETREQS)
+          v &= ~REG_AIRCR__SYSRESETREQ;
+        v = CHGBITSM(v, REG_AIRCR__BFHFNMINS, GETBITSM(_n.aircrS, REG_AIRCR__BFHFNMINS));
+        return v;
+      }
+
+      case REG_CPACR_S:       return _n.cpacrS;
+      case REG_CPACR_NS:      return _n.cpacrNS;
+
+      case REG_NSACR:         return _n.nsacr;
+
+      case REG_MPU_TYPE_S:    return PUTBITSM(_NumMpuRegionS(),  REG_MPU_TYPE__DREGION);
+      case REG_MPU_TYPE_NS:   return PUTBITSM(_NumMpuRegionNS(), REG_MPU_TYPE__DREGION);
+
+      case REG_MPU_CTRL_S:    return _n.mpuCtrlS;
+      case REG_MPU_CTRL_NS:   return _n.mpuCtrlNS;
+
+      case REG_MPU_RNR_S:     return _n.mpuRnrS;
+      case REG_MPU_RNR_NS:    return _n.mpuRnrNS;
+
+      case REG_MPU_MAIR0_S:   return _n.mpuMair0S;
+      case REG_MPU_MAIR0_NS:  return _n.mpuMair0NS;
+      case REG_MPU_MAIR1_S:   return _n.mpuMair1S;
+      case REG_MPU_MAIR1_NS:  return _n.mpuMair1NS;
+
+      case REG_MPU_RBAR_S:    return _n.mpuRnrS  < _NumMpuRegionS()  ? _n.mpuRbarS [_n.mpuRnrS ] : 0;
+      case REG_MPU_RBAR_A1_S: return _n.mpuRnrS+1< _NumMpuRegionS()  ? _n.mpuRbarS [_n.mpuRnrS+1] : 0;
+      case REG_MPU_RBAR_A2_S: return _n.mpuRnrS+2< _NumMpuRegionS()  ? _n.mpuRbarS [_n.mpuRnrS+2] : 0;
+      case REG_MPU_RBAR_A3_S: return _n.mpuRnrS+3< _NumMpuRegionS()  ? _n.mpuRbarS [_n.mpuRnrS+3] : 0;
+      case REG_MPU_RBAR_NS:   return _n.mpuRnrNS < _NumMpuRegionNS() ? _n.mpuRbarNS[_n.mpuRnrNS ] : 0;
+      case REG_MPU_RBAR_A1_NS:return _n.mpuRnrNS+1<_NumMpuRegionNS() ? _n.mpuRbarNS[_n.mpuRnrNS+1] : 0;
+      case REG_MPU_RBAR_A2_NS:return _n.mpuRnrNS+2<_NumMpuRegionNS() ? _n.mpuRbarNS[_n.mpuRnrNS+2] : 0;
+      case REG_MPU_RBAR_A3_NS:return _n.mpuRnrNS+3<_NumMpuRegionNS() ? _n.mpuRbarNS[_n.mpuRnrNS+3] : 0;
+
+      case REG_MPU_RLAR_S:    return _n.mpuRnrS  < _NumMpuRegionS()  ? _n.mpuRlarS [_n.mpuRnrS ] : 0;
+      case REG_MPU_RLAR_A1_S: return _n.mpuRnrS+1< _NumMpuRegionS()  ? _n.mpuRlarS [_n.mpuRnrS+1] : 0;
+      case REG_MPU_RLAR_A2_S: return _n.mpuRnrS+2< _NumMpuRegionS()  ? _n.mpuRlarS [_n.mpuRnrS+2] : 0;
+      case REG_MPU_RLAR_A3_S: return _n.mpuRnrS+3< _NumMpuRegionS()  ? _n.mpuRlarS [_n.mpuRnrS+3] : 0;
+      case REG_MPU_RLAR_NS:   return _n.mpuRnrNS < _NumMpuRegionNS() ? _n.mpuRlarNS[_n.mpuRnrNS] : 0;
+      case REG_MPU_RLAR_A1_NS:return _n.mpuRnrNS+1< _NumMpuRegionNS() ? _n.mpuRlarNS[_n.mpuRnrNS+1] : 0;
+      case REG_MPU_RLAR_A2_NS:return _n.mpuRnrNS+2< _NumMpuRegionNS() ? _n.mpuRlarNS[_n.mpuRnrNS+2] : 0;
+      case REG_MPU_RLAR_A3_NS:return _n.mpuRnrNS+3< _NumMpuRegionNS() ? _n.mpuRlarNS[_n.mpuRnrNS+3] : 0;
+
+      case REG_SAU_CTRL:      return _n.sauCtrl;
+      case REG_SAU_TYPE:      return PUTBITSM(_NumSauRegion(), REG_SAU_TYPE__SREGION);
+      case REG_SAU_RNR:       return _n.sauRnr;
+      case REG_SAU_RBAR:      return _n.sauRnr < _NumSauRegion() ? _n.sauRbar[_n.sauRnr] : 0;
+      case REG_SAU_RLAR:      return _n.sauRnr < _NumSauRegion() ? _n.sauRlar[_n.sauRnr] : 0;
+
+      case REG_SFSR_S:        return _HaveMainExt() ? _n.sfsr : 0;
+      case REG_SFAR_S:        return _HaveMainExt() ? _n.sfar : 0;
+
+      case REG_VTOR_S:        return _n.vtorS;
+      case REG_VTOR_NS:       return _n.vtorNS;
+
+      case REG_DAUTHCTRL:     return (_HaveMainExt() || _HaveHaltingDebug()) && _HaveSecurityExt() ? _n.dauthCtrl : 0;
+
+      case REG_FPCCR_S:
+        return _n.fpccrS;
+
+      case REG_FPCCR_NS: {
+        uint32_t secureOnlyMask = REG_FPCCR__S | REG_FPCCR__SFRDY | REG_FPCCR__TS | REG_FPCCR__CLRONRETS | REG_FPCCR__LSPENS;
+        if (_n.demcr & REG_DEMCR__SDME)
+          secureOnlyMask |= REG_FPCCR__MONRDY;
+        uint32_t bankedBitsMask = REG_FPCCR__LSPACT | REG_FPCCR__USER | REG_FPCCR__THREAD
+          | REG_FPCCR__MMRDY | REG_FPCCR__SPLIMVIOL | REG_FPCCR__UFRDY | REG_FPCCR__ASPEN;
         uint32_t sharedBitsMask = ~bankedBitsMask;
 
-        return ((_n.fpccrNS & bankedBitsMask) | (_n.fpccrS & sharedBitsMask)) & ~secureOnlyMask;
-      }
+        return ((_n.fpccrNS & bankedBitsMask) | (_n.fpccrS & sharedBitsMask)) & ~secureOnlyMask;
+      }
+
+      case REG_FPCAR_S:       return _n.fpcarS;
+      case REG_FPCAR_NS:      return _n.fpcarNS;
+
+      case REG_FPDSCR_S:      return _n.fpdscrS;
+      case REG_FPDSCR_NS:     return _n.fpdscrNS;
+
+      case REG_ICSR_S:
+      case REG_ICSR_NS: {
+        uint32_t v = 0;
+        // VECTACTIVE
+        if (_HaveMainExt() || _HaveHaltingDebug())
+          v |= PUTBITSM(REG_ICSR__VECTACTIVE, GETBITSM(_s.xpsr, XPSR__EXCEPTION));
+        // RETTOBASE
+        if (_HaveMainExt()) {
+          int numActive = 0;
+          for (int i=0; i<ARRAYLEN(_s.excActive); ++i)
+            if (_s.excActive[i])
+              ++numActive;
+          if (numActive > 1)
+            v |= REG_ICSR__RETTOBASE;
+        }
+        // VECTPENDING
+        auto [pendingPrio, pendingExcNo, pendingIsSecure] = _PendingExceptionDetailsActual();
+        v |= PUTBITSM(pendingExcNo, REG_ICSR__VECTPENDING);
+        // ISRPENDING
+        if (_HaveMainExt() || _HaveHaltingDebug())
+          for (int i=16; i<NUM_EXC; ++i)
+            if (_s.excPending[i]) {
+              v |= REG_ICSR__ISRPENDING;
+              break;
+            }
+        // ISRPREEMPT
+        if ((_HaveMainExt() || _HaveHaltingDebug()) && pendingExcNo && _ExecutionPriority() > pendingPrio)
+          v |= REG_ICSR__ISRPREEMPT;
+        // STTNS
+        if (!isNS)
+          v |= (_n.icsr & REG_ICSR__STTNS);
+        // PENDSTSET
+        if (    (!isNS || _HaveSysTick() == 2
+                 || (_HaveSysTick() == 1 && !!(_n.icsr & REG_ICSR__STTNS)))
+             && (_s.excPending[SysTick] & BIT((int)isNS)) )
+          v |= REG_ICSR__PENDSTSET;
+        // PENDSVSET
+        if (_s.excPending[PendSV] & BIT((int)isNS))
+          v |= REG_ICSR__PENDSVSET;
+        // PENDNMISET
+        if (_s.excPending[NMI] && (!isNS || !!(_n.aircrS & REG_AIRCR__BFHFNMINS)))
+          v |= REG_ICSR__PENDNMISET;
+        return v;
+      }
+
+      case REG_SHCSR_S:
+      case REG_SHCSR_NS: {
+        uint32_t v = 0;
+        if (_HaveMainExt() && _IsActiveForState(MemManage, !isNS))
+          v |= REG_SHCSR__MEMFAULTACT;
+        if (_HaveMainExt() && _IsActiveForState(BusFault, !isNS))
+          v |= REG_SHCSR__BUSFAULTACT;
+        if (_IsActiveForState(HardFault, !isNS))
+          v |= REG_SHCSR__HARDFAULTACT;
+        if (_HaveMainExt() && _IsActiveForState(UsageFault, !isNS))
+          v |= REG_SHCSR__USGFAULTACT;
+        if (!isNS && _IsActiveForState(SecureFault, true))
+          v |= REG_SHCSR__SECUREFAULTACT;
+        if (_IsActiveForState(NMI, !isNS))
+          v |= REG_SHCSR__NMIACT;
+        if (_IsActiveForState(SVCall, !isNS))
+          v |= REG_SHCSR__SVCALLACT;
+        if (_IsActiveForState(DebugMonitor, !isNS))
+          v |= REG_SHCSR__MONITORACT;
+        if (_IsActiveForState(PendSV, !isNS))
+          v |= REG_SHCSR__PENDSVACT;
+        if (_IsActiveForState(SysTick, !isNS))
+          v |= REG_SHCSR__SYSTICKACT;
+
+        if (_HaveMainExt() && _IsPendingForState(UsageFault, !isNS))
+          v |= REG_SHCSR__USGFAULTPENDED;
+        if (_HaveMainExt() && _IsPendingForState(MemManage, !isNS))
+          v |= REG_SHCSR__MEMFAULTPENDED;
+        if (_HaveMainExt() && _IsPendingForState(BusFault, !isNS))
+          v |= REG_SHCSR__BUSFAULTPENDED;
+        if (_IsPendingForState(SVCall, !isNS))
+          v |= REG_SHCSR__SVCALLPENDED;
+
+        if (_HaveMainExt() && _IsEnabledForState(MemManage, !isNS))
+          v |= REG_SHCSR__MEMFAULTENA;
+        if (_HaveMainExt() && _IsEnabledForState(BusFault, !isNS))
+          v |= REG_SHCSR__BUSFAULTENA;
+        if (_HaveMainExt() && _IsEnabledForState(UsageFault, !isNS))
+          v |= REG_SHCSR__USGFAULTENA;
+        if (_HaveMainExt() && !isNS && _IsEnabledForState(SecureFault, true))
+          v |= REG_SHCSR__SECUREFAULTENA;
+
+        if (_HaveMainExt() && _IsPendingForState(SecureFault, true))
+          v |= REG_SHCSR__SECUREFAULTPENDED;
+
+        if (_IsPendingForState(HardFault, !isNS))
+          v |= REG_SHCSR__HARDFAULTPENDED;
+
+        return v;
+      }
+
+      case REG_DHCSR_S:
+      case REG_DHCSR_NS:
+        return _n.dhcsr;
+
+      case REG_DEMCR_S:
+      case REG_DEMCR_NS:
+        return _n.demcr;
+
+      case REG_SYST_CSR_S:
+        if (_HaveSysTick()) {
+          return _n.systCsrS | PUTBITSM(_SystGetCountFlag(/*ns=*/false, /*clear=*/nat == NAT_SW), REG_SYST_CSR__COUNTFLAG);
+        } else
+          return 0;
+      case REG_SYST_CSR_NS:
+        if (_HaveSysTick() == 2)
+          return _n.systCsrNS | PUTBITSM(_SystGetCountFlag(/*ns=*/true, /*clear=*/nat == NAT_SW), REG_SYST_CSR__COUNTFLAG);
+        else if (_HaveSysTick() == 1 && !!(_n.icsr & REG_ICSR__STTNS))
+          return _n.systCsrS | PUTBITSM(_SystGetCountFlag(/*ns=*/false, /*clear=*/nat == NAT_SW), REG_SYST_CSR__COUNTFLAG);
+        else
+          return 0;
+      case REG_SYST_RVR_S:
+        return _n.systRvrS;
+      case REG_SYST_RVR_NS:
+        if (_HaveSysTick() == 2)
+          return _n.systRvrNS;
+        else if (_HaveSysTick() == 1 && !!(_n.icsr & REG_ICSR__STTNS))
+          return _n.systRvrS;
+        else
+          return 0;
+      case REG_SYST_CVR_S:
+        return _SystGetCurrent(false);
+      case REG_SYST_CVR_NS:
+        if (_HaveSysTick() == 2)
+          return _SystGetCurrent(true);
+        else if (_HaveSysTick() == 1 && !!(_n.icsr & REG_ICSR__STTNS))
+          return _SystGetCurrent(false);
+        else
+          return 0;
+      case REG_SYST_CALIB_S:
+        if (_HaveSysTick())
+          return _n.systCalibS | REG_SYST_CALIB__NOREF;
+        else
+          return 0;
+      case REG_SYST_CALIB_NS:
+        if (_HaveSysTick() == 2)
+          return _n.systCalibNS | REG_SYST_CALIB__NOREF;
+        else if (_HaveSysTick() == 1 && !!(_n.icsr & REG_ICSR__STTNS))
+          return _n.systCalibS | REG_SYST_CALIB__NOREF;
+        else
+          return 0;
+
+      // ----------------------------------------------
+      default:
+        // REG_NVIC_ISPRn, REG_NVIC_ICPRn
+        if ((baddr >= 0xE000'E200 && baddr < 0xE000'E240) || (baddr >= 0xE000'E280 && baddr < 0xE000'E2C0))
+          return _NestLoadNvicPendingReg((addr/4)&0xF, /*secure=*/!isNS);
+
+        // REG_NVIC_ISERn, REG_NVIC_ICERn
+        if ((baddr >= 0xE000'E100 && baddr < 0xE000'E140) || (baddr >= 0xE000'E180 && baddr < 0xE000'E1C0))
+          return _NestLoadNvicEnableReg((addr/4)&0xF, /*secure=*/!isNS);
+
+        // REG_NVIC_IABRn
+        if (baddr >= 0xE000'E300 && baddr < 0xE000'E340)
+          return _NestLoadNvicActiveReg((addr/4)&0xF, /*secure=*/!isNS);
+
+        // REG_NVIC_ITNSn
+        if (addr >= 0xE000E380 && addr < 0xE000E3C0)
+          return _n.nvicItns[(addr/4)&0xF];
+
+        // REG_NVIC_IPRn
+        if (addr >= 0xE000E400 && addr < 0xE000E5F0)
+          return _n.nvicIpr[(addr - 0xE000E400)/4];
+
+        // REG_FP_COMPn
+        if ((addr >= 0xE000'2008 && addr < 0xE000'2008 + NUM_FPB_COMP*4) && !(addr % 4))
+          return _NestCheckRegFPB(nat) ? _n.fpComp[(addr - 0xE000'2008)/4] : 0;
+
+        // "Privileged accesses to unimplemented registers are Res0."
+        // Return 0 for unimplemented registers.
+        return 0;
+    }
+  }
+
+  /* _NestStoreNvicPendingReg {{{4
+   * ------------------------
+   */
+  void _NestStoreNvicPendingReg(uint32_t groupNo, uint32_t v, bool isSecure, bool setNotClear) {
+    uint32_t itns   = _n.nvicItns[groupNo];
+    int      limit  = (groupNo == 15) ? 15 : 32;
+    for (int i=0; i<limit; ++i)
+      if (v & BIT(i))
+        _SetPending(16 + groupNo*32 + i, isSecure, setNotClear, true);
+  }
+
+  /* _NestStoreNvicEnableReg {{{4
+   * -----------------------
+   */
+  void _NestStoreNvicEnableReg(uint32_t groupNo, uint32_t v, bool isSecure, bool setNotClear) {
+    uint32_t itns  = _n.nvicItns[groupNo];
+    int      limit = (groupNo == 15) ? 15 : 32;
+    for (int i=0; i<limit; ++i)
+      if (v & BIT(i))
+        _SetEnable(16 + groupNo*32 + i, isSecure, setNotClear, true);
+  }
+
+  /* _NestLoadNvicPendingReg {{{4
+   * -----------------------
+   */
+  uint32_t _NestLoadNvicPendingReg(uint32_t groupNo, bool isSecure) {
+    uint32_t v      = 0;
+    uint32_t itns   = _n.nvicItns[groupNo];
+    int      limit  = (groupNo == 15) ? 15 : 32;
+    for (int i=0; i<limit; ++i)
+      if (_IsPendingForState(16+groupNo*32+i, isSecure))
+        v |= BIT(i);
+    return v;
+  }
+
+  /* _NestLoadNvicEnableReg {{{4
+   * ----------------------
+   */
+  uint32_t _NestLoadNvicEnableReg(uint32_t groupNo, bool isSecure) {
+    uint32_t v      = 0;
+    int      limit  = (groupNo == 15) ? 15 : 32;
+    for (int i=0; i<limit; ++i)
+      if (_IsEnabledForState(16+groupNo*32+i, isSecure))
+        v |= BIT(i);
+    return v;
+  }
+
+  /* _NestLoadNvicActiveReg {{{4
+   * ----------------------
+   */
+  uint32_t _NestLoadNvicActiveReg(uint32_t groupNo, bool isSecure) {
+    uint32_t v      = 0;
+    uint32_t itns   = _n.nvicItns[groupNo];
+    int      limit  = (groupNo == 15) ? 15 : 32;
+    for (int i=0; i<limit; ++i)
+      if (_IsActiveForState(16+groupNo*32+i, isSecure))
+        v |= BIT(i);
+    return v;
+  }
+
+  /* _NestStore32 {{{4
+   * ------------
+   */
+  int _NestStore32(phys_t addr, bool isPriv, bool isSecure, uint32_t v) {
+    auto [targetNS, targetRAZWI, targetFault] = _NestAccessClassify(addr, isPriv, isSecure);
+
+    if (targetFault)
+      return -1;
+
+    if (targetRAZWI)
+      return 0;
+
+    if (targetNS)
+      _NestStore32Actual(addr |  0x2'0000U, v, NAT_SW);
+    else
+      _NestStore32Actual(addr & ~0x2'0000U, v, NAT_SW);
+
+    return 0;
+  }
+
+  /* _NestStore32Actual {{{4
+   * ------------------
+   */
+  void _NestStore32Actual(phys_t addr, uint32_t v, NestAccessType nat) {
+    phys_t baddr    = addr & ~0x2'0000U;
+    bool   isNS     = !!(addr &  0x2'0000U);
+    if (isNS)
+      ASSERT(_HaveSecurityExt());
+
+    if (_IsPriorityReg(addr))
+      _InvalidateExcPriorities();
+
+    switch (addr) {
+      case REG_DWT_CTRL:
+        // !DWT:  res0
+        // !Main: might not be SW accessible
+        //
+        // 33222222 22221111 11111100 00000000  r: RO. c: 0 on cold reset. 0: Res0.
+        // 10987654 32109876 54321098 76543210  m: Res0 if !Main. M: Res1 if !Main. p: Res0 if !PRFCNT. t: Res0 if !TRCPKT/!NOCYCCNT. c: Res0 if !CYCCNT. u: Unknown on cold reset.
+        // rrrrr0rr cccccccc 000cuuuu uuuuuuuc
+        //     M MM mmpppppp    tcccc cccccccc
+        //                      c
+        if (_NestCheckRegDWT(nat)) {
+          uint32_t roBits = BITS(13,15) | BITS(24,31);
+          if (_n.dwtCtrl & REG_DWT_CTRL__NOCYCCNT)
+            roBits |= BITS(16,23) | BITS(0,12);
+          if (_n.dwtCtrl & REG_DWT_CTRL__NOTRCPKT)
+            roBits |= BIT (12);
+          if (_n.dwtCtrl & REG_DWT_CTRL__NOPRFCNT)
+            roBits |= BITS(16,21);
+          v &= ~roBits;
+          v |= _n.dwtCtrl & roBits;
+          _n.dwtCtrl = v;
+        }
+        break;
+
+      case REG_DWT_COMP( 0):
+      case REG_DWT_COMP( 1):
+      case REG_DWT_COMP( 2):
+      case REG_DWT_COMP( 3):
+      case REG_DWT_COMP( 4):
+      case REG_DWT_COMP( 5):
+      case REG_DWT_COMP( 6):
+      case REG_DWT_COMP( 7):
+      case REG_DWT_COMP( 8):
+      case REG_DWT_COMP( 9):
+      case REG_DWT_COMP(10):
+      case REG_DWT_COMP(11):
+      case REG_DWT_COMP(12):
+      case REG_DWT_COMP(13):
+      case REG_DWT_COMP(14):
+        if (_NestCheckRegDWT(nat)) {
+          uint32_t n      = (addr - REG_DWT_COMP(0))/16;
+          if (n < NUM_DWT_COMP) {
+            uint32_t roBits = 0;
+            if ((GETBITSM(_n.dwtFunction[n], REG_DWT_FUNCTION__MATCH) & 0b1110) == 0b0010)
+              roBits |= BIT(0);
+            v &= ~roBits;
+            _n.dwtComp[n] = v;
+          }
+        }
+        break;
+
+      case REG_DWT_FUNCTION( 0):
+      case REG_DWT_FUNCTION( 1):
+      case REG_DWT_FUNCTION( 2):
+      case REG_DWT_FUNCTION( 3):
+      case REG_DWT_FUNCTION( 4):
+      case REG_DWT_FUNCTION( 5):
+      case REG_DWT_FUNCTION( 6):
+      case REG_DWT_FUNCTION( 7):
+      case REG_DWT_FUNCTION( 8):
+      case REG_DWT_FUNCTION( 9):
+      case REG_DWT_FUNCTION(10):
+      case REG_DWT_FUNCTION(11):
+      case REG_DWT_FUNCTION(12):
+      case REG_DWT_FUNCTION(13):
+      case REG_DWT_FUNCTION(14):
+        if (_NestCheckRegDWT(nat)) {
+          uint32_t n      = (addr - REG_DWT_FUNCTION(0))/16;
+          if (n < NUM_DWT_COMP) {
+            uint32_t roBits = BITS( 6, 9) | BITS(12,31);
+            v &= ~roBits;
+            v |= _n.dwtFunction[n] & roBits;
+            _n.dwtFunction[n] = v;
+            if ((GETBITSM(v, REG_DWT_FUNCTION__MATCH) & 0b1110) == 0b0010)
+              _n.dwtComp[n] &= ~1;
+          }
+        }
+        break;
+
+      case REG_FP_CTRL:
+        if (_NestCheckRegFPB(nat) && (v & BIT(1))) {
+          uint32_t roBits = BITS( 1,31);
+          v &= ~roBits;
+          v |= _n.fpCtrl & roBits;
+          _n.fpCtrl = v;
+        }
+        break;
+
+      case REG_CPPWR_S:
+        if (_HaveMainExt())
+          // TODO make bits for unsupported coprocessors RAZ/WI
+          _n.cppwrS = v & (BITS( 0,15) | BITS(20,23));
+        break;
+
+      case REG_CPPWR_NS:
+        if (_HaveMainExt())
+          _n.cppwrNS = v & (BITS( 0,15) | BITS(20,23));
+        break;
+
+      case REG_CFSR_S:
+        if (_HaveMainExt()) {
+          if (nat == NAT_Internal)
+            _n.cfsrS = v;
+          else
+            _n.cfsrS &= ~v;
+        }
+        break;
+
+      case REG_CFSR_NS:
+        if (_HaveMainExt()) {
+          if (nat == NAT_Internal)
+            _n.cfsrNS = v;
+          else
+            _n.cfsrNS &= ~v;
+        }
+        break;
+
+      case REG_HFSR_S:
+        if (_HaveMainExt()) {
+          if (nat == NAT_Internal)
+            _n.hfsrS = v;
+          else
+            _n.hfsrS &= ~v;
+        }
+        break;
+
+      case REG_HFSR_NS:
+        if (_HaveMainExt()) {
+          if (nat == NAT_Internal)
+            _n.hfsrNS = v;
+          else
+            _n.hfsrNS &= ~v;
+        }
+        break;
+
+      case REG_DFSR_S:
+        if (_HaveMainExt() || _HaveHaltingDebug()) {
+          if (nat == NAT_Internal)
+            _n.dfsrS = v;
+          else
+            _n.dfsrS &= ~v;
+        }
+        break;
+
+      case REG_DFSR_NS:
+        if (_HaveMainExt() || _HaveHaltingDebug()) {
+          if (nat == NAT_Internal)
+            _n.dfsrNS = v;
+          else
+            _n.dfsrNS &= ~v;
+        }
+        break;
+
+      case REG_MMFAR_S:
+        if (_HaveMainExt() && nat == NAT_Internal)
+          _n.mmfarS = v;
+        break;
+
+      case REG_MMFAR_NS:
+        if (_HaveMainExt() && nat == NAT_Internal)
+          _n.mmfarNS = v;
+        break;
+
+      case REG_BFAR_S:
+        if (_HaveMainExt() && nat == NAT_Internal)
+          _n.bfarS = v;
+        break;
+
+      case REG_BFAR_NS:
+        if (_HaveMainExt() && nat == NAT_Internal)
+          _n.bfarNS = v;
+        break;
+
+      case REG_SHPR1_S:
+        if (_HaveMainExt()) {
+          v = CHGBITS(v, 0, 7, _NestMaskPrio(GETBITS(v, 0, 7)));
+          v = CHGBITS(v, 8,15, _NestMaskPrio(GETBITS(v, 8,15)));
+          v = CHGBITS(v,16,23, _NestMaskPrio(GETBITS(v,16,23)));
+          v = CHGBITS(v,24,31, _NestMaskPrio(GETBITS(v,24,31)));
+          _n.shpr1S = v;
+        }
+        break;
+
+      case REG_SHPR1_NS:
+        if (_HaveMainExt()) {
+          v = CHGBITS(v, 0, 7, _NestMaskPrio(GETBITS(v, 0, 7)));
+          v = CHGBITS(v, 8,15, _NestMaskPrio(GETBITS(v, 8,15)));
+          v = CHGBITS(v,16,23, _NestMaskPrio(GETBITS(v,16,23)));
+          v = CHGBITS(v,24,31, _NestMaskPrio(GETBITS(v,24,31)));
+          _n.shpr1NS = v;
+        }
+        break;
+
+      case REG_SHPR2_S:
+        v = CHGBITS(v, 0,23, 0);
+        v = CHGBITS(v,24,31, _NestMaskPrio(GETBITS(v,24,31)));
+        _n.shpr2S = v;
+        break;
+
+      case REG_SHPR2_NS:
+        v = CHGBITS(v, 0,23, 0);
+        v = CHGBITS(v,24,31, _NestMaskPrio(GETBITS(v,24,31)));
+        _n.shpr2NS = v;
+        break;
+
+      case REG_SHPR3_S:
+        v = CHGBITS(v, 0, 7, _HaveMainExt() ? _NestMaskPrio(GETBITS(v, 0, 7)) : 0); // TODO DEMCR.SDME
+        v = CHGBITS(v, 8,15, 0);
+        v = CHGBITS(v,16,23, _NestMaskPrio(GETBITS(v,16,23)));
+        v = CHGBITS(v,24,31, _NestMaskPrio(GETBITS(v,24,31))); // TODO Type 1 SysTick
+        _n.shpr3S = v;
+        break;
+
+      case REG_SHPR3_NS:
+        v = CHGBITS(v, 0, 7, _HaveMainExt() ? _NestMaskPrio(GETBITS(v, 0, 7)) : 0);
+        v = CHGBITS(v, 8,15, 0);
+        v = CHGBITS(v,16,23, _NestMaskPrio(GETBITS(v,16,23)));
+        v = CHGBITS(v,24,31, _NestMaskPrio(GETBITS(v,24,31)));
+        _n.shpr3NS = v;
+        break;
+
+      case REG_CCR_S:
+        _n.ccrS     = _MaskOrNonMain((v & 0b1110000011100011011) | BIT(0) | BIT(9),
+          BITS(16,18)|BIT(10)|BIT( 8)|BIT( 4)|BIT( 1), BIT( 3)); break;
+
+      case REG_CCR_NS:
+        _n.ccrNS    = _MaskOrNonMain((v & 0b1110000011100011011) | BIT(0) | BIT(9),
+          BITS(16,18)|BIT(10)|BIT( 8)|BIT( 4)|BIT( 1), BIT( 3)); break;
+
+      case REG_SCR_S:
+        _n.scrS = v & BITS(1,4);
+        break;
+
+      case REG_SCR_NS:
+        _n.scrNS = v & BITS(1,4);
+        break;
+
+      case REG_AIRCR_S:
+        if (GETBITSM(v, REG_AIRCR__VECTKEY) == 0x05FA) {
+          uint32_t roMask = BIT(15);
+          if (!_HaveMainExt())
+            roMask |= BITS( 8,10);
+          v = CHGBITSM(v, REG_AIRCR__VECTKEY, 0);
+          v &= ~roMask;
+          v |= _n.aircrS;
+          if (v & REG_AIRCR__SYSRESETREQ)
+            _SetPending(Reset, true, true);
+          v &= ~REG_AIRCR__SYSRESETREQ;
+          if (v & REG_AIRCR__VECTCLRACTIVE)
+            ; // TODO
+          v &= ~REG_AIRCR__VECTCLRACTIVE;
+          _n.aircrS = v;
+        }
+        break;
+
+      case REG_AIRCR_NS:
+        if (GETBITSM(v, REG_AIRCR__VECTKEY) == 0x05FA) {
+          // TODO VECTCLRACTIVE
+          uint32_t roMask = BIT(15) | BIT(14) | BIT(13) | BIT( 1);
+          if (!_HaveMainExt())
+            roMask |= BITS( 8,10);
+          if (_n.aircrS & REG_AIRCR__SYSRESETREQS)
+            roMask |= REG_AIRCR__SYSRESETREQ;
+          v = CHGBITSM(v, REG_AIRCR__VECTKEY, 0);
+          v &= ~roMask;
+          v |= _n.aircrNS;
+          if (v & REG_AIRCR__SYSRESETREQ)
+            _SetPending(Reset, true, true);
+          v &= ~REG_AIRCR__SYSRESETREQ;
+          if (v & REG_AIRCR__VECTCLRACTIVE)
+            ; // TODO
+          v &= ~REG_AIRCR__VECTCLRACTIVE;
+          _n.aircrNS = v;
+        }
+        break;
+
+      case REG_CPACR_S:
+        _n.cpacrS = v & (BITS(0,15) | BITS(20,23)); // TODO RAZ/WI for unimplemented coprocessors
+        break;
+
+      case REG_CPACR_NS:
+        _n.cpacrNS = v & (BITS(0,15) | BITS(20,23));
+        break;
+
+      case REG_NSACR:
+        _n.nsacr = v & (BITS( 0, 7) | BITS(10,11));
+        break;
+
+      case REG_MPU_TYPE_S:
+      case REG_MPU_TYPE_NS:
+        break;
+
+      case REG_MPU_CTRL_S:
+        _n.mpuCtrlS = v & BITS(0,2);
+        break;
+
+      case REG_MPU_CTRL_NS:
+        _n.mpuCtrlNS = v & BITS(0,2);
+        break;
+
+      case REG_MPU_RNR_S:
+        _n.mpuRnrS = v & BITS( 0, 7); // TODO CONSTRAINED UNPREDICTABLE
+        break;
+
+      case REG_MPU_RNR_NS:
+        _n.mpuRnrNS = v & BITS( 0, 7); // TODO CONSTRAINED UNPREDICTABLE
+        break;
+
+      case REG_MPU_MAIR0_S:
+        _n.mpuMair0S = v;
+        _UpdateMAIRTable(true);
+        break;
+
+      case REG_MPU_MAIR0_NS:
+        _n.mpuMair0NS = v;
+        _UpdateMAIRTable(false);
+        break;
+
+      case REG_MPU_MAIR1_S:
+        _n.mpuMair1S = v;
+        _UpdateMAIRTable(true);
+        break;
+
+      case REG_MPU_MAIR1_NS:
+        _n.mpuMair1NS = v;
+        _UpdateMAIRTable(false);
+        break;
+
+      case REG_MPU_RBAR_S:
+        if (_n.mpuRnrS < _NumMpuRegionS())
+          _n.mpuRbarS[_n.mpuRnrS] = v;
+        break;
+
+      case REG_MPU_RBAR_A1_S:
+        if (_n.mpuRnrS+1 < _NumMpuRegionS())
+          _n.mpuRbarS[_n.mpuRnrS+1] = v;
+        break;
+
+      case REG_MPU_RBAR_A2_S:
+        if (_n.mpuRnrS+2 < _NumMpuRegionS())
+          _n.mpuRbarS[_n.mpuRnrS+2] = v;
+        break;
+
+      case REG_MPU_RBAR_A3_S:
+        if (_n.mpuRnrS+3 < _NumMpuRegionS())
+          _n.mpuRbarS[_n.mpuRnrS+3] = v;
+        break;
+
+      case REG_MPU_RBAR_NS:
+        if (_n.mpuRnrNS < _NumMpuRegionNS())
+          _n.mpuRbarNS[_n.mpuRnrNS] = v;
+        break;
+
+      case REG_MPU_RBAR_A1_NS:
+        if (_n.mpuRnrNS+1 < _NumMpuRegionNS())
+          _n.mpuRbarNS[_n.mpuRnrNS+1] = v;
+        break;
+
+      case REG_MPU_RBAR_A2_NS:
+        if (_n.mpuRnrNS+2 < _NumMpuRegionNS())
+          _n.mpuRbarNS[_n.mpuRnrNS+2] = v;
+        break;
 
-      case REG_FPCAR_S:       return _n.fpcarS;
-      case REG_FPCAR_NS:      return _n.fpcarNS;
+      case REG_MPU_RBAR_A3_NS:
+        if (_n.mpuRnrNS+3 < _NumMpuRegionNS())
+          _n.mpuRbarNS[_n.mpuRnrNS+3] = v;
+        break;
 
-      case REG_FPDSCR_S:      return _n.fpdscrS;
-      case REG_FPDSCR_NS:     return _n.fpdscrNS;
+      case REG_MPU_RLAR_S:
+        if (_n.mpuRnrS < _NumMpuRegionS())
+          _n.mpuRlarS[_n.mpuRnrS] = v;
+        break;
 
-      case REG_ICSR_S:
-      case REG_ICSR_NS: {
-        uint32_t v = 0;
-        // VECTACTIVE
-        if (_HaveMainExt() || _HaveHaltingDebug())
-          v |= PUTBITSM(REG_ICSR__VECTACTIVE, GETBITSM(_s.xpsr, XPSR__EXCEPTION));
-        // RETTOBASE
+      case REG_MPU_RLAR_A1_S:
+        if (_n.mpuRnrS+1 < _NumMpuRegionS())
+          _n.mpuRlarS[_n.mpuRnrS+1] = v;
+        break;
+
+      case REG_MPU_RLAR_A2_S:
+        if (_n.mpuRnrS+2 < _NumMpuRegionS())
+          _n.mpuRlarS[_n.mpuRnrS+2] = v;
+        break;
+
+      case REG_MPU_RLAR_A3_S:
+        if (_n.mpuRnrS+3 < _NumMpuRegionS())
+          _n.mpuRlarS[_n.mpuRnrS+3] = v;
+        break;
+
+      case REG_MPU_RLAR_NS:
+        if (_n.mpuRnrNS < _NumMpuRegionNS())
+          _n.mpuRlarNS[_n.mpuRnrNS] = v;
+        break;
+
+      case REG_MPU_RLAR_A1_NS:
+        if (_n.mpuRnrNS+1 < _NumMpuRegionNS())
+          _n.mpuRlarNS[_n.mpuRnrNS+1] = v;
+        break;
+
+      case REG_MPU_RLAR_A2_NS:
+        if (_n.mpuRnrNS+2 < _NumMpuRegionNS())
+          _n.mpuRlarNS[_n.mpuRnrNS+2] = v;
+        break;
+
+      case REG_MPU_RLAR_A3_NS:
+        if (_n.mpuRnrNS+3 < _NumMpuRegionNS())
+          _n.mpuRlarNS[_n.mpuRnrNS+3] = v;
+        break;
+
+      case REG_SAU_CTRL:
+        _n.sauCtrl = v & BITS( 0, 1);
+        break;
+
+      case REG_SAU_TYPE:
+        break;
+
+      case REG_SAU_RNR:
+        if (_NumSauRegion())
+          _n.sauRnr = v & REG_SAU_RNR__REGION;
+        // TODO CONSTRAINED UNPREDICTABLE
+        break;
+
+      case REG_SAU_RBAR:
+        if (_n.sauRnr < _NumSauRegion())
+          _n.sauRbar[_n.sauRnr] = v & ~BITS( 0, 4);
+        break;
+
+      case REG_SAU_RLAR:
+        if (_n.sauRnr < _NumSauRegion())
+          _n.sauRlar[_n.sauRnr] = v & ~BITS( 2, 4);
+        break;
+
+      case REG_SFSR_S:
         if (_HaveMainExt()) {
-          int numActive = 0;
-          for (int i=0; i<ARRAYLEN(_s.excActive); ++i)
-            if (_s.excActive[i])
-              ++numActive;
-          if (numActive > 1)
-            v |= REG_ICSR__RETTOBASE;
+          if (nat == NAT_Internal)
+            _n.sfsr = v;
+          else
+            _n.sfsr &= ~v;
         }
-        // VECTPENDING
-        auto [pendingPrio, pendingExcNo, pendingIsSecure] = _PendingExceptionDetailsActual();
-        v |= PUTBITSM(pendingExcNo, REG_ICSR__VECTPENDING);
-        // ISRPENDING
-        if (_HaveMainExt() || _HaveHaltingDebug())
-          for (int i=16; i<NUM_EXC; ++i)
-            if (_s.excPending[i]) {
-              v |= REG_ICSR__ISRPENDING;
-              break;
-            }
-        // ISRPREEMPT
-        if ((_HaveMainExt() || _HaveHaltingDebug()) && pendingExcNo && _ExecutionPriority() > pendingPrio)
-          v |= REG_ICSR__ISRPREEMPT;
-        // STTNS
-        if (!isNS)
-          v |= (_n.icsr & REG_ICSR__STTNS);
-        // PENDSTSET
-        if (    (!isNS || _HaveSysTick() == 2
-                 || (_HaveSysTick() == 1 && !!(_n.icsr & REG_ICSR__STTNS)))
-             && (_s.excPending[SysTick] & BIT((int)isNS)) )
-          v |= REG_ICSR__PENDSTSET;
-        // PENDSVSET
-        if (_s.excPending[PendSV] & BIT((int)isNS))
-          v |= REG_ICSR__PENDSVSET;
-        // PENDNMISET
-        if (_s.excPending[NMI] && (!isNS || !!(_n.aircrS & REG_AIRCR__BFHFNMINS)))
-          v |= REG_ICSR__PENDNMISET;
-        return v;
-      }
+        break;
 
-      case REG_SHCSR_S:
-      case REG_SHCSR_NS: {
-        uint32_t v = 0;
-        if (_HaveMainExt() && _IsActiveForState(MemManage, !isNS))
-          v |= REG_SHCSR__MEMFAULTACT;
-        if (_HaveMainExt() && _IsActiveForState(BusFault, !isNS))
-          v |= REG_SHCSR__BUSFAULTACT;
-        if (_IsActiveForState(HardFault, !isNS))
-          v |= REG_SHCSR__HARDFAULTACT;
-        if (_HaveMainExt() && _IsActiveForState(UsageFault, !isNS))
-          v |= REG_SHCSR__USGFAULTACT;
-        if (!isNS && _IsActiveForState(SecureFault, true))
-          v |= REG_SHCSR__SECUREFAULTACT;
-        if (_IsActiveForState(NMI, !isNS))
-          v |= REG_SHCSR__NMIACT;
-        if (_IsActiveForState(SVCall, !isNS))
-          v |= REG_SHCSR__SVCALLACT;
-        if (_IsActiveForState(DebugMonitor, !isNS))
-          v |= REG_SHCSR__MONITORACT;
-        if (_IsActiveForState(PendSV, !isNS))
-          v |= REG_SHCSR__PENDSVACT;
-        if (_IsActiveForState(SysTick, !isNS))
-          v |= REG_SHCSR__SYSTICKACT;
+      case REG_SFAR_S:
+        if (_HaveMainExt())
+          _n.sfar = v;
+        break;
 
-        if (_HaveMainExt() && _IsPendingForState(UsageFault, !isNS))
-          v |= REG_SHCSR__USGFAULTPENDED;
-        if (_HaveMainExt() && _IsPendingForState(MemManage, !isNS))
-          v |= REG_SHCSR__MEMFAULTPENDED;
-        if (_HaveMainExt() && _IsPendingForState(BusFault, !isNS))
-          v |= REG_SHCSR__BUSFAULTPENDED;
-        if (_IsPendingForState(SVCall, !isNS))
-          v |= REG_SHCSR__SVCALLPENDED;
+      case REG_VTOR_S:    _n.vtorS    = v & BITS( 7,31); break;
+      case REG_VTOR_NS:   _n.vtorNS   = v & BITS( 7,31); break;
 
-        if (_HaveMainExt() && _IsEnabledForState(MemManage, !isNS))
-          v |= REG_SHCSR__MEMFAULTENA;
-        if (_HaveMainExt() && _IsEnabledForState(BusFault, !isNS))
-          v |= REG_SHCSR__BUSFAULTENA;
-        if (_HaveMainExt() && _IsEnabledForState(UsageFault, !isNS))
-          v |= REG_SHCSR__USGFAULTENA;
-        if (_HaveMainExt() && !isNS && _IsEnabledForState(SecureFault, true))
-          v |= REG_SHCSR__SECUREFAULTENA;
+      case REG_DAUTHCTRL:
+        if ((_HaveMainExt() || _HaveHaltingDebug()) && _HaveSecurityExt())
+          _n.dauthCtrl = v & BITS( 0, 3);
+        break;
 
-        if (_HaveMainExt() && _IsPendingForState(SecureFault, true))
-          v |= REG_SHCSR__SECUREFAULTPENDED;
+      case REG_FPCCR_S:
+        _n.fpccrS   = v & (BITS( 0, 10) | BITS(26,31));
+        break;
 
-        if (_IsPendingForState(HardFault, !isNS))
-          v |= REG_SHCSR__HARDFAULTPENDED;
+      case REG_FPCCR_NS: {
+        uint32_t secureOnlyMask = REG_FPCCR__S | REG_FPCCR__SFRDY | REG_FPCCR__TS | REG_FPCCR__CLRONRETS | REG_FPCCR__LSPENS;
+        if (_n.demcr & REG_DEMCR__SDME)
+          secureOnlyMask |= REG_FPCCR__MONRDY;
+        uint32_t bankedBitsMask = REG_FPCCR__LSPACT | REG_FPCCR__USER | REG_FPCCR__THREAD
+          | REG_FPCCR__MMRDY | REG_FPCCR__SPLIMVIOL | REG_FPCCR__UFRDY | REG_FPCCR__ASPEN;
+        uint32_t sharedBitsMask = ~bankedBitsMask;
+        uint32_t roMask = BITS(11,25);
+
+        _n.fpccrS  = (_n.fpccrS & ~(sharedBitsMask & ~secureOnlyMask)) | (v & (sharedBitsMask & ~secureOnlyMask));
+        _n.fpccrNS = v & bankedBitsMask;
+      } break;
+
+
+      case REG_FPCAR_S:
+        if (_HaveFPExt())
+          _n.fpcarS = v & ~BITS( 0, 2);
+        break;
+
+      case REG_FPCAR_NS:
+        if (_HaveFPExt())
+          _n.fpcarNS = v & ~BITS( 0, 2);
+        break;
+
+      case REG_FPDSCR_S:  if (_HaveFPExt()) _n.fpdscrS  = v & BITS(22,26); break;
+      case REG_FPDSCR_NS: if (_HaveFPExt()) _n.fpdscrNS = v & BITS(22,26); break;
+
+      case REG_ICSR_S:
+      case REG_ICSR_NS:
+        // PENDSTSET, PENDSTCLR
+        if (v & (REG_ICSR__PENDSTSET | REG_ICSR__PENDSTCLR))
+           if (   (_HaveSysTick() == 2)
+               || (_HaveSysTick() == 1 && (!(_n.icsr & REG_ICSR__STTNS)) == !isNS))
+             _SetPending(SysTick, !isNS, !!(v & REG_ICSR__PENDSTSET));
+        // PENDSVCLR
+        // PENDSVSET
+        if (v & (REG_ICSR__PENDSVSET | REG_ICSR__PENDSVCLR))
+          _SetPending(PendSV, !isNS, !!(v & REG_ICSR__PENDSVSET), true);
+        // PENDNMICLR
+        // PENDNMISET
+        if (v & (REG_ICSR__PENDNMISET | REG_ICSR__PENDNMICLR))
+          if (!isNS || !!(_n.aircrS & REG_AIRCR__BFHFNMINS))
+            _SetPending(NMI, true, !!(v & REG_ICSR__PENDNMISET), true);
+        if (!isNS) {
+          uint32_t rwMask = 0;
+          if (_HaveSysTick() == 1)
+            rwMask |= REG_ICSR__STTNS;
+          if ((_n.icsr ^ v) & rwMask)
+            _InvalidateExcPriorities();
+          _n.icsr = v & rwMask;
+        }
+        break;
+
+      case REG_SHCSR_S:
+      case REG_SHCSR_NS:
+        // ----- Actives
+        if (_HaveMainExt()) {
+          _SetActive(MemManage, !isNS, !!(v & REG_SHCSR__MEMFAULTACT));
+          _SetActive(BusFault, !isNS, !!(v & REG_SHCSR__BUSFAULTACT));
+        }
+        if (!(v & REG_SHCSR__HARDFAULTACT))
+          _SetActive(HardFault, !isNS, false);
+        if (_HaveMainExt())
+          _SetActive(UsageFault, !isNS, !!(v & REG_SHCSR__USGFAULTACT));
+        if (_HaveMainExt() && _HaveSecurityExt())
+          _SetActive(SecureFault, !isNS, !!(v & REG_SHCSR__SECUREFAULTACT));
+        if (!(v & REG_SHCSR__NMIACT))
+          // TODO: NMIACT: "This field ignores writes if the value being written
+          // is one, AIRCR.BFHFNMINS is zero, the access is from Non-secure state,
+          // the access is not via the NS alias, or the access is from a debugger
+          // when DHCSR.S_SDE is zero. This bit can only be cleared by access
+          // from the Secure state to the NS alias."
+          _SetActive(NMI, !isNS, false);
+        _SetActive(SVCall, !isNS, !!(v & REG_SHCSR__SVCALLACT));
+        if (_HaveMainExt())
+          _SetActive(DebugMonitor, !isNS, !!(v & REG_SHCSR__MONITORACT));
+        _SetActive(PendSV, !isNS, !!(v & REG_SHCSR__PENDSVACT));
+        _SetActive(SysTick, !isNS, !!(v & REG_SHCSR__SYSTICKACT));
 
-        return v;
-      }
+        // ----- Pendings
+        if (_HaveMainExt()) {
+          _SetPending(UsageFault, !isNS, !!(v & REG_SHCSR__USGFAULTPENDED), true);
+          _SetPending(MemManage, !isNS, !!(v & REG_SHCSR__MEMFAULTPENDED), true);
+          _SetPending(BusFault, !isNS, !!(v & REG_SHCSR__BUSFAULTPENDED), true);
+          _SetPending(SVCall, !isNS, !!(v & REG_SHCSR__SVCALLPENDED), true);
+          _SetPending(HardFault, !isNS, !!(v & REG_SHCSR__HARDFAULTPENDED), true);
+          if (_HaveSecurityExt())
+            _SetPending(SecureFault, !isNS, !!(v & REG_SHCSR__SECUREFAULTPENDED), true);
+        }
+
+        // ----- Enables
+        if (_HaveMainExt()) {
+          _SetEnable(MemManage, !isNS, !!(v & REG_SHCSR__MEMFAULTENA), true);
+          _SetEnable(BusFault, !isNS, !!(v & REG_SHCSR__BUSFAULTENA), true);
+          _SetEnable(UsageFault, !isNS, !!(v & REG_SHCSR__USGFAULTENA), true);
+          if (_HaveSecurityExt())
+            _SetEnable(SecureFault, !isNS, !!(v & REG_SHCSR__SECUREFAULTENA), true);
+        }
+        break;
 
       case REG_DHCSR_S:
       case REG_DHCSR_NS:
-        return _n.dhcsr;
+        if (nat == NAT_Internal)
+          _n.dhcsr = v;
+        else if (GETBITS(v,16,31) == 0xA05F) {
+          uint32_t rwBits = BITS(0,3) | BIT(5);
+          if (nat != NAT_External)
+            rwBits &= ~BIT(0);
+          _n.dhcsr = (_n.dhcsr & BITS(16,31)) | (v & rwBits);
+        }
+        break;
 
       case REG_DEMCR_S:
       case REG_DEMCR_NS:
-        return _n.demcr;
+        if ((_n.demcr ^ v) & REG_DEMCR__SDME)
+          _InvalidateExcPriorities();
+        if (nat == NAT_Internal)
+          _n.demcr = v;
+        else {
+          uint32_t roBits = REG_DEMCR__SDME | REG_DEMCR__MON_PEND | REG_DEMCR__MON_EN
+            | BITS( 1, 3) | BITS(12,15) | BITS(21,23) | BITS(25,31);
+          if (!_HaveMainExt())
+            roBits |= REG_DEMCR__MON_REQ | REG_DEMCR__MON_STEP | REG_DEMCR__VC_SFERR | REG_DEMCR__VC_INTERR
+              | REG_DEMCR__VC_BUSERR | REG_DEMCR__VC_STATERR | REG_DEMCR__VC_CHKERR | REG_DEMCR__VC_NOCPERR
+              | REG_DEMCR__VC_MMERR;
+          if (!_HaveSecurityExt() || !_HaveHaltingDebug())
+            roBits |= REG_DEMCR__VC_SFERR;
+          if (!_HaveHaltingDebug())
+            roBits |= REG_DEMCR__VC_HARDERR | REG_DEMCR__VC_INTERR | REG_DEMCR__VC_BUSERR | REG_DEMCR__VC_STATERR
+              | REG_DEMCR__VC_CHKERR | REG_DEMCR__VC_NOCPERR | REG_DEMCR__VC_MMERR | REG_DEMCR__VC_CORERESET;
+          if (_HaveMainExt()) {
+            _SetPending(DebugMonitor, !isNS, !!(v & REG_DEMCR__MON_PEND));
+            _SetEnable (DebugMonitor, !isNS, !!(v & REG_DEMCR__MON_EN));
+          }
+          _n.demcr = v;
+        }
+        break;
 
       case REG_SYST_CSR_S:
         if (_HaveSysTick()) {
-          return _n.systCsrS | PUTBITSM(_SystGetCountFlag(/*ns=*/false, /*clear=*/nat == NAT_SW), REG_SYST_CSR__COUNTFLAG);
-        } else
-          return 0;
+          if (!_SystCalcFreq(false))
+            v |= REG_SYST_CSR__CLKSOURCE;
+          _n.systCsrS = v & BITS(0,2);
+          _SystUpdate(/*ns=*/false, /*clearCount=*/false);
+        }
+        break;
       case REG_SYST_CSR_NS:
-        if (_HaveSysTick() == 2)
-          return _n.systCsrNS | PUTBITSM(_SystGetCountFlag(/*ns=*/true, /*clear=*/nat == NAT_SW), REG_SYST_CSR__COUNTFLAG);
-        else if (_HaveSysTick() == 1 && !!(_n.icsr & REG_ICSR__STTNS))
-          return _n.systCsrS | PUTBITSM(_SystGetCountFlag(/*ns=*/false, /*clear=*/nat == NAT_SW), REG_SYST_CSR__COUNTFLAG);
-        else
-          return 0;
+        if (_HaveSysTick() == 2) {
+          if (!_SystCalcFreq(false))
+            v |= REG_SYST_CSR__CLKSOURCE;
+          _n.systCsrNS = v & BITS(0,2);
+          _SystUpdate(/*ns=*/true, /*clearCount=*/false);
+        } else if (_HaveSysTick() == 1 && !!(_n.icsr & REG_ICSR__STTNS)) {
+          if (!_SystCalcFreq(false))
+            v |= REG_SYST_CSR__CLKSOURCE;
+          _n.systCsrS = v & BITS(0,2);
+          _SystUpdate(/*ns=*/false, /*clearCount=*/false);
+        }
+        break;
+
       case REG_SYST_RVR_S:
-        return _n.systRvrS;
+        if (_HaveSysTick()) {
+          _n.systRvrS = v & BITS(0,23);
+          _SystUpdate(/*ns=*/false, /*clearCount=*/false);
+        }
+        break;
       case REG_SYST_RVR_NS:
-        if (_HaveSysTick() == 2)
-          return _n.systRvrNS;
-        else if (_HaveSysTick() == 1 && !!(_n.icsr & REG_ICSR__STTNS))
-          return _n.systRvrS;
-        else
-          return 0;
+        if (_HaveSysTick() == 2) {
+          _n.systRvrNS = v & BITS(0,23);
+          _SystUpdate(/*ns=*/true, /*clearCount=*/false);
+        } else if (_HaveSysTick() == 1 && !!(_n.icsr & REG_ICSR__STTNS)) {
+          _n.systRvrS = v & BITS(0,23);
+          _SystUpdate(/*ns=*/false, /*clearCount=*/false);
+        }
+        break;
+
       case REG_SYST_CVR_S:
-        return _SystGetCurrent(false);
+        if (_HaveSysTick())
+          _SystUpdate(/*ns=*/false, /*clearCount=*/true);
+        break;
       case REG_SYST_CVR_NS:
         if (_HaveSysTick() == 2)
-          return _SystGetCurrent(true);
+          _SystUpdate(/*ns=*/true, /*clearCount=*/true);
         else if (_HaveSysTick() == 1 && !!(_n.icsr & REG_ICSR__STTNS))
-          return _SystGetCurrent(false);
-        else
-          return 0;
+          _SystUpdate(/*ns=*/false, /*clearCount=*/true);
+        break;
+
       case REG_SYST_CALIB_S:
         if (_HaveSysTick())
-          return _n.systCalibS | REG_SYST_CALIB__NOREF;
-        else
-          return 0;
+          _n.systCalibS = v & (BITS(0,23) | BIT(30));
+        break;
       case REG_SYST_CALIB_NS:
         if (_HaveSysTick() == 2)
-          return _n.systCalibNS | REG_SYST_CALIB__NOREF;
+          _n.systCalibNS = v & (BITS(0,23) | BIT(30));
         else if (_HaveSysTick() == 1 && !!(_n.icsr & REG_ICSR__STTNS))
-          return _n.systCalibS | REG_SYST_CALIB__NOREF;
-        else
-          return 0;
+          _n.systCalibNS = v & (BITS(0,23) | BIT(30));
+        break;
 
       // ----------------------------------------------
+
       default:
-        // REG_NVIC_ISPRn, REG_NVIC_ICPRn
-        if ((baddr >= 0xE000'E200 && baddr < 0xE000'E240) || (baddr >= 0xE000'E280 && baddr < 0xE000'E2C0))
-          return _NestLoadNvicPendingReg((addr/4)&0xF, /*secure=*/!isNS);
+        // REG_FP_COMPn
+        if ((addr >= 0xE000'2008 && addr < 0xE000'2008 + NUM_FPB_COMP*4) && !(addr % 4)) {
+          if (!_NestCheckRegFPB(nat))
+            return;
+
+          _n.fpComp[(addr - 0xE000'2008)/4] = v;
+          return;
+        }
+
+        // REG_NVIC_ICPRn
+        if (baddr >= 0xE000'E280 && baddr < 0xE000'E2C0) {
+          _NestStoreNvicPendingReg((baddr/4)&0xF, v, /*secure=*/!isNS, /*setNotClear=*/false);
+          return;
+        }
+
+        // REG_NVIC_ISPRn
+        if (baddr >= 0xE000'E200 && baddr < 0xE000'E240) {
+          _NestStoreNvicPendingReg((baddr/4)&0xF, v, /*secure=*/!isNS, /*setNotClear=*/true);
+          return;
+        }
+
+        // REG_NVIC_ICERn
+        if (baddr >= 0xE000'E180 && baddr < 0xE000'E1C0) {
+          _NestStoreNvicEnableReg((baddr/4)&0xF, v, /*isSecure=*/!isNS, /*setNotClear=*/false);
+          return;
+        }
+
+        // REG_NVIC_ISERn
+        if (baddr >= 0xE000'E100 && baddr < 0xE000'E140) {
+          _NestStoreNvicEnableReg((baddr/4)&0xF, v, /*isSecure=*/!isNS, /*setNotClear=*/true);
+          return;
+        }
+
+        // REG_NVIC_ITNSn
+        if (addr >= 0xE000E380 && addr < 0xE000E3C0) {
+          uint32_t n    = (addr/4) & 0xF;
+          uint32_t loEx = n*32 + 16;
+          uint32_t hiEx = loEx + 32;
+          uint32_t mask;
+          if (loEx >= NUM_EXC)
+            mask = 0;
+          else {
+            if (hiEx >= NUM_EXC)
+              hiEx = NUM_EXC-1;
+            mask = BITS(0, hiEx-loEx-1);
+          }
+
+          _n.nvicItns[n] = v & mask;
+          return;
+        }
+
+        // REG_NVIC_IPRn
+        if (addr >= 0xE000E400 && addr < 0xE000E5F0) {
+          uint32_t n = (addr - 0xE000E400)/4;
+          uint32_t loEx = n*4 + 16;
+          uint32_t mask = 0;
+          if (loEx < NUM_EXC)
+            mask |= BITS(0, 7);
+          if (loEx+1 < NUM_EXC)
+            mask |= BITS(8,15);
+          if (loEx+2 < NUM_EXC)
+            mask |= BITS(16,23);
+          if (loEx+3 < NUM_EXC)
+            mask |= BITS(24,31);
+
+          _n.nvicIpr[n] = v & mask;
+          return;
+        }
+
+        TRACE("Unsupported nest store 0x%08x <- 0x%08x\n", addr, v);
+    }
+  }
+
+  /* _SystResolve {{{4
+   * ------------
+   */
+  SysTickDevice &_SystResolve(bool ns) {
+    assert(_HaveSysTick());
+    assert(!ns || _HaveSysTick() == 2);
+    return ns ? _sysTickNS : _sysTickS;
+  }
+
+  /* _SystCalcFreq {{{4
+   * -------------
+   */
+  uint64_t _SystCalcFreq(bool clkSource) {
+    return clkSource ? _cfg.SystIntFreq() : _cfg.SystExtFreq();
+  }
+
+  /* _SystGetCountFlag {{{4
+   * -----------------
+   * Get, and optionally clear, the count flag for a SysTick timer.
+   */
+  bool _SystGetCountFlag(bool ns, bool clear) {
+    return _SystResolve(ns).SysTickGetCountFlag(clear);
+  }
+
+  /* _SystGetIntrFlag {{{4
+   * ----------------
+   * Get, and optionally clear, the interrupt flag for a SysTick timer.
+   */
+  bool _SystGetIntrFlag(bool ns, bool clear) {
+    return _SystResolve(ns).SysTickGetIntrFlag(clear);
+  }
+
+  /* _SystGetIntrDeadline {{{4
+   * --------------------
+   * Returns the earliest time at which either SysTick timer may raise its
+   * interrupt.
+   */
+  std::chrono::steady_clock::time_point _SystGetIntrDeadline() {
+    auto deadline = std::chrono::steady_clock::time_point::max();
+    if (_HaveSysTick())
+      deadline = std::min(deadline, _SystResolve(false).SysTickGetIntrDeadline());
+    if (_HaveSysTick() == 2)
+      deadline = std::min(deadline, _SystResolve(true).SysTickGetIntrDeadline());
+    return deadline;
+  }
+
+  /* _SystGetCurrent {{{4
+   * ---------------
+   */
+  uint32_t _SystGetCurrent(bool ns) {
+    return _SystResolve(ns).SysTickGetCurrent();
+  }
+
+  /* _SystUpdate {{{4
+   * -----------
+   */
+  void _SystUpdate(bool ns, bool clearCount) {
+    uint32_t reloadValue = ns ? _n.systRvrNS : _n.systRvrS;
+    uint32_t csr         = ns ? _n.systCsrNS : _n.systCsrS;
+
+    bool enable     = !!(csr & REG_SYST_CSR__ENABLE);
+    bool tickInt    = !!(csr & REG_SYST_CSR__TICKINT);
+    bool clkSource  = !!(csr & REG_SYST_CSR__CLKSOURCE);
 
-        // REG_NVIC_ISERn, REG_NVIC_ICERn
-        if ((baddr >= 0xE000'E100 && baddr < 0xE000'E140) || (baddr >= 0xE000'E180 && baddr < 0xE000'E1C0))
-          return _NestLoadNvicEnableReg((addr/4)&0xF, /*secure=*/!isNS);
+    uint64_t freq = _SystCalcFreq(clkSource);
 
-        // REG_NVIC_IABRn
-        if (baddr >= 0xE000'E300 && baddr < 0xE000'E340)
-          return _NestLoadNvicActiveReg((addr/4)&0xF, /*secure=*/!isNS);
+    auto &st = _SystResolve(ns);
+    st.SysTickSetConfig(enable, tickInt, freq, reloadValue, clearCount ? 0 : -1);
+    _ExcStateChanged();
+  }
 
-        // REG_NVIC_ITNSn
-        if (addr >= 0xE000E380 && addr < 0xE000E3C0)
-          return _n.nvicItns[(addr/4)&0xF];
+  /* LocalMonitor {{{3
+   * ============
+   * Implements an ARMv8-M local monitor for a specific PE.
+   */
+  struct LocalMonitor {
+    LocalMonitor(bool checkAddresses=true) :_checkAddresses(checkAddresses) {}
 
-        // REG_NVIC_IPRn
-        if (addr >= 0xE000E400 && addr < 0xE000E5F0)
-          return _n.nvicIpr[(addr - 0xE000E400)/4];
+    void MarkExclusive(phys_t addr, uint32_t size) {
+      _s.addr = addr;
+      _s.size = size;
+    }
 
-        // REG_FP_COMPn
-        if ((addr >= 0xE000'2008 && addr < 0xE000'2008 + NUM_FPB_COMP*4) && !(addr % 4))
-          return _NestCheckRegFPB(nat) ? _n.fpComp[(addr - 0xE000'2008)/4] : 0;
+    bool IsExclusive(phys_t addr, uint32_t size) {
+      return _s.size && (!_checkAddresses || _s.ContainsAll(addr, size));
+    }
 
-        // "Privileged accesses to unimplemented registers are Res0."
-        // Return 0 for unimplemented registers.
-        return 0;
+    void ClearExclusive() {
+      _s.size = 0;
     }
+
+  private:
+    MonitorState  _s{};
+    bool          _checkAddresses;
+  };
+
+  /* Architectural Support Functions {{{3
+   * ===============================
+   */
+
+  /* _IsSEE {{{4
+   * ------
+   */
+  static bool _IsSEE(const Exception &e) { return e.GetType() == ExceptionType::SEE; }
+
+  /* _IsUNDEFINED {{{4
+   * ------------
+   */
+  static bool _IsUNDEFINED(const Exception &e) { return e.GetType() == ExceptionType::UNDEFINED; }
+
+  /* _IsExceptionTaken {{{4
+   * -----------------
+   */
+  static bool _IsExceptionTaken(const Exception &e) { return e.GetType() == ExceptionType::EndOfInstruction; }
+
+  /* _IsUNPREDICTABLE {{{4
+   * ----------------
+   * Custom.
+   */
+  static bool _IsUNPREDICTABLE(const Exception &e) { return e.GetType() == ExceptionType::UNPREDICTABLE; }
+
+  /* _MaskOrNonMain {{{4
+   * --------------
+   */
+  uint32_t _MaskOrNonMain(uint32_t x, uint32_t maskBits, uint32_t orBits) {
+    if (_HaveMainExt())
+      return x;
+    return (x & ~maskBits) | orBits;
   }
 
-  /* _NestStoreNvicPendingReg {{{4
-   * ------------------------
+  /* InternalLoad32 {{{4
+   * --------------
    */
-  void _NestStoreNvicPendingReg(uint32_t groupNo, uint32_t v, bool isSecure, bool setNotClear) {
-    uint32_t itns   = _n.nvicItns[groupNo];
-    int      limit  = (groupNo == 15) ? 15 : 32;
-    for (int i=0; i<limit; ++i)
-      if (v & BIT(i))
-        _SetPending(16 + groupNo*32 + i, isSecure, setNotClear, true);
+  uint32_t InternalLoad32(phys_t addr) {
+    ASSERT(addr >= 0xE000'0000);
+    return _NestLoad32Actual(addr, NAT_Internal);
   }
 
-  /* _NestStoreNvicEnableReg {{{4
-   * -----------------------
+  /* InternalStore32 {{{4
+   * ---------------
    */
-  void _NestStoreNvicEnableReg(uint32_t groupNo, uint32_t v, bool isSecure, bool setNotClear) {
-    uint32_t itns  = _n.nvicItns[groupNo];
-    int      limit = (groupNo == 15) ? 15 : 32;
-    for (int i=0; i<limit; ++i)
-      if (v & BIT(i))
-        _SetEnable(16 + groupNo*32 + i, isSecure, setNotClear, true);
+  void InternalStore32(phys_t addr, uint32_t v) {
+    ASSERT(addr >= 0xE000'0000);
+    _NestStore32Actual(addr, v, NAT_Internal);
   }
 
-  /* _NestLoadNvicPendingReg {{{4
-   * -----------------------
+  /* InternalMaskOr32 {{{4
+   * ----------------
    */
-  uint32_t _NestLoadNvicPendingReg(uint32_t groupNo, bool isSecure) {
-    uint32_t v      = 0;
-    uint32_t itns   = _n.nvicItns[groupNo];
-    int      limit  = (groupNo == 15) ? 15 : 32;
-    for (int i=0; i<limit; ++i)
-      if (_IsPendingForState(16+groupNo*32+i, isSecure))
-        v |= BIT(i);
-    return v;
+  void InternalMaskOr32(phys_t addr, uint32_t mask, uint32_t or_) {
+    InternalStore32(addr, (InternalLoad32(addr) & ~mask) | or_);
   }
 
-  /* _NestLoadNvicEnableReg {{{4
-   * ----------------------
+  /* InternalOr32 {{{4
+   * ------------
    */
-  uint32_t _NestLoadNvicEnableReg(uint32_t groupNo, bool isSecure) {
-    uint32_t v      = 0;
-    int      limit  = (groupNo == 15) ? 15 : 32;
-    for (int i=0; i<limit; ++i)
-      if (_IsEnabledForState(16+groupNo*32+i, isSecure))
-        v |= BIT(i);
-    return v;
+  void InternalOr32(phys_t addr, uint32_t x) {
+    InternalStore32(addr, InternalLoad32(addr) | x);
   }
 
-  /* _NestLoadNvicActiveReg {{{4
-   * ----------------------
+  /* InternalMask32 {{{4
+   * --------------
    */
-  uint32_t _NestLoadNvicActiveReg(uint32_t groupNo, bool isSecure) {
-    uint32_t v      = 0;
-    uint32_t itns   = _n.nvicItns[groupNo];
-    int      limit  = (groupNo == 15) ? 15 : 32;
-    for (int i=0; i<limit; ++i)
-      if (_IsActiveForState(16+groupNo*32+i, isSecure))
-        v |= BIT(i);
-    return v;
+  void InternalMask32(phys_t addr, uint32_t x) {
+    InternalStore32(addr, InternalLoad32(addr) & ~x);
   }
 
-  /* _NestStore32 {{{4
-   * ------------
+  /* _InternalLoadMpuSecureRegion {{{4
+   * ----------------------------
    */
-  int _NestStore32(phys_t addr, bool isPriv, bool isSecure, uint32_t v) {
-    auto [targetNS, targetRAZWI, targetFault] = _NestAccessClassify(addr, isPriv, isSecure);
+  std::tuple<uint32_t,uint32_t> _InternalLoadMpuSecureRegion(size_t idx) {
+    printf("Bus internal load MPU secure region %zu\n", idx);
+    if (idx >= _NumMpuRegionS())
+      return {0,0}; // {RBAR,RLAR}
 
-    if (targetFault)
-      return -1;
+    return {_n.mpuRbarS[idx], _n.mpuRlarS[idx]};
+  }
 
-    if (targetRAZWI)
-      return 0;
+  /* _InternalLoadMpuNonSecureRegion {{{4
+   * -------------------------------
+   */
+  std::tuple<uint32_t,uint32_t> _InternalLoadMpuNonSecureRegion(size_t idx) {
+    printf("Bus internal load MPU non-secure region %zu\n", idx);
+    if (idx >= _NumMpuRegionNS())
+      return {0,0}; // {RBAR,RLAR}
 
-    if (targetNS)
-      _NestStore32Actual(addr |  0x2'0000U, v, NAT_SW);
-    else
-      _NestStore32Actual(addr & ~0x2'0000U, v, NAT_SW);
+    return {_n.mpuRbarNS[idx], _n.mpuRlarNS[idx]};
+  }
 
-    return 0;
+  /* _InternalLoadSauRegion {{{4
+   * ----------------------
+   */
+  std::tuple<uint32_t,uint32_t> _InternalLoadSauRegion(size_t idx) {
+    printf("Bus internal load SAU region %zu\n", idx);
+    if (idx >= _NumSauRegion())
+      return {0,0}; // {RBAR,RLAR}
+
+    return {_n.sauRbar[idx], _n.sauRlar[idx]};
   }
 
-  /* _NestStore32Actual {{{4
-   * ------------------
+  /* _ThisInstrAddr {{{4
+   * --------------
    */
-  void _NestStore32Actual(phys_t addr, uint32_t v, NestAccessType nat) {
-    phys_t baddr    = addr & ~0x2'0000U;
-    bool   isNS     = !!(addr &  0x2'0000U);
-    if (isNS)
-      ASSERT(_HaveSecurityExt());
+  uint32_t _ThisInstrAddr() { return _s.pc; }
 
-    switch (addr) {
-      case REG_DWT_CTRL:
-        // !DWT:  res0
-        // !Main: might not be SW accessible
-        //
-        // 33222222 22221111 11111100 00000000  r: RO. c: 0 on cold reset. 0: Res0.
-        // 10987654 32109876 54321098 76543210  m: Res0 if !Main. M: Res1 if !Main. p: Res0 if !PRFCNT. t: Res0 if !TRCPKT/!NOCYCCNT. c: Res0 if !CYCCNT. u: Unknown on cold reset.
-        // rrrrr0rr cccccccc 000cuuuu uuuuuuuc
-        //     M MM mmpppppp    tcccc cccccccc
-        //                      c
-        if (_NestCheckRegDWT(nat)) {
-          uint32_t roBits = BITS(13,15) | BITS(24,31);
-          if (_n.dwtCtrl & REG_DWT_CTRL__NOCYCCNT)
-            roBits |= BITS(16,23) | BITS(0,12);
-          if (_n.dwtCtrl & REG_DWT_CTRL__NOTRCPKT)
-            roBits |= BIT (12);
-          if (_n.dwtCtrl & REG_DWT_CTRL__NOPRFCNT)
-            roBits |= BITS(16,21);
-          v &= ~roBits;
-          v |= _n.dwtCtrl & roBits;
-          _n.dwtCtrl = v;
-        }
-        break;
+  /* _ThisInstr {{{4
+   * ----------
+   * Returns a 32-bit value which contains the bitstring encoding of the
+   * current instruction. In the case of 16-bit instructions, the instruction
+   * is packed into the bottom 16 bits with upper 16 bits zeroed. In the case
+   * of 32-bit instructions, the instruction is treated as two halfwords, with
+   * the first halfword of the instruction in the top 16 bits and the second
+   * halfword in the bottom 16 bits.
+   */
+  uint32_t _ThisInstr() { return _s.thisInstr; }
 
-      case REG_DWT_COMP( 0):
-      case REG_DWT_COMP( 1):
-      case REG_DWT_COMP( 2):
-      case REG_DWT_COMP( 3):
-      case REG_DWT_COMP( 4):
-      case REG_DWT_COMP( 5):
-      case REG_DWT_COMP( 6):
-      case REG_DWT_COMP( 7):
-      case REG_DWT_COMP( 8):
-      case REG_DWT_COMP( 9):
-      case REG_DWT_COMP(10):
-      case REG_DWT_COMP(11):
-      case REG_DWT_COMP(12):
-      case REG_DWT_COMP(13):
-      case REG_DWT_COMP(14):
-        if (_NestCheckRegDWT(nat)) {
-          uint32_t n      = (addr - REG_DWT_COMP(0))/16;
-          if (n < NUM_DWT_COMP) {
-            uint32_t roBits = 0;
-            if ((GETBITSM(_n.dwtFunction[n], REG_DWT_FUNCTION__MATCH) & 0b1110) == 0b0010)
-              roBits |= BIT(0);
-            v &= ~roBits;
-            _n.dwtComp[n] = v;
-          }
-        }
-        break;
+  /* _IsSecure {{{4
+   * ---------
+   */
+  bool _IsSecure() { return _HaveSecurityExt() && _s.curState == SecurityState_Secure; }
+
+  /* _HaveMainExt {{{4
+   * ------------
+   */
+  bool _HaveMainExt() { return _cfg.HaveMainExt(); }
 
-      case REG_DWT_FUNCTION( 0):
-      case REG_DWT_FUNCTION( 1):
-      case REG_DWT_FUNCTION( 2):
-      case REG_DWT_FUNCTION( 3):
-      case REG_DWT_FUNCTION( 4):
-      case REG_DWT_FUNCTION( 5):
-      case REG_DWT_FUNCTION( 6):
-      case REG_DWT_FUNCTION( 7):
-      case REG_DWT_FUNCTION( 8):
-      case REG_DWT_FUNCTION( 9):
-      case REG_DWT_FUNCTION(10):
-      case REG_DWT_FUNCTION(11):
-      case REG_DWT_FUNCTION(12):
-      case REG_DWT_FUNCTION(13):
-      case REG_DWT_FUNCTION(14):
-        if (_NestCheckRegDWT(nat)) {
-          uint32_t n      = (addr - REG_DWT_FUNCTION(0))/16;
-          if (n < NUM_DWT_COMP) {
-            uint32_t roBits = BITS( 6, 9) | BITS(12,31);
-            v &= ~roBits;
-            v |= _n.dwtFunction[n] & roBits;
-            _n.dwtFunction[n] = v;
-            if ((GETBITSM(v, REG_DWT_FUNCTION__MATCH) & 0b1110) == 0b0010)
-              _n.dwtComp[n] &= ~1;
-          }
-        }
-        break;
+  /* _HaveSecurityExt {{{4
+   * ----------------
+   */
+  bool _HaveSecurityExt() { return _cfg.HaveSecurityExt(); }
 
-      case REG_FP_CTRL:
-        if (_NestCheckRegFPB(nat) && (v & BIT(1))) {
-          uint32_t roBits = BITS( 1,31);
-          v &= ~roBits;
-          v |= _n.fpCtrl & roBits;
-          _n.fpCtrl = v;
-        }
-        break;
+  /* _SetThisInstrDetails {{{4
+   * --------------------
+   */
+  void _SetThisInstrDetails(uint32_t opcode, int len, uint32_t defaultCond) {
+    _s.thisInstr            = opcode;
+    _s.thisInstrLength      = len;
+    _s.thisInstrDefaultCond = defaultCond;
+    _s.curCondOverride      = -1;
+  }
 
-      case REG_CPPWR_S:
-        if (_HaveMainExt())
-          // TODO make bits for unsupported coprocessors RAZ/WI
-          _n.cppwrS = v & (BITS( 0,15) | BITS(20,23));
-        break;
+  /* _VFPSmallRegisterBank {{{4
+   * ---------------------
+   */
+  bool _VFPSmallRegisterBank() { return false; }
 
-      case REG_CPPWR_NS:
-        if (_HaveMainExt())
-          _n.cppwrNS = v & (BITS( 0,15) | BITS(20,23));
-        break;
+  /* _HaveDebugMonitor {{{4
+   * -----------------
+   */
+  bool _HaveDebugMonitor() { return _HaveMainExt(); }
 
-      case REG_CFSR_S:
-        if (_HaveMainExt()) {
-          if (nat == NAT_Internal)
-            _n.cfsrS = v;
-          else
-            _n.cfsrS &= ~v;
-        }
-        break;
+  /* _MaxExceptionNum {{{4
+   * ----------------
+   */
+  int _MaxExceptionNum() { return _HaveMainExt() ? 511 : 47; }
 
-      case REG_CFSR_NS:
-        if (_HaveMainExt()) {
-          if (nat == NAT_Internal)
-            _n.cfsrNS = v;
-          else
-            _n.cfsrNS &= ~v;
-        }
-        break;
+  /* _GetD {{{4
+   * -----
+   */
+  uint64_t _GetD(int n) {
+    assert(n >= 0 && n <= 31);
+    assert(!(n >= 16 && _VFPSmallRegisterBank())); // UNDEFINED
+    return _s.d[n];
+  }
 
-      case REG_HFSR_S:
-        if (_HaveMainExt()) {
-          if (nat == NAT_Internal)
-            _n.hfsrS = v;
-          else
-            _n.hfsrS &= ~v;
-        }
-        break;
+  /* _SetD {{{4
+   * -----
+   */
+  void _SetD(int n, uint64_t value) {
+    assert(n >= 0 && n <= 31);
+    assert(!(n >= 16 && _VFPSmallRegisterBank())); // UNDEFINED
+    _s.d[n] = value;
+  }
 
-      case REG_HFSR_NS:
-        if (_HaveMainExt()) {
-          if (nat == NAT_Internal)
-            _n.hfsrNS = v;
-          else
-            _n.hfsrNS &= ~v;
-        }
-        break;
+  /* _GetS {{{4
+   * -----
+   */
+  uint32_t _GetS(int n) {
+    assert(n >= 0 && n <= 31);
+    if (!(n%2))
+      return (uint32_t)_GetD(n/2);
+    else
+      return (uint32_t)(_GetD(n/2)>>32);
+  }
 
-      case REG_DFSR_S:
-        if (_HaveMainExt() || _HaveHaltingDebug()) {
-          if (nat == NAT_Internal)
-            _n.dfsrS = v;
-          else
-            _n.dfsrS &= ~v;
-        }
-        break;
+  /* _SetS {{{4
+   * -----
+   */
+  void _SetS(int n, uint32_t value) {
+    assert(n >= 0 && n <= 31);
+    if (!(n%2))
+      _SetD(n/2, (_GetD(n/2) & ~UINT64_C(0xFFFF'FFFF)) | uint64_t(value));
+    else
+      _SetD(n/2, (_GetD(n/2) & ~UINT64_C(0xFFFF'FFFF'0000'0000)) | (uint64_t(value)<<32));
+  }
 
-      case REG_DFSR_NS:
-        if (_HaveMainExt() || _HaveHaltingDebug()) {
-          if (nat == NAT_Internal)
-            _n.dfsrNS = v;
-          else
-            _n.dfsrNS &= ~v;
-        }
-        break;
+  /* _ClearExclusiveLocal {{{4
+   * --------------------
+   */
+  void _ClearExclusiveLocal(int procID) {
+    _lm.ClearExclusive();
+  }
 
-      case REG_MMFAR_S:
-        if (_HaveMainExt() && nat == NAT_Internal)
-          _n.mmfarS = v;
-        break;
+  /* _ProcessorID {{{4
+   * ------------
+   */
+  int _ProcessorID() { return _procID; }
 
-      case REG_MMFAR_NS:
-        if (_HaveMainExt() && nat == NAT_Internal)
-          _n.mmfarNS = v;
-        break;
+  /* _SetEventRegister {{{4
+   * -----------------
+   */
+  void _SetEventRegister() { _s.event = true; }
 
-      case REG_BFAR_S:
-        if (_HaveMainExt() && nat == NAT_Internal)
-          _n.bfarS = v;
-        break;
+  /* _ClearEventRegister {{{4
+   * -------------------
+   */
+  void _ClearEventRegister() { _s.event = false; }
 
-      case REG_BFAR_NS:
-        if (_HaveMainExt() && nat == NAT_Internal)
-          _n.bfarNS = v;
-        break;
+  /* _EventRegistered {{{4
+   * ----------------
+   */
+  bool _EventRegistered() { return _s.event; }
 
-      case REG_SHPR1_S:
-        if (_HaveMainExt()) {
-          v = CHGBITS(v, 0, 7, _NestMaskPrio(GETBITS(v, 0, 7)));
-          v = CHGBITS(v, 8,15, _NestMaskPrio(GETBITS(v, 8,15)));
-          v = CHGBITS(v,16,23, _NestMaskPrio(GETBITS(v,16,23)));
-          v = CHGBITS(v,24,31, _NestMaskPrio(GETBITS(v,24,31)));
-          _n.shpr1S = v;
-        }
-        break;
+  /* _SendEvent {{{4
+   * ----------
+   */
+  void _SendEvent() {
+    // XXX: This is supposed to set the event register of every PE in a multiprocessor system.
+    // The manual does not state whether this should include this PE or not. A literal reading
+    // says yes, so we do so.
+    _SetEventRegister();
+  }
 
-      case REG_SHPR1_NS:
-        if (_HaveMainExt()) {
-          v = CHGBITS(v, 0, 7, _NestMaskPrio(GETBITS(v, 0, 7)));
-          v = CHGBITS(v, 8,15, _NestMaskPrio(GETBITS(v, 8,15)));
-          v = CHGBITS(v,16,23, _NestMaskPrio(GETBITS(v,16,23)));
-          v = CHGBITS(v,24,31, _NestMaskPrio(GETBITS(v,24,31)));
-          _n.shpr1NS = v;
-        }
-        break;
+  /* _InstructionSynchronizationBarrier {{{4
+   * ----------------------------------
+   */
+  void _InstructionSynchronizationBarrier(uint8_t option) {
+    // See _DataMemoryBarrier.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+  }
+
+  /* _DataSynchronizationBarrier {{{4
+   * ---------------------------
+   */
+  void _DataSynchronizationBarrier(uint8_t option) {
+    // See _DataMemoryBarrier.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+  }
+
+  /* _DataMemoryBarrier {{{4
+   * ------------------
+   */
+  void _DataMemoryBarrier(uint8_t option) {
+    // Emulated program has requested a data memory barrier. Though it's very
+    // unlikely with the complexity of the simulator that we will need to
+    // perform such a barrier on the host it's not conceptually impossible, so
+    // we execute a barrier just in case.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+  }
+
+  /* _HaveFPB {{{4
+   * --------
+   */
+  bool _HaveFPB() { return _cfg.HaveFPB(); }
+
+  /* _FPB_BreakpointMatch {{{4
+   * --------------------
+   */
+  void _FPB_BreakpointMatch() {
+    _GenerateDebugEventResponse();
+  }
 
-      case REG_SHPR2_S:
-        v = CHGBITS(v, 0,23, 0);
-        v = CHGBITS(v,24,31, _NestMaskPrio(GETBITS(v,24,31)));
-        _n.shpr2S = v;
-        break;
+  /* _DefaultExcInfo {{{4
+   * ---------------
+   */
+  ExcInfo _DefaultExcInfo() {
+    ExcInfo exc = {};
+    exc.fault       = NoFault;
+    exc.origFault   = NoFault;
+    exc.isSecure    = true;
+    exc.isTerminal  = false;
+    exc.inExcTaken  = false;
+    exc.lockup      = false;
+    exc.termInst    = true;
+    return exc;
+  }
 
-      case REG_SHPR2_NS:
-        v = CHGBITS(v, 0,23, 0);
-        v = CHGBITS(v,24,31, _NestMaskPrio(GETBITS(v,24,31)));
-        _n.shpr2NS = v;
-        break;
+  /* _HaveDWT {{{4
+   * --------
+   */
+  bool _HaveDWT() { return _cfg.HaveDWT(); }
 
-      case REG_SHPR3_S:
-        v = CHGBITS(v, 0, 7, _HaveMainExt() ? _NestMaskPrio(GETBITS(v, 0, 7)) : 0); // TODO DEMCR.SDME
-        v = CHGBITS(v, 8,15, 0);
-        v = CHGBITS(v,16,23, _NestMaskPrio(GETBITS(v,16,23)));
-        v = CHGBITS(v,24,31, _NestMaskPrio(GETBITS(v,24,31))); // TODO Type 1 SysTick
-        _n.shpr3S = v;
-        break;
+  /* _HaveITM {{{4
+   * --------
+   */
+  bool _HaveITM() { return _cfg.HaveITM(); }
 
-      case REG_SHPR3_NS:
-        v = CHGBITS(v, 0, 7, _HaveMainExt() ? _NestMaskPrio(GETBITS(v, 0, 7)) : 0);
-        v = CHGBITS(v, 8,15, 0);
-        v = CHGBITS(v,16,23, _NestMaskPrio(GETBITS(v,16,23)));
-        v = CHGBITS(v,24,31, _NestMaskPrio(GETBITS(v,24,31)));
-        _n.shpr3NS = v;
-        break;
+  /* _HaveFPExt {{{4
+   * ----------
+   */
+  bool _HaveFPExt() { return _cfg.HaveFPExt(); }
 
-      case REG_CCR_S:
-        _n.ccrS     = _MaskOrNonMain((v & 0b1110000011100011011) | BIT(0) | BIT(9),
-          BITS(16,18)|BIT(10)|BIT( 8)|BIT( 4)|BIT( 1), BIT( 3)); break;
+  /* _NoninvasiveDebugAllowed {{{4
+   * ------------------------
+   */
+  bool _NoninvasiveDebugAllowed() {
+    return _ExternalNoninvasiveDebugEnabled() || _HaltingDebugAllowed();
+  }
 
-      case REG_CCR_NS:
-        _n.ccrNS    = _MaskOrNonMain((v & 0b1110000011100011011) | BIT(0) | BIT(9),
-          BITS(16,18)|BIT(10)|BIT( 8)|BIT( 4)|BIT( 1), BIT( 3)); break;
+  /* _SecureNoninvasiveDebugAllowed {{{4
+   * ------------------------------
+   */
+  bool _SecureNoninvasiveDebugAllowed() {
+    if (!_NoninvasiveDebugAllowed())
+      return false;
 
-      case REG_SCR_S:
-        _n.scrS = v & BITS(1,4);
-        break;
+    if (GETBITSM(InternalLoad32(REG_DHCSR), REG_DHCSR__S_SDE))
+      return true;
 
-      case REG_SCR_NS:
-        _n.scrNS = v & BITS(1,4);
-        break;
+    if (GETBITSM(InternalLoad32(REG_DAUTHCTRL), REG_DAUTHCTRL__SPNIDENSEL))
+      return !!GETBITSM(InternalLoad32(REG_DAUTHCTRL), REG_DAUTHCTRL__INTSPNIDEN);
 
-      case REG_AIRCR_S:
-        if (GETBITSM(v, REG_AIRCR__VECTKEY) == 0x05FA) {
-          uint32_t roMask = BIT(15);
-          if (!_HaveMainExt())
-            roMask |= BITS( 8,10);
-          v = CHGBITSM(v, REG_AIRCR__VECTKEY, 0);
-          v &= ~roMask;
-          v |= _n.aircrS;
-          if (v & REG_AIRCR__SYSRESETREQ)
-            _SetPending(Reset, true, true);
-          v &= ~REG_AIRCR__SYSRESETREQ;
-          if (v & REG_AIRCR__VECTCLRACTIVE)
-            ; // TODO
-          v &= ~REG_AIRCR__VECTCLRACTIVE;
-          _n.aircrS = v;
-        }
-        break;
+    return _ExternalSecureNoninvasiveDebugEnabled();
+  }
 
-      case REG_AIRCR_NS:
-        if (GETBITSM(v, REG_AIRCR__VECTKEY) == 0x05FA) {
-          // TODO VECTCLRACTIVE
-          uint32_t roMask = BIT(15) | BIT(14) | BIT(13) | BIT( 1);
-          if (!_HaveMainExt())
-            roMask |= BITS( 8,10);
-          if (_n.aircrS & REG_AIRCR__SYSRESETREQS)
-            roMask |= REG_AIRCR__SYSRESETREQ;
-          v = CHGBITSM(v, REG_AIRCR__VECTKEY, 0);
-          v &= ~roMask;
-          v |= _n.aircrNS;
-          if (v & REG_AIRCR__SYSRESETREQ)
-            _SetPending(Reset, true, true);
-          v &= ~REG_AIRCR__SYSRESETREQ;
-          if (v & REG_AIRCR__VECTCLRACTIVE)
-            ; // TODO
-          v &= ~REG_AIRCR__VECTCLRACTIVE;
-          _n.aircrNS = v;
-        }
-        break;
+  /* _HaltingDebugAllowed {{{4
+   * --------------------
+   */
+  bool _HaltingDebugAllowed() {
+    return _ExternalInvasiveDebugEnabled() || GETBITSM(InternalLoad32(REG_DHCSR), REG_DHCSR__S_HALT);
+  }
 
-      case REG_CPACR_S:
-        _n.cpacrS = v & (BITS(0,15) | BITS(20,23)); // TODO RAZ/WI for unimplemented coprocessors
-        break;
+  /* _ExternalInvasiveDebugEnabled {{{4
+   * -----------------------------
+   */
+  bool _ExternalInvasiveDebugEnabled() {
+    return !!(_dev.DebugPins() & DEBUG_PIN__DBGEN);
+  }
 
-      case REG_CPACR_NS:
-        _n.cpacrNS = v & (BITS(0,15) | BITS(20,23));
-        break;
+  /* _ExternalNoninvasiveDebugEnabled {{{4
+   * --------------------------------
+   */
+  bool _ExternalNoninvasiveDebugEnabled() {
+    return _ExternalInvasiveDebugEnabled() || !!(_dev.DebugPins() & DEBUG_PIN__NIDEN);
+  }
 
-      case REG_NSACR:
-        _n.nsacr = v & (BITS( 0, 7) | BITS(10,11));
-        break;
+  /* _IsDWTEnabled {{{4
+   * -------------
+   */
+  bool _IsDWTEnabled() {
+    return _HaveDWT() && GETBITSM(InternalLoad32(REG_DEMCR), REG_DEMCR__TRCENA) && _NoninvasiveDebugAllowed();
+  }
 
-      case REG_MPU_TYPE_S:
-      case REG_MPU_TYPE_NS:
-        break;
+  /* _SecureHaltingDebugAllowed {{{4
+   * --------------------------
+   */
+  bool _SecureHaltingDebugAllowed() {
+    if (!_HaltingDebugAllowed())
+      return false;
+    else if (InternalLoad32(REG_DAUTHCTRL) & REG_DAUTHCTRL__SPIDENSEL)
+      return !!(InternalLoad32(REG_DAUTHCTRL) & REG_DAUTHCTRL__INTSPIDEN);
+    else
+      return _ExternalSecureInvasiveDebugEnabled();
+  }
 
-      case REG_MPU_CTRL_S:
-        _n.mpuCtrlS = v & BITS(0,2);
-        break;
+  /* _ExternalSecureInvasiveDebugEnabled {{{4
+   * -----------------------------------
+   */
+  bool _ExternalSecureInvasiveDebugEnabled() {
+    return _ExternalInvasiveDebugEnabled() && !!(_dev.DebugPins() & DEBUG_PIN__SPIDEN);
+  }
 
-      case REG_MPU_CTRL_NS:
-        _n.mpuCtrlNS = v & BITS(0,2);
-        break;
+  /* _ExternalSecureNoninvasiveDebugEnabled {{{4
+   * --------------------------------------
+   */
+  bool _ExternalSecureNoninvasiveDebugEnabled() {
+    return _ExternalNoninvasiveDebugEnabled() && !!(_dev.DebugPins() & (DEBUG_PIN__SPIDEN | DEBUG_PIN__SPNIDEN));
+  }
 
-      case REG_MPU_RNR_S:
-        _n.mpuRnrS = v & BITS( 0, 7); // TODO CONSTRAINED UNPREDICTABLE
-        break;
+  /* _NumMpuRegionS {{{4
+   * --------------
+   */
+  uint8_t _NumMpuRegionS() { return _cfg.NumMpuRegionS(); }
 
-      case REG_MPU_RNR_NS:
-        _n.mpuRnrNS = v & BITS( 0, 7); // TODO CONSTRAINED UNPREDICTABLE
-        break;
+  /* _NumMpuRegionNS {{{4
+   * ---------------
+   */
+  uint8_t _NumMpuRegionNS() { return _cfg.NumMpuRegionNS(); }
 
-      case REG_MPU_MAIR0_S:
-        _n.mpuMair0S = v;
-        break;
+  /* _NumSauRegion {{{4
+   * -------------
+   */
+  uint8_t _NumSauRegion() { return _cfg.NumSauRegion(); }
 
-      case REG_MPU_MAIR0_NS:
-        _n.mpuMair0NS = v;
-        break;
+  /* _CurrentCond {{{4
+   * ------------
+   */
+  uint32_t _CurrentCond() {
+    // Defined in ISA manual (ARMv8-M § C1.6.1). This is
+    // based on ITSTATE for most instructions but is specially overriden for
+    // branch instructions. We implement this by always getting this field from
+    // ITSTATE unless this special field is set, which is to be set by our
+    // branch instruction decode.
+    if (_s.curCondOverride >= 0)
+      return _s.curCondOverride & 0xF;
 
-      case REG_MPU_MAIR1_S:
-        _n.mpuMair1S = v;
-        break;
+    return _s.thisInstrDefaultCond;
+  }
 
-      case REG_MPU_MAIR1_NS:
-        _n.mpuMair1NS = v;
-        break;
+  /* _SecureDebugMonitorAllowed {{{4
+   * --------------------------
+   */
+  bool _SecureDebugMonitorAllowed() {
+    if (InternalLoad32(REG_DAUTHCTRL) & REG_DAUTHCTRL__SPIDENSEL)
+      return !!(InternalLoad32(REG_DAUTHCTRL) & REG_DAUTHCTRL__INTSPIDEN);
+    else
+      return _ExternalSecureSelfHostedDebugEnabled();
+  }
 
-      case REG_MPU_RBAR_S:
-        if (_n.mpuRnrS < _NumMpuRegionS())
-          _n.mpuRbarS[_n.mpuRnrS] = v;
-        break;
+  /* _ExternalSecureSelfHostedDebugEnabled {{{4
+   * -------------------------------------
+   */
+  bool _ExternalSecureSelfHostedDebugEnabled() {
+    uint32_t debugPins = _dev.DebugPins();
+    return !!(debugPins & DEBUG_PIN__DBGEN) && !!(debugPins & DEBUG_PIN__SPIDEN);
+  }
+
+  /* _ResetSCSRegs {{{4
+   * -------------
+   */
+  void _ResetSCSRegs() {
+    _NestReset();
+    memset(_s.excEnable, 0, sizeof(_s.excEnable));
+    memset(_s.excPending, 0, sizeof(_s.excPending));
+    _InvalidateExcPriorities();
+  }
 
-      case REG_MPU_RBAR_A1_S:
-        if (_n.mpuRnrS+1 < _NumMpuRegionS())
-          _n.mpuRbarS[_n.mpuRnrS+1] = v;
-        break;
+  /* _IsCPEnabled {{{4
+   * ------------
+   */
+  std::tuple<bool, bool> _IsCPEnabled(int cp) {
+    return _IsCPEnabled(cp, _CurrentModeIsPrivileged(), _IsSecure());
+  }
 
-      case REG_MPU_RBAR_A2_S:
-        if (_n.mpuRnrS+2 < _NumMpuRegionS())
-          _n.mpuRbarS[_n.mpuRnrS+2] = v;
-        break;
+  /* _CurrentModeIsPrivileged {{{4
+   * ------------------------
+   */
+  bool _CurrentModeIsPrivileged() {
+    return _CurrentModeIsPrivileged(_IsSecure());
+  }
+  bool _CurrentModeIsPrivileged(bool isSecure) {
+    bool npriv = isSecure ? GETBITSM(_s.controlS, CONTROL__NPRIV) : GETBITSM(_s.controlNS, CONTROL__NPRIV);
+    return (_CurrentMode() == PEMode_Handler || !npriv);
+  }
 
-      case REG_MPU_RBAR_A3_S:
-        if (_n.mpuRnrS+3 < _NumMpuRegionS())
-          _n.mpuRbarS[_n.mpuRnrS+3] = v;
-        break;
+  /* _CurrentMode {{{4
+   * ------------
+   */
+  PEMode _CurrentMode() {
+    return GETBITSM(_s.xpsr, XPSR__EXCEPTION) == NoFault ? PEMode_Thread : PEMode_Handler;
+  }
 
-      case REG_MPU_RBAR_NS:
-        if (_n.mpuRnrNS < _NumMpuRegionNS())
-          _n.mpuRbarNS[_n.mpuRnrNS] = v;
-        break;
+  /* _ConditionPassed {{{4
+   * ----------------
+   */
+  bool _ConditionPassed() {
+    return _ConditionHolds(_CurrentCond());
+  }
 
-      case REG_MPU_RBAR_A1_NS:
-        if (_n.mpuRnrNS+1 < _NumMpuRegionNS())
-          _n.mpuRbarNS[_n.mpuRnrNS+1] = v;
-        break;
+  /* _GetPC {{{4
+   * ------
+   */
+  uint32_t _GetPC() {
+    return _GetR(15);
+  }
 
-      case REG_MPU_RBAR_A2_NS:
-        if (_n.mpuRnrNS+2 < _NumMpuRegionNS())
-          _n.mpuRbarNS[_n.mpuRnrNS+2] = v;
-        break;
+  /* _ThrowUnaligned {{{4
+   * ---------------
+   * Custom function not corresponding to the ISA manual. Throws unaligned
+   * usage fault. For use implementing UNPREDICTABLE where a permitted
+   * implementation is to raise an UNALIGNED UsageFault.
+   */
+  void _ThrowUnaligned() {
+    InternalOr32(REG_CFSR, REG_CFSR__UFSR__UNALIGNED);
+    auto excInfo = _CreateException(UsageFault, false, false/*UNKNOWN*/);
+    _HandleException(excInfo);
+  }
 
-      case REG_MPU_RBAR_A3_NS:
-        if (_n.mpuRnrNS+3 < _NumMpuRegionNS())
-          _n.mpuRbarNS[_n.mpuRnrNS+3] = v;
-        break;
+  /* _ZeroExtend {{{4
+   * -----------
+   * Exposition only
+   */
+  static uint32_t _ZeroExtend(uint32_t v, uint32_t w) {
+    return v;
+  }
 
-      case REG_MPU_RLAR_S:
-        if (_n.mpuRnrS < _NumMpuRegionS())
-          _n.mpuRlarS[_n.mpuRnrS] = v;
-        break;
+  /* _Align {{{4
+   * ------
+   */
+  static uint32_t _Align(uint32_t x, uint32_t align) {
+    return x & ~(align-1);
+  }
 
-      case REG_MPU_RLAR_A1_S:
-        if (_n.mpuRnrS+1 < _NumMpuRegionS())
-          _n.mpuRlarS[_n.mpuRnrS+1] = v;
-        break;
+  /* _BranchWritePC {{{4
+   * --------------
+   */
+  void _BranchWritePC(uint32_t address) {
+    _BranchTo(address & ~BIT(0));
+  }
 
-      case REG_MPU_RLAR_A2_S:
-        if (_n.mpuRnrS+2 < _NumMpuRegionS())
-          _n.mpuRlarS[_n.mpuRnrS+2] = v;
-        break;
+  /* _ALUWritePC {{{4
+   * -----------
+   */
+  void _ALUWritePC(uint32_t address) {
+    _BranchWritePC(address);
+  }
 
-      case REG_MPU_RLAR_A3_S:
-        if (_n.mpuRnrS+3 < _NumMpuRegionS())
-          _n.mpuRlarS[_n.mpuRnrS+3] = v;
-        break;
+  /* _InITBlock {{{4
+   * ----------
+   */
+  bool _InITBlock() {
+    return !!(_GetITSTATE() & BITS(0,3));
+  }
 
-      case REG_MPU_RLAR_NS:
-        if (_n.mpuRnrNS < _NumMpuRegionNS())
-          _n.mpuRlarNS[_n.mpuRnrNS] = v;
-        break;
+  /* _LastInITBlock {{{4
+   * --------------
+   */
+  bool _LastInITBlock() {
+    return GETBITS(_GetITSTATE(),0,3) == 0b1000;
+  }
 
-      case REG_MPU_RLAR_A1_NS:
-        if (_n.mpuRnrNS+1 < _NumMpuRegionNS())
-          _n.mpuRlarNS[_n.mpuRnrNS+1] = v;
-        break;
+  /* _LSL_C {{{4
+   * ------
+   */
+  static std::tuple<uint32_t, bool> _LSL_C(uint32_t x, int shift) {
+    ASSERT(shift > 0);
 
-      case REG_MPU_RLAR_A2_NS:
-        if (_n.mpuRnrNS+2 < _NumMpuRegionNS())
-          _n.mpuRlarNS[_n.mpuRnrNS+2] = v;
-        break;
+    if (shift == 32)
+      return {0, !!(x & BIT(31))};
 
-      case REG_MPU_RLAR_A3_NS:
-        if (_n.mpuRnrNS+3 < _NumMpuRegionNS())
-          _n.mpuRlarNS[_n.mpuRnrNS+3] = v;
-        break;
+    if (shift > 32)
+      return {0, false};
 
-      case REG_SAU_CTRL:
-        _n.sauCtrl = v & BITS( 0, 1);
-        break;
+    uint32_t result   = x<<shift;
+    bool     carryOut = !!(x & BIT(32-shift));
 
-      case REG_SAU_TYPE:
-        break;
+    return {result, carryOut};
+  }
 
-      case REG_SAU_RNR:
-        if (_NumSauRegion())
-          _n.sauRnr = v & REG_SAU_RNR__REGION;
-        // TODO CONSTRAINED UNPREDICTABLE
-        break;
+  /* _LSR_C {{{4
+   * ------
+   */
+  static std::tuple<uint32_t, bool> _LSR_C(uint32_t x, int shift) {
+    ASSERT(shift > 0);
 
-      case REG_SAU_RBAR:
-        if (_n.sauRnr < _NumSauRegion())
-          _n.sauRbar[_n.sauRnr] = v & ~BITS( 0, 4);
-        break;
+    uint32_t result   = x>>shift;
+    bool     carryOut = !!(x & BIT(shift-1));
 
-      case REG_SAU_RLAR:
-        if (_n.sauRnr < _NumSauRegion())
-          _n.sauRlar[_n.sauRnr] = v & ~BITS( 2, 4);
-        break;
+    return {result, carryOut};
+  }
 
-      case REG_SFSR_S:
-        if (_HaveMainExt()) {
-          if (nat == NAT_Internal)
-            _n.sfsr = v;
-          else
-            _n.sfsr &= ~v;
-        }
-        break;
+  /* _ASR_C {{{4
+   * ------
+   */
+  static std::tuple<uint32_t, bool> _ASR_C(uint32_t x, int shift) {
+    ASSERT(shift > 0);
 
-      case REG_SFAR_S:
-        if (_HaveMainExt())
-          _n.sfar = v;
-        break;
+    int32_t xs = (int32_t)x;
 
-      case REG_VTOR_S:    _n.vtorS    = v & BITS( 7,31); break;
-      case REG_VTOR_NS:   _n.vtorNS   = v & BITS( 7,31); break;
+    uint32_t result   = (uint32_t)(xs>>shift);
+    bool     carryOut = !!(x & BIT(shift-1));
 
-      case REG_DAUTHCTRL:
-        if ((_HaveMainExt() || _HaveHaltingDebug()) && _HaveSecurityExt())
-          _n.dauthCtrl = v & BITS( 0, 3);
-        break;
+    return {result, carryOut};
+  }
 
-      case REG_FPCCR_S:
-        _n.fpccrS   = v & (BITS( 0, 10) | BITS(26,31));
-        break;
+  /* _LSL {{{4
+   * ----
+   */
+  static uint32_t _LSL(uint32_t x, int shift) {
+    ASSERT(shift >= 0);
+    if (!shift)
+      return x;
 
-      case REG_FPCCR_NS: {
-        uint32_t secureOnlyMask = REG_FPCCR__S | REG_FPCCR__SFRDY | REG_FPCCR__TS | REG_FPCCR__CLRONRETS | REG_FPCCR__LSPENS;
-        if (_n.demcr & REG_DEMCR__SDME)
-          secureOnlyMask |= REG_FPCCR__MONRDY;
-        uint32_t bankedBitsMask = REG_FPCCR__LSPACT | REG_FPCCR__USER | REG_FPCCR__THREAD
-          | REG_FPCCR__MMRDY | REG_FPCCR__SPLIMVIOL | REG_FPCCR__UFRDY | REG_FPCCR__ASPEN;
-        uint32_t sharedBitsMask = ~bankedBitsMask;
-        uint32_t roMask = BITS(11,25);
+    auto [result, _] = _LSL_C(x, shift);
+    return result;
+  }
 
-        _n.fpccrS  = (_n.fpccrS & ~(sharedBitsMask & ~secureOnlyMask)) | (v & (sharedBitsMask & ~secureOnlyMask));
-        _n.fpccrNS = v & bankedBitsMask;
-      } break;
+  /* _LSR {{{4
+   * ----
+   */
+  static uint32_t _LSR(uint32_t x, int shift) {
+    ASSERT(shift >= 0);
+    if (!shift)
+      return x;
 
+    auto [result, _] = _LSR_C(x, shift);
+    return result;
+  }
 
-      case REG_FPCAR_S:
-        if (_HaveFPExt())
-          _n.fpcarS = v & ~BITS( 0, 2);
-        break;
+  /* _ROR_C {{{4
+   * ------
+   */
+  static std::tuple<uint32_t, bool> _ROR_C(uint32_t x, int shift) {
+    ASSERT(shift);
+
+    uint32_t m        = shift % 32;
+    uint32_t result   = _LSR(x, m) | _LSL(x, 32-m);
+    bool     carryOut = !!(result & BIT(31));
 
-      case REG_FPCAR_NS:
-        if (_HaveFPExt())
-          _n.fpcarNS = v & ~BITS( 0, 2);
-        break;
+    return {result, carryOut};
+  }
 
-      case REG_FPDSCR_S:  if (_HaveFPExt()) _n.fpdscrS  = v & BITS(22,26); break;
-      case REG_FPDSCR_NS: if (_HaveFPExt()) _n.fpdscrNS = v & BITS(22,26); break;
+  /* _ROR {{{4
+   * ----
+   */
+  static uint32_t _ROR(uint32_t x, int shift) {
+    if (!shift)
+      return x;
 
-      case REG_ICSR_S:
-      case REG_ICSR_NS:
-        // PENDSTSET, PENDSTCLR
-        if (v & (REG_ICSR__PENDSTSET | REG_ICSR__PENDSTCLR))
-           if (   (_HaveSysTick() == 2)
-               || (_HaveSysTick() == 1 && (!(_n.icsr & REG_ICSR__STTNS)) == !isNS))
-             _SetPending(SysTick, !isNS, !!(v & REG_ICSR__PENDSTSET));
-        // PENDSVCLR
-        // PENDSVSET
-        if (v & (REG_ICSR__PENDSVSET | REG_ICSR__PENDSVCLR))
-          _SetPending(PendSV, !isNS, !!(v & REG_ICSR__PENDSVSET), true);
-        // PENDNMICLR
-        // PENDNMISET
-        if (v & (REG_ICSR__PENDNMISET | REG_ICSR__PENDNMICLR))
-          if (!isNS || !!(_n.aircrS & REG_AIRCR__BFHFNMINS))
-            _SetPending(NMI, true, !!(v & REG_ICSR__PENDNMISET), true);
-        if (!isNS) {
-          uint32_t rwMask = 0;
-          if (_HaveSysTick() == 1)
-            rwMask |= REG_ICSR__STTNS;
-          _n.icsr = v & rwMask;
-        }
-        break;
+    auto [result, _] = _ROR_C(x, shift);
+    return result;
+  }
 
-      case REG_SHCSR_S:
-      case REG_SHCSR_NS:
-        // ----- Actives
-        if (_HaveMainExt()) {
-          _SetActive(MemManage, !isNS, !!(v & REG_SHCSR__MEMFAULTACT));
-          _SetActive(BusFault, !isNS, !!(v & REG_SHCSR__BUSFAULTACT));
-        }
-        if (!(v & REG_SHCSR__HARDFAULTACT))
-          _SetActive(HardFault, !isNS, false);
-        if (_HaveMainExt())
-          _SetActive(UsageFault, !isNS, !!(v & REG_SHCSR__USGFAULTACT));
-        if (_HaveMainExt() && _HaveSecurityExt())
-          _SetActive(SecureFault, !isNS, !!(v & REG_SHCSR__SECUREFAULTACT));
-        if (!(v & REG_SHCSR__NMIACT))
-          // TODO: NMIACT: "This field ignores writes if the value being written
-          // is one, AIRCR.BFHFNMINS is zero, the access is from Non-secure state,
-          // the access is not via the NS alias, or the access is from a debugger
-          // when DHCSR.S_SDE is zero. This bit can only be cleared by access
-          // from the Secure state to the NS alias."
-          _SetActive(NMI, !isNS, false);
-        _SetActive(SVCall, !isNS, !!(v & REG_SHCSR__SVCALLACT));
-        if (_HaveMainExt())
-          _SetActive(DebugMonitor, !isNS, !!(v & REG_SHCSR__MONITORACT));
-        _SetActive(PendSV, !isNS, !!(v & REG_SHCSR__PENDSVACT));
-        _SetActive(SysTick, !isNS, !!(v & REG_SHCSR__SYSTICKACT));
+  /* _RRX_C {{{4
+   * ------
+   */
+  static std::tuple<uint32_t, bool> _RRX_C(uint32_t x, bool carryIn) {
+    uint32_t result   = (carryIn ? BIT(31) : 0) | (x>>1);
+    bool    carryOut  = !!(x & BIT(0));
 
-        // ----- Pendings
-        if (_HaveMainExt()) {
-          _SetPending(UsageFault, !isNS, !!(v & REG_SHCSR__USGFAULTPENDED), true);
-          _SetPending(MemManage, !isNS, !!(v & REG_SHCSR__MEMFAULTPENDED), true);
-          _SetPending(BusFault, !isNS, !!(v & REG_SHCSR__BUSFAULTPENDED), true);
-          _SetPending(SVCall, !isNS, !!(v & REG_SHCSR__SVCALLPENDED), true);
-          _SetPending(HardFault, !isNS, !!(v & REG_SHCSR__HARDFAULTPENDED), true);
-          if (_HaveSecurityExt())
-            _SetPending(SecureFault, !isNS, !!(v & REG_SHCSR__SECUREFAULTPENDED), true);
-        }
+    return {result, carryOut};
+  }
 
-        // ----- Enables
-        if (_HaveMainExt()) {
-          _SetEnable(MemManage, !isNS, !!(v & REG_SHCSR__MEMFAULTENA), true);
-          _SetEnable(BusFault, !isNS, !!(v & REG_SHCSR__BUSFAULTENA), true);
-          _SetEnable(UsageFault, !isNS, !!(v & REG_SHCSR__USGFAULTENA), true);
-          if (_HaveSecurityExt())
-            _SetEnable(SecureFault, !isNS, !!(v & REG_SHCSR__SECUREFAULTENA), true);
-        }
-        break;
+  /* _Shift_C {{{4
+   * --------
+   */
+  static std::tuple<uint32_t, bool> _Shift_C(uint32_t value, SRType srType, int amount, bool carryIn) {
+    ASSERT(!(srType == SRType_RRX && amount != 1));
 
-      case REG_DHCSR_S:
-      case REG_DHCSR_NS:
-        if (nat == NAT_Internal)
-          _n.dhcsr = v;
-        else if (GETBITS(v,16,31) == 0xA05F) {
-          uint32_t rwBits = BITS(0,3) | BIT(5);
-          if (nat != NAT_External)
-            rwBits &= ~BIT(0);
-          _n.dhcsr = (_n.dhcsr & BITS(16,31)) | (v & rwBits);
-        }
-        break;
+    if (!amount)
+      return {value, carryIn};
 
-      case REG_DEMCR_S:
-      case REG_DEMCR_NS:
-        if (nat == NAT_Internal)
-          _n.demcr = v;
-        else {
-          uint32_t roBits = REG_DEMCR__SDME | REG_DEMCR__MON_PEND | REG_DEMCR__MON_EN
-            | BITS( 1, 3) | BITS(12,15) | BITS(21,23) | BITS(25,31);
-          if (!_HaveMainExt())
-            roBits |= REG_DEMCR__MON_REQ | REG_DEMCR__MON_STEP | REG_DEMCR__VC_SFERR | REG_DEMCR__VC_INTERR
-              | REG_DEMCR__VC_BUSERR | REG_DEMCR__VC_STATERR | REG_DEMCR__VC_CHKERR | REG_DEMCR__VC_NOCPERR
-              | REG_DEMCR__VC_MMERR;
-          if (!_HaveSecurityExt() || !_HaveHaltingDebug())
-            roBits |= REG_DEMCR__VC_SFERR;
-          if (!_HaveHaltingDebug())
-            roBits |= REG_DEMCR__VC_HARDERR | REG_DEMCR__VC_INTERR | REG_DEMCR__VC_BUSERR | REG_DEMCR__VC_STATERR
-              | REG_DEMCR__VC_CHKERR | REG_DEMCR__VC_NOCPERR | REG_DEMCR__VC_MMERR | REG_DEMCR__VC_CORERESET;
-          if (_HaveMainExt()) {
-            _SetPending(DebugMonitor, !isNS, !!(v & REG_DEMCR__MON_PEND));
-            _SetEnable (DebugMonitor, !isNS, !!(v & REG_DEMCR__MON_EN));
-          }
-          _n.demcr = v;
-        }
+    switch (srType) {
+      case SRType_LSL:
+        return _LSL_C(value, amount);
+      case SRType_LSR:
+        return _LSR_C(value, amount);
+      case SRType_ASR:
+        return _ASR_C(value, amount);
+      case SRType_ROR:
+        return _ROR_C(value, amount);
+      case SRType_RRX:
+        return _RRX_C(value, carryIn);
+      default:
+        UNREACHABLE();
         break;
+    }
+  }
 
-      case REG_SYST_CSR_S:
-        if (_HaveSysTick()) {
-          if (!_SystCalcFreq(false))
-            v |= REG_SYST_CSR__CLKSOURCE;
-          _n.systCsrS = v & BITS(0,2);
-          _SystUpdate(/*ns=*/false, /*clearCount=*/false);
-        }
-        break;
-      case REG_SYST_CSR_NS:
-        if (_HaveSysTick() == 2) {
-          if (!_SystCalcFreq(false))
-            v |= REG_SYST_CSR__CLKSOURCE;
-          _n.systCsrNS = v & BITS(0,2);
-          _SystUpdate(/*ns=*/true, /*clearCount=*/false);
-        } else if (_HaveSysTick() == 1 && !!(_n.icsr & REG_ICSR__STTNS)) {
-          if (!_SystCalcFreq(false))
-            v |= REG_SYST_CSR__CLKSOURCE;
-          _n.systCsrS = v & BITS(0,2);
-          _SystUpdate(/*ns=*/false, /*clearCount=*/false);
-        }
-        break;
+  /* _IsZero {{{4
+   * -------
+   */
+  static bool _IsZero(uint32_t x) {
+    return !x;
+  }
 
-      case REG_SYST_RVR_S:
-        if (_HaveSysTick()) {
-          _n.systRvrS = v & BITS(0,23);
-          _SystUpdate(/*ns=*/false, /*clearCount=*/false);
-        }
-        break;
-      case REG_SYST_RVR_NS:
-        if (_HaveSysTick() == 2) {
-          _n.systRvrNS = v & BITS(0,23);
-          _SystUpdate(/*ns=*/true, /*clearCount=*/false);
-        } else if (_HaveSysTick() == 1 && !!(_n.icsr & REG_ICSR__STTNS)) {
-          _n.systRvrS = v & BITS(0,23);
-          _SystUpdate(/*ns=*/false, /*clearCount=*/false);
-        }
-        break;
+  /* _IsZeroBit {{{4
+   * ----------
+   */
+  static bool _IsZeroBit(uint32_t x) {
+    return _IsZero(x);
+  }
 
-      case REG_SYST_CVR_S:
-        if (_HaveSysTick())
-          _SystUpdate(/*ns=*/false, /*clearCount=*/true);
-        break;
-      case REG_SYST_CVR_NS:
-        if (_HaveSysTick() == 2)
-          _SystUpdate(/*ns=*/true, /*clearCount=*/true);
-        else if (_HaveSysTick() == 1 && !!(_n.icsr & REG_ICSR__STTNS))
-          _SystUpdate(/*ns=*/false, /*clearCount=*/true);
-        break;
+  /* _LookUpRName {{{4
+   * ------------
+   */
+  RName _LookUpRName(int n) {
+    ASSERT(n >= 0 && n <= 15);
+    switch (n) {
+      case  0: return RName0;
+      case  1: return RName1;
+      case  2: return RName2;
+      case  3: return RName3;
+      case  4: return RName4;
+      case  5: return RName5;
+      case  6: return RName6;
+      case  7: return RName7;
+      case  8: return RName8;
+      case  9: return RName9;
+      case 10: return RName10;
+      case 11: return RName11;
+      case 12: return RName12;
+      case 13: return _LookUpSP();
+      case 14: return RName_LR;
+      case 15: return RName_PC;
+      default: UNREACHABLE();
+    }
+  }
 
-      case REG_SYST_CALIB_S:
-        if (_HaveSysTick())
-          _n.systCalibS = v & (BITS(0,23) | BIT(30));
-        break;
-      case REG_SYST_CALIB_NS:
-        if (_HaveSysTick() == 2)
-          _n.systCalibNS = v & (BITS(0,23) | BIT(30));
-        else if (_HaveSysTick() == 1 && !!(_n.icsr & REG_ICSR__STTNS))
-          _n.systCalibNS = v & (BITS(0,23) | BIT(30));
-        break;
+  /* _BranchToNS {{{4
+   * -----------
+   */
+  void _BranchToNS(uint32_t addr) {
+    ASSERT(_HaveSecurityExt() && _IsSecure());
 
-      // ----------------------------------------------
+    _s.xpsr = CHGBITSM(_s.xpsr, XPSR__T, 1);
+    if (!(addr & BIT(0))) {
+      _s.curState = SecurityState_NonSecure;
+      if (_HaveFPExt())
+        _s.controlS = CHGBITSM(_s.controlS, CONTROL__SFPA, 0);
+    }
+
+    _BranchTo(addr & ~BIT(0));
+  }
 
-      default:
-        // REG_FP_COMPn
-        if ((addr >= 0xE000'2008 && addr < 0xE000'2008 + NUM_FPB_COMP*4) && !(addr % 4)) {
-          if (!_NestCheckRegFPB(nat))
-            return;
+  /* _FunctionReturn {{{4
+   * ---------------
+   */
+  ExcInfo _FunctionReturn() {
+    auto exc = _DefaultExcInfo();
 
-          _n.fpComp[(addr - 0xE000'2008)/4] = v;
-          return;
-        }
+    // Pull the return address and IPSR off the Secure stack
+    PEMode    mode      = _CurrentMode();
+    RName     spName    = _LookUpSP_with_security_mode(true, mode);
+    uint32_t  framePtr  = _GetSP(spName);
 
-        // REG_NVIC_ICPRn
-        if (baddr >= 0xE000'E280 && baddr < 0xE000'E2C0) {
-          _NestStoreNvicPendingReg((baddr/4)&0xF, v, /*secure=*/!isNS, /*setNotClear=*/false);
-          return;
-        }
+    if (!_IsAligned(framePtr, 8)) {
+      // XXX(UNPREDICTABLE): This is ultimately called from
+      // _InstructionAdvance() so we do not want to raise an exception here. We
+      // arbitrarily choose to resolve this by masking the low bit sto make the
+      // frame pointer aligned, which feels like a plausible thing a real CPU
+      // might do (TBD).
+      QUIET_UNPREDICTABLE("unaligned frame pointer on function return: 0x%x\n", framePtr);
+      framePtr &= ~7; // (UNPREDICTABLE)
+    }
 
-        // REG_NVIC_ISPRn
-        if (baddr >= 0xE000'E200 && baddr < 0xE000'E240) {
-          _NestStoreNvicPendingReg((baddr/4)&0xF, v, /*secure=*/!isNS, /*setNotClear=*/true);
-          return;
-        }
+    // Only stack locations, not the load order are architected
+    uint32_t newPSR, newPC;
+    if (exc.fault == NoFault) std::tie(exc, newPSR) = _Stack(framePtr, 4, spName, mode);
+    if (exc.fault == NoFault) std::tie(exc, newPC)  = _Stack(framePtr, 0, spName, mode);
 
-        // REG_NVIC_ICERn
-        if (baddr >= 0xE000'E180 && baddr < 0xE000'E1C0) {
-          _NestStoreNvicEnableReg((baddr/4)&0xF, v, /*isSecure=*/!isNS, /*setNotClear=*/false);
-          return;
-        }
+    // Check the IPSR value that has been unstacked is consistent with the current mode,
+    // and being originally called from the Secure state.
+    //
+    // NOTE: It is IMPLEMENTATION DEFINED whether this check is performed before or after
+    // the load of the return address above.
+    if (   exc.fault == NoFault
+        && !(   ( GETBITSM(_s.xpsr, XPSR__EXCEPTION) == 0 && GETBITSM(newPSR, RETPSR__EXCEPTION) == 0)
+             || ( GETBITSM(_s.xpsr, XPSR__EXCEPTION) == 1 && GETBITSM(newPSR, RETPSR__EXCEPTION) != 0))) {
+      if (_HaveMainExt())
+        InternalOr32(REG_CFSR, REG_CFSR__UFSR__INVPC);
 
-        // REG_NVIC_ISERn
-        if (baddr >= 0xE000'E100 && baddr < 0xE000'E140) {
-          _NestStoreNvicEnableReg((baddr/4)&0xF, v, /*isSecure=*/!isNS, /*setNotClear=*/true);
-          return;
-        }
+      // Create the exception. NOTE: If Main Extension not implemented then the fault
+      // always escalates to a HardFault.
+      exc = _CreateException(UsageFault, true, true);
+    }
 
-        // REG_NVIC_ITNSn
-        if (addr >= 0xE000E380 && addr < 0xE000E3C0) {
-          uint32_t n    = (addr/4) & 0xF;
-          uint32_t loEx = n*32 + 16;
-          uint32_t hiEx = loEx + 32;
-          uint32_t mask;
-          if (loEx >= NUM_EXC)
-            mask = 0;
-          else {
-            if (hiEx >= NUM_EXC)
-              hiEx = NUM_EXC-1;
-            mask = BITS(0, hiEx-loEx-1);
-          }
+    // The IPSR value is set as UNKNOWN if the IPSR value is not supported by the PE.
+    uint32_t excNum = GETBITSM(newPSR, XPSR__EXCEPTION);
 
-          _n.nvicItns[n] = v & mask;
-          return;
-        }
+    bool validIPSR = (excNum == 0
+                   || excNum == 1
+                   || excNum == NMI
+                   || excNum == HardFault
+                   || excNum == SVCall
+                   || excNum == PendSV
+                   || excNum == SysTick);
+    if (!validIPSR && _HaveMainExt())
+      validIPSR = (excNum == MemManage
+                || excNum == BusFault
+                || excNum == UsageFault
+                || excNum == SecureFault
+                || excNum == DebugMonitor);
 
-        // REG_NVIC_IPRn
-        if (addr >= 0xE000E400 && addr < 0xE000E5F0) {
-          uint32_t n = (addr/4) & 0xF;
-          uint32_t loEx = n*4 + 16;
-          uint32_t mask = 0;
-          if (loEx < NUM_EXC)
-            mask |= BITS(0, 7);
-          if (loEx+1 < NUM_EXC)
-            mask |= BITS(8,15);
-          if (loEx+2 < NUM_EXC)
-            mask |= BITS(16,23);
-          if (loEx+3 < NUM_EXC)
-            mask |= BITS(24,31);
+    if (!validIPSR && !_IsIrqValid(excNum))
+      newPSR = CHGBITSM(newPSR, RETPSR__EXCEPTION, UNKNOWN_VAL(0));
 
-          _n.nvicIpr[n] = v & mask;
-          return;
-        }
+    // Only consume the function return stack frame and update the XPSR/PC if no
+    // faults occurred.
+    if (exc.fault == NoFault) {
+      // Transition to the Secure state
+      _s.curState = SecurityState_Secure;
+      // Update stack pointer. NOTE: Stack pointer limit not checked on function
+      // return as stack pointer guaranteed to be ascending not descending.
+      _s.r[spName]  = framePtr + 8;
+      _s.xpsr       = CHGBITSM(_s.xpsr, XPSR__EXCEPTION, GETBITSM(newPSR, RETPSR__EXCEPTION));
+      _s.controlS   = CHGBITSM(_s.controlS, CONTROL__SFPA, GETBITSM(newPSR, RETPSR__SFPA));
+      // IT/ICI bits cleared to prevent non-secure code interfering with secure
+      // execution.
+      if (_HaveMainExt())
+        _SetITSTATE(0);
 
-        TRACE("Unsupported nest store 0x%08x <- 0x%08x\n", addr, v);
+      // If EPSR.T == 0, a UsageFault('Invalid State') or a HardFault is taken
+      // on the next instruction depending on whether the Main Extension is
+      // implemented or not.
+      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__T, newPC & BIT(0));
+      _BranchTo(newPC & ~BIT(0));
     }
-  }
 
-  /* _SystResolve {{{4
-   * ------------
-   */
-  SysTickDevice &_SystResolve(bool ns) {
-    assert(_HaveSysTick());
-    assert(!ns || _HaveSysTick() == 2);
-    return ns ? _sysTickNS : _sysTickS;
+    return exc;
   }
 
-  /* _SystCalcFreq {{{4
-   * -------------
+  /* _BXWritePC {{{4
+   * ----------
    */
-  uint64_t _SystCalcFreq(bool clkSource) {
-    return clkSource ? _cfg.SystIntFreq() : _cfg.SystExtFreq();
+  ExcInfo _BXWritePC(uint32_t addr, bool allowNonSecure) {
+    auto exc = _DefaultExcInfo();
+
+    if (_HaveSecurityExt() && (addr & ~BIT(0)) == 0b1111'1110'1111'1111'1111'1111'1111'1110) {
+      // Unlike exception return, any faults raised during a FNC_RETURN
+      // unstacking are raised synchronously with the instruction that
+      // triggered the unstacking.
+      exc = _FunctionReturn();
+    } else if (_CurrentMode() == PEMode_Handler && GETBITS(addr,24,31) == 0xFF) {
+      // The actual exception return is performed when the current instruction
+      // completes. This is because faults that occur during the exception
+      // return are handled differently from faults raised during the
+      // instruction execution.
+      _PendReturnOperation(addr);
+    } else if (_HaveSecurityExt() && _IsSecure() && allowNonSecure) {
+      // If in the Secure state and transitions to the non-secure state are allowed
+      // then the target state is specified by the LSB of the target address.
+      _BranchToNS(addr);
+    } else {
+      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__T, addr & 1);
+      // If EPSR.T == 0 then an exception is taken on the next instruction:
+      // UsageFault('Invalid State') if the Main Extension is implemented;
+      // HardFault otherwise
+      _BranchTo(addr & ~BIT(0));
+    }
+
+    return exc;
   }
 
-  /* _SystGetCountFlag {{{4
-   * -----------------
-   * Get, and optionally clear, the count flag for a SysTick timer.
+  /* _BLXWritePC {{{4
+   * -----------
    */
-  bool _SystGetCountFlag(bool ns, bool clear) {
-    return _SystResolve(ns).SysTickGetCountFlag(clear);
+  void _BLXWritePC(uint32_t addr, bool allowNonSecure) {
+    // If in the Secure state and transitions to the Non-secure state are
+    // allowed then the target state is specified by the LSB of the target
+    // address.
+    if (_HaveSecurityExt() && allowNonSecure && _IsSecure())
+      _BranchToNS(addr);
+    else {
+      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__T, GETBIT(addr, 0));
+      // If EPSR.T == 0 then an exception is taken on the next instruction:
+      // UsageFault('Invalid State') if the Main Extension is implemented;
+      // HardFault otherwise
+      _BranchTo(addr & ~BIT(0));
+    }
   }
 
-  /* _SystGetIntrFlag {{{4
-   * ----------------
-   * Get, and optionally clear, the interrupt flag for a SysTick timer.
+  /* _LoadWritePC {{{4
+   * ------------
    */
-  bool _SystGetIntrFlag(bool ns, bool clear) {
-    return _SystResolve(ns).SysTickGetIntrFlag(clear);
+  void _LoadWritePC(uint32_t addr, int baseReg, uint32_t baseRegVal, bool baseRegUpdate, bool spLimCheck) {
+    RName    regName;
+    uint32_t oldBaseVal;
+
+    if (baseRegUpdate) {
+      regName     = _LookUpRName(baseReg);
+      oldBaseVal  = _GetR(baseReg);
+      if (spLimCheck)
+        _SetRSPCheck(baseReg, baseRegVal);
+      else
+        _SetR(baseReg, baseRegVal);
+    }
+
+    // Attempt to update the PC, which may result in a fault
+    auto excInfo = _BXWritePC(addr, false);
+
+    if (baseRegUpdate && excInfo.fault != NoFault)
+      // Restore the previous base reg value, SP limit checking is not performed
+      _s.r[regName] = oldBaseVal; // _R
+
+    _HandleException(excInfo);
   }
 
-  /* _SystGetCurrent {{{4
-   * ---------------
+  /* _GetPRIMASK {{{4
+   * -----------
    */
-  uint32_t _SystGetCurrent(bool ns) {
-    return _SystResolve(ns).SysTickGetCurrent();
+  uint32_t _GetPRIMASK() {
+    return _IsSecure() ? _s.primaskS : _s.primaskNS;
   }
 
-  /* _SystUpdate {{{4
+  /* _SetPRIMASK {{{4
    * -----------
    */
-  void _SystUpdate(bool ns, bool clearCount) {
-    uint32_t reloadValue = ns ? _n.systRvrNS : _n.systRvrS;
-    uint32_t csr         = ns ? _n.systCsrNS : _n.systCsrS;
-
-    bool enable     = !!(csr & REG_SYST_CSR__ENABLE);
-    bool tickInt    = !!(csr & REG_SYST_CSR__TICKINT);
-    bool clkSource  = !!(csr & REG_SYST_CSR__CLKSOURCE);
-
-    uint64_t freq = _SystCalcFreq(clkSource);
+  void _SetPRIMASK(uint32_t v) {
+    if (_IsSecure())
+      _s.primaskS = v;
+    else
+      _s.primaskNS = v;
+    _ExcStateChanged();
+  }
 
-    auto &st = _SystResolve(ns);
-    st.SysTickSetConfig(enable, tickInt, freq, reloadValue, clearCount ? 0 : -1);
+  /* _GetFAULTMASK {{{4
+   * -------------
+   */
+  uint32_t _GetFAULTMASK() {
+    return _IsSecure() ? _s.faultmaskS : _s.faultmaskNS;
+  }
+
+  /* _SetFAULTMASK {{{4
+   * -------------
+   */
+  void _SetFAULTMASK(uint32_t v) {
+    if (_IsSecure())
+      _s.faultmaskS = v;
+    else
+      _s.faultmaskNS = v;
+    _ExcStateChanged();
   }
 
-  /* LocalMonitor {{{3
-   * ============
-   * Implements an ARMv8-M local monitor for a specific PE.
+  /* _AddWithCarry {{{4
+   * -------------
    */
-  struct LocalMonitor {
-    LocalMonitor(bool checkAddresses=true) :_checkAddresses(checkAddresses) {}
+  std::tuple<uint32_t, bool, bool> _AddWithCarry(uint32_t x, uint32_t y, bool carryIn) {
+    uint32_t unsignedSum;
+    int32_t  signedSum;
+    bool     carryOut, overflow;
 
-    void MarkExclusive(phys_t addr, uint32_t size) {
-      _s.addr = addr;
-      _s.size = size;
-    }
+    carryOut  = __builtin_add_overflow(x, y, &unsignedSum);
+    carryOut |= __builtin_add_overflow(unsignedSum, (uint32_t)carryIn, &unsignedSum);
 
-    bool IsExclusive(phys_t addr, uint32_t size) {
-      return _s.size && (!_checkAddresses || _s.ContainsAll(addr, size));
-    }
+    overflow  = __builtin_add_overflow((int32_t)x, (int32_t)y, &signedSum);
+    overflow |= __builtin_add_overflow(signedSum, (int32_t)carryIn, &signedSum);
 
-    void ClearExclusive() {
-      _s.size = 0;
-    }
+    return {unsignedSum, carryOut, overflow};
+  }
 
-  private:
-    MonitorState  _s{};
-    bool          _checkAddresses;
-  };
+  /* _SignExtend {{{4
+   * -----------
+   * Corresponds to SignExtend(), but has an additional parameter to represent input width.
+   */
+  uint32_t _SignExtend(uint32_t x, uint32_t inWidth, uint32_t outWidth) {
+    if (x & BIT(inWidth-1)) {
+      return x | BITS(inWidth,outWidth-1);
+    } else
+      return x;
+  }
 
-  /* Architectural Support Functions {{{3
-   * ===============================
+  /* _BitCount {{{4
+   * ---------
    */
+  static uint32_t _BitCount(uint32_t x) {
+    return __builtin_popcount(x);
+  }
 
-  /* _IsSEE {{{4
-   * ------
+  /* _T32ExpandImm_C {{{4
+   * ---------------
    */
-  static bool _IsSEE(const Exception &e) { return e.GetType() == ExceptionType::SEE; }
+  static std::tuple<uint32_t, bool> _T32ExpandImm_C(uint32_t imm12, bool carryIn) {
+    if (GETBITS(imm12,10,11) == 0b00) {
+      uint32_t imm32;
+      switch (GETBITS(imm12, 8, 9)) {
+        case 0b00:
+          imm32 = _ZeroExtend(GETBITS(imm12, 0, 7), 32);
+          break;
+        case 0b01:
+          if (GETBITS(imm12, 0, 7) == 0)
+            THROW_UNPREDICTABLE();
+          imm32 = (GETBITS(imm12, 0, 7)<<16) | GETBITS(imm12, 0, 7);
+          break;
+        case 0b10:
+          if (GETBITS(imm12, 0, 7) == 0)
+            THROW_UNPREDICTABLE();
+          imm32 = (GETBITS(imm12, 0, 7)<<24) | (GETBITS(imm12, 0, 7)<<8);
+          break;
+        case 0b11:
+          if (GETBITS(imm12, 0, 7) == 0)
+            THROW_UNPREDICTABLE();
+          imm32 = (GETBITS(imm12, 0, 7)<<24) | (GETBITS(imm12, 0, 7)<<16)
+            | (GETBITS(imm12, 0, 7)<<8) | GETBITS(imm12, 0, 7);
+          break;
+      }
+      return {imm32, carryIn};
+    } else {
+      uint32_t unrotatedValue = _ZeroExtend(BIT(7) | GETBITS(imm12, 0, 6), 32);
+      return _ROR_C(unrotatedValue, GETBITS(imm12, 7, 11));
+    }
+  }
 
-  /* _IsUNDEFINED {{{4
-   * ------------
+  /* _T32ExpandImm {{{4
+   * -------------
    */
-  static bool _IsUNDEFINED(const Exception &e) { return e.GetType() == ExceptionType::UNDEFINED; }
+  uint32_t _T32ExpandImm(uint32_t imm12) {
+    auto [imm32, _] = _T32ExpandImm_C(imm12, _CarryFlag());
+    return imm32;
+  }
 
-  /* _IsExceptionTaken {{{4
-   * -----------------
+  /* _Shift {{{4
+   * ------
    */
-  static bool _IsExceptionTaken(const Exception &e) { return e.GetType() == ExceptionType::EndOfInstruction; }
+  uint32_t _Shift(uint32_t value, SRType srType, int amount, bool carryIn) {
+    auto [result, _] = _Shift_C(value, srType, amount, carryIn);
+    return result;
+  }
 
-  /* _IsUNPREDICTABLE {{{4
-   * ----------------
-   * Custom.
+  /* _DecodeImmShift {{{4
+   * ---------------
    */
-  static bool _IsUNPREDICTABLE(const Exception &e) { return e.GetType() == ExceptionType::UNPREDICTABLE; }
+  std::tuple<SRType, int> _DecodeImmShift(uint32_t srType, uint32_t imm5) {
+    switch (srType) {
+      case 0b00:
+        return {SRType_LSL, imm5};
+      case 0b01:
+        return {SRType_LSR, imm5 ? imm5 : 32};
+      case 0b10:
+        return {SRType_ASR, imm5 ? imm5 : 32};
+      case 0b11:
+        if (!imm5)
+          return {SRType_RRX, 1};
+        else
+          return {SRType_ROR, imm5};
+      default:
+        UNREACHABLE();
+    }
+  }
 
-  /* _MaskOrNonMain {{{4
-   * --------------
+  /* _SetITSTATEAndCommit {{{4
+   * --------------------
    */
-  uint32_t _MaskOrNonMain(uint32_t x, uint32_t maskBits, uint32_t orBits) {
-    if (_HaveMainExt())
-      return x;
-    return (x & ~maskBits) | orBits;
+  void _SetITSTATEAndCommit(uint8_t it) {
+    _s.nextInstrITState = it;
+    _s.itStateChanged = true;
+    _PutITSTATE(it);
   }
 
-  /* InternalLoad32 {{{4
-   * --------------
+  /* _PutITSTATE {{{4
+   * -----------
+   * Writes ITSTATE to XPSR and to its decoded form in CpuState.
    */
-  uint32_t InternalLoad32(phys_t addr) {
-    ASSERT(addr >= 0xE000'0000);
-    return _NestLoad32Actual(addr, NAT_Internal);
+  void _PutITSTATE(uint8_t it) {
+    _s.xpsr   = CHGBITSM(_s.xpsr, XPSR__IT_ICI_LO, it>>2);
+    _s.xpsr   = CHGBITSM(_s.xpsr, XPSR__IT_ICI_HI, it&3);
+    _s.itstate = it;
+    _s.itCond  = _ITCond(it);
   }
 
-  /* InternalStore32 {{{4
-   * ---------------
+  /* _SyncITSTATE {{{4
+   * ------------
+   * Re-derives the decoded ITSTATE in CpuState from XPSR. Must be called
+   * whenever XPSR is written other than via _PutITSTATE.
    */
-  void InternalStore32(phys_t addr, uint32_t v) {
-    ASSERT(addr >= 0xE000'0000);
-    _NestStore32Actual(addr, v, NAT_Internal);
+  void _SyncITSTATE() {
+    _s.itstate = _HaveMainExt() ? (GETBITSM(_s.xpsr, XPSR__IT_ICI_LO)<<2) | GETBITSM(_s.xpsr, XPSR__IT_ICI_HI) : 0;
+    _s.itCond  = _ITCond(_s.itstate);
   }
 
-  /* InternalMaskOr32 {{{4
-   * ----------------
+  /* _ITCond {{{4
+   * -------
+   * Returns the default condition for an instruction executed with the given
+   * ITSTATE.
+   *
+   * XXX: This is exactly as described in the pseudocode. However prose states
+   * that if bits [0:3] are zero but bits [4:7] are not, behaviour is
+   * UNPREDICTABLE. We should consider throwing UNPREDICTABLE in this case.
    */
-  void InternalMaskOr32(phys_t addr, uint32_t mask, uint32_t or_) {
-    InternalStore32(addr, (InternalLoad32(addr) & ~mask) | or_);
+  static constexpr uint8_t _ITCond(uint8_t it) {
+    return !GETBITS(it,0,3) ? 0b1110 : GETBITS(it,4,7);
   }
 
-  /* InternalOr32 {{{4
+  /* _HaveSysTick {{{4
    * ------------
    */
-  void InternalOr32(phys_t addr, uint32_t x) {
-    InternalStore32(addr, InternalLoad32(addr) | x);
-  }
+  int _HaveSysTick() { return _cfg.SysTick(); }
 
-  /* InternalMask32 {{{4
+  /* _NextInstrAddr {{{4
    * --------------
    */
-  void InternalMask32(phys_t addr, uint32_t x) {
-    InternalStore32(addr, InternalLoad32(addr) & ~x);
+  uint32_t _NextInstrAddr() {
+    if (_s.pcChanged)
+      return _s.nextInstrAddr;
+    else
+      return _ThisInstrAddr() + _ThisInstrLength();
   }
 
-  /* _InternalLoadMpuSecureRegion {{{4
-   * ----------------------------
+  /* _ThisInstrLength {{{4
+   * ----------------
    */
-  std::tuple<uint32_t,uint32_t> _InternalLoadMpuSecureRegion(size_t idx) {
-    printf("Bus internal load MPU secure region %zu\n", idx);
-    if (idx >= _NumMpuRegionS())
-      return {0,0}; // {RBAR,RLAR}
-
-    return {_n.mpuRbarS[idx], _n.mpuRlarS[idx]};
-  }
+  int _ThisInstrLength() { return _s.thisInstrLength; }
 
-  /* _InternalLoadMpuNonSecureRegion {{{4
-   * -------------------------------
+  /* _MemAttrFlags {{{4
+   * -------------
+   * Packs the fields of memAttrs other than ns into LS_FLAG__* bits. This is
+   * done once per set of attributes and the result kept in lsFlags.
    */
-  std::tuple<uint32_t,uint32_t> _InternalLoadMpuNonSecureRegion(size_t idx) {
-    printf("Bus internal load MPU non-secure region %zu\n", idx);
-    if (idx >= _NumMpuRegionNS())
-      return {0,0}; // {RBAR,RLAR}
+  static uint32_t _MemAttrFlags(const MemoryAttributes &memAttrs) {
+    uint32_t flags = 0;
 
-    return {_n.mpuRbarNS[idx], _n.mpuRlarNS[idx]};
+    if (memAttrs.memType == MemType_Device)
+      flags |= LS_FLAG__DEVICE;
+    flags |= PUTBITSM(memAttrs.device, LS_FLAG__DEVTYPE__MASK);
+    flags |= PUTBITSM(memAttrs.innerAttrs, LS_FLAG__IATTR__MASK);
+    flags |= PUTBITSM(memAttrs.outerAttrs, LS_FLAG__OATTR__MASK);
+    flags |= PUTBITSM(memAttrs.innerHints, LS_FLAG__IHINT__MASK);
+    flags |= PUTBITSM(memAttrs.outerHints, LS_FLAG__OHINT__MASK);
+    if (memAttrs.innerTransient)
+      flags |= LS_FLAG__ITRANSIENT;
+    if (memAttrs.outerTransient)
+      flags |= LS_FLAG__OTRANSIENT;
+    if (memAttrs.shareable)
+      flags |= LS_FLAG__SHAREABLE;
+    if (memAttrs.outerShareable)
+      flags |= LS_FLAG__OSHAREABLE;
+
+    return flags;
   }
 
-  /* _InternalLoadSauRegion {{{4
-   * ----------------------
+  /* _CalcDescriptorFlags {{{4
+   * --------------------
    */
-  std::tuple<uint32_t,uint32_t> _InternalLoadSauRegion(size_t idx) {
-    printf("Bus internal load SAU region %zu\n", idx);
-    if (idx >= _NumSauRegion())
-      return {0,0}; // {RBAR,RLAR}
+  static inline uint32_t _CalcDescriptorFlags(AddressDescriptor memAddrDesc) {
+    uint32_t flags = memAddrDesc.memAttrs.lsFlags;
 
-    return {_n.sauRbar[idx], _n.sauRlar[idx]};
+    if (memAddrDesc.accAttrs.isWrite)
+      flags |= LS_FLAG__WRITE;
+    if (memAddrDesc.accAttrs.isPriv)
+      flags |= LS_FLAG__PRIV;
+    flags |= PUTBITSM(memAddrDesc.accAttrs.accType, LS_FLAG__ATYPE__MASK);
+    if (memAddrDesc.memAttrs.ns)
+      flags |= LS_FLAG__NS;
+
+    return flags;
   }
 
-  /* _ThisInstrAddr {{{4
-   * --------------
+  /* _Load {{{4
+   * -----
    */
-  uint32_t _ThisInstrAddr() { return _s.pc; }
+  int _Load(AddressDescriptor memAddrDesc, int size, uint32_t &v) {
+    uint32_t perm = memAddrDesc.accAttrs.accType == AccType_IFETCH ? HOST_REGION__EXEC : HOST_REGION__READ;
+    if (const uint8_t *p = _FindHostMem(memAddrDesc.physAddr, size, perm)) {
+      v = 0;
+      memcpy(&v, p, size);
+      return 0;
+    }
 
-  /* _ThisInstr {{{4
-   * ----------
-   * Returns a 32-bit value which contains the bitstring encoding of the
-   * current instruction. In the case of 16-bit instructions, the instruction
-   * is packed into the bottom 16 bits with upper 16 bits zeroed. In the case
-   * of 32-bit instructions, the instruction is treated as two halfwords, with
-   * the first halfword of the instruction in the top 16 bits and the second
-   * halfword in the bottom 16 bits.
-   */
-  uint32_t _ThisInstr() { return _s.thisInstr; }
+    if (memAddrDesc.physAddr >= 0xE000'0000 && memAddrDesc.physAddr < 0xE010'0000) {
+      if (size != 4)
+        // Non-32 bit accesses to SCS are UNPREDICTABLE; generate BusFault.
+        return 1;
 
-  /* _IsSecure {{{4
-   * ---------
+      return _NestLoad32(memAddrDesc.physAddr, memAddrDesc.accAttrs.isPriv, !memAddrDesc.memAttrs.ns, v);
+    }
+
+    return _dev.Load(memAddrDesc.physAddr, size, _CalcDescriptorFlags(memAddrDesc), v);
+  }
+
+  /* _Store {{{4
+   * ------
    */
-  bool _IsSecure() { return _HaveSecurityExt() && _s.curState == SecurityState_Secure; }
+  int _Store(AddressDescriptor memAddrDesc, int size, uint32_t v) {
+    if (memAddrDesc.physAddr >= 0xE000'0000 && memAddrDesc.physAddr < 0xE010'0000) {
+      if (size != 4)
+        // Non-32 bit accesses to SCS are UNPREDICTABLE; generate BusFault.
+        return 1;
 
-  /* _HaveMainExt {{{4
-   * ------------
-   */
-  bool _HaveMainExt() { return _cfg.HaveMainExt(); }
+      // End the current block, and discard all blocks and cached fetch
+      // attributes if the register may affect instruction fetch (SAU_*,
+      // MPU_*, VTOR, etc.)
+      _bc.sync = true;
+      if (!_IsInterruptControlReg(memAddrDesc.physAddr)) {
+        _FlushFetchAttrs();
+        _FlushBlocks();
+      }
+      if (_IsMemoryAttrReg(memAddrDesc.physAddr))
+        _FlushTlb();
 
-  /* _HaveSecurityExt {{{4
-   * ----------------
-   */
-  bool _HaveSecurityExt() { return _cfg.HaveSecurityExt(); }
+      return _NestStore32(memAddrDesc.physAddr, memAddrDesc.accAttrs.isPriv, !memAddrDesc.memAttrs.ns, v);
+    }
 
-  /* _SetThisInstrDetails {{{4
-   * --------------------
-   */
-  void _SetThisInstrDetails(uint32_t opcode, int len, uint32_t defaultCond) {
-    _s.thisInstr            = opcode;
-    _s.thisInstrLength      = len;
-    _s.thisInstrDefaultCond = defaultCond;
-    _s.curCondOverride      = -1;
+    if (_cw.IsWatched(memAddrDesc.physAddr, size))
+      _InvalidateCode(memAddrDesc.physAddr, size);
+
+    if (uint8_t *p = _FindHostMem(memAddrDesc.physAddr, size, HOST_REGION__WRITE)) {
+      memcpy(p, &v, size);
+      _HostStored(p, memAddrDesc.physAddr, size);
+      return 0;
+    }
+
+    int rc = _dev.Store(memAddrDesc.physAddr, size, _CalcDescriptorFlags(memAddrDesc), v);
+    if (!rc)
+      _DeviceStored(memAddrDesc.physAddr, size);
+    return rc;
   }
 
-  /* _VFPSmallRegisterBank {{{4
-   * ---------------------
-   */
-  bool _VFPSmallRegisterBank() { return false; }
+  /* _LoadBurst {{{4
+   * ----------
+   * Loads count words. memAddrDesc.physAddr must be word aligned and the words
+   * must share its attributes. Returns the number of words loaded before the
+   * first error, i.e. count on success.
+   */
+  int _LoadBurst(AddressDescriptor memAddrDesc, int count, uint32_t *v) {
+    phys_t addr = memAddrDesc.physAddr;
+    if (const uint8_t *p = _FindHostMem(addr, 4*count, HOST_REGION__READ)) {
+      memcpy(v, p, 4*count);
+      return count;
+    }
 
-  /* _HaveDebugMonitor {{{4
-   * -----------------
-   */
-  bool _HaveDebugMonitor() { return _HaveMainExt(); }
+    if (addr >= 0xE000'0000 && addr < 0xE010'0000) {
+      for (int i=0; i<count; ++i, memAddrDesc.physAddr += 4)
+        if (_Load(memAddrDesc, 4, v[i]))
+          return i;
 
-  /* _MaxExceptionNum {{{4
-   * ----------------
-   */
-  int _MaxExceptionNum() { return _HaveMainExt() ? 511 : 47; }
+      return count;
+    }
 
-  /* _GetD {{{4
-   * -----
-   */
-  uint64_t _GetD(int n) {
-    assert(n >= 0 && n <= 31);
-    assert(!(n >= 16 && _VFPSmallRegisterBank())); // UNDEFINED
-    return _s.d[n];
+    return _dev.LoadBurst(addr, count, _CalcDescriptorFlags(memAddrDesc), v);
   }
 
-  /* _SetD {{{4
-   * -----
+  /* _StoreBurst {{{4
+   * -----------
+   * Stores count words. Requirements are as for _LoadBurst.
    */
-  void _SetD(int n, uint64_t value) {
-    assert(n >= 0 && n <= 31);
-    assert(!(n >= 16 && _VFPSmallRegisterBank())); // UNDEFINED
-    _s.d[n] = value;
+  int _StoreBurst(AddressDescriptor memAddrDesc, int count, const uint32_t *v) {
+    phys_t addr = memAddrDesc.physAddr;
+    if (addr >= 0xE000'0000 && addr < 0xE010'0000) {
+      for (int i=0; i<count; ++i, memAddrDesc.physAddr += 4)
+        if (_Store(memAddrDesc, 4, v[i]))
+          return i;
+
+      return count;
+    }
+
+    if (_cw.IsWatched(addr, 4*count))
+      _InvalidateCode(addr, 4*count);
+
+    if (uint8_t *p = _FindHostMem(addr, 4*count, HOST_REGION__WRITE)) {
+      memcpy(p, v, 4*count);
+      _HostStored(p, addr, 4*count);
+      return count;
+    }
+
+    int n = _dev.StoreBurst(addr, count, _CalcDescriptorFlags(memAddrDesc), v);
+    if (n > 0)
+      _DeviceStored(addr, 4*n);
+    return n;
   }
 
-  /* _GetS {{{4
-   * -----
+  /* _DeviceStored {{{4
+   * -------------
+   * Reports a store made via the device to the CodeWatches of any other
+   * simulators using it (see IDevice::NotifyStore). Our own cached code has
+   * already been invalidated.
    */
-  uint32_t _GetS(int n) {
-    assert(n >= 0 && n <= 31);
-    if (!(n%2))
-      return (uint32_t)_GetD(n/2);
-    else
-      return (uint32_t)(_GetD(n/2)>>32);
+  void _DeviceStored(phys_t addr, uint32_t size) {
+    if constexpr (std::is_base_of_v<IDevice, Device>)
+      _dev.NotifyStore(addr, size, &_cw);
   }
 
-  /* _SetS {{{4
-   * -----
+  /* _GetMem {{{4
+   * -------
    */
-  void _SetS(int n, uint32_t value) {
-    assert(n >= 0 && n <= 31);
-    if (!(n%2))
-      _SetD(n/2, (_GetD(n/2) & ~UINT64_C(0xFFFF'FFFF)) | uint64_t(value));
+  std::tuple<bool,uint32_t> _GetMem(AddressDescriptor memAddrDesc, int size) {
+    uint32_t v;
+    if (_Load(memAddrDesc, size, v))
+      return {true, 0};
     else
-      _SetD(n/2, (_GetD(n/2) & ~UINT64_C(0xFFFF'FFFF'0000'0000)) | (uint64_t(value)<<32));
+      return {false, v};
   }
 
-  /* _ClearExclusiveLocal {{{4
-   * --------------------
+  /* _SetMem {{{4
+   * -------
    */
-  void _ClearExclusiveLocal(int procID) {
-    _lm.ClearExclusive();
+  bool _SetMem(AddressDescriptor memAddrDesc, int size, uint32_t v) {
+    return !!_Store(memAddrDesc, size, MaskBySize(v, size));
   }
 
-  /* _ProcessorID {{{4
-   * ------------
-   */
-  int _ProcessorID() { return _procID; }
-
-  /* _SetEventRegister {{{4
+  /* _HaveHaltingDebug {{{4
    * -----------------
    */
-  void _SetEventRegister() { _s.event = true; }
+  bool _HaveHaltingDebug() { return _cfg.HaveHaltingDebug(); }
 
-  /* _ClearEventRegister {{{4
-   * -------------------
+  /* _CanHaltOnEvent {{{4
+   * ---------------
    */
-  void _ClearEventRegister() { _s.event = false; }
+  bool _CanHaltOnEvent(bool isSecure) {
+    if (!_HaveSecurityExt())
+      assert(!isSecure);
+    return _HaveHaltingDebug() && _HaltingDebugAllowed() && !!(InternalLoad32(REG_DHCSR) & REG_DHCSR__C_DEBUGEN)
+      && !(InternalLoad32(REG_DHCSR) & REG_DHCSR__S_HALT) && (!isSecure || !!(InternalLoad32(REG_DHCSR) & REG_DHCSR__S_SDE));
+  }
 
-  /* _EventRegistered {{{4
-   * ----------------
+  /* _CanPendMonitorOnEvent {{{4
+   * ----------------------
    */
-  bool _EventRegistered() { return _s.event; }
+  bool _CanPendMonitorOnEvent(bool isSecure, bool checkPri) {
+    if (!_HaveSecurityExt())
+      assert(!isSecure);
+    return _HaveDebugMonitor() && !_CanHaltOnEvent(isSecure)
+      && !!(InternalLoad32(REG_DEMCR) & REG_DEMCR__MON_EN)
+      && !(InternalLoad32(REG_DHCSR) & REG_DHCSR__S_HALT)
+      && (!isSecure || !!(InternalLoad32(REG_DEMCR) & REG_DEMCR__SDME))
+      && (!checkPri || _ExceptionPriority(DebugMonitor, isSecure, true) < _ExecutionPriority());
+  }
 
-  /* _SendEvent {{{4
-   * ----------
+  /* _ThisInstrITState {{{4
+   * -----------------
    */
-  void _SendEvent() {
-    // XXX: This is supposed to set the event register of every PE in a multiprocessor system.
-    // The manual does not state whether this should include this PE or not. A literal reading
-    // says yes, so we do so.
-    _SetEventRegister();
+  uint8_t _ThisInstrITState() {
+    // Always zero if !_HaveMainExt(); see _SyncITSTATE.
+    return _s.itstate;
   }
 
-  /* _InstructionSynchronizationBarrier {{{4
-   * ----------------------------------
+  /* _GetITSTATE {{{4
+   * -----------
    */
-  void _InstructionSynchronizationBarrier(uint8_t option) {
-    // See _DataMemoryBarrier.
-    std::atomic_thread_fence(std::memory_order_seq_cst);
-  }
+  uint8_t _GetITSTATE() { return _ThisInstrITState(); }
 
-  /* _DataSynchronizationBarrier {{{4
-   * ---------------------------
+  /* _SetITSTATE {{{4
+   * -----------
    */
-  void _DataSynchronizationBarrier(uint8_t option) {
-    // See _DataMemoryBarrier.
-    std::atomic_thread_fence(std::memory_order_seq_cst);
+  void _SetITSTATE(uint8_t value) {
+    _s.nextInstrITState = value;
+    _s.itStateChanged = true;
   }
 
-  /* _DataMemoryBarrier {{{4
-   * ------------------
+  /* _GetSP {{{4
+   * ------
    */
-  void _DataMemoryBarrier(uint8_t option) {
-    // Emulated program has requested a data memory barrier. Though it's very
-    // unlikely with the complexity of the simulator that we will need to
-    // perform such a barrier on the host it's not conceptually impossible, so
-    // we execute a barrier just in case.
-    std::atomic_thread_fence(std::memory_order_seq_cst);
+  uint32_t _GetSP(RName spreg) {
+    assert(    spreg == RNameSP_Main_NonSecure
+           || (spreg == RNameSP_Main_Secure       && _HaveSecurityExt())
+           ||  spreg == RNameSP_Process_NonSecure
+           || (spreg == RNameSP_Process_Secure    && _HaveSecurityExt()));
+    return _s.r[spreg] & ~3;
   }
 
-  /* _HaveFPB {{{4
-   * --------
+  /* _SetSP {{{4
+   * ------
    */
-  bool _HaveFPB() { return _cfg.HaveFPB(); }
+  ExcInfo _SetSP(RName spreg, bool excEntry, uint32_t value) {
+    ExcInfo excInfo = _DefaultExcInfo();
+    auto [limit, applyLimit] = _LookUpSPLim(spreg);
+    if (applyLimit && value < limit) {
+      if (excEntry)
+        _s.r[spreg] = limit;
 
-  /* _FPB_BreakpointMatch {{{4
-   * --------------------
-   */
-  void _FPB_BreakpointMatch() {
-    _GenerateDebugEventResponse();
-  }
+      if (_HaveMainExt())
+        InternalOr32(REG_CFSR, REG_CFSR__UFSR__STKOF);
 
-  /* _DefaultExcInfo {{{4
-   * ---------------
-   */
-  ExcInfo _DefaultExcInfo() {
-    ExcInfo exc = {};
-    exc.fault       = NoFault;
-    exc.origFault   = NoFault;
-    exc.isSecure    = true;
-    exc.isTerminal  = false;
-    exc.inExcTaken  = false;
-    exc.lockup      = false;
-    exc.termInst    = true;
-    return exc;
+      excInfo = _CreateException(UsageFault, false, false/*UNKNOWN*/);
+      if (!excEntry)
+        _HandleException(excInfo);
+    } else
+      _s.r[spreg] = value & ~3;
+
+    TRACE("SP(%u) <- 0x%x\n", spreg, _s.r[spreg]);
+    return excInfo;
   }
 
-  /* _HaveDWT {{{4
-   * --------
+  /* _Stack {{{4
+   * ------
    */
-  bool _HaveDWT() { return _cfg.HaveDWT(); }
+  ExcInfo _Stack(uint32_t framePtr, int offset, RName spreg, PEMode mode, uint32_t value) {
+    auto [limit, applyLimit] = _LookUpSPLim(spreg);
+    bool doAccess;
+    if (!applyLimit || framePtr >= limit)
+      doAccess = true;
+    else
+      doAccess = IMPL_DEF_PUSH_NON_VIOL_LOCATIONS;
 
-  /* _HaveITM {{{4
-   * --------
-   */
-  bool _HaveITM() { return _cfg.HaveITM(); }
+    uint32_t addr = framePtr + offset;
+    ExcInfo excInfo;
+    if (doAccess && (!applyLimit || ((addr >= limit)))) {
+      bool secure = (spreg == RNameSP_Main_Secure || spreg == RNameSP_Process_Secure);
+      bool isPriv = secure ? !GETBITSM(_s.controlS, CONTROL__NPRIV) : !GETBITSM(_s.controlNS, CONTROL__NPRIV);
+      isPriv = isPriv || mode == PEMode_Handler;
+      excInfo = _MemA_with_priv_security(addr, 4, AccType_STACK, isPriv, secure, true, value);
+    } else
+      excInfo = _DefaultExcInfo();
 
-  /* _HaveFPExt {{{4
-   * ----------
-   */
-  bool _HaveFPExt() { return _cfg.HaveFPExt(); }
+    return excInfo;
+  }
 
-  /* _NoninvasiveDebugAllowed {{{4
-   * ------------------------
-   */
-  bool _NoninvasiveDebugAllowed() {
-    return _ExternalNoninvasiveDebugEnabled() || _HaltingDebugAllowed();
+  std::tuple<ExcInfo, uint32_t> _Stack(uint32_t framePtr, int offset, RName spreg, PEMode mode) {
+    bool secure = (spreg == RNameSP_Main_Secure || spreg == RNameSP_Process_Secure);
+    bool isPriv = secure ? !(_s.controlS & CONTROL__NPRIV) : !(_s.controlNS & CONTROL__NPRIV);
+    isPriv = isPriv || mode == PEMode_Handler;
+    uint32_t addr = framePtr + offset;
+    auto [excInfo, value] = _MemA_with_priv_security(addr, 4, AccType_STACK, isPriv, secure, true);
+    return {excInfo, value};
   }
 
-  /* _SecureNoninvasiveDebugAllowed {{{4
-   * ------------------------------
+  /* _StackStoreBurst {{{4
+   * ----------------
+   * Equivalent to calling _Stack for count consecutive words in turn, stopping
+   * at the first fault, but using burst transfers.
    */
-  bool _SecureNoninvasiveDebugAllowed() {
-    if (!_NoninvasiveDebugAllowed())
-      return false;
+  ExcInfo _StackStoreBurst(uint32_t framePtr, int offset, RName spreg, PEMode mode, const uint32_t *values, int count) {
+    auto [limit, applyLimit] = _LookUpSPLim(spreg);
+    bool doAccess;
+    if (!applyLimit || framePtr >= limit)
+      doAccess = true;
+    else
+      doAccess = IMPL_DEF_PUSH_NON_VIOL_LOCATIONS;
 
-    if (GETBITSM(InternalLoad32(REG_DHCSR), REG_DHCSR__S_SDE))
-      return true;
+    if (!doAccess)
+      return _DefaultExcInfo();
 
-    if (GETBITSM(InternalLoad32(REG_DAUTHCTRL), REG_DAUTHCTRL__SPNIDENSEL))
-      return !!GETBITSM(InternalLoad32(REG_DAUTHCTRL), REG_DAUTHCTRL__INTSPNIDEN);
+    // Only the locations at or above the limit are accessed.
+    int first = 0;
+    while (applyLimit && first < count && framePtr + offset + 4*first < limit)
+      ++first;
 
-    return _ExternalSecureNoninvasiveDebugEnabled();
+    bool secure = (spreg == RNameSP_Main_Secure || spreg == RNameSP_Process_Secure);
+    bool isPriv = secure ? !GETBITSM(_s.controlS, CONTROL__NPRIV) : !GETBITSM(_s.controlNS, CONTROL__NPRIV);
+    isPriv = isPriv || mode == PEMode_Handler;
+    auto [excInfo, done] = _MemA_StoreBurst(framePtr + offset + 4*first, count - first, AccType_STACK, isPriv, secure, values + first);
+    return excInfo;
   }
 
-  /* _HaltingDebugAllowed {{{4
-   * --------------------
+  /* _StackLoadBurst {{{4
+   * ---------------
+   * As for _StackStoreBurst, for loads. Returns the exception (if any) and the
+   * number of words loaded before it, as for _MemA_LoadBurst.
    */
-  bool _HaltingDebugAllowed() {
-    return _ExternalInvasiveDebugEnabled() || GETBITSM(InternalLoad32(REG_DHCSR), REG_DHCSR__S_HALT);
+  std::tuple<ExcInfo, int> _StackLoadBurst(uint32_t framePtr, int offset, RName spreg, PEMode mode, uint32_t *values, int count) {
+    bool secure = (spreg == RNameSP_Main_Secure || spreg == RNameSP_Process_Secure);
+    bool isPriv = secure ? !(_s.controlS & CONTROL__NPRIV) : !(_s.controlNS & CONTROL__NPRIV);
+    isPriv = isPriv || mode == PEMode_Handler;
+    return _MemA_LoadBurst(framePtr + offset, count, AccType_STACK, isPriv, secure, values);
   }
 
-  /* _ExternalInvasiveDebugEnabled {{{4
-   * -----------------------------
+  /* _GetLR {{{4
+   * ------
    */
-  bool _ExternalInvasiveDebugEnabled() {
-    return !!(_dev.DebugPins() & DEBUG_PIN__DBGEN);
-  }
+  uint32_t _GetLR() { return _GetR(14); }
 
-  /* _ExternalNoninvasiveDebugEnabled {{{4
-   * --------------------------------
+  /* _SetLR {{{4
+   * ------
    */
-  bool _ExternalNoninvasiveDebugEnabled() {
-    return _ExternalInvasiveDebugEnabled() || !!(_dev.DebugPins() & DEBUG_PIN__NIDEN);
-  }
+  void _SetLR(uint32_t v) { _SetR(14, v); }
 
-  /* _IsDWTEnabled {{{4
-   * -------------
+  /* _HaveDSPExt {{{4
+   * -----------
    */
-  bool _IsDWTEnabled() {
-    return _HaveDWT() && GETBITSM(InternalLoad32(REG_DEMCR), REG_DEMCR__TRCENA) && _NoninvasiveDebugAllowed();
+  bool _HaveDSPExt() { return _cfg.HaveDSPExt(); }
+
+  /* _GetR {{{4
+   * -----
+   */
+  uint32_t _GetR(int n) {
+    assert(n >= 0 && n <= 15);
+    switch (n) {
+      case  0: return _s.r[RName0];
+      case  1: return _s.r[RName1];
+      case  2: return _s.r[RName2];
+      case  3: return _s.r[RName3];
+      case  4: return _s.r[RName4];
+      case  5: return _s.r[RName5];
+      case  6: return _s.r[RName6];
+      case  7: return _s.r[RName7];
+      case  8: return _s.r[RName8];
+      case  9: return _s.r[RName9];
+      case 10: return _s.r[RName10];
+      case 11: return _s.r[RName11];
+      case 12: return _s.r[RName12];
+      case 13: return _s.r[_LookUpSP()] & ~3;
+      case 14: return _s.r[RName_LR];
+      case 15: return _s.r[RName_PC] + 4;
+      default: assert(false);
+    }
   }
 
-  /* _SecureHaltingDebugAllowed {{{4
-   * --------------------------
+  /* _SetR {{{4
+   * -----
    */
-  bool _SecureHaltingDebugAllowed() {
-    if (!_HaltingDebugAllowed())
-      return false;
-    else if (InternalLoad32(REG_DAUTHCTRL) & REG_DAUTHCTRL__SPIDENSEL)
-      return !!(InternalLoad32(REG_DAUTHCTRL) & REG_DAUTHCTRL__INTSPIDEN);
-    else
-      return _ExternalSecureInvasiveDebugEnabled();
+  void _SetR(int n, uint32_t v) {
+    assert(n >= 0 && n <= 14);
+    switch (n) {
+      case  0: _s.r[RName0 ] = v; break;
+      case  1: _s.r[RName1 ] = v; break;
+      case  2: _s.r[RName2 ] = v; break;
+      case  3: _s.r[RName3 ] = v; break;
+      case  4: _s.r[RName4 ] = v; break;
+      case  5: _s.r[RName5 ] = v; break;
+      case  6: _s.r[RName6 ] = v; break;
+      case  7: _s.r[RName7 ] = v; break;
+      case  8: _s.r[RName8 ] = v; break;
+      case  9: _s.r[RName9 ] = v; break;
+      case 10: _s.r[RName10] = v; break;
+      case 11: _s.r[RName11] = v; break;
+      case 12: _s.r[RName12] = v; break;
+      case 13:
+        if (IMPL_DEF_SPLIM_CHECK_UNPRED_INSTR)
+          _SetSP(_LookUpSP(), false, v);
+        else
+          _s.r[_LookUpSP()] = v & ~3;
+        break;
+      case 14:
+        _s.r[RName_LR] = v;
+        break;
+    }
   }
 
-  /* _ExternalSecureInvasiveDebugEnabled {{{4
-   * -----------------------------------
+  /* _LookUpSP_with_security_mode {{{4
+   * ----------------------------
    */
-  bool _ExternalSecureInvasiveDebugEnabled() {
-    return _ExternalInvasiveDebugEnabled() && !!(_dev.DebugPins() & DEBUG_PIN__SPIDEN);
+  RName _LookUpSP_with_security_mode(bool isSecure, PEMode mode) {
+    bool spSel;
+
+    if (isSecure)
+      spSel = !!(_s.controlS & CONTROL__SPSEL);
+    else
+      spSel = !!(_s.controlNS & CONTROL__SPSEL);
+
+    if (spSel && mode == PEMode_Thread)
+      return isSecure ? RNameSP_Process_Secure : RNameSP_Process_NonSecure;
+    else
+      return isSecure ? RNameSP_Main_Secure : RNameSP_Main_NonSecure;
   }
 
-  /* _ExternalSecureNoninvasiveDebugEnabled {{{4
-   * --------------------------------------
+  /* _LookUpSP {{{4
+   * ---------
    */
-  bool _ExternalSecureNoninvasiveDebugEnabled() {
-    return _ExternalNoninvasiveDebugEnabled() && !!(_dev.DebugPins() & (DEBUG_PIN__SPIDEN | DEBUG_PIN__SPNIDEN));
+  RName _LookUpSP() {
+    return _LookUpSP_with_security_mode(_IsSecure(), _CurrentMode());
   }
 
-  /* _NumMpuRegionS {{{4
-   * --------------
+  /* _LookUpSPLim {{{4
+   * ------------
    */
-  uint8_t _NumMpuRegionS() { return _cfg.NumMpuRegionS(); }
+  std::tuple<uint32_t, bool> _LookUpSPLim(RName spreg) {
+    uint32_t limit;
+    switch (spreg) {
+      case RNameSP_Main_Secure:
+        limit = _s.msplimS & ~7;
+        break;
+      case RNameSP_Process_Secure:
+        limit = _s.psplimS & ~7;
+        break;
+      case RNameSP_Main_NonSecure:
+        limit = _HaveMainExt() ? (_s.msplimNS & ~7) : 0;
+        break;
+      case RNameSP_Process_NonSecure:
+        limit = _HaveMainExt()? (_s.psplimNS & ~7) : 0;
+        break;
+      default:
+        assert(false);
+    }
 
-  /* _NumMpuRegionNS {{{4
+    bool applyLimit;
+    bool secure = (spreg == RNameSP_Main_Secure || spreg == RNameSP_Process_Secure);
+    assert(!secure || _HaveSecurityExt());
+    if (_HaveMainExt() && _IsReqExcPriNeg(secure)) {
+      bool ignLimit = secure ? (InternalLoad32(REG_CCR_S) & REG_CCR__STKOFHFNMIGN) : (InternalLoad32(REG_CCR_NS) & REG_CCR__STKOFHFNMIGN);
+      applyLimit = !ignLimit;
+    } else
+      applyLimit = true;
+
+    return {limit, applyLimit};
+  }
+
+  /* _IsReqExcPriNeg {{{4
    * ---------------
    */
-  uint8_t _NumMpuRegionNS() { return _cfg.NumMpuRegionNS(); }
+  bool _IsReqExcPriNeg(bool secure) {
+    bool neg = _IsActiveForState(NMI, secure) || _IsActiveForState(HardFault, secure);
+    if (_HaveMainExt()) {
+      uint32_t faultMask = secure ? _s.faultmaskS : _s.faultmaskNS;
+      if (faultMask & 1)
+        neg = true;
+    }
+    return neg;
+  }
 
-  /* _NumSauRegion {{{4
-   * -------------
+  /* _GetSP {{{4
+   * ------
    */
-  uint8_t _NumSauRegion() { return _cfg.NumSauRegion(); }
+  uint32_t _GetSP() { return _GetR(13); }
 
-  /* _CurrentCond {{{4
-   * ------------
+  /* _SetSP {{{4
+   * ------
    */
-  uint32_t _CurrentCond() {
-    // Defined in ISA manual (ARMv8-M § C1.6.1). This is
-    // based on ITSTATE for most instructions but is specially overriden for
-    // branch instructions. We implement this by always getting this field from
-    // ITSTATE unless this special field is set, which is to be set by our
-    // branch instruction decode.
-    if (_s.curCondOverride >= 0)
-      return _s.curCondOverride & 0xF;
+  void _SetSP(uint32_t value) { _SetRSPCheck(13, value); }
 
-    return _s.thisInstrDefaultCond;
-  }
+  /* _GetSP_Main {{{4
+   * -----------
+   */
+  uint32_t _GetSP_Main() { return _IsSecure() ? _GetSP_Main_Secure() : _GetSP_Main_NonSecure(); }
 
-  /* _SecureDebugMonitorAllowed {{{4
-   * --------------------------
+  /* _SetSP_Main {{{4
+   * -----------
    */
-  bool _SecureDebugMonitorAllowed() {
-    if (InternalLoad32(REG_DAUTHCTRL) & REG_DAUTHCTRL__SPIDENSEL)
-      return !!(InternalLoad32(REG_DAUTHCTRL) & REG_DAUTHCTRL__INTSPIDEN);
+  void _SetSP_Main(uint32_t value) {
+    if (_IsSecure())
+      _SetSP_Main_Secure(value);
     else
-      return _ExternalSecureSelfHostedDebugEnabled();
+      _SetSP_Main_NonSecure(value);
   }
 
-  /* _ExternalSecureSelfHostedDebugEnabled {{{4
-   * -------------------------------------
+  /* _GetSP_Main_NonSecure {{{4
+   * ---------------------
    */
-  bool _ExternalSecureSelfHostedDebugEnabled() {
-    uint32_t debugPins = _dev.DebugPins();
-    return !!(debugPins & DEBUG_PIN__DBGEN) && !!(debugPins & DEBUG_PIN__SPIDEN);
+  uint32_t _GetSP_Main_NonSecure() {
+    return _GetSP(RNameSP_Main_NonSecure);
   }
 
-  /* _ResetSCSRegs {{{4
-   * -------------
+  /* _SetSP_Main_NonSecure {{{4
+   * ---------------------
    */
-  void _ResetSCSRegs() {
-    _NestReset();
-    memset(_s.excEnable, 0, sizeof(_s.excEnable));
-    memset(_s.excPending, 0, sizeof(_s.excPending));
+  void _SetSP_Main_NonSecure(uint32_t value) {
+    _SetSP(RNameSP_Main_NonSecure, false, value);
   }
 
-  /* _IsCPEnabled {{{4
-   * ------------
+  /* _SetSP_Main_Secure {{{4
+   * ------------------
    */
-  std::tuple<bool, bool> _IsCPEnabled(int cp) {
-    return _IsCPEnabled(cp, _CurrentModeIsPrivileged(), _IsSecure());
+  void _SetSP_Main_Secure(uint32_t value) {
+    _SetSP(RNameSP_Main_Secure, false, value);
+  }
+
+  /* _GetSP_Main_Secure {{{4
+   * ------------------
+   */
+  uint32_t _GetSP_Main_Secure() {
+    return _GetSP(RNameSP_Main_Secure);
   }
 
-  /* _CurrentModeIsPrivileged {{{4
-   * ------------------------
+  /* _GetSP_Process {{{4
+   * --------------
    */
-  bool _CurrentModeIsPrivileged() {
-    return _CurrentModeIsPrivileged(_IsSecure());
-  }
-  bool _CurrentModeIsPrivileged(bool isSecure) {
-    bool npriv = isSecure ? GETBITSM(_s.controlS, CONTROL__NPRIV) : GETBITSM(_s.controlNS, CONTROL__NPRIV);
-    return (_CurrentMode() == PEMode_Handler || !npriv);
+  uint32_t _GetSP_Process() {
+    return _IsSecure() ? _GetSP_Process_Secure() : _GetSP_Process_NonSecure();
   }
 
-  /* _CurrentMode {{{4
-   * ------------
+  /* _SetSP_Process {{{4
+   * --------------
    */
-  PEMode _CurrentMode() {
-    return GETBITSM(_s.xpsr, XPSR__EXCEPTION) == NoFault ? PEMode_Thread : PEMode_Handler;
+  void _SetSP_Process(uint32_t value) {
+    if (_IsSecure())
+      _SetSP_Process_Secure(value);
+    else
+      _SetSP_Process_NonSecure(value);
   }
 
-  /* _ConditionPassed {{{4
-   * ----------------
+  /* _GetSP_Process_NonSecure {{{4
+   * ------------------------
    */
-  bool _ConditionPassed() {
-    return _ConditionHolds(_CurrentCond());
+  uint32_t _GetSP_Process_NonSecure() {
+    return _GetSP(RNameSP_Process_NonSecure);
   }
 
-  /* _GetPC {{{4
-   * ------
+  /* _SetSP_Process_NonSecure {{{4
+   * ------------------------
    */
-  uint32_t _GetPC() {
-    return _GetR(15);
+  void _SetSP_Process_NonSecure(uint32_t value) {
+    _SetSP(RNameSP_Process_NonSecure, false, value);
   }
 
-  /* _ThrowUnaligned {{{4
-   * ---------------
-   * Custom function not corresponding to the ISA manual. Throws unaligned
-   * usage fault. For use implementing UNPREDICTABLE where a permitted
-   * implementation is to raise an UNALIGNED UsageFault.
+  /* _GetSP_Process_Secure {{{4
+   * ---------------------
    */
-  void _ThrowUnaligned() {
-    InternalOr32(REG_CFSR, REG_CFSR__UFSR__UNALIGNED);
-    auto excInfo = _CreateException(UsageFault, false, false/*UNKNOWN*/);
-    _HandleException(excInfo);
+  uint32_t _GetSP_Process_Secure() {
+    return _GetSP(RNameSP_Process_Secure);
   }
 
-  /* _ZeroExtend {{{4
-   * -----------
-   * Exposition only
+  /* _SetSP_Process_Secure {{{4
+   * ---------------------
    */
-  static uint32_t _ZeroExtend(uint32_t v, uint32_t w) {
-    return v;
+  void _SetSP_Process_Secure(uint32_t value) {
+    _SetSP(RNameSP_Process_Secure, false, value);
   }
 
-  /* _Align {{{4
-   * ------
+  /* _SetRSPCheck {{{4
+   * ------------
    */
-  static uint32_t _Align(uint32_t x, uint32_t align) {
-    return x & ~(align-1);
+  void _SetRSPCheck(int n, uint32_t v) {
+    if (n == 13)
+      _SetSP(_LookUpSP(), false, v);
+    else
+      _SetR(n, v);
   }
 
-  /* _BranchWritePC {{{4
-   * --------------
+  /* _Lockup {{{4
+   * -------
    */
-  void _BranchWritePC(uint32_t address) {
-    _BranchTo(address & ~BIT(0));
+  void _Lockup(bool termInst) {
+    InternalOr32(REG_DHCSR, REG_DHCSR__S_LOCKUP);
+    _BranchToAndCommit(0xEFFF'FFFE);
+    if (termInst)
+      _EndOfInstruction();
   }
 
-  /* _ALUWritePC {{{4
-   * -----------
+  /* _BranchToAndCommit {{{4
+   * ------------------
    */
-  void _ALUWritePC(uint32_t address) {
-    _BranchWritePC(address);
+  void _BranchToAndCommit(uint32_t addr) {
+    _s.r[RName_PC]    = addr & ~1;
+    _s.pcChanged      = true;
+    _s.nextInstrAddr  = addr & ~1;
+    _s.pendingReturnOperation = false;
   }
 
-  /* _InITBlock {{{4
-   * ----------
+  /* _BranchTo {{{4
+   * ---------
    */
-  bool _InITBlock() {
-    return !!(_GetITSTATE() & BITS(0,3));
+  void _BranchTo(uint32_t addr) {
+    _s.nextInstrAddr = addr;
+    _s.pcChanged     = true;
+    _s.pendingReturnOperation = false;
   }
 
-  /* _LastInITBlock {{{4
-   * --------------
+  /* _PendReturnOperation {{{4
+   * --------------------
    */
-  bool _LastInITBlock() {
-    return GETBITS(_GetITSTATE(),0,3) == 0b1000;
+  void _PendReturnOperation(uint32_t retValue) {
+    _s.nextInstrAddr          = retValue;
+    _s.pcChanged              = true;
+    _s.pendingReturnOperation = true;
   }
 
-  /* _LSL_C {{{4
-   * ------
+  /* _IsActiveForState {{{4
+   * -----------------
    */
-  static std::tuple<uint32_t, bool> _LSL_C(uint32_t x, int shift) {
-    ASSERT(shift > 0);
-
-    if (shift == 32)
-      return {0, !!(x & BIT(31))};
-
-    if (shift > 32)
-      return {0, false};
+  bool _IsActiveForState(int exc, bool isSecure) {
+    if (!_HaveSecurityExt())
+      isSecure = false;
 
-    uint32_t result   = x<<shift;
-    bool     carryOut = !!(x & BIT(32-shift));
+    bool active;
+    if (_IsExceptionTargetConfigurable(exc))
+      active = (_s.excActive[exc] && _ExceptionTargetsSecure(exc, isSecure) == isSecure);
+    else {
+      int idx = isSecure ? 0 : 1;
+      active = !!(_s.excActive[exc] & BIT(idx));
+    }
 
-    return {result, carryOut};
+    return active;
   }
 
-  /* _LSR_C {{{4
-   * ------
+  /* _IsPendingForState {{{4
+   * ------------------
+   * XXX
    */
-  static std::tuple<uint32_t, bool> _LSR_C(uint32_t x, int shift) {
-    ASSERT(shift > 0);
+  bool _IsPendingForState(int exc, bool isSecure) {
+    if (!_HaveSecurityExt())
+      isSecure = false;
 
-    uint32_t result   = x>>shift;
-    bool     carryOut = !!(x & BIT(shift-1));
+    bool pending;
+    if (_IsExceptionTargetConfigurable(exc))
+      pending = (_s.excPending[exc] && _ExceptionTargetsSecure(exc, isSecure) == isSecure);
+    else {
+      int idx = isSecure ? 0 : 1;
+      pending = !!(_s.excPending[exc] & BIT(idx));
+    }
 
-    return {result, carryOut};
+    return pending;
   }
 
-  /* _ASR_C {{{4
-   * ------
+  /* _IsEnabledForState {{{4
+   * ------------------
+   * XXX
    */
-  static std::tuple<uint32_t, bool> _ASR_C(uint32_t x, int shift) {
-    ASSERT(shift > 0);
-
-    int32_t xs = (int32_t)x;
+  bool _IsEnabledForState(int exc, bool isSecure) {
+    if (!_HaveSecurityExt())
+      isSecure = false;
 
-    uint32_t result   = (uint32_t)(xs>>shift);
-    bool     carryOut = !!(x & BIT(shift-1));
+    bool enabled;
+    if (_IsExceptionTargetConfigurable(exc))
+      enabled = (_s.excEnable[exc] && _ExceptionTargetsSecure(exc, isSecure) == isSecure);
+    else {
+      int idx = isSecure ? 0 : 1;
+      enabled = !!(_s.excEnable[exc] & BIT(idx));
+    }
 
-    return {result, carryOut};
+    return enabled;
   }
 
-  /* _LSL {{{4
-   * ----
+  /* _IsExceptionTargetConfigurable {{{4
+   * ------------------------------
    */
-  static uint32_t _LSL(uint32_t x, int shift) {
-    ASSERT(shift >= 0);
-    if (!shift)
-      return x;
+  bool _IsExceptionTargetConfigurable(int e) {
+    if (!_HaveSecurityExt())
+      return false;
 
-    auto [result, _] = _LSL_C(x, shift);
-    return result;
+    switch (e) {
+      case NMI: return true;
+      case BusFault: return true;
+      case DebugMonitor: return true;
+      case SysTick: return _HaveSysTick() == 1;
+      default: return e >= 16;
+    }
   }
 
-  /* _LSR {{{4
-   * ----
+  /* _GetVector {{{4
+   * ----------
    */
-  static uint32_t _LSR(uint32_t x, int shift) {
-    ASSERT(shift >= 0);
-    if (!shift)
-      return x;
-
-    auto [result, _] = _LSR_C(x, shift);
-    return result;
+  std::tuple<ExcInfo, uint32_t> _GetVector(int excNo, bool isSecure) {
+    uint32_t vtor = isSecure ? InternalLoad32(REG_VTOR_S) : InternalLoad32(REG_VTOR_NS);
+    uint32_t addr = (vtor & ~BITS(0,6)) + 4*excNo;
+    auto [exc, vector] = _MemA_with_priv_security(addr, 4, AccType_VECTABLE, true, isSecure, true);
+    if (exc.fault != NoFault) {
+      exc.isTerminal = true;
+      exc.fault = HardFault;
+      exc.isSecure = exc.isSecure || !(InternalLoad32(REG_AIRCR) & REG_AIRCR__BFHFNMINS);
+      InternalOr32(REG_HFSR, REG_HFSR__VECTTBL);
+    }
+    return {exc, vector};
   }
 
-  /* _ROR_C {{{4
-   * ------
+  /* _ValidateAddress {{{4
+   * ----------------
+   * If extent is non-null, it receives the last address up to which an access
+   * of the same kind would be validated identically (see _AttrExtent).
    */
-  static std::tuple<uint32_t, bool> _ROR_C(uint32_t x, int shift) {
-    ASSERT(shift);
+  std::tuple<ExcInfo, AddressDescriptor> _ValidateAddress(uint32_t addr, AccType accType, bool isPriv, bool secure, bool isWrite, bool aligned, uint32_t *extent = nullptr) {
+    AddressDescriptor result;
+    Permissions       perms;
+
+    bool    ns            = false; // UNKNOWN
+    ExcInfo excInfo       = _DefaultExcInfo();
+    bool    isInstrFetch  = (accType == AccType_IFETCH);
+
+    uint32_t        ctx = _TlbCacheable(accType) ? _BlockContext() : 0;
+    const TlbEntry *te  = _LookUpTlb(addr, accType, isPriv, secure, ctx);
+
+    bool secureMpu;
+    SAttributes sAttrib{};
+    if (_HaveSecurityExt()) {
+      sAttrib = te ? te->sAttrs : _SecurityCheck(addr, isInstrFetch, secure);
+      if (isInstrFetch) {
+        ns        = sAttrib.ns;
+        secureMpu = !sAttrib.ns;
+        isPriv    = _CurrentModeIsPrivileged(secureMpu);
+      } else {
+        ns        = (!secure || sAttrib.ns);
+        secureMpu = secure;
+      }
+    } else {
+      ns        = true;
+      secureMpu = false;
+    }
 
-    uint32_t m        = shift % 32;
-    uint32_t result   = _LSR(x, m) | _LSL(x, 32-m);
-    bool     carryOut = !!(result & BIT(31));
+    if (te) {
+      result.memAttrs = te->memAttrs;
+      perms           = te->perms;
+      if (extent)
+        *extent = te->extent;
+    } else {
+      std::tie(result.memAttrs, perms) = _MPUCheck(addr, accType, isPriv, secureMpu);
+      if (extent || _TlbCacheable(accType)) {
+        uint32_t ext = isInstrFetch ? (addr | BITS(0,4)) : _AttrExtent(addr, secureMpu);
+        _FillTlb(addr, accType, isPriv, secure, ctx, ext, sAttrib, result.memAttrs, perms);
+        if (extent)
+          *extent = ext;
+      }
+    }
+    result.memAttrs.ns = ns;
 
-    return {result, carryOut};
-  }
+    if (!aligned && result.memAttrs.memType == MemType_Device && perms.apValid) {
+      InternalOr32(REG_CFSR, REG_CFSR__UFSR__UNALIGNED);
+      excInfo = _CreateException(UsageFault, false, false/*UNKNOWN*/);
+    }
 
-  /* _ROR {{{4
-   * ----
-   */
-  static uint32_t _ROR(uint32_t x, int shift) {
-    if (!shift)
-      return x;
+    if (excInfo.fault == NoFault && _HaveSecurityExt()) {
+      bool raiseSecFault = false;
+      if (isInstrFetch) {
+        if (secure) {
+          if (sAttrib.ns) {
+            InternalOr32(REG_SFSR, REG_SFSR__INVTRAN);
+            raiseSecFault = true;
+          }
+        } else {
+          if (!sAttrib.ns && !sAttrib.nsc) {
+            InternalOr32(REG_SFSR, REG_SFSR__INVEP);
+            raiseSecFault = true;
+          }
+        }
+      } else {
+        if (!secure && !sAttrib.ns) {
+          if (_HaveMainExt() && accType != AccType_VECTABLE) {
+            if (accType == AccType_LAZYFP)
+              InternalOr32(REG_SFSR, REG_SFSR__LSPERR);
+            else
+              InternalOr32(REG_SFSR, REG_SFSR__AUVIOL);
+            InternalOr32(REG_SFSR, REG_SFSR__SFARVALID);
+            InternalStore32(REG_SFAR, addr);
+          }
+          raiseSecFault = true;
+        }
+      }
+      if (raiseSecFault)
+        excInfo = _CreateException(SecureFault, true, true);
+    }
 
-    auto [result, _] = _ROR_C(x, shift);
-    return result;
-  }
+    result.physAddr = addr;
+    result.accAttrs.isWrite = isWrite;
+    result.accAttrs.isPriv  = isPriv;
+    result.accAttrs.accType = accType;
 
-  /* _RRX_C {{{4
-   * ------
-   */
-  static std::tuple<uint32_t, bool> _RRX_C(uint32_t x, bool carryIn) {
-    uint32_t result   = (carryIn ? BIT(31) : 0) | (x>>1);
-    bool    carryOut  = !!(x & BIT(0));
+    if (excInfo.fault == NoFault)
+      excInfo = _CheckPermission(perms, addr, accType, isWrite, isPriv, secureMpu);
 
-    return {result, carryOut};
+    return {excInfo, result};
   }
 
-  /* _Shift_C {{{4
-   * --------
+  /* _MemO {{{4
+   * -----
+   * This and the other accessors below report faults via _RaiseFault; callers
+   * must use RETURN_IF_TERMINATED.
    */
-  static std::tuple<uint32_t, bool> _Shift_C(uint32_t value, SRType srType, int amount, bool carryIn) {
-    ASSERT(!(srType == SRType_RRX && amount != 1));
-
-    if (!amount)
-      return {value, carryIn};
+  uint32_t _MemO(uint32_t addr, int size) {
+    auto [excInfo, value] = _MemA_with_priv_security(addr, size, AccType_ORDERED, _FindPriv(), _IsSecure(), true);
+    _RaiseFault(excInfo);
+    return value;
+  }
 
-    switch (srType) {
-      case SRType_LSL:
-        return _LSL_C(value, amount);
-      case SRType_LSR:
-        return _LSR_C(value, amount);
-      case SRType_ASR:
-        return _ASR_C(value, amount);
-      case SRType_ROR:
-        return _ROR_C(value, amount);
-      case SRType_RRX:
-        return _RRX_C(value, carryIn);
-      default:
-        UNREACHABLE();
-        break;
-    }
+  void _MemO(uint32_t addr, int size, uint32_t value) {
+    auto excInfo = _MemA_with_priv_security(addr, size, AccType_ORDERED, _FindPriv(), _IsSecure(), true, value);
+    _RaiseFault(excInfo);
   }
 
-  /* _IsZero {{{4
-   * -------
+  /* _MemU {{{4
+   * -----
    */
-  static bool _IsZero(uint32_t x) {
-    return !x;
+  uint32_t _MemU(uint32_t addr, int size) {
+    if (_HaveMainExt())
+      return _MemU_with_priv(addr, size, _FindPriv());
+    else
+      return _MemA(addr, size);
   }
 
-  /* _IsZeroBit {{{4
-   * ----------
-   */
-  static bool _IsZeroBit(uint32_t x) {
-    return _IsZero(x);
+  void _MemU(uint32_t addr, int size, uint32_t value) {
+    if (_HaveMainExt())
+      _MemU_with_priv(addr, size, _FindPriv(), value);
+    else
+      _MemA(addr, size, value);
   }
 
-  /* _LookUpRName {{{4
+  /* _MemU_unpriv {{{4
    * ------------
    */
-  RName _LookUpRName(int n) {
-    ASSERT(n >= 0 && n <= 15);
-    switch (n) {
-      case  0: return RName0;
-      case  1: return RName1;
-      case  2: return RName2;
-      case  3: return RName3;
-      case  4: return RName4;
-      case  5: return RName5;
-      case  6: return RName6;
-      case  7: return RName7;
-      case  8: return RName8;
-      case  9: return RName9;
-      case 10: return RName10;
-      case 11: return RName11;
-      case 12: return RName12;
-      case 13: return _LookUpSP();
-      case 14: return RName_LR;
-      case 15: return RName_PC;
-      default: UNREACHABLE();
-    }
+  uint32_t _MemU_unpriv(uint32_t addr, int size) {
+    return _MemU_with_priv(addr, size, false);
   }
 
-  /* _BranchToNS {{{4
-   * -----------
-   */
-  void _BranchToNS(uint32_t addr) {
-    ASSERT(_HaveSecurityExt() && _IsSecure());
-
-    _s.xpsr = CHGBITSM(_s.xpsr, XPSR__T, 1);
-    if (!(addr & BIT(0))) {
-      _s.curState = SecurityState_NonSecure;
-      if (_HaveFPExt())
-        _s.controlS = CHGBITSM(_s.controlS, CONTROL__SFPA, 0);
-    }
-
-    _BranchTo(addr & ~BIT(0));
+  void _MemU_unpriv(uint32_t addr, int size, uint32_t value) {
+    _MemU_with_priv(addr, size, false, value);
   }
 
-  /* _FunctionReturn {{{4
+  /* _MemU_with_priv {{{4
    * ---------------
    */
-  ExcInfo _FunctionReturn() {
-    auto exc = _DefaultExcInfo();
-
-    // Pull the return address and IPSR off the Secure stack
-    PEMode    mode      = _CurrentMode();
-    RName     spName    = _LookUpSP_with_security_mode(true, mode);
-    uint32_t  framePtr  = _GetSP(spName);
-
-    if (!_IsAligned(framePtr, 8)) {
-      // XXX(UNPREDICTABLE): This is ultimately called from
-      // _InstructionAdvance() so we do not want to raise an exception here. We
-      // arbitrarily choose to resolve this by masking the low bit sto make the
-      // frame pointer aligned, which feels like a plausible thing a real CPU
-      // might do (TBD).
-      QUIET_UNPREDICTABLE("unaligned frame pointer on function return: 0x%x\n", framePtr);
-      framePtr &= ~7; // (UNPREDICTABLE)
-    }
-
-    // Only stack locations, not the load order are architected
-    uint32_t newPSR, newPC;
-    if (exc.fault == NoFault) std::tie(exc, newPSR) = _Stack(framePtr, 4, spName, mode);
-    if (exc.fault == NoFault) std::tie(exc, newPC)  = _Stack(framePtr, 0, spName, mode);
-
-    // Check the IPSR value that has been unstacked is consistent with the current mode,
-    // and being originally called from the Secure state.
-    //
-    // NOTE: It is IMPLEMENTATION DEFINED whether this check is performed before or after
-    // the load of the return address above.
-    if (   exc.fault == NoFault
-        && !(   ( GETBITSM(_s.xpsr, XPSR__EXCEPTION) == 0 && GETBITSM(newPSR, RETPSR__EXCEPTION) == 0)
-             || ( GETBITSM(_s.xpsr, XPSR__EXCEPTION) == 1 && GETBITSM(newPSR, RETPSR__EXCEPTION) != 0))) {
-      if (_HaveMainExt())
-        InternalOr32(REG_CFSR, REG_CFSR__UFSR__INVPC);
+  uint32_t _MemU_with_priv(uint32_t addr, int size, bool priv) {
+    uint32_t value = 0;
 
-      // Create the exception. NOTE: If Main Extension not implemented then the fault
-      // always escalates to a HardFault.
-      exc = _CreateException(UsageFault, true, true);
+    // Do aligned access, take alignment fault, or do sequence of bytes
+    if (addr == _Align(addr, size)) {
+      value = _MemA_with_priv(addr, size, priv, true);
+    } else if (InternalLoad32(REG_CCR) & REG_CCR__UNALIGN_TRP) {
+      InternalOr32(REG_CFSR, REG_CFSR__UFSR__UNALIGNED);
+      auto excInfo = _CreateException(UsageFault, false, UNKNOWN_VAL(false));
+      _RaiseFault(excInfo);
+    } else { // if unaligned access
+      for (int i=0; i<size && !_s.instrTerminated; ++i)
+        value = CHGBITS(value, 8*i, 8*i+7, _MemA_with_priv(addr+i, 1, priv, false));
+      // PPB (0xE0000000 to 0xE0100000) is always little endian
+      if ((InternalLoad32(REG_AIRCR) & REG_AIRCR__ENDIANNESS) && GETBITS(addr,20,31) != 0xE00)
+        value = _BigEndianReverse(value, size);
     }
 
-    // The IPSR value is set as UNKNOWN if the IPSR value is not supported by the PE.
-    uint32_t excNum = GETBITSM(newPSR, XPSR__EXCEPTION);
-
-    bool validIPSR = (excNum == 0
-                   || excNum == 1
-                   || excNum == NMI
-                   || excNum == HardFault
-                   || excNum == SVCall
-                   || excNum == PendSV
-                   || excNum == SysTick);
-    if (!validIPSR && _HaveMainExt())
-      validIPSR = (excNum == MemManage
-                || excNum == BusFault
-                || excNum == UsageFault
-                || excNum == SecureFault
-                || excNum == DebugMonitor);
-
-    if (!validIPSR && !_IsIrqValid(excNum))
-      newPSR = CHGBITSM(newPSR, RETPSR__EXCEPTION, UNKNOWN_VAL(0));
-
-    // Only consume the function return stack frame and update the XPSR/PC if no
-    // faults occurred.
-    if (exc.fault == NoFault) {
-      // Transition to the Secure state
-      _s.curState = SecurityState_Secure;
-      // Update stack pointer. NOTE: Stack pointer limit not checked on function
-      // return as stack pointer guaranteed to be ascending not descending.
-      _s.r[spName]  = framePtr + 8;
-      _s.xpsr       = CHGBITSM(_s.xpsr, XPSR__EXCEPTION, GETBITSM(newPSR, RETPSR__EXCEPTION));
-      _s.controlS   = CHGBITSM(_s.controlS, CONTROL__SFPA, GETBITSM(newPSR, RETPSR__SFPA));
-      // IT/ICI bits cleared to prevent non-secure code interfering with secure
-      // execution.
-      if (_HaveMainExt())
-        _SetITSTATE(0);
+    return value;
+  }
 
-      // If EPSR.T == 0, a UsageFault('Invalid State') or a HardFault is taken
-      // on the next instruction depending on whether the Main Extension is
-      // implemented or not.
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__T, newPC & BIT(0));
-      _BranchTo(newPC & ~BIT(0));
+  void _MemU_with_priv(uint32_t addr, int size, bool priv, uint32_t value) {
+    // Do aligned access, take alignment fault, or do sequence of bytes
+    if (addr == _Align(addr, size))
+      _MemA_with_priv(addr, size, priv, true, value);
+    else if (InternalLoad32(REG_CCR) & REG_CCR__UNALIGN_TRP) {
+      InternalOr32(REG_CFSR, REG_CFSR__UFSR__UNALIGNED);
+      auto excInfo = _CreateException(UsageFault, false, UNKNOWN_VAL(false));
+      _RaiseFault(excInfo);
+    } else { // if unaligned access
+      // PPB (0xE0000000 to 0xE010000) is always little endian
+      if ((InternalLoad32(REG_AIRCR) & REG_AIRCR__ENDIANNESS) && GETBITS(addr,20,31) != 0xE00)
+        value = _BigEndianReverse(value, size);
+      for (int i=0; i<size && !_s.instrTerminated; ++i)
+        _MemA_with_priv(addr+i, 1, priv, false, GETBITS(value, 8*i, 8*i+7));
     }
-
-    return exc;
   }
 
-  /* _BXWritePC {{{4
-   * ----------
+  /* _MemA {{{4
+   * -----
    */
-  ExcInfo _BXWritePC(uint32_t addr, bool allowNonSecure) {
-    auto exc = _DefaultExcInfo();
+  uint32_t _MemA(uint32_t addr, int size) {
+    return _MemA_with_priv(addr, size, _FindPriv(), true);
+  }
 
-    if (_HaveSecurityExt() && (addr & ~BIT(0)) == 0b1111'1110'1111'1111'1111'1111'1111'1110) {
-      // Unlike exception return, any faults raised during a FNC_RETURN
-      // unstacking are raised synchronously with the instruction that
-      // triggered the unstacking.
-      exc = _FunctionReturn();
-    } else if (_CurrentMode() == PEMode_Handler && GETBITS(addr,24,31) == 0xFF) {
-      // The actual exception return is performed when the current instruction
-      // completes. This is because faults that occur during the exception
-      // return are handled differently from faults raised during the
-      // instruction execution.
-      _PendReturnOperation(addr);
-    } else if (_HaveSecurityExt() && _IsSecure() && allowNonSecure) {
-      // If in the Secure state and transitions to the non-secure state are allowed
-      // then the target state is specified by the LSB of the target address.
-      _BranchToNS(addr);
-    } else {
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__T, addr & 1);
-      // If EPSR.T == 0 then an exception is taken on the next instruction:
-      // UsageFault('Invalid State') if the Main Extension is implemented;
-      // HardFault otherwise
-      _BranchTo(addr & ~BIT(0));
-    }
+  void _MemA(uint32_t addr, int size, uint32_t value) {
+    _MemA_with_priv(addr, size, _FindPriv(), true, value);
+  }
 
-    return exc;
+  /* _MemA_with_priv {{{4
+   * ---------------
+   */
+  uint32_t _MemA_with_priv(uint32_t addr, int size, bool priv, bool aligned) {
+    auto [excInfo, value] = _MemA_with_priv_security(addr, size, AccType_NORMAL, priv, _IsSecure(), aligned);
+    _RaiseFault(excInfo);
+    return value;
   }
 
-  /* _BLXWritePC {{{4
-   * -----------
+  void _MemA_with_priv(uint32_t addr, int size, bool priv, bool aligned, uint32_t value) {
+    auto excInfo = _MemA_with_priv_security(addr, size, AccType_NORMAL, priv, _IsSecure(), aligned, value);
+    _RaiseFault(excInfo);
+  }
+
+  /* _MemA_with_priv_security {{{4
+   * ------------------------
    */
-  void _BLXWritePC(uint32_t addr, bool allowNonSecure) {
-    // If in the Secure state and transitions to the Non-secure state are
-    // allowed then the target state is specified by the LSB of the target
-    // address.
-    if (_HaveSecurityExt() && allowNonSecure && _IsSecure())
-      _BranchToNS(addr);
-    else {
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__T, GETBIT(addr, 0));
-      // If EPSR.T == 0 then an exception is taken on the next instruction:
-      // UsageFault('Invalid State') if the Main Extension is implemented;
-      // HardFault otherwise
-      _BranchTo(addr & ~BIT(0));
+  std::tuple<ExcInfo, uint32_t> _MemA_with_priv_security(uint32_t addr, int size, AccType accType, bool priv, bool secure, bool aligned) {
+    ExcInfo excInfo = _DefaultExcInfo();
+    if (!_IsAligned(addr, size)) {
+      if (_HaveMainExt())
+        InternalOr32(REG_CFSR, REG_CFSR__UFSR__UNALIGNED);
+      excInfo = _CreateException(UsageFault, true, secure);
+    }
+
+    uint32_t value;
+    AddressDescriptor memAddrDesc;
+    if (excInfo.fault == NoFault)
+      std::tie(excInfo, memAddrDesc) = _ValidateAddress(addr, accType, priv, secure, false, aligned);
+
+    if (excInfo.fault == NoFault) {
+      bool error;
+      std::tie(error, value) = _GetMem(memAddrDesc, size);
+
+      if (error) {
+        value   = UNKNOWN_VAL(0xFFFF'FFFF);
+        excInfo = _LoadBusError(addr, accType, secure);
+      } else if ((InternalLoad32(REG_AIRCR) & REG_AIRCR__ENDIANNESS) && GETBITS(addr,20,31) != 0xE00)
+        value = _BigEndianReverse(value, size);
+
+      if (_IsDWTEnabled()) {
+        uint32_t dvalue = value;
+        _DWT_DataMatch(addr, size, dvalue, true, secure);
+      }
     }
+
+    return {excInfo, value};
   }
 
-  /* _LoadWritePC {{{4
-   * ------------
-   */
-  void _LoadWritePC(uint32_t addr, int baseReg, uint32_t baseRegVal, bool baseRegUpdate, bool spLimCheck) {
-    RName    regName;
-    uint32_t oldBaseVal;
+  ExcInfo _MemA_with_priv_security(uint32_t addr, int size, AccType accType, bool priv, bool secure, bool aligned, uint32_t value) {
+    ExcInfo excInfo = _DefaultExcInfo();
 
-    if (baseRegUpdate) {
-      regName     = _LookUpRName(baseReg);
-      oldBaseVal  = _GetR(baseReg);
-      if (spLimCheck)
-        _SetRSPCheck(baseReg, baseRegVal);
-      else
-        _SetR(baseReg, baseRegVal);
+    if (!_IsAligned(addr, size)) {
+      if (_HaveMainExt())
+        InternalOr32(REG_CFSR, REG_CFSR__UFSR__UNALIGNED);
+      excInfo = _CreateException(UsageFault, true, secure);
     }
 
-    // Attempt to update the PC, which may result in a fault
-    auto excInfo = _BXWritePC(addr, false);
+    AddressDescriptor memAddrDesc;
+    if (excInfo.fault == NoFault)
+      std::tie(excInfo, memAddrDesc) = _ValidateAddress(addr, accType, priv, secure, true, aligned);
 
-    if (baseRegUpdate && excInfo.fault != NoFault)
-      // Restore the previous base reg value, SP limit checking is not performed
-      _s.r[regName] = oldBaseVal; // _R
+    if (excInfo.fault == NoFault) {
+      if (memAddrDesc.memAttrs.shareable)
+        _ClearExclusiveByAddress(memAddrDesc.physAddr, _ProcessorID(), size);
 
-    _HandleException(excInfo);
-  }
+      if (_IsDWTEnabled()) {
+        uint32_t dvalue = value;
+        _DWT_DataMatch(addr, size, dvalue, false, secure);
+      }
 
-  /* _GetPRIMASK {{{4
-   * -----------
-   */
-  uint32_t _GetPRIMASK() {
-    return _IsSecure() ? _s.primaskS : _s.primaskNS;
-  }
+      if ((InternalLoad32(REG_AIRCR) & REG_AIRCR__ENDIANNESS) && GETBITS(addr,20,31) != 0xE00)
+        value = _BigEndianReverse(value, size);
 
-  /* _SetPRIMASK {{{4
-   * -----------
-   */
-  void _SetPRIMASK(uint32_t v) {
-    if (_IsSecure())
-      _s.primaskS = v;
-    else
-      _s.primaskNS = v;
+      if (_SetMem(memAddrDesc, size, value))
+        excInfo = _StoreBusError(addr, accType, secure);
+    }
+
+    return excInfo;
   }
 
-  /* _GetFAULTMASK {{{4
+  /* _LoadBusError {{{4
    * -------------
+   * Records a bus error on a load from addr, and returns the resulting
+   * exception (none if it is ignored due to CCR.BFHFNMIGN).
    */
-  uint32_t _GetFAULTMASK() {
-    return _IsSecure() ? _s.faultmaskS : _s.faultmaskNS;
+  ExcInfo _LoadBusError(uint32_t addr, AccType accType, bool secure) {
+    if (_HaveMainExt()) {
+      if (accType == AccType_STACK)
+        InternalOr32(REG_CFSR, REG_CFSR__BFSR__UNSTKERR);
+      else if (accType == AccType_NORMAL || accType == AccType_ORDERED) {
+        uint32_t bfar = InternalLoad32(REG_BFAR);
+        bfar = CHGBITSM(bfar, REG_BFAR__ADDRESS, addr);
+        InternalStore32(REG_BFAR, bfar);
+        InternalMaskOr32(REG_CFSR, _cfg.MmfarBfarMerged() ? REG_CFSR__MMFSR__MMARVALID : 0,
+          REG_CFSR__BFSR__BFARVALID | REG_CFSR__BFSR__PRECISERR);
+      }
+    }
+
+    if (!_IsReqExcPriNeg(secure) || !(InternalLoad32(REG_CCR) & REG_CCR__BFHFNMIGN))
+      return _CreateException(BusFault, false, false/*UNKNOWN*/);
+
+    return _DefaultExcInfo();
   }
 
-  /* _SetFAULTMASK {{{4
-   * -------------
+  /* _StoreBusError {{{4
+   * --------------
+   * As for _LoadBusError, for a store.
    */
-  void _SetFAULTMASK(uint32_t v) {
-    if (_IsSecure())
-      _s.faultmaskS = v;
+  ExcInfo _StoreBusError(uint32_t addr, AccType accType, bool secure) {
+    bool negativePri;
+    if (accType == AccType_LAZYFP)
+      negativePri = !(InternalLoad32(REG_FPCCR_S) & REG_FPCCR__HFRDY);
     else
-      _s.faultmaskNS = v;
+      negativePri = _IsReqExcPriNeg(secure);
+
+    if (_HaveMainExt()) {
+      if (accType == AccType_STACK)
+        InternalOr32(REG_CFSR, REG_CFSR__BFSR__STKERR);
+      else if (accType == AccType_LAZYFP)
+        InternalOr32(REG_CFSR, REG_CFSR__BFSR__LSPERR);
+      else if (accType == AccType_NORMAL || accType == AccType_ORDERED) {
+        InternalStore32(REG_BFAR, addr);
+        InternalMaskOr32(REG_CFSR, _cfg.MmfarBfarMerged() ? REG_CFSR__MMFSR__MMARVALID : 0,
+          REG_CFSR__BFSR__BFARVALID | REG_CFSR__BFSR__PRECISERR);
+      }
+    }
+
+    if (!negativePri || !(InternalLoad32(REG_CCR) & REG_CCR__BFHFNMIGN))
+      return _CreateException(BusFault, false, false/*UNKNOWN*/);
+
+    return _DefaultExcInfo();
   }
 
-  /* _AddWithCarry {{{4
-   * -------------
-   */
-  std::tuple<uint32_t, bool, bool> _AddWithCarry(uint32_t x, uint32_t y, bool carryIn) {
-    uint32_t unsignedSum;
-    int32_t  signedSum;
-    bool     carryOut, overflow;
+  /* _MemA_LoadBurst {{{4
+   * ---------------
+   * Equivalent to loading count consecutive words from addr, one at a time and
+   * in ascending order, with _MemA_with_priv_security, stopping at the first
+   * fault. The transfer is validated once for each run of words over which the
+   * SAU and MPU results are the same, which is usually the whole transfer, and
+   * each run is transferred with a single _LoadBurst. Returns the exception
+   * (if any) and the number of words loaded before it. The value of the
+   * faulting word is UNKNOWN.
+   */
+  std::tuple<ExcInfo, int> _MemA_LoadBurst(uint32_t addr, int count, AccType accType, bool priv, bool secure, uint32_t *values) {
+    // DWT matching and big endian data are handled per word.
+    if (!_IsAligned(addr, 4) || _IsDWTEnabled() || (InternalLoad32(REG_AIRCR) & REG_AIRCR__ENDIANNESS)) {
+      for (int i=0; i<count; ++i) {
+        ExcInfo excInfo;
+        std::tie(excInfo, values[i]) = _MemA_with_priv_security(addr + 4*i, 4, accType, priv, secure, true);
+        if (excInfo.fault != NoFault)
+          return {excInfo, i};
+      }
 
-    carryOut  = __builtin_add_overflow(x, y, &unsignedSum);
-    carryOut |= __builtin_add_overflow(unsignedSum, (uint32_t)carryIn, &unsignedSum);
+      return {_DefaultExcInfo(), count};
+    }
 
-    overflow  = __builtin_add_overflow((int32_t)x, (int32_t)y, &signedSum);
-    overflow |= __builtin_add_overflow(signedSum, (int32_t)carryIn, &signedSum);
+    for (int done=0; done < count; ) {
+      uint32_t a = addr + 4*done;
+      uint32_t extent;
+      auto [excInfo, memAddrDesc] = _ValidateAddress(a, accType, priv, secure, false, true, &extent);
+      if (excInfo.fault != NoFault) {
+        values[done] = UNKNOWN_VAL(0xFFFF'FFFF);
+        return {excInfo, done};
+      }
 
-    return {unsignedSum, carryOut, overflow};
-  }
+      int n   = int(std::min<uint32_t>(count - done, (extent - a)/4 + 1));
+      int got = _LoadBurst(memAddrDesc, n, values + done);
+      done += got;
+      if (got < n) {
+        values[done] = UNKNOWN_VAL(0xFFFF'FFFF);
+        excInfo = _LoadBusError(addr + 4*done, accType, secure);
+        if (excInfo.fault != NoFault)
+          return {excInfo, done};
 
-  /* _SignExtend {{{4
-   * -----------
-   * Corresponds to SignExtend(), but has an additional parameter to represent input width.
-   */
-  uint32_t _SignExtend(uint32_t x, uint32_t inWidth, uint32_t outWidth) {
-    if (x & BIT(inWidth-1)) {
-      return x | BITS(inWidth,outWidth-1);
-    } else
-      return x;
-  }
+        ++done;
+      }
+    }
 
-  /* _BitCount {{{4
-   * ---------
-   */
-  static uint32_t _BitCount(uint32_t x) {
-    return __builtin_popcount(x);
+    return {_DefaultExcInfo(), count};
   }
 
-  /* _T32ExpandImm_C {{{4
-   * ---------------
-   */
-  static std::tuple<uint32_t, bool> _T32ExpandImm_C(uint32_t imm12, bool carryIn) {
-    if (GETBITS(imm12,10,11) == 0b00) {
-      uint32_t imm32;
-      switch (GETBITS(imm12, 8, 9)) {
-        case 0b00:
-          imm32 = _ZeroExtend(GETBITS(imm12, 0, 7), 32);
-          break;
-        case 0b01:
-          if (GETBITS(imm12, 0, 7) == 0)
-            THROW_UNPREDICTABLE();
-          imm32 = (GETBITS(imm12, 0, 7)<<16) | GETBITS(imm12, 0, 7);
-          break;
-        case 0b10:
-          if (GETBITS(imm12, 0, 7) == 0)
-            THROW_UNPREDICTABLE();
-          imm32 = (GETBITS(imm12, 0, 7)<<24) | (GETBITS(imm12, 0, 7)<<8);
-          break;
-        case 0b11:
-          if (GETBITS(imm12, 0, 7) == 0)
-            THROW_UNPREDICTABLE();
-          imm32 = (GETBITS(imm12, 0, 7)<<24) | (GETBITS(imm12, 0, 7)<<16)
-            | (GETBITS(imm12, 0, 7)<<8) | GETBITS(imm12, 0, 7);
-          break;
+  /* _MemA_StoreBurst {{{4
+   * ----------------
+   * As for _MemA_LoadBurst, for stores. Returns the exception (if any) and the
+   * number of words stored before it.
+   */
+  std::tuple<ExcInfo, int> _MemA_StoreBurst(uint32_t addr, int count, AccType accType, bool priv, bool secure, const uint32_t *values) {
+    if (!_IsAligned(addr, 4) || _IsDWTEnabled() || (InternalLoad32(REG_AIRCR) & REG_AIRCR__ENDIANNESS)) {
+      for (int i=0; i<count; ++i) {
+        ExcInfo excInfo = _MemA_with_priv_security(addr + 4*i, 4, accType, priv, secure, true, values[i]);
+        if (excInfo.fault != NoFault)
+          return {excInfo, i};
       }
-      return {imm32, carryIn};
-    } else {
-      uint32_t unrotatedValue = _ZeroExtend(BIT(7) | GETBITS(imm12, 0, 6), 32);
-      return _ROR_C(unrotatedValue, GETBITS(imm12, 7, 11));
+
+      return {_DefaultExcInfo(), count};
     }
-  }
 
-  /* _T32ExpandImm {{{4
-   * -------------
-   */
-  uint32_t _T32ExpandImm(uint32_t imm12) {
-    auto [imm32, _] = _T32ExpandImm_C(imm12, GETBITSM(_s.xpsr, XPSR__C));
-    return imm32;
-  }
+    for (int done=0; done < count; ) {
+      uint32_t a = addr + 4*done;
+      uint32_t extent;
+      auto [excInfo, memAddrDesc] = _ValidateAddress(a, accType, priv, secure, true, true, &extent);
+      if (excInfo.fault != NoFault)
+        return {excInfo, done};
+
+      int n   = int(std::min<uint32_t>(count - done, (extent - a)/4 + 1));
+      int got = _StoreBurst(memAddrDesc, n, values + done);
+      if (memAddrDesc.memAttrs.shareable)
+        _ClearExclusiveByAddress(memAddrDesc.physAddr, _ProcessorID(), 4*std::min(got + 1, n));
+
+      done += got;
+      if (got < n) {
+        excInfo = _StoreBusError(addr + 4*done, accType, secure);
+        if (excInfo.fault != NoFault)
+          return {excInfo, done};
+
+        ++done;
+      }
+    }
 
-  /* _Shift {{{4
-   * ------
-   */
-  uint32_t _Shift(uint32_t value, SRType srType, int amount, bool carryIn) {
-    auto [result, _] = _Shift_C(value, srType, amount, carryIn);
-    return result;
+    return {_DefaultExcInfo(), count};
   }
 
-  /* _DecodeImmShift {{{4
-   * ---------------
+  /* _ClearExclusiveByAddress {{{4
+   * ------------------------
    */
-  std::tuple<SRType, int> _DecodeImmShift(uint32_t srType, uint32_t imm5) {
-    switch (srType) {
-      case 0b00:
-        return {SRType_LSL, imm5};
-      case 0b01:
-        return {SRType_LSR, imm5 ? imm5 : 32};
-      case 0b10:
-        return {SRType_ASR, imm5 ? imm5 : 32};
-      case 0b11:
-        if (!imm5)
-          return {SRType_RRX, 1};
-        else
-          return {SRType_ROR, imm5};
-      default:
-        UNREACHABLE();
-    }
+  void _ClearExclusiveByAddress(uint32_t addr, int exclProcID, int size) {
+    auto lk = _gm.Lock();
+    _gm.ClearExclusiveByAddress(addr, exclProcID, size);
   }
 
-  /* _SetITSTATEAndCommit {{{4
-   * --------------------
+  /* _IsAligned {{{4
+   * ----------
    */
-  void _SetITSTATEAndCommit(uint8_t it) {
-    _s.nextInstrITState = it;
-    _s.itStateChanged = true;
-    _s.xpsr = CHGBITSM(_s.xpsr, XPSR__IT_ICI_LO, it>>2);
-    _s.xpsr = CHGBITSM(_s.xpsr, XPSR__IT_ICI_HI, it&3);
+  bool _IsAligned(uint32_t addr, int size) {
+    assert(size == 1 || size == 2 || size == 4 || size == 8);
+    uint32_t mask = (size-1);
+    return !(addr & mask);
   }
 
-  /* _HaveSysTick {{{4
-   * ------------
+  /* _MPUCheck {{{4
+   * ---------
    */
-  int _HaveSysTick() { return _cfg.SysTick(); }
+  std::tuple<MemoryAttributes, Permissions> _MPUCheck(uint32_t addr, AccType accType, bool isPriv, bool secure) {
+    assert(_HaveSecurityExt() || !secure);
 
-  /* _NextInstrAddr {{{4
-   * --------------
-   */
-  uint32_t _NextInstrAddr() {
-    if (_s.pcChanged)
-      return _s.nextInstrAddr;
-    else
-      return _ThisInstrAddr() + _ThisInstrLength();
-  }
+    MemoryAttributes  attrs       = _DefaultMemoryAttributes(addr);
+    Permissions       perms       = _DefaultPermissions(addr);
+    bool              hit         = false;
+    bool              isPPBAccess = (GETBITS(addr,20,31) == 0b111000000000);
 
-  /* _ThisInstrLength {{{4
-   * ----------------
-   */
-  int _ThisInstrLength() { return _s.thisInstrLength; }
+    uint32_t mpuCtrl, mpuType;
+    if (secure) {
+      mpuCtrl = InternalLoad32(REG_MPU_CTRL_S);
+      mpuType = InternalLoad32(REG_MPU_TYPE_S);
+    } else {
+      mpuCtrl = InternalLoad32(REG_MPU_CTRL_NS);
+      mpuType = InternalLoad32(REG_MPU_TYPE_NS);
+    }
 
-  /* _CalcDescriptorFlags {{{4
-   * --------------------
-   */
-  static inline uint32_t _CalcDescriptorFlags(AddressDescriptor memAddrDesc) {
-    uint32_t flags = 0;
+    bool negativePri;
+    if (accType == AccType_LAZYFP)
+      negativePri = !(InternalLoad32(REG_FPCCR_S) & REG_FPCCR__HFRDY);
+    else
+      negativePri = _IsReqExcPriNeg(secure);
 
-    if (memAddrDesc.accAttrs.isWrite)
-      flags |= LS_FLAG__WRITE;
-    if (memAddrDesc.accAttrs.isPriv)
-      flags |= LS_FLAG__PRIV;
-    flags |= PUTBITSM(memAddrDesc.accAttrs.accType, LS_FLAG__ATYPE__MASK);
-    if (memAddrDesc.memAttrs.memType == MemType_Device)
-      flags |= LS_FLAG__DEVICE;
-    flags |= PUTBITSM(memAddrDesc.memAttrs.device, LS_FLAG__DEVTYPE__MASK);
-    flags |= PUTBITSM(memAddrDesc.memAttrs.innerAttrs, LS_FLAG__IATTR__MASK);
-    flags |= PUTBITSM(memAddrDesc.memAttrs.outerAttrs, LS_FLAG__OATTR__MASK);
-    flags |= PUTBITSM(memAddrDesc.memAttrs.innerHints, LS_FLAG__IHINT__MASK);
-    flags |= PUTBITSM(memAddrDesc.memAttrs.outerHints, LS_FLAG__OHINT__MASK);
-    if (memAddrDesc.memAttrs.ns)
-      flags |= LS_FLAG__NS;
-    if (memAddrDesc.memAttrs.innerTransient)
-      flags |= LS_FLAG__ITRANSIENT;
-    if (memAddrDesc.memAttrs.outerTransient)
-      flags |= LS_FLAG__OTRANSIENT;
-    if (memAddrDesc.memAttrs.shareable)
-      flags |= LS_FLAG__SHAREABLE;
-    if (memAddrDesc.memAttrs.outerShareable)
-      flags |= LS_FLAG__OSHAREABLE;
+    if (accType == AccType_VECTABLE || isPPBAccess)
+      hit = true;
+    else if (!(mpuCtrl & REG_MPU_CTRL__ENABLE)) {
+      if (mpuCtrl & REG_MPU_CTRL__HFNMIENA) {
+        // XXX(UNPREDICTABLE): We do not want to throw UNPREDICTABLE here as this
+        // function can be ultimately called by _InstructionAdvance().
+        // Where the MPU is not enabled, we choose to handle this case the same as
+        // if this bit were not set.
+        QUIET_UNPREDICTABLE("HFNMIENA set when MPU not enabled\n");
+        hit = true;
+      } else
+        hit = true;
+    } else if (!(mpuCtrl & REG_MPU_CTRL__HFNMIENA) && negativePri)
+      hit = true;
+    else {
+      if ((mpuCtrl & REG_MPU_CTRL__PRIVDEFENA) && isPriv)
+        hit = true;
 
-    return flags;
-  }
+      bool regionMatched = false;
+      int  numRegions = GETBITSM(mpuType, REG_MPU_TYPE__DREGION);
+      for (int r=0; r<numRegions; ++r) {
+        uint32_t rbar, rlar;
+        if (secure)
+          std::tie(rbar,rlar) = _InternalLoadMpuSecureRegion(r);
+        else
+          std::tie(rbar,rlar) = _InternalLoadMpuNonSecureRegion(r);
 
-  /* _Load {{{4
-   * -----
-   */
-  int _Load(AddressDescriptor memAddrDesc, int size, uint32_t &v) {
-    if (memAddrDesc.physAddr >= 0xE000'0000 && memAddrDesc.physAddr < 0xE010'0000) {
-      if (size != 4)
-        // Non-32 bit accesses to SCS are UNPREDICTABLE; generate BusFault.
-        return 1;
+        if (rlar & REG_MPU_RLAR__EN) {
+          if (   addr >= ( GETBITSM(rbar, REG_MPU_RBAR__BASE )<<5)
+              && addr <= ((GETBITSM(rlar, REG_MPU_RLAR__LIMIT)<<5) | 0b11111)) {
+            uint32_t sh = 0;
+            if (regionMatched) {
+              perms.regionValid = false;
+              perms.region      = 0;
+              hit               = false;
+            } else {
+              regionMatched = true;
+              perms.ap      = GETBITSM(rbar, REG_MPU_RBAR__AP);
+              perms.xn      = GETBITSM(rbar, REG_MPU_RBAR__XN);
+              perms.region  = r & 0xFF;
+              perms.regionValid = true;
+              hit = true;
+              sh = GETBITSM(rbar, REG_MPU_RBAR__SH);
+            }
 
-      return _NestLoad32(memAddrDesc.physAddr, memAddrDesc.accAttrs.isPriv, !memAddrDesc.memAttrs.ns, v);
+            attrs = _LookUpMAIR(secure, GETBITSM(rlar, REG_MPU_RLAR__ATTR_IDX), sh);
+          }
+        }
+      }
     }
 
-    return _dev.Load(memAddrDesc.physAddr, size, _CalcDescriptorFlags(memAddrDesc), v);
+    if (GETBITS(addr,29,31) == 0b111)
+      perms.xn = true;
+
+    if (!hit)
+      perms.apValid = false;
+
+    return {attrs, perms};
   }
 
-  /* _Store {{{4
-   * ------
+  /* _MAIRDecode {{{4
+   * -----------
    */
-  int _Store(AddressDescriptor memAddrDesc, int size, uint32_t v) {
-    if (memAddrDesc.physAddr >= 0xE000'0000 && memAddrDesc.physAddr < 0xE010'0000) {
-      if (size != 4)
-        // Non-32 bit accesses to SCS are UNPREDICTABLE; generate BusFault.
-        return 1;
+  MemoryAttributes _MAIRDecode(uint8_t attrField, uint8_t sh) {
+    MemoryAttributes memAttrs{};
+    bool unpackInner;
 
-      return _NestStore32(memAddrDesc.physAddr, memAddrDesc.accAttrs.isPriv, !memAddrDesc.memAttrs.ns, v);
+    if (!GETBITS(attrField, 4, 7)) {
+      unpackInner = false;
+      memAttrs.memType        = MemType_Device;
+      memAttrs.shareable      = true;
+      memAttrs.outerShareable = true;
+      memAttrs.innerAttrs     = 0; // UNKNOWN
+      memAttrs.outerAttrs     = 0; // UNKNOWN
+      memAttrs.innerHints     = 0; // UNKNOWN
+      memAttrs.outerHints     = 0; // UNKNOWN
+      memAttrs.innerTransient = false; // UNKNOWN
+      memAttrs.outerTransient = false; // UNKNOWN
+      switch (GETBITS(attrField, 0, 3)) {
+        case 0b0000: memAttrs.device = DeviceType_nGnRnE; break;
+        case 0b0100: memAttrs.device = DeviceType_nGnRE; break;
+        case 0b1000: memAttrs.device = DeviceType_nGRE; break;
+        case 0b1100: memAttrs.device = DeviceType_GRE; break;
+      }
+      if (GETBITS(attrField, 0, 1)) {
+        // XXX(UNPREDICTABLE): This function may be called ultimately by
+        // _InstructionAdvance() so we should not raise UNPREDICTABLE here. If
+        // these reserved bits are set when they should not be, we simply
+        // ignore them, which is a plausible implementation.
+        QUIET_UNPREDICTABLE("invalid MAIR configuration\n");
+      }
+    } else {
+      unpackInner = true;
+      memAttrs.memType        = MemType_Normal;
+      memAttrs.device         = DeviceType_GRE; // UNKNOWN
+      memAttrs.outerHints     = GETBITS(attrField, 4, 5);
+      memAttrs.shareable      = (sh & BIT(1));
+      memAttrs.outerShareable = (sh == 0b10);
+      if (sh == 0b01) {
+        // XXX(UNPREDICTABLE): See above.
+        QUIET_UNPREDICTABLE("invalid MAIR configuration\n");
+      }
+
+      if (GETBITS(attrField, 6, 7) == 0b00) {
+        memAttrs.outerAttrs       = 0b10;
+        memAttrs.outerTransient   = true;
+      } else if (GETBITS(attrField, 6, 7) == 0b01) {
+        if (GETBITS(attrField, 4, 5) == 0b00) {
+          memAttrs.outerAttrs     = 0b00;
+          memAttrs.outerTransient = false;
+        } else {
+          memAttrs.outerAttrs     = 0b11;
+          memAttrs.outerTransient = true;
+        }
+      } else {
+        memAttrs.outerAttrs     = GETBITS(attrField, 6, 7);
+        memAttrs.outerTransient = false;
+      }
+    }
+
+    if (unpackInner) {
+      if (GETBITS(attrField, 0, 3) == 0b0000) {
+        // XXX(UNPREDICTABLE): See above.
+        QUIET_UNPREDICTABLE("invalid MAIR configuration\n");
+        memAttrs.innerAttrs     = 0;      // dummy values
+        memAttrs.innerHints     = 0;      //
+        memAttrs.innerTransient = false;  //
+      } else {
+        if (GETBITS(attrField, 2, 3) == 0b00) {
+          memAttrs.innerAttrs     = 0b10;
+          memAttrs.innerHints     = GETBITS(attrField, 0, 1);
+          memAttrs.innerTransient = true;
+        } else if (GETBITS(attrField, 2, 3) == 0b01) {
+          memAttrs.innerHints     = GETBITS(attrField, 0, 1);
+          if (GETBITS(attrField, 0, 1) == 0b00) {
+            memAttrs.innerAttrs     = 0b00;
+            memAttrs.innerTransient = false;
+          } else {
+            memAttrs.innerAttrs     = 0b11;
+            memAttrs.innerTransient = true;
+          }
+        } else if (GETBITS(attrField, 2, 3) == 0b10) {
+          memAttrs.innerHints     = GETBITS(attrField, 0, 1);
+          memAttrs.innerAttrs     = 0b10;
+          memAttrs.innerTransient = false;
+        } else if (GETBITS(attrField, 2, 3) == 0b11) {
+          memAttrs.innerHints     = GETBITS(attrField, 0, 1);
+          memAttrs.innerAttrs     = 0b11;
+          memAttrs.innerTransient = false;
+        } else {
+          // XXX(UNPREDICTABLE): See above.
+          QUIET_UNPREDICTABLE("invalid MAIR configuration\n");
+          memAttrs.innerAttrs     = 0;      // dummy values
+          memAttrs.innerHints     = 0;      // dummy values
+          memAttrs.innerTransient = false;  // dummy values
+        }
+      }
     }
 
-    return _dev.Store(memAddrDesc.physAddr, size, _CalcDescriptorFlags(memAddrDesc), v);
+    return memAttrs;
   }
 
-  /* _GetMem {{{4
-   * -------
+  /* MAIR Decode Tables {{{4
+   * ------------------
+   * MAIR0/MAIR1 rarely change, so rather than calling _MAIRDecode whenever an
+   * MPU region matches, we decode all eight attribute indices for each
+   * security state when the registers are written (and on reset and
+   * InvalidateCaches). Only the shareability, which comes from the region,
+   * remains to be applied on lookup.
    */
-  std::tuple<bool,uint32_t> _GetMem(AddressDescriptor memAddrDesc, int size) {
-    uint32_t v;
-    if (_Load(memAddrDesc, size, v))
-      return {true, 0};
+  void _UpdateMAIRTable(bool secure) {
+    uint64_t mair;
+    if (secure)
+      mair = (uint64_t(InternalLoad32(REG_MPU_MAIR1_S))<<32) | (uint64_t)InternalLoad32(REG_MPU_MAIR0_S);
     else
-      return {false, v};
+      mair = (uint64_t(InternalLoad32(REG_MPU_MAIR1_NS))<<32) | (uint64_t)InternalLoad32(REG_MPU_MAIR0_NS);
+
+    for (int idx=0; idx<8; ++idx) {
+      MemoryAttributes &attrs = _mair[secure][idx];
+      attrs         = _MAIRDecode(GETBITS(mair, 8*idx, 8*idx + 7), 0);
+      attrs.lsFlags = _MemAttrFlags(attrs);
+    }
   }
 
-  /* _SetMem {{{4
-   * -------
-   */
-  bool _SetMem(AddressDescriptor memAddrDesc, int size, uint32_t v) {
-    return !!_Store(memAddrDesc, size, MaskBySize(v, size));
+  void _UpdateMAIRTables() {
+    _UpdateMAIRTable(false);
+    if (_HaveSecurityExt())
+      _UpdateMAIRTable(true);
   }
 
-  /* _HaveHaltingDebug {{{4
-   * -----------------
-   */
-  bool _HaveHaltingDebug() { return _cfg.HaveHaltingDebug(); }
+  // Equivalent to _MAIRDecode of the given attribute index of MAIR0/MAIR1.
+  MemoryAttributes _LookUpMAIR(bool secure, uint32_t idx, uint8_t sh) {
+    MemoryAttributes attrs = _mair[secure][idx];
+    if (attrs.memType == MemType_Normal) {
+      attrs.shareable      = (sh & BIT(1));
+      attrs.outerShareable = (sh == 0b10);
+      if (sh == 0b01) {
+        // XXX(UNPREDICTABLE): See _MAIRDecode.
+        QUIET_UNPREDICTABLE("invalid MAIR configuration\n");
+      }
 
-  /* _CanHaltOnEvent {{{4
-   * ---------------
-   */
-  bool _CanHaltOnEvent(bool isSecure) {
-    if (!_HaveSecurityExt())
-      assert(!isSecure);
-    return _HaveHaltingDebug() && _HaltingDebugAllowed() && !!(InternalLoad32(REG_DHCSR) & REG_DHCSR__C_DEBUGEN)
-      && !(InternalLoad32(REG_DHCSR) & REG_DHCSR__S_HALT) && (!isSecure || !!(InternalLoad32(REG_DHCSR) & REG_DHCSR__S_SDE));
-  }
+      attrs.lsFlags &= ~(LS_FLAG__SHAREABLE | LS_FLAG__OSHAREABLE);
+      if (attrs.shareable)
+        attrs.lsFlags |= LS_FLAG__SHAREABLE;
+      if (attrs.outerShareable)
+        attrs.lsFlags |= LS_FLAG__OSHAREABLE;
+    }
 
-  /* _CanPendMonitorOnEvent {{{4
-   * ----------------------
-   */
-  bool _CanPendMonitorOnEvent(bool isSecure, bool checkPri) {
-    if (!_HaveSecurityExt())
-      assert(!isSecure);
-    return _HaveDebugMonitor() && !_CanHaltOnEvent(isSecure)
-      && !!(InternalLoad32(REG_DEMCR) & REG_DEMCR__MON_EN)
-      && !(InternalLoad32(REG_DHCSR) & REG_DHCSR__S_HALT)
-      && (!isSecure || !!(InternalLoad32(REG_DEMCR) & REG_DEMCR__SDME))
-      && (!checkPri || _ExceptionPriority(DebugMonitor, isSecure, true) < _ExecutionPriority());
+    return attrs;
   }
 
-  /* _ThisInstrITState {{{4
-   * -----------------
+  /* _CheckPermission {{{4
+   * ----------------
    */
-  uint8_t _ThisInstrITState() {
-    if (_HaveMainExt())
-      return (GETBITSM(_s.xpsr, XPSR__IT_ICI_LO)<<2) | GETBITSM(_s.xpsr, XPSR__IT_ICI_HI);
+  ExcInfo _CheckPermission(const Permissions &perms, uint32_t addr, AccType accType, bool isWrite, bool isPriv, bool isSecure) {
+    bool fault = true;
+    if (!perms.apValid)
+      fault = true;
+    else if (perms.xn && accType == AccType_IFETCH)
+      fault = true;
     else
-      return 0;
-  }
+      switch (perms.ap) {
+        case 0b00: fault = !isPriv; break;
+        case 0b01: fault = false; break;
+        case 0b10: fault = !isPriv || isWrite; break;
+        case 0b11: fault = isWrite; break;
+        default:
+          // XXX(UNPREDICTABLE): This can be called ultimately from
+          // _InstructionAdvance() so we should not throw here. Instead, treat
+          // the access as faulting.
+          QUIET_UNPREDICTABLE("invalid MPU range permission configuration\n");
+          fault = true;
+          break;
+      }
 
-  /* _GetITSTATE {{{4
-   * -----------
-   */
-  uint8_t _GetITSTATE() { return _ThisInstrITState(); }
+    if (!fault)
+      return _DefaultExcInfo();
 
-  /* _SetITSTATE {{{4
-   * -----------
-   */
-  void _SetITSTATE(uint8_t value) {
-    _s.nextInstrITState = value;
-    _s.itStateChanged = true;
+    if (_HaveMainExt()) {
+      uint8_t fsr = 0;
+      switch (accType) {
+        case AccType_IFETCH:
+          fsr |= REG_CFSR__MMFSR__IACCVIOL;
+          break;
+        case AccType_STACK:
+          if (isWrite)
+            fsr |= REG_CFSR__MMFSR__MSTKERR;
+          else
+            fsr |= REG_CFSR__MMFSR__MUNSTKERR;
+          break;
+        case AccType_LAZYFP:
+          fsr |= REG_CFSR__MMFSR__MLSPERR;
+          break;
+        case AccType_NORMAL:
+        case AccType_ORDERED:
+          fsr |= REG_CFSR__MMFSR__MMARVALID;
+          fsr |= REG_CFSR__MMFSR__DACCVIOL;
+          break;
+        default:
+          assert(false);
+          break;
+      }
+
+      uint32_t mask = (_cfg.MmfarBfarMerged() && !!(fsr & REG_CFSR__MMFSR__MMARVALID)) ? REG_CFSR__BFSR__BFARVALID : 0;
+      if (isSecure) {
+        InternalMaskOr32(REG_CFSR_S, mask, fsr);
+        if (fsr & REG_CFSR__MMFSR__MMARVALID)
+          InternalStore32(REG_MMFAR_S, addr);
+      } else {
+        InternalMaskOr32(REG_CFSR_NS, mask, fsr);
+        if (fsr & REG_CFSR__MMFSR__MMARVALID)
+          InternalStore32(REG_MMFAR_NS, addr);
+      }
+    }
+
+    return _CreateException(MemManage, true, isSecure);
   }
 
-  /* _GetSP {{{4
-   * ------
+  /* _BigEndianReverse {{{4
+   * -----------------
    */
-  uint32_t _GetSP(RName spreg) {
-    assert(    spreg == RNameSP_Main_NonSecure
-           || (spreg == RNameSP_Main_Secure       && _HaveSecurityExt())
-           ||  spreg == RNameSP_Process_NonSecure
-           || (spreg == RNameSP_Process_Secure    && _HaveSecurityExt()));
-    return _s.r[spreg] & ~3;
+  uint32_t _BigEndianReverse(uint32_t value, int N) {
+    assert(N == 1 || N == 2 || N == 4);
+    uint32_t result;
+    switch (N) {
+      case 1:
+        return value & UINT8_MAX;
+      case 2:
+        return (uint16_t(value)>>8) | (uint16_t(value)<<8);
+      default:
+      case 4:
+        return
+          (GETBITS(value,24,31)<< 0)
+        | (GETBITS(value,16,23)<< 8)
+        | (GETBITS(value, 8,15)<<16)
+        | (GETBITS(value, 0, 7)<<24)
+        ;
+    }
   }
 
-  /* _SetSP {{{4
-   * ------
+  /* _DWT_DataMatch {{{4
+   * --------------
    */
-  ExcInfo _SetSP(RName spreg, bool excEntry, uint32_t value) {
-    ExcInfo excInfo = _DefaultExcInfo();
-    auto [limit, applyLimit] = _LookUpSPLim(spreg);
-    if (applyLimit && value < limit) {
-      if (excEntry)
-        _s.r[spreg] = limit;
+  void _DWT_DataMatch(uint32_t daddr, int dsize, uint32_t dvalue, bool read, bool nsReq) {
+    bool triggerDebugEvent  = false;
+    bool debugEvent         = false;
 
-      if (_HaveMainExt())
-        InternalOr32(REG_CFSR, REG_CFSR__UFSR__STKOF);
+    uint32_t numComp = GETBITSM(InternalLoad32(REG_DWT_CTRL), REG_DWT_CTRL__NUMCOMP);
+    if (!_HaveDWT() || !numComp)
+      return;
 
-      excInfo = _CreateException(UsageFault, false, false/*UNKNOWN*/);
-      if (!excEntry)
-        _HandleException(excInfo);
-    } else
-      _s.r[spreg] = value & ~3;
+    for (uint32_t i=0; i<numComp; ++i) {
+      if (_IsDWTConfigUnpredictable(i)) {
+        // XXX(UNPREDICTABLE): We do not want to throw here. UNPREDICTABLE DWT configurations
+        // are simply not considered.
+        QUIET_UNPREDICTABLE("invalid DWT configuration (comparator %u)\n", i);
+        continue;
+      }
 
-    TRACE("SP(%u) <- 0x%x\n", spreg, _s.r[spreg]);
-    return excInfo;
-  }
+      bool daddrMatch   = _DWT_DataAddressMatch(i, daddr, dsize, read, nsReq);
+      bool dvalueMatch  = _DWT_DataValueMatch(i, daddr, dvalue, dsize, read, nsReq);
 
-  /* _Stack {{{4
-   * ------
-   */
-  ExcInfo _Stack(uint32_t framePtr, int offset, RName spreg, PEMode mode, uint32_t value) {
-    auto [limit, applyLimit] = _LookUpSPLim(spreg);
-    bool doAccess;
-    if (!applyLimit || framePtr >= limit)
-      doAccess = true;
-    else
-      doAccess = IMPL_DEF_PUSH_NON_VIOL_LOCATIONS;
+      if (daddrMatch && (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(i)), REG_DWT_FUNCTION__MATCH) & 0b1100) == 0b0100) {
+        if (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(i)), REG_DWT_FUNCTION__MATCH) != 0b0111) {
+          InternalOr32(REG_DWT_FUNCTION(i), REG_DWT_FUNCTION__MATCHED);
+          debugEvent = (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(i)), REG_DWT_FUNCTION__ACTION) == 0b01);
+        } else {
+          InternalMask32(REG_DWT_FUNCTION(i), REG_DWT_FUNCTION__MATCHED); // UNKNOWN
+          InternalOr32(REG_DWT_FUNCTION(i-1), REG_DWT_FUNCTION__MATCHED);
+          debugEvent = (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(i)), REG_DWT_FUNCTION__ACTION) == 0b01);
+        }
+      }
 
-    uint32_t addr = framePtr + offset;
-    ExcInfo excInfo;
-    if (doAccess && (!applyLimit || ((addr >= limit)))) {
-      bool secure = (spreg == RNameSP_Main_Secure || spreg == RNameSP_Process_Secure);
-      bool isPriv = secure ? !GETBITSM(_s.controlS, CONTROL__NPRIV) : !GETBITSM(_s.controlNS, CONTROL__NPRIV);
-      isPriv = isPriv || mode == PEMode_Handler;
-      excInfo = _MemA_with_priv_security(addr, 4, AccType_STACK, isPriv, secure, true, value);
-    } else
-      excInfo = _DefaultExcInfo();
+      if (dvalueMatch && (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(i)), REG_DWT_FUNCTION__MATCH) & 0b1100) == 0b1000) {
+        if (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(i)), REG_DWT_FUNCTION__MATCH) != 0b1011) {
+          InternalOr32(REG_DWT_FUNCTION(i), REG_DWT_FUNCTION__MATCHED);
+          debugEvent = (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(i)), REG_DWT_FUNCTION__ACTION) == 0b01);
+        } else {
+          InternalOr32(REG_DWT_FUNCTION(i), REG_DWT_FUNCTION__MATCHED);
+          debugEvent = (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(i)), REG_DWT_FUNCTION__ACTION) == 0b01);
+        }
+      }
 
-    return excInfo;
-  }
+      if (daddrMatch && (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(i)), REG_DWT_FUNCTION__MATCH) & 0b1100) == 0b1100)
+        InternalOr32(REG_DWT_FUNCTION(i), REG_DWT_FUNCTION__MATCHED);
 
-  std::tuple<ExcInfo, uint32_t> _Stack(uint32_t framePtr, int offset, RName spreg, PEMode mode) {
-    bool secure = (spreg == RNameSP_Main_Secure || spreg == RNameSP_Process_Secure);
-    bool isPriv = secure ? !(_s.controlS & CONTROL__NPRIV) : !(_s.controlNS & CONTROL__NPRIV);
-    isPriv = isPriv || mode == PEMode_Handler;
-    uint32_t addr = framePtr + offset;
-    auto [excInfo, value] = _MemA_with_priv_security(addr, 4, AccType_STACK, isPriv, secure, true);
-    return {excInfo, value};
+      triggerDebugEvent = triggerDebugEvent || debugEvent;
+    }
+
+    if (triggerDebugEvent)
+      debugEvent = _SetDWTDebugEvent(!nsReq);
   }
 
-  /* _GetLR {{{4
-   * ------
+  /* _DWT_DataAddressMatch {{{4
+   * ---------------------
+   * Check for match of access at "daddr". "dsize", "read" and "nsReq" are the
+   * attributes for the access. Note that for a load or store instruction,
+   * "nsReq" is the current security state of the PE, but this is not
+   * necessarily true for a hardware stack push/pop or vector table access.
+   * "nsReq" might not be the same as the "nsAttr" attribute the PE finally
+   * uses to make the access.
+   *
+   * If comparators 'm' and 'm+1' form a Data Address Range comparator, then
+   * this function returns the range match result when N=m+1.
    */
-  uint32_t _GetLR() { return _GetR(14); }
+  bool _DWT_DataAddressMatch(int N, uint32_t daddr, int dsize, bool read, bool nsReq) {
+    ASSERT(N < GETBITSM(InternalLoad32(REG_DWT_CTRL), REG_DWT_CTRL__NUMCOMP)
+        && (dsize == 1 || dsize == 2 || dsize == 4)
+        && _Align(daddr, dsize) == daddr);
 
-  /* _SetLR {{{4
-   * ------
-   */
-  void _SetLR(uint32_t v) { _SetR(14, v); }
+    bool validMatch = _DWT_ValidMatch(N, !nsReq);
+    bool validAddr  = ((GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__MATCH) & 0b0100) == 0b0100);
 
-  /* _HaveDSPExt {{{4
-   * -----------
-   */
-  bool _HaveDSPExt() { return _cfg.HaveDSPExt(); }
+    if (!validMatch || !validAddr)
+      return false;
 
-  /* _GetR {{{4
-   * -----
-   */
-  uint32_t _GetR(int n) {
-    assert(n >= 0 && n <= 15);
-    switch (n) {
-      case  0: return _s.r[RName0];
-      case  1: return _s.r[RName1];
-      case  2: return _s.r[RName2];
-      case  3: return _s.r[RName3];
-      case  4: return _s.r[RName4];
-      case  5: return _s.r[RName5];
-      case  6: return _s.r[RName6];
-      case  7: return _s.r[RName7];
-      case  8: return _s.r[RName8];
-      case  9: return _s.r[RName9];
-      case 10: return _s.r[RName10];
-      case 11: return _s.r[RName11];
-      case 12: return _s.r[RName12];
-      case 13: return _s.r[_LookUpSP()] & ~3;
-      case 14: return _s.r[RName_LR];
-      case 15: return _s.r[RName_PC] + 4;
-      default: assert(false);
+    bool linkedToAddr, linkedToData;
+    if (N != GETBITSM(InternalLoad32(REG_DWT_CTRL), REG_DWT_CTRL__NUMCOMP)-1) {
+      linkedToAddr = (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N+1)), REG_DWT_FUNCTION__MATCH) == 0b0111); // Data Address Limit
+      linkedToData = (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N+1)), REG_DWT_FUNCTION__MATCH) == 0b1011); // Linked Data Value
+    } else {
+      linkedToAddr = false;
+      linkedToData = false;
     }
-  }
 
-  /* _SetR {{{4
-   * -----
-   */
-  void _SetR(int n, uint32_t v) {
-    assert(n >= 0 && n <= 14);
-    switch (n) {
-      case  0: _s.r[RName0 ] = v; break;
-      case  1: _s.r[RName1 ] = v; break;
-      case  2: _s.r[RName2 ] = v; break;
-      case  3: _s.r[RName3 ] = v; break;
-      case  4: _s.r[RName4 ] = v; break;
-      case  5: _s.r[RName5 ] = v; break;
-      case  6: _s.r[RName6 ] = v; break;
-      case  7: _s.r[RName7 ] = v; break;
-      case  8: _s.r[RName8 ] = v; break;
-      case  9: _s.r[RName9 ] = v; break;
-      case 10: _s.r[RName10] = v; break;
-      case 11: _s.r[RName11] = v; break;
-      case 12: _s.r[RName12] = v; break;
-      case 13:
-        if (IMPL_DEF_SPLIM_CHECK_UNPRED_INSTR)
-          _SetSP(_LookUpSP(), false, v);
-        else
-          _s.r[_LookUpSP()] = v & ~3;
-        break;
-      case 14:
-        _s.r[RName_LR] = v;
+    bool matchLSC, linked;
+    switch (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__MATCH) & 3) {
+      case 0b00: matchLSC = true; linked = false; break;
+      case 0b01: matchLSC = !read; linked = false; break;
+      case 0b10: matchLSC = read; linked = false; break;
+      case 0b11:
+        ASSERT(N > 0);
+        switch (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N-1)), REG_DWT_FUNCTION__MATCH) & 3) {
+          case 0b00: matchLSC = true; linked = true; break;
+          case 0b01: matchLSC = !read; linked = true; break;
+          case 0b10: matchLSC = read; linked = true; break;
+          default: UNREACHABLE();
+        }
         break;
     }
+
+    bool matchAddr;
+    if (!linkedToAddr) {
+      uint32_t vsize = BIT(GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__DATAVSIZE));
+      auto [matchEQ, matchGT] = _DWT_AddressCompare(daddr, InternalLoad32(REG_DWT_COMP(N)), dsize, vsize);
+
+      if (linked) {
+        validMatch = _DWT_ValidMatch(N-1, !nsReq);
+        auto [lowerEQ, lowerGT] = _DWT_AddressCompare(daddr, InternalLoad32(REG_DWT_COMP(N-1)), dsize, 1);
+        matchAddr = validMatch && (lowerEQ || lowerGT) && !matchGT;
+      } else
+        matchAddr = matchEQ;
+    } else
+      matchAddr = false;
+
+    return matchAddr && matchLSC;
   }
 
-  /* _LookUpSP_with_security_mode {{{4
-   * ----------------------------
+  /* _DWT_AddressCompare {{{4
+   * -------------------
+   * Returns a pair of values. The first result is whether the (masked)
+   * addresses are equal, where the access address (addr) is masked according
+   * to REG_DWT_FUNCTION(n)__DATAVSIZE and the comparator address (compAddr) is
+   * masked according to the access size. The second result is whether the
+   * (unmasked) addr is greater than the (unmasked) compAddr.
    */
-  RName _LookUpSP_with_security_mode(bool isSecure, PEMode mode) {
-    bool spSel;
+  std::tuple<bool, bool> _DWT_AddressCompare(uint32_t addr, uint32_t compAddr, int size, int compSize) {
+    // addr must be a multiple of size. Unaligned accesses are split into smaller accesses.
+    ASSERT(_Align(addr, size) == addr);
 
-    if (isSecure)
-      spSel = !!(_s.controlS & CONTROL__SPSEL);
-    else
-      spSel = !!(_s.controlNS & CONTROL__SPSEL);
+    // compAddr must be a multiple of compSize.
+    if (_Align(compAddr, compSize) != compAddr) {
+      // XXX(UNPREDICTABLE): We do not want to throw here. Simply mask the bits.
+      QUIET_UNPREDICTABLE("DWT address comparison is not aligned (0x%x)\n", compAddr);
+      compAddr = _Align(compAddr, compSize);
+    }
 
-    if (spSel && mode == PEMode_Thread)
-      return isSecure ? RNameSP_Process_Secure : RNameSP_Process_NonSecure;
-    else
-      return isSecure ? RNameSP_Main_Secure : RNameSP_Main_NonSecure;
+    bool addrMatch    = (_Align(addr, compSize) == _Align(compAddr, size));
+    bool addrGreater  = (addr > compAddr);
+    return {addrMatch, addrGreater};
   }
 
-  /* _LookUpSP {{{4
-   * ---------
+  /* _DWT_ValidMatch {{{4
+   * ---------------
+   * Returns TRUE if this match is permitted by the current authentication controls.
    */
-  RName _LookUpSP() {
-    return _LookUpSP_with_security_mode(_IsSecure(), _CurrentMode());
+  bool _DWT_ValidMatch(int N, bool secureMatch) {
+    if (!_HaveSecurityExt())
+      ASSERT(!secureMatch);
+
+    // Check for disabled.
+    if (!_NoninvasiveDebugAllowed()
+     || !GETBITSM(InternalLoad32(REG_DEMCR), REG_DEMCR__TRCENA)
+     || !GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__MATCH))
+      return false;
+
+    if (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__ACTION) == 0b01) {
+      bool hltEn = _CanHaltOnEvent(secureMatch);
+      // Ignore priority when checking whether DebugMonitor activates DWT matches
+      bool monEn = _HaveDebugMonitor() && _CanPendMonitorOnEvent(secureMatch, false);
+      return hltEn || monEn;
+    } else
+      return !secureMatch || _SecureNoninvasiveDebugAllowed();
   }
 
-  /* _LookUpSPLim {{{4
-   * ------------
+  /* _DWT_DataValueMatch {{{4
+   * -------------------
+   * Check for match of access of "dvalue" at "daddr". "dsize", "read" and
+   * "nsReq" are the attributes for the access. Note that for a load or store
+   * instruction, "nsReq" is the current Security state of the PE, but this is
+   * not necessarily true for a hardware stack push/pop or vector table access.
+   * "nsReq" might not be the same as the "nsAttr" attribute the PE finally
+   * uses to make the access.
    */
-  std::tuple<uint32_t, bool> _LookUpSPLim(RName spreg) {
-    uint32_t limit;
-    switch (spreg) {
-      case RNameSP_Main_Secure:
-        limit = _s.msplimS & ~7;
-        break;
-      case RNameSP_Process_Secure:
-        limit = _s.psplimS & ~7;
-        break;
-      case RNameSP_Main_NonSecure:
-        limit = _HaveMainExt() ? (_s.msplimNS & ~7) : 0;
-        break;
-      case RNameSP_Process_NonSecure:
-        limit = _HaveMainExt()? (_s.psplimNS & ~7) : 0;
+  bool _DWT_DataValueMatch(int N, uint32_t daddr, uint32_t dvalue, int dsize, bool read, bool nsReq) {
+    ASSERT(N < GETBITSM(InternalLoad32(REG_DWT_CTRL), REG_DWT_CTRL__NUMCOMP)
+        && (dsize == 1 || dsize == 2 || dsize == 4)
+        && _Align(daddr, dsize) == daddr);
+
+    bool validMatch = _DWT_ValidMatch(N, !nsReq);
+    bool validData  = (GETBITS(GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__MATCH), 2, 3) == 0b10);
+
+    if (!validMatch || !validData)
+      return false;
+
+    bool matchLSC, linked;
+    switch (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__MATCH) & 3) {
+      case 0b00: matchLSC = true; linked = false; break;
+      case 0b01: matchLSC = !read; linked = false; break;
+      case 0b10: matchLSC = read; linked = false; break;
+      case 0b11:
+        ASSERT(N > 0);
+        switch (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N-1)), REG_DWT_FUNCTION__MATCH) & 3) {
+          case 0b00: matchLSC = true; linked = true; break;
+          case 0b01: matchLSC = !read; linked = true; break;
+          case 0b10: matchLSC = read; linked = true; break;
+          default: UNREACHABLE();
+        }
         break;
-      default:
-        assert(false);
     }
 
-    bool applyLimit;
-    bool secure = (spreg == RNameSP_Main_Secure || spreg == RNameSP_Process_Secure);
-    assert(!secure || _HaveSecurityExt());
-    if (_HaveMainExt() && _IsReqExcPriNeg(secure)) {
-      bool ignLimit = secure ? (InternalLoad32(REG_CCR_S) & REG_CCR__STKOFHFNMIGN) : (InternalLoad32(REG_CCR_NS) & REG_CCR__STKOFHFNMIGN);
-      applyLimit = !ignLimit;
-    } else
-      applyLimit = true;
-
-    return {limit, applyLimit};
-  }
+    uint32_t vsize = BIT(GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__DATAVSIZE));
 
-  /* _IsReqExcPriNeg {{{4
-   * ---------------
-   */
-  bool _IsReqExcPriNeg(bool secure) {
-    bool neg = _IsActiveForState(NMI, secure) || _IsActiveForState(HardFault, secure);
-    if (_HaveMainExt()) {
-      uint32_t faultMask = secure ? _s.faultmaskS : _s.faultmaskNS;
-      if (faultMask & 1)
-        neg = true;
+    uint32_t dmask;
+    if (linked) {
+      dmask = 0b0000; // Filled in below if there is an address match
+      if (_DWT_DataAddressMatch(N-1, daddr, dsize, read, nsReq)) {
+        if (vsize == 1 && dsize == 1)
+          dmask = CHGBIT(dmask, 0, 1);
+        else if (vsize == 1 && dsize == 2)
+          dmask = CHGBIT(dmask, GETBITS(InternalLoad32(REG_DWT_COMP(N-1)), 0, 0), 1);
+        else if (vsize == 1 && dsize == 4)
+          dmask = CHGBIT(dmask, GETBITS(InternalLoad32(REG_DWT_COMP(N-1)), 0, 1), 1);
+        else if (vsize == 2 && dsize == 2)
+          dmask = CHGBITS(dmask, 0, 1, 0b11);
+        else if (vsize == 2 && dsize == 4)
+          dmask = CHGBITS(dmask, GETBITS(InternalLoad32(REG_DWT_COMP(N-1)), 0, 1),
+                                 GETBITS(InternalLoad32(REG_DWT_COMP(N-1)), 0, 1)+1, 0b11);
+        else if (vsize == 4 && dsize == 4)
+          dmask = 0b1111;
+        else
+          dmask = 0b0000; // vsize > dsize: no match
+      }
+    } else {
+      switch (dsize) {
+        case 1: dmask = 0b0001; break;
+        case 2: dmask = 0b0011; break;
+        case 4: dmask = 0b1111; break;
+        default: UNREACHABLE();
+      }
     }
-    return neg;
-  }
-
-  /* _GetSP {{{4
-   * ------
-   */
-  uint32_t _GetSP() { return _GetR(13); }
-
-  /* _SetSP {{{4
-   * ------
-   */
-  void _SetSP(uint32_t value) { _SetRSPCheck(13, value); }
 
-  /* _GetSP_Main {{{4
-   * -----------
-   */
-  uint32_t _GetSP_Main() { return _IsSecure() ? _GetSP_Main_Secure() : _GetSP_Main_NonSecure(); }
-
-  /* _SetSP_Main {{{4
-   * -----------
-   */
-  void _SetSP_Main(uint32_t value) {
-    if (_IsSecure())
-      _SetSP_Main_Secure(value);
-    else
-      _SetSP_Main_NonSecure(value);
-  }
+    // Split both values into byte lanes: DCBA and dcba.
+    // This function relies on the values being correctly replicated across
+    // REG_DWT_COMP(N).
+    uint32_t D = GETBITS(dvalue,24,31);
+    uint32_t C = GETBITS(dvalue,16,23);
+    uint32_t B = GETBITS(dvalue, 8,15);
+    uint32_t A = GETBITS(dvalue, 0, 7);
 
-  /* _GetSP_Main_NonSecure {{{4
-   * ---------------------
-   */
-  uint32_t _GetSP_Main_NonSecure() {
-    return _GetSP(RNameSP_Main_NonSecure);
-  }
+    uint32_t d = GETBITS(InternalLoad32(REG_DWT_COMP(N)),24,31);
+    uint32_t c = GETBITS(InternalLoad32(REG_DWT_COMP(N)),16,23);
+    uint32_t b = GETBITS(InternalLoad32(REG_DWT_COMP(N)), 8,15);
+    uint32_t a = GETBITS(InternalLoad32(REG_DWT_COMP(N)), 0, 7);
 
-  /* _SetSP_Main_NonSecure {{{4
-   * ---------------------
-   */
-  void _SetSP_Main_NonSecure(uint32_t value) {
-    _SetSP(RNameSP_Main_NonSecure, false, value);
-  }
+    // Partial results.
+    bool Dd = (GETBIT(dmask, 3) && D == d);
+    bool Cc = (GETBIT(dmask, 2) && C == c);
+    bool Bb = (GETBIT(dmask, 1) && B == b);
+    bool Aa = (GETBIT(dmask, 0) && A == a);
 
-  /* _SetSP_Main_Secure {{{4
-   * ------------------
-   */
-  void _SetSP_Main_Secure(uint32_t value) {
-    _SetSP(RNameSP_Main_Secure, false, value);
-  }
+    // Combined partial results.
+    bool BAba = Bb && Aa;
+    bool DCdc = Dd && Cc;
+    bool DCBAdcba = Dd && Cc && Bb && Aa;
 
-  /* _GetSP_Main_Secure {{{4
-   * ------------------
-   */
-  uint32_t _GetSP_Main_Secure() {
-    return _GetSP(RNameSP_Main_Secure);
-  }
+    // Generate full results.
+    bool matchData;
+    if (vsize == 1)
+      matchData = (Dd || Cc || Bb || Aa);
+    else if (vsize == 2 && (dsize == 2 || dsize == 4))
+      matchData = (DCdc || BAba);
+    else if (vsize == 4 && dsize == 4)
+      matchData = DCBAdcba;
+    else
+      matchData = false;
 
-  /* _GetSP_Process {{{4
-   * --------------
-   */
-  uint32_t _GetSP_Process() {
-    return _IsSecure() ? _GetSP_Process_Secure() : _GetSP_Process_NonSecure();
+    return matchData && matchLSC;
   }
 
-  /* _SetSP_Process {{{4
-   * --------------
+  /* _IsDWTConfigUnpredictable {{{4
+   * -------------------------
+   * Checks for the UNPREDICTABLE cases for various combinations of MATCH and
+   * ACTION for each comparator.
    */
-  void _SetSP_Process(uint32_t value) {
-    if (_IsSecure())
-      _SetSP_Process_Secure(value);
-    else
-      _SetSP_Process_NonSecure(value);
-  }
+  bool _IsDWTConfigUnpredictable(int N) {
+    bool noTrace = (!_HaveMainExt() || GETBITSM(InternalLoad32(REG_DWT_CTRL), REG_DWT_CTRL__NOTRCPKT) || !_HaveITM());
 
-  /* _GetSP_Process_NonSecure {{{4
-   * ------------------------
-   */
-  uint32_t _GetSP_Process_NonSecure() {
-    return _GetSP(RNameSP_Process_NonSecure);
-  }
+    // First pass check of MATCH field — coarse checks.
+    switch (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__MATCH)) {
+      case 0b0000: // Disabled
+        return false;
+      case 0b0001: // Cycle counter match
+        if (!_HaveMainExt() || GETBITSM(InternalLoad32(REG_DWT_CTRL), REG_DWT_CTRL__NOCYCCNT)
+         || !(GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__ID) & BIT(0)))
+          return true;
+        break;
+      case 0b0010: // Instruction address
+      case 0b0011:
+        if (!(GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__ID) & BIT(1))
+         || GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__DATAVSIZE) != 0b01
+         || GETBIT(InternalLoad32(REG_DWT_COMP(N)), 0))
+          return true;
+        break;
+      case 0b0100: // Data address
+      case 0b0101:
+      case 0b0110:
+      case 0b0111: {
+        uint32_t lsb = GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__DATAVSIZE);
+        if (!(GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__ID) & BIT(3))
+         || (lsb > 0 && !_IsZero(GETBITS(InternalLoad32(REG_DWT_COMP(N)), 0, lsb-1))))
+          return true;
+      } break;
+      case 0b1100: // Data address with value
+      case 0b1101:
+      case 0b1110: {
+        if (noTrace)
+          return true;
+        uint32_t lsb = GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__DATAVSIZE);
+        if (!(GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__ID) & BIT(3))
+          || (lsb > 0 && !_IsZero(GETBITS(InternalLoad32(REG_DWT_COMP(N)), 0, lsb-1))))
+          return true;
+      } break;
+      case 0b1000: // Data value
+      case 0b1001:
+      case 0b1010:
+      case 0b1011: {
+        uint32_t vsize = BIT(GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__DATAVSIZE));
+        if (!_HaveMainExt()
+         || !(GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__ID) & BIT(2))
+         || (vsize != 4 && GETBITS(InternalLoad32(REG_DWT_COMP(N)), 16, 31) != GETBITS(InternalLoad32(REG_DWT_COMP(N)), 0, 15))
+         || (vsize == 1 && GETBITS(InternalLoad32(REG_DWT_COMP(N)),  8, 15) != GETBITS(InternalLoad32(REG_DWT_COMP(N)), 0,  7)))
+          return true;
+      } break;
+      default:
+       return true;
+    }
 
-  /* _SetSP_Process_NonSecure {{{4
-   * ------------------------
-   */
-  void _SetSP_Process_NonSecure(uint32_t value) {
-    _SetSP(RNameSP_Process_NonSecure, false, value);
-  }
+    // Second pass MATCH check — linked and limit comparators.
+    switch (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__MATCH)) {
+      case 0b0011: { // Instruction address limit
+        uint32_t m = GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N-1)), REG_DWT_FUNCTION__MATCH);
+        if (!N
+         || !(GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__ID) & BIT(4))
+         || (m == 0b0001 || m == 0b0011 || ((m & 0b1100) == 0b0100) || (m & 0b1000))
+         || (InternalLoad32(REG_DWT_COMP(N)) <= InternalLoad32(REG_DWT_COMP(N-1))))
+          return true;
+        if (!m)
+          return false;
+      } break;
 
-  /* _GetSP_Process_Secure {{{4
-   * ---------------------
-   */
-  uint32_t _GetSP_Process_Secure() {
-    return _GetSP(RNameSP_Process_Secure);
-  }
+      case 0b0111: { // Data address limit
+        uint32_t m = GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N-1)), REG_DWT_FUNCTION__MATCH);
+        if (!N
+         || !(GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__ID) & BIT(4))
+         || (m == 0b0001 || ((m & 0b1110) == 0b0010) || m == 0b0111 || (m & 0b1100) == 0b1000)
+         || (InternalLoad32(REG_DWT_COMP(N)) <= InternalLoad32(REG_DWT_COMP(N-1))))
+          return true;
+        if (!m)
+          return false;
+      } break;
 
-  /* _SetSP_Process_Secure {{{4
-   * ---------------------
-   */
-  void _SetSP_Process_Secure(uint32_t value) {
-    _SetSP(RNameSP_Process_Secure, false, value);
-  }
+      case 0b1011: { // Linked data value
+        uint32_t m = GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N-1)), REG_DWT_FUNCTION__MATCH);
+        if (!N
+         || !(GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__ID) & BIT(4))
+         || (m == 0b0001 || ((m & 0b1110) == 0b0010) || m == 0b0111 || (m & 0b1100) == 0b1000)
+         || GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N  )), REG_DWT_FUNCTION__DATAVSIZE) !=
+            GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N-1)), REG_DWT_FUNCTION__DATAVSIZE))
+          return true;
+        if (!m)
+          return false;
+      } break;
+    }
 
-  /* _SetRSPCheck {{{4
-   * ------------
-   */
-  void _SetRSPCheck(int n, uint32_t v) {
-    if (n == 13)
-      _SetSP(_LookUpSP(), false, v);
-    else
-      _SetR(n, v);
-  }
+    // Check DATAVSIZE is permitted.
+    if (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__DATAVSIZE) == 0b11)
+      return true;
 
-  /* _Lockup {{{4
-   * -------
-   */
-  void _Lockup(bool termInst) {
-    InternalOr32(REG_DHCSR, REG_DHCSR__S_LOCKUP);
-    _BranchToAndCommit(0xEFFF'FFFE);
-    if (termInst)
-      _EndOfInstruction();
-  }
+    // Check the ACTION is allowed for the MATCH type.
+    switch (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__ACTION)) {
+      case 0b00: { // CMPMATCH trigger only
+        uint32_t m = GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__MATCH);
+        if (m == 0b1100 || m == 0b1101 || m == 0b1110)
+          return true;
+      } break;
+      case 0b01: { // Debug event
+        uint32_t m = GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__MATCH);
+        if (m == 0b0011 || m == 0b0111 || m == 0b1100 || m == 0b1101 || m == 0b1110)
+          return true;
+      } break;
+      case 0b10: { // Data Trace Match or Data Value packet
+        uint32_t m = GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__MATCH);
+        if (noTrace || m == 0b0011 || m == 0b0111)
+          return true;
+      } break;
+      case 0b11: { // Other Data Trace Packet
+        uint32_t m = GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__MATCH);
+        if (noTrace
+         || (m == 0b0010 || m == 0b1000 || m == 0b1001 || m == 0b1010)
+         || (m == 0b0011 && GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N-1)), REG_DWT_FUNCTION__ACTION) != 0b00)
+         || (m == 0b0111 && (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N-1)), REG_DWT_FUNCTION__MATCH) & 0b1100) == 0b0100
+                         && (   GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N-1)), REG_DWT_FUNCTION__ACTION) == 0b01
+                             || GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N-1)), REG_DWT_FUNCTION__ACTION) == 0b10))
+         || (m == 0b0111 && (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N-1)), REG_DWT_FUNCTION__MATCH) & 0b1100) == 0b1100
+                         && (   GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N-1)), REG_DWT_FUNCTION__ACTION) == 0b00
+                             || GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N-1)), REG_DWT_FUNCTION__ACTION) == 0b01)))
+          return true;
+      } break;
+    }
 
-  /* _BranchToAndCommit {{{4
-   * ------------------
-   */
-  void _BranchToAndCommit(uint32_t addr) {
-    _s.r[RName_PC]    = addr & ~1;
-    _s.pcChanged      = true;
-    _s.nextInstrAddr  = addr & ~1;
-    _s.pendingReturnOperation = false;
+    return false; // Passes checks
   }
 
-  /* _BranchTo {{{4
-   * ---------
+  /* _SetDWTDebugEvent {{{4
+   * -----------------
    */
-  void _BranchTo(uint32_t addr) {
-    _s.nextInstrAddr = addr;
-    _s.pcChanged     = true;
-    _s.pendingReturnOperation = false;
-  }
+  bool _SetDWTDebugEvent(bool secureMatch) {
+    if (_CanHaltOnEvent(secureMatch)) {
+      InternalOr32(REG_DHCSR, REG_DHCSR__C_HALT);
+      InternalOr32(REG_DFSR, REG_DFSR__DWTTRAP);
+      return true;
+    }
 
-  /* _PendReturnOperation {{{4
-   * --------------------
-   */
-  void _PendReturnOperation(uint32_t retValue) {
-    _s.nextInstrAddr          = retValue;
-    _s.pcChanged              = true;
-    _s.pendingReturnOperation = true;
+    if (_HaveMainExt() && _CanPendMonitorOnEvent(secureMatch, true)) {
+      InternalOr32(REG_DEMCR, REG_DEMCR__MON_PEND);
+      InternalOr32(REG_DFSR, REG_DFSR__DWTTRAP);
+      return true;
+    }
+
+    return false;
   }
 
-  /* _IsActiveForState {{{4
-   * -----------------
+  /* _DefaultMemoryAttributes {{{4
+   * ------------------------
    */
-  bool _IsActiveForState(int exc, bool isSecure) {
-    if (!_HaveSecurityExt())
-      isSecure = false;
+  MemoryAttributes _DefaultMemoryAttributes(uint32_t addr) {
+    MemoryAttributes attrs{};
 
-    bool active;
-    if (_IsExceptionTargetConfigurable(exc))
-      active = (_s.excActive[exc] && _ExceptionTargetsSecure(exc, isSecure) == isSecure);
-    else {
-      int idx = isSecure ? 0 : 1;
-      active = !!(_s.excActive[exc] & BIT(idx));
+    switch (GETBITS(addr,29,31)) {
+      case 0b000:
+        attrs.memType     = MemType_Normal;
+        attrs.device      = DeviceType_GRE; // UNKNOWN
+        attrs.innerAttrs  = 0b10;
+        attrs.shareable   = false;
+        break;
+      case 0b001:
+        attrs.memType     = MemType_Normal;
+        attrs.device      = DeviceType_GRE; // UNKNOWN
+        attrs.innerAttrs  = 0b01;
+        attrs.shareable   = false;
+        break;
+      case 0b010:
+        attrs.memType     = MemType_Device;
+        attrs.device      = DeviceType_nGnRE;
+        attrs.innerAttrs  = 0b00;
+        attrs.shareable   = true;
+        break;
+      case 0b011:
+        attrs.memType     = MemType_Normal;
+        attrs.device      = DeviceType_GRE; // UNKNOWN
+        attrs.innerAttrs  = 0b01;
+        attrs.shareable   = false;
+        break;
+      case 0b100:
+        attrs.memType     = MemType_Normal;
+        attrs.device      = DeviceType_GRE; // UNKNOWN
+        attrs.innerAttrs  = 0b10;
+        attrs.shareable   = false;
+        break;
+      case 0b101:
+        attrs.memType     = MemType_Device;
+        attrs.device      = DeviceType_nGnRE;
+        attrs.innerAttrs  = 0b00;
+        attrs.shareable   = true;
+        break;
+      case 0b110:
+        attrs.memType     = MemType_Device;
+        attrs.device      = DeviceType_nGnRE;
+        attrs.innerAttrs  = 0b00;
+        attrs.shareable   = true;
+        break;
+      case 0b111:
+        if (!GETBITS(addr,20,28)) {
+          attrs.memType     = MemType_Device;
+          attrs.device      = DeviceType_nGnRnE;
+          attrs.innerAttrs  = 0b00;
+          attrs.shareable   = true;
+        } else {
+          attrs.memType     = MemType_Device;
+          attrs.device      = DeviceType_nGnRE;
+          attrs.innerAttrs  = 0b00;
+          attrs.shareable   = true;
+        }
+        break;
     }
 
-    return active;
+    attrs.outerAttrs      = attrs.innerAttrs;
+    attrs.outerShareable  = attrs.shareable;
+    attrs.ns              = false; // UNKNOWN
+    attrs.lsFlags         = _MemAttrFlags(attrs);
+    return attrs;
   }
 
-  /* _IsPendingForState {{{4
-   * ------------------
-   * XXX
+  /* _DefaultPermissions {{{4
+   * -------------------
    */
-  bool _IsPendingForState(int exc, bool isSecure) {
-    if (!_HaveSecurityExt())
-      isSecure = false;
+  Permissions _DefaultPermissions(uint32_t addr) {
+    Permissions perms = {};
+    perms.ap          = 0b01;
+    perms.apValid     = true;
+    perms.region      = 0;
+    perms.regionValid = false;
 
-    bool pending;
-    if (_IsExceptionTargetConfigurable(exc))
-      pending = (_s.excPending[exc] && _ExceptionTargetsSecure(exc, isSecure) == isSecure);
-    else {
-      int idx = isSecure ? 0 : 1;
-      pending = !!(_s.excPending[exc] & BIT(idx));
+    switch (GETBITS(addr,29,31)) {
+      case 0b000: perms.xn = false; break;
+      case 0b001: perms.xn = false; break;
+      case 0b010: perms.xn = true;  break;
+      case 0b011: perms.xn = false; break;
+      case 0b100: perms.xn = false; break;
+      case 0b101: perms.xn = true;  break;
+      case 0b110: perms.xn = true;  break;
+      case 0b111: perms.xn = true;  break;
     }
 
-    return pending;
+    return perms;
   }
 
-  /* _IsEnabledForState {{{4
-   * ------------------
-   * XXX
+  /* _SetPending {{{4
+   * -----------
+   * XXX. This function has been augmented relative to the ISA manual's
+   * definition to add an additional check parameter allowing us to choose to
+   * test _ExceptionTargetsSecure, which is useful for implementing NVIC
+   * registers.
    */
-  bool _IsEnabledForState(int exc, bool isSecure) {
+  void _SetPending(int exc, bool isSecure, bool setNotClear, bool check=false) {
     if (!_HaveSecurityExt())
       isSecure = false;
 
-    bool enabled;
-    if (_IsExceptionTargetConfigurable(exc))
-      enabled = (_s.excEnable[exc] && _ExceptionTargetsSecure(exc, isSecure) == isSecure);
-    else {
-      int idx = isSecure ? 0 : 1;
-      enabled = !!(_s.excEnable[exc] & BIT(idx));
+    if (_IsExceptionTargetConfigurable(exc)) {
+      if (!check || _ExceptionTargetsSecure(exc, isSecure) == isSecure)
+        _s.excPending[exc] = setNotClear ? 0b11 : 0b00;
+    } else {
+      uint32_t idx = isSecure ? 0 : 1;
+      _s.excPending[exc] = CHGBITS(_s.excPending[exc], idx, idx, setNotClear);
     }
 
-    return enabled;
+    _UpdatePendingSet(exc);
+    _ExcStateChanged();
   }
 
-  /* _IsExceptionTargetConfigurable {{{4
-   * ------------------------------
+  /* _SetEnable {{{4
+   * ----------
+   * XXX. This does not appear in the ISA manual but has been constructed
+   * analagously to _SetPending.
    */
-  bool _IsExceptionTargetConfigurable(int e) {
+  void _SetEnable(int exc, bool isSecure, bool setNotClear, bool check=false) {
     if (!_HaveSecurityExt())
-      return false;
+      isSecure = false;
 
-    switch (e) {
-      case NMI: return true;
-      case BusFault: return true;
-      case DebugMonitor: return true;
-      case SysTick: return _HaveSysTick() == 1;
-      default: return e >= 16;
+    if (_IsExceptionTargetConfigurable(exc)) {
+      if (!check || _ExceptionTargetsSecure(exc, isSecure) == isSecure)
+        _s.excEnable[exc] = setNotClear ? 0b11 : 0b00;
+    } else {
+      uint32_t idx = isSecure ? 0 : 1;
+      _s.excEnable[exc] = CHGBITS(_s.excEnable[exc], idx, idx, setNotClear);
     }
+
+    if (exc >= 16)
+      _UpdatePendingSet(exc);
+    _ExcStateChanged();
   }
 
-  /* _GetVector {{{4
-   * ----------
+  /* _NextInstrITState {{{4
+   * -----------------
    */
-  std::tuple<ExcInfo, uint32_t> _GetVector(int excNo, bool isSecure) {
-    uint32_t vtor = isSecure ? InternalLoad32(REG_VTOR_S) : InternalLoad32(REG_VTOR_NS);
-    uint32_t addr = (vtor & ~BITS(0,6)) + 4*excNo;
-    auto [exc, vector] = _MemA_with_priv_security(addr, 4, AccType_VECTABLE, true, isSecure, true);
-    if (exc.fault != NoFault) {
-      exc.isTerminal = true;
-      exc.fault = HardFault;
-      exc.isSecure = exc.isSecure || !(InternalLoad32(REG_AIRCR) & REG_AIRCR__BFHFNMINS);
-      InternalOr32(REG_HFSR, REG_HFSR__VECTTBL);
-    }
-    return {exc, vector};
+  uint8_t _NextInstrITState() {
+    uint8_t nextState;
+    if (_HaveMainExt()) {
+      if (_s.itStateChanged)
+        nextState = _s.nextInstrITState;
+      else {
+        nextState = _ThisInstrITState();
+        if (GETBITS(nextState, 0, 2) == 0b000)
+          nextState = 0;
+        else
+          nextState = CHGBITS(nextState, 0, 4, GETBITS(nextState, 0, 4)<<1);
+      }
+    } else
+      nextState = 0;
+    return nextState;
   }
 
-  /* _ValidateAddress {{{4
-   * ----------------
+  /* _PendingExceptionDetails {{{4
+   * ------------------------
    */
-  std::tuple<ExcInfo, AddressDescriptor> _ValidateAddress(uint32_t addr, AccType accType, bool isPriv, bool secure, bool isWrite, bool aligned) {
-    AddressDescriptor result;
-    Permissions       perms;
-
-    bool    ns            = false; // UNKNOWN
-    ExcInfo excInfo       = _DefaultExcInfo();
-    bool    isInstrFetch  = (accType == AccType_IFETCH);
-
-    bool secureMpu;
-    SAttributes sAttrib;
-    if (_HaveSecurityExt()) {
-      sAttrib = _SecurityCheck(addr, isInstrFetch, secure);
-      if (isInstrFetch) {
-        ns        = sAttrib.ns;
-        secureMpu = !sAttrib.ns;
-        isPriv    = _CurrentModeIsPrivileged(secureMpu);
-      } else {
-        ns        = (!secure || sAttrib.ns);
-        secureMpu = secure;
-      }
-    } else {
-      ns        = true;
-      secureMpu = false;
+  // XXX: Unfortunately the ARM ISA manual exceptionally does not give a definition
+  // for this function. Its definition has been estimated via reference to qemu's codebase.
+  //
+  // XXX: This function has been augmented relative to the ARM ISA manual to add an argument
+  // `ignorePrimask`, which is useful for implementing WFI.
+  //
+  // TODO: DHCSR.C_MASKINTS
+  std::tuple<bool, int, bool> _PendingExceptionDetails(bool ignorePrimask=false) {
+    // Skip the check if it found nothing last time and nothing it depends on
+    // has changed since (see IntrCheck).
+    if (_ic.idle && _ic.ignorePrimask == ignorePrimask
+        && (_ic.deadline == std::chrono::steady_clock::time_point::max()
+            || std::chrono::steady_clock::now() < _ic.deadline)) {
+      VERIFY_CACHE(!(_ExecutionPriority(ignorePrimask) > std::get<0>(_PendingExceptionDetailsActual())));
+      return {false, 0, false};
     }
 
-    std::tie(result.memAttrs, perms) = _MPUCheck(addr, accType, isPriv, secureMpu);
-    result.memAttrs.ns = ns;
+    // XXX: Not specified exactly where SysTick should be checked, so we choose
+    // to check it here like everything else.
+    bool systIntrS  = (_HaveSysTick() && _SystGetIntrFlag(false, true));
+    bool systIntrNS = (_HaveSysTick() == 2 && _SystGetIntrFlag(true, true));
+    if (systIntrS)
+      _SetPending(SysTick, true, true);
+    if (systIntrNS)
+      _SetPending(SysTick, false, true);
 
-    if (!aligned && result.memAttrs.memType == MemType_Device && perms.apValid) {
-      InternalOr32(REG_CFSR, REG_CFSR__UFSR__UNALIGNED);
-      excInfo = _CreateException(UsageFault, false, false/*UNKNOWN*/);
-    }
+    // _NvicPendingPriority() has a value higher than the highest possible
+    // priority value if there is no pending interrupt so there is an interrupt
+    // to be handled iff this is true.
+    auto [pendingPrio, pendingExcNo, excIsSecure] = _PendingExceptionDetailsActual();
+    bool canTakePendingExc = (_ExecutionPriority(ignorePrimask) > pendingPrio);
 
-    if (excInfo.fault == NoFault && _HaveSecurityExt()) {
-      bool raiseSecFault = false;
-      if (isInstrFetch) {
-        if (secure) {
-          if (sAttrib.ns) {
-            InternalOr32(REG_SFSR, REG_SFSR__INVTRAN);
-            raiseSecFault = true;
-          }
-        } else {
-          if (!sAttrib.ns && !sAttrib.nsc) {
-            InternalOr32(REG_SFSR, REG_SFSR__INVEP);
-            raiseSecFault = true;
-          }
-        }
-      } else {
-        if (!secure && !sAttrib.ns) {
-          if (_HaveMainExt() && accType != AccType_VECTABLE) {
-            if (accType == AccType_LAZYFP)
-              InternalOr32(REG_SFSR, REG_SFSR__LSPERR);
-            else
-              InternalOr32(REG_SFSR, REG_SFSR__AUVIOL);
-            InternalOr32(REG_SFSR, REG_SFSR__SFARVALID);
-            InternalStore32(REG_SFAR, addr);
-          }
-          raiseSecFault = true;
-        }
-      }
-      if (raiseSecFault)
-        excInfo = _CreateException(SecureFault, true, true);
+    if (!canTakePendingExc) {
+      _ic.idle          = true;
+      _ic.ignorePrimask = ignorePrimask;
+      _ic.deadline      = _HaveSysTick() ? _SystGetIntrDeadline() : std::chrono::steady_clock::time_point::max();
+      return {false, 0, false};
     }
 
-    result.physAddr = addr;
-    result.accAttrs.isWrite = isWrite;
-    result.accAttrs.isPriv  = isPriv;
-    result.accAttrs.accType = accType;
-
-    if (excInfo.fault == NoFault)
-      excInfo = _CheckPermission(perms, addr, accType, isWrite, isPriv, secureMpu);
-
-    return {excInfo, result};
+    return {true, pendingExcNo, excIsSecure};
   }
 
-  /* _MemO {{{4
-   * -----
+  /* IntrCheck {{{4
+   * ---------
+   * Lets _PendingExceptionDetails skip the check after an instruction when the
+   * previous check found no exception to take and nothing that could change
+   * that has happened since. idle is cleared by _ExcStateChanged, which is
+   * called whenever the pending, enable or active state of an exception,
+   * PRIMASK, BASEPRI, FAULTMASK, an exception priority or a SysTick
+   * configuration changes. A SysTick timer may also raise its interrupt
+   * without any of these, so the check is repeated once the time given by
+   * SysTickGetIntrDeadline has passed.
+   */
+  struct IntrCheck {
+    bool          idle = false;
+    bool          ignorePrimask;
+    std::chrono::steady_clock::time_point deadline;
+  };
+
+  /* _ExcStateChanged {{{4
+   * ----------------
    */
-  uint32_t _MemO(uint32_t addr, int size) {
-    auto [excInfo, value] = _MemA_with_priv_security(addr, size, AccType_ORDERED, _FindPriv(), _IsSecure(), true);
-    _HandleException(excInfo);
-    return value;
+  void _ExcStateChanged() {
+    _ic.idle = false;
   }
 
-  void _MemO(uint32_t addr, int size, uint32_t value) {
-    auto excInfo = _MemA_with_priv_security(addr, size, AccType_ORDERED, _FindPriv(), _IsSecure(), true, value);
-    _HandleException(excInfo);
-  }
+  /* PendingSet {{{4
+   * ----------
+   * The pending exceptions which can be taken, indexed by effective group
+   * priority, so that _PendingExceptionDetailsActual can find the one to take
+   * next without scanning every exception.
+   *
+   * Each pending exception occupies a slot. Slots 0-31 are the system
+   * exceptions, two per exception number (Secure then Non-secure), and the
+   * remaining slots are the external interrupts in order, so that the lowest
+   * numbered slot at a given priority is the one the architecture takes first.
+   * External interrupts only occupy a slot while they are enabled. For each
+   * priority level there is a bitmap of slots, a word saying which words of
+   * that bitmap are nonzero, and a summary bitmap saying which levels are
+   * nonempty.
+   *
+   * _SetPending and _SetEnable move the affected slots; stores to the
+   * registers on which _ExceptionPriority and _ExceptionTargetsSecure depend
+   * invalidate the whole set and the next lookup rebuilds it from excPending.
+   */
+  struct PendingSet {
+    static constexpr int NUM_SLOT   = 32 + NUM_EXC - 16;
+    static constexpr int NUM_WORD   = (NUM_SLOT + 63)/64;
+    static constexpr int NUM_LEVEL  = 4 + 256; // Priorities -4 to 255
+    static constexpr int NO_LEVEL   = -1;
+
+    uint64_t      slots[NUM_LEVEL][NUM_WORD] = {};
+    uint16_t      words[NUM_LEVEL] = {};
+    uint64_t      levels[(NUM_LEVEL + 63)/64] = {};
+    int16_t       levelOf[NUM_SLOT] = {};
+    bool          valid = false;
+  };
 
-  /* _MemU {{{4
-   * -----
+  /* _InvalidatePendingSet {{{4
+   * ---------------------
    */
-  uint32_t _MemU(uint32_t addr, int size) {
-    if (_HaveMainExt())
-      return _MemU_with_priv(addr, size, _FindPriv());
-    else
-      return _MemA(addr, size);
+  void _InvalidatePendingSet() {
+    _ps.valid = false;
   }
 
-  void _MemU(uint32_t addr, int size, uint32_t value) {
-    if (_HaveMainExt())
-      _MemU_with_priv(addr, size, _FindPriv(), value);
-    else
-      _MemA(addr, size, value);
+  /* _InvalidateExcPriorities {{{4
+   * ------------------------
+   * Called when the priority or target security state of any exception may
+   * have changed.
+   */
+  void _InvalidateExcPriorities() {
+    _ExcStateChanged();
+    _InvalidateExcPriTable();
+    _InvalidateExecPri();
+    _InvalidatePendingSet();
   }
 
-  /* _MemU_unpriv {{{4
-   * ------------
+  /* _PendingSlotRemove {{{4
+   * ------------------
    */
-  uint32_t _MemU_unpriv(uint32_t addr, int size) {
-    return _MemU_with_priv(addr, size, false);
-  }
+  void _PendingSlotRemove(int slot) {
+    int lvl = _ps.levelOf[slot];
+    if (lvl == PendingSet::NO_LEVEL)
+      return;
 
-  void _MemU_unpriv(uint32_t addr, int size, uint32_t value) {
-    _MemU_with_priv(addr, size, false, value);
+    int w = slot/64;
+    _ps.levelOf[slot] = PendingSet::NO_LEVEL;
+    _ps.slots[lvl][w] &= ~(uint64_t(1) << (slot%64));
+    if (!_ps.slots[lvl][w]) {
+      _ps.words[lvl] &= ~(1U << w);
+      if (!_ps.words[lvl])
+        _ps.levels[lvl/64] &= ~(uint64_t(1) << (lvl%64));
+    }
   }
 
-  /* _MemU_with_priv {{{4
-   * ---------------
+  /* _PendingSlotInsert {{{4
+   * ------------------
    */
-  uint32_t _MemU_with_priv(uint32_t addr, int size, bool priv) {
-    uint32_t value;
+  void _PendingSlotInsert(int slot, int excPrio) {
+    _PendingSlotRemove(slot);
 
-    // Do aligned access, take alignment fault, or do sequence of bytes
-    if (addr == _Align(addr, size)) {
-      value = _MemA_with_priv(addr, size, priv, true);
-    } else if (InternalLoad32(REG_CCR) & REG_CCR__UNALIGN_TRP) {
-      InternalOr32(REG_CFSR, REG_CFSR__UFSR__UNALIGNED);
-      auto excInfo = _CreateException(UsageFault, false, UNKNOWN_VAL(false));
-      _HandleException(excInfo);
-    } else { // if unaligned access
-      for (int i=0; i<size; ++i)
-        value = CHGBITS(value, 8*i, 8*i+7, _MemA_with_priv(addr+i, 1, priv, false));
-      // PPB (0xE0000000 to 0xE0100000) is always little endian
-      if ((InternalLoad32(REG_AIRCR) & REG_AIRCR__ENDIANNESS) && GETBITS(addr,20,31) != 0xE00)
-        value = _BigEndianReverse(value, size);
-    }
+    // Priority 256 is lower than any execution priority, so the exception
+    // could never be taken.
+    if (excPrio >= _HighestPri())
+      return;
 
-    return value;
+    int lvl = excPrio + 4;
+    int w   = slot/64;
+    _ps.levelOf[slot]   = lvl;
+    _ps.slots[lvl][w]  |= uint64_t(1) << (slot%64);
+    _ps.words[lvl]     |= 1U << w;
+    _ps.levels[lvl/64] |= uint64_t(1) << (lvl%64);
   }
 
-  void _MemU_with_priv(uint32_t addr, int size, bool priv, uint32_t value) {
-    // Do aligned access, take alignment fault, or do sequence of bytes
-    if (addr == _Align(addr, size))
-      _MemA_with_priv(addr, size, priv, true, value);
-    else if (InternalLoad32(REG_CCR) & REG_CCR__UNALIGN_TRP) {
-      InternalOr32(REG_CFSR, REG_CFSR__UFSR__UNALIGNED);
-      auto excInfo = _CreateException(UsageFault, false, UNKNOWN_VAL(false));
-      _HandleException(excInfo);
-    } else { // if unaligned access
-      // PPB (0xE0000000 to 0xE010000) is always little endian
-      if ((InternalLoad32(REG_AIRCR) & REG_AIRCR__ENDIANNESS) && GETBITS(addr,20,31) != 0xE00)
-        value = _BigEndianReverse(value, size);
-      for (int i=0; i<size; ++i)
-        _MemA_with_priv(addr+i, 1, priv, false, GETBITS(value, 8*i, 8*i+7));
+  /* _UpdatePendingSlots {{{4
+   * -------------------
+   * Moves the slots for the given exception to reflect its current pending
+   * and enable state and priority.
+   */
+  void _UpdatePendingSlots(int exc) {
+    if (exc < NMI)
+      return; // Reset is not handled here
+
+    if (exc < 16)
+      for (int j=0; j<2; ++j) { // j=0: secure exception, j=1: non-secure exception
+        int slot = exc*2 + j;
+        if (_s.excPending[exc] & BIT(j)) {
+          bool excIsSecure = _ExceptionTargetsSecure(exc, j == 0);
+          _PendingSlotInsert(slot, _ExceptionPriority(exc, excIsSecure, /*applyPrigroup=*/true));
+        } else
+          _PendingSlotRemove(slot);
+      }
+    else {
+      int slot = 32 + exc - 16;
+      if (_s.excPending[exc] && _s.excEnable[exc]) {
+        bool intrIsSecure = _ExceptionTargetsSecure(exc, false/*doesn't matter*/);
+        _PendingSlotInsert(slot, _ExceptionPriority(exc, intrIsSecure, /*applyPrigroup=*/true));
+      } else
+        _PendingSlotRemove(slot);
     }
   }
 
-  /* _MemA {{{4
-   * -----
+  /* _UpdatePendingSet {{{4
+   * -----------------
    */
-  uint32_t _MemA(uint32_t addr, int size) {
-    return _MemA_with_priv(addr, size, _FindPriv(), true);
+  void _UpdatePendingSet(int exc) {
+    if (_ps.valid)
+      _UpdatePendingSlots(exc);
+    else
+      _InvalidatePendingSet();
   }
 
-  void _MemA(uint32_t addr, int size, uint32_t value) {
-    _MemA_with_priv(addr, size, _FindPriv(), true, value);
+  /* _RebuildPendingSet {{{4
+   * ------------------
+   */
+  void _RebuildPendingSet() {
+    memset(_ps.slots, 0, sizeof(_ps.slots));
+    memset(_ps.words, 0, sizeof(_ps.words));
+    memset(_ps.levels, 0, sizeof(_ps.levels));
+    for (int i=0; i<PendingSet::NUM_SLOT; ++i)
+      _ps.levelOf[i] = PendingSet::NO_LEVEL;
+
+    _ps.valid = true;
+
+    for (int i=NMI; i<=_MaxExceptionNum(); ++i)
+      if (_s.excPending[i])
+        _UpdatePendingSlots(i);
   }
 
-  /* _MemA_with_priv {{{4
-   * ---------------
+  /* _PendingExceptionDetailsActual {{{4
+   * ------------------------------
+   * XXX: Custom function, not found in ISA definition. Returns the priority,
+   * number and target security state of the pending exception which would be
+   * taken next, or a priority of 0x100 if there is none.
    */
-  uint32_t _MemA_with_priv(uint32_t addr, int size, bool priv, bool aligned) {
-    auto [excInfo, value] = _MemA_with_priv_security(addr, size, AccType_NORMAL, priv, _IsSecure(), aligned);
-    _HandleException(excInfo);
-    return value;
-  }
+  std::tuple<int,int,bool> _PendingExceptionDetailsActual() {
+    if unlikely (!_ps.valid)
+      _RebuildPendingSet();
+
+    std::tuple<int,int,bool> r{0x100, 0, false};
+    for (size_t w=0; w<ARRAYLEN(_ps.levels); ++w)
+      if (uint64_t m = _ps.levels[w]) {
+        int lvl   = w*64 + CTZL(m);
+        int word  = CTZL(_ps.words[lvl]);
+        int slot  = word*64 + CTZL(_ps.slots[lvl][word]);
+        int excNo = (slot < 32) ? slot/2 : slot - 32 + 16;
+        bool excIsSecure = _ExceptionTargetsSecure(excNo, slot < 32 ? !(slot%2) : false);
+        r = {lvl - 4, excNo, excIsSecure};
+        break;
+      }
 
-  void _MemA_with_priv(uint32_t addr, int size, bool priv, bool aligned, uint32_t value) {
-    auto excInfo = _MemA_with_priv_security(addr, size, AccType_NORMAL, priv, _IsSecure(), aligned, value);
-    _HandleException(excInfo);
+    VERIFY_CACHE(r == _ScanPendingExceptionDetails());
+    return r;
   }
 
-  /* _MemA_with_priv_security {{{4
-   * ------------------------
+  /* _ScanPendingExceptionDetails {{{4
+   * ----------------------------
+   * As for _PendingExceptionDetailsActual, but determined by scanning every
+   * exception. Used only to check the pending set (see EMU_VERIFY_CACHES).
    */
-  std::tuple<ExcInfo, uint32_t> _MemA_with_priv_security(uint32_t addr, int size, AccType accType, bool priv, bool secure, bool aligned) {
-    ExcInfo excInfo = _DefaultExcInfo();
-    if (!_IsAligned(addr, size)) {
-      if (_HaveMainExt())
-        InternalOr32(REG_CFSR, REG_CFSR__UFSR__UNALIGNED);
-      excInfo = _CreateException(UsageFault, true, secure);
-    }
+  std::tuple<int,int,bool> _ScanPendingExceptionDetails() {
+    int  maxPrio      = 0x100; // Higher than any possible execution priority
+    int  maxPrioExc   = 0;
+    bool excIsSecure  = false;
 
-    uint32_t value;
-    AddressDescriptor memAddrDesc;
-    if (excInfo.fault == NoFault)
-      std::tie(excInfo, memAddrDesc) = _ValidateAddress(addr, accType, priv, secure, false, aligned);
+    for (int i=NMI; i<16; ++i) { // Reset is not handled here
+      for (int j=0; j<2; ++j) { // j=0: secure exception, j=1: non-secure exception
+        if (!(_s.excPending[i] & BIT(j)))
+          continue;
 
-    if (excInfo.fault == NoFault) {
-      bool error;
-      std::tie(error, value) = _GetMem(memAddrDesc, size);
+        bool excIsSecure_ = _ExceptionTargetsSecure(i, j == 0);
+        int  excPrio      = _ExceptionPriority(i, excIsSecure_, /*applyPrigroup=*/true);
 
-      if (error) {
-        value = UNKNOWN_VAL(0xFFFF'FFFF);
-        if (_HaveMainExt()) {
-          if (accType == AccType_STACK)
-            InternalOr32(REG_CFSR, REG_CFSR__BFSR__UNSTKERR);
-          else if (accType == AccType_NORMAL || accType == AccType_ORDERED) {
-            uint32_t bfar = InternalLoad32(REG_BFAR);
-            bfar = CHGBITSM(bfar, REG_BFAR__ADDRESS, addr);
-            InternalStore32(REG_BFAR, bfar);
-            InternalMaskOr32(REG_CFSR, _cfg.MmfarBfarMerged() ? REG_CFSR__MMFSR__MMARVALID : 0,
-              REG_CFSR__BFSR__BFARVALID | REG_CFSR__BFSR__PRECISERR);
-          }
+        if (excPrio < maxPrio) {
+          maxPrio     = excPrio;
+          maxPrioExc  = i;
+          excIsSecure = excIsSecure_;
         }
+      }
+    }
 
-        if (!_IsReqExcPriNeg(secure) || !(InternalLoad32(REG_CCR) & REG_CCR__BFHFNMIGN))
-          excInfo = _CreateException(BusFault, false, false/*UNKNOWN*/);
-      } else if ((InternalLoad32(REG_AIRCR) & REG_AIRCR__ENDIANNESS) && GETBITS(addr,20,31) != 0xE00)
-        value = _BigEndianReverse(value, size);
+    for (int i=16; i<=_MaxExceptionNum(); ++i) {
+      if (!_s.excPending[i] || !_s.excEnable[i])
+        continue;
 
-      if (_IsDWTEnabled()) {
-        uint32_t dvalue = value;
-        _DWT_DataMatch(addr, size, dvalue, true, secure);
+      bool intrIsSecure = _ExceptionTargetsSecure(i, false/*doesn't matter*/);
+      int  intrPrio     = _ExceptionPriority(i, intrIsSecure, /*applyPrigroup=*/true);
+      if (intrPrio < maxPrio) {
+        maxPrio     = intrPrio;
+        maxPrioExc  = i;
+        excIsSecure = intrIsSecure;
       }
     }
 
-    return {excInfo, value};
+    return {maxPrio, maxPrioExc, excIsSecure};
   }
 
-  ExcInfo _MemA_with_priv_security(uint32_t addr, int size, AccType accType, bool priv, bool secure, bool aligned, uint32_t value) {
-    ExcInfo excInfo = _DefaultExcInfo();
+  /* ExecPriCache {{{4
+   * ------------
+   * _RawExecutionPriority would otherwise scan every exception number in both
+   * security states, and is called for every exception entry and return and
+   * whenever pending exceptions are checked. Instead we cache its result, and
+   * keep a bitmap of the exceptions with a nonzero excActive entry so that
+   * recomputing it only visits those.
+   *
+   * Activating an exception can only lower the value, so _SetActive folds the
+   * new exception's priority in; deactivation, reset, and stores to the
+   * registers on which _ExceptionPriority and _IsActiveForState depend (SHPRn,
+   * NVIC_IPRn, NVIC_ITNSn, AIRCR and ICSR.STTNS) invalidate it and the next
+   * call recomputes it from the bitmap.
+   */
+  struct ExecPriCache {
+    int           pri;
+    bool          valid = false;
+    uint64_t      active[NUM_EXC/64]{};
+  };
 
-    if (!_IsAligned(addr, size)) {
-      if (_HaveMainExt())
-        InternalOr32(REG_CFSR, REG_CFSR__UFSR__UNALIGNED);
-      excInfo = _CreateException(UsageFault, true, secure);
-    }
+  /* _InvalidateExecPri {{{4
+   * ------------------
+   */
+  void _InvalidateExecPri() {
+    _xp.valid = false;
+  }
 
-    AddressDescriptor memAddrDesc;
-    if (excInfo.fault == NoFault)
-      std::tie(excInfo, memAddrDesc) = _ValidateAddress(addr, accType, priv, secure, true, aligned);
+  /* _UpdateActiveMap {{{4
+   * ----------------
+   * Re-derives the bitmap of active exceptions from CpuState.
+   */
+  void _UpdateActiveMap() {
+    for (int i=0; i<NUM_EXC/64; ++i)
+      _xp.active[i] = 0;
+    for (int i=0; i<NUM_EXC; ++i)
+      if (_s.excActive[i])
+        _xp.active[i/64] |= uint64_t(1) << (i%64);
+    _InvalidateExecPri();
+    _ExcStateChanged();
+  }
 
-    if (excInfo.fault == NoFault) {
-      if (memAddrDesc.memAttrs.shareable)
-        _ClearExclusiveByAddress(memAddrDesc.physAddr, _ProcessorID(), size);
+  /* _IsPriorityReg {{{4
+   * --------------
+   * Returns true for SCS registers on which _ExceptionPriority and
+   * _IsActiveForState depend, other than ICSR. Writes to these invalidate the
+   * cached execution priority.
+   */
+  static bool _IsPriorityReg(phys_t addr) {
+    addr &= ~0x0002'0000U; // Non-Secure alias
+    return (addr >= 0xE000'E380 && addr < 0xE000'E3C0)
+        || (addr >= 0xE000'E400 && addr < 0xE000'E5F0)
+        || (addr >= 0xE000'ED18 && addr < 0xE000'ED24)
+        ||  addr == 0xE000'ED0C;
+  }
 
-      if (_IsDWTEnabled()) {
-        uint32_t dvalue = value;
-        _DWT_DataMatch(addr, size, dvalue, false, secure);
-      }
+  /* _RawExecutionPriority {{{4
+   * ---------------------
+   */
+  int _RawExecutionPriority() {
+    if unlikely (!_xp.valid) {
+      _xp.pri   = _ActiveRawExecutionPriority();
+      _xp.valid = true;
+    }
 
-      if ((InternalLoad32(REG_AIRCR) & REG_AIRCR__ENDIANNESS) && GETBITS(addr,20,31) != 0xE00)
-        value = _BigEndianReverse(value, size);
+    VERIFY_CACHE(_xp.pri == _ScanRawExecutionPriority());
+    return _xp.pri;
+  }
 
-      if (_SetMem(memAddrDesc, size, value)) {
-        bool negativePri;
-        if (accType == AccType_LAZYFP)
-          negativePri = !(InternalLoad32(REG_FPCCR_S) & REG_FPCCR__HFRDY);
-        else
-          negativePri = _IsReqExcPriNeg(secure);
+  /* _ActiveRawExecutionPriority {{{4
+   * ---------------------------
+   * As for _ScanRawExecutionPriority, but only visits the exceptions marked in
+   * the active bitmap.
+   */
+  int _ActiveRawExecutionPriority() {
+    int execPri = _HighestPri();
+    for (int w=0; w<NUM_EXC/64; ++w)
+      for (uint64_t m = _xp.active[w]; m; m &= m - 1) {
+        int i = w*64 + CTZL(m);
+        if (i < 2 || i > _MaxExceptionNum())
+          continue;
 
-        if (_HaveMainExt()) {
-          if (accType == AccType_STACK)
-            InternalOr32(REG_CFSR, REG_CFSR__BFSR__STKERR);
-          else if (accType == AccType_LAZYFP)
-            InternalOr32(REG_CFSR, REG_CFSR__BFSR__LSPERR);
-          else if (accType == AccType_NORMAL || accType == AccType_ORDERED) {
-            InternalStore32(REG_BFAR, addr);
-            InternalMaskOr32(REG_CFSR, _cfg.MmfarBfarMerged() ? REG_CFSR__MMFSR__MMARVALID : 0,
-              REG_CFSR__BFSR__BFARVALID | REG_CFSR__BFSR__PRECISERR);
+        for (int j=0; j<2; ++j) {
+          bool secure = !j;
+          if (_IsActiveForState(i, secure)) {
+            int effectivePriority = _ExceptionPriority(i, secure, true);
+            if (effectivePriority < execPri)
+              execPri = effectivePriority;
           }
         }
+      }
+
+    return execPri;
+  }
 
-        if (!negativePri || !(InternalLoad32(REG_CCR) & REG_CCR__BFHFNMIGN))
-          excInfo = _CreateException(BusFault, false, false/*UNKNOWN*/);
+  /* _ScanRawExecutionPriority {{{4
+   * -------------------------
+   * Corresponds to RawExecutionPriority in the ISA manual. Used only to check
+   * the cached value (see EMU_VERIFY_CACHES).
+   */
+  int _ScanRawExecutionPriority() {
+    int execPri = _HighestPri();
+    for (int i=2; i<=_MaxExceptionNum(); ++i)
+      for (int j=0; j<2; ++j) {
+        bool secure = !j;
+        if (_IsActiveForState(i, secure)) {
+          int effectivePriority = _ExceptionPriority(i, secure, true);
+          if (effectivePriority < execPri)
+            execPri = effectivePriority;
+        }
       }
-    }
 
-    return excInfo;
+    return execPri;
   }
 
-  /* _ClearExclusiveByAddress {{{4
-   * ------------------------
+  /* _HighestPri {{{4
+   * -----------
    */
-  void _ClearExclusiveByAddress(uint32_t addr, int exclProcID, int size) {
-    auto lk = _gm.Lock();
-    _gm.ClearExclusiveByAddress(addr, exclProcID, size);
+  int _HighestPri() {
+    return 256;
   }
 
-  /* _IsAligned {{{4
-   * ----------
+  /* _RestrictedNSPri {{{4
+   * ----------------
    */
-  bool _IsAligned(uint32_t addr, int size) {
-    assert(size == 1 || size == 2 || size == 4 || size == 8);
-    uint32_t mask = (size-1);
-    return !(addr & mask);
+  int _RestrictedNSPri() {
+    return 0x80;
   }
 
-  /* _MPUCheck {{{4
+  /* _FindPriv {{{4
    * ---------
    */
-  std::tuple<MemoryAttributes, Permissions> _MPUCheck(uint32_t addr, AccType accType, bool isPriv, bool secure) {
-    assert(_HaveSecurityExt() || !secure);
+  bool _FindPriv() {
+    return _CurrentModeIsPrivileged();
+  }
 
-    MemoryAttributes  attrs       = _DefaultMemoryAttributes(addr);
-    Permissions       perms       = _DefaultPermissions(addr);
-    bool              hit         = false;
-    bool              isPPBAccess = (GETBITS(addr,20,31) == 0b111000000000);
+  /* _ExceptionEntry {{{4
+   * ---------------
+   */
+  ExcInfo _ExceptionEntry(int excType, bool toSecure, bool instExecOk) {
+    ExcInfo exc = _PushStack(toSecure, instExecOk);
+    if (exc.fault == NoFault)
+      exc = _ExceptionTaken(excType, false, toSecure, false);
+    return exc;
+  }
 
-    uint32_t mpuCtrl, mpuType;
-    uint64_t mair;
-    if (secure) {
-      mpuCtrl = InternalLoad32(REG_MPU_CTRL_S);
-      mpuType = InternalLoad32(REG_MPU_TYPE_S);
-      mair    = (uint64_t(InternalLoad32(REG_MPU_MAIR1_S))<<32) | (uint64_t)InternalLoad32(REG_MPU_MAIR0_S);
-    } else {
-      mpuCtrl = InternalLoad32(REG_MPU_CTRL_NS);
-      mpuType = InternalLoad32(REG_MPU_TYPE_NS);
-      mair    = (uint64_t(InternalLoad32(REG_MPU_MAIR1_NS))<<32) | (uint64_t)InternalLoad32(REG_MPU_MAIR0_NS);
-    }
+  /* _PushStack {{{4
+   * ----------
+   */
+  ExcInfo _PushStack(bool secureExc, bool instExecOk) {
+    auto &control = _IsSecure() ? _s.controlS : _s.controlNS;
 
-    bool negativePri;
-    if (accType == AccType_LAZYFP)
-      negativePri = !(InternalLoad32(REG_FPCCR_S) & REG_FPCCR__HFRDY);
-    else
-      negativePri = _IsReqExcPriNeg(secure);
+    uint32_t frameSize;
+    if (_HaveFPExt() && GETBITSM(control, CONTROL__FPCA) && (_IsSecure() || GETBITSM(InternalLoad32(REG_NSACR), REG_NSACR__CP(10)))) {
+      if (_IsSecure() && GETBITSM(InternalLoad32(REG_FPCCR_S), REG_FPCCR__TS))
+        frameSize = 0xA8;
+      else
+        frameSize = 0x68;
+    } else
+      frameSize = 0x20;
 
-    if (accType == AccType_VECTABLE || isPPBAccess)
-      hit = true;
-    else if (!(mpuCtrl & REG_MPU_CTRL__ENABLE)) {
-      if (mpuCtrl & REG_MPU_CTRL__HFNMIENA) {
-        // XXX(UNPREDICTABLE): We do not want to throw UNPREDICTABLE here as this
-        // function can be ultimately called by _InstructionAdvance().
-        // Where the MPU is not enabled, we choose to handle this case the same as
-        // if this bit were not set.
-        QUIET_UNPREDICTABLE("HFNMIENA set when MPU not enabled\n");
-        hit = true;
-      } else
-        hit = true;
-    } else if (!(mpuCtrl & REG_MPU_CTRL__HFNMIENA) && negativePri)
-      hit = true;
-    else {
-      if ((mpuCtrl & REG_MPU_CTRL__PRIVDEFENA) && isPriv)
-        hit = true;
+    bool framePtrAlign = GETBIT(_GetSP(), 2);
+    uint32_t framePtr = (_GetSP() - frameSize) & ~BIT(2);
+    RName spName = _LookUpSP();
 
-      bool regionMatched = false;
-      int  numRegions = GETBITSM(mpuType, REG_MPU_TYPE__DREGION);
-      for (int r=0; r<numRegions; ++r) {
-        uint32_t rbar, rlar;
-        if (secure)
-          std::tie(rbar,rlar) = _InternalLoadMpuSecureRegion(r);
-        else
-          std::tie(rbar,rlar) = _InternalLoadMpuNonSecureRegion(r);
+    auto [retAddr, itState] = _ReturnState(instExecOk);
+    _SyncFlags();
+    uint32_t retpsr = _s.xpsr;
+    retpsr = CHGBITSM(retpsr, RETPSR__IT_ICI_LO, itState>>2);
+    retpsr = CHGBITSM(retpsr, RETPSR__IT_ICI_HI, itState);
+    retpsr = CHGBITSM(retpsr, RETPSR__SPREALIGN, framePtrAlign);
+    retpsr = CHGBITSM(retpsr, RETPSR__SFPA, _IsSecure() ? GETBITSM(_s.controlS, CONTROL__SFPA) : 0);
 
-        if (rlar & REG_MPU_RLAR__EN) {
-          if (   addr >= ( GETBITSM(rbar, REG_MPU_RBAR__BASE )<<5)
-              && addr <= ((GETBITSM(rlar, REG_MPU_RLAR__LIMIT)<<5) | 0b11111)) {
-            uint32_t sh = 0;
-            if (regionMatched) {
-              perms.regionValid = false;
-              perms.region      = 0;
-              hit               = false;
-            } else {
-              regionMatched = true;
-              perms.ap      = GETBITSM(rbar, REG_MPU_RBAR__AP);
-              perms.xn      = GETBITSM(rbar, REG_MPU_RBAR__XN);
-              perms.region  = r & 0xFF;
-              perms.regionValid = true;
-              hit = true;
-              sh = GETBITSM(rbar, REG_MPU_RBAR__SH);
-            }
+    PEMode mode = _CurrentMode();
+    uint32_t frame[8] = {_GetR(0), _GetR(1), _GetR(2), _GetR(3), _GetR(12), _GetLR(), retAddr, retpsr};
+    ExcInfo exc = _StackStoreBurst(framePtr, 0x00, spName, mode, frame, 8);
+
+    if (_HaveFPExt() && GETBITSM(control, CONTROL__FPCA)) {
 
-            uint32_t idx        = GETBITSM(rlar, REG_MPU_RLAR__ATTR_IDX);
-            uint32_t attrField  = GETBITS(mair, 8*idx, 8*idx + 7);
-            attrs               = _MAIRDecode(attrField, sh);
-          }
-        }
-      }
     }
 
-    if (GETBITS(addr,29,31) == 0b111)
-      perms.xn = true;
+    ExcInfo spExc = _SetSP(spName, true, framePtr);
+    exc = _MergeExcInfo(exc, spExc);
 
-    if (!hit)
-      perms.apValid = false;
+    bool isSecure = _IsSecure();
+    bool isThread = (mode == PEMode_Thread);
+    if (_HaveFPExt())
+      _SetLR(BITS(7,31) | (uint32_t(isSecure)<<6) | (uint32_t(isThread)<<3) | 0b100000 | ((GETBITSM(control, CONTROL__FPCA)^1)<<4));
+    else
+      _SetLR(BITS(7,31) | (uint32_t(isSecure)<<6) | (uint32_t(isThread)<<3) | 0b110000);
 
-    return {attrs, perms};
+    return exc;
   }
 
-  /* _MAIRDecode {{{4
-   * -----------
+  /* _MergeExcInfo {{{4
+   * -------------
    */
-  MemoryAttributes _MAIRDecode(uint8_t attrField, uint8_t sh) {
-    MemoryAttributes memAttrs;
-    bool unpackInner;
-
-    if (!GETBITS(attrField, 4, 7)) {
-      unpackInner = false;
-      memAttrs.memType        = MemType_Device;
-      memAttrs.shareable      = true;
-      memAttrs.outerShareable = true;
-      memAttrs.innerAttrs     = 0; // UNKNOWN
-      memAttrs.outerAttrs     = 0; // UNKNOWN
-      memAttrs.innerHints     = 0; // UNKNOWN
-      memAttrs.outerHints     = 0; // UNKNOWN
-      memAttrs.innerTransient = false; // UNKNOWN
-      memAttrs.outerTransient = false; // UNKNOWN
-      switch (GETBITS(attrField, 0, 3)) {
-        case 0b0000: memAttrs.device = DeviceType_nGnRnE; break;
-        case 0b0100: memAttrs.device = DeviceType_nGnRE; break;
-        case 0b1000: memAttrs.device = DeviceType_nGRE; break;
-        case 0b1100: memAttrs.device = DeviceType_GRE; break;
-      }
-      if (GETBITS(attrField, 0, 1)) {
-        // XXX(UNPREDICTABLE): This function may be called ultimately by
-        // _InstructionAdvance() so we should not raise UNPREDICTABLE here. If
-        // these reserved bits are set when they should not be, we simply
-        // ignore them, which is a plausible implementation.
-        QUIET_UNPREDICTABLE("invalid MAIR configuration\n");
-      }
-    } else {
-      unpackInner = true;
-      memAttrs.memType        = MemType_Normal;
-      memAttrs.device         = DeviceType_GRE; // UNKNOWN
-      memAttrs.outerHints     = GETBITS(attrField, 4, 5);
-      memAttrs.shareable      = (sh & BIT(1));
-      memAttrs.outerShareable = (sh == 0b10);
-      if (sh == 0b01) {
-        // XXX(UNPREDICTABLE): See above.
-        QUIET_UNPREDICTABLE("invalid MAIR configuration\n");
-      }
-
-      if (GETBITS(attrField, 6, 7) == 0b00) {
-        memAttrs.outerAttrs       = 0b10;
-        memAttrs.outerTransient   = true;
-      } else if (GETBITS(attrField, 6, 7) == 0b01) {
-        if (GETBITS(attrField, 4, 5) == 0b00) {
-          memAttrs.outerAttrs     = 0b00;
-          memAttrs.outerTransient = false;
-        } else {
-          memAttrs.outerAttrs     = 0b11;
-          memAttrs.outerTransient = true;
-        }
-      } else {
-        memAttrs.outerAttrs     = GETBITS(attrField, 6, 7);
-        memAttrs.outerTransient = false;
-      }
-    }
+  ExcInfo _MergeExcInfo(const ExcInfo &a, const ExcInfo &b) {
+    ExcInfo exc, pend;
 
-    if (unpackInner) {
-      if (GETBITS(attrField, 0, 3) == 0b0000) {
-        // XXX(UNPREDICTABLE): See above.
-        QUIET_UNPREDICTABLE("invalid MAIR configuration\n");
-        memAttrs.innerAttrs     = 0;      // dummy values
-        memAttrs.innerHints     = 0;      //
-        memAttrs.innerTransient = false;  //
-      } else {
-        if (GETBITS(attrField, 2, 3) == 0b00) {
-          memAttrs.innerAttrs     = 0b10;
-          memAttrs.innerHints     = GETBITS(attrField, 0, 1);
-          memAttrs.innerTransient = true;
-        } else if (GETBITS(attrField, 2, 3) == 0b01) {
-          memAttrs.innerHints     = GETBITS(attrField, 0, 1);
-          if (GETBITS(attrField, 0, 1) == 0b00) {
-            memAttrs.innerAttrs     = 0b00;
-            memAttrs.innerTransient = false;
-          } else {
-            memAttrs.innerAttrs     = 0b11;
-            memAttrs.innerTransient = true;
-          }
-        } else if (GETBITS(attrField, 2, 3) == 0b10) {
-          memAttrs.innerHints     = GETBITS(attrField, 0, 1);
-          memAttrs.innerAttrs     = 0b10;
-          memAttrs.innerTransient = false;
-        } else if (GETBITS(attrField, 2, 3) == 0b11) {
-          memAttrs.innerHints     = GETBITS(attrField, 0, 1);
-          memAttrs.innerAttrs     = 0b11;
-          memAttrs.innerTransient = false;
-        } else {
-          // XXX(UNPREDICTABLE): See above.
-          QUIET_UNPREDICTABLE("invalid MAIR configuration\n");
-          memAttrs.innerAttrs     = 0;      // dummy values
-          memAttrs.innerHints     = 0;      // dummy values
-          memAttrs.innerTransient = false;  // dummy values
-        }
+    if (b.fault == NoFault || (a.isTerminal && !b.isTerminal))
+      exc = a;
+    else if (a.fault == NoFault || (b.isTerminal && !a.isTerminal))
+      exc = b;
+    else if (a.fault == b.fault && a.isSecure == b.isSecure)
+      exc = a;
+    else {
+      int aPri = _ExceptionPriority(a.fault, a.isSecure, false);
+      int bPri = _ExceptionPriority(b.fault, b.isSecure, false);
+
+      if (aPri < bPri) {
+        exc  = a;
+        pend = b;
+      } else {
+        exc  = b;
+        pend = a;
       }
+
+      if (IMPL_DEF_OVERRIDDEN_EXCEPTIONS_PENDED)
+        _SetPending(pend.fault, pend.isSecure, true);
     }
 
-    return memAttrs;
+    return exc;
   }
 
-  /* _CheckPermission {{{4
-   * ----------------
+  /* _ReturnState {{{4
+   * ------------
    */
-  ExcInfo _CheckPermission(const Permissions &perms, uint32_t addr, AccType accType, bool isWrite, bool isPriv, bool isSecure) {
-    bool fault = true;
-    if (!perms.apValid)
-      fault = true;
-    else if (perms.xn && accType == AccType_IFETCH)
-      fault = true;
+  std::tuple<uint32_t, uint8_t> _ReturnState(bool instExecOk) {
+    if (instExecOk)
+      return {_NextInstrAddr(), _NextInstrITState()};
     else
-      switch (perms.ap) {
-        case 0b00: fault = !isPriv; break;
-        case 0b01: fault = false; break;
-        case 0b10: fault = !isPriv || isWrite; break;
-        case 0b11: fault = isWrite; break;
-        default:
-          // XXX(UNPREDICTABLE): This can be called ultimately from
-          // _InstructionAdvance() so we should not throw here. Instead, treat
-          // the access as faulting.
-          QUIET_UNPREDICTABLE("invalid MPU range permission configuration\n");
-          fault = true;
-          break;
-      }
+      return {_ThisInstrAddr(), _ThisInstrITState()};
+  }
 
-    if (!fault)
-      return _DefaultExcInfo();
+  /* _DerivedLateArrival {{{4
+   * -------------------
+   */
+  void _DerivedLateArrival(int pePriority, int peNumber, bool peIsSecure, const ExcInfo &deInfo, int oeNumber, bool oeIsSecure) {
+    int oePriority = _ExceptionPriority(oeNumber, oeIsSecure, false);
 
-    if (_HaveMainExt()) {
-      uint8_t fsr = 0;
-      switch (accType) {
-        case AccType_IFETCH:
-          fsr |= REG_CFSR__MMFSR__IACCVIOL;
-          break;
-        case AccType_STACK:
-          if (isWrite)
-            fsr |= REG_CFSR__MMFSR__MSTKERR;
-          else
-            fsr |= REG_CFSR__MMFSR__MUNSTKERR;
-          break;
-        case AccType_LAZYFP:
-          fsr |= REG_CFSR__MMFSR__MLSPERR;
-          break;
-        case AccType_NORMAL:
-        case AccType_ORDERED:
-          fsr |= REG_CFSR__MMFSR__MMARVALID;
-          fsr |= REG_CFSR__MMFSR__DACCVIOL;
-          break;
-        default:
-          assert(false);
-          break;
-      }
+    bool deIsDbgMonFault = _HaveMainExt() ? deInfo.origFault == DebugMonitor : false;
 
-      uint32_t mask = (_cfg.MmfarBfarMerged() && !!(fsr & REG_CFSR__MMFSR__MMARVALID)) ? REG_CFSR__BFSR__BFARVALID : 0;
-      if (isSecure) {
-        InternalMaskOr32(REG_CFSR_S, mask, fsr);
-        if (fsr & REG_CFSR__MMFSR__MMARVALID)
-          InternalStore32(REG_MMFAR_S, addr);
+    bool targetIsSecure;
+    int targetFault;
+    if (deInfo.isTerminal) {
+      targetIsSecure  = deInfo.isSecure;
+      targetFault     = deInfo.fault;
+      if (!_ComparePriorities(deInfo, false, oePriority, oeNumber, oeIsSecure)) {
+        _ActivateException(oeNumber, oeIsSecure);
+        _Lockup(true);
+      }
+    } else if (deIsDbgMonFault && !_ComparePriorities(deInfo, true, pePriority, peNumber, peIsSecure)) {
+      _SetPending(DebugMonitor, deInfo.isSecure, false);
+      targetFault = oeNumber;
+      targetIsSecure = oeIsSecure;
+    } else if (_ComparePriorities(deInfo, false, oePriority, oeNumber, oeIsSecure)) {
+      targetFault = deInfo.fault;
+      targetIsSecure = deInfo.isSecure;
+    } else {
+      if (deInfo.lockup) {
+        _ActivateException(oeNumber, oeIsSecure);
+        _Lockup(true);
       } else {
-        InternalMaskOr32(REG_CFSR_NS, mask, fsr);
-        if (fsr & REG_CFSR__MMFSR__MMARVALID)
-          InternalStore32(REG_MMFAR_NS, addr);
+        targetFault = oeNumber;
+        targetIsSecure = oeIsSecure;
       }
     }
 
-    return _CreateException(MemManage, true, isSecure);
+    if (_HaveMainExt() && deInfo.fault == HardFault && deInfo.origFault != HardFault)
+      InternalOr32(REG_HFSR, REG_HFSR__FORCED);
+
+    _SetPending(deInfo.fault, deInfo.isSecure, true);
+    ExcInfo excInfo = _ExceptionTaken(targetFault, deInfo.inExcTaken, targetIsSecure, true);
+    if (excInfo.fault != NoFault)
+      _DerivedLateArrival(pePriority, peNumber, peIsSecure, excInfo, targetFault, targetIsSecure);
   }
 
-  /* _BigEndianReverse {{{4
-   * -----------------
+  /* _ComparePriorities {{{4
+   * ------------------
    */
-  uint32_t _BigEndianReverse(uint32_t value, int N) {
-    assert(N == 1 || N == 2 || N == 4);
-    uint32_t result;
-    switch (N) {
-      case 1:
-        return value & UINT8_MAX;
-      case 2:
-        return (uint16_t(value)>>8) | (uint16_t(value)<<8);
-      default:
-      case 4:
-        return
-          (GETBITS(value,24,31)<< 0)
-        | (GETBITS(value,16,23)<< 8)
-        | (GETBITS(value, 8,15)<<16)
-        | (GETBITS(value, 0, 7)<<24)
-        ;
+  bool _ComparePriorities(int exc0Pri, int exc0Number, bool exc0IsSecure,
+                          int exc1Pri, int exc1Number, bool exc1IsSecure) {
+    bool takeE0;
+    if (exc0Pri != exc1Pri)
+      takeE0 = (exc0Pri < exc1Pri);
+    else if (exc0Number != exc1Number)
+      takeE0 = (exc0Number < exc1Number);
+    else if (exc0IsSecure != exc1IsSecure)
+      takeE0 = exc0IsSecure;
+    else
+      takeE0 = false;
+    return takeE0;
+  }
+
+  bool _ComparePriorities(const ExcInfo &exc0Info, bool groupPri, int exc1Pri, int exc1Number, bool exc1IsSecure) {
+    int exc0Pri = _ExceptionPriority(exc0Info.fault, exc0Info.isSecure, groupPri);
+    return _ComparePriorities(exc0Pri, exc0Info.fault, exc0Info.isSecure, exc1Pri, exc1Number, exc1IsSecure);
+  }
+
+  /* _ActivateException {{{4
+   * ------------------
+   */
+  void _ActivateException(int excNo, bool excIsSecure) {
+    _s.curState = excIsSecure ? SecurityState_Secure : SecurityState_NonSecure;
+    _s.xpsr = CHGBITSM(_s.xpsr, XPSR__EXCEPTION, excNo);
+    if (_HaveMainExt())
+      _SetITSTATE(0);
+    uint32_t &control = _IsSecure() ? _s.controlS : _s.controlNS;
+    if (_HaveFPExt()) {
+      control = CHGBITSM(control, CONTROL__FPCA, 0);
+      _s.controlS = CHGBITSM(_s.controlS, CONTROL__SFPA, 0);
     }
+    control = CHGBITSM(control, CONTROL__SPSEL, 0);
+
+    _SetPending(excNo, excIsSecure, false);
+    _SetActive(excNo, excIsSecure, true);
   }
 
-  /* _DWT_DataMatch {{{4
-   * --------------
+  /* _SetActive {{{4
+   * ----------
    */
-  void _DWT_DataMatch(uint32_t daddr, int dsize, uint32_t dvalue, bool read, bool nsReq) {
-    bool triggerDebugEvent  = false;
-    bool debugEvent         = false;
+  void _SetActive(int exc, bool isSecure, bool setNotClear) {
+    if (!_HaveSecurityExt())
+      isSecure = false;
 
-    uint32_t numComp = GETBITSM(InternalLoad32(REG_DWT_CTRL), REG_DWT_CTRL__NUMCOMP);
-    if (!_HaveDWT() || !numComp)
-      return;
+    if (_IsExceptionTargetConfigurable(exc)) {
+      if (_ExceptionTargetsSecure(exc, isSecure/*UNKNOWN TODO*/) == isSecure)
+        _s.excActive[exc] = setNotClear ? 0b11 : 0b00;
+    } else {
+      uint32_t idx = isSecure ? 0 : 1;
+      _s.excActive[exc] = CHGBITS(_s.excActive[exc], idx, idx, setNotClear ? 1 : 0);
+    }
 
-    for (uint32_t i=0; i<numComp; ++i) {
-      if (_IsDWTConfigUnpredictable(i)) {
-        // XXX(UNPREDICTABLE): We do not want to throw here. UNPREDICTABLE DWT configurations
-        // are simply not considered.
-        QUIET_UNPREDICTABLE("invalid DWT configuration (comparator %u)\n", i);
-        continue;
+    _ExcStateChanged();
+    if (_s.excActive[exc])
+      _xp.active[exc/64] |=  (uint64_t(1) << (exc%64));
+    else
+      _xp.active[exc/64] &= ~(uint64_t(1) << (exc%64));
+
+    if (!setNotClear)
+      _InvalidateExecPri();
+    else if (_xp.valid)
+      for (int j=0; j<2; ++j) {
+        bool secure = !j;
+        if (_IsActiveForState(exc, secure))
+          _xp.pri = std::min(_xp.pri, _ExceptionPriority(exc, secure, true));
       }
+  }
+
+  /* _TailChain {{{4
+   * ----------
+   */
+  ExcInfo _TailChain(int excNo, bool excIsSecure, uint32_t excReturn) {
+    if (!_HaveFPExt())
+      excReturn = CHGBITSM(excReturn, EXC_RETURN__FTYPE, 1);
+    excReturn = CHGBITSM(excReturn, EXC_RETURN__PREFIX, 0xFF);
+    _SetLR(excReturn);
+
+    return _ExceptionTaken(excNo, true, excIsSecure, false);
+  }
+
+  /* _ConsumeExcStackFrame {{{4
+   * ---------------------
+   */
+  void _ConsumeExcStackFrame(uint32_t excReturn, bool fourByteAlign) {
+    bool toSecure = _HaveSecurityExt() && !!(excReturn & BIT(6));
+    uint32_t frameSize;
+    if (toSecure && (!GETBITSM(excReturn, EXC_RETURN__ES) || !GETBITSM(excReturn, EXC_RETURN__DCRS)))
+      frameSize = 0x48;
+    else
+      frameSize = 0x20;
+
+    if (_HaveFPExt() && !GETBITSM(excReturn, EXC_RETURN__FTYPE)) {
+      if (toSecure && (InternalLoad32(REG_FPCCR_S) & REG_FPCCR__TS))
+        frameSize = frameSize + 0x88;
+      else
+        frameSize = frameSize + 0x48;
+    }
+
+    PEMode mode = GETBITSM(excReturn, EXC_RETURN__MODE) == 1 ? PEMode_Thread : PEMode_Handler;
+    RName spName = _LookUpSP_with_security_mode(toSecure, mode);
+    _s.r[spName] = (_GetSP(spName) + frameSize) | (fourByteAlign ? 0b100 : 0);
+  }
+
+  /* _ExceptionReturn {{{4
+   * ----------------
+   */
+  std::tuple<ExcInfo, uint32_t> _ExceptionReturn(uint32_t excReturn) {
+    int returningExcNo = GETBITSM(_s.xpsr, XPSR__EXCEPTION);
+
+    ExcInfo exc;
+    std::tie(exc, excReturn) = _ValidateExceptionReturn(excReturn, returningExcNo);
+    if (exc.fault != NoFault)
+      return {exc, excReturn};
+
+    bool excSecure, retToSecure;
+    if (_HaveSecurityExt()) {
+      excSecure   = !!GETBITSM(excReturn, EXC_RETURN__ES);
+      retToSecure = !!GETBITSM(excReturn, EXC_RETURN__S);
+    } else {
+      excSecure   = false;
+      retToSecure = false;
+    }
 
-      bool daddrMatch   = _DWT_DataAddressMatch(i, daddr, dsize, read, nsReq);
-      bool dvalueMatch  = _DWT_DataValueMatch(i, daddr, dvalue, dsize, read, nsReq);
+    if (excSecure)
+      _s.controlS = CHGBITSM(_s.controlS, CONTROL__SPSEL, GETBITSM(excReturn, EXC_RETURN__SPSEL));
+    else
+      _s.controlNS = CHGBITSM(_s.controlNS, CONTROL__SPSEL, GETBITSM(excReturn, EXC_RETURN__SPSEL));
 
-      if (daddrMatch && (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(i)), REG_DWT_FUNCTION__MATCH) & 0b1100) == 0b0100) {
-        if (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(i)), REG_DWT_FUNCTION__MATCH) != 0b0111) {
-          InternalOr32(REG_DWT_FUNCTION(i), REG_DWT_FUNCTION__MATCHED);
-          debugEvent = (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(i)), REG_DWT_FUNCTION__ACTION) == 0b01);
-        } else {
-          InternalMask32(REG_DWT_FUNCTION(i), REG_DWT_FUNCTION__MATCHED); // UNKNOWN
-          InternalOr32(REG_DWT_FUNCTION(i-1), REG_DWT_FUNCTION__MATCHED);
-          debugEvent = (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(i)), REG_DWT_FUNCTION__ACTION) == 0b01);
-        }
+    bool targetDomainSecure = !!GETBITSM(excReturn, EXC_RETURN__ES);
+    _DeActivate(returningExcNo, targetDomainSecure);
+
+    auto &control = _IsSecure() ? _s.controlS : _s.controlNS;
+    if (_HaveFPExt() && (InternalLoad32(REG_FPCCR) & REG_FPCCR__CLRONRET) && (control & CONTROL__FPCA)) {
+      if (InternalLoad32(REG_FPCCR_S) & REG_FPCCR__LSPACT) {
+        InternalOr32(REG_SFSR, REG_SFSR__LSERR);
+        exc = _CreateException(SecureFault, true, true);
+        return {exc, excReturn};
+      } else {
+        for (int i=0; i<16; ++i)
+          _SetS(i,0);
+        _s.fpscr = 0;
       }
+    }
 
-      if (dvalueMatch && (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(i)), REG_DWT_FUNCTION__MATCH) & 0b1100) == 0b1000) {
-        if (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(i)), REG_DWT_FUNCTION__MATCH) != 0b1011) {
-          InternalOr32(REG_DWT_FUNCTION(i), REG_DWT_FUNCTION__MATCHED);
-          debugEvent = (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(i)), REG_DWT_FUNCTION__ACTION) == 0b01);
-        } else {
-          InternalOr32(REG_DWT_FUNCTION(i), REG_DWT_FUNCTION__MATCHED);
-          debugEvent = (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(i)), REG_DWT_FUNCTION__ACTION) == 0b01);
-        }
+    if (IMPL_DEF_TAIL_CHAINING_SUPPORTED) {
+      auto [takeException, exc2, excIsSecure] = _PendingExceptionDetails();
+      if (takeException) {
+        exc = _TailChain(exc2, excIsSecure, excReturn);
+        return {exc, excReturn};
       }
+    }
 
-      if (daddrMatch && (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(i)), REG_DWT_FUNCTION__MATCH) & 0b1100) == 0b1100)
-        InternalOr32(REG_DWT_FUNCTION(i), REG_DWT_FUNCTION__MATCHED);
+    if (_HaveSecurityExt())
+      _s.curState = retToSecure ? SecurityState_Secure : SecurityState_NonSecure;
 
-      triggerDebugEvent = triggerDebugEvent || debugEvent;
+    if (GETBITSM(excReturn, EXC_RETURN__MODE) && (InternalLoad32(REG_SCR) & REG_SCR__SLEEPONEXIT) && !_ExceptionActiveBitCount())
+      _SleepOnExit();
+
+    exc = _PopStack(excReturn);
+    if (exc.fault == NoFault) {
+      _ClearExclusiveLocal(_ProcessorID());
+      _SetEventRegister();
+      _InstructionSynchronizationBarrier(0b1111);
     }
 
-    if (triggerDebugEvent)
-      debugEvent = _SetDWTDebugEvent(!nsReq);
+    return {exc, excReturn};
   }
 
-  /* _DWT_DataAddressMatch {{{4
-   * ---------------------
-   * Check for match of access at "daddr". "dsize", "read" and "nsReq" are the
-   * attributes for the access. Note that for a load or store instruction,
-   * "nsReq" is the current security state of the PE, but this is not
-   * necessarily true for a hardware stack push/pop or vector table access.
-   * "nsReq" might not be the same as the "nsAttr" attribute the PE finally
-   * uses to make the access.
-   *
-   * If comparators 'm' and 'm+1' form a Data Address Range comparator, then
-   * this function returns the range match result when N=m+1.
+  /* _ExceptionActiveBitCount {{{4
+   * ------------------------
+   * As for _ScanExceptionActiveBitCount, but only visits the exceptions marked
+   * in the active bitmap (see ExecPriCache).
    */
-  bool _DWT_DataAddressMatch(int N, uint32_t daddr, int dsize, bool read, bool nsReq) {
-    ASSERT(N < GETBITSM(InternalLoad32(REG_DWT_CTRL), REG_DWT_CTRL__NUMCOMP)
-        && (dsize == 1 || dsize == 2 || dsize == 4)
-        && _Align(daddr, dsize) == daddr);
-
-    bool validMatch = _DWT_ValidMatch(N, !nsReq);
-    bool validAddr  = ((GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__MATCH) & 0b0100) == 0b0100);
-
-    if (!validMatch || !validAddr)
-      return false;
-
-    bool linkedToAddr, linkedToData;
-    if (N != GETBITSM(InternalLoad32(REG_DWT_CTRL), REG_DWT_CTRL__NUMCOMP)-1) {
-      linkedToAddr = (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N+1)), REG_DWT_FUNCTION__MATCH) == 0b0111); // Data Address Limit
-      linkedToData = (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N+1)), REG_DWT_FUNCTION__MATCH) == 0b1011); // Linked Data Value
-    } else {
-      linkedToAddr = false;
-      linkedToData = false;
-    }
-
-    bool matchLSC, linked;
-    switch (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__MATCH) & 3) {
-      case 0b00: matchLSC = true; linked = false; break;
-      case 0b01: matchLSC = !read; linked = false; break;
-      case 0b10: matchLSC = read; linked = false; break;
-      case 0b11:
-        ASSERT(N > 0);
-        switch (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N-1)), REG_DWT_FUNCTION__MATCH) & 3) {
-          case 0b00: matchLSC = true; linked = true; break;
-          case 0b01: matchLSC = !read; linked = true; break;
-          case 0b10: matchLSC = read; linked = true; break;
-          default: UNREACHABLE();
-        }
-        break;
-    }
+  int _ExceptionActiveBitCount() {
+    int count = 0;
+    for (int w=0; w<NUM_EXC/64; ++w)
+      for (uint64_t m = _xp.active[w]; m; m &= m - 1) {
+        int i = w*64 + CTZL(m);
+        if (i > _MaxExceptionNum())
+          continue;
 
-    bool matchAddr;
-    if (!linkedToAddr) {
-      uint32_t vsize = BIT(GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__DATAVSIZE));
-      auto [matchEQ, matchGT] = _DWT_AddressCompare(daddr, InternalLoad32(REG_DWT_COMP(N)), dsize, vsize);
+        for (int j=0; j<2; ++j)
+          if (_IsActiveForState(i, !j))
+            ++count;
+      }
 
-      if (linked) {
-        validMatch = _DWT_ValidMatch(N-1, !nsReq);
-        auto [lowerEQ, lowerGT] = _DWT_AddressCompare(daddr, InternalLoad32(REG_DWT_COMP(N-1)), dsize, 1);
-        matchAddr = validMatch && (lowerEQ || lowerGT) && !matchGT;
-      } else
-        matchAddr = matchEQ;
-    } else
-      matchAddr = false;
+    VERIFY_CACHE(count == _ScanExceptionActiveBitCount());
+    return count;
+  }
 
-    return matchAddr && matchLSC;
+  /* _ScanExceptionActiveBitCount {{{4
+   * ----------------------------
+   * Corresponds to ExceptionActiveBitCount in the ISA manual. Used only to
+   * check the result of _ExceptionActiveBitCount (see EMU_VERIFY_CACHES).
+   */
+  int _ScanExceptionActiveBitCount() {
+    int count = 0;
+    for (int i=0; i<=_MaxExceptionNum(); ++i)
+      for (int j=0; j<2; ++j)
+        if (_IsActiveForState(i, !j))
+          ++count;
+    return count;
   }
 
-  /* _DWT_AddressCompare {{{4
-   * -------------------
-   * Returns a pair of values. The first result is whether the (masked)
-   * addresses are equal, where the access address (addr) is masked according
-   * to REG_DWT_FUNCTION(n)__DATAVSIZE and the comparator address (compAddr) is
-   * masked according to the access size. The second result is whether the
-   * (unmasked) addr is greater than the (unmasked) compAddr.
+  /* _DeActivate {{{4
+   * -----------
    */
-  std::tuple<bool, bool> _DWT_AddressCompare(uint32_t addr, uint32_t compAddr, int size, int compSize) {
-    // addr must be a multiple of size. Unaligned accesses are split into smaller accesses.
-    ASSERT(_Align(addr, size) == addr);
+  void _DeActivate(int returningExcNo, bool targetDomainSecure) {
+    int rawPri = _RawExecutionPriority();
+    if (rawPri == -1)
+      _SetActive(HardFault, !(InternalLoad32(REG_AIRCR) & REG_AIRCR__BFHFNMINS), false);
+    else if (rawPri == -2)
+      _SetActive(NMI,       !(InternalLoad32(REG_AIRCR) & REG_AIRCR__BFHFNMINS), false);
+    else if (rawPri == -3)
+      _SetActive(HardFault,  true, false);
+    else {
+      bool secure = _HaveSecurityExt() && targetDomainSecure;
+      _SetActive(returningExcNo, secure, false);
+    }
 
-    // compAddr must be a multiple of compSize.
-    if (_Align(compAddr, compSize) != compAddr) {
-      // XXX(UNPREDICTABLE): We do not want to throw here. Simply mask the bits.
-      QUIET_UNPREDICTABLE("DWT address comparison is not aligned (0x%x)\n", compAddr);
-      compAddr = _Align(compAddr, compSize);
+    if (_HaveMainExt() && rawPri >= 0) {
+      if (_HaveSecurityExt() && targetDomainSecure)
+        _s.faultmaskS &= ~1;
+      else
+        _s.faultmaskNS &= ~1;
+      _ExcStateChanged();
     }
+  }
 
-    bool addrMatch    = (_Align(addr, compSize) == _Align(compAddr, size));
-    bool addrGreater  = (addr > compAddr);
-    return {addrMatch, addrGreater};
+  /* _SleepOnExit {{{4
+   * ------------
+   */
+  void _SleepOnExit() {
+    // Handling this is the responsibility of the code calling into the Simulator.
+    _s.exitCause |= EXIT_CAUSE__SLEEP_ON_EXIT;
   }
 
-  /* _DWT_ValidMatch {{{4
-   * ---------------
-   * Returns TRUE if this match is permitted by the current authentication controls.
+  /* _WaitForInterrupt {{{4
+   * -----------------
    */
-  bool _DWT_ValidMatch(int N, bool secureMatch) {
-    if (!_HaveSecurityExt())
-      ASSERT(!secureMatch);
+  void _WaitForInterrupt() {
+    // Handling this is the responsibility of the code calling into the Simulator.
+    _s.exitCause |= EXIT_CAUSE__WFI;
+  }
 
-    // Check for disabled.
-    if (!_NoninvasiveDebugAllowed()
-     || !GETBITSM(InternalLoad32(REG_DEMCR), REG_DEMCR__TRCENA)
-     || !GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__MATCH))
-      return false;
+  /* _WaitForEvent {{{4
+   * -------------
+   */
+  void _WaitForEvent() {
+    // Handling this is the responsibility of the code calling into the Simulator.
+    _s.exitCause |= EXIT_CAUSE__WFE;
+  }
 
-    if (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__ACTION) == 0b01) {
-      bool hltEn = _CanHaltOnEvent(secureMatch);
-      // Ignore priority when checking whether DebugMonitor activates DWT matches
-      bool monEn = _HaveDebugMonitor() && _CanPendMonitorOnEvent(secureMatch, false);
-      return hltEn || monEn;
-    } else
-      return !secureMatch || _SecureNoninvasiveDebugAllowed();
+  /* _IsIrqValid {{{4
+   * -----------
+   */
+  bool _IsIrqValid(int e) {
+    return e >= 16 && e <= _cfg.MaxExc();
   }
 
-  /* _DWT_DataValueMatch {{{4
-   * -------------------
-   * Check for match of access of "dvalue" at "daddr". "dsize", "read" and
-   * "nsReq" are the attributes for the access. Note that for a load or store
-   * instruction, "nsReq" is the current Security state of the PE, but this is
-   * not necessarily true for a hardware stack push/pop or vector table access.
-   * "nsReq" might not be the same as the "nsAttr" attribute the PE finally
-   * uses to make the access.
+  /* _PopStack {{{4
+   * ---------
    */
-  bool _DWT_DataValueMatch(int N, uint32_t daddr, uint32_t dvalue, int dsize, bool read, bool nsReq) {
-    ASSERT(N < GETBITSM(InternalLoad32(REG_DWT_CTRL), REG_DWT_CTRL__NUMCOMP)
-        && (dsize == 1 || dsize == 2 || dsize == 4)
-        && _Align(daddr, dsize) == daddr);
+  ExcInfo _PopStack(uint32_t excReturn) {
+    PEMode    mode      = (GETBITSM(excReturn, EXC_RETURN__MODE) ? PEMode_Thread : PEMode_Handler);
+    bool      toSecure  = _HaveSecurityExt() && GETBITSM(excReturn, EXC_RETURN__S);
+    RName     spName    = _LookUpSP_with_security_mode(toSecure, mode);
+    uint32_t  framePtr  = _GetSP(spName);
+    if (!_IsAligned(framePtr, 8)) {
+      // XXX(UNPREDICTABLE): This function can be called ultimately from _InstructionAdvance()
+      // so we do not want to throw here. Simply mask the bits, which is plausibly what a real
+      // CPU might do.
+      QUIET_UNPREDICTABLE("unaligned frame pointer on exception return (0x%x)\n", framePtr);
+      framePtr &= ~7;
+    }
+
+    ExcInfo exc = _DefaultExcInfo();
+    bool calleeFrame = toSecure && (!GETBITSM(excReturn, EXC_RETURN__ES) || !GETBITSM(excReturn, EXC_RETURN__DCRS));
+    if (calleeFrame) {
+      uint32_t expectedSig = 0xFEFA'125B;
+      if (_HaveFPExt())
+        expectedSig = CHGBITS(expectedSig, 0, 0, GETBITSM(excReturn, EXC_RETURN__FTYPE));
+      uint32_t integritySig;
+      std::tie(exc, integritySig) = _Stack(framePtr, 0, spName, mode);
+      if (exc.fault == NoFault && integritySig != expectedSig) {
+        if (_HaveMainExt())
+          InternalOr32(REG_SFSR, REG_SFSR__INVIS);
+        return _CreateException(SecureFault, true, true);
+      }
+    }
 
-    bool validMatch = _DWT_ValidMatch(N, !nsReq);
-    bool validData  = (GETBITS(GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__MATCH), 2, 3) == 0b10);
+    // The callee registers, if stacked, immediately precede the basic frame,
+    // so both are loaded with a single burst. The registers up to and
+    // including any which faulted are updated, as if each were loaded in turn.
+    static constexpr int regs[14] = {4, 5, 6, 7, 8, 9, 10, 11, 0, 1, 2, 3, 12, 14};
+    uint32_t words[16]{};
+    int      first = calleeFrame ? 0 : 8;
+    if (exc.fault == NoFault) {
+      int done;
+      std::tie(exc, done) = _StackLoadBurst(framePtr, calleeFrame ? 0x08 : 0x00, spName, mode, words + first, 16 - first);
+      for (int i=first; i<14 && i-first <= done; ++i)
+        _SetR(regs[i], words[i]);
+    }
 
-    if (!validMatch || !validData)
-      return false;
+    if (calleeFrame)
+      framePtr += 0x28;
 
-    bool matchLSC, linked;
-    switch (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__MATCH) & 3) {
-      case 0b00: matchLSC = true; linked = false; break;
-      case 0b01: matchLSC = !read; linked = false; break;
-      case 0b10: matchLSC = read; linked = false; break;
-      case 0b11:
-        ASSERT(N > 0);
-        switch (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N-1)), REG_DWT_FUNCTION__MATCH) & 3) {
-          case 0b00: matchLSC = true; linked = true; break;
-          case 0b01: matchLSC = !read; linked = true; break;
-          case 0b10: matchLSC = read; linked = true; break;
-          default: UNREACHABLE();
-        }
-        break;
+    uint32_t pc = words[14], psr = words[15];
+    _BranchToAndCommit(pc);
+
+    uint32_t excNo = GETBITSM(psr, XPSR__EXCEPTION);
+    if (exc.fault == NoFault && (mode == PEMode_Handler) == !excNo) {
+      if (_HaveMainExt())
+        InternalOr32(REG_CFSR, REG_CFSR__UFSR__INVPC);
+      return _CreateException(UsageFault, false, false/*UNKNOWN*/);
     }
 
-    uint32_t vsize = BIT(GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__DATAVSIZE));
+    bool validIPSR = (excNo == 0 || excNo == 1 || excNo == NMI || excNo == HardFault || excNo == SVCall || excNo == PendSV || excNo == SysTick);
+    if (!validIPSR && _HaveMainExt())
+      validIPSR = (excNo == MemManage || excNo == BusFault || excNo == UsageFault || excNo == SecureFault || excNo == DebugMonitor);
 
-    uint32_t dmask;
-    if (linked) {
-      dmask = 0b0000; // Filled in below if there is an address match
-      if (_DWT_DataAddressMatch(N-1, daddr, dsize, read, nsReq)) {
-        if (vsize == 1 && dsize == 1)
-          dmask = CHGBIT(dmask, 0, 1);
-        else if (vsize == 1 && dsize == 2)
-          dmask = CHGBIT(dmask, GETBITS(InternalLoad32(REG_DWT_COMP(N-1)), 0, 0), 1);
-        else if (vsize == 1 && dsize == 4)
-          dmask = CHGBIT(dmask, GETBITS(InternalLoad32(REG_DWT_COMP(N-1)), 0, 1), 1);
-        else if (vsize == 2 && dsize == 2)
-          dmask = CHGBITS(dmask, 0, 1, 0b11);
-        else if (vsize == 2 && dsize == 4)
-          dmask = CHGBITS(dmask, GETBITS(InternalLoad32(REG_DWT_COMP(N-1)), 0, 1),
-                                 GETBITS(InternalLoad32(REG_DWT_COMP(N-1)), 0, 1)+1, 0b11);
-        else if (vsize == 4 && dsize == 4)
-          dmask = 0b1111;
-        else
-          dmask = 0b0000; // vsize > dsize: no match
-      }
-    } else {
-      switch (dsize) {
-        case 1: dmask = 0b0001; break;
-        case 2: dmask = 0b0011; break;
-        case 4: dmask = 0b1111; break;
-        default: UNREACHABLE();
+    if (!validIPSR && !_IsIrqValid(excNo))
+      psr = CHGBITSM(psr, XPSR__EXCEPTION, 0); // UNKNOWN
+
+    if (_HaveFPExt()) {
+      if (!GETBITSM(excReturn, EXC_RETURN__FTYPE)) {
+        if (!toSecure && (InternalLoad32(REG_FPCCR_S) & REG_FPCCR__LSPACT)) {
+          InternalOr32(REG_SFSR, REG_SFSR__LSERR);
+          ExcInfo newExc = _CreateException(SecureFault, true, true);
+          if (IMPL_DEF_DROP_PREV_GEN_EXC)
+            exc = newExc;
+          else
+            exc = _MergeExcInfo(exc, newExc);
+        } else {
+          bool lspAct = !!(toSecure ? InternalLoad32(REG_FPCCR_S) & REG_FPCCR__LSPACT : InternalLoad32(REG_FPCCR_NS) & REG_FPCCR__LSPACT);
+          if (lspAct) {
+            if (exc.fault == NoFault) {
+              if (toSecure)
+                InternalMask32(REG_FPCCR_S, REG_FPCCR__LSPACT);
+              else
+                InternalMask32(REG_FPCCR_NS, REG_FPCCR__LSPACT);
+            }
+          } else {
+            if (exc.fault == NoFault) {
+              bool nPriv  = toSecure ? GETBITSM(_s.controlS, CONTROL__NPRIV) : GETBITSM(_s.controlNS, CONTROL__NPRIV);
+              bool isPriv = (mode == PEMode_Handler || !nPriv);
+              exc = _CheckCPEnabled(10, isPriv, toSecure);
+            }
+
+            if (exc.fault == NoFault) {
+              // S0-S15 and FPSCR are contiguous, as are S16-S31 after the
+              // reserved word. A fault makes all of the restored registers
+              // zero below, so they are only written once a burst completes.
+              uint32_t fp[17];
+              std::tie(exc, std::ignore) = _StackLoadBurst(framePtr, 0x20, spName, mode, fp, 17);
+              if (exc.fault == NoFault) {
+                for (int i=0; i<16; ++i)
+                  _SetS(i, fp[i]);
+                _s.fpscr = fp[16];
+              }
+              if (toSecure && (InternalLoad32(REG_FPCCR_S) & REG_FPCCR__TS)) {
+                if (exc.fault == NoFault) {
+                  std::tie(exc, std::ignore) = _StackLoadBurst(framePtr, 0x68, spName, mode, fp, 16);
+                  if (exc.fault == NoFault)
+                    for (int i=0; i<16; ++i)
+                      _SetS(i+16, fp[i]);
+                }
+
+                if (exc.fault != NoFault)
+                  for (int i=16; i<32; ++i)
+                    _SetS(i, _HaveSecurityExt() ? 0 : 0 /* UNKNOWN */);
+              }
+              if (exc.fault != NoFault) {
+                for (int i=0; i<16; ++i)
+                  _SetS(i, _HaveSecurityExt() ? 0 : 0 /* UNKNOWN */);
+                _s.fpscr = (_HaveSecurityExt() ? 0 : 0 /* UNKNOWN */);
+              }
+            }
+          }
+        }
       }
+
+      auto &control = _IsSecure() ? _s.controlS : _s.controlNS;
+      control = CHGBITSM(control, CONTROL__FPCA, GETBITSM(excReturn, EXC_RETURN__FTYPE) ^ 1);
     }
 
-    // Split both values into byte lanes: DCBA and dcba.
-    // This function relies on the values being correctly replicated across
-    // REG_DWT_COMP(N).
-    uint32_t D = GETBITS(dvalue,24,31);
-    uint32_t C = GETBITS(dvalue,16,23);
-    uint32_t B = GETBITS(dvalue, 8,15);
-    uint32_t A = GETBITS(dvalue, 0, 7);
+    if (exc.fault == NoFault)
+      _ConsumeExcStackFrame(excReturn, GETBITSM(psr, RETPSR__SPREALIGN));
 
-    uint32_t d = GETBITS(InternalLoad32(REG_DWT_COMP(N)),24,31);
-    uint32_t c = GETBITS(InternalLoad32(REG_DWT_COMP(N)),16,23);
-    uint32_t b = GETBITS(InternalLoad32(REG_DWT_COMP(N)), 8,15);
-    uint32_t a = GETBITS(InternalLoad32(REG_DWT_COMP(N)), 0, 7);
+    if (_HaveDSPExt())
+      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__GE, GETBITSM(psr, XPSR__GE));
 
-    // Partial results.
-    bool Dd = (GETBIT(dmask, 3) && D == d);
-    bool Cc = (GETBIT(dmask, 2) && C == c);
-    bool Bb = (GETBIT(dmask, 1) && B == b);
-    bool Aa = (GETBIT(dmask, 0) && A == a);
+    if (_IsSecure())
+      _s.controlS = CHGBITSM(_s.controlS, CONTROL__SFPA, GETBITSM(psr, RETPSR__SFPA));
 
-    // Combined partial results.
-    bool BAba = Bb && Aa;
-    bool DCdc = Dd && Cc;
-    bool DCBAdcba = Dd && Cc && Bb && Aa;
+    _SyncFlags();
+    _s.xpsr = CHGBITSM(_s.xpsr, XPSR__EXCEPTION, GETBITSM(psr, XPSR__EXCEPTION));
+    _s.xpsr = CHGBITSM(_s.xpsr, XPSR__T,         GETBITSM(psr, XPSR__T));
+    if (_HaveMainExt()) {
+      _s.xpsr = CHGBITS(_s.xpsr,27,31,GETBITS(psr,27,31));
 
-    // Generate full results.
-    bool matchData;
-    if (vsize == 1)
-      matchData = (Dd || Cc || Bb || Aa);
-    else if (vsize == 2 && (dsize == 2 || dsize == 4))
-      matchData = (DCdc || BAba);
-    else if (vsize == 4 && dsize == 4)
-      matchData = DCBAdcba;
-    else
-      matchData = false;
+      uint32_t it = (GETBITSM(psr, XPSR__IT_ICI_LO)<<2) | GETBITSM(psr, XPSR__IT_ICI_HI);
+      _SetITSTATEAndCommit(it);
+    } else
+      _s.xpsr = CHGBITS(_s.xpsr,28,31,GETBITS(psr,28,31));
 
-    return matchData && matchLSC;
+    return exc;
   }
 
-  /* _IsDWTConfigUnpredictable {{{4
-   * -------------------------
-   * Checks for the UNPREDICTABLE cases for various combinations of MATCH and
-   * ACTION for each comparator.
+  /* _CheckCPEnabled {{{4
+   * ---------------
    */
-  bool _IsDWTConfigUnpredictable(int N) {
-    bool noTrace = (!_HaveMainExt() || GETBITSM(InternalLoad32(REG_DWT_CTRL), REG_DWT_CTRL__NOTRCPKT) || !_HaveITM());
-
-    // First pass check of MATCH field — coarse checks.
-    switch (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__MATCH)) {
-      case 0b0000: // Disabled
-        return false;
-      case 0b0001: // Cycle counter match
-        if (!_HaveMainExt() || GETBITSM(InternalLoad32(REG_DWT_CTRL), REG_DWT_CTRL__NOCYCCNT)
-         || !(GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__ID) & BIT(0)))
-          return true;
-        break;
-      case 0b0010: // Instruction address
-      case 0b0011:
-        if (!(GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__ID) & BIT(1))
-         || GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__DATAVSIZE) != 0b01
-         || GETBIT(InternalLoad32(REG_DWT_COMP(N)), 0))
-          return true;
-        break;
-      case 0b0100: // Data address
-      case 0b0101:
-      case 0b0110:
-      case 0b0111: {
-        uint32_t lsb = GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__DATAVSIZE);
-        if (!(GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__ID) & BIT(3))
-         || (lsb > 0 && !_IsZero(GETBITS(InternalLoad32(REG_DWT_COMP(N)), 0, lsb-1))))
-          return true;
-      } break;
-      case 0b1100: // Data address with value
-      case 0b1101:
-      case 0b1110: {
-        if (noTrace)
-          return true;
-        uint32_t lsb = GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__DATAVSIZE);
-        if (!(GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__ID) & BIT(3))
-          || (lsb > 0 && !_IsZero(GETBITS(InternalLoad32(REG_DWT_COMP(N)), 0, lsb-1))))
-          return true;
-      } break;
-      case 0b1000: // Data value
-      case 0b1001:
-      case 0b1010:
-      case 0b1011: {
-        uint32_t vsize = BIT(GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__DATAVSIZE));
-        if (!_HaveMainExt()
-         || !(GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__ID) & BIT(2))
-         || (vsize != 4 && GETBITS(InternalLoad32(REG_DWT_COMP(N)), 16, 31) != GETBITS(InternalLoad32(REG_DWT_COMP(N)), 0, 15))
-         || (vsize == 1 && GETBITS(InternalLoad32(REG_DWT_COMP(N)),  8, 15) != GETBITS(InternalLoad32(REG_DWT_COMP(N)), 0,  7)))
-          return true;
-      } break;
-      default:
-       return true;
-    }
+  ExcInfo _CheckCPEnabled(int cp) {
+    return _CheckCPEnabled(cp, _CurrentModeIsPrivileged(), _IsSecure());
+  }
 
-    // Second pass MATCH check — linked and limit comparators.
-    switch (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__MATCH)) {
-      case 0b0011: { // Instruction address limit
-        uint32_t m = GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N-1)), REG_DWT_FUNCTION__MATCH);
-        if (!N
-         || !(GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__ID) & BIT(4))
-         || (m == 0b0001 || m == 0b0011 || ((m & 0b1100) == 0b0100) || (m & 0b1000))
-         || (InternalLoad32(REG_DWT_COMP(N)) <= InternalLoad32(REG_DWT_COMP(N-1))))
-          return true;
-        if (!m)
-          return false;
-      } break;
+  ExcInfo _CheckCPEnabled(int cp, bool priv, bool secure) {
+    auto [enabled, toSecure] = _IsCPEnabled(cp, priv, secure);
+    ExcInfo excInfo;
+    if (!enabled) {
+      if (toSecure)
+        InternalOr32(REG_CFSR_S, REG_CFSR__UFSR__NOCP);
+      else
+        InternalOr32(REG_CFSR_NS, REG_CFSR__UFSR__NOCP);
+      excInfo = _CreateException(UsageFault, true, toSecure);
+    } else
+      excInfo = _DefaultExcInfo();
+    return excInfo;
+  }
 
-      case 0b0111: { // Data address limit
-        uint32_t m = GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N-1)), REG_DWT_FUNCTION__MATCH);
-        if (!N
-         || !(GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__ID) & BIT(4))
-         || (m == 0b0001 || ((m & 0b1110) == 0b0010) || m == 0b0111 || (m & 0b1100) == 0b1000)
-         || (InternalLoad32(REG_DWT_COMP(N)) <= InternalLoad32(REG_DWT_COMP(N-1))))
-          return true;
-        if (!m)
-          return false;
-      } break;
+  /* _ValidateExceptionReturn {{{4
+   * ------------------------
+   */
+  std::tuple<ExcInfo, uint32_t> _ValidateExceptionReturn(uint32_t excReturn, int retExcNo) {
+    bool error = false;
+    assert(_CurrentMode() == PEMode_Handler);
 
-      case 0b1011: { // Linked data value
-        uint32_t m = GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N-1)), REG_DWT_FUNCTION__MATCH);
-        if (!N
-         || !(GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__ID) & BIT(4))
-         || (m == 0b0001 || ((m & 0b1110) == 0b0010) || m == 0b0111 || (m & 0b1100) == 0b1000)
-         || GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N  )), REG_DWT_FUNCTION__DATAVSIZE) !=
-            GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N-1)), REG_DWT_FUNCTION__DATAVSIZE))
-          return true;
-        if (!m)
-          return false;
-      } break;
+    // XXX: These are specified as UNPREDICTABLE. However, this function is
+    // ultimately called from _InstructionAdvance(), which does not execute in
+    // a context where UNPREDICTABLE can be suitably caught. Moreover given
+    // that this function is all about explicitly creating and returning ISA
+    // exceptions having it throw a (C++/psuedocode) exception seems odd.
+    // Most likely these bits are just ignored by actual CPUs. Ideally we
+    // would handle these as an error as we should be stricter than a real CPU
+    // if possible, but for now, treat them as no-ops.
+    if (GETBITS(excReturn, 7,23) != BITS(0,16) || GETBITS(excReturn, 1, 1)) {
+      TRACE("unpredictable exception return (0x%x)\n", excReturn);
+      //THROW_UNPREDICTABLE();
+    }
+    if (!_HaveFPExt() && !GETBITSM(excReturn, EXC_RETURN__FTYPE)) {
+      TRACE("unpredictable exception return (no FP)\n");
+      //THROW_UNPREDICTABLE();
     }
 
-    // Check DATAVSIZE is permitted.
-    if (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__DATAVSIZE) == 0b11)
-      return true;
+    bool targetDomainSecure = !!GETBITSM(excReturn, EXC_RETURN__ES);
+    bool excStateNonSecure;
+    int excNo;
+    if (_HaveSecurityExt()) {
+      excStateNonSecure = (_s.curState == SecurityState_NonSecure || !targetDomainSecure);
+      if (excStateNonSecure && (!GETBITSM(excReturn, EXC_RETURN__DCRS) || targetDomainSecure)) {
+        if (_HaveMainExt())
+          InternalOr32(REG_SFSR, REG_SFSR__INVER);
 
-    // Check the ACTION is allowed for the MATCH type.
-    switch (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__ACTION)) {
-      case 0b00: { // CMPMATCH trigger only
-        uint32_t m = GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__MATCH);
-        if (m == 0b1100 || m == 0b1101 || m == 0b1110)
-          return true;
-      } break;
-      case 0b01: { // Debug event
-        uint32_t m = GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__MATCH);
-        if (m == 0b0011 || m == 0b0111 || m == 0b1100 || m == 0b1101 || m == 0b1110)
-          return true;
-      } break;
-      case 0b10: { // Data Trace Match or Data Value packet
-        uint32_t m = GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__MATCH);
-        if (noTrace || m == 0b0011 || m == 0b0111)
-          return true;
-      } break;
-      case 0b11: { // Other Data Trace Packet
-        uint32_t m = GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__MATCH);
-        if (noTrace
-         || (m == 0b0010 || m == 0b1000 || m == 0b1001 || m == 0b1010)
-         || (m == 0b0011 && GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N-1)), REG_DWT_FUNCTION__ACTION) != 0b00)
-         || (m == 0b0111 && (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N-1)), REG_DWT_FUNCTION__MATCH) & 0b1100) == 0b0100
-                         && (   GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N-1)), REG_DWT_FUNCTION__ACTION) == 0b01
-                             || GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N-1)), REG_DWT_FUNCTION__ACTION) == 0b10))
-         || (m == 0b0111 && (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N-1)), REG_DWT_FUNCTION__MATCH) & 0b1100) == 0b1100
-                         && (   GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N-1)), REG_DWT_FUNCTION__ACTION) == 0b00
-                             || GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N-1)), REG_DWT_FUNCTION__ACTION) == 0b01)))
-          return true;
-      } break;
-    }
+        if (excStateNonSecure && targetDomainSecure)
+          excReturn = CHGBITSM(excReturn, EXC_RETURN__ES, 0);
 
-    return false; // Passes checks
+        targetDomainSecure = false;
+        error = true;
+        excNo = SecureFault;
+      }
+    } else
+      excStateNonSecure = true;
+
+    if (!error)
+      if (!_IsActiveForState(retExcNo, targetDomainSecure)) {
+        error = true;
+        if (_HaveMainExt()) {
+          InternalOr32(REG_CFSR, REG_CFSR__UFSR__INVPC);
+          excNo = UsageFault;
+        } else
+          excNo = HardFault;
+      }
+
+    ExcInfo excInfo;
+    if (error) {
+      _DeActivate(retExcNo, targetDomainSecure);
+      if (_HaveSecurityExt() && targetDomainSecure)
+        _s.controlS = CHGBITSM(_s.controlS, CONTROL__SPSEL, GETBITSM(excReturn, EXC_RETURN__SPSEL));
+      else
+        _s.controlNS = CHGBITSM(_s.controlNS, CONTROL__SPSEL, GETBITSM(excReturn, EXC_RETURN__SPSEL));
+      excInfo = _CreateException(excNo, false, false /*UNKNOWN*/);
+    } else
+      excInfo = _DefaultExcInfo();
+
+    return {excInfo, excReturn};
   }
 
-  /* _SetDWTDebugEvent {{{4
-   * -----------------
+  /* _ExceptionTaken {{{4
+   * ---------------
    */
-  bool _SetDWTDebugEvent(bool secureMatch) {
-    if (_CanHaltOnEvent(secureMatch)) {
-      InternalOr32(REG_DHCSR, REG_DHCSR__C_HALT);
-      InternalOr32(REG_DFSR, REG_DFSR__DWTTRAP);
-      return true;
-    }
+  ExcInfo _ExceptionTaken(int excNo, bool doTailChain, bool excIsSecure, bool ignStackFaults) {
+    assert(_HaveSecurityExt() || !excIsSecure);
 
-    if (_HaveMainExt() && _CanPendMonitorOnEvent(secureMatch, true)) {
-      InternalOr32(REG_DEMCR, REG_DEMCR__MON_PEND);
-      InternalOr32(REG_DFSR, REG_DFSR__DWTTRAP);
-      return true;
+    ExcInfo exc = _DefaultExcInfo();
+    if (_HaveSecurityExt() && GETBIT(_GetLR(), 6)) {
+      if (excIsSecure) {
+        if (doTailChain && !GETBIT(_GetLR(), 0))
+          _SetLR(CHGBITS(_GetLR(), 5, 5, 0));
+      } else {
+        if (GETBIT(_GetLR(), 5) && !(doTailChain && !GETBIT(_GetLR(),0)))
+          exc = _PushCalleeStack(doTailChain);
+        _SetLR(CHGBITS(_GetLR(), 5, 5, 1));
+      }
     }
 
-    return false;
-  }
+    if (excIsSecure)
+      _SetLR(CHGBITS(CHGBITS(_GetLR(), 2, 2, GETBITSM(_s.controlS, CONTROL__SPSEL)), 0, 0, 1));
+    else
+      _SetLR(CHGBITS(CHGBITS(_GetLR(), 2, 2, GETBITSM(_s.controlNS, CONTROL__SPSEL)), 0, 0, 0));
 
-  /* _DefaultMemoryAttributes {{{4
-   * ------------------------
-   */
-  MemoryAttributes _DefaultMemoryAttributes(uint32_t addr) {
-    MemoryAttributes attrs;
+    uint32_t callerRegValue = (!_HaveSecurityExt() || excIsSecure) ? 0 /*UNKNOWN*/ : 0;
+    for (int n=0; n<4; ++n)
+      _SetR(n, callerRegValue);
+    _SetR(12, callerRegValue);
+    _SyncFlags();
+    _s.xpsr = (callerRegValue & ~XPSR__EXCEPTION) | (_s.xpsr & XPSR__EXCEPTION);
+    _SyncITSTATE();
 
-    switch (GETBITS(addr,29,31)) {
-      case 0b000:
-        attrs.memType     = MemType_Normal;
-        attrs.device      = DeviceType_GRE; // UNKNOWN
-        attrs.innerAttrs  = 0b10;
-        attrs.shareable   = false;
-        break;
-      case 0b001:
-        attrs.memType     = MemType_Normal;
-        attrs.device      = DeviceType_GRE; // UNKNOWN
-        attrs.innerAttrs  = 0b01;
-        attrs.shareable   = false;
-        break;
-      case 0b010:
-        attrs.memType     = MemType_Device;
-        attrs.device      = DeviceType_nGnRE;
-        attrs.innerAttrs  = 0b00;
-        attrs.shareable   = true;
-        break;
-      case 0b011:
-        attrs.memType     = MemType_Normal;
-        attrs.device      = DeviceType_GRE; // UNKNOWN
-        attrs.innerAttrs  = 0b01;
-        attrs.shareable   = false;
-        break;
-      case 0b100:
-        attrs.memType     = MemType_Normal;
-        attrs.device      = DeviceType_GRE; // UNKNOWN
-        attrs.innerAttrs  = 0b10;
-        attrs.shareable   = false;
-        break;
-      case 0b101:
-        attrs.memType     = MemType_Device;
-        attrs.device      = DeviceType_nGnRE;
-        attrs.innerAttrs  = 0b00;
-        attrs.shareable   = true;
-        break;
-      case 0b110:
-        attrs.memType     = MemType_Device;
-        attrs.device      = DeviceType_nGnRE;
-        attrs.innerAttrs  = 0b00;
-        attrs.shareable   = true;
-        break;
-      case 0b111:
-        if (!GETBITS(addr,20,28)) {
-          attrs.memType     = MemType_Device;
-          attrs.device      = DeviceType_nGnRnE;
-          attrs.innerAttrs  = 0b00;
-          attrs.shareable   = true;
-        } else {
-          attrs.memType     = MemType_Device;
-          attrs.device      = DeviceType_nGnRE;
-          attrs.innerAttrs  = 0b00;
-          attrs.shareable   = true;
-        }
-        break;
+    if (_HaveSecurityExt() && GETBIT(_GetLR(), 6)) {
+      if (excIsSecure) {
+        if (!GETBIT(_GetLR(),5))
+          for (int n=4; n<12; ++n)
+            _SetR(n, 0/*UNKNOWN*/);
+      } else
+        for (int n=4; n<12; ++n)
+          _SetR(n, 0);
     }
 
-    attrs.outerAttrs      = attrs.innerAttrs;
-    attrs.outerShareable  = attrs.shareable;
-    attrs.ns              = false; // UNKNOWN
-    return attrs;
+    uint32_t start;
+    if (exc.fault == NoFault || ignStackFaults)
+      std::tie(exc, start) = _GetVector(excNo, excIsSecure);
+
+    if (exc.fault == NoFault) {
+      _ActivateException(excNo, excIsSecure);
+      _SCS_UpdateStatusRegs();
+      _ClearExclusiveLocal(_ProcessorID());
+      _SetEventRegister();
+      _InstructionSynchronizationBarrier(0b1111);
+      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__T, start & 1);
+      _BranchTo(start & ~1);
+    } else
+      exc.inExcTaken = true;
+
+    return exc;
   }
 
-  /* _DefaultPermissions {{{4
-   * -------------------
+  /* _PushCalleeStack {{{4
+   * ----------------
    */
-  Permissions _DefaultPermissions(uint32_t addr) {
-    Permissions perms = {};
-    perms.ap          = 0b01;
-    perms.apValid     = true;
-    perms.region      = 0;
-    perms.regionValid = false;
-
-    switch (GETBITS(addr,29,31)) {
-      case 0b000: perms.xn = false; break;
-      case 0b001: perms.xn = false; break;
-      case 0b010: perms.xn = true;  break;
-      case 0b011: perms.xn = false; break;
-      case 0b100: perms.xn = false; break;
-      case 0b101: perms.xn = true;  break;
-      case 0b110: perms.xn = true;  break;
-      case 0b111: perms.xn = true;  break;
+  ExcInfo _PushCalleeStack(bool doTailChain) {
+    PEMode mode;
+    RName spName;
+    if (doTailChain) {
+      if (!GETBIT(_GetLR(), 3)) {
+        mode = PEMode_Handler;
+        spName = RNameSP_Main_Secure;
+      } else {
+        mode = PEMode_Thread;
+        spName = (GETBIT(_GetLR(), 2) ? RNameSP_Process_Secure : RNameSP_Main_Secure);
+      }
+    } else {
+      spName = _LookUpSP();
+      mode = _CurrentMode();
     }
 
-    return perms;
+    uint32_t framePtr = _GetSP(spName) - 0x28;
+
+    uint32_t integritySig = _HaveFPExt() ? CHGBITS(0xFEFA125A,0,0,GETBIT(_GetLR(),4)) : 0xFEFA125B;
+    ExcInfo exc = _Stack(framePtr, 0x00, spName, mode, integritySig);
+
+    // The word at 0x04 is reserved and not written.
+    uint32_t callee[8] = {_GetR(4), _GetR(5), _GetR(6), _GetR(7), _GetR(8), _GetR(9), _GetR(10), _GetR(11)};
+    if (exc.fault == NoFault) exc = _StackStoreBurst(framePtr, 0x08, spName, mode, callee, 8);
+
+    ExcInfo spExc = _SetSP(spName, true, framePtr);
+    return _MergeExcInfo(exc, spExc);
   }
 
-  /* _SetPending {{{4
+  /* _SCS_UpdateStatusRegs {{{4
+   * ---------------------
+   */
+  void _SCS_UpdateStatusRegs() {
+    // TODO
+  }
+
+  /* _ConstrainUnpredictableBool {{{4
+   * ---------------------------
+   */
+  bool _ConstrainUnpredictableBool(bool x) { return x; }
+
+  /* ExcPriTable {{{4
    * -----------
-   * XXX. This function has been augmented relative to the ISA manual's
-   * definition to add an additional check parameter allowing us to choose to
-   * test _ExceptionTargetsSecure, which is useful for implementing NVIC
-   * registers.
+   * Caches the result of _ComputeExceptionPriority for every exception,
+   * security state and groupPri. Entries are filled on first use. They depend
+   * only on SHPRn, NVIC_IPRn, AIRCR and ICSR.STTNS, so stores to those reset
+   * every entry to UNKNOWN (see _InvalidateExcPriorities).
    */
-  void _SetPending(int exc, bool isSecure, bool setNotClear, bool check=false) {
-    if (!_HaveSecurityExt())
-      isSecure = false;
+  struct ExcPriTable {
+    static constexpr int16_t UNKNOWN = INT16_MIN;
 
-    if (_IsExceptionTargetConfigurable(exc)) {
-      if (!check || _ExceptionTargetsSecure(exc, isSecure) == isSecure)
-        _s.excPending[exc] = setNotClear ? 0b11 : 0b00;
-    } else {
-      uint32_t idx = isSecure ? 0 : 1;
-      _s.excPending[exc] = CHGBITS(_s.excPending[exc], idx, idx, setNotClear);
-    }
+    int16_t pri[NUM_EXC][2][2]; // [n][isSecure][groupPri]
+  };
+
+  /* _InvalidateExcPriTable {{{4
+   * ----------------------
+   */
+  void _InvalidateExcPriTable() {
+    std::fill(&_ep.pri[0][0][0], &_ep.pri[0][0][0] + NUM_EXC*2*2, ExcPriTable::UNKNOWN);
   }
 
-  /* _SetEnable {{{4
-   * ----------
-   * XXX. This does not appear in the ISA manual but has been constructed
-   * analagously to _SetPending.
+  /* _ExceptionPriority {{{4
+   * ------------------
    */
-  void _SetEnable(int exc, bool isSecure, bool setNotClear, bool check=false) {
-    if (!_HaveSecurityExt())
-      isSecure = false;
+  int _ExceptionPriority(int n, bool isSecure, bool groupPri) {
+    if (_HaveMainExt())
+      assert(n >= 1 && n <= 511);
+    else
+      assert(n >= 1 && n <= 48);
 
-    if (_IsExceptionTargetConfigurable(exc)) {
-      if (!check || _ExceptionTargetsSecure(exc, isSecure) == isSecure)
-        _s.excEnable[exc] = setNotClear ? 0b11 : 0b00;
-    } else {
-      uint32_t idx = isSecure ? 0 : 1;
-      _s.excEnable[exc] = CHGBITS(_s.excEnable[exc], idx, idx, setNotClear);
-    }
+    int16_t &pri = _ep.pri[n][isSecure][groupPri];
+    if unlikely (pri == ExcPriTable::UNKNOWN)
+      pri = _ComputeExceptionPriority(n, isSecure, groupPri);
+
+    VERIFY_CACHE(pri == _ComputeExceptionPriority(n, isSecure, groupPri));
+    return pri;
   }
 
-  /* _NextInstrITState {{{4
-   * -----------------
+  /* _ComputeExceptionPriority {{{4
+   * -------------------------
+   * Corresponds to ExceptionPriority in the ISA manual. Only called to fill
+   * ExcPriTable entries.
    */
-  uint8_t _NextInstrITState() {
-    uint8_t nextState;
-    if (_HaveMainExt()) {
-      if (_s.itStateChanged)
-        nextState = _s.nextInstrITState;
-      else {
-        nextState = _ThisInstrITState();
-        if (GETBITS(nextState, 0, 2) == 0b000)
-          nextState = 0;
+  int _ComputeExceptionPriority(int n, bool isSecure, bool groupPri) {
+    int result;
+    if (n == Reset)
+      result = -4;
+    else if (n == NMI)
+      result = -2;
+    else if (n == HardFault) {
+      if (isSecure && (InternalLoad32(REG_AIRCR) & REG_AIRCR__BFHFNMINS))
+        result = -3;
+      else
+        result = -1;
+    } else if (_HaveMainExt() && n == MemManage)
+      result = isSecure ? GETBITSM(InternalLoad32(REG_SHPR1_S), REG_SHPR1__PRI_4) : GETBITSM(InternalLoad32(REG_SHPR1_NS), REG_SHPR1__PRI_4);
+    else if (_HaveMainExt() && n == BusFault)
+      result = GETBITSM(InternalLoad32(REG_SHPR1_S), REG_SHPR1__PRI_5);
+    else if (_HaveMainExt() && n == UsageFault)
+      result = isSecure ? GETBITSM(InternalLoad32(REG_SHPR1_S), REG_SHPR1__PRI_6) : GETBITSM(InternalLoad32(REG_SHPR1_NS), REG_SHPR1__PRI_6);
+    else if (_HaveMainExt() && n == SecureFault)
+      result = GETBITSM(InternalLoad32(REG_SHPR1_S), REG_SHPR1__PRI_7);
+    else if (n == SVCall)
+      result = isSecure ? GETBITSM(InternalLoad32(REG_SHPR2_S), REG_SHPR2__PRI_11) : GETBITSM(InternalLoad32(REG_SHPR2_NS), REG_SHPR2__PRI_11);
+    else if (_HaveMainExt() && n == DebugMonitor)
+      result = GETBITSM(InternalLoad32(REG_SHPR3_S), REG_SHPR3__PRI_12);
+    else if (n == PendSV)
+      result = isSecure ? GETBITSM(InternalLoad32(REG_SHPR3_S), REG_SHPR3__PRI_14) : GETBITSM(InternalLoad32(REG_SHPR3_NS), REG_SHPR3__PRI_14);
+    else if (   n == SysTick
+             && (   (_HaveSysTick() == 2)
+                 || (_HaveSysTick() == 1 && (!(InternalLoad32(REG_ICSR_S) & REG_ICSR__STTNS)) == isSecure)))
+      result = isSecure ? GETBITSM(InternalLoad32(REG_SHPR3_S), REG_SHPR3__PRI_15) : GETBITSM(InternalLoad32(REG_SHPR3_NS), REG_SHPR3__PRI_15);
+    else if (n >= 16) {
+      int r = (n-16)/4;
+      int v = n%4;
+      result = GETBITS(InternalLoad32(REG_NVIC_IPRn_S(r)), v*8, v*8+7);
+    } else
+      result = 256;
+
+    if (result >= 0) {
+      if (_HaveMainExt() && groupPri) {
+        int subGroupShift;
+        if (isSecure)
+          subGroupShift = GETBITSM(InternalLoad32(REG_AIRCR_S), REG_AIRCR__PRIGROUP);
         else
-          nextState = CHGBITS(nextState, 0, 4, GETBITS(nextState, 0, 4)<<1);
+          subGroupShift = GETBITSM(InternalLoad32(REG_AIRCR_NS), REG_AIRCR__PRIGROUP);
+        int groupValue    = 2<<subGroupShift;
+        int subGroupValue = result % groupValue;
+        result = result - subGroupValue;
       }
-    } else
-      nextState = 0;
-    return nextState;
+
+      int priSNsPri = _RestrictedNSPri();
+      if ((InternalLoad32(REG_AIRCR_S) & REG_AIRCR__PRIS) && !isSecure)
+        result = (result>>1) + priSNsPri;
+    }
+
+    return result;
   }
 
-  /* _PendingExceptionDetails {{{4
-   * ------------------------
+  /* _TopLevel {{{4
+   * ---------
+   * Called once for each tick the PE is not in a sleep state. Handles all
+   * instruction processing, including fetching the opcode, decode and execute.
+   * It also handles pausing execution when in the lockup state.
    */
-  // XXX: Unfortunately the ARM ISA manual exceptionally does not give a definition
-  // for this function. Its definition has been estimated via reference to qemu's codebase.
-  //
-  // XXX: This function has been augmented relative to the ARM ISA manual to add an argument
-  // `ignorePrimask`, which is useful for implementing WFI.
-  //
-  // TODO: DHCSR.C_MASKINTS
-  std::tuple<bool, int, bool> _PendingExceptionDetails(bool ignorePrimask=false) {
-    // XXX: Not specified exactly where SysTick should be checked, so we choose
-    // to check it here like everything else.
-    bool systIntrS  = (_HaveSysTick() && _SystGetIntrFlag(false, true));
-    bool systIntrNS = (_HaveSysTick() == 2 && _SystGetIntrFlag(true, true));
-    if (systIntrS)
-      _SetPending(SysTick, true, true);
-    if (systIntrNS)
-      _SetPending(SysTick, false, true);
+  void _TopLevel() {
+    // Implementation-specific: Set exit cause value
+    _s.exitCause = 0;
 
-    // _NvicPendingPriority() has a value higher than the highest possible
-    // priority value if there is no pending interrupt so there is an interrupt
-    // to be handled iff this is true.
-    auto [pendingPrio, pendingExcNo, excIsSecure] = _PendingExceptionDetailsActual();
-    bool canTakePendingExc = (_ExecutionPriority(ignorePrimask) > pendingPrio);
+    // If the PE has locked up then abort execution of this instruction. Set
+    // the length of the current instruction to 0 so NextInstrAddr() reports
+    // the correct lockup address.
+    bool ok = !GETBITSM(InternalLoad32(REG_DHCSR), REG_DHCSR__S_LOCKUP);
+    if (!ok) {
+      TRACE("locked up\n");
+      _SetThisInstrDetails(0, 0, 0b1111);
+    } else {
+      ASSERT(!_s.pcChanged);
 
-    if (!canTakePendingExc)
-      return {false, 0, false};
+      // Check for stepping debug for current insn fetch.
+      bool monStepActive = _SteppingDebug();
+      _UpdateSecureDebugEnable();
+      uint32_t pc = _ThisInstrAddr();
 
-    return {true, pendingExcNo, excIsSecure};
-  }
+      uint32_t instr = 0;
+      bool is16bit;
+      try {
+        // Not locked up, so attempt to fetch the instruction.
+        std::tie(instr, is16bit) = _FetchInstr(pc);
+        //TRACE("fetched %d-bit insn: 0x%08x\n", is16bit ? 16 : 32, instr);
 
-  // XXX: Custom function, not found in ISA definition.
-  std::tuple<int,int,bool> _PendingExceptionDetailsActual() {
-    int  maxPrio      = 0x100; // Higher than any possible execution priority
-    int  maxPrioExc   = 0;
-    bool excIsSecure  = false;
+        // Setup the details of the instruction. NOTE: The default condition
+        // is based on the ITSTATE, however this is overridden in the decode
+        // stage by instructions that have explicit condition codes.
+        uint32_t len = is16bit ? 2 : 4;
+        _SetThisInstrDetails(instr, len, _s.itCond);
 
-    for (int i=NMI; i<16; ++i) { // Reset is not handled here
-      for (int j=0; j<2; ++j) { // j=0: secure exception, j=1: non-secure exception
-        if (!(_s.excPending[i] & BIT(j)))
-          continue;
+        // Checking for FPB Breakpoint on instructions
+        if (_HaveFPB() && _FPB_CheckBreakPoint(pc, len, true, _IsSecure()))
+          _FPB_BreakpointMatch();
 
-        bool excIsSecure_ = _ExceptionTargetsSecure(i, j == 0);
-        int  excPrio      = _ExceptionPriority(i, excIsSecure_, /*applyPrigroup=*/true);
+        // Finally try and execute the instruction.
+        _DecodeExecuteCached(instr, pc, is16bit);
 
-        if (excPrio < maxPrio) {
-          maxPrio     = excPrio;
-          maxPrioExc  = i;
-          excIsSecure = excIsSecure_;
+        if unlikely (_InstrTerminated())
+          ok = false;
+        else {
+          // Check for Monitor Step
+          if (_HaveDebugMonitor())
+            _SetMonStep(monStepActive);
+
+          // Check for DWT match
+          if (_IsDWTEnabled())
+            _DWT_InstructionMatch(pc);
         }
+
+      } catch (const Exception &e) {
+        ok = _HandleInstrException(e, instr);
       }
     }
 
-    for (int i=0; i<16; ++i) {
-      uint32_t v = InternalLoad32(REG_NVIC_ISPRn_S(i));
-      if (!v)
-        continue;
+    _TopLevelAdvance(ok);
+  }
+
+  /* _HandleInstrException {{{4
+   * ---------------------
+   * Handles an exception thrown while fetching, decoding or executing an
+   * instruction in _TopLevel. Returns false if the instruction did not
+   * complete.
+   */
+  bool _HandleInstrException(const Exception &e, uint32_t instr) {
+    bool ok = true;
+    // XXX: The psuedocode defines this as _IsSEE(e) || _IsUNDEFINED(e).
+    // Moreover, the comment below suggests that UNPREDICTABLE should not
+    // be caught here. However this seems to contradict the definition of
+    // UNPREDICTABLE in the glossary which states that a) UNPREDICTABLE
+    // must not do anything which could not be done with a sequence of
+    // non-UNPREDICTABLE instructions and b) UNPREDICTABLE can be
+    // implemented as UNDEFINED. For now, we disregard the comment below
+    // about not handling UNPREDICTABLE and treat all UNPREDICTABLE events
+    // as UNDEFINED.
+    if (_IsSEE(e) || _IsUNDEFINED(e) || _IsUNPREDICTABLE(e)) {
+      TRACE("top-level SEE/UD exception\n");
+      ok = _HandleUndefinedInstr(instr);
+    } else if (_IsExceptionTaken(e)) { // XXX guessing this is EndOfInstruction
+      TRACE("top-level EOI exception\n");
+      ok = false;
+    } else
+      // Do not catch UNPREDICTABLE or internal errors
+      throw;
+
+    return ok;
+  }
 
-      // ARMv8-M supports exceptions in range [1,511], leaving room for 495
-      // external interrupts. We must not attempt to ask about exceptions with
-      // numbers above 511, even if the _dev implementation is buggy and
-      // returns ones for ISPRn(15) bits [16:31].
-      if (i == 15)
-        v &= 0x0000FFFF;
-
-      while (v) {
-        // Determine number of least significant bit which is set.
-        uint32_t bitNo    = CTZL(v);
-        uint32_t intrNo   = i*32 + bitNo;
-        // Calculate effective exception priority for this external interrupt,
-        // including PRIGROUP etc.
-        bool intrIsSecure = _ExceptionTargetsSecure(16 + intrNo, false/*doesn't matter*/);
-        int  intrPrio     = _ExceptionPriority(16 + intrNo, intrIsSecure, /*applyPrigroup=*/true);
-        if (intrPrio < maxPrio) {
-          maxPrio     = intrPrio;
-          maxPrioExc  = 16 + intrNo;
-          excIsSecure = intrIsSecure;
+  /* _HandleUndefinedInstr {{{4
+   * ---------------------
+   * The handling of an UNDEFINED (or SEE) instruction by _HandleInstrException.
+   * Never throws. Returns false if the instruction did not complete.
+   */
+  bool _HandleUndefinedInstr(uint32_t instr) {
+    bool ok = true;
+    // Unallocated instructions in the NOP hint space and instructions that
+    // fail their condition tests are treated like NOPs.
+    bool nopHint =
+         (instr & 0b11111111111111111111111100001111U) == 0b00000000000000001011111100000000U
+      || (instr & 0b11111111111111111111111100000000U) == 0b11110011101011111000000000000000U;
+    if (_ConditionHolds(_CurrentCond()) && !nopHint) {
+      ok = false;
+      bool toSecure = _IsSecure();
+      // Unallocated instructions in the coprocessor space behave as NOCP if the
+      // coprocessor is disabled.
+      auto [isCp, cpNum] = _IsCPInstruction(instr);
+      if (isCp) {
+        auto [cpEnabled, cpFaultState] = _IsCPEnabled(cpNum);
+        if (!cpEnabled) {
+          // A PE is permitted to decode the coprocessor space and raise
+          // UNDEFINSTR UsageFaults for unallocated encodings even if the
+          // coprocessor is disabled.
+          if (IMPL_DEF_DECODE_CP_SPACE)
+            InternalOr32(REG_CFSR, REG_CFSR__UFSR__UNDEFINSTR);
+          else {
+            InternalOr32(REG_CFSR, REG_CFSR__UFSR__NOCP);
+            toSecure = cpFaultState;
+          }
         }
-        // Mask off this bit from our ISPR mask to see if any other interrupts
-        // are pending in this ISPR register by repeating CTZL above.
-        v &= ~BIT(bitNo);
-      }
+      } else
+        InternalOr32(REG_CFSR, REG_CFSR__UFSR__UNDEFINSTR);
+
+      // If Main Extension is not implemented the fault will escalate to a HardFault.
+      ExcInfo excInfo = _CreateException(UsageFault, true, toSecure);
+
+      // Prevent EndOfInstruction() being called in HandleInstruction() as the
+      // instruction has already been terminated so there is no need to throw
+      // the exception again.
+      excInfo.termInst = false;
+      _HandleException(excInfo);
     }
 
-    return {maxPrio, maxPrioExc, excIsSecure};
+    return ok;
   }
 
-  /* _RawExecutionPriority {{{4
-   * ---------------------
+  /* _RaiseUndefined {{{4
+   * ---------------
+   * Equivalent to THROW_UNDEFINED in an _Exec_* function, but via the status
+   * path of _RaiseFault.
    */
-  int _RawExecutionPriority() {
-    int execPri = _HighestPri();
-    for (int i=2; i<=_MaxExceptionNum(); ++i)
-      for (int j=0; j<2; ++j) {
-        bool secure = !j;
-        if (_IsActiveForState(i, secure)) {
-          int effectivePriority = _ExceptionPriority(i, secure, true);
-          if (effectivePriority < execPri)
-            execPri = effectivePriority;
-        }
+  void _RaiseUndefined() {
+    TRACE("W: undefined\n");
+    if (!_HandleUndefinedInstr(_ThisInstr()))
+      _s.instrTerminated = true;
+  }
+
+  /* _TopLevelAdvance {{{4
+   * ----------------
+   * The latter half of _TopLevel, run after the instruction has completed or
+   * been terminated.
+   */
+  void _TopLevelAdvance(bool ok) {
+    // If there is a reset pending do that, otherwise process the normal
+    // instruction advance.
+    try {
+      if (_s.excPending[Reset]) {
+        TRACE("top-level handling pending reset\n");
+        _s.excPending[Reset] = 0;
+        _TakeReset();
+        TRACE("top-level done handling pending reset\n");
+      } else {
+        // Call instruction advance for exception handling and PC/ITSTATE
+        // advance.
+        _InstructionAdvance(ok);
       }
 
-    return execPri;
+    } catch (const Exception &e) {
+      TRACE("top-level reset/advance exception\n");
+
+      // Do not catch UNPREDICTABLE or internal errors
+      if (!_IsExceptionTaken(e))
+        throw;
+
+      // The correct architectural behaviour for any exceptions is performed
+      // inside TakeReset() and InstructionAdvance(). So no additional actions
+      // are required in this catch block.
+    }
   }
 
-  /* _HighestPri {{{4
-   * -----------
+  /* _EndOfInstruction {{{4
+   * -----------------
    */
-  int _HighestPri() {
-    return 256;
+  void _EndOfInstruction() {
+    throw Exception(ExceptionType::EndOfInstruction);
   }
 
-  /* _RestrictedNSPri {{{4
+  /* _CreateException {{{4
    * ----------------
    */
-  int _RestrictedNSPri() {
-    return 0x80;
+  ExcInfo _CreateException(int exc, bool forceSecurity, bool isSecure, bool isSync=true) {
+    // Work out the effective target state of the exception.
+    if (_HaveSecurityExt()) {
+      if (!forceSecurity)
+        isSecure = _ExceptionTargetsSecure(exc, _IsSecure());
+      else
+        isSecure = false;
+    }
+
+    // An implementation without Security Extensions cannot cause a fault targeting
+    // Secure state.
+    assert(_HaveSecurityExt() || !isSecure);
+
+    // Get the remaining exception details.
+    auto [escalateToHf, termInst] = _ExceptionDetails(exc, isSecure, isSync);
+
+    // Fill in the default exception info.
+    ExcInfo info            = _DefaultExcInfo();
+    info.fault              = exc;
+    info.termInst           = termInst;
+    info.origFault          = exc;
+    info.origFaultIsSecure  = isSecure;
+
+    // Check for HardFault escalation.
+    // NOTE: In some cases (for example faults during lazy floating-point state
+    // preservation) the decision to escalate below is ignored and instead
+    // based on the info.origFaults fields and other factors.
+    if (escalateToHf && info.fault != HardFault) {
+      // Update the exception info with the escalation details, including
+      // whether there's a change in destination Security state.
+      info.fault    = HardFault;
+      isSecure      = _ExceptionTargetsSecure(HardFault, isSecure);
+      bool dummy;
+      std::tie(escalateToHf, dummy) = _ExceptionDetails(HardFault, isSecure, isSync);
+    }
+
+    // If the requested exception was already a HardFault then we can't
+    // escalate to a HardFault, so lockup. NOTE: Async BusFaults never cause
+    // lockups, if the BusFault is disabled it escalates to a HardFault that is
+    // pended.
+    if (escalateToHf && isSync && info.fault == HardFault)
+      info.lockup = true;
+
+    // Fill in the remaining exception info.
+    info.isSecure = isSecure;
+    return info;
   }
 
-  /* _FindPriv {{{4
-   * ---------
+  /* _UpdateSecureDebugEnable {{{4
+   * ------------------------
    */
-  bool _FindPriv() {
-    return _CurrentModeIsPrivileged();
+  void _UpdateSecureDebugEnable() {
+    /// DHCSR.S_SDE is frozen if the PE is in Debug state
+    uint32_t dhcsr = InternalLoad32(REG_DHCSR);
+    if (!GETBITSM(dhcsr, REG_DHCSR__S_HALT)) {
+      dhcsr = CHGBITSM(dhcsr, REG_DHCSR__S_SDE, _SecureHaltingDebugAllowed());
+      InternalStore32(REG_DHCSR, dhcsr);
+    }
+
+    uint32_t demcr = InternalLoad32(REG_DEMCR);
+    if (_HaveDebugMonitor() && !_s.excActive[DebugMonitor] && !GETBITSM(demcr, REG_DEMCR__MON_PEND)) {
+      demcr = CHGBITSM(demcr, REG_DEMCR__SDME, _SecureDebugMonitorAllowed());
+      InternalStore32(REG_DEMCR, demcr);
+    }
   }
 
-  /* _ExceptionEntry {{{4
-   * ---------------
+  /* _ColdReset {{{4
+   * ----------
+   * Does not correspond to any function in the ISA manual psuedocode; implements a cold
+   * reset as described in the manual. A cold reset is a superset of a warm reset.
    */
-  ExcInfo _ExceptionEntry(int excType, bool toSecure, bool instExecOk) {
-    ExcInfo exc = _PushStack(toSecure, instExecOk);
-    if (exc.fault == NoFault)
-      exc = _ExceptionTaken(excType, false, toSecure, false);
-    return exc;
+  void _ColdReset() {
+    // TODO
+    _TakeReset();
   }
 
-  /* _PushStack {{{4
+  /* _TakeReset {{{4
    * ----------
+   * This implements a warm reset.
    */
-  ExcInfo _PushStack(bool secureExc, bool instExecOk) {
-    auto &control = _IsSecure() ? _s.controlS : _s.controlNS;
+  void _TakeReset() {
+    _FlushFetchAttrs();
+    _FlushTlb();
+    _s.curState = _HaveSecurityExt() ? SecurityState_Secure : SecurityState_NonSecure;
 
-    uint32_t frameSize;
-    if (_HaveFPExt() && GETBITSM(control, CONTROL__FPCA) && (_IsSecure() || GETBITSM(InternalLoad32(REG_NSACR), REG_NSACR__CP(10)))) {
-      if (_IsSecure() && GETBITSM(InternalLoad32(REG_FPCCR_S), REG_FPCCR__TS))
-        frameSize = 0xA8;
-      else
-        frameSize = 0x68;
+    _ResetSCSRegs(); // Catch-all function for System Control Space reset
+    _UpdateMAIRTables();
+    _s.lazyFlags = 0;
+    _s.xpsr = 0; // APSR is UNKNOWN UNPREDICTABLE, IPSR exception number is 0
+    _SyncITSTATE();
+    if (_HaveMainExt()) {
+      _s.lr = 0xFFFF'FFFF;      // Preset to an illegal exception return value
+      _SetITSTATEAndCommit(0);  // IT/ICI bits cleared
     } else
-      frameSize = 0x20;
-
-    bool framePtrAlign = GETBIT(_GetSP(), 2);
-    uint32_t framePtr = (_GetSP() - frameSize) & ~BIT(2);
-    RName spName = _LookUpSP();
+      _s.lr = 0xFFFF'FFFF;      // UNKNOWN
 
-    auto [retAddr, itState] = _ReturnState(instExecOk);
-    uint32_t retpsr = _s.xpsr;
-    retpsr = CHGBITSM(retpsr, RETPSR__IT_ICI_LO, itState>>2);
-    retpsr = CHGBITSM(retpsr, RETPSR__IT_ICI_HI, itState);
-    retpsr = CHGBITSM(retpsr, RETPSR__SPREALIGN, framePtrAlign);
-    retpsr = CHGBITSM(retpsr, RETPSR__SFPA, _IsSecure() ? GETBITSM(_s.controlS, CONTROL__SFPA) : 0);
+    // Reset priority boosting
+    _s.primaskNS &= ~1;
+    if (_HaveSecurityExt())
+      _s.primaskS &= ~1;
+    if (_HaveMainExt()) {
+      _s.faultmaskNS &= ~1;
+      _s.basepriNS = CHGBITS(_s.basepriNS,0,7,0);
+      if (_HaveSecurityExt()) {
+        _s.faultmaskS &= ~1;
+        _s.basepriS = CHGBITS(_s.basepriS,0,7,0);
+      }
+    }
 
-    PEMode mode = _CurrentMode();
-    ExcInfo exc;
-    if (1)                    exc = _Stack(framePtr, 0x00, spName, mode, _GetR( 0));
-    if (exc.fault == NoFault) exc = _Stack(framePtr, 0x04, spName, mode, _GetR( 1));
-    if (exc.fault == NoFault) exc = _Stack(framePtr, 0x08, spName, mode, _GetR( 2));
-    if (exc.fault == NoFault) exc = _Stack(framePtr, 0x0C, spName, mode, _GetR( 3));
-    if (exc.fault == NoFault) exc = _Stack(framePtr, 0x10, spName, mode, _GetR(12));
-    if (exc.fault == NoFault) exc = _Stack(framePtr, 0x14, spName, mode, _GetLR());
-    if (exc.fault == NoFault) exc = _Stack(framePtr, 0x18, spName, mode, retAddr);
-    if (exc.fault == NoFault) exc = _Stack(framePtr, 0x1C, spName, mode, retpsr);
+    // Initialize the Floating Point Extn
+    if (_HaveFPExt()) {
+      _s.controlS = CHGBITSM(_s.controlS, CONTROL__FPCA, 0); // FP inactive
+      uint32_t fpdscrNS = InternalLoad32(REG_FPDSCR_NS);
+      fpdscrNS = CHGBITSM(fpdscrNS, REG_FPDSCR__AHP,    0);
+      fpdscrNS = CHGBITSM(fpdscrNS, REG_FPDSCR__DN,     0);
+      fpdscrNS = CHGBITSM(fpdscrNS, REG_FPDSCR__FZ,     0);
+      fpdscrNS = CHGBITSM(fpdscrNS, REG_FPDSCR__RMODE,  0);
+      InternalStore32(REG_FPDSCR_NS, fpdscrNS);
+      uint32_t fpccr = InternalLoad32(REG_FPCCR_S);
+      fpccr = CHGBITSM(fpccr, REG_FPCCR__LSPEN, 1);
+      InternalStore32(REG_FPCCR_S, fpccr);
+      uint32_t fpccrNS = InternalLoad32(REG_FPCCR_NS);
+      fpccrNS = CHGBITSM(fpccrNS, REG_FPCCR__ASPEN, 1);
+      fpccrNS = CHGBITSM(fpccrNS, REG_FPCCR__LSPACT, 0);
+      InternalStore32(REG_FPCCR_NS, fpccrNS);
+      InternalStore32(REG_FPCAR_NS, 0); // UNKNOWN
+      if (_HaveSecurityExt()) {
+        _s.controlS = CHGBITSM(_s.controlS, CONTROL__SFPA, 0);
+        uint32_t fpdscrS = InternalLoad32(REG_FPDSCR_S);
+        fpdscrS = CHGBITSM(fpdscrS, REG_FPDSCR__AHP, 0);
+        fpdscrS = CHGBITSM(fpdscrS, REG_FPDSCR__DN, 0);
+        fpdscrS = CHGBITSM(fpdscrS, REG_FPDSCR__FZ, 0);
+        fpdscrS = CHGBITSM(fpdscrS, REG_FPDSCR__RMODE, 0);
+        InternalStore32(REG_FPDSCR_S, fpdscrS);
+        uint32_t fpccr = InternalLoad32(REG_FPCCR_S);
+        fpccr = CHGBITSM(fpccr, REG_FPCCR__LSPENS, 0);
+        InternalStore32(REG_FPCCR_S, fpccr);
+        uint32_t fpccrS = InternalLoad32(REG_FPCCR_S);
+        fpccrS = CHGBITSM(fpccrS, REG_FPCCR__ASPEN, 1);
+        fpccrS = CHGBITSM(fpccrS, REG_FPCCR__LSPACT, 0);
+        InternalStore32(REG_FPCCR_S, fpccrS);
+        InternalStore32(REG_FPCAR_S, 0); // UNKNOWN
+      }
+      for (int i=0; i<32; ++i)
+        _SetS(i, 0); // UNKNOWN
+    }
 
-    if (_HaveFPExt() && GETBITSM(control, CONTROL__FPCA)) {
+    for (int i=0; i<_MaxExceptionNum(); ++i) // All exceptions Inactive
+      _s.excActive[i] = 0;
+    _UpdateActiveMap();
+    _ClearExclusiveLocal(_ProcessorID());
+    _ClearEventRegister();
+    for (int i=0; i<13; ++i)
+      _s.r[i] = 0; // UNKNOWN
 
+    // Stack limit registers. It is IMPLEMENTATIOND EFINED how many bits
+    // of these registers are writable. The following writes only affect the bits
+    // that an implementation defines as writable.
+    if (_HaveMainExt()) {
+      _s.msplimNS = 0;
+      _s.psplimNS = 0;
+    }
+    if (_HaveSecurityExt()) {
+      _s.msplimS = 0;
+      _s.psplimS = 0;
     }
 
-    ExcInfo spExc = _SetSP(spName, true, framePtr);
-    exc = _MergeExcInfo(exc, spExc);
-
-    bool isSecure = _IsSecure();
-    bool isThread = (mode == PEMode_Thread);
-    if (_HaveFPExt())
-      _SetLR(BITS(7,31) | (uint32_t(isSecure)<<6) | (uint32_t(isThread)<<3) | 0b100000 | ((GETBITSM(control, CONTROL__FPCA)^1)<<4));
-    else
-      _SetLR(BITS(7,31) | (uint32_t(isSecure)<<6) | (uint32_t(isThread)<<3) | 0b110000);
+    // Load the initial value of the stack pointer and the reset value from the
+    // vector table. The order of the loads is IMPLEMENTATION DEFINED.
+    auto [excSp, sp]      = _GetVector(0,     _HaveSecurityExt());
+    auto [excRst, start]  = _GetVector(Reset, _HaveSecurityExt());
+    if (excSp.fault != NoFault || excRst.fault != NoFault)
+      _Lockup(true);
 
-    return exc;
-  }
+    // Initialize the stack pointers and start execution at the reset vector
+    if (_HaveSecurityExt()) {
+      _SetSP_Main_Secure(sp);
+      _SetSP_Main_NonSecure(0); // UNKNOWN
+      _SetSP_Process_Secure(0); // UNKNOWN
+    } else
+      _SetSP_Main_NonSecure(sp);
 
-  /* _MergeExcInfo {{{4
-   * -------------
-   */
-  ExcInfo _MergeExcInfo(const ExcInfo &a, const ExcInfo &b) {
-    ExcInfo exc, pend;
+    // Begin Implementation-Specific Resets
+    _s.curCondOverride = -1;
+    // End Implementation-Specific Resets
 
-    if (b.fault == NoFault || (a.isTerminal && !b.isTerminal))
-      exc = a;
-    else if (a.fault == NoFault || (b.isTerminal && !a.isTerminal))
-      exc = b;
-    else if (a.fault == b.fault && a.isSecure == b.isSecure)
-      exc = a;
-    else {
-      int aPri = _ExceptionPriority(a.fault, a.isSecure, false);
-      int bPri = _ExceptionPriority(b.fault, b.isSecure, false);
+    _SetSP_Process_NonSecure(0); // UNKNOWN
+    _s.xpsr = CHGBITSM(_s.xpsr, XPSR__T, start & 1);
+    _BranchToAndCommit(start & ~1);
 
-      if (aPri < bPri) {
-        exc  = a;
-        pend = b;
-      } else {
-        exc  = b;
-        pend = a;
-      }
+    // This is not included in the psuedocode but is required else the first
+    // instruction will be executed twice.
+    _s.pcChanged       = false;
+  }
 
-      if (IMPL_DEF_OVERRIDDEN_EXCEPTIONS_PENDED)
-        _SetPending(pend.fault, pend.isSecure, true);
+  /* _SteppingDebug {{{4
+   * --------------
+   */
+  bool _SteppingDebug() {
+    // If halting debug is allowed and C_STEP is set, set C_HALT for the next instruction.
+    uint32_t dhcsr = InternalLoad32(REG_DHCSR);
+    if (_CanHaltOnEvent(_IsSecure()) && !!(dhcsr & REG_DHCSR__C_STEP)) {
+      dhcsr |= REG_DHCSR__C_HALT;
+      InternalStore32(REG_DHCSR, dhcsr);
+
+      uint32_t dfsr = InternalLoad32(REG_DFSR);
+      dfsr |= REG_DFSR__HALTED;
+      InternalStore32(REG_DFSR, dfsr);
     }
 
-    return exc;
+    uint32_t demcr = InternalLoad32(REG_DEMCR);
+    bool monStepEnabled = _HaveDebugMonitor() && _CanPendMonitorOnEvent(_IsSecure(), false);
+    return monStepEnabled && !!(demcr & REG_DEMCR__MON_STEP);
   }
 
-  /* _ReturnState {{{4
-   * ------------
+  /* _FetchInstr {{{4
+   * -----------
    */
-  std::tuple<uint32_t, uint8_t> _ReturnState(bool instExecOk) {
-    if (instExecOk)
-      return {_NextInstrAddr(), _NextInstrITState()};
-    else
-      return {_ThisInstrAddr(), _ThisInstrITState()};
-  }
+  std::tuple<uint32_t,bool> _FetchInstr(uint32_t addr) {
+    uint32_t sgOpcode = 0xE97F'E97F;
 
-  /* _DerivedLateArrival {{{4
-   * -------------------
-   */
-  void _DerivedLateArrival(int pePriority, int peNumber, bool peIsSecure, const ExcInfo &deInfo, int oeNumber, bool oeIsSecure) {
-    int oePriority = _ExceptionPriority(oeNumber, oeIsSecure, false);
+    uint32_t ctx = _BlockContext();
+    const FetchAttrs *fa = _LookUpFetchAttrs(addr, ctx);
+    SAttributes hw1Attr = fa ? fa->sAttrs : _SecurityCheck(addr, true, _IsSecure());
+    // Fetch the T16 instruction, or the first half of a T32.
+    uint16_t hw1Instr = _GetMemI(addr, ctx);
 
-    bool deIsDbgMonFault = _HaveMainExt() ? deInfo.origFault == DebugMonitor : false;
+    // If the T bit is clear then the instruction can't be decoded
+    if (!GETBITSM(_s.xpsr, XPSR__T)) {
+      // Attempted NS->S domain crossing with the T bit clear raise an INVEP
+      // SecureFault
+      ExcInfo excInfo;
+      if (!_IsSecure() && !hw1Attr.ns) {
+        uint32_t sfsr = InternalLoad32(REG_SFSR);
+        sfsr |= REG_SFSR__INVEP;
+        InternalStore32(REG_SFSR, sfsr);
+        excInfo = _CreateException(SecureFault, true, true);
+      } else {
+        InternalOr32(REG_CFSR, REG_CFSR__UFSR__INVSTATE);
+        excInfo = _CreateException(UsageFault, false, false/*unknown*/);
+      }
+      _HandleException(excInfo);
+    }
 
-    bool targetIsSecure;
-    int targetFault;
-    if (deInfo.isTerminal) {
-      targetIsSecure  = deInfo.isSecure;
-      targetFault     = deInfo.fault;
-      if (!_ComparePriorities(deInfo, false, oePriority, oeNumber, oeIsSecure)) {
-        _ActivateException(oeNumber, oeIsSecure);
-        _Lockup(true);
+    // Implementations are permitted to terminate the fetch process early if a
+    // domain crossing is being attempted and the first 16bits of the opcode
+    // isn't the first part of the SG instruction.
+    if (IMPL_DEF_EARLY_SG_CHECK) {
+      if (!_IsSecure() && !hw1Attr.ns && (hw1Instr != sgOpcode>>16)) {
+        uint32_t sfsr = InternalLoad32(REG_SFSR);
+        sfsr |= REG_SFSR__INVEP;
+        InternalStore32(REG_SFSR, sfsr);
+        ExcInfo excInfo = _CreateException(SecureFault, true, true);
+        _HandleException(excInfo);
       }
-    } else if (deIsDbgMonFault && !_ComparePriorities(deInfo, true, pePriority, peNumber, peIsSecure)) {
-      _SetPending(DebugMonitor, deInfo.isSecure, false);
-      targetFault = oeNumber;
-      targetIsSecure = oeIsSecure;
-    } else if (_ComparePriorities(deInfo, false, oePriority, oeNumber, oeIsSecure)) {
-      targetFault = deInfo.fault;
-      targetIsSecure = deInfo.isSecure;
-    } else {
-      if (deInfo.lockup) {
-        _ActivateException(oeNumber, oeIsSecure);
-        _Lockup(true);
-      } else {
-        targetFault = oeNumber;
-        targetIsSecure = oeIsSecure;
+    }
+
+    // NOTE: Implementations are also permitted to terminate the fetch process
+    // at this point with an UNDEFINSTR UsageFault if the first 16 bits are an
+    // undefined T32 prefix.
+
+    // If the data fetched is the top half of a T32 instruction, fetch the bottom
+    // 16 bits.
+    uint32_t instr;
+    SAttributes hw2Attr;
+    bool isT16 = GETBITS(hw1Instr,11,15) < 0b11101;
+    if (isT16)
+      instr = hw1Instr;
+    else {
+      fa = _LookUpFetchAttrs(addr+2, ctx);
+      hw2Attr = fa ? fa->sAttrs : _SecurityCheck(addr+2, true, _IsSecure());
+      // The following test covers 2 possible fault conditions:
+      // 1) NS code branching to a T32 instruction where the first half is in
+      //    NS memory, and the second half is in S memory
+      // 2) NS code branching to a T32 instruction in S & NSC memory, but
+      //    where the second half of the instruction is in NS memory
+      if (!_IsSecure() && hw1Attr.ns != hw2Attr.ns) {
+        uint32_t sfsr = InternalLoad32(REG_SFSR);
+        sfsr |= REG_SFSR__INVEP;
+        InternalStore32(REG_SFSR, sfsr);
+        ExcInfo excInfo = _CreateException(SecureFault, true, true);
+        _HandleException(excInfo);
       }
+
+      // Fetch the second half of the TE2 instruction.
+      instr = (uint32_t(hw1Instr)<<16) | _GetMemI(addr+2, ctx);
     }
 
-    if (_HaveMainExt() && deInfo.fault == HardFault && deInfo.origFault != HardFault)
-      InternalOr32(REG_HFSR, REG_HFSR__FORCED);
+    // Raise a fault if an otherwise valid NS->S transition that doesn't land on
+    // an SG instruction.
+    if (!_IsSecure() && !hw1Attr.ns && instr != sgOpcode) {
+      uint32_t sfsr = InternalLoad32(REG_SFSR);
+      sfsr |= REG_SFSR__INVEP;
+      InternalStore32(REG_SFSR, sfsr);
+      ExcInfo excInfo = _CreateException(SecureFault, true, true);
+      _HandleException(excInfo);
+    }
 
-    _SetPending(deInfo.fault, deInfo.isSecure, true);
-    ExcInfo excInfo = _ExceptionTaken(targetFault, deInfo.inExcTaken, targetIsSecure, true);
-    if (excInfo.fault != NoFault)
-      _DerivedLateArrival(pePriority, peNumber, peIsSecure, excInfo, targetFault, targetIsSecure);
+    return {instr, isT16};
   }
 
-  /* _ComparePriorities {{{4
-   * ------------------
+  /* _GenerateDebugEventResponse {{{4
+   * ---------------------------
    */
-  bool _ComparePriorities(int exc0Pri, int exc0Number, bool exc0IsSecure,
-                          int exc1Pri, int exc1Number, bool exc1IsSecure) {
-    bool takeE0;
-    if (exc0Pri != exc1Pri)
-      takeE0 = (exc0Pri < exc1Pri);
-    else if (exc0Number != exc1Number)
-      takeE0 = (exc0Number < exc1Number);
-    else if (exc0IsSecure != exc1IsSecure)
-      takeE0 = exc0IsSecure;
-    else
-      takeE0 = false;
-    return takeE0;
+  bool _GenerateDebugEventResponse() {
+    if (_CanHaltOnEvent(_IsSecure())) {
+      InternalOr32(REG_DFSR, REG_DFSR__BKPT);
+      InternalOr32(REG_DHCSR, REG_DHCSR__C_HALT);
+      return true;
+    } else if (_HaveMainExt() && _CanPendMonitorOnEvent(_IsSecure(), true)) {
+      InternalOr32(REG_DFSR, REG_DFSR__BKPT);
+      InternalOr32(REG_DEMCR, REG_DEMCR__MON_PEND);
+      ExcInfo excInfo = _CreateException(DebugMonitor, false, false/*UNKNOWN*/);
+      _HandleException(excInfo);
+      return true;
+    } else
+      return false;
   }
 
-  bool _ComparePriorities(const ExcInfo &exc0Info, bool groupPri, int exc1Pri, int exc1Number, bool exc1IsSecure) {
-    int exc0Pri = _ExceptionPriority(exc0Info.fault, exc0Info.isSecure, groupPri);
-    return _ComparePriorities(exc0Pri, exc0Info.fault, exc0Info.isSecure, exc1Pri, exc1Number, exc1IsSecure);
+  /* _FPB_CheckBreakPoint {{{4
+   * --------------------
+   */
+  bool _FPB_CheckBreakPoint(uint32_t iaddr, int size, bool isIFetch, bool isSecure) {
+    bool match = _FPB_CheckMatchAddress(iaddr);
+    if (!match && size == 4 && _FPB_CheckMatchAddress(iaddr+2))
+      match = _ConstrainUnpredictableBool(true/*Unpredictable_FPBreakpoint*/);
+    return match;
   }
 
-  /* _ActivateException {{{4
-   * ------------------
+  /* _FPB_CheckMatchAddress {{{4
+   * ----------------------
    */
-  void _ActivateException(int excNo, bool excIsSecure) {
-    _s.curState = excIsSecure ? SecurityState_Secure : SecurityState_NonSecure;
-    _s.xpsr = CHGBITSM(_s.xpsr, XPSR__EXCEPTION, excNo);
-    if (_HaveMainExt())
-      _SetITSTATE(0);
-    uint32_t &control = _IsSecure() ? _s.controlS : _s.controlNS;
-    if (_HaveFPExt()) {
-      control = CHGBITSM(control, CONTROL__FPCA, 0);
-      _s.controlS = CHGBITSM(_s.controlS, CONTROL__SFPA, 0);
+  bool _FPB_CheckMatchAddress(uint32_t iaddr) {
+    if (!(InternalLoad32(REG_FP_CTRL) & REG_FP_CTRL__ENABLE))
+      return false; // FPB not enabled
+
+    // Instruction Comparator.
+    uint32_t fpCtrl = InternalLoad32(REG_FP_CTRL);
+    uint32_t numAddrCmp = GETBITSM(fpCtrl, REG_FP_CTRL__NUM_CODE_LO) | (GETBITSM(fpCtrl, REG_FP_CTRL__NUM_CODE_HI)<<4);
+    if (!numAddrCmp)
+      return false; // No comparator support
+
+    for (int N=0; N<numAddrCmp; ++N) {
+      uint32_t x = InternalLoad32(REG_FP_COMP(N));
+      if (x & REG_FP_COMPn__BE) // Breakpoint enabled
+        if ((iaddr>>1) == GETBITSM(x, REG_FP_COMPn__BPADDR))
+          return true;
     }
-    control = CHGBITSM(control, CONTROL__SPSEL, 0);
 
-    _SetPending(excNo, excIsSecure, false);
-    _SetActive(excNo, excIsSecure, true);
+    return false;
   }
 
-  /* _SetActive {{{4
-   * ----------
+  /* _ExceptionDetails {{{4
+   * -----------------
    */
-  void _SetActive(int exc, bool isSecure, bool setNotClear) {
-    if (!_HaveSecurityExt())
-      isSecure = false;
+  std::tuple<bool,bool> _ExceptionDetails(int exc, bool isSecure, bool isSync) {
+    bool escalateToHf, termInst, enabled, canEscalate;
 
-    if (_IsExceptionTargetConfigurable(exc)) {
-      if (_ExceptionTargetsSecure(exc, isSecure/*UNKNOWN TODO*/) == isSecure)
-        _s.excActive[exc] = setNotClear ? 0b11 : 0b00;
-    } else {
-      uint32_t idx = isSecure ? 0 : 1;
-      _s.excActive[exc] = CHGBITS(_s.excActive[exc], idx, idx, setNotClear ? 1 : 0);
+    switch (exc) {
+      case HardFault:
+        termInst = true;
+        enabled = true;
+        canEscalate = true;
+        break;
+      case MemManage:
+        termInst = true;
+        if (_HaveMainExt()) {
+          uint32_t val = isSecure ? InternalLoad32(REG_SHCSR_S) : InternalLoad32(REG_SHCSR_NS);
+          enabled = !!(val & REG_SHCSR__MEMFAULTENA);
+        } else
+          enabled = false;
+        canEscalate = true;
+        break;
+      case BusFault:
+        termInst = isSync;
+        enabled = _HaveMainExt() ? !!(InternalLoad32(REG_SHCSR_S) & REG_SHCSR__BUSFAULTENA) : false;
+        canEscalate = termInst || !enabled; // Async BusFaults only escalate if they are disabled
+        break;
+      case UsageFault:
+        termInst = true;
+        if (_HaveMainExt()) {
+          uint32_t val = isSecure ? InternalLoad32(REG_SHCSR_S) : InternalLoad32(REG_SHCSR_NS);
+          enabled = !!(val & REG_SHCSR__USGFAULTENA);
+        } else
+          enabled = false;
+        canEscalate = true;
+        break;
+      case SecureFault:
+        termInst = true;
+        enabled = _HaveMainExt() ? !!(InternalLoad32(REG_SHCSR_S) & REG_SHCSR__SECUREFAULTENA) : false;
+        canEscalate = true;
+        break;
+      case SVCall:
+        termInst = false;
+        enabled  = true;
+        canEscalate = true;
+        break;
+      case DebugMonitor:
+        termInst = true;
+        enabled = _HaveMainExt() ? !!(InternalLoad32(REG_DEMCR) & REG_DEMCR__MON_EN) : false;
+        canEscalate = false; // true if fault caused by BKPT instruction
+        break;
+      default:
+        termInst = false;
+        canEscalate = false;
+        break;
     }
-  }
-
-  /* _TailChain {{{4
-   * ----------
-   */
-  ExcInfo _TailChain(int excNo, bool excIsSecure, uint32_t excReturn) {
-    if (!_HaveFPExt())
-      excReturn = CHGBITSM(excReturn, EXC_RETURN__FTYPE, 1);
-    excReturn = CHGBITSM(excReturn, EXC_RETURN__PREFIX, 0xFF);
-    _SetLR(excReturn);
-
-    return _ExceptionTaken(excNo, true, excIsSecure, false);
-  }
-
-  /* _ConsumeExcStackFrame {{{4
-   * ---------------------
-   */
-  void _ConsumeExcStackFrame(uint32_t excReturn, bool fourByteAlign) {
-    bool toSecure = _HaveSecurityExt() && !!(excReturn & BIT(6));
-    uint32_t frameSize;
-    if (toSecure && (!GETBITSM(excReturn, EXC_RETURN__ES) || !GETBITSM(excReturn, EXC_RETURN__DCRS)))
-      frameSize = 0x48;
-    else
-      frameSize = 0x20;
 
-    if (_HaveFPExt() && !GETBITSM(excReturn, EXC_RETURN__FTYPE)) {
-      if (toSecure && (InternalLoad32(REG_FPCCR_S) & REG_FPCCR__TS))
-        frameSize = frameSize + 0x88;
-      else
-        frameSize = frameSize + 0x48;
+    // If the fault can escalate then check if exception can be taken
+    // immediately, or whether it should escalate.
+    escalateToHf = false;
+    if (canEscalate) {
+      int execPri = _ExecutionPriority();
+      int excePri = _ExceptionPriority(exc, isSecure, true);
+      if (excePri >= execPri || !enabled)
+        escalateToHf = true;
     }
 
-    PEMode mode = GETBITSM(excReturn, EXC_RETURN__MODE) == 1 ? PEMode_Thread : PEMode_Handler;
-    RName spName = _LookUpSP_with_security_mode(toSecure, mode);
-    _s.r[spName] = (_GetSP(spName) + frameSize) | (fourByteAlign ? 0b100 : 0);
+    return {escalateToHf, termInst};
   }
 
-  /* _ExceptionReturn {{{4
+  /* _HandleException {{{4
    * ----------------
    */
-  std::tuple<ExcInfo, uint32_t> _ExceptionReturn(uint32_t excReturn) {
-    int returningExcNo = GETBITSM(_s.xpsr, XPSR__EXCEPTION);
-
-    ExcInfo exc;
-    std::tie(exc, excReturn) = _ValidateExceptionReturn(excReturn, returningExcNo);
-    if (exc.fault != NoFault)
-      return {exc, excReturn};
-
-    bool excSecure, retToSecure;
-    if (_HaveSecurityExt()) {
-      excSecure   = !!GETBITSM(excReturn, EXC_RETURN__ES);
-      retToSecure = !!GETBITSM(excReturn, EXC_RETURN__S);
-    } else {
-      excSecure   = false;
-      retToSecure = false;
-    }
-
-    if (excSecure)
-      _s.controlS = CHGBITSM(_s.controlS, CONTROL__SPSEL, GETBITSM(excReturn, EXC_RETURN__SPSEL));
-    else
-      _s.controlNS = CHGBITSM(_s.controlNS, CONTROL__SPSEL, GETBITSM(excReturn, EXC_RETURN__SPSEL));
-
-    bool targetDomainSecure = !!GETBITSM(excReturn, EXC_RETURN__ES);
-    _DeActivate(returningExcNo, targetDomainSecure);
+  void _HandleException(const ExcInfo &excInfo) {
+    if (excInfo.fault == NoFault)
+      return;
 
-    auto &control = _IsSecure() ? _s.controlS : _s.controlNS;
-    if (_HaveFPExt() && (InternalLoad32(REG_FPCCR) & REG_FPCCR__CLRONRET) && (control & CONTROL__FPCA)) {
-      if (InternalLoad32(REG_FPCCR_S) & REG_FPCCR__LSPACT) {
-        InternalOr32(REG_SFSR, REG_SFSR__LSERR);
-        exc = _CreateException(SecureFault, true, true);
-        return {exc, excReturn};
-      } else {
-        for (int i=0; i<16; ++i)
-          _SetS(i,0);
-        _s.fpscr = 0;
-      }
-    }
+    TRACE("handling exception %d\n", excInfo.fault);
 
-    if (IMPL_DEF_TAIL_CHAINING_SUPPORTED) {
-      auto [takeException, exc2, excIsSecure] = _PendingExceptionDetails();
-      if (takeException) {
-        exc = _TailChain(exc2, excIsSecure, excReturn);
-        return {exc, excReturn};
-      }
+    if (excInfo.lockup) {
+      TRACE("commencing lockup\n");
+      _Lockup(excInfo.termInst);
+      return;
     }
 
-    if (_HaveSecurityExt())
-      _s.curState = retToSecure ? SecurityState_Secure : SecurityState_NonSecure;
+    // If the fault escalated to a HardFault update the syndrome info
+    if (_HaveMainExt() && excInfo.fault == HardFault && excInfo.origFault != HardFault)
+      InternalOr32(REG_HFSR, REG_HFSR__FORCED);
 
-    if (GETBITSM(excReturn, EXC_RETURN__MODE) && (InternalLoad32(REG_SCR) & REG_SCR__SLEEPONEXIT) && !_ExceptionActiveBitCount())
-      _SleepOnExit();
+    // If the exception does not cause a lockup set the exception pending and
+    // potentially terminate execution of the current instruction
+    _SetPending(excInfo.fault, excInfo.isSecure, true);
+    if (excInfo.termInst)
+      _EndOfInstruction();
+  }
 
-    exc = _PopStack(excReturn);
-    if (exc.fault == NoFault) {
-      _ClearExclusiveLocal(_ProcessorID());
-      _SetEventRegister();
-      _InstructionSynchronizationBarrier(0b1111);
-    }
+  /* _RaiseFault {{{4
+   * -----------
+   * As for _HandleException, but if the exception terminates the current
+   * instruction, sets instrTerminated instead of throwing. The caller must
+   * then return without further effect (see RETURN_IF_TERMINATED), and the
+   * dispatch loop treats the instruction as it would a caught
+   * EndOfInstruction. Unwinding a C++ exception costs far more than the
+   * fault itself, which matters for code which faults routinely (MPU stack
+   * guards, demand paging via MemManage, fuzzing).
+   */
+  void _RaiseFault(ExcInfo excInfo) {
+    if likely (excInfo.fault == NoFault)
+      return;
 
-    return {exc, excReturn};
+    bool termInst = excInfo.termInst;
+    excInfo.termInst = false;
+    _HandleException(excInfo);
+    if (termInst)
+      _s.instrTerminated = true;
   }
 
-  /* _ExceptionActiveBitCount {{{4
-   * ------------------------
+  /* _InstrTerminated {{{4
+   * ----------------
+   * Called by the dispatch loops after executing an instruction. Returns true
+   * (and clears the status) if it was terminated via _RaiseFault.
    */
-  int _ExceptionActiveBitCount() {
-    int count = 0;
-    for (int i=0; i<=_MaxExceptionNum(); ++i)
-      for (int j=0; j<2; ++j)
-        if (_IsActiveForState(i, !j))
-          ++count;
-    return count;
+  bool _InstrTerminated() {
+    if likely (!_s.instrTerminated)
+      return false;
+
+    _s.instrTerminated = false;
+    return true;
   }
 
-  /* _DeActivate {{{4
-   * -----------
+  /* _InstructionAdvance {{{4
+   * -------------------
    */
-  void _DeActivate(int returningExcNo, bool targetDomainSecure) {
-    int rawPri = _RawExecutionPriority();
-    if (rawPri == -1)
-      _SetActive(HardFault, !(InternalLoad32(REG_AIRCR) & REG_AIRCR__BFHFNMINS), false);
-    else if (rawPri == -2)
-      _SetActive(NMI,       !(InternalLoad32(REG_AIRCR) & REG_AIRCR__BFHFNMINS), false);
-    else if (rawPri == -3)
-      _SetActive(HardFault,  true, false);
-    else {
-      bool secure = _HaveSecurityExt() && targetDomainSecure;
-      _SetActive(returningExcNo, secure, false);
+  void _InstructionAdvance(bool instExecOk) {
+    // Check for, and process any exception returns that were requested. This
+    // must be done after the instruction has completed so any exceptions raised
+    // during the exception return do not interfere with the execution of the
+    // instruction that causes the exception return (e.g. a POP causing an
+    // excReturn value to be written to the PC must adjust SP even if the
+    // exception return caused by the POP raises a fault).
+    bool excRetFault = false;
+    uint32_t excReturn = _NextInstrAddr();
+    if (_s.pendingReturnOperation) {
+      _s.pendingReturnOperation = false;
+      ExcInfo excInfo;
+      std::tie(excInfo, excReturn) = _ExceptionReturn(excReturn);
+      // Handle any faults raised during exception return
+      if (excInfo.fault != NoFault) {
+        excRetFault = true;
+        // Either lockup, or pend the fault if it can be taken
+        if (excInfo.lockup) {
+          // Check if the fault occured on an exception return, or whether it
+          // occured during a tail chained exception entry. This is because
+          // Lockups on exception return have to be handled differently.
+          if (!excInfo.inExcTaken) {
+            // If the fault occured during exception return, then the register
+            // state is UNKNOWN. This is due to the fact that an unknown amount
+            // of the exception stack frame might have been restored.
+            for (int n=0; n<13; ++n)
+              _s.r[n] = 0; // UNKNOWN
+            _s.lr = 0; // UNKNOWN
+            _s.lazyFlags = 0;
+            _s.xpsr = 0; // UNKNOWN
+            _SyncITSTATE();
+            if (_HaveFPExt())
+              for (int n=0; n<32; ++n)
+                _SetS(n, 0); // UNKNOWN
+            _s.fpscr = 0; // UNKNOWN
+            // If lockup is entered as a result of an exception return fault the
+            // original exception is deactivated. Therefore the stack pointer
+            // must be updated to consume the exception stack frame to keep the
+            // stack depth consistent with the number of active exceptions. NOTE:
+            // The XPSR SP alignment flag is UNKNOWN, assume is was zero.
+            _ConsumeExcStackFrame(excReturn, false);
+            // IPSR from stack is UNKNOWN, set IPSR bsased on mode specified in
+            // EXC_RETURN.
+            _s.xpsr = CHGBITSM(_s.xpsr, XPSR__EXCEPTION, (excReturn & EXC_RETURN__MODE) ? NoFault : HardFault);
+            if (_HaveFPExt()) {
+              uint32_t &control = _IsSecure() ? _s.controlS : _s.controlNS;
+              control = CHGBITSM(control,  CONTROL__FPCA, ~GETBITSM(excReturn, EXC_RETURN__FTYPE));
+              _s.controlS = CHGBITSM(_s.controlS, CONTROL__SFPA, 0); // UNKNOWN
+            }
+          }
+          _Lockup(false);
+        } else {
+          // Set syndrome if fault escalated to a hardfault
+          if (_HaveMainExt() && excInfo.fault == HardFault && excInfo.origFault != HardFault)
+            InternalOr32(REG_HFSR, REG_HFSR__FORCED);
+          _SetPending(excInfo.fault, excInfo.isSecure, true);
+        }
+      }
     }
 
-    if (_HaveMainExt() && rawPri >= 0) {
-      if (_HaveSecurityExt() && targetDomainSecure)
-        _s.faultmaskS &= ~1;
-      else
-        _s.faultmaskNS &= ~1;
+    // If there is a pending exception with sufficient priority take it now. This
+    // is done before committing PC and ITSTATE changes caused by the previous
+    // instruction so that calls to ThisInstrAddr(), NextInstrAddr(),
+    // ThisInstrITState(), NextInstrITState() represent the context the
+    // instruction was executed in. IE so the correct context is pushed to the
+    // stack.
+    auto [takeException, exception, excIsSecure] = _PendingExceptionDetails();
+    if (takeException) {
+      TRACE("TAKE EXC %d\n", exception);
+      // If a fault occurred during an exception return then the exception
+      // stack frame will already be on the stack, as a resut entry to the
+      // next exception is treated as if it were a tail chain.
+      int pePriority = _ExecutionPriority();
+      uint32_t peException = GETBITSM(_s.xpsr, XPSR__EXCEPTION);
+      bool peIsSecure = _IsSecure();
+      ExcInfo excInfo;
+      if (excRetFault) {
+        // If the fault occurred during ExceptionTaken() then LR will have been
+        // updated with the new exception return value. To excReturn consistent
+        // with the state of the exception stack frame we need to use the updated
+        // version in this case. If no updates have occurred then the excReturn
+        // value from the previous exception return is used.
+        uint32_t nextExcReturn = excInfo.inExcTaken ? _s.lr : excReturn;
+        excInfo = _TailChain(exception, excIsSecure, nextExcReturn);
+      } else
+        excInfo = _ExceptionEntry(exception, excIsSecure, instExecOk);
+      // Handle any derived faults that have occurred
+      if (excInfo.fault != NoFault)
+        _DerivedLateArrival(pePriority, peException, peIsSecure, excInfo, exception, excIsSecure);
     }
-  }
 
-  /* _SleepOnExit {{{4
-   * ------------
-   */
-  void _SleepOnExit() {
-    // Handling this is the responsibility of the code calling into the Simulator.
-    _s.exitCause |= EXIT_CAUSE__SLEEP_ON_EXIT;
+    // If the PC has moved away from the lockup address (eg because an NMI has
+    // been taken) leave the lockup state.
+    if (InternalLoad32(REG_DHCSR) & REG_DHCSR__S_LOCKUP && _NextInstrAddr() != 0xEFFF'FFFE)
+      InternalMask32(REG_DHCSR, REG_DHCSR__S_LOCKUP);
+
+    // Only advance the PC and ISTATE if not locked up.
+    if (!(InternalLoad32(REG_DHCSR) & REG_DHCSR__S_LOCKUP))
+      _CommitPCAndITSTATE();
   }
 
-  /* _WaitForInterrupt {{{4
-   * -----------------
+  /* _CommitPCAndITSTATE {{{4
+   * -------------------
+   * Commit PC and ITSTATE changes ready for the next instruction.
    */
-  void _WaitForInterrupt() {
-    // Handling this is the responsibility of the code calling into the Simulator.
-    _s.exitCause |= EXIT_CAUSE__WFI;
+  void _CommitPCAndITSTATE() {
+    _s.pc = _NextInstrAddr();
+    _s.pcChanged = false;
+    if (_HaveMainExt()) {
+      // XPSR only needs writing inside (or at the end of) an IT block.
+      uint8_t next = _NextInstrITState();
+      if (next != _s.itstate)
+        _PutITSTATE(next);
+      _s.itStateChanged = false;
+    }
   }
 
-  /* _WaitForEvent {{{4
+  /* _SetFlagsNZCV {{{4
    * -------------
+   * Record the APSR.NZCV produced by a flag-setting instruction without
+   * writing xpsr. See CpuState::lazyFlags.
    */
-  void _WaitForEvent() {
-    // Handling this is the responsibility of the code calling into the Simulator.
-    _s.exitCause |= EXIT_CAUSE__WFE;
+  void _SetFlagsNZCV(uint32_t result, bool carry, bool overflow) {
+    _s.lazyResult   = result;
+    _s.lazyCarry    = carry;
+    _s.lazyOverflow = overflow;
+    _s.lazyFlags    = XPSR__N | XPSR__Z | XPSR__C | XPSR__V;
   }
 
-  /* _IsIrqValid {{{4
-   * -----------
+  /* _SetFlagsNZC {{{4
+   * ------------
+   * As above, but APSR.V is unchanged.
    */
-  bool _IsIrqValid(int e) {
-    return e >= 16 && e <= _cfg.MaxExc();
+  void _SetFlagsNZC(uint32_t result, bool carry) {
+    _s.lazyResult = result;
+    _s.lazyCarry  = carry;
+    _s.lazyFlags |= XPSR__N | XPSR__Z | XPSR__C;
   }
 
-  /* _PopStack {{{4
-   * ---------
+  /* _SetFlagsNZ {{{4
+   * -----------
+   * As above, but APSR.C and APSR.V are unchanged.
    */
-  ExcInfo _PopStack(uint32_t excReturn) {
-    PEMode    mode      = (GETBITSM(excReturn, EXC_RETURN__MODE) ? PEMode_Thread : PEMode_Handler);
-    bool      toSecure  = _HaveSecurityExt() && GETBITSM(excReturn, EXC_RETURN__S);
-    RName     spName    = _LookUpSP_with_security_mode(toSecure, mode);
-    uint32_t  framePtr  = _GetSP(spName);
-    if (!_IsAligned(framePtr, 8)) {
-      // XXX(UNPREDICTABLE): This function can be called ultimately from _InstructionAdvance()
-      // so we do not want to throw here. Simply mask the bits, which is plausibly what a real
-      // CPU might do.
-      QUIET_UNPREDICTABLE("unaligned frame pointer on exception return (0x%x)\n", framePtr);
-      framePtr &= ~7;
-    }
-
-    uint32_t tmp;
-    ExcInfo exc = _DefaultExcInfo();
-    if (toSecure && (!GETBITSM(excReturn, EXC_RETURN__ES) || !GETBITSM(excReturn, EXC_RETURN__DCRS))) {
-      uint32_t expectedSig = 0xFEFA'125B;
-      if (_HaveFPExt())
-        expectedSig = CHGBITS(expectedSig, 0, 0, GETBITSM(excReturn, EXC_RETURN__FTYPE));
-      uint32_t integritySig;
-      std::tie(exc, integritySig) = _Stack(framePtr, 0, spName, mode);
-      if (exc.fault == NoFault && integritySig != expectedSig) {
-        if (_HaveMainExt())
-          InternalOr32(REG_SFSR, REG_SFSR__INVIS);
-        return _CreateException(SecureFault, true, true);
-      }
-
-      if (exc.fault == NoFault) { std::tie(exc, tmp) = _Stack(framePtr, 0x08, spName, mode); _SetR( 4, tmp); }
-      if (exc.fault == NoFault) { std::tie(exc, tmp) = _Stack(framePtr, 0x0C, spName, mode); _SetR( 5, tmp); }
-      if (exc.fault == NoFault) { std::tie(exc, tmp) = _Stack(framePtr, 0x10, spName, mode); _SetR( 6, tmp); }
-      if (exc.fault == NoFault) { std::tie(exc, tmp) = _Stack(framePtr, 0x14, spName, mode); _SetR( 7, tmp); }
-      if (exc.fault == NoFault) { std::tie(exc, tmp) = _Stack(framePtr, 0x18, spName, mode); _SetR( 8, tmp); }
-      if (exc.fault == NoFault) { std::tie(exc, tmp) = _Stack(framePtr, 0x1C, spName, mode); _SetR( 9, tmp); }
-      if (exc.fault == NoFault) { std::tie(exc, tmp) = _Stack(framePtr, 0x20, spName, mode); _SetR(10, tmp); }
-      if (exc.fault == NoFault) { std::tie(exc, tmp) = _Stack(framePtr, 0x24, spName, mode); _SetR(11, tmp); }
-      framePtr += 0x28;
-    }
-
-    uint32_t pc, psr;
-    if (exc.fault == NoFault) { std::tie(exc, tmp) = _Stack(framePtr, 0x00, spName, mode); _SetR( 0, tmp); }
-    if (exc.fault == NoFault) { std::tie(exc, tmp) = _Stack(framePtr, 0x04, spName, mode); _SetR( 1, tmp); }
-    if (exc.fault == NoFault) { std::tie(exc, tmp) = _Stack(framePtr, 0x08, spName, mode); _SetR( 2, tmp); }
-    if (exc.fault == NoFault) { std::tie(exc, tmp) = _Stack(framePtr, 0x0C, spName, mode); _SetR( 3, tmp); }
-    if (exc.fault == NoFault) { std::tie(exc, tmp) = _Stack(framePtr, 0x10, spName, mode); _SetR(12, tmp); }
-    if (exc.fault == NoFault) { std::tie(exc, tmp) = _Stack(framePtr, 0x14, spName, mode); _SetLR(tmp); }
-    if (exc.fault == NoFault) { std::tie(exc, pc ) = _Stack(framePtr, 0x18, spName, mode); }
-    if (exc.fault == NoFault) { std::tie(exc, psr) = _Stack(framePtr, 0x1C, spName, mode); }
-    _BranchToAndCommit(pc);
-
-    uint32_t excNo = GETBITSM(psr, XPSR__EXCEPTION);
-    if (exc.fault == NoFault && (mode == PEMode_Handler) == !excNo) {
-      if (_HaveMainExt())
-        InternalOr32(REG_CFSR, REG_CFSR__UFSR__INVPC);
-      return _CreateException(UsageFault, false, false/*UNKNOWN*/);
-    }
-
-    bool validIPSR = (excNo == 0 || excNo == 1 || excNo == NMI || excNo == HardFault || excNo == SVCall || excNo == PendSV || excNo == SysTick);
-    if (!validIPSR && _HaveMainExt())
-      validIPSR = (excNo == MemManage || excNo == BusFault || excNo == UsageFault || excNo == SecureFault || excNo == DebugMonitor);
+  void _SetFlagsNZ(uint32_t result) {
+    _s.lazyResult = result;
+    _s.lazyFlags |= XPSR__N | XPSR__Z;
+  }
 
-    if (!validIPSR && !_IsIrqValid(excNo))
-      psr = CHGBITSM(psr, XPSR__EXCEPTION, 0); // UNKNOWN
+  /* _SyncFlags {{{4
+   * ----------
+   * Fold any pending lazily-evaluated flags into xpsr. Must be called before
+   * anything reads or writes APSR.NZCV directly.
+   */
+  void _SyncFlags() {
+    if (!_s.lazyFlags)
+      return;
 
-    if (_HaveFPExt()) {
-      if (!GETBITSM(excReturn, EXC_RETURN__FTYPE)) {
-        if (!toSecure && (InternalLoad32(REG_FPCCR_S) & REG_FPCCR__LSPACT)) {
-          InternalOr32(REG_SFSR, REG_SFSR__LSERR);
-          ExcInfo newExc = _CreateException(SecureFault, true, true);
-          if (IMPL_DEF_DROP_PREV_GEN_EXC)
-            exc = newExc;
-          else
-            exc = _MergeExcInfo(exc, newExc);
-        } else {
-          bool lspAct = !!(toSecure ? InternalLoad32(REG_FPCCR_S) & REG_FPCCR__LSPACT : InternalLoad32(REG_FPCCR_NS) & REG_FPCCR__LSPACT);
-          if (lspAct) {
-            if (exc.fault == NoFault) {
-              if (toSecure)
-                InternalMask32(REG_FPCCR_S, REG_FPCCR__LSPACT);
-              else
-                InternalMask32(REG_FPCCR_NS, REG_FPCCR__LSPACT);
-            }
-          } else {
-            if (exc.fault == NoFault) {
-              bool nPriv  = toSecure ? GETBITSM(_s.controlS, CONTROL__NPRIV) : GETBITSM(_s.controlNS, CONTROL__NPRIV);
-              bool isPriv = (mode == PEMode_Handler || !nPriv);
-              exc = _CheckCPEnabled(10, isPriv, toSecure);
-            }
+    uint32_t v = (_s.lazyResult & XPSR__N)
+               | (_s.lazyResult ? 0 : XPSR__Z)
+               | (_s.lazyCarry ? XPSR__C : 0)
+               | (_s.lazyOverflow ? XPSR__V : 0);
+    _s.xpsr = (_s.xpsr & ~_s.lazyFlags) | (v & _s.lazyFlags);
+    _s.lazyFlags = 0;
+  }
 
-            if (exc.fault == NoFault) {
-              for (int i=0; i<16; ++i)
-                if (exc.fault == NoFault) {
-                  uint32_t offset = 0x20+(4*i);
-                  uint32_t tmp;
-                  std::tie(exc, tmp) = _Stack(framePtr, offset, spName, mode);
-                  _SetS(i, tmp);
-                }
-              if (exc.fault == NoFault) {
-                uint32_t tmp;
-                std::tie(exc, tmp) = _Stack(framePtr, 0x60, spName, mode);
-                _s.fpscr = tmp;
-              }
-              if (toSecure && (InternalLoad32(REG_FPCCR_S) & REG_FPCCR__TS)) {
-                for (int i=0; i<16; ++i)
-                  if (exc.fault == NoFault) {
-                    uint32_t offset = 0x68+(4*i);
-                    uint32_t tmp;
-                    std::tie(exc, tmp) = _Stack(framePtr, offset, spName, mode);
-                    _SetS(i+16, tmp);
-                  }
+  /* _CarryFlag {{{4
+   * ----------
+   * Current value of APSR.C, for use as a carry-in.
+   */
+  bool _CarryFlag() {
+    return (_s.lazyFlags & XPSR__C) ? _s.lazyCarry : GETBITSM(_s.xpsr, XPSR__C);
+  }
 
-                if (exc.fault != NoFault)
-                  for (int i=16; i<32; ++i)
-                    _SetS(i, _HaveSecurityExt() ? 0 : 0 /* UNKNOWN */);
-              }
-              if (exc.fault != NoFault) {
-                for (int i=0; i<16; ++i)
-                  _SetS(i, _HaveSecurityExt() ? 0 : 0 /* UNKNOWN */);
-                _s.fpscr = (_HaveSecurityExt() ? 0 : 0 /* UNKNOWN */);
-              }
-            }
-          }
-        }
-      }
+  /* _ConditionHolds {{{4
+   * ---------------
+   */
+  bool _ConditionHolds(uint32_t cond) {
+    _SyncFlags();
+    return GETBIT(_condTable[cond & 0xF], GETBITS(_s.xpsr, 28, 31));
+  }
 
-      auto &control = _IsSecure() ? _s.controlS : _s.controlNS;
-      control = CHGBITSM(control, CONTROL__FPCA, GETBITSM(excReturn, EXC_RETURN__FTYPE) ^ 1);
+  /* _ConditionHoldsNZCV {{{4
+   * -------------------
+   * _ConditionHolds for the given APSR.NZCV (bits 3:0 are N, Z, C and V
+   * respectively). Used to build _condTable.
+   */
+  static constexpr bool _ConditionHoldsNZCV(uint32_t cond, uint32_t nzcv) {
+    bool n = GETBIT(nzcv, 3), z = GETBIT(nzcv, 2), c = GETBIT(nzcv, 1), v = GETBIT(nzcv, 0);
+    bool result = false;
+    switch ((cond>>1) & 0b111) {
+      case 0b000: result = z; break;
+      case 0b001: result = c; break;
+      case 0b010: result = n; break;
+      case 0b011: result = v; break;
+      case 0b100: result = c && !z; break;
+      case 0b101: result = z == v; break;
+      case 0b110: result = z == v && !z; break;
+      case 0b111: result = true; break;
     }
 
-    if (exc.fault == NoFault)
-      _ConsumeExcStackFrame(excReturn, GETBITSM(psr, RETPSR__SPREALIGN));
-
-    if (_HaveDSPExt())
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__GE, GETBITSM(psr, XPSR__GE));
-
-    if (_IsSecure())
-      _s.controlS = CHGBITSM(_s.controlS, CONTROL__SFPA, GETBITSM(psr, RETPSR__SFPA));
-
-    _s.xpsr = CHGBITSM(_s.xpsr, XPSR__EXCEPTION, GETBITSM(psr, XPSR__EXCEPTION));
-    _s.xpsr = CHGBITSM(_s.xpsr, XPSR__T,         GETBITSM(psr, XPSR__T));
-    if (_HaveMainExt()) {
-      _s.xpsr = CHGBITS(_s.xpsr,27,31,GETBITS(psr,27,31));
-
-      uint32_t it = (GETBITSM(psr, XPSR__IT_ICI_LO)<<2) | GETBITSM(psr, XPSR__IT_ICI_HI);
-      _SetITSTATEAndCommit(it);
-    } else
-      _s.xpsr = CHGBITS(_s.xpsr,28,31,GETBITS(psr,28,31));
+    if ((cond & 1) && cond != 0b111)
+      result = !result;
 
-    return exc;
+    return result;
   }
 
-  /* _CheckCPEnabled {{{4
-   * ---------------
+  /* _MakeCondTable {{{4
+   * --------------
+   * Bit i of entry cond is set if cond holds when APSR.NZCV is i.
    */
-  ExcInfo _CheckCPEnabled(int cp) {
-    return _CheckCPEnabled(cp, _CurrentModeIsPrivileged(), _IsSecure());
+  static constexpr std::array<uint16_t,16> _MakeCondTable() {
+    std::array<uint16_t,16> t{};
+    for (uint32_t cond=0; cond<16; ++cond)
+      for (uint32_t nzcv=0; nzcv<16; ++nzcv)
+        if (_ConditionHoldsNZCV(cond, nzcv))
+          t[cond] |= 1U<<nzcv;
+    return t;
   }
 
-  ExcInfo _CheckCPEnabled(int cp, bool priv, bool secure) {
-    auto [enabled, toSecure] = _IsCPEnabled(cp, priv, secure);
-    ExcInfo excInfo;
-    if (!enabled) {
-      if (toSecure)
-        InternalOr32(REG_CFSR_S, REG_CFSR__UFSR__NOCP);
-      else
-        InternalOr32(REG_CFSR_NS, REG_CFSR__UFSR__NOCP);
-      excInfo = _CreateException(UsageFault, true, toSecure);
-    } else
-      excInfo = _DefaultExcInfo();
-    return excInfo;
-  }
+  static constexpr std::array<uint16_t,16> _condTable = _MakeCondTable();
 
-  /* _ValidateExceptionReturn {{{4
-   * ------------------------
+  /* _SetMonStep {{{4
+   * -----------
    */
-  std::tuple<ExcInfo, uint32_t> _ValidateExceptionReturn(uint32_t excReturn, int retExcNo) {
-    bool error = false;
-    assert(_CurrentMode() == PEMode_Handler);
+  void _SetMonStep(bool monStepActive) {
+    if (!monStepActive)
+      return;
 
-    // XXX: These are specified as UNPREDICTABLE. However, this function is
-    // ultimately called from _InstructionAdvance(), which does not execute in
-    // a context where UNPREDICTABLE can be suitably caught. Moreover given
-    // that this function is all about explicitly creating and returning ISA
-    // exceptions having it throw a (C++/psuedocode) exception seems odd.
-    // Most likely these bits are just ignored by actual CPUs. Ideally we
-    // would handle these as an error as we should be stricter than a real CPU
-    // if possible, but for now, treat them as no-ops.
-    if (GETBITS(excReturn, 7,23) != BITS(0,16) || GETBITS(excReturn, 1, 1)) {
-      TRACE("unpredictable exception return (0x%x)\n", excReturn);
-      //THROW_UNPREDICTABLE();
-    }
-    if (!_HaveFPExt() && !GETBITSM(excReturn, EXC_RETURN__FTYPE)) {
-      TRACE("unpredictable exception return (no FP)\n");
-      //THROW_UNPREDICTABLE();
-    }
+    if (!(InternalLoad32(REG_DEMCR) & REG_DEMCR__MON_STEP))
+      THROW_UNPREDICTABLE();
 
-    bool targetDomainSecure = !!GETBITSM(excReturn, EXC_RETURN__ES);
-    bool excStateNonSecure;
-    int excNo;
-    if (_HaveSecurityExt()) {
-      excStateNonSecure = (_s.curState == SecurityState_NonSecure || !targetDomainSecure);
-      if (excStateNonSecure && (!GETBITSM(excReturn, EXC_RETURN__DCRS) || targetDomainSecure)) {
-        if (_HaveMainExt())
-          InternalOr32(REG_SFSR, REG_SFSR__INVER);
+    if (_ExceptionPriority(DebugMonitor, _IsSecure(), true) < _ExecutionPriority()) {
+      InternalOr32(REG_DEMCR, REG_DEMCR__MON_PEND);
+      InternalOr32(REG_DFSR, REG_DFSR__HALTED);
+    }
+  }
 
-        if (excStateNonSecure && targetDomainSecure)
-          excReturn = CHGBITSM(excReturn, EXC_RETURN__ES, 0);
+  /* _ExceptionTargetsSecure {{{4
+   * -----------------------
+   */
+  bool _ExceptionTargetsSecure(int excNo, bool isSecure) {
+    if (!_HaveSecurityExt())
+      return false;
 
-        targetDomainSecure = false;
-        error = true;
-        excNo = SecureFault;
-      }
-    } else
-      excStateNonSecure = true;
+    bool targetSecure = false;
+    switch (excNo) {
+      case NMI:
+        targetSecure = !(InternalLoad32(REG_AIRCR) & REG_AIRCR__BFHFNMINS);
+        break;
+      case HardFault:
+        targetSecure = !(InternalLoad32(REG_AIRCR) & REG_AIRCR__BFHFNMINS) || isSecure;
+        break;
+      case MemManage:
+        targetSecure = isSecure;
+        break;
+      case BusFault:
+        targetSecure = !(InternalLoad32(REG_AIRCR) & REG_AIRCR__BFHFNMINS);
+        break;
+      case UsageFault:
+        targetSecure = isSecure;
+        break;
+      case SecureFault:
+        targetSecure = true;
+        break;
+      case SVCall:
+        targetSecure = isSecure;
+        break;
+      case DebugMonitor:
+        targetSecure = !!(InternalLoad32(REG_DEMCR) & REG_DEMCR__SDME);
+        break;
+      case PendSV:
+        targetSecure = isSecure;
+        break;
+      case SysTick:
+        if (_HaveSysTick() == 2) {
+          // XXX. The ISA manual does not give a definition here but suggests
+          // that targetSecure should equal whether the S or NS SysTick timer
+          // is raising. This is only applicable if we are in a context of handling
+          // an exception and this function is called from other places. However,
+          // it *should* never be called for SysTick if _HaveSysTick() == 2, because
+          // then !_IsExceptionTargetConfigurable(SysTick), and this function
+          // never be called when !_IsExceptionTargetConfigurable() for SysTick specifically
+          // unless we are actually handling an actually pending exception. In this circumstance,
+          // we will be called by _PendingExceptionDetailsActual() and isSecure will be
+          // equal to the correct value.
+          targetSecure = isSecure;
+        } else if (_HaveSysTick() == 1)
+          // SysTick target state is configurable
+          targetSecure = !(InternalLoad32(REG_ICSR_S) & REG_ICSR__STTNS);
+        break;
 
-    if (!error)
-      if (!_IsActiveForState(retExcNo, targetDomainSecure)) {
-        error = true;
-        if (_HaveMainExt()) {
-          InternalOr32(REG_CFSR, REG_CFSR__UFSR__INVPC);
-          excNo = UsageFault;
-        } else
-          excNo = HardFault;
-      }
+      default:
+        if (excNo >= 16)
+          targetSecure = !(InternalLoad32(REG_NVIC_ITNSn((excNo-16)/32)) & BIT((excNo-16)%32));
+        break;
+    }
 
-    ExcInfo excInfo;
-    if (error) {
-      _DeActivate(retExcNo, targetDomainSecure);
-      if (_HaveSecurityExt() && targetDomainSecure)
-        _s.controlS = CHGBITSM(_s.controlS, CONTROL__SPSEL, GETBITSM(excReturn, EXC_RETURN__SPSEL));
-      else
-        _s.controlNS = CHGBITSM(_s.controlNS, CONTROL__SPSEL, GETBITSM(excReturn, EXC_RETURN__SPSEL));
-      excInfo = _CreateException(excNo, false, false /*UNKNOWN*/);
-    } else
-      excInfo = _DefaultExcInfo();
+    return targetSecure;
+  }
 
-    return {excInfo, excReturn};
+  /* _IsCPInstruction {{{4
+   * ----------------
+   */
+  std::tuple<bool, int> _IsCPInstruction(uint32_t instr) {
+    bool isCp = false;
+    if ((instr & 0b11101111000000000000000000000000) == 0b11101110000000000000000000000000)
+      isCp = true;
+    if ((instr & 0b11101110000000000000000000000000) == 0b11101100000000000000000000000000)
+      isCp = true;
+    int cpNum = isCp ? GETBITS(instr, 8,11) : 0 /* UNKNOWN */;
+    if (cpNum == 11)
+      cpNum = 10;
+    return {isCp, cpNum};
   }
 
-  /* _ExceptionTaken {{{4
-   * ---------------
+  /* _DWT_InstructionMatch {{{4
+   * ---------------------
    */
-  ExcInfo _ExceptionTaken(int excNo, bool doTailChain, bool excIsSecure, bool ignStackFaults) {
-    assert(_HaveSecurityExt() || !excIsSecure);
+  void _DWT_InstructionMatch(uint32_t iaddr) {
+    bool triggerDebugEvent  = false;
+    bool debugEvent         = false;
 
-    ExcInfo exc = _DefaultExcInfo();
-    if (_HaveSecurityExt() && GETBIT(_GetLR(), 6)) {
-      if (excIsSecure) {
-        if (doTailChain && !GETBIT(_GetLR(), 0))
-          _SetLR(CHGBITS(_GetLR(), 5, 5, 0));
-      } else {
-        if (GETBIT(_GetLR(), 5) && !(doTailChain && !GETBIT(_GetLR(),0)))
-          exc = _PushCalleeStack(doTailChain);
-        _SetLR(CHGBITS(_GetLR(), 5, 5, 1));
+    if (!_HaveDWT() || _IsZero(InternalLoad32(REG_DWT_CTRL) & REG_DWT_CTRL__NUMCOMP))
+      // No comparator support.
+      return;
+
+    for (int i=0; i<GETBITSM(InternalLoad32(REG_DWT_CTRL), REG_DWT_CTRL__NUMCOMP); ++i) {
+      if (_IsDWTConfigUnpredictable(i)) {
+        // XXX(UNPREDICTABLE): We do not want to throw here, so we simply do not consider
+        // invalid configurations.
+        QUIET_UNPREDICTABLE("DWT comparator %u has unpredictable configuration\n", i);
+        continue;
       }
-    }
 
-    if (excIsSecure)
-      _SetLR(CHGBITS(CHGBITS(_GetLR(), 2, 2, GETBITSM(_s.controlS, CONTROL__SPSEL)), 0, 0, 1));
-    else
-      _SetLR(CHGBITS(CHGBITS(_GetLR(), 2, 2, GETBITSM(_s.controlNS, CONTROL__SPSEL)), 0, 0, 0));
+      bool instrAddrMatch = _DWT_InstructionAddressMatch(i, iaddr);
+      if (!instrAddrMatch)
+        continue;
 
-    uint32_t callerRegValue = (!_HaveSecurityExt() || excIsSecure) ? 0 /*UNKNOWN*/ : 0;
-    for (int n=0; n<4; ++n)
-      _SetR(n, callerRegValue);
-    _SetR(12, callerRegValue);
-    _s.xpsr = (callerRegValue & ~XPSR__EXCEPTION) | (_s.xpsr & XPSR__EXCEPTION);
+      // Instruction Address
+      if (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(i)), REG_DWT_FUNCTION__MATCH) == 0b0010) {
+        InternalOr32(REG_DWT_FUNCTION(i), REG_DWT_FUNCTION__MATCHED);
+        debugEvent = (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(i)), REG_DWT_FUNCTION__ACTION) == 0b01);
+      }
 
-    if (_HaveSecurityExt() && GETBIT(_GetLR(), 6)) {
-      if (excIsSecure) {
-        if (!GETBIT(_GetLR(),5))
-          for (int n=4; n<12; ++n)
-            _SetR(n, 0/*UNKNOWN*/);
-      } else
-        for (int n=4; n<12; ++n)
-          _SetR(n, 0);
-    }
+      // Instruction Address Limit
+      else if (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(i)), REG_DWT_FUNCTION__MATCH) == 0b0011) {
+        ASSERT(i > 0);
+        InternalOr32(REG_DWT_FUNCTION(i  ), REG_DWT_FUNCTION__MATCHED); // UNKNOWN
+        InternalOr32(REG_DWT_FUNCTION(i-1), REG_DWT_FUNCTION__MATCHED);
+        debugEvent = (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(i-1)), REG_DWT_FUNCTION__ACTION) == 0b01);
+      }
 
-    uint32_t start;
-    if (exc.fault == NoFault || ignStackFaults)
-      std::tie(exc, start) = _GetVector(excNo, excIsSecure);
+      triggerDebugEvent = triggerDebugEvent || debugEvent;
+    }
 
-    if (exc.fault == NoFault) {
-      _ActivateException(excNo, excIsSecure);
-      _SCS_UpdateStatusRegs();
-      _ClearExclusiveLocal(_ProcessorID());
-      _SetEventRegister();
-      _InstructionSynchronizationBarrier(0b1111);
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__T, start & 1);
-      _BranchTo(start & ~1);
-    } else
-      exc.inExcTaken = true;
+    if (triggerDebugEvent)
+      debugEvent = _SetDWTDebugEvent(_IsSecure());
 
-    return exc;
+    assert(false); // TODO
   }
 
-  /* _PushCalleeStack {{{4
-   * ----------------
+  /* _DWT_InstructionAddressMatch {{{4
+   * ----------------------------
    */
-  ExcInfo _PushCalleeStack(bool doTailChain) {
-    PEMode mode;
-    RName spName;
-    if (doTailChain) {
-      if (!GETBIT(_GetLR(), 3)) {
-        mode = PEMode_Handler;
-        spName = RNameSP_Main_Secure;
-      } else {
-        mode = PEMode_Thread;
-        spName = (GETBIT(_GetLR(), 2) ? RNameSP_Process_Secure : RNameSP_Main_Secure);
-      }
-    } else {
-      spName = _LookUpSP();
-      mode = _CurrentMode();
-    }
+  bool _DWT_InstructionAddressMatch(int N, uint32_t iaddr) {
+    ASSERT(N < GETBITSM(InternalLoad32(REG_DWT_CTRL), REG_DWT_CTRL__NUMCOMP) && _Align(iaddr, 2) == iaddr);
 
-    uint32_t framePtr = _GetSP(spName) - 0x28;
+    bool secureMatch = _IsSecure();
+    bool validMatch  = _DWT_ValidMatch(N, secureMatch);
+    bool validInstr  = ((GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__MATCH) & 0b1110) == 0b0010);
 
-    uint32_t integritySig = _HaveFPExt() ? CHGBITS(0xFEFA125A,0,0,GETBIT(_GetLR(),4)) : 0xFEFA125B;
-    ExcInfo exc = _Stack(framePtr, 0x00, spName, mode, integritySig);
+    if (!validMatch || !validInstr)
+      return false;
 
-    if (exc.fault == NoFault) exc = _Stack(framePtr, 0x08, spName, mode, _GetR( 4));
-    if (exc.fault == NoFault) exc = _Stack(framePtr, 0x0C, spName, mode, _GetR( 5));
-    if (exc.fault == NoFault) exc = _Stack(framePtr, 0x10, spName, mode, _GetR( 6));
-    if (exc.fault == NoFault) exc = _Stack(framePtr, 0x14, spName, mode, _GetR( 7));
-    if (exc.fault == NoFault) exc = _Stack(framePtr, 0x18, spName, mode, _GetR( 8));
-    if (exc.fault == NoFault) exc = _Stack(framePtr, 0x1C, spName, mode, _GetR( 9));
-    if (exc.fault == NoFault) exc = _Stack(framePtr, 0x20, spName, mode, _GetR(10));
-    if (exc.fault == NoFault) exc = _Stack(framePtr, 0x24, spName, mode, _GetR(11));
+    bool linkedToInstr;
+    if (N != GETBITSM(InternalLoad32(REG_DWT_CTRL), REG_DWT_CTRL__NUMCOMP)-1)
+      linkedToInstr = (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N+1)), REG_DWT_FUNCTION__MATCH) == 0b0011);
+    else
+      linkedToInstr = false;
 
-    ExcInfo spExc = _SetSP(spName, true, framePtr);
-    return _MergeExcInfo(exc, spExc);
-  }
+    bool linked;
+    if (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__MATCH) == 0b0011)
+      linked = true;
+    else
+      linked = false;
 
-  /* _SCS_UpdateStatusRegs {{{4
-   * ---------------------
-   */
-  void _SCS_UpdateStatusRegs() {
-    // TODO
-  }
+    bool matchAddr;
+    if (!linkedToInstr) {
+      auto [matchEQ, matchGT] = _DWT_AddressCompare(iaddr, InternalLoad32(REG_DWT_COMP(N)), 2, 2);
+      if (linked) {
+        validMatch = _DWT_ValidMatch(N-1, secureMatch);
+        auto [lowerEQ, lowerGT] = _DWT_AddressCompare(iaddr, InternalLoad32(REG_DWT_COMP(N-1)), 2, 2);
+        matchAddr = (validMatch && (lowerEQ || lowerGT) && !matchGT);
+      } else
+        matchAddr = matchEQ;
+    } else
+      matchAddr = false;
 
-  /* _ConstrainUnpredictableBool {{{4
-   * ---------------------------
-   */
-  bool _ConstrainUnpredictableBool(bool x) { return x; }
+    return matchAddr;
+  }
 
-  /* _ExceptionPriority {{{4
-   * ------------------
+  /* _IsCPEnabled {{{4
+   * ------------
    */
-  int _ExceptionPriority(int n, bool isSecure, bool groupPri) {
-    if (_HaveMainExt())
-      assert(n >= 1 && n <= 511);
-    else
-      assert(n >= 1 && n <= 48);
+  std::tuple<bool, bool> _IsCPEnabled(int cp, bool priv, bool secure) {
+    bool enabled, forceToSecure = false;
 
-    int result;
-    if (n == Reset)
-      result = -4;
-    else if (n == NMI)
-      result = -2;
-    else if (n == HardFault) {
-      if (isSecure && (InternalLoad32(REG_AIRCR) & REG_AIRCR__BFHFNMINS))
-        result = -3;
-      else
-        result = -1;
-    } else if (_HaveMainExt() && n == MemManage)
-      result = isSecure ? GETBITSM(InternalLoad32(REG_SHPR1_S), REG_SHPR1__PRI_4) : GETBITSM(InternalLoad32(REG_SHPR1_NS), REG_SHPR1__PRI_4);
-    else if (_HaveMainExt() && n == BusFault)
-      result = GETBITSM(InternalLoad32(REG_SHPR1_S), REG_SHPR1__PRI_5);
-    else if (_HaveMainExt() && n == UsageFault)
-      result = isSecure ? GETBITSM(InternalLoad32(REG_SHPR1_S), REG_SHPR1__PRI_6) : GETBITSM(InternalLoad32(REG_SHPR1_NS), REG_SHPR1__PRI_6);
-    else if (_HaveMainExt() && n == SecureFault)
-      result = GETBITSM(InternalLoad32(REG_SHPR1_S), REG_SHPR1__PRI_7);
-    else if (n == SVCall)
-      result = isSecure ? GETBITSM(InternalLoad32(REG_SHPR2_S), REG_SHPR2__PRI_11) : GETBITSM(InternalLoad32(REG_SHPR2_NS), REG_SHPR2__PRI_11);
-    else if (_HaveMainExt() && n == DebugMonitor)
-      result = GETBITSM(InternalLoad32(REG_SHPR3_S), REG_SHPR3__PRI_12);
-    else if (n == PendSV)
-      result = isSecure ? GETBITSM(InternalLoad32(REG_SHPR3_S), REG_SHPR3__PRI_14) : GETBITSM(InternalLoad32(REG_SHPR3_NS), REG_SHPR3__PRI_14);
-    else if (   n == SysTick
-             && (   (_HaveSysTick() == 2)
-                 || (_HaveSysTick() == 1 && (!(InternalLoad32(REG_ICSR_S) & REG_ICSR__STTNS)) == isSecure)))
-      result = isSecure ? GETBITSM(InternalLoad32(REG_SHPR3_S), REG_SHPR3__PRI_15) : GETBITSM(InternalLoad32(REG_SHPR3_NS), REG_SHPR3__PRI_15);
-    else if (n >= 16) {
-      int r = (n-16)/4;
-      int v = n%4;
-      result = GETBITS(InternalLoad32(_IsSecure() ? REG_NVIC_IPRn_S(r) : REG_NVIC_IPRn_NS(r)), v*8, v*8+7);
-    } else
-      result = 256;
+    uint32_t cpacr = secure ? InternalLoad32(REG_CPACR_S) : InternalLoad32(REG_CPACR_NS);
+    switch (GETBITS(cpacr,cp*2,cp*2+1)) {
+      case 0b00:
+        enabled = false;
+        break;
+      case 0b01:
+        enabled = priv;
+        break;
+      case 0b10:
+        // XXX(UNPREDICTABLE): We do not want to throw here, so simply treat this as
+        // disabled.
+        enabled = false;
+        QUIET_UNPREDICTABLE("invalid CP enable value for CP %u\n", cp);
+        break;
+      case 0b11:
+        enabled = true;
+        break;
+    }
 
-    if (result >= 0) {
-      if (_HaveMainExt() && groupPri) {
-        int subGroupShift;
-        if (isSecure)
-          subGroupShift = GETBITSM(InternalLoad32(REG_AIRCR_S), REG_AIRCR__PRIGROUP);
-        else
-          subGroupShift = GETBITSM(InternalLoad32(REG_AIRCR_NS), REG_AIRCR__PRIGROUP);
-        int groupValue    = 2<<subGroupShift;
-        int subGroupValue = result % groupValue;
-        result = result - subGroupValue;
+    if (enabled && _HaveSecurityExt()) {
+      if (!secure && !(InternalLoad32(REG_NSACR) & BIT(cp))) {
+        enabled = false;
+        forceToSecure = true;
       }
+    }
 
-      int priSNsPri = _RestrictedNSPri();
-      if ((InternalLoad32(REG_AIRCR_S) & REG_AIRCR__PRIS) && !isSecure)
-        result = (result>>1) + priSNsPri;
+    if (enabled && !!(InternalLoad32(REG_CPPWR) & BIT(cp*2))) {
+      enabled = false;
+      forceToSecure = !!(InternalLoad32(REG_CPPWR) & BIT(cp*2+1));
     }
 
-    return result;
+    return {enabled, secure || forceToSecure};
   }
 
-  /* _TopLevel {{{4
-   * ---------
-   * Called once for each tick the PE is not in a sleep state. Handles all
-   * instruction processing, including fetching the opcode, decode and execute.
-   * It also handles pausing execution when in the lockup state.
+  /* _GetMemI {{{4
+   * --------
+   * ctx is _BlockContext(), used to look up cached attributes.
    */
-  void _TopLevel() {
-    // Implementation-specific: Set exit cause value
-    _s.exitCause = 0;
+  uint16_t _GetMemI(uint32_t addr, uint32_t ctx) {
+    uint16_t          value;
+    ExcInfo           excInfo;
+    AddressDescriptor memAddrDesc;
+    if (const FetchAttrs *fa = _LookUpFetchAttrs(addr, ctx)) {
+      if (fa->host) {
+        memcpy(&value, fa->host + (addr & BITS(0,4)), 2);
+        if (_IsDWTEnabled())
+          _DWT_InstructionMatch(addr);
+        return value;
+      }
 
-    // If the PE has locked up then abort execution of this instruction. Set
-    // the length of the current instruction to 0 so NextInstrAddr() reports
-    // the correct lockup address.
-    bool ok = !GETBITSM(InternalLoad32(REG_DHCSR), REG_DHCSR__S_LOCKUP);
-    if (!ok) {
-      TRACE("locked up\n");
-      _SetThisInstrDetails(0, 0, 0b1111);
+      excInfo               = _DefaultExcInfo();
+      memAddrDesc           = fa->desc;
+      memAddrDesc.physAddr  = addr;
     } else {
-      ASSERT(!_s.pcChanged);
+      std::tie(excInfo, memAddrDesc) = _ValidateAddress(addr, AccType_IFETCH, _FindPriv(), _IsSecure(), false, true);
+      if (excInfo.fault == NoFault)
+        _FillFetchAttrs(addr, ctx, memAddrDesc);
+    }
 
-      // Check for stepping debug for current insn fetch.
-      bool monStepActive = _SteppingDebug();
-      _UpdateSecureDebugEnable();
-      uint32_t pc = _ThisInstrAddr();
+    if (excInfo.fault == NoFault) {
+      bool error;
+      std::tie(error, value) = _GetMem(memAddrDesc, 2);
+      if (error) {
+        value = UINT16_MAX; // UNKNOWN
+        InternalOr32(REG_CFSR, REG_CFSR__BFSR__IBUSERR);
+        excInfo = _CreateException(BusFault, false, false/*UNKNOWN*/);
+        TRACE("fetch failed\n");
+      }
+    } else TRACE("fetch addr validate failed 0x%x\n", addr);
 
-      uint32_t instr;
-      bool is16bit;
-      try {
-        // Not locked up, so attempt to fetch the instruction.
-        std::tie(instr, is16bit) = _FetchInstr(pc);
-        //TRACE("fetched %d-bit insn: 0x%08x\n", is16bit ? 16 : 32, instr);
+    _HandleException(excInfo);
+    if (_IsDWTEnabled())
+      _DWT_InstructionMatch(addr);
+    return value;
+  }
 
-        // Setup the details of the instruction. NOTE: The default condition
-        // is based on the ITSTATE, however this is overridden in the decode
-        // stage by instructions that have explicit condition codes.
-        uint32_t len = is16bit ? 2 : 4;
+  /* _ExecutionPriority {{{4
+   * ------------------
+   * XXX: This has been augmented relative to the ISA manual psuedocode to add
+   * an argument `ignorePrimask`, to assist in the implementation of WFI.
+   */
+  int _ExecutionPriority(bool ignorePrimask=false) {
+    int boostedPri = _HighestPri();
 
-        // XXX: This is exactly as described in the pseudocode. However prose
-        // states that if bits [0:3] are zero but bits [4:7] are not, behaviour
-        // is UNPREDICTABLE. We should consider throwing UNPREDICTABLE in this
-        // case.
-        uint32_t defaultCond = !GETBITS(_GetITSTATE(),0,3) ? 0b1110 : GETBITS(_GetITSTATE(),4,7);
-        _SetThisInstrDetails(instr, len, defaultCond);
+    int priSNsPri = _RestrictedNSPri();
+    if (_HaveMainExt()) {
+      if (GETBITS(_s.basepriNS, 0, 7)) {
+        uint32_t basepri        = GETBITS(_s.basepriNS, 0, 7);
+        uint32_t subGroupShift  = GETBITSM(InternalLoad32(REG_AIRCR_NS), REG_AIRCR__PRIGROUP);
+        uint32_t groupValue     = 2U<<subGroupShift;
+        uint32_t subGroupValue  = basepri % groupValue;
+        boostedPri              = basepri - subGroupValue;
+        if (InternalLoad32(REG_AIRCR_S) & REG_AIRCR__PRIS)
+          boostedPri = (boostedPri>>1) + priSNsPri;
+      }
 
-        // Checking for FPB Breakpoint on instructions
-        if (_HaveFPB() && _FPB_CheckBreakPoint(pc, len, true, _IsSecure()))
-          _FPB_BreakpointMatch();
+      if (GETBITS(_s.basepriS, 0, 7)) {
+        uint32_t basepri        = GETBITS(_s.basepriS, 0, 7);
+        uint32_t subGroupShift  = GETBITSM(InternalLoad32(REG_AIRCR_S), REG_AIRCR__PRIGROUP);
+        uint32_t groupValue     = 2U<<subGroupShift;
+        uint32_t subGroupValue  = basepri % groupValue;
+        basepri                 = basepri - subGroupValue;
+        if (boostedPri > basepri)
+          boostedPri = basepri;
+      }
+    }
 
-        // Finally try and execute the instruction.
-        _DecodeExecute(instr, pc, is16bit);
+    if (!ignorePrimask) {
+      if (_s.primaskNS & 1) {
+        if (!(InternalLoad32(REG_AIRCR_S) & REG_AIRCR__PRIS))
+          boostedPri = 0;
+        else if (boostedPri > priSNsPri)
+          boostedPri = priSNsPri;
+      }
 
-        // Check for Monitor Step
-        if (_HaveDebugMonitor())
-          _SetMonStep(monStepActive);
+      if (_s.primaskS & 1)
+        boostedPri = 0;
+    }
 
-        // Check for DWT match
-        if (_IsDWTEnabled())
-          _DWT_InstructionMatch(pc);
-
-      } catch (Exception e) {
-        // XXX: The psuedocode defines this as _IsSEE(e) || _IsUNDEFINED(e).
-        // Moreover, the comment below suggests that UNPREDICTABLE should not
-        // be caught here. However this seems to contradict the definition of
-        // UNPREDICTABLE in the glossary which states that a) UNPREDICTABLE
-        // must not do anything which could not be done with a sequence of
-        // non-UNPREDICTABLE instructions and b) UNPREDICTABLE can be
-        // implemented as UNDEFINED. For now, we disregard the comment below
-        // about not handling UNPREDICTABLE and treat all UNPREDICTABLE events
-        // as UNDEFINED.
-        if (_IsSEE(e) || _IsUNDEFINED(e) || _IsUNPREDICTABLE(e)) {
-          TRACE("top-level SEE/UD exception\n");
-          // Unallocated instructions in the NOP hint space and instructions that
-          // fail their condition tests are treated like NOPs.
-          bool nopHint =
-               (instr & 0b11111111111111111111111100001111U) == 0b00000000000000001011111100000000U
-            || (instr & 0b11111111111111111111111100000000U) == 0b11110011101011111000000000000000U;
-          if (_ConditionHolds(_CurrentCond()) && !nopHint) {
-            ok = false;
-            bool toSecure = _IsSecure();
-            // Unallocated instructions in the coprocessor space behave as NOCP if the
-            // coprocessor is disabled.
-            auto [isCp, cpNum] = _IsCPInstruction(instr);
-            if (isCp) {
-              auto [cpEnabled, cpFaultState] = _IsCPEnabled(cpNum);
-              if (!cpEnabled) {
-                // A PE is permitted to decode the coprocessor space and raise
-                // UNDEFINSTR UsageFaults for unallocated encodings even if the
-                // coprocessor is disabled.
-                if (IMPL_DEF_DECODE_CP_SPACE)
-                  InternalOr32(REG_CFSR, REG_CFSR__UFSR__UNDEFINSTR);
-                else {
-                  InternalOr32(REG_CFSR, REG_CFSR__UFSR__NOCP);
-                  toSecure = cpFaultState;
-                }
-              }
-            } else
-              InternalOr32(REG_CFSR, REG_CFSR__UFSR__UNDEFINSTR);
+    if (_HaveMainExt()) {
+      if (_s.faultmaskNS & 1) {
+        if (!(InternalLoad32(REG_AIRCR) & REG_AIRCR__BFHFNMINS)) {
+          if (!(InternalLoad32(REG_AIRCR_S) & REG_AIRCR__PRIS))
+            boostedPri = 0;
+          else if (boostedPri > priSNsPri)
+            boostedPri = priSNsPri;
+        } else
+          boostedPri = -1;
+      }
+
+      if (_s.faultmaskS & 1)
+        boostedPri = !(InternalLoad32(REG_AIRCR) & REG_AIRCR__BFHFNMINS) ? -1 : -3;
+    }
+
+    int rawExecPri = _RawExecutionPriority();
+    return boostedPri < rawExecPri ? boostedPri : rawExecPri;
+  }
+
+  /* _SecurityCheck {{{4
+   * --------------
+   */
+  SAttributes _SecurityCheck(uint32_t addr, bool isInstrFetch, bool isSecure) {
+    SAttributes result = {};
+
+    bool idauExempt = false;
+    bool idauNs = true;
+    bool idauNsc = true;
 
-            // If Main Extension is not implemented the fault will escalate to a HardFault.
-            ExcInfo excInfo = _CreateException(UsageFault, true, toSecure);
+    if (IMPL_DEF_IDAU_PRESENT)
+      std::tie(idauExempt, idauNs, idauNsc, result.iregion, result.irvalid) = _IDAUCheck(addr & ~BITS(0,4));
 
-            // Prevent EndOfInstruction() being called in HandleInstruction() as the
-            // instruction has already been terminated so there is no need to throw
-            // the exception again.
-            excInfo.termInst = false;
-            _HandleException(excInfo);
+    if (isInstrFetch && GETBITS(addr,28,31) == 0b1111) {
+      // Use default attributes defined above.
+    } else if (   idauExempt
+               || (isInstrFetch && GETBITS(addr,28,31) == 0b1110)
+               || (addr >= 0xE000'0000 && addr <= 0xE000'2FFF)
+               || (addr >= 0xE000'E000 && addr <= 0xE000'EFFF)
+               || (addr >= 0xE002'E000 && addr <= 0xE002'EFFF)
+               || (addr >= 0xE004'0000 && addr <= 0xE004'1FFF)
+               || (addr >= 0xE00F'F000 && addr <= 0xE00F'FFFF)) {
+      result.ns       = !isSecure;
+      result.irvalid  = false;
+    } else {
+      if (InternalLoad32(REG_SAU_CTRL) & REG_SAU_CTRL__ENABLE) {
+        bool multiRegionHit = false;
+        uint32_t numRegion = GETBITSM(InternalLoad32(REG_SAU_TYPE), REG_SAU_TYPE__SREGION);
+        for (int r=0; r<numRegion; ++r) {
+          auto [rbar,rlar] = _InternalLoadSauRegion(r);
+          if (rlar & REG_SAU_RLAR__ENABLE) {
+            uint32_t baseAddr   = (GETBITSM(rbar, REG_SAU_RBAR__BADDR) << 5) | 0b00000;
+            uint32_t limitAddr  = (GETBITSM(rlar, REG_SAU_RLAR__LADDR) << 5) | 0b11111;
+            if (baseAddr <= addr && limitAddr >= addr) {
+              if (result.srvalid)
+                multiRegionHit = true;
+              else {
+                result.ns       =  !(rlar & REG_SAU_RLAR__NSC);
+                result.nsc      = !!(rlar & REG_SAU_RLAR__NSC);
+                result.srvalid  = true;
+                result.sregion  = r & 0xFF;
+              }
+            }
           }
-        } else if (_IsExceptionTaken(e)) { // XXX guessing this is EndOfInstruction
-          TRACE("top-level EOI exception\n");
-          ok = false;
-        } else
-          // Do not catch UNPREDICTABLE or internal errors
-          throw;
+        }
+        if (multiRegionHit) {
+          result.ns       = false;
+          result.nsc      = false;
+          result.sregion  = 0;
+          result.srvalid  = false;
+        }
+      } else if (InternalLoad32(REG_SAU_CTRL) & REG_SAU_CTRL__ALLNS)
+        result.ns = true;
+
+      if (!idauNs) {
+        if (result.ns || (!idauNsc && result.nsc)) {
+          result.ns   = false;
+          result.nsc  = idauNsc;
+        }
       }
     }
 
-    // SEE
-    // UNDEFINED
-    // Taken
-    // UNPREDICTABLE
-    // internal
+    return result;
+  }
 
-    // If there is a reset pending do that, otherwise process the normal
-    // instruction advance.
-    try {
-      if (_s.excPending[Reset]) {
-        TRACE("top-level handling pending reset\n");
-        _s.excPending[Reset] = 0;
-        _TakeReset();
-        TRACE("top-level done handling pending reset\n");
-      } else {
-        // Call instruction advance for exception handling and PC/ITSTATE
-        // advance.
-        _InstructionAdvance(ok);
-      }
+  /* _IDAUCheck {{{4
+   * ----------
+   */
+  std::tuple<bool, bool, bool, uint8_t, bool> _IDAUCheck(uint32_t addr) {
+    return _dev.IDAUCheck(addr);
+  }
 
-    } catch (Exception e) {
-      TRACE("top-level reset/advance exception\n");
+  /* _LowestSetBit {{{4
+   * -------------
+   */
+  static int _LowestSetBit(uint32_t x) {
+    ASSERT(x);
+    return CTZL(x);
+  }
 
-      // Do not catch UNPREDICTABLE or internal errors
-      if (!_IsExceptionTaken(e))
-        throw;
+  /* _DecodeRegShift {{{4
+   * ---------------
+   */
+  SRType _DecodeRegShift(uint32_t srType) {
+    switch (srType) {
+      case 0b00: return SRType_LSL;
+      case 0b01: return SRType_LSR;
+      case 0b10: return SRType_ASR;
+      case 0b11: return SRType_ROR;
+      default: UNREACHABLE();
+    }
+  }
 
-      // The correct architectural behaviour for any exceptions is performed
-      // inside TakeReset() and InstructionAdvance(). So no additional actions
-      // are required in this catch block.
+  /* _BKPTInstrDebugEvent {{{4
+   * --------------------
+   */
+  void _BKPTInstrDebugEvent() {
+    if (!_GenerateDebugEventResponse()) {
+      auto excInfo = _CreateException(HardFault, false, UNKNOWN_VAL(false));
+      _HandleException(excInfo);
     }
   }
 
-  /* _EndOfInstruction {{{4
-   * -----------------
+  /* _Hint_Yield {{{4
+   * -----------
+   * Performs a Yield hint.
    */
-  void _EndOfInstruction() {
-    throw Exception(ExceptionType::EndOfInstruction);
+  void _Hint_Yield() {
+    // TODO
+    _s.exitCause |= EXIT_CAUSE__YIELD;
   }
 
-  /* _CreateException {{{4
-   * ----------------
+  /* _Hint_Debug {{{4
+   * -----------
+   * Generate a hint to the debug system.
    */
-  ExcInfo _CreateException(int exc, bool forceSecurity, bool isSecure, bool isSync=true) {
-    // Work out the effective target state of the exception.
-    if (_HaveSecurityExt()) {
-      if (!forceSecurity)
-        isSecure = _ExceptionTargetsSecure(exc, _IsSecure());
-      else
-        isSecure = false;
-    }
-
-    // An implementation without Security Extensions cannot cause a fault targeting
-    // Secure state.
-    assert(_HaveSecurityExt() || !isSecure);
-
-    // Get the remaining exception details.
-    auto [escalateToHf, termInst] = _ExceptionDetails(exc, isSecure, isSync);
-
-    // Fill in the default exception info.
-    ExcInfo info            = _DefaultExcInfo();
-    info.fault              = exc;
-    info.termInst           = termInst;
-    info.origFault          = exc;
-    info.origFaultIsSecure  = isSecure;
-
-    // Check for HardFault escalation.
-    // NOTE: In some cases (for example faults during lazy floating-point state
-    // preservation) the decision to escalate below is ignored and instead
-    // based on the info.origFaults fields and other factors.
-    if (escalateToHf && info.fault != HardFault) {
-      // Update the exception info with the escalation details, including
-      // whether there's a change in destination Security state.
-      info.fault    = HardFault;
-      isSecure      = _ExceptionTargetsSecure(HardFault, isSecure);
-      bool dummy;
-      std::tie(escalateToHf, dummy) = _ExceptionDetails(HardFault, isSecure, isSync);
-    }
-
-    // If the requested exception was already a HardFault then we can't
-    // escalate to a HardFault, so lockup. NOTE: Async BusFaults never cause
-    // lockups, if the BusFault is disabled it escalates to a HardFault that is
-    // pended.
-    if (escalateToHf && isSync && info.fault == HardFault)
-      info.lockup = true;
-
-    // Fill in the remaining exception info.
-    info.isSecure = isSecure;
-    return info;
+  void _Hint_Debug(uint32_t option) {
+    // TODO
+    _s.exitCause |= EXIT_CAUSE__DBG;
   }
 
-  /* _UpdateSecureDebugEnable {{{4
-   * ------------------------
+  /* _Hint_PreloadData {{{4
+   * -----------------
+   * Performs a preload data hint.
    */
-  void _UpdateSecureDebugEnable() {
-    /// DHCSR.S_SDE is frozen if the PE is in Debug state
-    uint32_t dhcsr = InternalLoad32(REG_DHCSR);
-    if (!GETBITSM(dhcsr, REG_DHCSR__S_HALT)) {
-      dhcsr = CHGBITSM(dhcsr, REG_DHCSR__S_SDE, _SecureHaltingDebugAllowed());
-      InternalStore32(REG_DHCSR, dhcsr);
-    }
+  void _Hint_PreloadData(uint32_t addr) {
+    // TODO
+  }
 
-    uint32_t demcr = InternalLoad32(REG_DEMCR);
-    if (_HaveDebugMonitor() && !_s.excActive[DebugMonitor] && !GETBITSM(demcr, REG_DEMCR__MON_PEND)) {
-      demcr = CHGBITSM(demcr, REG_DEMCR__SDME, _SecureDebugMonitorAllowed());
-      InternalStore32(REG_DEMCR, demcr);
-    }
+  /* _Hint_PreloadDataForWrite {{{4
+   * -------------------------
+   * Performs a preload data hint for write.
+   */
+  void _Hint_PreloadDataForWrite(uint32_t addr) {
+    // TODO
   }
 
-  /* _ColdReset {{{4
-   * ----------
-   * Does not correspond to any function in the ISA manual psuedocode; implements a cold
-   * reset as described in the manual. A cold reset is a superset of a warm reset.
+  /* _Hint_PreloadInstr {{{4
+   * ------------------
+   * Performs a preload instruction hint.
    */
-  void _ColdReset() {
+  void _Hint_PreloadInstr(uint32_t addr) {
     // TODO
-    _TakeReset();
   }
 
-  /* _TakeReset {{{4
-   * ----------
-   * This implements a warm reset.
+  /* _CallSupervisor {{{4
+   * ---------------
    */
-  void _TakeReset() {
-    _s.curState = _HaveSecurityExt() ? SecurityState_Secure : SecurityState_NonSecure;
+  void _CallSupervisor() {
+    auto excInfo = _CreateException(SVCall, false, UNKNOWN_VAL(false));
+    _HandleException(excInfo);
+  }
 
-    _ResetSCSRegs(); // Catch-all function for System Control Space reset
-    _s.xpsr = 0; // APSR is UNKNOWN UNPREDICTABLE, IPSR exception number is 0
-    if (_HaveMainExt()) {
-      _s.lr = 0xFFFF'FFFF;      // Preset to an illegal exception return value
-      _SetITSTATEAndCommit(0);  // IT/ICI bits cleared
-    } else
-      _s.lr = 0xFFFF'FFFF;      // UNKNOWN
+  /* _TTResp {{{4
+   * -------
+   */
+  uint32_t _TTResp(uint32_t addr, bool alt, bool forceUnpriv) {
+    uint32_t resp = 0;
 
-    // Reset priority boosting
-    _s.primaskNS &= ~1;
-    if (_HaveSecurityExt())
-      _s.primaskS &= ~1;
-    if (_HaveMainExt()) {
-      _s.faultmaskNS &= ~1;
-      _s.basepriNS = CHGBITS(_s.basepriNS,0,7,0);
-      if (_HaveSecurityExt()) {
-        _s.faultmaskS &= ~1;
-        _s.basepriS = CHGBITS(_s.basepriS,0,7,0);
+    // Only allow security checks if currently in Secure state.
+    bool addrSecure;
+    if (_IsSecure()) {
+      auto sAttributes = _SecurityCheck(addr, false, _IsSecure());
+      if (sAttributes.srvalid) {
+        resp = CHGBITSM(resp, TT_RESP__SREGION, sAttributes.sregion);
+        resp = CHGBITSM(resp, TT_RESP__SRVALID, 1);
+      }
+      if (sAttributes.irvalid) {
+        resp = CHGBITSM(resp, TT_RESP__IREGION, sAttributes.iregion);
+        resp = CHGBITSM(resp, TT_RESP__IRVALID, 1);
       }
+
+      addrSecure = sAttributes.ns ? 0 : 1;
+      resp = CHGBITSM(resp, TT_RESP__S, addrSecure);
     }
 
-    // Initialize the Floating Point Extn
-    if (_HaveFPExt()) {
-      _s.controlS = CHGBITSM(_s.controlS, CONTROL__FPCA, 0); // FP inactive
-      uint32_t fpdscrNS = InternalLoad32(REG_FPDSCR_NS);
-      fpdscrNS = CHGBITSM(fpdscrNS, REG_FPDSCR__AHP,    0);
-      fpdscrNS = CHGBITSM(fpdscrNS, REG_FPDSCR__DN,     0);
-      fpdscrNS = CHGBITSM(fpdscrNS, REG_FPDSCR__FZ,     0);
-      fpdscrNS = CHGBITSM(fpdscrNS, REG_FPDSCR__RMODE,  0);
-      InternalStore32(REG_FPDSCR_NS, fpdscrNS);
-      uint32_t fpccr = InternalLoad32(REG_FPCCR_S);
-      fpccr = CHGBITSM(fpccr, REG_FPCCR__LSPEN, 1);
-      InternalStore32(REG_FPCCR_S, fpccr);
-      uint32_t fpccrNS = InternalLoad32(REG_FPCCR_NS);
-      fpccrNS = CHGBITSM(fpccrNS, REG_FPCCR__ASPEN, 1);
-      fpccrNS = CHGBITSM(fpccrNS, REG_FPCCR__LSPACT, 0);
-      InternalStore32(REG_FPCCR_NS, fpccrNS);
-      InternalStore32(REG_FPCAR_NS, 0); // UNKNOWN
-      if (_HaveSecurityExt()) {
-        _s.controlS = CHGBITSM(_s.controlS, CONTROL__SFPA, 0);
-        uint32_t fpdscrS = InternalLoad32(REG_FPDSCR_S);
-        fpdscrS = CHGBITSM(fpdscrS, REG_FPDSCR__AHP, 0);
-        fpdscrS = CHGBITSM(fpdscrS, REG_FPDSCR__DN, 0);
-        fpdscrS = CHGBITSM(fpdscrS, REG_FPDSCR__FZ, 0);
-        fpdscrS = CHGBITSM(fpdscrS, REG_FPDSCR__RMODE, 0);
-        InternalStore32(REG_FPDSCR_S, fpdscrS);
-        uint32_t fpccr = InternalLoad32(REG_FPCCR_S);
-        fpccr = CHGBITSM(fpccr, REG_FPCCR__LSPENS, 0);
-        InternalStore32(REG_FPCCR_S, fpccr);
-        uint32_t fpccrS = InternalLoad32(REG_FPCCR_S);
-        fpccrS = CHGBITSM(fpccrS, REG_FPCCR__ASPEN, 1);
-        fpccrS = CHGBITSM(fpccrS, REG_FPCCR__LSPACT, 0);
-        InternalStore32(REG_FPCCR_S, fpccrS);
-        InternalStore32(REG_FPCAR_S, 0); // UNKNOWN
+    // MPU region information only available when privileged or when
+    // inspecting the other MPU state.
+    bool otherDomain = (alt != _IsSecure());
+    if (_CurrentModeIsPrivileged() || alt) {
+      auto [write, read, region, hit] = _IsAccessible(addr, forceUnpriv, otherDomain);
+      if (hit) {
+        resp = CHGBITSM(resp, TT_RESP__MREGION, region);
+        resp = CHGBITSM(resp, TT_RESP__MRVALID, 1);
+      }
+      resp = CHGBITSM(resp, TT_RESP__R,  read);
+      resp = CHGBITSM(resp, TT_RESP__RW, write);
+      if (_IsSecure()) {
+        resp = CHGBITSM(resp, TT_RESP__NSR,  (read && !addrSecure));
+        resp = CHGBITSM(resp, TT_RESP__NSRW, (write && !addrSecure));
       }
-      for (int i=0; i<32; ++i)
-        _SetS(i, 0); // UNKNOWN
     }
 
-    for (int i=0; i<_MaxExceptionNum(); ++i) // All exceptions Inactive
-      _s.excActive[i] = 0;
-    _ClearExclusiveLocal(_ProcessorID());
-    _ClearEventRegister();
-    for (int i=0; i<13; ++i)
-      _s.r[i] = 0; // UNKNOWN
+    return resp;
+  }
+
+  /* _IsAccessible {{{4
+   * -------------
+   */
+  std::tuple<bool, bool, uint8_t, bool> _IsAccessible(uint32_t addr, bool forceUnpriv, bool isSecure) {
+    bool write, read;
+
+    // Work out which privilege level the current mode in the Non-secure state
+    // is subject to.
+    bool isPrivileged;
+    if (forceUnpriv)
+      isPrivileged = false;
+    else
+      isPrivileged = (_CurrentMode() == PEMode_Handler
+        || (isSecure ? !GETBITSM(_s.controlS,  CONTROL__NPRIV)
+                     : !GETBITSM(_s.controlNS, CONTROL__NPRIV)));
+
+    auto [_, perms] = _MPUCheck(addr, AccType_NORMAL, isPrivileged, isSecure);
+    if (!perms.apValid) {
+      write = false;
+      read  = false;
+    } else
+      switch (perms.ap) {
+        case 0b00:
+          if (isPrivileged) write = true,  read = true;
+          else              write = false, read = false;
+          break;
+        case 0b01:
+          write = true, read = true;
+          break;
+        case 0b10:
+          if (isPrivileged) write = false, read = true;
+          else              write = false, read = false;
+          break;
+        case 0b11:
+          write = false, read = true;
+          break;
+        default:
+          UNREACHABLE();
+          break;
+      }
+
+    return {write, read, perms.region, perms.regionValid};
+  }
+
+  /* _SetExclusiveMonitors {{{4
+   * ---------------------
+   */
+  void _SetExclusiveMonitors(uint32_t addr, int size) {
+    bool isSecure = (_s.curState == SecurityState_Secure);
+    auto [excInfo, memAddrDesc] = _ValidateAddress(addr, AccType_NORMAL, _FindPriv(), isSecure, false, true);
+    _HandleException(excInfo);
+
+    if (memAddrDesc.memAttrs.shareable)
+      _MarkExclusiveGlobal(memAddrDesc.physAddr, _ProcessorID(), size);
+
+    _MarkExclusiveLocal(memAddrDesc.physAddr, _ProcessorID(), size);
+  }
+
+  /* _MarkExclusiveGlobal {{{4
+   * --------------------
+   * Records in a global record that the PE has requested "exclusive access"
+   * covering at least size bytes from the address.
+   */
+  void _MarkExclusiveGlobal(uint32_t addr, int processorID, int size) {
+    auto lk = _gm.Lock();
+    _gm.MarkExclusive(addr, processorID, size);
+  }
 
-    // Stack limit registers. It is IMPLEMENTATIOND EFINED how many bits
-    // of these registers are writable. The following writes only affect the bits
-    // that an implementation defines as writable.
-    if (_HaveMainExt()) {
-      _s.msplimNS = 0;
-      _s.psplimNS = 0;
-    }
-    if (_HaveSecurityExt()) {
-      _s.msplimS = 0;
-      _s.psplimS = 0;
-    }
+  /* _MarkExclusiveLocal {{{4
+   * -------------------
+   * Records in a local record that the PE has requested "exclusive access"
+   * covering at least size bytes from the address.
+   */
+  void _MarkExclusiveLocal(uint32_t addr, int processorID, int size) {
+    _lm.MarkExclusive(addr, size);
+  }
 
-    // Load the initial value of the stack pointer and the reset value from the
-    // vector table. The order of the loads is IMPLEMENTATION DEFINED.
-    auto [excSp, sp]      = _GetVector(0,     _HaveSecurityExt());
-    auto [excRst, start]  = _GetVector(Reset, _HaveSecurityExt());
-    if (excSp.fault != NoFault || excRst.fault != NoFault)
-      _Lockup(true);
+  /* _ExclusiveMonitorsPass {{{4
+   * ----------------------
+   */
+  bool _ExclusiveMonitorsPass(uint32_t addr, int size) {
+    // It is IMPLEMENTATION DEFINED whether the detection of memory aborts
+    // happens before or after the check on the local Exclusive Monitor. As a
+    // result a failure of the local monitor can occur on some implementations
+    // even if the memory access would give a memory abort.
 
-    // Initialize the stack pointers and start execution at the reset vector
-    if (_HaveSecurityExt()) {
-      _SetSP_Main_Secure(sp);
-      _SetSP_Main_NonSecure(0); // UNKNOWN
-      _SetSP_Process_Secure(0); // UNKNOWN
+    ExcInfo           excInfo;
+    AddressDescriptor memAddrDesc;
+    if (addr != _Align(addr, size)) {
+      InternalOr32(REG_CFSR, REG_CFSR__UFSR__UNALIGNED);
+      excInfo = _CreateException(UsageFault, false, UNKNOWN_VAL(false));
     } else
-      _SetSP_Main_NonSecure(sp);
+      std::tie(excInfo, memAddrDesc) =
+        _ValidateAddress(addr, AccType_NORMAL, _FindPriv(), _IsSecure(), true, true);
 
-    // Begin Implementation-Specific Resets
-    _s.curCondOverride = -1;
-    // End Implementation-Specific Resets
+    _HandleException(excInfo);
 
-    _SetSP_Process_NonSecure(0); // UNKNOWN
-    _s.xpsr = CHGBITSM(_s.xpsr, XPSR__T, start & 1);
-    _BranchToAndCommit(start & ~1);
+    bool passed = _IsExclusiveLocal(memAddrDesc.physAddr, _ProcessorID(), size);
+    if (memAddrDesc.memAttrs.shareable)
+      passed = passed && _IsExclusiveGlobal(memAddrDesc.physAddr, _ProcessorID(), size);
 
-    // This is not included in the psuedocode but is required else the first
-    // instruction will be executed twice.
-    _s.pcChanged       = false;
+    if (passed)
+      _ClearExclusiveLocal(_ProcessorID());
+
+    return passed;
   }
 
-  /* _SteppingDebug {{{4
-   * --------------
+  /* _IsExclusiveGlobal {{{4
+   * ------------------
+   * Checks if PE has marked in a global record an address range as an
+   * "exclusive access requested" that covers at least the size bytes from
+   * address.
    */
-  bool _SteppingDebug() {
-    // If halting debug is allowed and C_STEP is set, set C_HALT for the next instruction.
-    uint32_t dhcsr = InternalLoad32(REG_DHCSR);
-    if (_CanHaltOnEvent(_IsSecure()) && !!(dhcsr & REG_DHCSR__C_STEP)) {
-      dhcsr |= REG_DHCSR__C_HALT;
-      InternalStore32(REG_DHCSR, dhcsr);
-
-      uint32_t dfsr = InternalLoad32(REG_DFSR);
-      dfsr |= REG_DFSR__HALTED;
-      InternalStore32(REG_DFSR, dfsr);
-    }
+  bool _IsExclusiveGlobal(uint32_t addr, int processorID, int size) {
+    auto lk = _gm.Lock();
+    return _gm.IsExclusive(addr, processorID, size);
+  }
 
-    uint32_t demcr = InternalLoad32(REG_DEMCR);
-    bool monStepEnabled = _HaveDebugMonitor() && _CanPendMonitorOnEvent(_IsSecure(), false);
-    return monStepEnabled && !!(demcr & REG_DEMCR__MON_STEP);
+  /* _IsExclusiveLocal {{{4
+   * -----------------
+   * Checks if PE has marked in a local record an address range as an
+   * "exclusive access requested" that covers at least the size bytes from
+   * address.
+   */
+  bool _IsExclusiveLocal(uint32_t addr, int processorID, int size) {
+    return _lm.IsExclusive(addr, size);
   }
 
-  /* _FetchInstr {{{4
-   * -----------
+  /* _CountLeadingZeroBits {{{4
+   * ---------------------
    */
-  std::tuple<uint32_t,bool> _FetchInstr(uint32_t addr) {
-    uint32_t sgOpcode = 0xE97F'E97F;
+  static uint32_t _CountLeadingZeroBits(uint32_t x) {
+    return x ? __builtin_clz(x) : 32;
+  }
 
-    SAttributes hw1Attr = _SecurityCheck(addr, true, _IsSecure());
-    // Fetch the T16 instruction, or the first half of a T32.
-    uint16_t hw1Instr = _GetMemI(addr);
+  /* _IntegerZeroDivideTrappingEnabled {{{4
+   * ---------------------------------
+   */
+  bool _IntegerZeroDivideTrappingEnabled() {
+    // DIV_0_TRP bit in CCR is RAZ/WI if the Main Extension is not implememented
+    return !!(InternalLoad32(REG_CCR) & REG_CCR__DIV_0_TRP);
+  }
 
-    // If the T bit is clear then the instruction can't be decoded
-    if (!GETBITSM(_s.xpsr, XPSR__T)) {
-      // Attempted NS->S domain crossing with the T bit clear raise an INVEP
-      // SecureFault
-      ExcInfo excInfo;
-      if (!_IsSecure() && !hw1Attr.ns) {
-        uint32_t sfsr = InternalLoad32(REG_SFSR);
-        sfsr |= REG_SFSR__INVEP;
-        InternalStore32(REG_SFSR, sfsr);
-        excInfo = _CreateException(SecureFault, true, true);
-      } else {
-        InternalOr32(REG_CFSR, REG_CFSR__UFSR__INVSTATE);
-        excInfo = _CreateException(UsageFault, false, false/*unknown*/);
-      }
-      _HandleException(excInfo);
-    }
+  /* _GenerateIntegerZeroDivide {{{4
+   * --------------------------
+   */
+  void _GenerateIntegerZeroDivide() {
+    InternalOr32(REG_CFSR, REG_CFSR__UFSR__DIVBYZERO);
 
-    // Implementations are permitted to terminate the fetch process early if a
-    // domain crossing is being attempted and the first 16bits of the opcode
-    // isn't the first part of the SG instruction.
-    if (IMPL_DEF_EARLY_SG_CHECK) {
-      if (!_IsSecure() && !hw1Attr.ns && (hw1Instr != sgOpcode>>16)) {
-        uint32_t sfsr = InternalLoad32(REG_SFSR);
-        sfsr |= REG_SFSR__INVEP;
-        InternalStore32(REG_SFSR, sfsr);
-        ExcInfo excInfo = _CreateException(SecureFault, true, true);
-        _HandleException(excInfo);
-      }
-    }
+    auto excInfo = _CreateException(UsageFault, false, UNKNOWN_VAL(false));
+    _HandleException(excInfo);
+  }
 
-    // NOTE: Implementations are also permitted to terminate the fetch process
-    // at this point with an UNDEFINSTR UsageFault if the first 16 bits are an
-    // undefined T32 prefix.
+  /* _ExecuteCPCheck {{{4
+   * ---------------
+   */
+  void _ExecuteCPCheck(int cp) {
+    // Check access to coprocessor is enabled.
+    auto excInfo = _CheckCPEnabled(cp);
+    _HandleException(excInfo);
+  }
 
-    // If the data fetched is the top half of a T32 instruction, fetch the bottom
-    // 16 bits.
-    uint32_t instr;
-    SAttributes hw2Attr;
-    bool isT16 = GETBITS(hw1Instr,11,15) < 0b11101;
-    if (isT16)
-      instr = hw1Instr;
-    else {
-      hw2Attr = _SecurityCheck(addr+2, true, _IsSecure());
-      // The following test covers 2 possible fault conditions:
-      // 1) NS code branching to a T32 instruction where the first half is in
-      //    NS memory, and the second half is in S memory
-      // 2) NS code branching to a T32 instruction in S & NSC memory, but
-      //    where the second half of the instruction is in NS memory
-      if (!_IsSecure() && hw1Attr.ns != hw2Attr.ns) {
-        uint32_t sfsr = InternalLoad32(REG_SFSR);
-        sfsr |= REG_SFSR__INVEP;
-        InternalStore32(REG_SFSR, sfsr);
-        ExcInfo excInfo = _CreateException(SecureFault, true, true);
-        _HandleException(excInfo);
-      }
+  /* _GenerateCoprocessorException {{{4
+   * -----------------------------
+   */
+  void _GenerateCoprocessorException() {
+    InternalOr32(REG_CFSR, REG_CFSR__UFSR__UNDEFINSTR);
+    auto excInfo = _CreateException(UsageFault, false, UNKNOWN_VAL(false));
+    _HandleException(excInfo);
+  }
 
-      // Fetch the second half of the TE2 instruction.
-      instr = (uint32_t(hw1Instr)<<16) | _GetMemI(addr+2);
-    }
+  /* _Coproc_Accepted {{{4
+   * ----------------
+   */
+  bool _Coproc_Accepted(int cpNum, uint32_t instr) {
+    // TODO
+    return false;
+  }
 
-    // Raise a fault if an otherwise valid NS->S transition that doesn't land on
-    // an SG instruction.
-    if (!_IsSecure() && !hw1Attr.ns && instr != sgOpcode) {
-      uint32_t sfsr = InternalLoad32(REG_SFSR);
-      sfsr |= REG_SFSR__INVEP;
-      InternalStore32(REG_SFSR, sfsr);
-      ExcInfo excInfo = _CreateException(SecureFault, true, true);
-      _HandleException(excInfo);
-    }
+  /* _Coproc_DoneLoading {{{4
+   * -------------------
+   * Check whether enough 32-bit words have been loaded for an LDC instruction.
+   */
+  bool _Coproc_DoneLoading(int cpNum, uint32_t instr) {
+    // TODO
+    return true;
+  }
 
-    return {instr, isT16};
+  /* _Coproc_DoneStoring {{{4
+   * -------------------
+   * Check whether enough 32-bit words have been stored for a STC instruction.
+   */
+  bool _Coproc_DoneStoring(int cpNum, uint32_t instr) {
+    // TODO
+    return true;
   }
 
-  /* _GenerateDebugEventResponse {{{4
-   * ---------------------------
+  /* _Coproc_GetOneWord {{{4
+   * ------------------
+   * Gets the 32-bit word for an MRC instruction from the coprocessor.
    */
-  bool _GenerateDebugEventResponse() {
-    if (_CanHaltOnEvent(_IsSecure())) {
-      InternalOr32(REG_DFSR, REG_DFSR__BKPT);
-      InternalOr32(REG_DHCSR, REG_DHCSR__C_HALT);
-      return true;
-    } else if (_HaveMainExt() && _CanPendMonitorOnEvent(_IsSecure(), true)) {
-      InternalOr32(REG_DFSR, REG_DFSR__BKPT);
-      InternalOr32(REG_DEMCR, REG_DEMCR__MON_PEND);
-      ExcInfo excInfo = _CreateException(DebugMonitor, false, false/*UNKNOWN*/);
-      _HandleException(excInfo);
-      return true;
-    } else
-      return false;
+  uint32_t _Coproc_GetOneWord(int cpNum, uint32_t instr) {
+    return 0xFFFF'FFFF; // TODO
   }
 
-  /* _FPB_CheckBreakPoint {{{4
-   * --------------------
+  /* _Coproc_GetTwoWords {{{4
+   * -------------------
+   * Get two 32-bit words for an MRRC instruction from the coprocessor.
    */
-  bool _FPB_CheckBreakPoint(uint32_t iaddr, int size, bool isIFetch, bool isSecure) {
-    bool match = _FPB_CheckMatchAddress(iaddr);
-    if (!match && size == 4 && _FPB_CheckMatchAddress(iaddr+2))
-      match = _ConstrainUnpredictableBool(true/*Unpredictable_FPBreakpoint*/);
-    return match;
+  std::tuple<uint32_t, uint32_t> _Coproc_GetTwoWords(int cpNum, uint32_t instr) {
+    return {0xFFFF'FFFF, 0xFFFF'FFFF}; // TODO
   }
 
-  /* _FPB_CheckMatchAddress {{{4
+  /* _Coproc_GetWordToStore {{{4
    * ----------------------
+   * Gets the next 32-bit word to store for a STC instruction from the coprocessor.
    */
-  bool _FPB_CheckMatchAddress(uint32_t iaddr) {
-    if (!(InternalLoad32(REG_FP_CTRL) & REG_FP_CTRL__ENABLE))
-      return false; // FPB not enabled
-
-    // Instruction Comparator.
-    uint32_t fpCtrl = InternalLoad32(REG_FP_CTRL);
-    uint32_t numAddrCmp = GETBITSM(fpCtrl, REG_FP_CTRL__NUM_CODE_LO) | (GETBITSM(fpCtrl, REG_FP_CTRL__NUM_CODE_HI)<<4);
-    if (!numAddrCmp)
-      return false; // No comparator support
-
-    for (int N=0; N<numAddrCmp; ++N) {
-      uint32_t x = InternalLoad32(REG_FP_COMP(N));
-      if (x & REG_FP_COMPn__BE) // Breakpoint enabled
-        if ((iaddr>>1) == GETBITSM(x, REG_FP_COMPn__BPADDR))
-          return true;
-    }
-
-    return false;
+  uint32_t _Coproc_GetWordToStore(int cpNum, uint32_t instr) {
+    return 0xFFFF'FFFF; // TODO
   }
 
-  /* _ExceptionDetails {{{4
-   * -----------------
+  /* _Coproc_InternalOperation {{{4
+   * -------------------------
+   * Instructs a coprocessor to perform the internal operation requested by a
+   * CDP instruction.
    */
-  std::tuple<bool,bool> _ExceptionDetails(int exc, bool isSecure, bool isSync) {
-    bool escalateToHf, termInst, enabled, canEscalate;
-
-    switch (exc) {
-      case HardFault:
-        termInst = true;
-        enabled = true;
-        canEscalate = true;
-        break;
-      case MemManage:
-        termInst = true;
-        if (_HaveMainExt()) {
-          uint32_t val = isSecure ? InternalLoad32(REG_SHCSR_S) : InternalLoad32(REG_SHCSR_NS);
-          enabled = !!(val & REG_SHCSR__MEMFAULTENA);
-        } else
-          enabled = false;
-        canEscalate = true;
-        break;
-      case BusFault:
-        termInst = isSync;
-        enabled = _HaveMainExt() ? !!(InternalLoad32(REG_SHCSR_S) & REG_SHCSR__BUSFAULTENA) : false;
-        canEscalate = termInst || !enabled; // Async BusFaults only escalate if they are disabled
-        break;
-      case UsageFault:
-        termInst = true;
-        if (_HaveMainExt()) {
-          uint32_t val = isSecure ? InternalLoad32(REG_SHCSR_S) : InternalLoad32(REG_SHCSR_NS);
-          enabled = !!(val & REG_SHCSR__USGFAULTENA);
-        } else
-          enabled = false;
-        canEscalate = true;
-        break;
-      case SecureFault:
-        termInst = true;
-        enabled = _HaveMainExt() ? !!(InternalLoad32(REG_SHCSR_S) & REG_SHCSR__SECUREFAULTENA) : false;
-        canEscalate = true;
-        break;
-      case SVCall:
-        termInst = false;
-        enabled  = true;
-        canEscalate = true;
-        break;
-      case DebugMonitor:
-        termInst = true;
-        enabled = _HaveMainExt() ? !!(InternalLoad32(REG_DEMCR) & REG_DEMCR__MON_EN) : false;
-        canEscalate = false; // true if fault caused by BKPT instruction
-        break;
-      default:
-        termInst = false;
-        canEscalate = false;
-        break;
-    }
+  void _Coproc_InternalOperation(int cpNum, uint32_t instr) {
+    // TODO
+  }
 
-    // If the fault can escalate then check if exception can be taken
-    // immediately, or whether it should escalate.
-    escalateToHf = false;
-    if (canEscalate) {
-      int execPri = _ExecutionPriority();
-      int excePri = _ExceptionPriority(exc, isSecure, true);
-      if (excePri >= execPri || !enabled)
-        escalateToHf = true;
-    }
+  /* _Coproc_SendLoadedWord {{{4
+   * ----------------------
+   * Sends a loaded 32-bit word for an LDC instruction to the coprocessor.
+   */
+  void _Coproc_SendLoadedWord(uint32_t word, int cpNum, uint32_t instr) {
+    // TODO
+  }
 
-    return {escalateToHf, termInst};
+  /* _Coproc_SendOneWord {{{4
+   * -------------------
+   * Sends the 32-bit word for an MCR instruction to the coprocessor.
+   */
+  void _Coproc_SendOneWord(uint32_t word, int cpNum, uint32_t instr) {
+    // TODO
   }
 
-  /* _HandleException {{{4
-   * ----------------
+  /* _Coproc_SendTwoWords {{{4
+   * --------------------
+   * Send two 32-bit words for an MCRR instruction to the coprocessor.
    */
-  void _HandleException(const ExcInfo &excInfo) {
-    if (excInfo.fault == NoFault)
-      return;
+  void _Coproc_SendTwoWords(uint32_t word2, uint32_t word1, int cpNum, uint32_t instr) {
+    // TODO
+  }
 
-    TRACE("handling exception %d\n", excInfo.fault);
+  /* _UnsignedSatQ {{{4
+   * -------------
+   */
+  std::tuple<uint32_t, bool> _UnsignedSatQ(uint32_t i, int N) {
+    uint32_t result;
+    bool     saturated;
 
-    if (excInfo.lockup) {
-      TRACE("commencing lockup\n");
-      _Lockup(excInfo.termInst);
-      return;
+    if (i > (BIT(N)-1)) {
+      result    = BIT(N)-1;
+      saturated = true;
+    } else if (i < 0) { // no-op
+      result    = 0;
+      saturated = true;
+    } else {
+      result    = i;
+      saturated = false;
     }
 
-    // If the fault escalated to a HardFault update the syndrome info
-    if (_HaveMainExt() && excInfo.fault == HardFault && excInfo.origFault != HardFault)
-      InternalOr32(REG_HFSR, REG_HFSR__FORCED);
-
-    // If the exception does not cause a lockup set the exception pending and
-    // potentially terminate execution of the current instruction
-    _SetPending(excInfo.fault, excInfo.isSecure, true);
-    if (excInfo.termInst)
-      _EndOfInstruction();
+    return {GETBITS(result, 0, N-1), saturated};
   }
 
-  /* _InstructionAdvance {{{4
-   * -------------------
+  /* _SignedSatQ {{{4
+   * -----------
    */
-  void _InstructionAdvance(bool instExecOk) {
-    // Check for, and process any exception returns that were requested. This
-    // must be done after the instruction has completed so any exceptions raised
-    // during the exception return do not interfere with the execution of the
-    // instruction that causes the exception return (e.g. a POP causing an
-    // excReturn value to be written to the PC must adjust SP even if the
-    // exception return caused by the POP raises a fault).
-    bool excRetFault = false;
-    uint32_t excReturn = _NextInstrAddr();
-    if (_s.pendingReturnOperation) {
-      _s.pendingReturnOperation = false;
-      ExcInfo excInfo;
-      std::tie(excInfo, excReturn) = _ExceptionReturn(excReturn);
-      // Handle any faults raised during exception return
-      if (excInfo.fault != NoFault) {
-        excRetFault = true;
-        // Either lockup, or pend the fault if it can be taken
-        if (excInfo.lockup) {
-          // Check if the fault occured on an exception return, or whether it
-          // occured during a tail chained exception entry. This is because
-          // Lockups on exception return have to be handled differently.
-          if (!excInfo.inExcTaken) {
-            // If the fault occured during exception return, then the register
-            // state is UNKNOWN. This is due to the fact that an unknown amount
-            // of the exception stack frame might have been restored.
-            for (int n=0; n<13; ++n)
-              _s.r[n] = 0; // UNKNOWN
-            _s.lr = 0; // UNKNOWN
-            _s.xpsr = 0; // UNKNOWN
-            if (_HaveFPExt())
-              for (int n=0; n<32; ++n)
-                _SetS(n, 0); // UNKNOWN
-            _s.fpscr = 0; // UNKNOWN
-            // If lockup is entered as a result of an exception return fault the
-            // original exception is deactivated. Therefore the stack pointer
-            // must be updated to consume the exception stack frame to keep the
-            // stack depth consistent with the number of active exceptions. NOTE:
-            // The XPSR SP alignment flag is UNKNOWN, assume is was zero.
-            _ConsumeExcStackFrame(excReturn, false);
-            // IPSR from stack is UNKNOWN, set IPSR bsased on mode specified in
-            // EXC_RETURN.
-            _s.xpsr = CHGBITSM(_s.xpsr, XPSR__EXCEPTION, (excReturn & EXC_RETURN__MODE) ? NoFault : HardFault);
-            if (_HaveFPExt()) {
-              uint32_t &control = _IsSecure() ? _s.controlS : _s.controlNS;
-              control = CHGBITSM(control,  CONTROL__FPCA, ~GETBITSM(excReturn, EXC_RETURN__FTYPE));
-              _s.controlS = CHGBITSM(_s.controlS, CONTROL__SFPA, 0); // UNKNOWN
-            }
-          }
-          _Lockup(false);
-        } else {
-          // Set syndrome if fault escalated to a hardfault
-          if (_HaveMainExt() && excInfo.fault == HardFault && excInfo.origFault != HardFault)
-            InternalOr32(REG_HFSR, REG_HFSR__FORCED);
-          _SetPending(excInfo.fault, excInfo.isSecure, true);
-        }
-      }
-    }
-
-    // If there is a pending exception with sufficient priority take it now. This
-    // is done before committing PC and ITSTATE changes caused by the previous
-    // instruction so that calls to ThisInstrAddr(), NextInstrAddr(),
-    // ThisInstrITState(), NextInstrITState() represent the context the
-    // instruction was executed in. IE so the correct context is pushed to the
-    // stack.
-    auto [takeException, exception, excIsSecure] = _PendingExceptionDetails();
-    if (takeException) {
-      TRACE("TAKE EXC %d\n", exception);
-      // If a fault occurred during an exception return then the exception
-      // stack frame will already be on the stack, as a resut entry to the
-      // next exception is treated as if it were a tail chain.
-      int pePriority = _ExecutionPriority();
-      uint32_t peException = GETBITSM(_s.xpsr, XPSR__EXCEPTION);
-      bool peIsSecure = _IsSecure();
-      ExcInfo excInfo;
-      if (excRetFault) {
-        // If the fault occurred during ExceptionTaken() then LR will have been
-        // updated with the new exception return value. To excReturn consistent
-        // with the state of the exception stack frame we need to use the updated
-        // version in this case. If no updates have occurred then the excReturn
-        // value from the previous exception return is used.
-        uint32_t nextExcReturn = excInfo.inExcTaken ? _s.lr : excReturn;
-        excInfo = _TailChain(exception, excIsSecure, nextExcReturn);
-      } else
-        excInfo = _ExceptionEntry(exception, excIsSecure, instExecOk);
-      // Handle any derived faults that have occurred
-      if (excInfo.fault != NoFault)
-        _DerivedLateArrival(pePriority, peException, peIsSecure, excInfo, exception, excIsSecure);
+  std::tuple<int32_t, bool> _SignedSatQ(uint32_t i, int N) {
+    uint32_t result;
+    bool     saturated;
+
+    if (int32_t(i) > (int32_t)(BIT(N-1)-1)) {
+      result    = BIT(N-1)-1;
+      saturated = true;
+    } else if (int32_t(i) < -(int32_t)BIT(N-1)) {
+      result    = -BIT(N-1);
+      saturated = true;
+    } else {
+      result    = i;
+      saturated = false;
     }
 
-    // If the PC has moved away from the lockup address (eg because an NMI has
-    // been taken) leave the lockup state.
-    if (InternalLoad32(REG_DHCSR) & REG_DHCSR__S_LOCKUP && _NextInstrAddr() != 0xEFFF'FFFE)
-      InternalMask32(REG_DHCSR, REG_DHCSR__S_LOCKUP);
+    return {GETBITS(result, 0, N-1), saturated};
+  }
 
-    // Only advance the PC and ISTATE if not locked up.
-    if (!(InternalLoad32(REG_DHCSR) & REG_DHCSR__S_LOCKUP)) {
-      // Commit PC and ITSTATE changes ready for the next instruction.
-      _s.pc = _NextInstrAddr();
-      _s.pcChanged = false;
-      if (_HaveMainExt()) {
-        uint32_t next = _NextInstrITState();
-        _s.xpsr = CHGBITSM(_s.xpsr, XPSR__IT_ICI_LO, next>>2);
-        _s.xpsr = CHGBITSM(_s.xpsr, XPSR__IT_ICI_HI, next);
-        _s.itStateChanged = false;
-      }
+  /* Instruction Fetch Attribute Cache {{{3
+   * =================================
+   * Validating an instruction fetch (_SecurityCheck, then _ValidateAddress,
+   * which scans the SAU and MPU regions) is done for every halfword fetched.
+   * SAU and MPU regions, the IDAU lookup and the default memory map all have
+   * a granularity of 32 bytes, so we cache the result of validating a fetch
+   * for each 32-byte granule, keyed by _BlockContext(), which covers the
+   * security state, privilege and everything else outside the SCS on which
+   * validation depends. Only fetches which validate without a fault are
+   * cached, as a fault has side effects (e.g. on CFSR).
+   *
+   * Any SCS store which may affect fetch validation (SAU_*, MPU_*, including
+   * MAIR*, VTOR, etc.) flushes the cache, as does a reset. CONTROL is part of
+   * the key.
+   */
+  struct FetchAttrs {
+    uint32_t          granule = DI_INVALID_PC; // Address of the granule.
+    uint32_t          ctx;                     // _BlockContext() when validated.
+    SAttributes       sAttrs;                  // Result of _SecurityCheck.
+    AddressDescriptor desc;                    // Result of _ValidateAddress, apart from physAddr.
+    const uint8_t    *host;                    // Host memory holding the granule, if any.
+  };
+
+  struct FetchCache {
+    FetchCache() :entries(FETCH_CACHE_SIZE ? new FetchAttrs[FETCH_CACHE_SIZE] : nullptr) {}
+
+    std::unique_ptr<FetchAttrs[]> entries;
+  };
+
+  /* _LookUpFetchAttrs {{{4
+   * -----------------
+   * Returns the cached attributes for a fetch from addr, or nullptr if there
+   * are none. ctx is _BlockContext().
+   */
+  const FetchAttrs *_LookUpFetchAttrs(uint32_t addr, uint32_t ctx) {
+    if constexpr (FETCH_CACHE_SIZE > 0) {
+      const FetchAttrs &fa = _fc.entries[(addr>>5) & (FETCH_CACHE_SIZE-1)];
+      if (fa.granule == (addr & ~BITS(0,4)) && fa.ctx == ctx)
+        return &fa;
     }
+
+    return nullptr;
   }
 
-  /* _ConditionHolds {{{4
+  /* _FillFetchAttrs {{{4
    * ---------------
-   */
-  bool _ConditionHolds(uint32_t cond) {
-    bool result;
-    switch ((cond>>1) & 0b111) {
-      case 0b000: result = GETBITSM(_s.xpsr, XPSR__Z); break;
-      case 0b001: result = GETBITSM(_s.xpsr, XPSR__C); break;
-      case 0b010: result = GETBITSM(_s.xpsr, XPSR__N); break;
-      case 0b011: result = GETBITSM(_s.xpsr, XPSR__V); break;
-      case 0b100: result = GETBITSM(_s.xpsr, XPSR__C) && !GETBITSM(_s.xpsr, XPSR__Z); break;
-      case 0b101: result = GETBITSM(_s.xpsr, XPSR__Z) == GETBITSM(_s.xpsr, XPSR__V); break;
-      case 0b110: result = GETBITSM(_s.xpsr, XPSR__Z) == GETBITSM(_s.xpsr, XPSR__V) && !GETBITSM(_s.xpsr, XPSR__Z); break;
-      case 0b111: result = true; break;
+   * Caches the attributes for a fetch from addr which validated without a
+   * fault.
+   */
+  void _FillFetchAttrs(uint32_t addr, uint32_t ctx, const AddressDescriptor &desc) {
+    if constexpr (FETCH_CACHE_SIZE > 0) {
+      FetchAttrs &fa = _fc.entries[(addr>>5) & (FETCH_CACHE_SIZE-1)];
+      fa.granule  = addr & ~BITS(0,4);
+      fa.ctx      = ctx;
+      fa.sAttrs   = _SecurityCheck(fa.granule, true, _IsSecure());
+      fa.desc     = desc;
+      fa.host     = _FindHostMem(desc.physAddr & ~BITS(0,4), 32, HOST_REGION__EXEC);
     }
+  }
 
-    if ((cond & 1) && cond != 0b111)
-      result = !result;
+  /* _FlushFetchAttrs {{{4
+   * ----------------
+   */
+  void _FlushFetchAttrs() {
+    if constexpr (FETCH_CACHE_SIZE > 0)
+      for (size_t i=0; i<FETCH_CACHE_SIZE; ++i)
+        _fc.entries[i].granule = DI_INVALID_PC;
+  }
+
+  /* Address Translation Cache {{{3
+   * =========================
+   * _ValidateAddress calls _SecurityCheck and _MPUCheck, which scan the SAU
+   * and MPU regions, for every data access. Their results depend only on the
+   * 32-byte granule, the class of access, the privilege and security state
+   * requested, the SCS registers, and whether the execution priority is
+   * negative, which is determined by _BlockContext(). We cache them in a small
+   * TLB keyed by all of these. Instruction fetches use the fetch attribute
+   * cache instead and lazy FP state preservation depends on FPCCR.HFRDY, so
+   * neither is cached here.
+   *
+   * Stores to the MPU and SAU registers and AIRCR flush the TLB, as does a
+   * reset. CONTROL is covered by the key.
+   *
+   * Each entry also records the extent over which the results are the same,
+   * so that a multi-word transfer within one SAU and MPU region need only be
+   * validated once.
+   */
+  struct TlbEntry {
+    uint32_t          tag = UINT32_MAX; // Granule address | TLB_KEY__*.
+    uint32_t          ctx;              // _BlockContext() when filled.
+    uint32_t          extent;           // Last address with the same results.
+    SAttributes       sAttrs;           // Result of _SecurityCheck.
+    MemoryAttributes  memAttrs;         // Result of _MPUCheck.
+    Permissions       perms;            // Result of _MPUCheck.
+  };
 
-    return result;
-  }
+  struct Tlb {
+    Tlb() :entries(TLB_SIZE ? new TlbEntry[TLB_SIZE] : nullptr) {}
 
-  /* _SetMonStep {{{4
-   * -----------
+    std::unique_ptr<TlbEntry[]> entries;
+  };
+
+  static constexpr uint32_t TLB_KEY__PRIV     = BIT(0);
+  static constexpr uint32_t TLB_KEY__SECURE   = BIT(1);
+  static constexpr uint32_t TLB_KEY__VECTABLE = BIT(2);
+
+  /* _TlbCacheable {{{4
+   * -------------
+   * NORMAL, ORDERED and STACK accesses are treated identically by
+   * _SecurityCheck and _MPUCheck and so form one class; VECTABLE is another.
    */
-  void _SetMonStep(bool monStepActive) {
-    if (!monStepActive)
-      return;
+  static bool _TlbCacheable(AccType accType) {
+    return TLB_SIZE > 0 && accType != AccType_IFETCH && accType != AccType_LAZYFP;
+  }
 
-    if (!(InternalLoad32(REG_DEMCR) & REG_DEMCR__MON_STEP))
-      THROW_UNPREDICTABLE();
+  static uint32_t _TlbTag(uint32_t addr, AccType accType, bool isPriv, bool secure) {
+    return (addr & ~BITS(0,4))
+      | (isPriv ? TLB_KEY__PRIV : 0)
+      | (secure ? TLB_KEY__SECURE : 0)
+      | (accType == AccType_VECTABLE ? TLB_KEY__VECTABLE : 0);
+  }
 
-    if (_ExceptionPriority(DebugMonitor, _IsSecure(), true) < _ExecutionPriority()) {
-      InternalOr32(REG_DEMCR, REG_DEMCR__MON_PEND);
-      InternalOr32(REG_DFSR, REG_DFSR__HALTED);
-    }
+  // The key bits are mixed into the index so that, for example, privileged
+  // and unprivileged accesses to the same granule do not evict each other.
+  static size_t _TlbIndex(uint32_t tag) {
+    return ((tag >> 5) ^ ((tag & BITS(0,2)) << 3)) & (TLB_SIZE-1);
   }
 
-  /* _ExceptionTargetsSecure {{{4
-   * -----------------------
+  /* _LookUpTlb {{{4
+   * ----------
+   * Returns the cached results for an access, or nullptr if there are none.
    */
-  bool _ExceptionTargetsSecure(int excNo, bool isSecure) {
-    if (!_HaveSecurityExt())
-      return false;
+  const TlbEntry *_LookUpTlb(uint32_t addr, AccType accType, bool isPriv, bool secure, uint32_t ctx) {
+    if constexpr (TLB_SIZE > 0) {
+      if (!_TlbCacheable(accType))
+        return nullptr;
 
-    bool targetSecure = false;
-    switch (excNo) {
-      case NMI:
-        targetSecure = !(InternalLoad32(REG_AIRCR) & REG_AIRCR__BFHFNMINS);
-        break;
-      case HardFault:
-        targetSecure = !(InternalLoad32(REG_AIRCR) & REG_AIRCR__BFHFNMINS) || isSecure;
-        break;
-      case MemManage:
-        targetSecure = isSecure;
-        break;
-      case BusFault:
-        targetSecure = !(InternalLoad32(REG_AIRCR) & REG_AIRCR__BFHFNMINS);
-        break;
-      case UsageFault:
-        targetSecure = isSecure;
-        break;
-      case SecureFault:
-        targetSecure = true;
-        break;
-      case SVCall:
-        targetSecure = isSecure;
-        break;
-      case DebugMonitor:
-        targetSecure = !!(InternalLoad32(REG_DEMCR) & REG_DEMCR__SDME);
-        break;
-      case PendSV:
-        targetSecure = isSecure;
-        break;
-      case SysTick:
-        if (_HaveSysTick() == 2) {
-          // XXX. The ISA manual does not give a definition here but suggests
-          // that targetSecure should equal whether the S or NS SysTick timer
-          // is raising. This is only applicable if we are in a context of handling
-          // an exception and this function is called from other places. However,
-          // it *should* never be called for SysTick if _HaveSysTick() == 2, because
-          // then !_IsExceptionTargetConfigurable(SysTick), and this function
-          // never be called when !_IsExceptionTargetConfigurable() for SysTick specifically
-          // unless we are actually handling an actually pending exception. In this circumstance,
-          // we will be called by _PendingExceptionDetailsActual() and isSecure will be
-          // equal to the correct value.
-          targetSecure = isSecure;
-        } else if (_HaveSysTick() == 1)
-          // SysTick target state is configurable
-          targetSecure = !(InternalLoad32(REG_ICSR_S) & REG_ICSR__STTNS);
-        break;
-
-      default:
-        if (excNo >= 16)
-          targetSecure = !(InternalLoad32(REG_NVIC_ITNSn((excNo-16)/32)) & BIT((excNo-16)%32));
-        break;
+      uint32_t        tag = _TlbTag(addr, accType, isPriv, secure);
+      const TlbEntry &te  = _tlb.entries[_TlbIndex(tag)];
+      if (te.tag == tag && te.ctx == ctx)
+        return &te;
     }
 
-    return targetSecure;
+    return nullptr;
   }
 
-  /* _IsCPInstruction {{{4
-   * ----------------
+  /* _FillTlb {{{4
+   * --------
    */
-  std::tuple<bool, int> _IsCPInstruction(uint32_t instr) {
-    bool isCp = false;
-    if ((instr & 0b11101111000000000000000000000000) == 0b11101110000000000000000000000000)
-      isCp = true;
-    if ((instr & 0b11101110000000000000000000000000) == 0b11101100000000000000000000000000)
-      isCp = true;
-    int cpNum = isCp ? GETBITS(instr, 8,11) : 0 /* UNKNOWN */;
-    if (cpNum == 11)
-      cpNum = 10;
-    return {isCp, cpNum};
-  }
+  void _FillTlb(uint32_t addr, AccType accType, bool isPriv, bool secure, uint32_t ctx, uint32_t extent,
+                const SAttributes &sAttrs, const MemoryAttributes &memAttrs, const Permissions &perms) {
+    if constexpr (TLB_SIZE > 0) {
+      if (!_TlbCacheable(accType))
+        return;
 
-  /* _DWT_InstructionMatch {{{4
-   * ---------------------
-   */
-  void _DWT_InstructionMatch(uint32_t iaddr) {
-    bool triggerDebugEvent  = false;
-    bool debugEvent         = false;
+      uint32_t  tag = _TlbTag(addr, accType, isPriv, secure);
+      TlbEntry &te  = _tlb.entries[_TlbIndex(tag)];
+      te.tag      = tag;
+      te.ctx      = ctx;
+      te.extent   = extent;
+      te.sAttrs   = sAttrs;
+      te.memAttrs = memAttrs;
+      te.perms    = perms;
+    }
+  }
 
-    if (!_HaveDWT() || _IsZero(InternalLoad32(REG_DWT_CTRL) & REG_DWT_CTRL__NUMCOMP))
-      // No comparator support.
-      return;
+  /* _AttrExtent {{{4
+   * -----------
+   * Returns the last address of the run of memory starting at addr for which
+   * _SecurityCheck and _MPUCheck (using the given MPU bank) give the same
+   * results as for addr. This is conservative: any region boundary, or a
+   * boundary of the default memory map, ends the run. The PPB and vendor
+   * system areas, and memory subject to an IDAU, are treated granule by
+   * granule.
+   */
+  uint32_t _AttrExtent(uint32_t addr, bool secureMpu) {
+    uint32_t granuleEnd = addr | BITS(0,4);
+    if (IMPL_DEF_IDAU_PRESENT || addr >= 0xE000'0000)
+      return granuleEnd;
+
+    uint32_t extent = addr | BITS(0,28);
+    auto clip = [&](uint32_t base, uint32_t limit) {
+      if (base > addr)
+        extent = std::min(extent, base - 1);
+      else if (limit >= addr)
+        extent = std::min(extent, limit);
+    };
 
-    for (int i=0; i<GETBITSM(InternalLoad32(REG_DWT_CTRL), REG_DWT_CTRL__NUMCOMP); ++i) {
-      if (_IsDWTConfigUnpredictable(i)) {
-        // XXX(UNPREDICTABLE): We do not want to throw here, so we simply do not consider
-        // invalid configurations.
-        QUIET_UNPREDICTABLE("DWT comparator %u has unpredictable configuration\n", i);
-        continue;
+    if (_HaveSecurityExt() && (InternalLoad32(REG_SAU_CTRL) & REG_SAU_CTRL__ENABLE)) {
+      uint32_t numRegion = GETBITSM(InternalLoad32(REG_SAU_TYPE), REG_SAU_TYPE__SREGION);
+      for (uint32_t r=0; r<numRegion; ++r) {
+        auto [rbar,rlar] = _InternalLoadSauRegion(r);
+        if (rlar & REG_SAU_RLAR__ENABLE)
+          clip(GETBITSM(rbar, REG_SAU_RBAR__BADDR) << 5, (GETBITSM(rlar, REG_SAU_RLAR__LADDR) << 5) | 0b11111);
       }
+    }
 
-      bool instrAddrMatch = _DWT_InstructionAddressMatch(i, iaddr);
-      if (!instrAddrMatch)
-        continue;
-
-      // Instruction Address
-      if (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(i)), REG_DWT_FUNCTION__MATCH) == 0b0010) {
-        InternalOr32(REG_DWT_FUNCTION(i), REG_DWT_FUNCTION__MATCHED);
-        debugEvent = (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(i)), REG_DWT_FUNCTION__ACTION) == 0b01);
-      }
+    uint32_t mpuCtrl = InternalLoad32(secureMpu ? REG_MPU_CTRL_S : REG_MPU_CTRL_NS);
+    uint32_t mpuType = InternalLoad32(secureMpu ? REG_MPU_TYPE_S : REG_MPU_TYPE_NS);
+    if (mpuCtrl & REG_MPU_CTRL__ENABLE) {
+      int numRegions = GETBITSM(mpuType, REG_MPU_TYPE__DREGION);
+      for (int r=0; r<numRegions; ++r) {
+        uint32_t rbar, rlar;
+        if (secureMpu)
+          std::tie(rbar,rlar) = _InternalLoadMpuSecureRegion(r);
+        else
+          std::tie(rbar,rlar) = _InternalLoadMpuNonSecureRegion(r);
 
-      // Instruction Address Limit
-      else if (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(i)), REG_DWT_FUNCTION__MATCH) == 0b0011) {
-        ASSERT(i > 0);
-        InternalOr32(REG_DWT_FUNCTION(i  ), REG_DWT_FUNCTION__MATCHED); // UNKNOWN
-        InternalOr32(REG_DWT_FUNCTION(i-1), REG_DWT_FUNCTION__MATCHED);
-        debugEvent = (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(i-1)), REG_DWT_FUNCTION__ACTION) == 0b01);
+        if (rlar & REG_MPU_RLAR__EN)
+          clip(GETBITSM(rbar, REG_MPU_RBAR__BASE) << 5, (GETBITSM(rlar, REG_MPU_RLAR__LIMIT) << 5) | 0b11111);
       }
-
-      triggerDebugEvent = triggerDebugEvent || debugEvent;
     }
 
-    if (triggerDebugEvent)
-      debugEvent = _SetDWTDebugEvent(_IsSecure());
-
-    assert(false); // TODO
+    return std::max(extent, granuleEnd);
   }
 
-  /* _DWT_InstructionAddressMatch {{{4
-   * ----------------------------
+  /* _FlushTlb {{{4
+   * ---------
    */
-  bool _DWT_InstructionAddressMatch(int N, uint32_t iaddr) {
-    ASSERT(N < GETBITSM(InternalLoad32(REG_DWT_CTRL), REG_DWT_CTRL__NUMCOMP) && _Align(iaddr, 2) == iaddr);
-
-    bool secureMatch = _IsSecure();
-    bool validMatch  = _DWT_ValidMatch(N, secureMatch);
-    bool validInstr  = ((GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__MATCH) & 0b1110) == 0b0010);
-
-    if (!validMatch || !validInstr)
-      return false;
-
-    bool linkedToInstr;
-    if (N != GETBITSM(InternalLoad32(REG_DWT_CTRL), REG_DWT_CTRL__NUMCOMP)-1)
-      linkedToInstr = (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N+1)), REG_DWT_FUNCTION__MATCH) == 0b0011);
-    else
-      linkedToInstr = false;
+  void _FlushTlb() {
+    if constexpr (TLB_SIZE > 0)
+      for (size_t i=0; i<TLB_SIZE; ++i)
+        _tlb.entries[i].tag = UINT32_MAX;
+  }
 
-    bool linked;
-    if (GETBITSM(InternalLoad32(REG_DWT_FUNCTION(N)), REG_DWT_FUNCTION__MATCH) == 0b0011)
-      linked = true;
-    else
-      linked = false;
+  /* Host Memory Regions {{{3
+   * ===================
+   * The regions published by the device via IDevice::GetHostRegions. Loads,
+   * stores and fetches which fall within a region with the appropriate
+   * permission access host memory directly rather than via the device.
+   * Lookups check the region last found first, as accesses tend to hit the
+   * same region repeatedly.
+   */
+  struct HostRegions {
+    std::vector<HostRegion> regions;
+    size_t                  last = 0;  // Index of the region last found.
+  };
 
-    bool matchAddr;
-    if (!linkedToInstr) {
-      auto [matchEQ, matchGT] = _DWT_AddressCompare(iaddr, InternalLoad32(REG_DWT_COMP(N)), 2, 2);
-      if (linked) {
-        validMatch = _DWT_ValidMatch(N-1, secureMatch);
-        auto [lowerEQ, lowerGT] = _DWT_AddressCompare(iaddr, InternalLoad32(REG_DWT_COMP(N-1)), 2, 2);
-        matchAddr = (validMatch && (lowerEQ || lowerGT) && !matchGT);
-      } else
-        matchAddr = matchEQ;
-    } else
-      matchAddr = false;
+  /* _LoadHostRegions {{{4
+   * ----------------
+   */
+  void _LoadHostRegions() {
+    _hr.regions.clear();
+    _hr.last = 0;
+    if constexpr (std::is_base_of_v<IDevice, Device>)
+      _dev.GetHostRegions(_hr.regions);
 
-    return matchAddr;
+    // Accesses to the SCS never reach the device.
+    auto end = std::remove_if(_hr.regions.begin(), _hr.regions.end(), [](const HostRegion &r) {
+      return !r.len || !r.ptr || (uint64_t(r.base) + r.len > 0xE000'0000 && r.base < 0xE010'0000);
+    });
+    _hr.regions.erase(end, _hr.regions.end());
   }
 
-  /* _IsCPEnabled {{{4
+  /* _FindHostMem {{{4
    * ------------
-   */
-  std::tuple<bool, bool> _IsCPEnabled(int cp, bool priv, bool secure) {
-    bool enabled, forceToSecure = false;
+   * Returns a pointer to the host memory holding the given bytes, or nullptr
+   * if they are not within a single region permitting the access given by
+   * perm (HOST_REGION__*).
+   */
+  uint8_t *_FindHostMem(phys_t addr, uint32_t size, uint32_t perm) {
+    auto match = [&](const HostRegion &r) {
+      uint32_t off = addr - r.base;
+      return off < r.len && size <= r.len - off && (r.perms & perm);
+    };
 
-    uint32_t cpacr = secure ? InternalLoad32(REG_CPACR_S) : InternalLoad32(REG_CPACR_NS);
-    switch (GETBITS(cpacr,cp*2,cp*2+1)) {
-      case 0b00:
-        enabled = false;
-        break;
-      case 0b01:
-        enabled = priv;
-        break;
-      case 0b10:
-        // XXX(UNPREDICTABLE): We do not want to throw here, so simply treat this as
-        // disabled.
-        enabled = false;
-        QUIET_UNPREDICTABLE("invalid CP enable value for CP %u\n", cp);
-        break;
-      case 0b11:
-        enabled = true;
-        break;
-    }
+    size_t n = _hr.regions.size();
+    if likely (n && match(_hr.regions[_hr.last]))
+      return _hr.regions[_hr.last].ptr + (addr - _hr.regions[_hr.last].base);
 
-    if (enabled && _HaveSecurityExt()) {
-      if (!secure && !(InternalLoad32(REG_NSACR) & BIT(cp))) {
-        enabled = false;
-        forceToSecure = true;
+    for (size_t i=0; i<n; ++i)
+      if (match(_hr.regions[i])) {
+        _hr.last = i;
+        return _hr.regions[i].ptr + (addr - _hr.regions[i].base);
       }
-    }
 
-    if (enabled && !!(InternalLoad32(REG_CPPWR) & BIT(cp*2))) {
-      enabled = false;
-      forceToSecure = !!(InternalLoad32(REG_CPPWR) & BIT(cp*2+1));
-    }
+    return nullptr;
+  }
+
+  /* _HostStored {{{4
+   * -----------
+   * Records a store to host memory just returned by _FindHostMem in the dirty
+   * map of its region, if it has one, and reports it to the CodeWatches of
+   * any other simulators using the region.
+   */
+  void _HostStored(const uint8_t *p, phys_t addr, uint32_t size) {
+    const HostRegion &r = _hr.regions[_hr.last];
+    if (r.dirty)
+      r.dirty->Mark(p, size);
+    if (r.watches)
+      r.watches->NotifyWrite(addr, size, &_cw);
+  }
+
+  /* Decoded Instruction Cache {{{3
+   * =========================
+   * Decoding an instruction walks the decoder tree below, which is expensive
+   * relative to executing the typical instruction. The decoders end by calling
+   * a single _Exec_* function, so we record that call (the function and its
+   * arguments) the first time an instruction is decoded and replay it directly
+   * when the same instruction is executed again.
+   *
+   * Entries are indexed by PC and tagged with everything the decoders depend
+   * on other than the configuration: the encoding, ITSTATE, the security
+   * state and, for the few decoders which read it, APSR.C. Decoders which
+   * throw (UNDEFINED, etc.) never produce an entry. Stores through _Store
+   * invalidate any entry overlapping the written bytes.
+   */
+  struct DecodedInstr;
+  using DecodedHandler = void (*)(Simulator &sim, const DecodedInstr &di);
+
+  enum :uint8_t {
+    DI_FLAG__SECURE     = BIT(0), // Decoded in Secure state.
+    DI_FLAG__CARRY_DEP  = BIT(1), // Decoder read APSR.C; entry only valid if it still matches...
+    DI_FLAG__CARRY      = BIT(2), // ...this value.
+    DI_FLAG__SYNC       = BIT(3), // Instruction may change state checked by _InstructionAdvance.
+
+    DI_FLAG__TAG        = DI_FLAG__SECURE | DI_FLAG__CARRY_DEP | DI_FLAG__CARRY,
+  };
+
+  // Classification of instructions in blocks; see _ClassifyFastOp.
+  enum :uint8_t {
+    DI_FAST__NONE,
+    DI_FAST__MOV_IMM,
+    DI_FAST__MOV_REG,
+    DI_FAST__ADD_IMM,
+    DI_FAST__SUB_IMM,
+    DI_FAST__CMP_IMM,
+    DI_FAST__ADD_REG,
+    DI_FAST__SUB_REG,
+    DI_FAST__CMP_REG,
+    DI_FAST__CMN_IMM,
+    DI_FAST__CMN_REG,
+    DI_FAST__AND_REG,
+    DI_FAST__ORR_REG,
+    DI_FAST__EOR_REG,
+    DI_FAST__MAX,
+  };
 
-    return {enabled, secure || forceToSecure};
-  }
+  // An odd PC can never be fetched, so it marks an unused entry.
+  static constexpr uint32_t DI_INVALID_PC = 1;
+
+  struct DecodedInstr {
+    uint32_t        pc = DI_INVALID_PC;
+    uint32_t        instr;          // Encoding as returned by _FetchInstr.
+    uint8_t         itstate;        // ITSTATE at decode time.
+    uint8_t         flags;          // DI_FLAG__*
+    char            condOverride;   // curCondOverride as set by the decoder.
+    uint8_t         fastOp = DI_FAST__NONE; // DI_FAST__*; only set in blocks.
+    DecodedHandler  handler;        // Calls the _Exec_* function with the arguments in ops.
+    alignas(8) uint8_t ops[32];     // Arguments to the _Exec_* function.
+  };
 
-  /* _GetMemI {{{4
+  struct DecodeCache {
+    DecodeCache() :entries(DECODE_CACHE_SIZE ? new DecodedInstr[DECODE_CACHE_SIZE] : nullptr) {}
+
+    std::unique_ptr<DecodedInstr[]> entries;
+    DecodedInstr                   *fill = nullptr; // Entry being filled by the current decode, if any.
+    uint32_t                        fillPC;
+    DecodedInstr                   *last = nullptr; // Entry for the last instruction executed, if valid.
+    bool                            probe = false;  // Fill without executing (see _ProbeDecode).
+  };
+
+  /* ExecArgs {{{4
    * --------
+   * The arguments to an _Exec_* function, as stored in DecodedInstr::ops.
    */
-  uint16_t _GetMemI(uint32_t addr) {
-    uint16_t value;
-    auto [excInfo, memAddrDesc] = _ValidateAddress(addr, AccType_IFETCH, _FindPriv(), _IsSecure(), false, true);
-    if (excInfo.fault == NoFault) {
-      bool error;
-      std::tie(error, value) = _GetMem(memAddrDesc, 2);
-      if (error) {
-        value = UINT16_MAX; // UNKNOWN
-        InternalOr32(REG_CFSR, REG_CFSR__BFSR__IBUSERR);
-        excInfo = _CreateException(BusFault, false, false/*UNKNOWN*/);
-        TRACE("fetch failed\n");
-      }
-    } else TRACE("fetch addr validate failed 0x%x\n", addr);
+  template<typename ...Params>
+  static std::tuple<Params...> *_ExecArgsOf(void (Simulator::*)(Params...)) { return nullptr; }
 
-    _HandleException(excInfo);
-    if (_IsDWTEnabled())
-      _DWT_InstructionMatch(addr);
-    return value;
+  template<auto Fn>
+  using ExecArgs = std::remove_pointer_t<decltype(_ExecArgsOf(Fn))>;
+
+  // DecodedInstr is copied bytewise, so the arguments must be trivially
+  // copyable.
+  template<typename ...Params>
+  static constexpr bool _IsTrivialArgs(std::tuple<Params...> *) {
+    return (std::is_trivially_copyable_v<Params> && ...);
   }
 
-  /* _ExecutionPriority {{{4
-   * ------------------
-   * XXX: This has been augmented relative to the ISA manual psuedocode to add
-   * an argument `ignorePrimask`, to assist in the implementation of WFI.
+  /* _DecodedArgs {{{4
+   * ------------
+   * Returns the arguments of a decoded instruction known to execute Fn.
    */
-  int _ExecutionPriority(bool ignorePrimask=false) {
-    int boostedPri = _HighestPri();
+  template<auto Fn>
+  static const ExecArgs<Fn> &_DecodedArgs(const DecodedInstr &di) {
+    return *std::launder(reinterpret_cast<const ExecArgs<Fn> *>(di.ops));
+  }
 
-    int priSNsPri = _RestrictedNSPri();
-    if (_HaveMainExt()) {
-      if (GETBITS(_s.basepriNS, 0, 7)) {
-        uint32_t basepri        = GETBITS(_s.basepriNS, 0, 7);
-        uint32_t subGroupShift  = GETBITSM(InternalLoad32(REG_AIRCR_NS), REG_AIRCR__PRIGROUP);
-        uint32_t groupValue     = 2U<<subGroupShift;
-        uint32_t subGroupValue  = basepri % groupValue;
-        boostedPri              = basepri - subGroupValue;
-        if (InternalLoad32(REG_AIRCR_S) & REG_AIRCR__PRIS)
-          boostedPri = (boostedPri>>1) + priSNsPri;
-      }
+  /* _DispatchThunk {{{4
+   * --------------
+   */
+  template<auto Fn>
+  static void _DispatchThunk(Simulator &sim, const DecodedInstr &di) {
+    std::apply([&sim](auto ...a) { (sim.*Fn)(a...); }, _DecodedArgs<Fn>(di));
+  }
 
-      if (GETBITS(_s.basepriS, 0, 7)) {
-        uint32_t basepri        = GETBITS(_s.basepriS, 0, 7);
-        uint32_t subGroupShift  = GETBITSM(InternalLoad32(REG_AIRCR_S), REG_AIRCR__PRIGROUP);
-        uint32_t groupValue     = 2U<<subGroupShift;
-        uint32_t subGroupValue  = basepri % groupValue;
-        basepri                 = basepri - subGroupValue;
-        if (boostedPri > basepri)
-          boostedPri = basepri;
+  /* _Dispatch {{{4
+   * ---------
+   * Called by the decoders in place of calling an _Exec_* function directly.
+   * If the decode was started by _DecodeExecuteCached, completes the cache
+   * entry before executing the instruction.
+   */
+  template<auto Fn, typename ...Args>
+  void _Dispatch(Args ...args) {
+    if constexpr (DECODE_CACHE_SIZE > 0) {
+      static_assert(sizeof(ExecArgs<Fn>) <= sizeof(DecodedInstr::ops));
+      static_assert(_IsTrivialArgs(static_cast<ExecArgs<Fn> *>(nullptr)));
+
+      if (_dc.fill) {
+        DecodedInstr &di = *_dc.fill;
+        new (di.ops) ExecArgs<Fn>(args...);
+        di.handler      = &_DispatchThunk<Fn>;
+        di.condOverride = _s.curCondOverride;
+        di.pc           = _dc.fillPC;
+        if (_IsSyncInstr<Fn>())
+          di.flags     |= DI_FLAG__SYNC;
+        _dc.fill        = nullptr;
+        _dc.last        = &di;
+        if (_dc.probe)
+          return;
+        _cw.Watch(di.pc, di.instr > 0xFFFF ? 4 : 2);
       }
     }
 
-    if (!ignorePrimask) {
-      if (_s.primaskNS & 1) {
-        if (!(InternalLoad32(REG_AIRCR_S) & REG_AIRCR__PRIS))
-          boostedPri = 0;
-        else if (boostedPri > priSNsPri)
-          boostedPri = priSNsPri;
-      }
+    (this->*Fn)(args...);
+  }
 
-      if (_s.primaskS & 1)
-        boostedPri = 0;
-    }
+  /* _IsSyncInstr {{{4
+   * ------------
+   * Instructions which may change the exception state (PRIMASK, FAULTMASK,
+   * BASEPRI, CONTROL, the security state, pending exceptions) or which
+   * otherwise need the caller's attention without necessarily branching.
+   * Stores to the SCS are detected separately, in _Store.
+   */
+  template<auto Fn>
+  static constexpr bool _IsSyncInstr() {
+    return _IsOneOf<Fn,
+      &Simulator::_Exec_MSR_register, &Simulator::_Exec_CPS,
+      &Simulator::_Exec_SG,           &Simulator::_Exec_SVC,
+      &Simulator::_Exec_BKPT,         &Simulator::_Exec_UDF,
+      &Simulator::_Exec_WFI,          &Simulator::_Exec_WFE,
+      &Simulator::_Exec_SEV,          &Simulator::_Exec_YIELD,
+      &Simulator::_Exec_DBG,          &Simulator::_Exec_ISB,
+      &Simulator::_Exec_DSB,          &Simulator::_Exec_CDP_CDP2,
+      &Simulator::_Exec_LDC_LDC2_immediate, &Simulator::_Exec_LDC_LDC2_literal,
+      &Simulator::_Exec_STC_STC2,     &Simulator::_Exec_MCR_MCR2,
+      &Simulator::_Exec_MCRR_MCRR2,   &Simulator::_Exec_MRC_MRC2,
+      &Simulator::_Exec_MRRC_MRRC2>();
+  }
+
+  /* _IsOneOf {{{4
+   * --------
+   * Returns true if Fn is one of Fns.
+   */
+  template<auto Fn, auto ...Fns>
+  static constexpr bool _IsOneOf() {
+    return ([] {
+      if constexpr (std::is_same_v<decltype(Fn), decltype(Fns)>)
+        return Fn == Fns;
+      else
+        return false;
+    }() || ...);
+  }
 
-    if (_HaveMainExt()) {
-      if (_s.faultmaskNS & 1) {
-        if (!(InternalLoad32(REG_AIRCR) & REG_AIRCR__BFHFNMINS)) {
-          if (!(InternalLoad32(REG_AIRCR_S) & REG_AIRCR__PRIS))
-            boostedPri = 0;
-          else if (boostedPri > priSNsPri)
-            boostedPri = priSNsPri;
-        } else
-          boostedPri = -1;
-      }
+  /* _DecodeCarry {{{4
+   * ------------
+   * Returns APSR.C for decoders which take it as the carry-in to an immediate
+   * expansion, and records the dependency against any entry being filled.
+   */
+  bool _DecodeCarry() {
+    bool carry = _CarryFlag();
+    if constexpr (DECODE_CACHE_SIZE > 0)
+      if (_dc.fill)
+        _dc.fill->flags |= DI_FLAG__CARRY_DEP | (carry ? DI_FLAG__CARRY : 0);
+    return carry;
+  }
 
-      if (_s.faultmaskS & 1)
-        boostedPri = !(InternalLoad32(REG_AIRCR) & REG_AIRCR__BFHFNMINS) ? -1 : -3;
-    }
+  /* _DecodedInstrMatches {{{4
+   * --------------------
+   * Returns true if a decoded instruction is still valid for the current
+   * ITSTATE, security state and (if relevant) APSR.C.
+   */
+  bool _DecodedInstrMatches(const DecodedInstr &di, uint8_t itstate) {
+    uint8_t flags = _IsSecure() ? DI_FLAG__SECURE : 0;
+    if (di.flags & DI_FLAG__CARRY_DEP)
+      flags |= DI_FLAG__CARRY_DEP | (_CarryFlag() ? DI_FLAG__CARRY : 0);
 
-    int rawExecPri = _RawExecutionPriority();
-    return boostedPri < rawExecPri ? boostedPri : rawExecPri;
+    return di.itstate == itstate && (di.flags & DI_FLAG__TAG) == flags;
   }
 
-  /* _SecurityCheck {{{4
-   * --------------
+  /* _DecodeExecuteCached {{{4
+   * --------------------
+   * As for _DecodeExecute, but uses the decoded instruction cache.
    */
-  SAttributes _SecurityCheck(uint32_t addr, bool isInstrFetch, bool isSecure) {
-    SAttributes result = {};
+  void _DecodeExecuteCached(uint32_t instr, uint32_t pc, bool is16bit) {
+    if constexpr (DECODE_CACHE_SIZE > 0) {
+      DecodedInstr &di      = _dc.entries[(pc>>1) & (DECODE_CACHE_SIZE-1)];
+      uint8_t       itstate = _GetITSTATE();
 
-    bool idauExempt = false;
-    bool idauNs = true;
-    bool idauNsc = true;
+      if likely (di.pc == pc && di.instr == instr && _DecodedInstrMatches(di, itstate)) {
+        _dc.last = &di;
+        _s.curCondOverride = di.condOverride;
+        di.handler(*this, di);
+        return;
+      }
 
-    if (IMPL_DEF_IDAU_PRESENT)
-      std::tie(idauExempt, idauNs, idauNsc, result.iregion, result.irvalid) = _IDAUCheck(addr & ~BITS(0,4));
+      // Miss. The entry becomes valid once the decoder reaches _Dispatch, or
+      // if the decoder rejects the encoding, in which case it records that
+      // so that executing the encoding again neither decodes nor throws.
+      di.pc       = DI_INVALID_PC;
+      di.instr    = instr;
+      di.itstate  = itstate;
+      di.flags    = _IsSecure() ? DI_FLAG__SECURE : 0;
+      _dc.fill    = &di;
+      _dc.fillPC  = pc;
+      _dc.last    = nullptr;
 
-    if (isInstrFetch && GETBITS(addr,28,31) == 0b1111) {
-      // Use default attributes defined above.
-    } else if (   idauExempt
-               || (isInstrFetch && GETBITS(addr,28,31) == 0b1110)
-               || (addr >= 0xE000'0000 && addr <= 0xE000'2FFF)
-               || (addr >= 0xE000'E000 && addr <= 0xE000'EFFF)
-               || (addr >= 0xE002'E000 && addr <= 0xE002'EFFF)
-               || (addr >= 0xE004'0000 && addr <= 0xE004'1FFF)
-               || (addr >= 0xE00F'F000 && addr <= 0xE00F'FFFF)) {
-      result.ns       = !isSecure;
-      result.irvalid  = false;
-    } else {
-      if (InternalLoad32(REG_SAU_CTRL) & REG_SAU_CTRL__ENABLE) {
-        bool multiRegionHit = false;
-        uint32_t numRegion = GETBITSM(InternalLoad32(REG_SAU_TYPE), REG_SAU_TYPE__SREGION);
-        for (int r=0; r<numRegion; ++r) {
-          auto [rbar,rlar] = _InternalLoadSauRegion(r);
-          if (rlar & REG_SAU_RLAR__ENABLE) {
-            uint32_t baseAddr   = (GETBITSM(rbar, REG_SAU_RBAR__BADDR) << 5) | 0b00000;
-            uint32_t limitAddr  = (GETBITSM(rlar, REG_SAU_RLAR__LADDR) << 5) | 0b11111;
-            if (baseAddr <= addr && limitAddr >= addr) {
-              if (result.srvalid)
-                multiRegionHit = true;
-              else {
-                result.ns       =  !(rlar & REG_SAU_RLAR__NSC);
-                result.nsc      = !!(rlar & REG_SAU_RLAR__NSC);
-                result.srvalid  = true;
-                result.sregion  = r & 0xFF;
-              }
-            }
-          }
-        }
-        if (multiRegionHit) {
-          result.ns       = false;
-          result.nsc      = false;
-          result.sregion  = 0;
-          result.srvalid  = false;
-        }
-      } else if (InternalLoad32(REG_SAU_CTRL) & REG_SAU_CTRL__ALLNS)
-        result.ns = true;
+      try {
+        _DecodeExecute(instr, pc, is16bit);
+      } catch (const Exception &e) {
+        // If the entry is no longer being filled, the exception came from
+        // the _Exec_* function rather than the decoder.
+        if (_dc.fill != &di || !(_IsSEE(e) || _IsUNDEFINED(e) || _IsUNPREDICTABLE(e)))
+          throw;
 
-      if (!idauNs) {
-        if (result.ns || (!idauNsc && result.nsc)) {
-          result.ns   = false;
-          result.nsc  = idauNsc;
-        }
+        di.handler      = &_UndefinedThunk;
+        di.condOverride = _s.curCondOverride;
+        di.pc           = pc;
+        di.flags       |= DI_FLAG__SYNC;
+        _dc.fill        = nullptr;
+        _dc.last        = &di;
+        _cw.Watch(pc, is16bit ? 2 : 4);
+        _UndefinedThunk(*this, di);
       }
+      return;
     }
 
-    return result;
+    _DecodeExecute(instr, pc, is16bit);
   }
 
-  /* _IDAUCheck {{{4
-   * ----------
+  /* _UndefinedThunk {{{4
+   * ---------------
+   * Handler for a decoded instruction entry recording an encoding which the
+   * decoders rejected as UNDEFINED, UNPREDICTABLE or SEE.
    */
-  std::tuple<bool, bool, bool, uint8_t, bool> _IDAUCheck(uint32_t addr) {
-    return _dev.IDAUCheck(addr);
+  static void _UndefinedThunk(Simulator &sim, const DecodedInstr &di) {
+    sim._RaiseUndefined();
   }
 
-  /* _LowestSetBit {{{4
-   * -------------
-   */
-  static int _LowestSetBit(uint32_t x) {
-    ASSERT(x);
-    return CTZL(x);
+  /* _InvalidateDecodeCache {{{4
+   * ----------------------
+   * Invalidates any cached instruction overlapping the given bytes. A 32-bit
+   * instruction starting at addr-2 overlaps addr, so that halfword is checked
+   * too.
+   */
+  void _InvalidateDecodeCache(phys_t addr, uint32_t size) {
+    if constexpr (DECODE_CACHE_SIZE > 0) {
+      uint32_t first = (addr - 2) & ~1U, last = (addr + size - 1) & ~1U;
+      for (uint32_t a = first; a != last + 2; a += 2) {
+        DecodedInstr &di = _dc.entries[(a>>1) & (DECODE_CACHE_SIZE-1)];
+        if (di.pc == a)
+          di.pc = DI_INVALID_PC;
+      }
+    }
   }
 
-  /* _DecodeRegShift {{{4
+  /* _InvalidateCode {{{4
    * ---------------
+   * Invalidates any cached instruction or block overlapping the given bytes.
+   * Only needed for pages marked in the CodeWatch.
    */
-  SRType _DecodeRegShift(uint32_t srType) {
-    switch (srType) {
-      case 0b00: return SRType_LSL;
-      case 0b01: return SRType_LSR;
-      case 0b10: return SRType_ASR;
-      case 0b11: return SRType_ROR;
-      default: UNREACHABLE();
-    }
+  void _InvalidateCode(phys_t addr, uint32_t size) {
+    _InvalidateDecodeCache(addr, size);
+    if (_bc.blocks)
+      _InvalidateBlocks(addr, size);
   }
 
-  /* _BKPTInstrDebugEvent {{{4
-   * --------------------
-   */
-  void _BKPTInstrDebugEvent() {
-    if (!_GenerateDebugEventResponse()) {
-      auto excInfo = _CreateException(HardFault, false, UNKNOWN_VAL(false));
-      _HandleException(excInfo);
-    }
-  }
+  /* Block Engine {{{3
+   * ============
+   * With ExecEngine_Block, straight-line runs of instructions are recorded
+   * into blocks of decoded instructions the first time they are executed (by
+   * the ordinary _TopLevel path) and replayed back to back afterwards. When
+   * replaying, the fetch is skipped, as are the interrupt checks and the
+   * debug checks in _TopLevel/_InstructionAdvance for all but the last
+   * instruction in the block. Blocks are linked to the blocks which last
+   * followed them, so that a loop runs without hashing.
+   *
+   * This is equivalent to the reference interpreter provided that:
+   *
+   *   - the outcome of the fetch is unchanged. The instruction memory is
+   *     covered by _InvalidateBlocks; the validation performed by the fetch
+   *     (SAU, MPU, privilege) is covered by keying blocks on _BlockContext
+   *     and by flushing all blocks when any SCS register other than the
+   *     interrupt controls is written;
+   *
+   *   - no exception becomes pending in the middle of a block. Instructions
+   *     which can change exception state are marked DI_FLAG__SYNC and end a
+   *     block, as do stores to the SCS. Faults terminate a block at the
+   *     faulting instruction. The exception is SysTick, which is only
+   *     sampled at block boundaries;
+   *
+   *   - no debug feature which acts per instruction (stepping, FPB, DWT) is
+   *     enabled. If one is, we fall back to _TopLevel.
+   *
+   * Code memory modified other than via the simulator (e.g. by the device
+   * directly) must be reported via the CodeWatch (see GetCodeWatch).
+   */
+  using JitFn = int (*)();
+
+  struct Block {
+    uint32_t  pc = DI_INVALID_PC; // Address of the first instruction.
+    uint32_t  end;                // Address after the last instruction.
+    uint32_t  ctx;                // _BlockContext() when recorded.
+    uint32_t  first;              // Index of the first instruction in the arena.
+    uint32_t  count;              // Number of instructions.
+    uint32_t  runs;               // Number of times run (ExecEngine_JIT only).
+    JitFn     code;               // Translated code, if any (ExecEngine_JIT only).
+    Block    *next[2]{};          // Last successor seen after fallthrough/branch.
+  };
 
-  /* _Hint_Yield {{{4
-   * -----------
-   * Performs a Yield hint.
+  struct BlockCache {
+    std::unique_ptr<Block[]>        blocks;
+    std::unique_ptr<DecodedInstr[]> arena;
+    uint32_t                        arenaUsed = 0;
+    uint32_t                        lo = UINT32_MAX, hi = 0; // Bounds of all recorded code.
+    uint32_t                        recPC = 0, recEnd = 0;   // Bounds of the block being recorded.
+    bool                            recDirty = false;        // Block being recorded was written to.
+    uint32_t                        flushes = 0;
+    bool                            sync = false;            // SCS store in the current instruction.
+  };
+
+  /* _BlockContext {{{4
+   * -------------
+   * Summarises the state on which instruction fetch validation depends, other
+   * than the SCS registers.
+   */
+  uint32_t _BlockContext() {
+    return (_s.curState == SecurityState_Secure)
+      | (!!GETBITSM(_s.xpsr, XPSR__EXCEPTION)     <<1)
+      | (!!GETBITSM(_s.xpsr, XPSR__T)             <<2)
+      | (!!(_s.controlS  & CONTROL__NPRIV)        <<3)
+      | (!!(_s.controlNS & CONTROL__NPRIV)        <<4)
+      | ((_s.faultmaskS  & 1)                     <<5)
+      | ((_s.faultmaskNS & 1)                     <<6)
+      | (uint32_t(_s.excActive[NMI])              <<7)
+      | (uint32_t(_s.excActive[HardFault])        <<9);
+  }
+
+  /* _CanRunBlocks {{{4
+   * -------------
+   * Returns false if _TopLevel must be used for the next instruction because
+   * the core is locked up or a per-instruction debug feature is enabled.
    */
-  void _Hint_Yield() {
-    // TODO
-    _s.exitCause |= EXIT_CAUSE__YIELD;
+  bool _CanRunBlocks() {
+    uint32_t dhcsr = InternalLoad32(REG_DHCSR);
+    if (dhcsr & REG_DHCSR__S_LOCKUP)
+      return false;
+
+    if ((dhcsr & REG_DHCSR__C_STEP) && _CanHaltOnEvent(_IsSecure()))
+      return false;
+
+    if (_HaveDebugMonitor() && (InternalLoad32(REG_DEMCR) & REG_DEMCR__MON_STEP))
+      return false;
+
+    if (_HaveFPB() && (InternalLoad32(REG_FP_CTRL) & REG_FP_CTRL__ENABLE))
+      return false;
+
+    return !_IsDWTEnabled();
   }
 
-  /* _Hint_Debug {{{4
-   * -----------
-   * Generate a hint to the debug system.
+  /* _TopLevelBlock {{{4
+   * --------------
+   * TopLevel for ExecEngine_Block. Returns the number of instructions
+   * processed.
    */
-  void _Hint_Debug(uint32_t option) {
-    // TODO
-    _s.exitCause |= EXIT_CAUSE__DBG;
+  int _TopLevelBlock() {
+    if constexpr (DECODE_CACHE_SIZE == 0) {
+      _TopLevel();
+      return 1;
+    }
+
+    if unlikely (!_bc.blocks) {
+      _bc.blocks.reset(new Block[BLOCK_CACHE_SIZE]);
+      _bc.arena.reset(new DecodedInstr[BLOCK_ARENA_SIZE]);
+    }
+
+    int     n     = 0;
+    Block  *prev  = nullptr;
+    bool    taken = false;
+    for (int i=0; i<BLOCK_CHAIN_MAX; ++i) {
+      if (!_CanRunBlocks()) {
+        _TopLevel();
+        return n+1;
+      }
+
+      // Follow the link from the previous block if it is still valid,
+      // otherwise look the block up by address.
+      uint32_t  pc  = _s.pc;
+      uint32_t  ctx = _BlockContext();
+      Block    *b   = prev ? prev->next[taken] : nullptr;
+      if (!b || b->pc != pc || b->ctx != ctx) {
+        b = &_bc.blocks[(pc>>1) & (BLOCK_CACHE_SIZE-1)];
+        if (b->pc != pc || b->ctx != ctx)
+          return n + _RecordBlock(pc, ctx);
+
+        if (prev)
+          prev->next[taken] = b;
+      }
+
+      n += _ExecBlock(*b);
+      if (_s.exitCause)
+        break;
+
+      prev  = b;
+      taken = (_s.pc != b->end);
+    }
+
+    return n;
   }
 
-  /* _Hint_PreloadData {{{4
-   * -----------------
-   * Performs a preload data hint.
+  /* _RecordBlock {{{4
+   * ------------
+   * Executes instructions via _TopLevel, recording them as a new block until
+   * something ends the block. Returns the number of instructions processed.
    */
-  void _Hint_PreloadData(uint32_t addr) {
-    // TODO
+  int _RecordBlock(uint32_t startPC, uint32_t ctx) {
+    if (_bc.arenaUsed + BLOCK_MAX_INSTRS > BLOCK_ARENA_SIZE)
+      _FlushBlocks();
+
+    uint32_t first = _bc.arenaUsed, count = 0, pc = startPC, flushes = _bc.flushes;
+    int n = 0;
+
+    _bc.recPC     = startPC;
+    _bc.recDirty  = false;
+    for (;;) {
+      _bc.recEnd = pc + 4;
+      _bc.sync = false;
+      _dc.last = nullptr;
+      _TopLevel();
+      ++n;
+
+      // Stop if the instruction was not cached (e.g. because it faulted, or
+      // stored to its own encoding).
+      DecodedInstr *di = _dc.last;
+      if (!di || di->pc != pc)
+        break;
+
+      DecodedInstr &rec = _bc.arena[first + count++];
+      rec         = *di;
+      rec.fastOp  = _ClassifyFastOp(rec);
+      pc += _s.thisInstrLength;
+
+      if (_s.exitCause || _bc.sync || (di->flags & DI_FLAG__SYNC) || _s.pc != pc
+          || count == BLOCK_MAX_INSTRS || _BlockContext() != ctx)
+        break;
+    }
+
+    _bc.recEnd = _bc.recPC;
+
+    // The last instruction always goes through _BlockStep, which ends the
+    // block.
+    if (count)
+      _bc.arena[first + count - 1].fastOp = DI_FAST__NONE;
+
+    // Discard the block if its code was modified while recording, or if the
+    // SCS store which ended it flushed the cache.
+    if (count && !_bc.recDirty && _bc.flushes == flushes) {
+      Block &b = _bc.blocks[(startPC>>1) & (BLOCK_CACHE_SIZE-1)];
+      b.pc        = startPC;
+      b.end       = pc;
+      b.ctx       = ctx;
+      b.first     = first;
+      b.count     = count;
+      b.runs      = 0;
+      b.code      = nullptr;
+      b.next[0]   = b.next[1] = nullptr;
+
+      _bc.arenaUsed = first + count;
+      _bc.lo        = std::min(_bc.lo, startPC);
+      _bc.hi        = std::max(_bc.hi, pc);
+    }
+
+    return n;
   }
 
-  /* _Hint_PreloadDataForWrite {{{4
-   * -------------------------
-   * Performs a preload data hint for write.
-   */
-  void _Hint_PreloadDataForWrite(uint32_t addr) {
-    // TODO
+  /* _ExecBlock {{{4
+   * ----------
+   * Runs a block using the configured engine. Returns the number of
+   * instructions processed.
+   */
+  int _ExecBlock(Block &b) {
+#if JIT_SUPPORTED
+    if (_cfg.Engine() == ExecEngine_JIT) {
+      if (!b.code && ++b.runs == JIT_THRESHOLD)
+        _JitCompile(b);
+      if (b.code)
+        return _JitRun(b);
+    }
+#endif
+
+    if (_cfg.Engine() == ExecEngine_Threaded)
+      return _RunBlockThreaded(b);
+
+    return _RunBlock(b);
   }
 
-  /* _Hint_PreloadInstr {{{4
-   * ------------------
-   * Performs a preload instruction hint.
+  /* _BeginBlock {{{4
+   * -----------
+   * Per-block setup performed before the first instruction of a block.
    */
-  void _Hint_PreloadInstr(uint32_t addr) {
-    // TODO
+  void _BeginBlock() {
+    // These are invariant for the duration of the block; see _TopLevel.
+    _s.exitCause = 0;
+    _UpdateSecureDebugEnable();
+    _bc.sync = false;
   }
 
-  /* _CallSupervisor {{{4
-   * ---------------
+  /* _RunBlock {{{4
+   * ---------
+   * Replays a recorded block. Returns the number of instructions processed.
    */
-  void _CallSupervisor() {
-    auto excInfo = _CreateException(SVCall, false, UNKNOWN_VAL(false));
-    _HandleException(excInfo);
+  int _RunBlock(const Block &b) {
+    _BeginBlock();
+
+    const DecodedInstr *di = &_bc.arena[b.first];
+    uint32_t pc = b.pc;
+    for (uint32_t i=0;; ++i, ++di) {
+      if (_BlockStep(b, *di, pc, i+1 == b.count))
+        return i+1;
+
+      pc += di->instr > 0xFFFF ? 4 : 2;
+    }
   }
 
-  /* _TTResp {{{4
-   * -------
+  /* _BlockStep {{{4
+   * ----------
+   * Executes one instruction of a block. Returns true if the block ends after
+   * this instruction, in which case the instruction advance has been
+   * performed; otherwise PC and ITSTATE have been committed.
    */
-  uint32_t _TTResp(uint32_t addr, bool alt, bool forceUnpriv) {
-    uint32_t resp = 0;
+  bool _BlockStep(const Block &b, const DecodedInstr &di, uint32_t pc, bool last) {
+    uint32_t  len         = di.instr > 0xFFFF ? 4 : 2;
+    bool      ok          = true;
 
-    // Only allow security checks if currently in Secure state.
-    bool addrSecure;
-    if (_IsSecure()) {
-      auto sAttributes = _SecurityCheck(addr, false, _IsSecure());
-      if (sAttributes.srvalid) {
-        resp = CHGBITSM(resp, TT_RESP__SREGION, sAttributes.sregion);
-        resp = CHGBITSM(resp, TT_RESP__SRVALID, 1);
-      }
-      if (sAttributes.irvalid) {
-        resp = CHGBITSM(resp, TT_RESP__IREGION, sAttributes.iregion);
-        resp = CHGBITSM(resp, TT_RESP__IRVALID, 1);
-      }
+    _SetThisInstrDetails(di.instr, len, _s.itCond);
+    try {
+      if likely (_DecodedInstrMatches(di, _s.itstate)) {
+        _s.curCondOverride = di.condOverride;
+        di.handler(*this, di);
+      } else
+        _DecodeExecuteCached(di.instr, pc, len == 2);
 
-      addrSecure = sAttributes.ns ? 0 : 1;
-      resp = CHGBITSM(resp, TT_RESP__S, addrSecure);
+      if unlikely (_InstrTerminated())
+        ok = false;
+    } catch (const Exception &e) {
+      ok = _HandleInstrException(e, di.instr);
     }
 
-    // MPU region information only available when privileged or when
-    // inspecting the other MPU state.
-    bool otherDomain = (alt != _IsSecure());
-    if (_CurrentModeIsPrivileged() || alt) {
-      auto [write, read, region, hit] = _IsAccessible(addr, forceUnpriv, otherDomain);
-      if (hit) {
-        resp = CHGBITSM(resp, TT_RESP__MREGION, region);
-        resp = CHGBITSM(resp, TT_RESP__MRVALID, 1);
-      }
-      resp = CHGBITSM(resp, TT_RESP__R,  read);
-      resp = CHGBITSM(resp, TT_RESP__RW, write);
-      if (_IsSecure()) {
-        resp = CHGBITSM(resp, TT_RESP__NSR,  (read && !addrSecure));
-        resp = CHGBITSM(resp, TT_RESP__NSRW, (write && !addrSecure));
-      }
+    if (!ok || _BlockEnds(b, di, last)) {
+      _TopLevelAdvance(ok);
+      return true;
     }
 
-    return resp;
+    _CommitPCAndITSTATE();
+    return false;
   }
 
-  /* _IsAccessible {{{4
-   * -------------
+  /* _BlockEnds {{{4
+   * ----------
+   * Returns true if a block must end after an instruction which completed
+   * normally.
    */
-  std::tuple<bool, bool, uint8_t, bool> _IsAccessible(uint32_t addr, bool forceUnpriv, bool isSecure) {
-    bool write, read;
+  bool _BlockEnds(const Block &b, const DecodedInstr &di, bool last) {
+    return _s.pcChanged || _s.pendingReturnOperation || _s.exitCause
+        || _bc.sync || (di.flags & DI_FLAG__SYNC) || last
+        || b.pc == DI_INVALID_PC;
+  }
 
-    // Work out which privilege level the current mode in the Non-secure state
-    // is subject to.
-    bool isPrivileged;
-    if (forceUnpriv)
-      isPrivileged = false;
-    else
-      isPrivileged = (_CurrentMode() == PEMode_Handler
-        || (isSecure ? !GETBITSM(_s.controlS,  CONTROL__NPRIV)
-                     : !GETBITSM(_s.controlNS, CONTROL__NPRIV)));
+  /* _RunBlockThreaded {{{4
+   * -----------------
+   * Replays a recorded block as threaded code (ExecEngine_Threaded). Rather
+   * than returning to a loop after each instruction, each instruction jumps
+   * directly to the code for the next, selected by its DI_FAST__*
+   * classification. Instructions classified by _ClassifyFastOp call their
+   * _Exec_* function directly without the bookkeeping of _BlockStep; see the
+   * JIT for why this is safe. All other instructions take the same steps as
+   * _BlockStep. One try block covers the whole block. Returns the number of
+   * instructions processed.
+   */
+  int _RunBlockThreaded(const Block &b) {
+    using S = Simulator;
+
+    static void *const labels[] = {
+      &&L_NONE,
+      &&L_MOV_IMM, &&L_MOV_REG,
+      &&L_ADD_IMM, &&L_SUB_IMM, &&L_CMP_IMM,
+      &&L_ADD_REG, &&L_SUB_REG, &&L_CMP_REG,
+      &&L_CMN_IMM, &&L_CMN_REG,
+      &&L_AND_REG, &&L_ORR_REG, &&L_EOR_REG,
+    };
+    static_assert(ARRAYLEN(labels) == DI_FAST__MAX);
 
-    auto [_, perms] = _MPUCheck(addr, AccType_NORMAL, isPrivileged, isSecure);
-    if (!perms.apValid) {
-      write = false;
-      read  = false;
-    } else
-      switch (perms.ap) {
-        case 0b00:
-          if (isPrivileged) write = true,  read = true;
-          else              write = false, read = false;
-          break;
-        case 0b01:
-          write = true, read = true;
-          break;
-        case 0b10:
-          if (isPrivileged) write = false, read = true;
-          else              write = false, read = false;
-          break;
-        case 0b11:
-          write = false, read = true;
-          break;
-        default:
-          UNREACHABLE();
-          break;
+    const DecodedInstr *first = &_bc.arena[b.first], *last = first + b.count - 1, *di = first;
+    if (_GetITSTATE() != first->itstate)
+      return _RunBlock(b);
+
+    _BeginBlock();
+
+    uint32_t  pc = b.pc;
+    bool      ok = true;
+    try {
+#define THREADED_NEXT()                     \
+      do {                                  \
+        pc += di->instr > 0xFFFF ? 4 : 2;   \
+        ++di;                               \
+        goto *labels[di->fastOp];           \
+      } while (0)                        /**/
+#define THREADED_FAST(Name, Fn)                                           \
+    L_##Name:                                                             \
+      _SetThisInstrDetails(di->instr, di->instr > 0xFFFF ? 4 : 2, 0b1110);  \
+      _DispatchThunk<Fn>(*this, *di);                                     \
+      THREADED_NEXT();                                                 /**/
+
+      goto *labels[di->fastOp];
+
+    L_NONE: {
+        uint32_t len = di->instr > 0xFFFF ? 4 : 2;
+
+        // Fast ops do not commit the PC.
+        _s.pc = pc;
+        _SetThisInstrDetails(di->instr, len, _s.itCond);
+        if likely (_DecodedInstrMatches(*di, _s.itstate)) {
+          _s.curCondOverride = di->condOverride;
+          di->handler(*this, *di);
+        } else
+          _DecodeExecuteCached(di->instr, pc, len == 2);
+
+        if unlikely (_InstrTerminated()) {
+          ok = false;
+          goto done;
+        }
+
+        if (_BlockEnds(b, *di, di == last))
+          goto done;
+
+        _CommitPCAndITSTATE();
+        THREADED_NEXT();
       }
 
-    return {write, read, perms.region, perms.regionValid};
+      THREADED_FAST(MOV_IMM, &S::_Exec_MOV_immediate)
+      THREADED_FAST(MOV_REG, &S::_Exec_MOV_register)
+      THREADED_FAST(ADD_IMM, &S::_Exec_ADD_immediate)
+      THREADED_FAST(SUB_IMM, &S::_Exec_SUB_immediate)
+      THREADED_FAST(CMP_IMM, &S::_Exec_CMP_immediate)
+      THREADED_FAST(ADD_REG, &S::_Exec_ADD_register)
+      THREADED_FAST(SUB_REG, &S::_Exec_SUB_register)
+      THREADED_FAST(CMP_REG, &S::_Exec_CMP_register)
+      THREADED_FAST(CMN_IMM, &S::_Exec_CMN_immediate)
+      THREADED_FAST(CMN_REG, &S::_Exec_CMN_register)
+      THREADED_FAST(AND_REG, &S::_Exec_AND_register)
+      THREADED_FAST(ORR_REG, &S::_Exec_ORR_register)
+      THREADED_FAST(EOR_REG, &S::_Exec_EOR_register)
+
+#undef THREADED_FAST
+#undef THREADED_NEXT
+    } catch (const Exception &e) {
+      ok = _HandleInstrException(e, di->instr);
+    }
+
+  done:
+    _TopLevelAdvance(ok);
+    return int(di - first) + 1;
   }
 
-  /* _SetExclusiveMonitors {{{4
-   * ---------------------
-   */
-  void _SetExclusiveMonitors(uint32_t addr, int size) {
-    bool isSecure = (_s.curState == SecurityState_Secure);
-    auto [excInfo, memAddrDesc] = _ValidateAddress(addr, AccType_NORMAL, _FindPriv(), isSecure, false, true);
-    _HandleException(excInfo);
+  /* _ClassifyFastOp {{{4
+   * ---------------
+   * Identifies the simple data processing instructions which the threaded
+   * and JIT engines run without the per-instruction bookkeeping of
+   * _BlockStep: MOV, ADD, SUB, CMP and CMN (immediate or register), and AND,
+   * ORR and EOR (register), on R0-R12 and LR, without shifts, outside IT
+   * blocks.
+   * These can neither fault, branch, read the PC nor depend on ITSTATE.
+   */
+  static uint8_t _ClassifyFastOp(const DecodedInstr &di) {
+    using S = Simulator;
+
+    if (di.itstate || (di.flags & DI_FLAG__CARRY_DEP))
+      return DI_FAST__NONE;
+
+    auto plain = [](uint32_t r) { return r <= 12 || r == 14; };
+    auto imm = [&](const auto &args, uint8_t op) {
+      auto [d, n, setflags, imm32] = args;
+      return plain(d) && plain(n) ? op : uint8_t(DI_FAST__NONE);
+    };
+    auto reg = [&](const auto &args, uint8_t op) {
+      auto [d, n, m, setflags, shiftT, shiftN] = args;
+      return plain(d) && plain(n) && plain(m) && !shiftN ? op : uint8_t(DI_FAST__NONE);
+    };
 
-    if (memAddrDesc.memAttrs.shareable)
-      _MarkExclusiveGlobal(memAddrDesc.physAddr, _ProcessorID(), size);
+    if (di.handler == &_DispatchThunk<&S::_Exec_MOV_immediate>) {
+      auto [d, setflags, imm32, carry] = _DecodedArgs<&S::_Exec_MOV_immediate>(di);
+      return plain(d) ? DI_FAST__MOV_IMM : DI_FAST__NONE;
+    }
 
-    _MarkExclusiveLocal(memAddrDesc.physAddr, _ProcessorID(), size);
-  }
+    if (di.handler == &_DispatchThunk<&S::_Exec_MOV_register>) {
+      auto [d, m, setflags, shiftT, shiftN] = _DecodedArgs<&S::_Exec_MOV_register>(di);
+      return plain(d) && plain(m) && !shiftN ? DI_FAST__MOV_REG : DI_FAST__NONE;
+    }
 
-  /* _MarkExclusiveGlobal {{{4
-   * --------------------
-   * Records in a global record that the PE has requested "exclusive access"
-   * covering at least size bytes from the address.
+    if (di.handler == &_DispatchThunk<&S::_Exec_CMP_immediate>) {
+      auto [n, imm32] = _DecodedArgs<&S::_Exec_CMP_immediate>(di);
+      return plain(n) ? DI_FAST__CMP_IMM : DI_FAST__NONE;
+    }
+
+    if (di.handler == &_DispatchThunk<&S::_Exec_CMP_register>) {
+      auto [n, m, shiftT, shiftN] = _DecodedArgs<&S::_Exec_CMP_register>(di);
+      return plain(n) && plain(m) && !shiftN ? DI_FAST__CMP_REG : DI_FAST__NONE;
+    }
+
+    if (di.handler == &_DispatchThunk<&S::_Exec_CMN_immediate>) {
+      auto [n, imm32] = _DecodedArgs<&S::_Exec_CMN_immediate>(di);
+      return plain(n) ? DI_FAST__CMN_IMM : DI_FAST__NONE;
+    }
+
+    if (di.handler == &_DispatchThunk<&S::_Exec_CMN_register>) {
+      auto [n, m, shiftT, shiftN] = _DecodedArgs<&S::_Exec_CMN_register>(di);
+      return plain(n) && plain(m) && !shiftN ? DI_FAST__CMN_REG : DI_FAST__NONE;
+    }
+
+    if (di.handler == &_DispatchThunk<&S::_Exec_ADD_immediate>)
+      return imm(_DecodedArgs<&S::_Exec_ADD_immediate>(di), DI_FAST__ADD_IMM);
+    if (di.handler == &_DispatchThunk<&S::_Exec_SUB_immediate>)
+      return imm(_DecodedArgs<&S::_Exec_SUB_immediate>(di), DI_FAST__SUB_IMM);
+    if (di.handler == &_DispatchThunk<&S::_Exec_ADD_register>)
+      return reg(_DecodedArgs<&S::_Exec_ADD_register>(di), DI_FAST__ADD_REG);
+    if (di.handler == &_DispatchThunk<&S::_Exec_SUB_register>)
+      return reg(_DecodedArgs<&S::_Exec_SUB_register>(di), DI_FAST__SUB_REG);
+    if (di.handler == &_DispatchThunk<&S::_Exec_AND_register>)
+      return reg(_DecodedArgs<&S::_Exec_AND_register>(di), DI_FAST__AND_REG);
+    if (di.handler == &_DispatchThunk<&S::_Exec_ORR_register>)
+      return reg(_DecodedArgs<&S::_Exec_ORR_register>(di), DI_FAST__ORR_REG);
+    if (di.handler == &_DispatchThunk<&S::_Exec_EOR_register>)
+      return reg(_DecodedArgs<&S::_Exec_EOR_register>(di), DI_FAST__EOR_REG);
+
+    return DI_FAST__NONE;
+  }
+
+  /* _InvalidateBlocks {{{4
+   * -----------------
+   * Invalidates any block containing the given bytes.
    */
-  void _MarkExclusiveGlobal(uint32_t addr, int processorID, int size) {
-    auto lk = _gm.Lock();
-    _gm.MarkExclusive(addr, processorID, size);
+  void _InvalidateBlocks(phys_t addr, uint32_t size) {
+    if (addr < _bc.recEnd && addr + size > _bc.recPC)
+      _bc.recDirty = true;
+
+    if (addr >= _bc.hi || addr + size <= _bc.lo)
+      return;
+
+    for (size_t i=0; i<BLOCK_CACHE_SIZE; ++i) {
+      Block &b = _bc.blocks[i];
+      if (b.pc != DI_INVALID_PC && addr < b.end && addr + size > b.pc)
+        b.pc = DI_INVALID_PC;
+    }
   }
 
-  /* _MarkExclusiveLocal {{{4
-   * -------------------
-   * Records in a local record that the PE has requested "exclusive access"
-   * covering at least size bytes from the address.
+  /* _FlushBlocks {{{4
+   * ------------
    */
-  void _MarkExclusiveLocal(uint32_t addr, int processorID, int size) {
-    _lm.MarkExclusive(addr, size);
+  void _FlushBlocks() {
+    if (!_bc.blocks)
+      return;
+
+    for (size_t i=0; i<BLOCK_CACHE_SIZE; ++i)
+      _bc.blocks[i].pc = DI_INVALID_PC;
+
+    _bc.arenaUsed = 0;
+    _bc.lo        = UINT32_MAX;
+    _bc.hi        = 0;
+    ++_bc.flushes;
+#if JIT_SUPPORTED
+    _JitFlush();
+#endif
   }
 
-  /* _ExclusiveMonitorsPass {{{4
+  /* _IsInterruptControlReg {{{4
    * ----------------------
+   * Returns true for SCS registers whose only effect is on interrupt state
+   * (NVIC, SysTick, ICSR, STIR). Writes to these do not affect recorded
+   * blocks.
    */
-  bool _ExclusiveMonitorsPass(uint32_t addr, int size) {
-    // It is IMPLEMENTATION DEFINED whether the detection of memory aborts
-    // happens before or after the check on the local Exclusive Monitor. As a
-    // result a failure of the local monitor can occur on some implementations
-    // even if the memory access would give a memory abort.
+  static bool _IsInterruptControlReg(phys_t addr) {
+    addr &= ~0x0002'0000U; // Non-Secure alias
+    return (addr >= 0xE000'E010 && addr < 0xE000'E020)
+        || (addr >= 0xE000'E100 && addr < 0xE000'E600)
+        ||  addr == 0xE000'ED04 || addr == 0xE000'EF00;
+  }
 
-    ExcInfo           excInfo;
-    AddressDescriptor memAddrDesc;
-    if (addr != _Align(addr, size)) {
-      InternalOr32(REG_CFSR, REG_CFSR__UFSR__UNALIGNED);
-      excInfo = _CreateException(UsageFault, false, UNKNOWN_VAL(false));
-    } else
-      std::tie(excInfo, memAddrDesc) =
-        _ValidateAddress(addr, AccType_NORMAL, _FindPriv(), _IsSecure(), true, true);
+  /* _IsMemoryAttrReg {{{4
+   * ----------------
+   * Returns true for SCS registers on which _SecurityCheck and _MPUCheck
+   * depend (MPU_*, SAU_* other than SFSR/SFAR, and AIRCR). Writes to these
+   * flush the TLB.
+   */
+  static bool _IsMemoryAttrReg(phys_t addr) {
+    addr &= ~0x0002'0000U; // Non-Secure alias
+    return (addr >= 0xE000'ED90 && addr < 0xE000'EDE4)
+        ||  addr == 0xE000'ED0C;
+  }
+
+#if JIT_SUPPORTED
+  /* JIT {{{3
+   * ===
+   * With ExecEngine_JIT, a block which has run JIT_THRESHOLD times is
+   * translated to x86-64 code. For most instructions the translation is a
+   * call to _JitStep, which does exactly what _RunBlock does for one
+   * instruction. The simple data processing instructions identified by
+   * _ClassifyFastOp are instead translated to native instructions which
+   * operate on CpuState directly.
+   *
+   * Natively translated instructions skip _SetThisInstrDetails and
+   * _CommitPCAndITSTATE. This is safe because they are never the last
+   * instruction in a block, so _TopLevelAdvance never sees their state;
+   * they are only translated where ITSTATE is zero, so they are
+   * unconditional and leave ITSTATE unchanged (_JitRun checks ITSTATE on
+   * entry to the block against its value when recorded, and ITSTATE evolves
+   * deterministically within a block); and _JitStep sets the PC before
+   * executing the next instruction which is not natively translated.
+   *
+   * Anything which can fault, including all memory (and therefore exclusive
+   * and SCS) accesses, goes through _JitStep and the _Exec_* functions. C++
+   * exceptions never propagate through translated code: _JitStep catches
+   * anything not handled by _BlockStep, and _JitRun rethrows it.
+   *
+   * The code buffer is never writable and executable at once. _JitCompile
+   * makes the pages it is about to write to writable, and executable again
+   * once it is done; translation never happens while translated code runs.
+   */
+  struct JitCache {
+    JitCache() = default;
+    JitCache(const JitCache &) = delete;
+    ~JitCache() {
+      if (buf)
+        munmap(buf, JIT_CODE_SIZE);
+    }
 
-    _HandleException(excInfo);
+    uint8_t             *buf          = nullptr;
+    size_t               used         = 0;
+    bool                 unavailable  = false; // Executable memory could not be allocated.
+    std::exception_ptr   exc;                  // Exception caught by _JitStep.
+  };
 
-    bool passed = _IsExclusiveLocal(memAddrDesc.physAddr, _ProcessorID(), size);
-    if (memAddrDesc.memAttrs.shareable)
-      passed = passed && _IsExclusiveGlobal(memAddrDesc.physAddr, _ProcessorID(), size);
+  // Upper bound on the size of the code generated for one instruction.
+  static constexpr size_t JIT_MAX_INSTR_CODE = 128;
 
-    if (passed)
-      _ClearExclusiveLocal(_ProcessorID());
+  /* _JitRun {{{4
+   * -------
+   * Runs the translated code for a block. Returns the number of instructions
+   * processed.
+   */
+  int _JitRun(const Block &b) {
+    if (_GetITSTATE() != _bc.arena[b.first].itstate)
+      return _RunBlock(b);
+
+    // Translated code reads and writes the flags in xpsr directly.
+    _SyncFlags();
+    _BeginBlock();
+    int n = b.code();
+    if unlikely (_jit.exc) {
+      std::exception_ptr exc = std::move(_jit.exc);
+      _jit.exc = nullptr;
+      std::rethrow_exception(exc);
+    }
 
-    return passed;
+    return n;
   }
 
-  /* _IsExclusiveGlobal {{{4
-   * ------------------
-   * Checks if PE has marked in a global record an address range as an
-   * "exclusive access requested" that covers at least the size bytes from
-   * address.
+  /* _JitStep {{{4
+   * --------
+   * Called from translated code to execute one instruction via _BlockStep.
+   * Returns nonzero if the block ends after this instruction.
    */
-  bool _IsExclusiveGlobal(uint32_t addr, int processorID, int size) {
-    auto lk = _gm.Lock();
-    return _gm.IsExclusive(addr, processorID, size);
+  static int _JitStep(Simulator *sim, const DecodedInstr *di, uint32_t pc, uint32_t last, const Block *b) noexcept {
+    try {
+      // Natively translated instructions do not commit the PC.
+      sim->_s.pc = pc;
+      int r = sim->_BlockStep(*b, *di, pc, last);
+      sim->_SyncFlags();
+      return r;
+    } catch (...) {
+      sim->_jit.exc = std::current_exception();
+      return 1;
+    }
   }
 
-  /* _IsExclusiveLocal {{{4
-   * -----------------
-   * Checks if PE has marked in a local record an address range as an
-   * "exclusive access requested" that covers at least the size bytes from
-   * address.
+  /* _JitCompile {{{4
+   * -----------
+   * Translates a block, setting b.code on success.
    */
-  bool _IsExclusiveLocal(uint32_t addr, int processorID, int size) {
-    return _lm.IsExclusive(addr, size);
-  }
+  void _JitCompile(Block &b) {
+    if (_jit.unavailable)
+      return;
 
-  /* _CountLeadingZeroBits {{{4
-   * ---------------------
-   */
-  static uint32_t _CountLeadingZeroBits(uint32_t x) {
-    return x ? __builtin_clz(x) : 32;
+    if (!_jit.buf) {
+      void *p = mmap(nullptr, JIT_CODE_SIZE, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+      if (p == MAP_FAILED) {
+        TRACE("cannot allocate JIT buffer, using block engine\n");
+        _jit.unavailable = true;
+        return;
+      }
+      _jit.buf = static_cast<uint8_t *>(p);
+    }
+
+    if (_jit.used + (b.count + 1)*JIT_MAX_INSTR_CODE > JIT_CODE_SIZE)
+      _JitFlush();
+
+    using E = X64Emitter;
+    uint8_t *start = _jit.buf + _jit.used;
+    size_t   limit = (b.count + 1)*JIT_MAX_INSTR_CODE;
+    if (!_JitProtect(start, limit, PROT_READ|PROT_WRITE)) {
+      TRACE("cannot make JIT buffer writable, using block engine\n");
+      _jit.unavailable = true;
+      return;
+    }
+
+    E e(start);
+
+    // RBX holds the Simulator pointer throughout. Pushing it also aligns the
+    // stack for calls.
+    e.PushRBX();
+    e.MovImm64(E::EBX, reinterpret_cast<uintptr_t>(this));
+
+    const DecodedInstr *di = &_bc.arena[b.first];
+    uint32_t pc = b.pc;
+    for (uint32_t i=0; i<b.count; ++i, ++di) {
+      bool last = (i+1 == b.count);
+      if (last || !_JitInline(e, *di)) {
+        e.MovRDIRBX();
+        e.MovImm64(E::ESI, reinterpret_cast<uintptr_t>(di));
+        e.MovImm32(E::EDX, pc);
+        e.MovImm32(E::ECX, last);
+        e.MovImm64(0, reinterpret_cast<uintptr_t>(&b), true); // R8
+        e.MovImm64(E::EAX, reinterpret_cast<uintptr_t>(&_JitStep));
+        e.CallRAX();
+        if (!last) {
+          e.TestEAX();
+          e.JzRel8(7);
+        }
+        e.MovImm32(E::EAX, i+1);
+        e.PopRBX();
+        e.Ret();
+      }
+
+      pc += di->instr > 0xFFFF ? 4 : 2;
+    }
+
+    ASSERT(size_t(e.p - start) <= limit);
+    if (!_JitProtect(start, limit, PROT_READ|PROT_EXEC)) {
+      TRACE("cannot make JIT buffer executable, using block engine\n");
+      _jit.unavailable = true;
+      return;
+    }
+
+    _jit.used += e.p - start;
+    b.code     = reinterpret_cast<JitFn>(start);
   }
 
-  /* _IntegerZeroDivideTrappingEnabled {{{4
-   * ---------------------------------
+  /* _JitProtect {{{4
+   * -----------
+   * Changes the protection of the pages of the code buffer spanned by
+   * [p, p+len), clamped to the end of the buffer.
    */
-  bool _IntegerZeroDivideTrappingEnabled() {
-    // DIV_0_TRP bit in CCR is RAZ/WI if the Main Extension is not implememented
-    return !!(InternalLoad32(REG_CCR) & REG_CCR__DIV_0_TRP);
+  bool _JitProtect(uint8_t *p, size_t len, int prot) {
+    static const size_t pageSize = sysconf(_SC_PAGESIZE);
+
+    uintptr_t lo = reinterpret_cast<uintptr_t>(p) & ~(pageSize - 1);
+    uintptr_t hi = std::min(reinterpret_cast<uintptr_t>(p) + len, reinterpret_cast<uintptr_t>(_jit.buf) + JIT_CODE_SIZE);
+    return mprotect(reinterpret_cast<void *>(lo), hi - lo, prot) == 0;
   }
 
-  /* _GenerateIntegerZeroDivide {{{4
-   * --------------------------
-   */
-  void _GenerateIntegerZeroDivide() {
-    InternalOr32(REG_CFSR, REG_CFSR__UFSR__DIVBYZERO);
+  /* _JitInline {{{4
+   * ----------
+   * Emits native code for an instruction if it is one of those classified by
+   * _ClassifyFastOp. Returns false if it is not.
+   */
+  bool _JitInline(X64Emitter &e, const DecodedInstr &di) {
+    using E = X64Emitter;
+    using S = Simulator;
+
+    switch (di.fastOp) {
+      case DI_FAST__MOV_IMM: {
+        auto [d, setflags, imm32, carry] = _DecodedArgs<&S::_Exec_MOV_immediate>(di);
+        e.MovImm32(E::EAX, imm32);
+        e.Store(_JitRegOffset(d), E::EAX);
+        if (setflags) {
+          // The flags are known now.
+          int32_t xpsr = _JitOffset(&_s.xpsr);
+          e.AndMem(xpsr, ~uint32_t(XPSR__N | XPSR__Z | XPSR__C));
+          e.OrMem(xpsr, PUTBITSM(GETBIT(imm32, 31), XPSR__N) | PUTBITSM(imm32 == 0, XPSR__Z) | PUTBITSM(carry, XPSR__C));
+        }
+        return true;
+      }
 
-    auto excInfo = _CreateException(UsageFault, false, UNKNOWN_VAL(false));
-    _HandleException(excInfo);
+      case DI_FAST__MOV_REG: {
+        auto [d, m, setflags, shiftT, shiftN] = _DecodedArgs<&S::_Exec_MOV_register>(di);
+        e.Load(E::EAX, _JitRegOffset(m));
+        e.Store(_JitRegOffset(d), E::EAX);
+        if (setflags) {
+          e.TestEAX();
+          _JitEmitFlags(e, false, false);
+        }
+        return true;
+      }
+
+      case DI_FAST__ADD_IMM:
+        _JitInlineImm(e, E::OP_ADD, _DecodedArgs<&S::_Exec_ADD_immediate>(di));
+        return true;
+      case DI_FAST__SUB_IMM:
+        _JitInlineImm(e, E::OP_SUB, _DecodedArgs<&S::_Exec_SUB_immediate>(di));
+        return true;
+      case DI_FAST__CMP_IMM: {
+        auto [n, imm32] = _DecodedArgs<&S::_Exec_CMP_immediate>(di);
+        _JitInlineImm(e, E::OP_CMP, {0, n, true, imm32});
+        return true;
+      }
+
+      case DI_FAST__ADD_REG:
+        _JitInlineReg(e, E::OP_ADD, _DecodedArgs<&S::_Exec_ADD_register>(di));
+        return true;
+      case DI_FAST__SUB_REG:
+        _JitInlineReg(e, E::OP_SUB, _DecodedArgs<&S::_Exec_SUB_register>(di));
+        return true;
+      case DI_FAST__CMP_REG: {
+        auto [n, m, shiftT, shiftN] = _DecodedArgs<&S::_Exec_CMP_register>(di);
+        _JitInlineReg(e, E::OP_CMP, {0, n, m, true, shiftT, shiftN});
+        return true;
+      }
+      case DI_FAST__CMN_IMM: {
+        auto [n, imm32] = _DecodedArgs<&S::_Exec_CMN_immediate>(di);
+        _JitInlineImm(e, E::OP_ADD, {0, n, true, imm32}, false);
+        return true;
+      }
+      case DI_FAST__CMN_REG: {
+        auto [n, m, shiftT, shiftN] = _DecodedArgs<&S::_Exec_CMN_register>(di);
+        _JitInlineReg(e, E::OP_ADD, {0, n, m, true, shiftT, shiftN}, false);
+        return true;
+      }
+      case DI_FAST__AND_REG:
+        _JitInlineReg(e, E::OP_AND, _DecodedArgs<&S::_Exec_AND_register>(di));
+        return true;
+      case DI_FAST__ORR_REG:
+        _JitInlineReg(e, E::OP_OR,  _DecodedArgs<&S::_Exec_ORR_register>(di));
+        return true;
+      case DI_FAST__EOR_REG:
+        _JitInlineReg(e, E::OP_XOR, _DecodedArgs<&S::_Exec_EOR_register>(di));
+        return true;
+
+      default:
+        return false;
+    }
   }
 
-  /* _ExecuteCPCheck {{{4
-   * ---------------
+  /* _JitInlineImm {{{4
+   * -------------
+   * ADD, SUB or CMP with an immediate. For CMP, or if store is false (CMN),
+   * d is ignored.
    */
-  void _ExecuteCPCheck(int cp) {
-    // Check access to coprocessor is enabled.
-    auto excInfo = _CheckCPEnabled(cp);
-    _HandleException(excInfo);
+  void _JitInlineImm(X64Emitter &e, uint8_t op, const std::tuple<uint32_t, uint32_t, bool, uint32_t> &args, bool store=true) {
+    auto [d, n, setflags, imm32] = args;
+    e.Load(X64Emitter::EAX, _JitRegOffset(n));
+    e.AluImm(op, imm32);
+    if (store && op != X64Emitter::OP_CMP)
+      e.Store(_JitRegOffset(d), X64Emitter::EAX);
+    if (setflags)
+      _JitEmitFlags(e, true, op != X64Emitter::OP_ADD);
   }
 
-  /* _GenerateCoprocessorException {{{4
-   * -----------------------------
+  /* _JitInlineReg {{{4
+   * -------------
+   * ADD, SUB, CMP, AND, ORR or EOR with an unshifted register. For CMP, or if
+   * store is false (CMN), d is ignored. A shift by zero leaves APSR.C
+   * unchanged for the logical operations.
    */
-  void _GenerateCoprocessorException() {
-    InternalOr32(REG_CFSR, REG_CFSR__UFSR__UNDEFINSTR);
-    auto excInfo = _CreateException(UsageFault, false, UNKNOWN_VAL(false));
-    _HandleException(excInfo);
-  }
+  void _JitInlineReg(X64Emitter &e, uint8_t op, const std::tuple<uint32_t, uint32_t, uint32_t, bool, SRType, uint32_t> &args, bool store=true) {
+    using E = X64Emitter;
 
-  /* _Coproc_Accepted {{{4
-   * ----------------
-   */
-  bool _Coproc_Accepted(int cpNum, uint32_t instr) {
-    // TODO
-    return false;
+    auto [d, n, m, setflags, shiftT, shiftN] = args;
+    e.Load(E::EAX, _JitRegOffset(n));
+    e.Load(E::ECX, _JitRegOffset(m));
+    e.AluRR(op);
+    if (store && op != E::OP_CMP)
+      e.Store(_JitRegOffset(d), E::EAX);
+    if (setflags)
+      _JitEmitFlags(e, op == E::OP_ADD || op == E::OP_SUB || op == E::OP_CMP, op != E::OP_ADD);
   }
 
-  /* _Coproc_DoneLoading {{{4
-   * -------------------
-   * Check whether enough 32-bit words have been loaded for an LDC instruction.
-   */
-  bool _Coproc_DoneLoading(int cpNum, uint32_t instr) {
-    // TODO
-    return true;
-  }
+  /* _JitEmitFlags {{{4
+   * -------------
+   * Copies the host flags set by the preceding instruction to APSR.N and
+   * APSR.Z, and also to APSR.C and APSR.V if nzcv is set. ARM's carry flag
+   * is the inverse of the host's for subtraction.
+   */
+  void _JitEmitFlags(X64Emitter &e, bool nzcv, bool sub) {
+    using E = X64Emitter;
+
+    int32_t xpsr = _JitOffset(&_s.xpsr);
+    e.Setcc(E::CC_S, E::ECX);
+    e.Setcc(E::CC_E, E::EDX);
+    if (nzcv) {
+      e.Setcc(sub ? E::CC_AE : E::CC_B, E::ESI);
+      e.Setcc(E::CC_O, E::EDI);
+    }
 
-  /* _Coproc_DoneStoring {{{4
-   * -------------------
-   * Check whether enough 32-bit words have been stored for a STC instruction.
-   */
-  bool _Coproc_DoneStoring(int cpNum, uint32_t instr) {
-    // TODO
-    return true;
+    e.Movzx8(E::ECX);
+    e.Shl(E::ECX, MASK_TO_SHIFT(XPSR__N));
+    e.Movzx8(E::EDX);
+    e.Shl(E::EDX, MASK_TO_SHIFT(XPSR__Z));
+    e.Or(E::ECX, E::EDX);
+    if (nzcv) {
+      e.Movzx8(E::ESI);
+      e.Shl(E::ESI, MASK_TO_SHIFT(XPSR__C));
+      e.Or(E::ECX, E::ESI);
+      e.Movzx8(E::EDI);
+      e.Shl(E::EDI, MASK_TO_SHIFT(XPSR__V));
+      e.Or(E::ECX, E::EDI);
+    }
+
+    e.Load(E::EDX, xpsr);
+    e.AndImm(E::EDX, ~uint32_t(XPSR__N | XPSR__Z | (nzcv ? XPSR__C | XPSR__V : 0)));
+    e.Or(E::EDX, E::ECX);
+    e.Store(xpsr, E::EDX);
   }
 
-  /* _Coproc_GetOneWord {{{4
-   * ------------------
-   * Gets the 32-bit word for an MRC instruction from the coprocessor.
+  /* _JitRegOffset {{{4
+   * -------------
    */
-  uint32_t _Coproc_GetOneWord(int cpNum, uint32_t instr) {
-    return 0xFFFF'FFFF; // TODO
+  int32_t _JitRegOffset(uint32_t r) {
+    return _JitOffset(&_s.r[r == 14 ? RName_LR : RName(r)]);
   }
 
-  /* _Coproc_GetTwoWords {{{4
-   * -------------------
-   * Get two 32-bit words for an MRRC instruction from the coprocessor.
+  /* _JitOffset {{{4
+   * ----------
+   * Returns the offset of a member from this, as addressed by translated
+   * code relative to RBX.
    */
-  std::tuple<uint32_t, uint32_t> _Coproc_GetTwoWords(int cpNum, uint32_t instr) {
-    return {0xFFFF'FFFF, 0xFFFF'FFFF}; // TODO
+  int32_t _JitOffset(const void *p) {
+    return int32_t(static_cast<const char *>(p) - reinterpret_cast<const char *>(this));
   }
 
-  /* _Coproc_GetWordToStore {{{4
-   * ----------------------
-   * Gets the next 32-bit word to store for a STC instruction from the coprocessor.
+  /* _JitFlush {{{4
+   * ---------
+   * Discards all translated code.
    */
-  uint32_t _Coproc_GetWordToStore(int cpNum, uint32_t instr) {
-    return 0xFFFF'FFFF; // TODO
+  void _JitFlush() {
+    _jit.used = 0;
+    for (size_t i=0; i<BLOCK_CACHE_SIZE; ++i) {
+      _bc.blocks[i].code = nullptr;
+      _bc.blocks[i].runs = 0;
+    }
   }
+#endif
 
-  /* _Coproc_InternalOperation {{{4
-   * -------------------------
-   * Instructs a coprocessor to perform the internal operation requested by a
-   * CDP instruction.
+  /* _DecodeExecute {{{3
+   * --------------
+   * This function is not defined by the ISA definition and must be generated
+   * from all of the instruction definitions. Our actual implementation is in
+   * _DecodeExecute(16|32) and wrapped by this.
    */
-  void _Coproc_InternalOperation(int cpNum, uint32_t instr) {
-    // TODO
+  void _DecodeExecute(uint32_t instr, uint32_t pc, bool is16bit) {
+    if (is16bit)
+      (this->*_LookUpDecoder16(instr))(instr, pc);
+    else
+      _DecodeExecute32(instr, pc);
   }
 
-  /* _Coproc_SendLoadedWord {{{4
-   * ----------------------
-   * Sends a loaded 32-bit word for an LDC instruction to the coprocessor.
+  /* Decode Table (16-Bit Instructions) {{{3
+   * ==================================
+   * The decoder tree below takes up to five levels of switches and calls to
+   * reach the routine which decodes a given 16-bit instruction. The table
+   * generated here maps each halfword directly to that final routine, so
+   * that _DecodeExecute can reach it in one indexed call.
+   *
+   * The tree remains the reference: _Route16 mirrors its non-leaf functions
+   * (those which only select another decoder, or are UNDEFINED), and
+   * CheckDecodeTable verifies the table against the tree.
+   */
+  using Decoder16 = void (Simulator::*)(uint32_t instr, uint32_t pc);
+
+  // All leaf decoders of the 16-bit tree, by the suffix of their names.
+#define DECODERS16(X)                                                     \
+  X(Undefined)                                                            \
+  X(000xxx)           X(000110_0)         X(000110_1)                     \
+  X(000111_0)         X(000111_1)                                         \
+  X(00100x)           X(00101x)           X(00110x)           X(00111x)   \
+  X(010000_0000)      X(010000_0001)      X(010000_0xxx_MOVsh)            \
+  X(010000_0101)      X(010000_0110)      X(010000_1000)      X(010000_1001) \
+  X(010000_1010)      X(010000_1011)      X(010000_1100)      X(010000_1101) \
+  X(010000_1110)      X(010000_1111)                                      \
+  X(010001_11_0)      X(010001_11_1)      X(010001_10)                    \
+  X(010001_00_a)      X(010001_00_b)      X(010001_00_c)      X(010001_01) \
+  X(01001x)                                                               \
+  X(010100_0)         X(010100_1)         X(010101_0)         X(010101_1) \
+  X(010110_0)         X(010110_1)         X(010111_0)         X(010111_1) \
+  X(01100x)           X(01101x)           X(01110x)           X(01111x)   \
+  X(10000x)           X(10001x)           X(10010x)           X(10011x)   \
+  X(1010xx_0)         X(1010xx_1)                                         \
+  X(101100_00_0)      X(101100_00_1)                                      \
+  X(101100_10_00)     X(101100_10_01)     X(101100_10_10)     X(101100_10_11) \
+  X(101101)           X(101101_10_01_1)   X(1011x0_xx)                    \
+  X(101110_10_00)     X(101110_10_01)     X(101110_10_11)                 \
+  X(101111)           X(101111_10)        X(101111_11_xxxx)               \
+  X(101111_11_0000_0000) X(101111_11_0000_0001) X(101111_11_0000_0010)    \
+  X(101111_11_0000_0011) X(101111_11_0000_0100) X(101111_11_0000_xxxx)    \
+  X(11000x)           X(11001x)                                           \
+  X(110111_10)        X(110111_11)        X(1101xx_xx)                    \
+  X(11100)                                                             /**/
+
+#define X(Name) D16_##Name,
+  enum :uint8_t { DECODERS16(X) };
+#undef X
+
+  /* _Route16 {{{4
+   * --------
+   * Returns the D16_* index of the leaf decoder which the tree reaches for a
+   * 16-bit instruction. 32-bit prefixes map to D16_Undefined, but are never
+   * looked up.
    */
-  void _Coproc_SendLoadedWord(uint32_t word, int cpNum, uint32_t instr) {
-    // TODO
+  static constexpr uint8_t _Route16(uint32_t instr) {
+    switch (GETBITS(instr,10,15)) {
+      case 0b00'0000: case 0b00'0001: case 0b00'0010: case 0b00'0011:
+      case 0b00'0100: case 0b00'0101:
+        // _DecodeExecute16_000xxx
+        return D16_000xxx;
+
+      case 0b00'0110:
+        // _DecodeExecute16_000110
+        return GETBIT(instr,9) ? D16_000110_1 : D16_000110_0;
+
+      case 0b00'0111:
+        // _DecodeExecute16_000111
+        return GETBIT(instr,9) ? D16_000111_1 : D16_000111_0;
+
+      case 0b00'1000: case 0b00'1001: case 0b00'1010: case 0b00'1011:
+      case 0b00'1100: case 0b00'1101: case 0b00'1110: case 0b00'1111:
+        // _DecodeExecute16_001xxx
+        switch (GETBITS(instr,11,12)) {
+          case 0b00:  return D16_00100x;
+          case 0b01:  return D16_00101x;
+          case 0b10:  return D16_00110x;
+          default:    return D16_00111x;
+        }
+
+      case 0b01'0000:
+        // _DecodeExecute16_010000
+        switch (GETBITS(instr,6,9)) {
+          case 0b0000: return D16_010000_0000;
+          case 0b0001: return D16_010000_0001;
+          case 0b0101: return D16_010000_0101;
+          case 0b0110: return D16_010000_0110;
+          case 0b1000: return D16_010000_1000;
+          case 0b1001: return D16_010000_1001;
+          case 0b1010: return D16_010000_1010;
+          case 0b1011: return D16_010000_1011;
+          case 0b1100: return D16_010000_1100;
+          case 0b1101: return D16_010000_1101;
+          case 0b1110: return D16_010000_1110;
+          case 0b1111: return D16_010000_1111;
+          default:     return D16_010000_0xxx_MOVsh;
+        }
+
+      case 0b01'0001:
+        // _DecodeExecute16_010001, _DecodeExecute16_010001_11,
+        // _DecodeExecute16_010001_xx
+        switch (GETBITS(instr,8,9)) {
+          case 0b00:
+            if (GETBITS(instr,3,6) == 0b1101)
+              return D16_010001_00_a;
+            else if (((GETBIT(instr,7)<<3) | GETBITS(instr,0,2)) == 0b1101)
+              return D16_010001_00_b;
+            else
+              return D16_010001_00_c;
+          case 0b01:  return D16_010001_01;
+          case 0b10:  return D16_010001_10;
+          default:    return GETBIT(instr,7) ? D16_010001_11_1 : D16_010001_11_0;
+        }
+
+      case 0b01'0010: case 0b01'0011:
+        return D16_01001x;
+
+      case 0b01'0100: case 0b01'0101: case 0b01'0110: case 0b01'0111:
+        // _DecodeExecute16_0101xx
+        switch (GETBITS(instr,9,11)) {
+          case 0b0'0'0: return D16_010100_0;
+          case 0b0'0'1: return D16_010100_1;
+          case 0b0'1'0: return D16_010101_0;
+          case 0b0'1'1: return D16_010101_1;
+          case 0b1'0'0: return D16_010110_0;
+          case 0b1'0'1: return D16_010110_1;
+          case 0b1'1'0: return D16_010111_0;
+          default:      return D16_010111_1;
+        }
+
+      case 0b01'1000: case 0b01'1001: case 0b01'1010: case 0b01'1011:
+      case 0b01'1100: case 0b01'1101: case 0b01'1110: case 0b01'1111:
+        // _DecodeExecute16_011xxx
+        switch (GETBITS(instr,11,12)) {
+          case 0b00:  return D16_01100x;
+          case 0b01:  return D16_01101x;
+          case 0b10:  return D16_01110x;
+          default:    return D16_01111x;
+        }
+
+      case 0b10'0000: case 0b10'0001: case 0b10'0010: case 0b10'0011:
+        // _DecodeExecute16_1000xx
+        return GETBIT(instr,11) ? D16_10001x : D16_10000x;
+
+      case 0b10'0100: case 0b10'0101: case 0b10'0110: case 0b10'0111:
+        // _DecodeExecute16_1001xx
+        return GETBIT(instr,11) ? D16_10011x : D16_10010x;
+
+      case 0b10'1000: case 0b10'1001: case 0b10'1010: case 0b10'1011:
+        // _DecodeExecute16_1010xx
+        return GETBIT(instr,11) ? D16_1010xx_1 : D16_1010xx_0;
+
+      case 0b10'1100: case 0b10'1101: case 0b10'1110: case 0b10'1111:
+        return _Route16_1011xx(instr);
+
+      case 0b11'0000: case 0b11'0001: case 0b11'0010: case 0b11'0011:
+        // _DecodeExecute16_1100xx
+        return GETBIT(instr,11) ? D16_11001x : D16_11000x;
+
+      case 0b11'0100: case 0b11'0101: case 0b11'0110: case 0b11'0111:
+        // _DecodeExecute16_1101xx, _DecodeExecute16_110111_1x
+        if (GETBITS(instr,9,11) == 0b111)
+          return GETBIT(instr,8) ? D16_110111_11 : D16_110111_10;
+        return D16_1101xx_xx;
+
+      case 0b11'1000: case 0b11'1001:
+        return D16_11100;
+
+      default:
+        return D16_Undefined;
+    }
   }
 
-  /* _Coproc_SendOneWord {{{4
-   * -------------------
-   * Sends the 32-bit word for an MCR instruction to the coprocessor.
+  /* _Route16_1011xx {{{4
+   * ---------------
+   * Miscellaneous 16-bit instructions. Mirrors _DecodeExecute16_1011xx and
+   * the non-leaf decoders below it.
    */
-  void _Coproc_SendOneWord(uint32_t word, int cpNum, uint32_t instr) {
-    // TODO
+  static constexpr uint8_t _Route16_1011xx(uint32_t instr) {
+    uint32_t op1 = GETBITS(instr, 6, 7);
+    uint32_t op2 = GETBITS(instr, 5, 5);
+    uint32_t op3 = GETBITS(instr, 0, 3);
+
+    switch (GETBITS(instr,8,11)) {
+      case 0b0000:
+        // _DecodeExecute16_101100_00
+        return GETBIT(instr,7) ? D16_101100_00_1 : D16_101100_00_0;
+
+      case 0b0010:
+        // _DecodeExecute16_101100_10
+        switch (op1) {
+          case 0b00:  return D16_101100_10_00;
+          case 0b01:  return D16_101100_10_01;
+          case 0b10:  return D16_101100_10_10;
+          default:    return D16_101100_10_11;
+        }
+
+      case 0b0110:
+        return (op1 == 0b01 && op2) ? D16_101101_10_01_1 : D16_Undefined;
+
+      case 0b0111:
+      case 0b1000:
+        return D16_Undefined;
+
+      case 0b1010:
+        // _DecodeExecute16_101110_10
+        switch (op1) {
+          case 0b00:  return D16_101110_10_00;
+          case 0b01:  return D16_101110_10_01;
+          case 0b11:  return D16_101110_10_11;
+          default:    return D16_Undefined;
+        }
+
+      case 0b1110:
+        return D16_101111_10;
+
+      case 0b1111:
+        if (op3)
+          return D16_101111_11_xxxx;
+
+        // _DecodeExecute16_101111_11_0000
+        switch (GETBITS(instr,4,7)) {
+          case 0b0000: return D16_101111_11_0000_0000;
+          case 0b0001: return D16_101111_11_0000_0001;
+          case 0b0010: return D16_101111_11_0000_0010;
+          case 0b0011: return D16_101111_11_0000_0011;
+          case 0b0100: return D16_101111_11_0000_0100;
+          default:     return D16_101111_11_0000_xxxx;
+        }
+
+      case 0b0001: case 0b0011: case 0b1001: case 0b1011:
+        return D16_1011x0_xx;
+
+      default: // 0b0100, 0b0101, 0b1100, 0b1101
+        // _DecodeExecute16_1011x1_0
+        return GETBIT(instr,11) ? D16_101111 : D16_101101;
+    }
   }
 
-  /* _Coproc_SendTwoWords {{{4
-   * --------------------
-   * Send two 32-bit words for an MCRR instruction to the coprocessor.
+  /* _MakeDecodeTable16 {{{4
+   * ------------------
    */
-  void _Coproc_SendTwoWords(uint32_t word2, uint32_t word1, int cpNum, uint32_t instr) {
-    // TODO
+  static constexpr std::array<uint8_t, 0x10000> _MakeDecodeTable16() {
+    std::array<uint8_t, 0x10000> table{};
+    for (uint32_t instr=0; instr<0x10000; ++instr)
+      table[instr] = _Route16(instr);
+    return table;
   }
 
-  /* _UnsignedSatQ {{{4
-   * -------------
+  /* _LookUpDecoder16 {{{4
+   * ----------------
+   * Returns the leaf decoder for a 16-bit instruction.
    */
-  std::tuple<uint32_t, bool> _UnsignedSatQ(uint32_t i, int N) {
-    uint32_t result;
-    bool     saturated;
+  static Decoder16 _LookUpDecoder16(uint32_t instr) {
+#define X(Name) &Simulator::_DecodeExecute16_##Name,
+    static constexpr Decoder16 decoders[] = { DECODERS16(X) };
+#undef X
+    static constexpr std::array<uint8_t, 0x10000> table = _MakeDecodeTable16();
 
-    if (i > (BIT(N)-1)) {
-      result    = BIT(N)-1;
-      saturated = true;
-    } else if (i < 0) { // no-op
-      result    = 0;
-      saturated = true;
-    } else {
-      result    = i;
-      saturated = false;
-    }
+    return decoders[table[instr]];
+  }
 
-    return {GETBITS(result, 0, N-1), saturated};
+  /* _DecodeExecute16_Undefined {{{4
+   * --------------------------
+   * Encodings the decoder tree rejects before reaching a leaf.
+   */
+  void _DecodeExecute16_Undefined(uint32_t instr, uint32_t pc) {
+    UNDEFINED_DEC();
   }
 
-  /* _SignedSatQ {{{4
-   * -----------
+  /* _ProbeDecode {{{4
+   * ------------
+   * Runs a decoder without executing the instruction. Returns the call it
+   * would have made, or the type of exception it threw. Used by
+   * CheckDecodeTable.
    */
-  std::tuple<int32_t, bool> _SignedSatQ(uint32_t i, int N) {
-    uint32_t result;
-    bool     saturated;
+  struct ProbeResult {
+    DecodedInstr  di;
+    int           exc = -1; // ExceptionType, or -1 if none.
+  };
 
-    if (int32_t(i) > (int32_t)(BIT(N-1)-1)) {
-      result    = BIT(N-1)-1;
-      saturated = true;
-    } else if (int32_t(i) < -(int32_t)BIT(N-1)) {
-      result    = -BIT(N-1);
-      saturated = true;
-    } else {
-      result    = i;
-      saturated = false;
-    }
+  ProbeResult _ProbeDecode(Decoder16 decoder, uint32_t instr) {
+    ProbeResult r;
+    memset(r.di.ops, 0, sizeof(r.di.ops));
+    r.di.handler      = nullptr;
+    r.di.condOverride = -1;
+    r.di.flags        = 0;
 
-    return {GETBITS(result, 0, N-1), saturated};
-  }
+    _s.curCondOverride = -1;
+    _dc.fill    = &r.di;
+    _dc.fillPC  = 0;
+    _dc.probe   = true;
+    try {
+      (this->*decoder)(instr, 0);
+    } catch (const Exception &e) {
+      r.exc = int(e.GetType());
+    }
 
-  /* _DecodeExecute {{{3
-   * --------------
-   * This function is not defined by the ISA definition and must be generated
-   * from all of the instruction definitions. Our actual implementation is in
-   * _DecodeExecute(16|32) and wrapped by this.
-   */
-  void _DecodeExecute(uint32_t instr, uint32_t pc, bool is16bit) {
-    if (is16bit)
-      _DecodeExecute16(instr, pc);
-    else
-      _DecodeExecute32(instr, pc);
+    _dc.fill  = nullptr;
+    _dc.probe = false;
+    _dc.last  = nullptr;
+    return r;
   }
 
   /* Decode/Execute (16-Bit Instructions) {{{3
@@ -8936,7 +12800,7 @@ private:
     TRACEI(MOV_reg, T2, "d=%u m=%u S=%u shiftT=%u shiftN=%u", d, m, setflags, shiftT, shiftN);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_MOV_register(d, m, setflags, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_MOV_register>(d, m, setflags, shiftT, shiftN);
   }
 
   /* _DecodeExecute16_000110 {{{4
@@ -8975,7 +12839,7 @@ private:
     TRACEI(ADD_reg, T1, "d=%u n=%u m=%u S=%u shiftT=%u shiftN=%u", d, n, m, setflags, shiftT, shiftN);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_ADD_register(d, n, m, setflags, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_ADD_register>(d, n, m, setflags, shiftT, shiftN);
   }
 
   /* _DecodeExecute16_000110_1 {{{4
@@ -8998,7 +12862,7 @@ private:
     TRACEI(SUB_reg, T1, "d=%u n=%u m=%u S=%u shiftT=%u shiftN=%u", d, n, m, setflags, shiftT, shiftN);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_SUB_register(d, n, m, setflags, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_SUB_register>(d, n, m, setflags, shiftT, shiftN);
   }
 
   /* _DecodeExecute16_000111 {{{4
@@ -9035,7 +12899,7 @@ private:
     TRACEI(ADD_imm, T1, "d=%u n=%u S=%u imm32=0x%x", d, n, setflags, imm32);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_ADD_immediate(d, n, setflags, imm32);
+    _Dispatch<&Simulator::_Exec_ADD_immediate>(d, n, setflags, imm32);
   }
 
   /* _DecodeExecute16_000111_1 {{{4
@@ -9056,7 +12920,7 @@ private:
     TRACEI(SUB_imm, T1, "d=%u n=%u S=%u imm32=0x%x", d, n, setflags, imm32);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_SUB_immediate(d, n, setflags, imm32);
+    _Dispatch<&Simulator::_Exec_SUB_immediate>(d, n, setflags, imm32);
   }
 
   /* _DecodeExecute16_00100x {{{4
@@ -9071,12 +12935,12 @@ private:
     uint32_t  d         = Rd;
     bool      setflags  = !_InITBlock();
     uint32_t  imm32     = _ZeroExtend(imm8, 32);
-    bool      carry     = GETBITSM(_s.xpsr, XPSR__C);
+    bool      carry     = _DecodeCarry();
 
     TRACEI(MOV_imm, T1, "d=%u S=%u imm32=0x%x carry=%u", d, setflags, imm32, carry);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_MOV_immediate(d, setflags, imm32, carry);
+    _Dispatch<&Simulator::_Exec_MOV_immediate>(d, setflags, imm32, carry);
   }
 
   /* _DecodeExecute16_00101x {{{4
@@ -9094,7 +12958,7 @@ private:
     TRACEI(CMP_imm, T1, "n=%u imm32=0x%x R[n]=0x%x", n, imm32, _GetR(n));
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_CMP_immediate(n, imm32);
+    _Dispatch<&Simulator::_Exec_CMP_immediate>(n, imm32);
   }
 
   /* _DecodeExecute16_00110x {{{4
@@ -9114,7 +12978,7 @@ private:
     TRACEI(ADD_imm, T2, "d/n=%u S=%u imm32=0x%x", d, setflags, imm32);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_ADD_immediate(d, n, setflags, imm32);
+    _Dispatch<&Simulator::_Exec_ADD_immediate>(d, n, setflags, imm32);
   }
 
   /* _DecodeExecute16_00111x {{{4
@@ -9134,7 +12998,7 @@ private:
     TRACEI(SUB_imm, T2, "d=%u n=%u S=%u imm32=0x%x", d, n, setflags, imm32);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_SUB_immediate(d, n, setflags, imm32);
+    _Dispatch<&Simulator::_Exec_SUB_immediate>(d, n, setflags, imm32);
   }
 
   /* _DecodeExecute16_001xxx {{{4
@@ -9285,7 +13149,7 @@ private:
     TRACEI(AND_reg, T1, "d=%u n=%u m=%u S=%u shiftT=%u shiftN=%u", d, n, m, setflags, shiftT, shiftN);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_AND_register(d, n, m, setflags, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_AND_register>(d, n, m, setflags, shiftT, shiftN);
   }
 
   /* _DecodeExecute16_010000_0001 {{{4
@@ -9307,7 +13171,7 @@ private:
     TRACEI(EOR_reg, T1, "d=%u n=%u m=%u S=%u shiftT=%u shiftN=%u", d, n, m, setflags, shiftT, shiftN);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_EOR_register(d, n, m, setflags, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_EOR_register>(d, n, m, setflags, shiftT, shiftN);
   }
 
   /* _DecodeExecute16_010000_0xxx_MOVsh {{{4
@@ -9331,7 +13195,7 @@ private:
     TRACEI(MOV_reg_shifted_reg, T1, "d=%u m=%u s=%u S=%u shiftT=%u", d, m, s, setflags, shiftT);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_MOV_MOVS_register_shifted_register(d, m, s, setflags, shiftT);
+    _Dispatch<&Simulator::_Exec_MOV_MOVS_register_shifted_register>(d, m, s, setflags, shiftT);
   }
 
   /* _DecodeExecute16_010000_0101 {{{4
@@ -9353,7 +13217,7 @@ private:
     TRACEI(ADC_reg, T1, "d=%u n=%u m=%u S=%u shiftT=%u shiftN=%u", d, n, m, setflags, shiftT, shiftN);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_ADC_register(d, n, m, setflags, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_ADC_register>(d, n, m, setflags, shiftT, shiftN);
   }
 
   /* _DecodeExecute16_010000_0110 {{{4
@@ -9375,7 +13239,7 @@ private:
     TRACEI(SBC_reg, T1, "d=%u n=%u m=%u S=%u shiftT=%u shiftN=%u", d, n, m, setflags, shiftT, shiftN);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_SBC_register(d, n, m, setflags, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_SBC_register>(d, n, m, setflags, shiftT, shiftN);
   }
 
   /* _DecodeExecute16_010000_1000 {{{4
@@ -9395,7 +13259,7 @@ private:
     TRACEI(TST_reg, T1, "n=%u m=%u shiftT=%u shiftN=%u", n, m, shiftT, shiftN);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_TST_register(n, m, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_TST_register>(n, m, shiftT, shiftN);
   }
 
   /* _DecodeExecute16_010000_1001 {{{4
@@ -9415,7 +13279,7 @@ private:
     TRACEI(RSB_imm, T1, "d=%u n=%u S=%u imm32=0x%x", d, n, setflags, imm32);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_RSB_immediate(d, n, setflags, imm32);
+    _Dispatch<&Simulator::_Exec_RSB_immediate>(d, n, setflags, imm32);
   }
 
   /* _DecodeExecute16_010000_1010 {{{4
@@ -9435,7 +13299,7 @@ private:
     TRACEI(CMP_reg, T1, "n=%u m=%u shiftT=%u shiftN=%u", n, m, shiftT, shiftN);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_CMP_register(n, m, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_CMP_register>(n, m, shiftT, shiftN);
   }
 
   /* _DecodeExecute16_010000_1011 {{{4
@@ -9455,7 +13319,7 @@ private:
     TRACEI(CMN_reg, T1, "n=%u m=%u shiftT=%u shiftN=%u", n, m, shiftT, shiftN);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_CMN_register(n, m, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_CMN_register>(n, m, shiftT, shiftN);
   }
 
   /* _DecodeExecute16_010000_1100 {{{4
@@ -9477,7 +13341,7 @@ private:
     TRACEI(ORR_reg, T1, "d/n=%u m=%u S=%u", d, m, setflags);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_ORR_register(d, n, m, setflags, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_ORR_register>(d, n, m, setflags, shiftT, shiftN);
   }
 
   /* _DecodeExecute16_010000_1101 {{{4
@@ -9497,7 +13361,7 @@ private:
     TRACEI(MUL, T1, "d=%u n=%u m=%u S=%u", d, n, m, setflags);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_MUL(d, n, m, setflags);
+    _Dispatch<&Simulator::_Exec_MUL>(d, n, m, setflags);
   }
 
   /* _DecodeExecute16_010000_1110 {{{4
@@ -9519,7 +13383,7 @@ private:
     TRACEI(BIC_reg, T1, "d=%u n=%u m=%u S=%u shiftT=%u shiftN=%u", d, n, m, setflags, shiftT, shiftN);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_BIC_register(d, n, m, setflags, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_BIC_register>(d, n, m, setflags, shiftT, shiftN);
   }
 
   /* _DecodeExecute16_010000_1111 {{{4
@@ -9540,7 +13404,7 @@ private:
     TRACEI(MVN_reg, T1, "d=%u m=%u S=%u shiftT=%u shiftN=%u", d, m, setflags, shiftT, shiftN);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_MVN_register(d, m, setflags, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_MVN_register>(d, m, setflags, shiftT, shiftN);
   }
 
   /* _DecodeExecute16_010001 {{{4
@@ -9604,7 +13468,7 @@ private:
     TRACEI(BX, T1, "m=%u allowNonSecure=%u R[m]=0x%x", m, allowNonSecure, _GetR(m));
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_BX(m, allowNonSecure);
+    _Dispatch<&Simulator::_Exec_BX>(m, allowNonSecure);
   }
 
   /* _DecodeExecute16_010001_11_1 {{{4
@@ -9633,7 +13497,7 @@ private:
     TRACEI(BLX, T1, "m=%u allowNonSecure=%u", m, allowNonSecure);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_BLX(m, allowNonSecure);
+    _Dispatch<&Simulator::_Exec_BLX>(m, allowNonSecure);
   }
 
   /* _DecodeExecute16_010001_10 {{{4
@@ -9659,7 +13523,7 @@ private:
     TRACEI(MOV_reg, T1, "d=%u m=%u", d, m);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_MOV_register(d, m, setflags, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_MOV_register>(d, m, setflags, shiftT, shiftN);
   }
 
   /* _DecodeExecute16_010001_xx {{{4
@@ -9726,7 +13590,7 @@ private:
     TRACEI(ADD_SP_plus_reg, T1, "d=%u m=%u S=%u shiftT=%u shiftN=%u", d, m, setflags, shiftT, shiftN);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_ADD_SP_plus_register(d, m, setflags, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_ADD_SP_plus_register>(d, m, setflags, shiftT, shiftN);
   }
 
   /* _DecodeExecute16_010001_00_b {{{4
@@ -9748,7 +13612,7 @@ private:
     TRACEI(ADD_SP_plus_reg, T2, "d=%u m=%u S=%u shiftT=%u shiftN=%u", d, m, setflags, shiftT, shiftN);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_ADD_SP_plus_register(d, m, setflags, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_ADD_SP_plus_register>(d, m, setflags, shiftT, shiftN);
   }
 
   /* _DecodeExecute16_010001_00_c {{{4
@@ -9781,7 +13645,7 @@ private:
     TRACEI(ADD_reg, T2, "d=%u n=%u m=%u S=%u shiftT=%u shiftN=%u", d, n, m, setflags, shiftT, shiftN);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_ADD_register(d, n, m, setflags, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_ADD_register>(d, n, m, setflags, shiftT, shiftN);
   }
 
   /* _DecodeExecute16_010001_01 {{{4
@@ -9809,7 +13673,7 @@ private:
     TRACEI(CMP_reg, T2, "n=%u m=%u shiftT=%u shiftN=%u", n, m, shiftT, shiftN);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_CMP_register(n, m, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_CMP_register>(n, m, shiftT, shiftN);
   }
 
   /* _DecodeExecute16_01001x {{{4
@@ -9828,7 +13692,7 @@ private:
     TRACEI(LDR_lit, T1, "t=%u imm32=0x%x", t, imm32);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDR_literal(t, imm32, add);
+    _Dispatch<&Simulator::_Exec_LDR_literal>(t, imm32, add);
   }
 
   /* _DecodeExecute16_0101xx {{{4
@@ -9909,7 +13773,7 @@ private:
     TRACEI(STR_reg, T1, "t=%u n=%u m=%u", t, n, m);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_STR_register(t, n, m, index, add, wback, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_STR_register>(t, n, m, index, add, wback, shiftT, shiftN);
   }
 
   /* _DecodeExecute16_010100_1 {{{4
@@ -9932,7 +13796,7 @@ private:
     TRACEI(STRH_reg, T1, "t=%u n=%u m=%u", t, n, m);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_STRH_register(t, n, m, index, add, wback, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_STRH_register>(t, n, m, index, add, wback, shiftT, shiftN);
   }
 
   /* _DecodeExecute16_010101_0 {{{4
@@ -9955,7 +13819,7 @@ private:
     TRACEI(STRB_reg, T1, "t=%u n=%u m=%u index=%u add=%u wback=%u shiftT=%u shiftN=%u", t, n, m, index, add, wback, shiftT, shiftN);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_STRB_register(t, n, m, index, add, wback, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_STRB_register>(t, n, m, index, add, wback, shiftT, shiftN);
   }
 
   /* _DecodeExecute16_010101_1 {{{4
@@ -9980,7 +13844,7 @@ private:
     TRACEI(LDRSB_reg, T1, "t=%u n=%u m=%u index=%u add=%u wback=%u shiftT=%u shiftN=%u", t, n, m, index, add, wback, shiftT, shiftN);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDRSB_register(t, n, m, index, add, wback, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_LDRSB_register>(t, n, m, index, add, wback, shiftT, shiftN);
   }
 
   /* _DecodeExecute16_010110_0 {{{4
@@ -10003,7 +13867,7 @@ private:
     TRACEI(LDR_reg, T1, "t=%u n=%u m=%u index=%u add=%u wback=%u shiftT=%u shiftN=%u", t, n, m, index, add, wback, shiftT, shiftN);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDR_register(t, n, m, index, add, wback, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_LDR_register>(t, n, m, index, add, wback, shiftT, shiftN);
   }
 
   /* _DecodeExecute16_010110_1 {{{4
@@ -10026,7 +13890,7 @@ private:
     TRACEI(LDRH_reg, T1, "t=%u n=%u m=%u index=%u add=%u wback=%u shiftT=%u shiftN=%u", t, n, m, index, add, wback, shiftT, shiftN);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDRH_register(t, n, m, index, add, wback, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_LDRH_register>(t, n, m, index, add, wback, shiftT, shiftN);
   }
 
   /* _DecodeExecute16_010111_0 {{{4
@@ -10049,7 +13913,7 @@ private:
     TRACEI(LDRB_reg, T1, "t=%u n=%u m=%u index=%u add=%u wback=%u shiftT=%u shiftN=%u", t, n, m, index, add, wback, shiftT, shiftN);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDRB_register(t, n, m, index, add, wback, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_LDRB_register>(t, n, m, index, add, wback, shiftT, shiftN);
   }
 
   /* _DecodeExecute16_010111_1 {{{4
@@ -10072,7 +13936,7 @@ private:
     TRACEI(LDRSH_reg, T1, "t=%u n=%u m=%u index=%u add=%u wback=%u shiftT=%u shiftN=%u", t, n, m, index, add, wback, shiftT, shiftN);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDRSH_register(t, n, m, index, add, wback, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_LDRSH_register>(t, n, m, index, add, wback, shiftT, shiftN);
   }
 
   /* _DecodeExecute16_011xxx {{{4
@@ -10128,7 +13992,7 @@ private:
     TRACEI(STRB_imm, T1, "t=%u n=%u imm32=0x%x index=%u add=%u wback=%u", t, n, imm32, index, add, wback);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_STRB_immediate(t, n, imm32, index, add, wback);
+    _Dispatch<&Simulator::_Exec_STRB_immediate>(t, n, imm32, index, add, wback);
   }
 
   /* _DecodeExecute16_01111x {{{4
@@ -10149,7 +14013,7 @@ private:
     TRACEI(LDRB_imm, T1, "t=%u n=%u imm32=0x%x", t, n, imm32);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDRB_immediate(t, n, imm32, index, add, wback);
+    _Dispatch<&Simulator::_Exec_LDRB_immediate>(t, n, imm32, index, add, wback);
   }
 
   /* _DecodeExecute16_01100x {{{4
@@ -10170,7 +14034,7 @@ private:
     TRACEI(STR_imm, T1, "t=%u n=%u imm32=0x%x", t, n, imm32);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_STR_immediate(t, n, imm32, index, add, wback);
+    _Dispatch<&Simulator::_Exec_STR_immediate>(t, n, imm32, index, add, wback);
   }
 
   /* _DecodeExecute16_01101x {{{4
@@ -10191,7 +14055,7 @@ private:
     TRACEI(LDR_imm, T1, "t=%u n=%u imm32=0x%x", t, n, imm32);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDR_immediate(t, n, imm32, index, add, wback);
+    _Dispatch<&Simulator::_Exec_LDR_immediate>(t, n, imm32, index, add, wback);
   }
 
   /* _DecodeExecute16_1000xx {{{4
@@ -10228,7 +14092,7 @@ private:
     TRACEI(STRH_imm, T1, "t=%u n=%u imm32=0x%x", t, n, imm32);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_STRH_immediate(t, n, imm32, index, add, wback);
+    _Dispatch<&Simulator::_Exec_STRH_immediate>(t, n, imm32, index, add, wback);
   }
 
   /* _DecodeExecute16_10001x {{{4
@@ -10249,7 +14113,7 @@ private:
     TRACEI(LDRH_imm, T1, "t=%u n=%u imm32=0x%x", t, n, imm32);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDRH_immediate(t, n, imm32, index, add, wback);
+    _Dispatch<&Simulator::_Exec_LDRH_immediate>(t, n, imm32, index, add, wback);
   }
 
   /* _DecodeExecute16_1001xx {{{4
@@ -10287,7 +14151,7 @@ private:
     TRACEI(STR_imm, T2, "t=%u n=%u imm32=0x%x index=%u add=%u wback=%u", t, n, imm32, index, add, wback);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_STR_immediate(t, n, imm32, index, add, wback);
+    _Dispatch<&Simulator::_Exec_STR_immediate>(t, n, imm32, index, add, wback);
   }
 
   /* _DecodeExecute16_10011x {{{4
@@ -10309,7 +14173,7 @@ private:
     TRACEI(LDR_imm, T2, "t=%u n=%u imm32=0x%x index=%u add=%u wback=%u", t, n, imm32, index, add, wback);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDR_immediate(t, n, imm32, index, add, wback);
+    _Dispatch<&Simulator::_Exec_LDR_immediate>(t, n, imm32, index, add, wback);
   }
 
   /* _DecodeExecute16_1010xx {{{4
@@ -10340,7 +14204,7 @@ private:
     TRACEI(ADR, T1, "d=%u imm32=0x%x", d, imm32);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_ADR(d, imm32, add);
+    _Dispatch<&Simulator::_Exec_ADR>(d, imm32, add);
   }
 
   /* _DecodeExecute16_1010xx_1 {{{4
@@ -10359,7 +14223,7 @@ private:
     TRACEI(ADD_SP_plus_imm, T1, "d=%u S=%u imm32=0x%x", d, setflags, imm32);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_ADD_SP_plus_immediate(d, setflags, imm32);
+    _Dispatch<&Simulator::_Exec_ADD_SP_plus_immediate>(d, setflags, imm32);
   }
 
   /* _DecodeExecute16_1011xx {{{4
@@ -10467,7 +14331,7 @@ private:
     TRACEI(CBNZ_CBZ, T1, "n=%u imm32=0x%x nonzero=%u", n, imm32, nonzero);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_CBNZ_CBZ(n, imm32, nonzero);
+    _Dispatch<&Simulator::_Exec_CBNZ_CBZ>(n, imm32, nonzero);
   }
 
   /* _DecodeExecute16_101111_10 {{{4
@@ -10484,7 +14348,7 @@ private:
     TRACEI(BKPT, T1, "imm32=0x%x", imm32);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_BKPT();
+    _Dispatch<&Simulator::_Exec_BKPT>();
   }
 
   /* _DecodeExecute16_101110_10 {{{4
@@ -10531,7 +14395,7 @@ private:
     TRACEI(REV, T1, "d=%u m=%u", d, m);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_REV(d, m);
+    _Dispatch<&Simulator::_Exec_REV>(d, m);
   }
 
   /* _DecodeExecute16_101110_10_01 {{{4
@@ -10549,7 +14413,7 @@ private:
     TRACEI(REV16, T1, "d=%u m=%u", d, m);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_REV16(d, m);
+    _Dispatch<&Simulator::_Exec_REV16>(d, m);
   }
 
   /* _DecodeExecute16_101110_10_11 {{{4
@@ -10567,7 +14431,7 @@ private:
     TRACEI(REVSH, T1, "d=%u m=%u", d, m);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_REVSH(d, m);
+    _Dispatch<&Simulator::_Exec_REVSH>(d, m);
   }
 
   /* _DecodeExecute16_101100_10 {{{4
@@ -10622,7 +14486,7 @@ private:
     TRACEI(SXTH, T1, "d=%u m=%u rotation=%u", d, m, rotation);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_SXTH(d, m, rotation);
+    _Dispatch<&Simulator::_Exec_SXTH>(d, m, rotation);
   }
 
   /* _DecodeExecute16_101100_10_01 {{{4
@@ -10641,7 +14505,7 @@ private:
     TRACEI(SXTB, T1, "d=%u m=%u rotation=%u", d, m, rotation);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_SXTB(d, m, rotation);
+    _Dispatch<&Simulator::_Exec_SXTB>(d, m, rotation);
   }
 
   /* _DecodeExecute16_101100_10_10 {{{4
@@ -10660,7 +14524,7 @@ private:
     TRACEI(UXTH, T1, "d=%u m=%u rotation=%u", d, m, rotation);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_UXTH(d, m, rotation);
+    _Dispatch<&Simulator::_Exec_UXTH>(d, m, rotation);
   }
 
   /* _DecodeExecute16_101100_10_11 {{{4
@@ -10679,7 +14543,7 @@ private:
     TRACEI(UXTB, T1, "d=%u m=%u rotation=%u", d, m, rotation);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_UXTB(d, m, rotation);
+    _Dispatch<&Simulator::_Exec_UXTB>(d, m, rotation);
   }
 
   /* _DecodeExecute16_1011x1_0 {{{4
@@ -10728,7 +14592,7 @@ private:
     TRACEI(ADD_SP_plus_imm, T2, "d=%u imm32=0x%x oldSP=0x%x", d, imm32, _GetSP());
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_ADD_SP_plus_immediate(d, setflags, imm32);
+    _Dispatch<&Simulator::_Exec_ADD_SP_plus_immediate>(d, setflags, imm32);
   }
 
   /* _DecodeExecute16_101100_00_1 {{{4
@@ -10746,7 +14610,7 @@ private:
     TRACEI(SUB_SP_minus_imm, T1, "d=%u S=%u imm32=0x%x prevSP=0x%x", d, setflags, imm32, _GetSP());
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_SUB_SP_minus_immediate(d, setflags, imm32);
+    _Dispatch<&Simulator::_Exec_SUB_SP_minus_immediate>(d, setflags, imm32);
   }
 
   /* _DecodeExecute16_101101 {{{4
@@ -10768,7 +14632,7 @@ private:
     TRACEI(STMDB, T2, "n=%u registers=0x%x wback=%u", n, registers, wback);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_STMDB(n, registers, wback);
+    _Dispatch<&Simulator::_Exec_STMDB>(n, registers, wback);
   }
 
   /* _DecodeExecute16_101101_10_01_1 {{{4
@@ -10803,7 +14667,7 @@ private:
     TRACEIU(CPS, T1, "enable=%u disable=%u PRI=%u FAULT=%u", enable, disable, affectPRI, affectFAULT);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_CPS(enable, disable, affectPRI, affectFAULT);
+    _Dispatch<&Simulator::_Exec_CPS>(enable, disable, affectPRI, affectFAULT);
   }
 
   /* _DecodeExecute16_101111 {{{4
@@ -10828,7 +14692,7 @@ private:
     TRACEI(LDM, T3, "n=%u wback=%u registers=0x%x", n, wback, registers);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDM(n, registers, wback);
+    _Dispatch<&Simulator::_Exec_LDM>(n, registers, wback);
   }
 
   /* _DecodeExecute16_101111_11_xxxx {{{4
@@ -10853,7 +14717,7 @@ private:
     TRACEI(IT, T1, "firstCond=0x%x mask=0x%x", firstCond, mask);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_IT(firstCond, mask);
+    _Dispatch<&Simulator::_Exec_IT>(firstCond, mask);
   }
 
   /* _DecodeExecute16_101111_11_0000 {{{4
@@ -10919,7 +14783,7 @@ private:
     TRACEI(NOP, T1, "");
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_NOP();
+    _Dispatch<&Simulator::_Exec_NOP>();
   }
 
   /* _DecodeExecute16_101111_11_0000_0001 {{{4
@@ -10932,7 +14796,7 @@ private:
     TRACEI(YIELD, T1, "");
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_YIELD();
+    _Dispatch<&Simulator::_Exec_YIELD>();
   }
 
   /* _DecodeExecute16_101111_11_0000_0010 {{{4
@@ -10945,7 +14809,7 @@ private:
     TRACEI(WFE, T1, "");
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_WFE();
+    _Dispatch<&Simulator::_Exec_WFE>();
   }
 
   /* _DecodeExecute16_101111_11_0000_0011 {{{4
@@ -10958,7 +14822,7 @@ private:
     TRACEI(WFI, T1, "");
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_WFI();
+    _Dispatch<&Simulator::_Exec_WFI>();
   }
 
   /* _DecodeExecute16_101111_11_0000_0100 {{{4
@@ -10973,7 +14837,7 @@ private:
     TRACEI(SEV, T1, "");
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_SEV();
+    _Dispatch<&Simulator::_Exec_SEV>();
   }
 
   /* _DecodeExecute16_101111_11_0000_xxxx {{{4
@@ -10986,7 +14850,7 @@ private:
     TRACEI(RSVD_HINT, UNK, "");
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_NOP();
+    _Dispatch<&Simulator::_Exec_NOP>();
   }
 
   /* _DecodeExecute16_1100xx {{{4
@@ -11023,7 +14887,7 @@ private:
     TRACEI(STM, T1, "n=%u registers=0x%x", n, registers);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_STM(n, registers, wback);
+    _Dispatch<&Simulator::_Exec_STM>(n, registers, wback);
   }
 
   /* _DecodeExecute16_11001x {{{4
@@ -11047,7 +14911,7 @@ private:
     TRACEI(LDM, T1, "n=%u registers=0x%x wback=%u", n, registers, wback);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDM(n, registers, wback);
+    _Dispatch<&Simulator::_Exec_LDM>(n, registers, wback);
   }
 
   /* _DecodeExecute16_1101xx {{{4
@@ -11102,7 +14966,7 @@ private:
     TRACEI(UDF, T1, "");
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_UDF();
+    _Dispatch<&Simulator::_Exec_UDF>();
   }
 
   /* _DecodeExecute32_110111_11 {{{4
@@ -11122,7 +14986,7 @@ private:
     TRACEI(SVC, T1, "imm32=0x%x", imm32);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_SVC();
+    _Dispatch<&Simulator::_Exec_SVC>();
   }
 
   /* _DecodeExecute16_1101xx_xx {{{4
@@ -11145,7 +15009,7 @@ private:
     TRACEI(B, T1, "imm32=0x%x cond=%u", imm32, cond);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_B(imm32);
+    _Dispatch<&Simulator::_Exec_B>(imm32);
   }
 
   /* _DecodeExecute16_11100 {{{4
@@ -11163,7 +15027,7 @@ private:
     TRACEI(B, T2, "imm32=0x%x", imm32);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_B(imm32);
+    _Dispatch<&Simulator::_Exec_B>(imm32);
   }
 
   /* Decode/Execute (32-Bit Instructions) {{{3
@@ -11432,7 +15296,7 @@ private:
       CUNPREDICTABLE_UNDEFINED();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDC_LDC2_literal(index, add, cp, imm32);
+    _Dispatch<&Simulator::_Exec_LDC_LDC2_literal>(index, add, cp, imm32);
   }
 
   /* _DecodeExecute32_LDC_LDC2_immediate_T1_T2 {{{4
@@ -11466,7 +15330,7 @@ private:
     bool     index = !!P, add = !!U, wback = !!W;
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDC_LDC2_immediate(n, cp, imm32, index, add, wback);
+    _Dispatch<&Simulator::_Exec_LDC_LDC2_immediate>(n, cp, imm32, index, add, wback);
   }
 
   /* _DecodeExecute32_STC_STC2_T1_T2 {{{4
@@ -11502,7 +15366,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_STC_STC2(n, cp, imm32, index, add, wback);
+    _Dispatch<&Simulator::_Exec_STC_STC2>(n, cp, imm32, index, add, wback);
   }
 
   /* _DecodeExecute32_CDP_CDP2_T1_T2 {{{4
@@ -11526,7 +15390,7 @@ private:
     uint32_t cp = coproc;
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_CDP_CDP2(cp);
+    _Dispatch<&Simulator::_Exec_CDP_CDP2>(cp);
   }
 
   /* _DecodeExecute32_x110_0_00x0 {{{4
@@ -11601,7 +15465,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_MRRC_MRRC2(t, t2, cp);
+    _Dispatch<&Simulator::_Exec_MRRC_MRRC2>(t, t2, cp);
   }
 
   /* _DecodeExecute32_MRRC_MRRC2_T2 {{{4
@@ -11633,7 +15497,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_MRRC_MRRC2(t, t2, cp);
+    _Dispatch<&Simulator::_Exec_MRRC_MRRC2>(t, t2, cp);
   }
 
   /* _DecodeExecute32_MCRR_MCRR2_T1 {{{4
@@ -11664,7 +15528,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_MCRR_MCRR2(t, t2, cp);
+    _Dispatch<&Simulator::_Exec_MCRR_MCRR2>(t, t2, cp);
   }
 
   /* _DecodeExecute32_MCRR_MCRR2_T2 {{{4
@@ -11696,7 +15560,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_MCRR_MCRR2(t, t2, cp);
+    _Dispatch<&Simulator::_Exec_MCRR_MCRR2>(t, t2, cp);
   }
 
   /* _DecodeExecute32_x111_0_0xxx_1 {{{4
@@ -11759,7 +15623,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_MRC_MRC2(t, cp);
+    _Dispatch<&Simulator::_Exec_MRC_MRC2>(t, cp);
   }
 
   /* _DecodeExecute32_MRC_MRC2_T2 {{{4
@@ -11788,7 +15652,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_MRC_MRC2(t, cp);
+    _Dispatch<&Simulator::_Exec_MRC_MRC2>(t, cp);
   }
 
   /* _DecodeExecute32_MCR_MCR2_T1 {{{4
@@ -11816,7 +15680,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_MCR_MCR2(t, cp);
+    _Dispatch<&Simulator::_Exec_MCR_MCR2>(t, cp);
   }
 
   /* _DecodeExecute32_MCR_MCR2_T2 {{{4
@@ -11845,7 +15709,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_MCR_MCR2(t, cp);
+    _Dispatch<&Simulator::_Exec_MCR_MCR2>(t, cp);
   }
 
   /* _DecodeExecute32_1101_11xxx {{{4
@@ -12009,7 +15873,7 @@ private:
       CUNPREDICTABLE_UNDEFINED();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_SMLAL(dLo, dHi, n, m, setflags);
+    _Dispatch<&Simulator::_Exec_SMLAL>(dLo, dHi, n, m, setflags);
   }
 
   /* _DecodeExecute32_UMLAL_T1 {{{4
@@ -12039,7 +15903,7 @@ private:
       CUNPREDICTABLE_UNDEFINED();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_UMLAL(dLo, dHi, n, m, setflags);
+    _Dispatch<&Simulator::_Exec_UMLAL>(dLo, dHi, n, m, setflags);
   }
 
   /* _DecodeExecute32_SDIV_T1 {{{4
@@ -12062,7 +15926,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_SDIV(d, n, m);
+    _Dispatch<&Simulator::_Exec_SDIV>(d, n, m);
   }
 
   /* _DecodeExecute32_UDIV_T1 {{{4
@@ -12085,7 +15949,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_UDIV(d, n, m);
+    _Dispatch<&Simulator::_Exec_UDIV>(d, n, m);
   }
 
   /* _DecodeExecute32_SMULL_T1 {{{4
@@ -12115,7 +15979,7 @@ private:
       CUNPREDICTABLE_UNDEFINED();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_SMULL(dLo, dHi, n, m, setflags);
+    _Dispatch<&Simulator::_Exec_SMULL>(dLo, dHi, n, m, setflags);
   }
 
   /* _DecodeExecute32_UMULL_T1 {{{4
@@ -12145,7 +16009,7 @@ private:
       CUNPREDICTABLE_UNDEFINED();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_UMULL(dLo, dHi, n, m, setflags);
+    _Dispatch<&Simulator::_Exec_UMULL>(dLo, dHi, n, m, setflags);
   }
 
   /* _DecodeExecute32_1101_10xxx {{{4
@@ -12323,7 +16187,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_MLA(d, n, m, a, setflags);
+    _Dispatch<&Simulator::_Exec_MLA>(d, n, m, a, setflags);
   }
 
   /* _DecodeExecute32_MLS_T1 {{{4
@@ -12349,7 +16213,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_MLS(d, n, m, a);
+    _Dispatch<&Simulator::_Exec_MLS>(d, n, m, a);
   }
 
   /* _DecodeExecute32_MUL_T2 {{{4
@@ -12374,7 +16238,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_MUL(d, n, m, setflags);
+    _Dispatch<&Simulator::_Exec_MUL>(d, n, m, setflags);
   }
 
   /* _DecodeExecute32_1101_0xxxx {{{4
@@ -12524,7 +16388,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_CLZ(d, m);
+    _Dispatch<&Simulator::_Exec_CLZ>(d, m);
   }
 
   /* _DecodeExecute32_REV_T2 {{{4
@@ -12550,7 +16414,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_REV(d, m);
+    _Dispatch<&Simulator::_Exec_REV>(d, m);
   }
 
   /* _DecodeExecute32_REV16_T2 {{{4
@@ -12576,7 +16440,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_REV16(d, m);
+    _Dispatch<&Simulator::_Exec_REV16>(d, m);
   }
 
   /* _DecodeExecute32_RBIT_T1 {{{4
@@ -12602,7 +16466,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_RBIT(d, m);
+    _Dispatch<&Simulator::_Exec_RBIT>(d, m);
   }
 
   /* _DecodeExecute32_REVSH_T2 {{{4
@@ -12628,7 +16492,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_REVSH(d, m);
+    _Dispatch<&Simulator::_Exec_REVSH>(d, m);
   }
 
   /* _DecodeExecute32_1101_00xxx_1xxx {{{4
@@ -12736,7 +16600,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_SXTB(d, m, rotation);
+    _Dispatch<&Simulator::_Exec_SXTB>(d, m, rotation);
   }
 
   /* _DecodeExecute32_UXTB_T2 {{{4
@@ -12762,7 +16626,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_UXTB(d, m, rotation);
+    _Dispatch<&Simulator::_Exec_UXTB>(d, m, rotation);
   }
 
   /* _DecodeExecute32_SXTH_T2 {{{4
@@ -12788,7 +16652,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_SXTH(d, m, rotation);
+    _Dispatch<&Simulator::_Exec_SXTH>(d, m, rotation);
   }
 
   /* _DecodeExecute32_UXTH_T2 {{{4
@@ -12814,7 +16678,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_UXTH(d, m, rotation);
+    _Dispatch<&Simulator::_Exec_UXTH>(d, m, rotation);
   }
 
   /* _DecodeExecute32_MOV_MOVS_register_shifted_register_T2 {{{4
@@ -12842,7 +16706,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_MOV_MOVS_register_shifted_register(d, m, s, setflags, shiftT);
+    _Dispatch<&Simulator::_Exec_MOV_MOVS_register_shifted_register>(d, m, s, setflags, shiftT);
   }
 
   /* _DecodeExecute32_0100 {{{4
@@ -12933,7 +16797,7 @@ private:
     CHECKV(8);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_SG();
+    _Dispatch<&Simulator::_Exec_SG>();
   }
 
   /* _DecodeExecute32_0100_111_xxxx {{{4
@@ -13024,7 +16888,7 @@ private:
       CUNPREDICTABLE_UNDEFINED();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDRD_literal(t, t2, imm32, add);
+    _Dispatch<&Simulator::_Exec_LDRD_literal>(t, t2, imm32, add);
   }
 
   /* _DecodeExecute32_0100_010 {{{4
@@ -13173,7 +17037,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_STLB(t, n);
+    _Dispatch<&Simulator::_Exec_STLB>(t, n);
   }
 
   /* _DecodeExecute32_STLH_T1 {{{4
@@ -13195,7 +17059,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_STLH(t, n);
+    _Dispatch<&Simulator::_Exec_STLH>(t, n);
   }
 
   /* _DecodeExecute32_STL_T1 {{{4
@@ -13217,7 +17081,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_STL(t, n);
+    _Dispatch<&Simulator::_Exec_STL>(t, n);
   }
 
   /* _DecodeExecute32_STLEXB_T1 {{{4
@@ -13244,7 +17108,7 @@ private:
       CUNPREDICTABLE_UNDEFINED();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_STLEXB(d, t, n);
+    _Dispatch<&Simulator::_Exec_STLEXB>(d, t, n);
   }
 
   /* _DecodeExecute32_STLEXH_T1 {{{4
@@ -13271,7 +17135,7 @@ private:
       CUNPREDICTABLE_UNDEFINED();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_STLEXH(d, t, n);
+    _Dispatch<&Simulator::_Exec_STLEXH>(d, t, n);
   }
 
   /* _DecodeExecute32_STLEX_T1 {{{4
@@ -13298,7 +17162,7 @@ private:
       CUNPREDICTABLE_UNDEFINED();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_STLEX(d, t, n);
+    _Dispatch<&Simulator::_Exec_STLEX>(d, t, n);
   }
 
   /* _DecodeExecute32_LDAB_T1 {{{4
@@ -13319,7 +17183,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDAB(t, n);
+    _Dispatch<&Simulator::_Exec_LDAB>(t, n);
   }
 
   /* _DecodeExecute32_LDAH_T1 {{{4
@@ -13340,7 +17204,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDAH(t, n);
+    _Dispatch<&Simulator::_Exec_LDAH>(t, n);
   }
 
   /* _DecodeExecute32_LDA_T1 {{{4
@@ -13361,7 +17225,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDA(t, n);
+    _Dispatch<&Simulator::_Exec_LDA>(t, n);
   }
 
   /* _DecodeExecute32_LDAEXB_T1 {{{4
@@ -13382,7 +17246,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDAEXB(t, n);
+    _Dispatch<&Simulator::_Exec_LDAEXB>(t, n);
   }
 
   /* _DecodeExecute32_LDAEXH_T1 {{{4
@@ -13403,7 +17267,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDAEXH(t, n);
+    _Dispatch<&Simulator::_Exec_LDAEXH>(t, n);
   }
 
   /* _DecodeExecute32_LDAEX_T1 {{{4
@@ -13424,7 +17288,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDAEX(t, n);
+    _Dispatch<&Simulator::_Exec_LDAEX>(t, n);
   }
 
   /* _DecodeExecute32_0100_010_1_01x {{{4
@@ -13488,7 +17352,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDREXB(t, n);
+    _Dispatch<&Simulator::_Exec_LDREXB>(t, n);
   }
 
   /* _DecodeExecute32_LDREXH_T1 {{{4
@@ -13509,7 +17373,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDREXH(t, n);
+    _Dispatch<&Simulator::_Exec_LDREXH>(t, n);
   }
 
   /* _DecodeExecute32_STREXB_T1 {{{4
@@ -13535,7 +17399,7 @@ private:
       CUNPREDICTABLE_UNDEFINED();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_STREXB(d, t, n);
+    _Dispatch<&Simulator::_Exec_STREXB>(d, t, n);
   }
 
   /* _DecodeExecute32_STREXH_T1 {{{4
@@ -13561,7 +17425,7 @@ private:
       CUNPREDICTABLE_UNDEFINED();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_STREXH(d, t, n);
+    _Dispatch<&Simulator::_Exec_STREXH>(d, t, n);
   }
 
   /* _DecodeExecute32_TBB_TBH_T1 {{{4
@@ -13590,7 +17454,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_TBB(n, m, isTBH);
+    _Dispatch<&Simulator::_Exec_TBB>(n, m, isTBH);
   }
 
   /* _DecodeExecute32_0100_010_0_xxxxxxxxx {{{4
@@ -13636,7 +17500,7 @@ private:
       CUNPREDICTABLE_UNDEFINED();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_STREX(d, t, n, imm32);
+    _Dispatch<&Simulator::_Exec_STREX>(d, t, n, imm32);
   }
 
   /* _DecodeExecute32_LDREX_T1 {{{4
@@ -13659,7 +17523,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDREX(t, n, imm32);
+    _Dispatch<&Simulator::_Exec_LDREX>(t, n, imm32);
   }
 
   /* _DecodeExecute32_TT_TTT_TTA_TTAT_T1 {{{4
@@ -13688,7 +17552,7 @@ private:
       THROW_UNDEFINED();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_TT(d, n, alt, forceUnpriv);
+    _Dispatch<&Simulator::_Exec_TT>(d, n, alt, forceUnpriv);
   }
 
   /* _DecodeExecute32_0100_x0x {{{4
@@ -13769,7 +17633,7 @@ private:
     TRACEI(STM, T2, "n=%u registers=0x%x wback=%u", n, registers, wback);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_STM(n, registers, wback);
+    _Dispatch<&Simulator::_Exec_STM>(n, registers, wback);
   }
 
   /* _DecodeExecute32_LDM_LDMIA_LDMFD_T2 {{{4
@@ -13805,7 +17669,7 @@ private:
     TRACEI(LDM, T2, "n=%u registers=0x%x wback=%u", n, registers, wback);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDM(n, registers, wback);
+    _Dispatch<&Simulator::_Exec_LDM>(n, registers, wback);
   }
 
   /* _DecodeExecute32_STMDB_STMFD_T1 {{{4
@@ -13840,7 +17704,7 @@ private:
     TRACEI(STMDB, T1, "n=%u registers=0x%x wback=%u", n, registers, wback);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_STMDB(n, registers, wback);
+    _Dispatch<&Simulator::_Exec_STMDB>(n, registers, wback);
   }
 
   /* _DecodeExecute32_LDMDB_LDMEA_T1 {{{4
@@ -13880,7 +17744,7 @@ private:
       CUNPREDICTABLE_UNDEFINED();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDMDB(n, registers, wback);
+    _Dispatch<&Simulator::_Exec_LDMDB>(n, registers, wback);
   }
 
   /* _DecodeExecute32_0100_011 {{{4
@@ -13946,7 +17810,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_STRD_immediate(t, t2, n, imm32, index, add, wback);
+    _Dispatch<&Simulator::_Exec_STRD_immediate>(t, t2, n, imm32, index, add, wback);
   }
 
   /* _DecodeExecute32_LDRD_immediate_T1 {{{4
@@ -13980,7 +17844,7 @@ private:
     TRACEI(LDRD_imm, T1, "t=%u t2=%u n=%u imm32=0x%x index=%u add=%u wback=%u", t, t2, n, imm32, index, add, wback);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDRD_immediate(t, t2, n, imm32, index, add, wback);
+    _Dispatch<&Simulator::_Exec_LDRD_immediate>(t, t2, n, imm32, index, add, wback);
   }
 
   /* _DecodeExecute32_0101 {{{4
@@ -14225,7 +18089,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_CMP_register(n, m, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_CMP_register>(n, m, shiftT, shiftN);
   }
 
   /* _DecodeExecute32_RSB_register_T1 {{{4
@@ -14255,7 +18119,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_RSB_register(d, n, m, setflags, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_RSB_register>(d, n, m, setflags, shiftT, shiftN);
   }
 
   /* _DecodeExecute32_CMP_immediate_T2 {{{4
@@ -14279,7 +18143,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_CMP_immediate(n, imm32);
+    _Dispatch<&Simulator::_Exec_CMP_immediate>(n, imm32);
   }
 
   /* _DecodeExecute32_SUB_SP_minus_register_T1 {{{4
@@ -14315,7 +18179,7 @@ private:
     TRACEI(SUB_SP_minus_reg, T1, "d=%u m=%u S=%u shiftT=%u shiftN=%u", d, m, setflags, shiftT, shiftN);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_SUB_SP_minus_register(d, m, setflags, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_SUB_SP_minus_register>(d, m, setflags, shiftT, shiftN);
   }
 
   /* _DecodeExecute32_SUB_register_T2 {{{4
@@ -14351,7 +18215,7 @@ private:
     TRACEI(SUB_reg, T2, "d=%u n=%u m=%u S=%u shiftT=%u shiftN=%u", d, n, m, setflags, shiftT, shiftN);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_SUB_register(d, n, m, setflags, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_SUB_register>(d, n, m, setflags, shiftT, shiftN);
   }
 
   /* _DecodeExecute32_PKHBT_PKHTB_T1 {{{4
@@ -14391,7 +18255,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_ADC_register(d, n, m, setflags, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_ADC_register>(d, n, m, setflags, shiftT, shiftN);
   }
 
   /* _DecodeExecute32_SBC_register_T2 {{{4
@@ -14423,7 +18287,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_SBC_register(d, n, m, setflags, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_SBC_register>(d, n, m, setflags, shiftT, shiftN);
   }
 
   /* _DecodeExecute32_CMN_register_T2 {{{4
@@ -14451,7 +18315,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_CMN_register(n, m, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_CMN_register>(n, m, shiftT, shiftN);
   }
 
   /* _DecodeExecute32_ADD_SP_plus_register_T3 {{{4
@@ -14485,7 +18349,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_ADD_SP_plus_register(d, m, setflags, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_ADD_SP_plus_register>(d, m, setflags, shiftT, shiftN);
   }
 
   /* _DecodeExecute32_ADD_register_T3 {{{4
@@ -14519,7 +18383,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_ADD_register(d, n, m, setflags, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_ADD_register>(d, n, m, setflags, shiftT, shiftN);
   }
 
   /* _DecodeExecute32_TEQ_register_T1 {{{4
@@ -14548,7 +18412,7 @@ private:
     TRACEI(TEQ_reg, T1, "n=%u m=%u shiftT=%u shiftN=%u", n, m, shiftT, shiftN);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_TEQ_register(n, m, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_TEQ_register>(n, m, shiftT, shiftN);
   }
 
   /* _DecodeExecute32_EOR_register_T2 {{{4
@@ -14582,7 +18446,7 @@ private:
     TRACEI(EOR_reg, T1, "d=%u n=%u m=%u S=%u shiftT=%u shiftN=%u", d, n, m, setflags, shiftT, shiftN);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_EOR_register(d, n, m, setflags, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_EOR_register>(d, n, m, setflags, shiftT, shiftN);
   }
 
   /* _DecodeExecute32_MVN_register_T2 {{{4
@@ -14613,7 +18477,7 @@ private:
     TRACEI(MVN_reg, T1, "d=%u m=%u S=%u shiftT=%u shiftN=%u", d, m, setflags, shiftT, shiftN);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_MVN_register(d, m, setflags, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_MVN_register>(d, m, setflags, shiftT, shiftN);
   }
 
   /* _DecodeExecute32_ORN_register_T1 {{{4
@@ -14647,7 +18511,7 @@ private:
     TRACEI(ORN_reg, T1, "d=%u n=%u m=%u S=%u shiftT=%u shiftN=%u", d, n, m, setflags, shiftT, shiftN);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_ORN_register(d, n, m, setflags, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_ORN_register>(d, n, m, setflags, shiftT, shiftN);
   }
 
   /* _DecodeExecute32_MOV_register_T3 {{{4
@@ -14682,7 +18546,7 @@ private:
         THROW_UNPREDICTABLE();
     }
 
-    _Exec_MOV_register(d, m, setflags, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_MOV_register>(d, m, setflags, shiftT, shiftN);
   }
 
   /* _DecodeExecute32_BIC_register_T2 {{{4
@@ -14714,7 +18578,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_BIC_register(d, n, m, setflags, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_BIC_register>(d, n, m, setflags, shiftT, shiftN);
   }
 
   /* _DecodeExecute32_TST_register_T2 {{{4
@@ -14742,7 +18606,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_TST_register(n, m, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_TST_register>(n, m, shiftT, shiftN);
   }
 
   /* _DecodeExecute32_AND_register_T2 {{{4
@@ -14774,7 +18638,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_AND_register(d, n, m, setflags, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_AND_register>(d, n, m, setflags, shiftT, shiftN);
   }
 
   /* _DecodeExecute32_ORR_register_T2 {{{4
@@ -14808,7 +18672,7 @@ private:
     TRACEI(ORR_reg, T2, "d=%u n=%u m=%u S=%u shiftT=%u shiftN=%u", d, n, m, setflags, shiftT, shiftN);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_ORR_register(d, n, m, setflags, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_ORR_register>(d, n, m, setflags, shiftT, shiftN);
   }
 
   /* _DecodeExecute32_10xx {{{4
@@ -14944,7 +18808,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_MRS(d, SYSm);
+    _Dispatch<&Simulator::_Exec_MRS>(d, SYSm);
   }
 
   /* _DecodeExecute32_101x_00_1_1x {{{4
@@ -14989,7 +18853,7 @@ private:
     // imm32 is for assembly and disassebly only, and is ignored by hardware.
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_UDF();
+    _Dispatch<&Simulator::_Exec_UDF>();
   }
 
   /* _DecodeExecute32_100x_00_xxx0_10_000 {{{4
@@ -15058,7 +18922,7 @@ private:
     // Any decoding of 'option' is specified by the debug system.
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_DBG(option);
+    _Dispatch<&Simulator::_Exec_DBG>(option);
   }
 
   /* _DecodeExecute32_NOP_T2 {{{4
@@ -15078,7 +18942,7 @@ private:
     TRACEI(NOP, T2, "");
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_NOP();
+    _Dispatch<&Simulator::_Exec_NOP>();
   }
 
   /* _DecodeExecute32_YIELD_T2 {{{4
@@ -15098,7 +18962,7 @@ private:
     TRACEI(YIELD, T2, "");
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_YIELD();
+    _Dispatch<&Simulator::_Exec_YIELD>();
   }
 
   /* _DecodeExecute32_WFE_T2 {{{4
@@ -15118,7 +18982,7 @@ private:
     TRACEI(WFE, T2, "");
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_WFE();
+    _Dispatch<&Simulator::_Exec_WFE>();
   }
 
   /* _DecodeExecute32_WFI_T2 {{{4
@@ -15138,7 +19002,7 @@ private:
     TRACEI(WFI, T2, "");
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_WFI();
+    _Dispatch<&Simulator::_Exec_WFI>();
   }
 
   /* _DecodeExecute32_SEV_T2 {{{4
@@ -15158,7 +19022,7 @@ private:
     TRACEI(SEV, T2, "");
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_SEV();
+    _Dispatch<&Simulator::_Exec_SEV>();
   }
 
   /* _DecodeExecute32_MSR_register_T1 {{{4
@@ -15187,7 +19051,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_MSR_register(n, mask, SYSm);
+    _Dispatch<&Simulator::_Exec_MSR_register>(n, mask, SYSm);
   }
 
   /* _DecodeExecute32_B_T3 {{{4
@@ -15214,7 +19078,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_B(imm32);
+    _Dispatch<&Simulator::_Exec_B>(imm32);
   }
 
   /* _DecodeExecute32_B_T4 {{{4
@@ -15237,7 +19101,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_B(imm32);
+    _Dispatch<&Simulator::_Exec_B>(imm32);
   }
 
   /* _DecodeExecute32_BL_T1 {{{4
@@ -15260,7 +19124,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_BL(imm32);
+    _Dispatch<&Simulator::_Exec_BL>(imm32);
   }
 
   /* _DecodeExecute32_10x0_0 {{{4
@@ -15451,7 +19315,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_RSB_immediate(d, n, setflags, imm32);
+    _Dispatch<&Simulator::_Exec_RSB_immediate>(d, n, setflags, imm32);
   }
 
   /* _DecodeExecute32_SUB_SP_minus_immediate_T2 {{{4
@@ -15481,7 +19345,7 @@ private:
     TRACEI(SUB_SP_minus_imm, T2, "d=%u S=%u imm32=0x%x", d, setflags, imm32);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_SUB_SP_minus_immediate(d, setflags, imm32);
+    _Dispatch<&Simulator::_Exec_SUB_SP_minus_immediate>(d, setflags, imm32);
   }
 
   /* _DecodeExecute32_CMN_immediate_T1 {{{4
@@ -15505,7 +19369,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_CMN_immediate(n, imm32);
+    _Dispatch<&Simulator::_Exec_CMN_immediate>(n, imm32);
   }
 
   /* _DecodeExecute32_SBC_immediate_T1 {{{4
@@ -15533,7 +19397,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_SBC_immediate(d, n, setflags, imm32);
+    _Dispatch<&Simulator::_Exec_SBC_immediate>(d, n, setflags, imm32);
   }
 
   /* _DecodeExecute32_ADC_immediate_T1 {{{4
@@ -15561,7 +19425,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_ADC_immediate(d, n, setflags, imm32);
+    _Dispatch<&Simulator::_Exec_ADC_immediate>(d, n, setflags, imm32);
   }
 
   /* _DecodeExecute32_ADD_SP_plus_immediate_T3 {{{4
@@ -15589,7 +19453,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_ADD_SP_plus_immediate(d, setflags, imm32);
+    _Dispatch<&Simulator::_Exec_ADD_SP_plus_immediate>(d, setflags, imm32);
   }
 
   /* _DecodeExecute32_TEQ_immediate_T1 {{{4
@@ -15607,13 +19471,13 @@ private:
       THROW_UNDEFINED();
 
     uint32_t n        = Rn;
-    auto [imm32, carry] = _T32ExpandImm_C((i<<11) | (imm3<<8) | imm8, GETBITSM(_s.xpsr, XPSR__C));
+    auto [imm32, carry] = _T32ExpandImm_C((i<<11) | (imm3<<8) | imm8, _DecodeCarry());
 
     if (n == 13 || n == 15)
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_TEQ_immediate(n, imm32, carry);
+    _Dispatch<&Simulator::_Exec_TEQ_immediate>(n, imm32, carry);
   }
 
   /* _DecodeExecute32_EOR_immediate_T1 {{{4
@@ -15637,13 +19501,13 @@ private:
     uint32_t d        = Rd;
     uint32_t n        = Rn;
     bool     setflags = !!S;
-    auto [imm32, carry] = _T32ExpandImm_C((i<<11) | (imm3<<8) | imm8, GETBITSM(_s.xpsr, XPSR__C));
+    auto [imm32, carry] = _T32ExpandImm_C((i<<11) | (imm3<<8) | imm8, _DecodeCarry());
 
     if (d == 13 || (d == 15 && !S) || (n == 13 || n == 15))
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_EOR_immediate(d, n, setflags, imm32, carry);
+    _Dispatch<&Simulator::_Exec_EOR_immediate>(d, n, setflags, imm32, carry);
   }
 
   /* _DecodeExecute32_MVN_immediate_T1 {{{4
@@ -15663,13 +19527,13 @@ private:
 
     uint32_t d        = Rd;
     bool     setflags = !!S;
-    auto [imm32, carry] = _T32ExpandImm_C((i<<11) | (imm3<<8) | imm8, GETBITSM(_s.xpsr, XPSR__C));
+    auto [imm32, carry] = _T32ExpandImm_C((i<<11) | (imm3<<8) | imm8, _DecodeCarry());
 
     if (d == 13 || d == 15)
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_MVN_immediate(d, setflags, imm32, carry);
+    _Dispatch<&Simulator::_Exec_MVN_immediate>(d, setflags, imm32, carry);
   }
 
   /* _DecodeExecute32_ORN_immediate_T1 {{{4
@@ -15693,13 +19557,13 @@ private:
     uint32_t d        = Rd;
     uint32_t n        = Rn;
     bool     setflags = !!S;
-    auto [imm32, carry] = _T32ExpandImm_C((i<<11) | (imm3<<8) | imm8, GETBITSM(_s.xpsr, XPSR__C));
+    auto [imm32, carry] = _T32ExpandImm_C((i<<11) | (imm3<<8) | imm8, _DecodeCarry());
 
     if ((d == 13 || d == 15) || n == 13)
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_ORN_immediate(d, n, setflags, imm32, carry);
+    _Dispatch<&Simulator::_Exec_ORN_immediate>(d, n, setflags, imm32, carry);
   }
 
   /* _DecodeExecute32_TST_immediate_T1 {{{4
@@ -15717,12 +19581,12 @@ private:
       THROW_UNDEFINED();
 
     uint32_t n = Rn;
-    auto [imm32, carry] = _T32ExpandImm_C((i<<11) | (imm3<<8) | imm8, GETBITSM(_s.xpsr, XPSR__C));
+    auto [imm32, carry] = _T32ExpandImm_C((i<<11) | (imm3<<8) | imm8, _DecodeCarry());
     if (n == 13 || n == 15)
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_TST_immediate(n, imm32, carry);
+    _Dispatch<&Simulator::_Exec_TST_immediate>(n, imm32, carry);
   }
 
   /* _DecodeExecute32_SUB_immediate_T3 {{{4
@@ -15754,7 +19618,7 @@ private:
     TRACEI(SUB_imm, T3, "d=%u n=%u[0x%x] S=%u imm32=0x%x", d, n, _GetR(n), setflags, imm32);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_SUB_immediate(d, n, setflags, imm32);
+    _Dispatch<&Simulator::_Exec_SUB_immediate>(d, n, setflags, imm32);
   }
 
   /* _DecodeExecute32_ADD_immediate_T3 {{{4
@@ -15786,7 +19650,7 @@ private:
     TRACEI(ADD_imm, T3, "d=%u n=%u S=%u imm32=0x%x", d, n, setflags, imm32);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_ADD_immediate(d, n, setflags, imm32);
+    _Dispatch<&Simulator::_Exec_ADD_immediate>(d, n, setflags, imm32);
   }
 
   /* _DecodeExecute32_BIC_immediate_T1 {{{4
@@ -15808,14 +19672,14 @@ private:
     uint32_t d        = Rd;
     uint32_t n        = Rn;
     bool     setflags = !!S;
-    auto [imm32, carry] = _T32ExpandImm_C((i<<11)|(imm3<<8)|imm8, GETBITSM(_s.xpsr, XPSR__C));
+    auto [imm32, carry] = _T32ExpandImm_C((i<<11)|(imm3<<8)|imm8, _DecodeCarry());
     if (d == 13 || d == 15 || n == 13 || n == 15)
       THROW_UNPREDICTABLE();
 
     TRACEI(BIC_imm, T1, "d=%u n=%u S=%u imm32=0x%x carry=%u", d, n, setflags, imm32, carry);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_BIC_immediate(d, n, setflags, imm32, carry);
+    _Dispatch<&Simulator::_Exec_BIC_immediate>(d, n, setflags, imm32, carry);
   }
 
   /* _DecodeExecute32_ORR_immediate_T1 {{{4
@@ -15838,14 +19702,14 @@ private:
     uint32_t d        = Rd;
     uint32_t n        = Rn;
     bool     setflags = !!S;
-    auto [imm32, carry] = _T32ExpandImm_C((i<<11)|(imm3<<8)|imm8, GETBITSM(_s.xpsr, XPSR__C));
+    auto [imm32, carry] = _T32ExpandImm_C((i<<11)|(imm3<<8)|imm8, _DecodeCarry());
     if (d == 13 || d == 15 || n == 13)
       THROW_UNPREDICTABLE();
 
     TRACEI(ORR_imm, T1, "d=%u n=%u S=%u imm32=0x%x carry=%u", d, n, setflags, imm32, carry);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_ORR_immediate(d, n, setflags, imm32, carry);
+    _Dispatch<&Simulator::_Exec_ORR_immediate>(d, n, setflags, imm32, carry);
   }
 
   /* _DecodeExecute32_MOV_immediate_T2 {{{4
@@ -15865,14 +19729,14 @@ private:
 
     uint32_t d        = Rd;
     bool     setflags = !!S;
-    auto [imm32, carry] = _T32ExpandImm_C((i<<11) | (imm3<<8) | imm8, GETBITSM(_s.xpsr, XPSR__C));
+    auto [imm32, carry] = _T32ExpandImm_C((i<<11) | (imm3<<8) | imm8, _DecodeCarry());
     if (d == 13 || d == 15)
       THROW_UNPREDICTABLE();
 
     TRACEI(MOV_imm, T2, "d=%u S=%u imm32=0x%x carry=%u", d, setflags, imm32, carry);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_MOV_immediate(d, setflags, imm32, carry);
+    _Dispatch<&Simulator::_Exec_MOV_immediate>(d, setflags, imm32, carry);
   }
 
   /* _DecodeExecute32_AND_immediate_T1 {{{4
@@ -15895,14 +19759,14 @@ private:
     uint32_t  d         = Rd;
     uint32_t  n         = Rn;
     bool      setflags  = !!S;
-    auto [imm32, carry] = _T32ExpandImm_C((i<<11) | (imm3<<8) | imm8, GETBITSM(_s.xpsr, XPSR__C));
+    auto [imm32, carry] = _T32ExpandImm_C((i<<11) | (imm3<<8) | imm8, _DecodeCarry());
     if (d == 13 || (d == 15 && !S) || (n == 13 || n == 15))
       THROW_UNPREDICTABLE();
 
     TRACEI(AND_imm, T1, "d=%u n=%u S=%u imm32=0x%x carry=%u", d, n, setflags, imm32, carry);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_AND_immediate(d, n, setflags, imm32, carry);
+    _Dispatch<&Simulator::_Exec_AND_immediate>(d, n, setflags, imm32, carry);
   }
 
   /* _DecodeExecute32_10x1_0 {{{4
@@ -16023,7 +19887,7 @@ private:
     TRACEI(SUB_imm, T4, "d=%u n=%u S=%u imm32=0x%x", d, n, setflags, imm32);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_SUB_immediate(d, n, setflags, imm32);
+    _Dispatch<&Simulator::_Exec_SUB_immediate>(d, n, setflags, imm32);
   }
 
   /* _DecodeExecute32_ADD_immediate_T4 {{{4
@@ -16055,7 +19919,7 @@ private:
     TRACEI(ADD_imm, T4, "d=%u n=%u S=%u imm32=0x%x", d, n, setflags, imm32);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_ADD_immediate(d, n, setflags, imm32);
+    _Dispatch<&Simulator::_Exec_ADD_immediate>(d, n, setflags, imm32);
   }
 
   /* _DecodeExecute32_SUB_SP_minus_immediate_T3 {{{4
@@ -16080,7 +19944,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_SUB_SP_minus_immediate(d, setflags, imm32);
+    _Dispatch<&Simulator::_Exec_SUB_SP_minus_immediate>(d, setflags, imm32);
   }
 
   /* _DecodeExecute32_ADD_SP_plus_immediate_T4 {{{4
@@ -16105,7 +19969,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_ADD_SP_plus_immediate(d, setflags, imm32);
+    _Dispatch<&Simulator::_Exec_ADD_SP_plus_immediate>(d, setflags, imm32);
   }
 
   /* _DecodeExecute32_ADR_T3 {{{4
@@ -16129,7 +19993,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_ADR(d, imm32, add);
+    _Dispatch<&Simulator::_Exec_ADR>(d, imm32, add);
   }
 
   /* _DecodeExecute32_ADR_T2 {{{4
@@ -16154,7 +20018,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_ADR(d, imm32, add);
+    _Dispatch<&Simulator::_Exec_ADR>(d, imm32, add);
   }
 
   /* _DecodeExecute32_10x1_0_010 {{{4
@@ -16191,7 +20055,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_MOVT(d, imm16);
+    _Dispatch<&Simulator::_Exec_MOVT>(d, imm16);
   }
 
   /* _DecodeExecute32_MOV_immediate_T3 {{{4
@@ -16217,7 +20081,7 @@ private:
     TRACEI(MOV_imm, T3, "d=%u imm32=0x%x", d, imm32);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_MOV_immediate(d, setflags, imm32, carry);
+    _Dispatch<&Simulator::_Exec_MOV_immediate>(d, setflags, imm32, carry);
   }
 
   /* _DecodeExecute32_10x1_0_1 {{{4
@@ -16322,7 +20186,7 @@ private:
       THROW_UNDEFINED();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_SSAT(d, n, saturateTo, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_SSAT>(d, n, saturateTo, shiftT, shiftN);
   }
 
   /* _DecodeExecute32_USAT_T1 {{{4
@@ -16354,7 +20218,7 @@ private:
       THROW_UNDEFINED();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_USAT(d, n, saturateTo, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_USAT>(d, n, saturateTo, shiftT, shiftN);
   }
 
   /* _DecodeExecute32_SBFX_T1 {{{4
@@ -16387,7 +20251,7 @@ private:
       THROW_UNDEFINED();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_SBFX(d, n, lsbit, widthminus1, msbit);
+    _Dispatch<&Simulator::_Exec_SBFX>(d, n, lsbit, widthminus1, msbit);
   }
 
   /* _DecodeExecute32_UBFX_T1 {{{4
@@ -16420,7 +20284,7 @@ private:
       THROW_UNDEFINED();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_UBFX(d, n, lsbit, widthminus1, msbit);
+    _Dispatch<&Simulator::_Exec_UBFX>(d, n, lsbit, widthminus1, msbit);
   }
 
   /* _DecodeExecute32_1001_00_110_11 {{{4
@@ -16484,7 +20348,7 @@ private:
     // No additional decoding required.
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_CLREX();
+    _Dispatch<&Simulator::_Exec_CLREX>();
   }
 
   /* _DecodeExecute32_DSB_T1 {{{4
@@ -16500,7 +20364,7 @@ private:
     TRACEI(DSB, T1, "option=0x%x", option);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_DSB(option);
+    _Dispatch<&Simulator::_Exec_DSB>(option);
   }
 
   /* _DecodeExecute32_DMB_T1 {{{4
@@ -16516,7 +20380,7 @@ private:
     TRACEI(DMB, T1, "option=0x%x", option);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_DMB(option);
+    _Dispatch<&Simulator::_Exec_DMB>(option);
   }
 
   /* _DecodeExecute32_ISB_T1 {{{4
@@ -16532,7 +20396,7 @@ private:
     TRACEI(ISB, T1, "option=0x%x", option);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_ISB(option);
+    _Dispatch<&Simulator::_Exec_ISB>(option);
   }
 
   /* _DecodeExecute32_BFI_T1 {{{4
@@ -16566,7 +20430,7 @@ private:
     TRACEI(BFI, T1, "d=%u n=%u msbit=%u lsbit=%u", d, n, msbit, lsbit);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_BFI(d, n, msbit, lsbit);
+    _Dispatch<&Simulator::_Exec_BFI>(d, n, msbit, lsbit);
   }
 
   /* _DecodeExecute32_BFC_T1 {{{4
@@ -16598,7 +20462,7 @@ private:
     TRACEI(BFC, T1, "d=%u msbit=%u lsbit=%u", d, msbit, lsbit);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_BFC(d, msbit, lsbit);
+    _Dispatch<&Simulator::_Exec_BFC>(d, msbit, lsbit);
   }
 
   /* _DecodeExecute32_1100_xxxxx {{{4
@@ -16759,7 +20623,7 @@ private:
     bool     add    = true;
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_PLI_immediate_literal(n, imm32, add);
+    _Dispatch<&Simulator::_Exec_PLI_immediate_literal>(n, imm32, add);
   }
 
   /* _DecodeExecute32_LDRSB_immediate_T1 {{{4
@@ -16787,7 +20651,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDRSB_immediate(t, n, imm32, index, add, wback);
+    _Dispatch<&Simulator::_Exec_LDRSB_immediate>(t, n, imm32, index, add, wback);
   }
 
   /* _DecodeExecute32_LDRSH_immediate_T1 {{{4
@@ -16815,7 +20679,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDRSH_immediate(t, n, imm32, index, add, wback);
+    _Dispatch<&Simulator::_Exec_LDRSH_immediate>(t, n, imm32, index, add, wback);
   }
 
   /* _DecodeExecute32_1100_10xxx_11x1xx {{{4
@@ -16901,7 +20765,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDRSBT(t, n, postindex, add, registerForm, imm32);
+    _Dispatch<&Simulator::_Exec_LDRSBT>(t, n, postindex, add, registerForm, imm32);
   }
 
   /* _DecodeExecute32_LDRSHT_T1 {{{4
@@ -16928,7 +20792,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDRSHT(t, n, postindex, add, registerForm, imm32);
+    _Dispatch<&Simulator::_Exec_LDRSHT>(t, n, postindex, add, registerForm, imm32);
   }
 
   /* _DecodeExecute32_1100_10xxx_1100xx {{{4
@@ -17036,7 +20900,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDRSB_immediate(t, n, imm32, index, add, wback);
+    _Dispatch<&Simulator::_Exec_LDRSB_immediate>(t, n, imm32, index, add, wback);
   }
 
   /* _DecodeExecute32_LDRSH_immediate_T2 {{{4
@@ -17074,7 +20938,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDRSH_immediate(t, n, imm32, index, add, wback);
+    _Dispatch<&Simulator::_Exec_LDRSH_immediate>(t, n, imm32, index, add, wback);
   }
 
   /* _DecodeExecute32_1100_10xxx_000000 {{{4
@@ -17138,7 +21002,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_PLI_register(n, m, add, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_PLI_register>(n, m, add, shiftT, shiftN);
   }
 
   /* _DecodeExecute32_LDRSB_register_T2 {{{4
@@ -17169,7 +21033,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDRSB_register(t, n, m, index, add, wback, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_LDRSB_register>(t, n, m, index, add, wback, shiftT, shiftN);
   }
 
   /* _DecodeExecute32_LDRSH_register_T2 {{{4
@@ -17200,7 +21064,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDRSH_register(t, n, m, index, add, wback, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_LDRSH_register>(t, n, m, index, add, wback, shiftT, shiftN);
   }
 
   /* _DecodeExecute32_1100_00xxx_1110xx {{{4
@@ -17274,7 +21138,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDRBT(t, n, postindex, add, registerForm, imm32);
+    _Dispatch<&Simulator::_Exec_LDRBT>(t, n, postindex, add, registerForm, imm32);
   }
 
   /* _DecodeExecute32_LDRHT_T1 {{{4
@@ -17303,7 +21167,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDRHT(t, n, postindex, add, registerForm, imm32);
+    _Dispatch<&Simulator::_Exec_LDRHT>(t, n, postindex, add, registerForm, imm32);
   }
 
   /* _DecodeExecute32_LDRT_T1 {{{4
@@ -17332,7 +21196,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDRT(t, n, postindex, add, registerForm, imm32);
+    _Dispatch<&Simulator::_Exec_LDRT>(t, n, postindex, add, registerForm, imm32);
   }
 
   /* _DecodeExecute32_STRBT_T1 {{{4
@@ -17361,7 +21225,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_STRBT(t, n, postindex, add, registerForm, imm32);
+    _Dispatch<&Simulator::_Exec_STRBT>(t, n, postindex, add, registerForm, imm32);
   }
 
   /* _DecodeExecute32_STRHT_T1 {{{4
@@ -17390,7 +21254,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_STRHT(t, n, postindex, add, registerForm, imm32);
+    _Dispatch<&Simulator::_Exec_STRHT>(t, n, postindex, add, registerForm, imm32);
   }
 
   /* _DecodeExecute32_STRT_T1 {{{4
@@ -17419,7 +21283,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_STRT(t, n, postindex, add, registerForm, imm32);
+    _Dispatch<&Simulator::_Exec_STRT>(t, n, postindex, add, registerForm, imm32);
   }
 
   /* _DecodeExecute32_1100_00xxx_11x1xx {{{4
@@ -17541,7 +21405,7 @@ private:
     bool     isPLDW = !!W;
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_PLD_PLDW_immediate(n, imm32, add, isPLDW);
+    _Dispatch<&Simulator::_Exec_PLD_PLDW_immediate>(n, imm32, add, isPLDW);
   }
 
   /* _DecodeExecute32_1100_00xxx_10x1xx {{{4
@@ -17625,7 +21489,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDR_immediate(t, n, imm32, index, add, wback);
+    _Dispatch<&Simulator::_Exec_LDR_immediate>(t, n, imm32, index, add, wback);
   }
 
   /* _DecodeExecute32_LDRB_immediate_T3 {{{4
@@ -17666,7 +21530,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDRB_immediate(t, n, imm32, index, add, wback);
+    _Dispatch<&Simulator::_Exec_LDRB_immediate>(t, n, imm32, index, add, wback);
   }
 
   /* _DecodeExecute32_LDRH_immediate_T3 {{{4
@@ -17707,7 +21571,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDRH_immediate(t, n, imm32, index, add, wback);
+    _Dispatch<&Simulator::_Exec_LDRH_immediate>(t, n, imm32, index, add, wback);
   }
 
   /* _DecodeExecute32_STR_immediate_T4 {{{4
@@ -17741,7 +21605,7 @@ private:
       CUNPREDICTABLE_UNDEFINED();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_STR_immediate(t, n, imm32, index, add, wback);
+    _Dispatch<&Simulator::_Exec_STR_immediate>(t, n, imm32, index, add, wback);
   }
 
   /* _DecodeExecute32_STRB_immediate_T3 {{{4
@@ -17775,7 +21639,7 @@ private:
       CUNPREDICTABLE_UNDEFINED();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_STRB_immediate(t, n, imm32, index, add, wback);
+    _Dispatch<&Simulator::_Exec_STRB_immediate>(t, n, imm32, index, add, wback);
   }
 
   /* _DecodeExecute32_STRH_immediate_T3 {{{4
@@ -17809,7 +21673,7 @@ private:
       CUNPREDICTABLE_UNDEFINED();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_STRH_immediate(t, n, imm32, index, add, wback);
+    _Dispatch<&Simulator::_Exec_STRH_immediate>(t, n, imm32, index, add, wback);
   }
 
   /* _DecodeExecute32_1100_1xxx1_1111 {{{4
@@ -17872,7 +21736,7 @@ private:
     bool     add    = false;
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_PLI_immediate_literal(n, imm32, add);
+    _Dispatch<&Simulator::_Exec_PLI_immediate_literal>(n, imm32, add);
   }
 
   /* _DecodeExecute32_PLI_immediate_literal_T3 {{{4
@@ -17892,7 +21756,7 @@ private:
     bool     add    = !!U;
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_PLI_immediate_literal(n, imm32, add);
+    _Dispatch<&Simulator::_Exec_PLI_immediate_literal>(n, imm32, add);
   }
 
   /* _DecodeExecute32_LDRSB_literal_T1 {{{4
@@ -17918,7 +21782,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDRSB_literal(t, imm32, add);
+    _Dispatch<&Simulator::_Exec_LDRSB_literal>(t, imm32, add);
   }
 
   /* _DecodeExecute32_LDRSH_literal_T1 {{{4
@@ -17944,7 +21808,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDRSH_literal(t, imm32, add);
+    _Dispatch<&Simulator::_Exec_LDRSH_literal>(t, imm32, add);
   }
 
   /* _DecodeExecute32_ReservedHint {{{4
@@ -17957,7 +21821,7 @@ private:
     TRACEI(RSVD_HINT, UNK32, "");
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_NOP();
+    _Dispatch<&Simulator::_Exec_NOP>();
   }
 
   /* _DecodeExecute32_1100_00xxx_xxxx_000000 {{{4
@@ -18054,7 +21918,7 @@ private:
     TRACEI(STR_reg, T2, "t=%u n=%u m=%u shiftT=%u shiftN=%u", t, n, m, shiftT, shiftN);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_STR_register(t, n, m, index, add, wback, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_STR_register>(t, n, m, index, add, wback, shiftT, shiftN);
   }
 
   /* _DecodeExecute32_STRB_register_T2 {{{4
@@ -18086,7 +21950,7 @@ private:
     TRACEI(STRB_reg, T2, "t=%u n=%u m=%u shiftT=%u shiftN=%u", t, n, m, shiftT, shiftN);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_STRB_register(t, n, m, index, add, wback, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_STRB_register>(t, n, m, index, add, wback, shiftT, shiftN);
   }
 
   /* _DecodeExecute32_STRH_register_T2 {{{4
@@ -18118,7 +21982,7 @@ private:
     TRACEI(STRH_reg, T2, "t=%u n=%u m=%u shiftT=%u shiftN=%u", t, n, m, shiftT, shiftN);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_STRH_register(t, n, m, index, add, wback, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_STRH_register>(t, n, m, index, add, wback, shiftT, shiftN);
   }
 
   /* _DecodeExecute32_PLD_register_RO {{{4
@@ -18149,7 +22013,7 @@ private:
     TRACEI(PLD_reg, RO, "n=%u m=%u shiftT=%u shiftN=%u", n, m, shiftT, shiftN);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_PLD_register(n, m, add, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_PLD_register>(n, m, add, shiftT, shiftN);
   }
 
   /* _DecodeExecute32_LDR_register_T2 {{{4
@@ -18184,7 +22048,7 @@ private:
     TRACEI(LDR_reg, T2, "t=%u n=%u m=%u shiftL=%u", t, n, m, shiftN);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDR_register(t, n, m, index, add, wback, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_LDR_register>(t, n, m, index, add, wback, shiftT, shiftN);
   }
 
   /* _DecodeExecute32_LDRB_register_T2 {{{4
@@ -18216,7 +22080,7 @@ private:
     TRACEI(LDRB_reg, T2, "t=%u n=%u m=%u shiftL=%u", t, n, m, shiftN);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDRB_register(t, n, m, index, add, wback, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_LDRB_register>(t, n, m, index, add, wback, shiftT, shiftN);
   }
 
   /* _DecodeExecute32_LDRH_register_T2 {{{4
@@ -18248,7 +22112,7 @@ private:
     TRACEI(LDRH_reg, T2, "t=%u n=%u m=%u shiftL=%u", t, n, m, shiftN);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDRH_register(t, n, m, index, add, wback, shiftT, shiftN);
+    _Dispatch<&Simulator::_Exec_LDRH_register>(t, n, m, index, add, wback, shiftT, shiftN);
   }
 
   /* _DecodeExecute32_1100_0xxxx_1111 {{{4
@@ -18323,7 +22187,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDRH_literal(t, imm32, add);
+    _Dispatch<&Simulator::_Exec_LDRH_literal>(t, imm32, add);
   }
 
   /* _DecodeExecute32_LDRB_literal_T1 {{{4
@@ -18348,7 +22212,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDRB_literal(t, imm32, add);
+    _Dispatch<&Simulator::_Exec_LDRB_literal>(t, imm32, add);
   }
 
   /* _DecodeExecute32_PLD_literal_T1 {{{4
@@ -18367,7 +22231,7 @@ private:
     bool     add    = !!U;
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_PLD_literal(imm32, add);
+    _Dispatch<&Simulator::_Exec_PLD_literal>(imm32, add);
   }
 
   /* _DecodeExecute32_LDR_literal_T2 {{{4
@@ -18393,7 +22257,7 @@ private:
     TRACEI(LDR_lit, T2, "t=%u imm32=0x%x add=%u", t, imm32, add);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDR_literal(t, imm32, add);
+    _Dispatch<&Simulator::_Exec_LDR_literal>(t, imm32, add);
   }
 
   /* _DecodeExecute32_1100_01xxx_xxxx {{{4
@@ -18479,7 +22343,7 @@ private:
     bool     isPLDW = !!W;
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_PLD_PLDW_immediate(n, imm32, add, isPLDW);
+    _Dispatch<&Simulator::_Exec_PLD_PLDW_immediate>(n, imm32, add, isPLDW);
   }
 
   /* _DecodeExecute32_STRB_immediate_T2 {{{4
@@ -18507,7 +22371,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_STRB_immediate(t, n, imm32, index, add, wback);
+    _Dispatch<&Simulator::_Exec_STRB_immediate>(t, n, imm32, index, add, wback);
   }
 
   /* _DecodeExecute32_STRH_immediate_T2 {{{4
@@ -18535,7 +22399,7 @@ private:
       THROW_UNPREDICTABLE();
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_STRH_immediate(t, n, imm32, index, add, wback);
+    _Dispatch<&Simulator::_Exec_STRH_immediate>(t, n, imm32, index, add, wback);
   }
 
   /* _DecodeExecute32_STR_immediate_T3 {{{4
@@ -18563,7 +22427,7 @@ private:
     TRACEI(STR_imm, T3, "t=%u n=%u imm32=0x%x", t, n, imm32);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_STR_immediate(t, n, imm32, index, add, wback);
+    _Dispatch<&Simulator::_Exec_STR_immediate>(t, n, imm32, index, add, wback);
   }
 
   /* _DecodeExecute32_LDRB_immediate_T2 {{{4
@@ -18592,7 +22456,7 @@ private:
     TRACEI(LDRB_imm, T2, "t=%u n=%u imm32=0x%x", t, n, imm32);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDRB_immediate(t, n, imm32, index, add, wback);
+    _Dispatch<&Simulator::_Exec_LDRB_immediate>(t, n, imm32, index, add, wback);
   }
 
   /* _DecodeExecute32_LDRH_immediate_T2 {{{4
@@ -18621,7 +22485,7 @@ private:
     TRACEI(LDRH_imm, T2, "t=%u n=%u imm32=0x%x", t, n, imm32);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDRH_immediate(t, n, imm32, index, add, wback);
+    _Dispatch<&Simulator::_Exec_LDRH_immediate>(t, n, imm32, index, add, wback);
   }
 
   /* _DecodeExecute32_LDR_immediate_T3 {{{4
@@ -18649,7 +22513,7 @@ private:
     TRACEI(LDR_imm, T3, "t=%u n=%u imm32=0x%x", t, n, imm32);
 
     // ---- EXECUTE -------------------------------------------------
-    _Exec_LDR_immediate(t, n, imm32, index, add, wback);
+    _Dispatch<&Simulator::_Exec_LDR_immediate>(t, n, imm32, index, add, wback);
   }
 
   /* Instruction Execution {{{3
@@ -18665,13 +22529,10 @@ private:
       return;
 
     //EncodingSpecificOperations
-    auto [result, carry, overflow] = _AddWithCarry(_GetR(n), imm32, GETBITSM(_s.xpsr, XPSR__C));
+    auto [result, carry, overflow] = _AddWithCarry(_GetR(n), imm32, _CarryFlag());
     _SetR(d, result);
     if (setflags) {
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__N, GETBIT(result, 31));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__Z, _IsZeroBit(result));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__C, carry);
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__V, overflow);
+      _SetFlagsNZCV(result, carry, overflow);
     }
   }
 
@@ -18684,14 +22545,11 @@ private:
       return;
 
     //EncodingSpecificOperations
-    uint32_t shifted = _Shift(_GetR(m), shiftT, shiftN, GETBITSM(_s.xpsr, XPSR__C));
-    auto [result, carry, overflow] = _AddWithCarry(_GetR(n), shifted, GETBITSM(_s.xpsr, XPSR__C));
+    uint32_t shifted = _Shift(_GetR(m), shiftT, shiftN, _CarryFlag());
+    auto [result, carry, overflow] = _AddWithCarry(_GetR(n), shifted, _CarryFlag());
     _SetR(d, result);
     if (setflags) {
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__N, GETBIT(result,31));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__Z, _IsZeroBit(result));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__C, carry);
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__V, overflow);
+      _SetFlagsNZCV(result, carry, overflow);
     }
   }
 
@@ -18707,10 +22565,7 @@ private:
     auto [result, carry, overflow] = _AddWithCarry(_GetSP(), imm32, false);
     _SetRSPCheck(d, result);
     if (setflags) {
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__N, GETBIT(result, 31));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__Z, _IsZeroBit(result));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__C, carry);
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__V, overflow);
+      _SetFlagsNZCV(result, carry, overflow);
     }
   }
 
@@ -18723,17 +22578,14 @@ private:
       return;
 
     //EncodingSpecificOperations
-    uint32_t shifted = _Shift(_GetR(m), shiftT, shiftN, GETBITSM(_s.xpsr, XPSR__C));
+    uint32_t shifted = _Shift(_GetR(m), shiftT, shiftN, _CarryFlag());
     auto [result, carry, overflow] = _AddWithCarry(_GetSP(), shifted, false);
     if (d == 15)
       _ALUWritePC(result); // setflags is always false here
     else {
       _SetRSPCheck(d, result);
       if (setflags) {
-        _s.xpsr = CHGBITSM(_s.xpsr, XPSR__N, GETBIT(result,31));
-        _s.xpsr = CHGBITSM(_s.xpsr, XPSR__Z, _IsZeroBit(result));
-        _s.xpsr = CHGBITSM(_s.xpsr, XPSR__C, carry);
-        _s.xpsr = CHGBITSM(_s.xpsr, XPSR__V, overflow);
+        _SetFlagsNZCV(result, carry, overflow);
       }
     }
   }
@@ -18750,10 +22602,7 @@ private:
     auto [result, carry, overflow] = _AddWithCarry(_GetR(n), imm32, false);
     _SetR(d, result);
     if (setflags) {
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__N, GETBIT(result,31));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__Z, _IsZeroBit(result));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__C, carry);
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__V, overflow);
+      _SetFlagsNZCV(result, carry, overflow);
     }
   }
 
@@ -18766,17 +22615,14 @@ private:
       return;
 
     //EncodingSpecificOperations
-    uint32_t shifted = _Shift(_GetR(m), shiftT, shiftN, GETBITSM(_s.xpsr, XPSR__C));
+    uint32_t shifted = _Shift(_GetR(m), shiftT, shiftN, _CarryFlag());
     auto [result, carry, overflow] = _AddWithCarry(_GetR(n), shifted, false);
     if (d == 15)
       _ALUWritePC(result);
     else {
       _SetR(d, result);
       if (setflags) {
-        _s.xpsr = CHGBITSM(_s.xpsr, XPSR__N, GETBIT(result, 31));
-        _s.xpsr = CHGBITSM(_s.xpsr, XPSR__Z, _IsZeroBit(result));
-        _s.xpsr = CHGBITSM(_s.xpsr, XPSR__C, carry);
-        _s.xpsr = CHGBITSM(_s.xpsr, XPSR__V, overflow);
+        _SetFlagsNZCV(result, carry, overflow);
       }
     }
   }
@@ -18807,9 +22653,7 @@ private:
     _SetR(d, result);
 
     if (setflags) {
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__N, GETBIT(result,31));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__Z, _IsZeroBit(result));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__C, carry);
+      _SetFlagsNZC(result, carry);
       // APSR.V unchanged
     }
   }
@@ -18823,13 +22667,11 @@ private:
       return;
 
     //EncodingSpecificOperations
-    auto [shifted, carry] = _Shift_C(_GetR(m), shiftT, shiftN, GETBITSM(_s.xpsr, XPSR__C));
+    auto [shifted, carry] = _Shift_C(_GetR(m), shiftT, shiftN, _CarryFlag());
     uint32_t result = _GetR(n) & shifted;
     _SetR(d, result);
     if (setflags) {
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__N, GETBIT(result, 31));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__Z, _IsZeroBit(result));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__C, carry);
+      _SetFlagsNZC(result, carry);
       // APSR.V unchanged
     }
   }
@@ -18888,9 +22730,7 @@ private:
     uint32_t result = _GetR(n) & ~imm32;
     _SetR(d, result);
     if (setflags) {
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__N, GETBIT(result,31));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__Z, _IsZeroBit(result));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__C, carry);
+      _SetFlagsNZC(result, carry);
       // APSR.V unchanged
     }
   }
@@ -18904,13 +22744,11 @@ private:
       return;
 
     //EncodingSpecificOperations
-    auto [shifted, carry] = _Shift_C(_GetR(m), shiftT, shiftN, GETBITSM(_s.xpsr, XPSR__C));
+    auto [shifted, carry] = _Shift_C(_GetR(m), shiftT, shiftN, _CarryFlag());
     uint32_t result = _GetR(n) & ~shifted;
     _SetR(d, result);
     if (setflags) {
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__N, GETBIT(result,31));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__Z, _IsZeroBit(result));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__C, carry);
+      _SetFlagsNZC(result, carry);
       // APSR.V unchanged
     }
   }
@@ -19059,10 +22897,7 @@ private:
 
     //EncodingSpecificOperations
     auto [result, carry, overflow] = _AddWithCarry(_GetR(n), ~imm32, true);
-    _s.xpsr = CHGBITSM(_s.xpsr, XPSR__N, GETBIT(result, 31));
-    _s.xpsr = CHGBITSM(_s.xpsr, XPSR__Z, _IsZeroBit(result));
-    _s.xpsr = CHGBITSM(_s.xpsr, XPSR__C, carry);
-    _s.xpsr = CHGBITSM(_s.xpsr, XPSR__V, overflow);
+    _SetFlagsNZCV(result, carry, overflow);
   }
 
   /* _Exec_CMP_register {{{4
@@ -19074,12 +22909,9 @@ private:
       return;
 
     //EncodingSpecificOperations
-    uint32_t shifted = _Shift(_GetR(m), shiftT, shiftN, GETBITSM(_s.xpsr, XPSR__C));
+    uint32_t shifted = _Shift(_GetR(m), shiftT, shiftN, _CarryFlag());
     auto [result, carry, overflow] = _AddWithCarry(_GetR(n), ~shifted, true);
-    _s.xpsr = CHGBITSM(_s.xpsr, XPSR__N, GETBIT(result,31));
-    _s.xpsr = CHGBITSM(_s.xpsr, XPSR__Z, _IsZeroBit(result));
-    _s.xpsr = CHGBITSM(_s.xpsr, XPSR__C, carry);
-    _s.xpsr = CHGBITSM(_s.xpsr, XPSR__V, overflow);
+    _SetFlagsNZCV(result, carry, overflow);
   }
 
   /* _Exec_CMN_immediate {{{4
@@ -19092,10 +22924,7 @@ private:
 
     //EncodingSpecificOperations
     auto [result, carry, overflow] = _AddWithCarry(_GetR(n), imm32, false);
-    _s.xpsr = CHGBITSM(_s.xpsr, XPSR__N, GETBIT(result, 31));
-    _s.xpsr = CHGBITSM(_s.xpsr, XPSR__Z, _IsZeroBit(result));
-    _s.xpsr = CHGBITSM(_s.xpsr, XPSR__C, carry);
-    _s.xpsr = CHGBITSM(_s.xpsr, XPSR__V, overflow);
+    _SetFlagsNZCV(result, carry, overflow);
   }
 
   /* _Exec_CMN_register {{{4
@@ -19107,12 +22936,9 @@ private:
       return;
 
     //EncodingSpecificOperations
-    uint32_t shifted = _Shift(_GetR(m), shiftT, shiftN, GETBITSM(_s.xpsr, XPSR__C));
+    uint32_t shifted = _Shift(_GetR(m), shiftT, shiftN, _CarryFlag());
     auto [result, carry, overflow] = _AddWithCarry(_GetR(n), shifted, false);
-    _s.xpsr = CHGBITSM(_s.xpsr, XPSR__N, GETBIT(result,31));
-    _s.xpsr = CHGBITSM(_s.xpsr, XPSR__Z, _IsZeroBit(result));
-    _s.xpsr = CHGBITSM(_s.xpsr, XPSR__C, carry);
-    _s.xpsr = CHGBITSM(_s.xpsr, XPSR__V, overflow);
+    _SetFlagsNZCV(result, carry, overflow);
   }
 
   /* _Exec_CPS {{{4
@@ -19185,9 +23011,7 @@ private:
     uint32_t result = _GetR(n) ^ imm32;
     _SetR(d, result);
     if (setflags) {
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__N, GETBIT(result, 31));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__Z, _IsZeroBit(result));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__C, carry);
+      _SetFlagsNZC(result, carry);
       // APSR.V unchanged
     }
   }
@@ -19200,13 +23024,11 @@ private:
       return;
 
     //EncodingSpecificOperations
-    auto [shifted, carry] = _Shift_C(_GetR(m), shiftT, shiftN, GETBITSM(_s.xpsr, XPSR__C));
+    auto [shifted, carry] = _Shift_C(_GetR(m), shiftT, shiftN, _CarryFlag());
     uint32_t result = _GetR(n) ^ shifted;
     _SetR(d, result);
     if (setflags) {
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__N, GETBIT(result,31));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__Z, _IsZeroBit(result));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__C, carry);
+      _SetFlagsNZC(result, carry);
       // APSR.V unchanged
     }
   }
@@ -19242,7 +23064,9 @@ private:
 
     //EncodingSpecificOperations
     uint32_t addr = _GetR(n);
-    _SetR(t, _ZeroExtend(_MemO(addr, 1), 32));
+    uint32_t data = _MemO(addr, 1);
+    RETURN_IF_TERMINATED();
+    _SetR(t, _ZeroExtend(data, 32));
   }
 
   /* _Exec_LDAH {{{4
@@ -19255,7 +23079,9 @@ private:
 
     //EncodingSpecificOperations
     uint32_t addr = _GetR(n);
-    _SetR(t, _ZeroExtend(_MemO(addr, 2), 32));
+    uint32_t data = _MemO(addr, 2);
+    RETURN_IF_TERMINATED();
+    _SetR(t, _ZeroExtend(data, 32));
   }
 
   /* _Exec_LDA {{{4
@@ -19268,7 +23094,9 @@ private:
 
     //EncodingSpecificOperations
     uint32_t addr = _GetR(n);
-    _SetR(t, _ZeroExtend(_MemO(addr, 4), 32));
+    uint32_t data = _MemO(addr, 4);
+    RETURN_IF_TERMINATED();
+    _SetR(t, _ZeroExtend(data, 32));
   }
 
   /* _Exec_LDAEXB {{{4
@@ -19282,7 +23110,9 @@ private:
     //EncodingSpecificOperations
     uint32_t addr = _GetR(n);
     _SetExclusiveMonitors(addr, 1);
-    _SetR(t, _ZeroExtend(_MemO(addr, 1), 32));
+    uint32_t data = _MemO(addr, 1);
+    RETURN_IF_TERMINATED();
+    _SetR(t, _ZeroExtend(data, 32));
   }
 
   /* _Exec_LDAEXH {{{4
@@ -19296,7 +23126,9 @@ private:
     //EncodingSpecificOperations
     uint32_t addr = _GetR(n);
     _SetExclusiveMonitors(addr, 2);
-    _SetR(t, _ZeroExtend(_MemO(addr, 2), 32));
+    uint32_t data = _MemO(addr, 2);
+    RETURN_IF_TERMINATED();
+    _SetR(t, _ZeroExtend(data, 32));
   }
 
   /* _Exec_LDAEX {{{4
@@ -19310,7 +23142,9 @@ private:
     //EncodingSpecificOperations
     uint32_t addr = _GetR(n);
     _SetExclusiveMonitors(addr, 4);
-    _SetR(t, _ZeroExtend(_MemO(addr, 4), 32));
+    uint32_t data = _MemO(addr, 4);
+    RETURN_IF_TERMINATED();
+    _SetR(t, _ZeroExtend(data, 32));
   }
 
   /* _Exec_LDC_LDC2_immediate {{{4
@@ -19342,7 +23176,9 @@ private:
     // Memory operation only performed if limit not violated.
     if (!applyLimit || offsetAddr >= limit) {
       do {
-        _Coproc_SendLoadedWord(_MemA(addr, 4), cp, _ThisInstr());
+        uint32_t data = _MemA(addr, 4);
+        RETURN_IF_TERMINATED();
+        _Coproc_SendLoadedWord(data, cp, _ThisInstr());
         addr += 4;
       } while (!_Coproc_DoneLoading(cp, _ThisInstr()));
     }
@@ -19370,7 +23206,9 @@ private:
     uint32_t addr       = index ? offsetAddr : _Align(_GetPC(), 4);
 
     do {
-      _Coproc_SendLoadedWord(_MemA(addr, 4), cp, _ThisInstr());
+      uint32_t data = _MemA(addr, 4);
+      RETURN_IF_TERMINATED();
+      _Coproc_SendLoadedWord(data, cp, _ThisInstr());
       addr += 4;
     } while (!_Coproc_DoneLoading(cp, _ThisInstr()));
   }
@@ -19410,23 +23248,29 @@ private:
     } else
       applyLimit = false;
 
-    uint32_t newBaseVal = 0; // ???
-    for (int i=0; i<15; ++i) {
-      // If R[n] is the SP, memory operation only performed if limit not violated.
-      if (GETBIT(registers, i) && (!applyLimit || addr >= limit)) {
-        if (i != n)
-          _SetR(i, _MemA(addr, 4));
-        else
-          newBaseVal = _MemA(addr, 4);
+    // The words are loaded with a single burst. Registers loaded before any
+    // fault are updated as if the words had been loaded one at a time.
+    uint32_t newBaseVal = 0, newPCVal = 0; // ???
+    int      count = _BitCount(registers);
+    // If R[n] is the SP, memory operation only performed if limit not violated.
+    if (!applyLimit || addr >= limit) {
+      uint32_t data[16];
+      auto [excInfo, done] = _MemA_LoadBurst(addr, count, AccType_NORMAL, _FindPriv(), _IsSecure(), data);
+      for (int i=0, j=0; i<15 && j<done; ++i)
+        if (GETBIT(registers, i)) {
+          if (i != n)
+            _SetR(i, data[j]);
+          else
+            newBaseVal = data[j];
+          ++j;
+        }
 
-        addr += 4;
-      }
+      _RaiseFault(excInfo);
+      RETURN_IF_TERMINATED();
+      if (GETBIT(registers, 15))
+        newPCVal = data[count-1];
     }
 
-    uint32_t newPCVal = 0; // ???
-    if (GETBIT(registers, 15) && (!applyLimit || addr >= limit))
-      newPCVal = _MemA(addr, 4);
-
     // If the register list contains the register that holds the base address
     // it must be updated after all memory reads have been performed. This
     // prevents the base address being overwritten if one of the memory reads
@@ -19466,19 +23310,24 @@ private:
     } else
       doOperation = true;
 
-    uint32_t data = 0, newPCVal = 0, newBaseVal = 0;
-    for (int i=0; i<16; ++i) {
-      // Memory operation only performed if limit not violated
-      if (GETBIT(registers, i) && doOperation) {
-        data   = _MemA(addr, 4);
-        addr  += 4;
-        if (i == 15)
-          newPCVal = data;
-        else if (i == n)
-          newBaseVal = data;
-        else
-          _SetR(i, data);
-      }
+    uint32_t newPCVal = 0, newBaseVal = 0;
+    // Memory operation only performed if limit not violated
+    if (doOperation) {
+      uint32_t data[16];
+      auto [excInfo, done] = _MemA_LoadBurst(addr, _BitCount(registers), AccType_NORMAL, _FindPriv(), _IsSecure(), data);
+      for (int i=0, j=0; i<16 && j<done; ++i)
+        if (GETBIT(registers, i)) {
+          if (i == 15)
+            newPCVal = data[j];
+          else if (i == n)
+            newBaseVal = data[j];
+          else
+            _SetR(i, data[j]);
+          ++j;
+        }
+
+      _RaiseFault(excInfo);
+      RETURN_IF_TERMINATED();
     }
 
     // If the register list contains the register that holds the base
@@ -19519,8 +23368,10 @@ private:
 
     // Memory operation only performed if limit not violated
     uint32_t data = 0;
-    if (!applyLimit || offsetAddr >= limit)
+    if (!applyLimit || offsetAddr >= limit) {
       data = _MemU(addr, 4);
+      RETURN_IF_TERMINATED();
+    }
 
     // If the stack pointer is being updated a fault will be
     // raised if the limit is violated
@@ -19549,6 +23400,7 @@ private:
     uint32_t base     = _Align(_GetPC(), 4);
     uint32_t address  = add ? base + imm32 : base - imm32;
     uint32_t data     = _MemU(address, 4);
+    RETURN_IF_TERMINATED();
     if (t == 15) {
       if (GETBITS(address, 0, 1) == 0b00)
         _LoadWritePC(data, 0, 0, false, false);
@@ -19567,7 +23419,7 @@ private:
       return;
 
     //EncodingSpecificOperations
-    uint32_t offset     = _Shift(_GetR(m), shiftT, shiftN, GETBITSM(_s.xpsr, XPSR__C));
+    uint32_t offset     = _Shift(_GetR(m), shiftT, shiftN, _CarryFlag());
     uint32_t offsetAddr = add ? _GetR(n) + offset : _GetR(n) - offset;
     uint32_t addr       = index ? offsetAddr : _GetR(n);
 
@@ -19582,8 +23434,10 @@ private:
     uint32_t data = 0;
 
     // Memory operation only performed if limit not violated.
-    if (!applyLimit && offsetAddr >= limit)
+    if (!applyLimit && offsetAddr >= limit) {
       data = _MemU(addr, 4);
+      RETURN_IF_TERMINATED();
+    }
 
     // If the stack pointer is being updated a fault will be raised
     // if the limit is violated.
@@ -19622,8 +23476,11 @@ private:
       applyLimit = false;
 
     // Memory operation only performed if limit not violated.
-    if (!applyLimit || offsetAddr >= limit)
-      _SetR(t, _ZeroExtend(_MemU(addr, 1), 32));
+    if (!applyLimit || offsetAddr >= limit) {
+      uint32_t data = _MemU(addr, 1);
+      RETURN_IF_TERMINATED();
+      _SetR(t, _ZeroExtend(data, 32));
+    }
 
     // If the stack pointer is benig updated a fault will be raised if the
     // limit is violated.
@@ -19653,8 +23510,11 @@ private:
       applyLimit = false;
 
     // Memory operation only performed if limit not violated.
-    if (!applyLimit || offsetAddr >= limit)
-      _SetR(t, _SignExtend(_MemU(addr, 1), 8, 32));
+    if (!applyLimit || offsetAddr >= limit) {
+      uint32_t data = _MemU(addr, 1);
+      RETURN_IF_TERMINATED();
+      _SetR(t, _SignExtend(data, 8, 32));
+    }
 
     // If the stack pointer is benig updated a fault will be raised if the
     // limit is violated.
@@ -19673,7 +23533,9 @@ private:
     //EncodingSpecificOperations
     uint32_t base = _Align(_GetPC(), 4);
     uint32_t addr = add ? base + imm32 : base - imm32;
-    _SetR(t, _ZeroExtend(_MemU(addr, 1), 32));
+    uint32_t data = _MemU(addr, 1);
+    RETURN_IF_TERMINATED();
+    _SetR(t, _ZeroExtend(data, 32));
   }
 
   /* _Exec_LDRB_register {{{4
@@ -19685,10 +23547,12 @@ private:
       return;
 
     //EncodingSpecificOperations
-    uint32_t offset     = _Shift(_GetR(m), shiftT, shiftN, GETBITSM(_s.xpsr, XPSR__C));
+    uint32_t offset     = _Shift(_GetR(m), shiftT, shiftN, _CarryFlag());
     uint32_t offsetAddr = add ? _GetR(n) + offset : _GetR(n) - offset;
     uint32_t addr       = index ? offsetAddr : _GetR(n);
-    _SetR(t, _ZeroExtend(_MemU(addr, 1), 32));
+    uint32_t data = _MemU(addr, 1);
+    RETURN_IF_TERMINATED();
+    _SetR(t, _ZeroExtend(data, 32));
   }
 
   /* _Exec_LDRBT {{{4
@@ -19700,7 +23564,9 @@ private:
       return;
 
     uint32_t addr = _GetR(n) + imm32;
-    _SetR(t, _ZeroExtend(_MemU_unpriv(addr, 1), 32));
+    uint32_t data = _MemU_unpriv(addr, 1);
+    RETURN_IF_TERMINATED();
+    _SetR(t, _ZeroExtend(data, 32));
   }
 
   /* _Exec_LDRHT {{{4
@@ -19713,6 +23579,7 @@ private:
 
     uint32_t addr = _GetR(n) + imm32;
     uint32_t data = _MemU_unpriv(addr, 2);
+    RETURN_IF_TERMINATED();
     _SetR(t, _ZeroExtend(data, 32));
   }
 
@@ -19725,7 +23592,9 @@ private:
       return;
 
     uint32_t addr = _GetR(n) + imm32;
-    _SetR(t, _SignExtend(_MemU_unpriv(addr, 1), 8, 32));
+    uint32_t data = _MemU_unpriv(addr, 1);
+    RETURN_IF_TERMINATED();
+    _SetR(t, _SignExtend(data, 8, 32));
   }
 
   /* _Exec_LDRSHT {{{4
@@ -19738,6 +23607,7 @@ private:
 
     uint32_t addr = _GetR(n) + imm32;
     uint32_t data = _MemU_unpriv(addr, 2);
+    RETURN_IF_TERMINATED();
     _SetR(t, _SignExtend(data, 16, 32));
   }
 
@@ -19751,6 +23621,7 @@ private:
 
     uint32_t addr = _GetR(n) + imm32;
     uint32_t data = _MemU_unpriv(addr, 4);
+    RETURN_IF_TERMINATED();
     _SetR(t, data);
   }
 
@@ -19766,6 +23637,7 @@ private:
     uint32_t base = _Align(_GetPC(), 4);
     uint32_t addr = add ? base + imm32 : base - imm32;
     uint32_t data = _MemU(addr, 2);
+    RETURN_IF_TERMINATED();
     _SetR(t, _ZeroExtend(data, 32));
   }
 
@@ -19789,8 +23661,12 @@ private:
       applyLimit = false;
 
     if (!applyLimit || offsetAddr >= limit) {
-      _SetR(t,  _MemA(address,   4));
-      _SetR(t2, _MemA(address+4, 4));
+      uint32_t data = _MemA(address,   4);
+      RETURN_IF_TERMINATED();
+      _SetR(t,  data);
+      uint32_t data2 = _MemA(address+4, 4);
+      RETURN_IF_TERMINATED();
+      _SetR(t2, data2);
     }
 
     if (wback)
@@ -19812,8 +23688,12 @@ private:
       CUNPREDICTABLE_UNALIGNED();
 
     uint32_t addr = add ? _GetPC() + imm32 : _GetPC() - imm32;
-    _SetR(t,  _MemA(addr  , 4));
-    _SetR(t2, _MemA(addr+4, 4));
+    uint32_t data = _MemA(addr  , 4);
+    RETURN_IF_TERMINATED();
+    _SetR(t,  data);
+    uint32_t data2 = _MemA(addr+4, 4);
+    RETURN_IF_TERMINATED();
+    _SetR(t2, data2);
   }
 
   /* _Exec_LDREX {{{4
@@ -19827,7 +23707,9 @@ private:
     //EncodingSpecificOperations
     uint32_t addr = _GetR(n) + imm32;
     _SetExclusiveMonitors(addr, 4);
-    _SetR(t, _MemA(addr, 4));
+    uint32_t data = _MemA(addr, 4);
+    RETURN_IF_TERMINATED();
+    _SetR(t, data);
   }
 
   /* _Exec_LDREXB {{{4
@@ -19841,7 +23723,9 @@ private:
     //EncodingSpecificOperations
     uint32_t addr = _GetR(n);
     _SetExclusiveMonitors(addr, 1);
-    _SetR(t, _ZeroExtend(_MemA(addr, 1), 32));
+    uint32_t data = _MemA(addr, 1);
+    RETURN_IF_TERMINATED();
+    _SetR(t, _ZeroExtend(data, 32));
   }
 
   /* _Exec_LDREXH {{{4
@@ -19855,7 +23739,9 @@ private:
     //EncodingSpecificOperations
     uint32_t addr = _GetR(n);
     _SetExclusiveMonitors(addr, 2);
-    _SetR(t, _ZeroExtend(_MemA(addr, 2), 32));
+    uint32_t data = _MemA(addr, 2);
+    RETURN_IF_TERMINATED();
+    _SetR(t, _ZeroExtend(data, 32));
   }
 
   /* _Exec_LDRH_immediate {{{4
@@ -19880,8 +23766,11 @@ private:
       applyLimit = false;
 
     // Memory operation only performed if limit not violated.
-    if (!applyLimit || offsetAddr >= limit)
-      _SetR(t, _ZeroExtend(_MemU(addr, 2), 32));
+    if (!applyLimit || offsetAddr >= limit) {
+      uint32_t data = _MemU(addr, 2);
+      RETURN_IF_TERMINATED();
+      _SetR(t, _ZeroExtend(data, 32));
+    }
 
     // If the stack pointer is benig updated a fault will be raised if the
     // limit is violated.
@@ -19911,8 +23800,11 @@ private:
       applyLimit = false;
 
     // Memory operation only performed if limit not violated.
-    if (!applyLimit || offsetAddr >= limit)
-      _SetR(t, _SignExtend(_MemU(addr, 2), 16, 32));
+    if (!applyLimit || offsetAddr >= limit) {
+      uint32_t data = _MemU(addr, 2);
+      RETURN_IF_TERMINATED();
+      _SetR(t, _SignExtend(data, 16, 32));
+    }
 
     // If the stack pointer is benig updated a fault will be raised if the
     // limit is violated.
@@ -19929,11 +23821,12 @@ private:
       return;
 
     //EncodingSpecificOperations
-    uint32_t offset     = _Shift(_GetR(m), shiftT, shiftN, GETBITSM(_s.xpsr, XPSR__C));
+    uint32_t offset     = _Shift(_GetR(m), shiftT, shiftN, _CarryFlag());
     uint32_t offsetAddr = add ? _GetR(n) + offset : _GetR(n) - offset;
     uint32_t addr       = index ? offsetAddr : _GetR(n);
 
     uint32_t data = _MemU(addr, 2);
+    RETURN_IF_TERMINATED();
     if (wback)
       _SetR(n, offsetAddr);
 
@@ -19952,6 +23845,7 @@ private:
     uint32_t base = _Align(_GetPC(), 4);
     uint32_t addr = add ? base + imm32 : base - imm32;
     uint32_t data = _MemU(addr, 1);
+    RETURN_IF_TERMINATED();
     _SetR(t, _SignExtend(data, 8, 32));
   }
 
@@ -19964,10 +23858,12 @@ private:
       return;
 
     //EncodingSpecificOperations
-    uint32_t offset     = _Shift(_GetR(m), shiftT, shiftN, GETBITSM(_s.xpsr, XPSR__C));
+    uint32_t offset     = _Shift(_GetR(m), shiftT, shiftN, _CarryFlag());
     uint32_t offsetAddr = add ? _GetR(n) + offset : _GetR(n) - offset;
     uint32_t addr       = index ? offsetAddr : _GetR(n);
-    _SetR(t, _SignExtend(_MemU(addr, 1), 8, 32));
+    uint32_t data = _MemU(addr, 1);
+    RETURN_IF_TERMINATED();
+    _SetR(t, _SignExtend(data, 8, 32));
   }
 
   /* _Exec_LDRSH_literal {{{4
@@ -19982,6 +23878,7 @@ private:
     uint32_t base = _Align(_GetPC(), 4);
     uint32_t addr = add ? base + imm32 : base - imm32;
     uint32_t data = _MemU(addr, 2);
+    RETURN_IF_TERMINATED();
     _SetR(t, _SignExtend(data, 16, 32));
   }
 
@@ -19994,11 +23891,12 @@ private:
       return;
 
     //EncodingSpecificOperations
-    uint32_t offset     = _Shift(_GetR(m), shiftT, shiftN, GETBITSM(_s.xpsr, XPSR__C));
+    uint32_t offset     = _Shift(_GetR(m), shiftT, shiftN, _CarryFlag());
     uint32_t offsetAddr = add ? _GetR(n) + offset : _GetR(n) - offset;
     uint32_t addr       = index ? offsetAddr : _GetR(n);
 
     uint32_t data = _MemU(addr, 2);
+    RETURN_IF_TERMINATED();
     if (wback)
       _SetR(n, offsetAddr);
 
@@ -20073,6 +23971,7 @@ private:
       if (t != 15)
         _SetR(t, value);
       else {
+        _SyncFlags();
         _s.xpsr = CHGBITSM(_s.xpsr, XPSR__N, GETBIT(value, 31));
         _s.xpsr = CHGBITSM(_s.xpsr, XPSR__Z, GETBIT(value, 30));
         _s.xpsr = CHGBITSM(_s.xpsr, XPSR__C, GETBIT(value, 29));
@@ -20095,9 +23994,7 @@ private:
     _SetR(d, result);
 
     if (setflags) {
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__N, GETBIT(result, 31));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__Z, _IsZeroBit(result));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__C, carry);
+      _SetFlagsNZC(result, carry);
       // APSR.V unchanged
     }
   }
@@ -20111,15 +24008,13 @@ private:
       return;
 
     //EncodingSpecificOperations
-    auto [result, carry] = _Shift_C(_GetR(m), shiftT, shiftN, GETBITSM(_s.xpsr, XPSR__C));
+    auto [result, carry] = _Shift_C(_GetR(m), shiftT, shiftN, _CarryFlag());
     if (d == 15)
       _ALUWritePC(result); // setflags is always false here
     else {
       _SetRSPCheck(d, result);
       if (setflags) {
-        _s.xpsr = CHGBITSM(_s.xpsr, XPSR__N, GETBIT(result,31));
-        _s.xpsr = CHGBITSM(_s.xpsr, XPSR__Z, _IsZeroBit(result));
-        _s.xpsr = CHGBITSM(_s.xpsr, XPSR__C, carry);
+        _SetFlagsNZC(result, carry);
         // APSR.V unchanged
       }
     }
@@ -20134,12 +24029,10 @@ private:
 
     //EncodingSpecificOperations
     uint32_t shiftN = GETBITS(_GetR(s), 0, 7);
-    auto [result, carry] = _Shift_C(_GetR(m), shiftT, shiftN, GETBITSM(_s.xpsr, XPSR__C));
+    auto [result, carry] = _Shift_C(_GetR(m), shiftT, shiftN, _CarryFlag());
     _SetR(d, result);
     if (setflags) {
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__N, GETBIT(result,31));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__Z, _IsZeroBit(result));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__C, carry);
+      _SetFlagsNZC(result, carry);
       // APSR.V unchanged
     }
   }
@@ -20190,6 +24083,7 @@ private:
           _SetR(d, CHGBITS(_GetR(d),10,15, 0b000000));
         }
         if (!GETBIT(SYSm, 2)) {
+          _SyncFlags();
           _SetR(d, CHGBITS(_GetR(d),27,31, GETBITS(_s.xpsr,27,31)));
           if (_HaveDSPExt())
             _SetR(d, CHGBITS(_GetR(d),16,19, GETBITS(_s.xpsr,16,19)));
@@ -20389,8 +24283,10 @@ private:
             else
               _s.xpsr = CHGBITS(_s.xpsr,16,19,GETBITS(_GetR(n),16,19));
           }
-          if (GETBIT(mask, 1)) // N, Z, C, V, Q bits
+          if (GETBIT(mask, 1)) { // N, Z, C, V, Q bits
+            _SyncFlags();
             _s.xpsr = CHGBITS(_s.xpsr,27,31,GETBITS(_GetR(n),27,31));
+          }
         }
         break;
       case 0b00001: // SP access
@@ -20463,6 +24359,7 @@ private:
           }
         break;
       case 0b00010: // Priority mask or CONTROL access
+        _ExcStateChanged();
         switch (GETBITS(SYSm, 0, 2)) {
           case 0b000:
             if (_CurrentModeIsPrivileged())
@@ -20515,6 +24412,7 @@ private:
       case 0b10010: // Priority mask or CONTROL access — alt domain
         if (!_HaveSecurityExt())
           CUNPREDICTABLE_UNDEFINED();
+        _ExcStateChanged();
         if (_CurrentModeIsPrivileged() && _s.curState == SecurityState_Secure)
           switch (GETBITS(SYSm, 0, 2)) {
             case 0b000:
@@ -20581,8 +24479,7 @@ private:
     uint32_t result   = operand1 * operand2 + addend;
     _SetR(d, GETBITS(result, 0,31));
     if (setflags) {
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__N, GETBIT(result,31));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__Z, _IsZeroBit(GETBITS(result, 0,31)));
+      _SetFlagsNZ(result);
       // APSR.C unchanged
       // APSR.V unchanged
     }
@@ -20618,8 +24515,7 @@ private:
     uint32_t result   = operand1 * operand2;
     _SetR(d, GETBITS(result, 0,31));
     if (setflags) {
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__N, GETBIT(result,31));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__Z, _IsZeroBit(GETBITS(result, 0,31)));
+      _SetFlagsNZ(result);
       // APSR.C unchanged
       // APSR.V unchanged
     }
@@ -20637,9 +24533,7 @@ private:
     uint32_t result = ~imm32;
     _SetR(d, result);
     if (setflags) {
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__N, GETBIT(result, 31));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__Z, _IsZeroBit(result));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__C, carry);
+      _SetFlagsNZC(result, carry);
       // APSR.V unchanged
     }
   }
@@ -20652,13 +24546,11 @@ private:
       return;
 
     //EncodingSpecificOperations
-    auto [shifted, carry] = _Shift_C(_GetR(m), shiftT, shiftN, GETBITSM(_s.xpsr, XPSR__C));
+    auto [shifted, carry] = _Shift_C(_GetR(m), shiftT, shiftN, _CarryFlag());
     uint32_t result = ~shifted;
     _SetR(d, result);
     if (setflags) {
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__N, GETBIT(result,31));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__Z, _IsZeroBit(result));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__C, carry);
+      _SetFlagsNZC(result, carry);
       // APSR.V unchanged
     }
   }
@@ -20688,9 +24580,7 @@ private:
     uint32_t result = _GetR(n) | imm32;
     _SetR(d, result);
     if (setflags) {
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__N, GETBIT(result, 31));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__Z, _IsZeroBit(result));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__C, carry);
+      _SetFlagsNZC(result, carry);
       // APSR.V unchanged
     }
   }
@@ -20707,9 +24597,7 @@ private:
     uint32_t result = _GetR(n) | ~imm32;
     _SetR(d, result);
     if (setflags) {
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__N, GETBIT(result, 31));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__Z, _IsZeroBit(result));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__C, carry);
+      _SetFlagsNZC(result, carry);
       // APSR.V unchanged
     }
   }
@@ -20723,13 +24611,11 @@ private:
       return;
 
     //EncodingSpecificOperations
-    auto [shifted, carry] = _Shift_C(_GetR(m), shiftT, shiftN, GETBITSM(_s.xpsr, XPSR__C));
+    auto [shifted, carry] = _Shift_C(_GetR(m), shiftT, shiftN, _CarryFlag());
     uint32_t result = _GetR(n) | ~shifted;
     _SetR(d, result);
     if (setflags) {
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__N, GETBIT(result, 31));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__Z, _IsZeroBit(result));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__C, carry);
+      _SetFlagsNZC(result, carry);
       // APSR.V unchanged
     }
   }
@@ -20743,13 +24629,11 @@ private:
       return;
 
     //EncodingSpecificOperations
-    auto [shifted, carry] = _Shift_C(_GetR(m), shiftT, shiftN, GETBITSM(_s.xpsr, XPSR__C));
+    auto [shifted, carry] = _Shift_C(_GetR(m), shiftT, shiftN, _CarryFlag());
     uint32_t result = _GetR(n) | shifted;
     _SetR(d, result);
     if (setflags) {
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__N, GETBIT(result, 31));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__Z, _IsZeroBit(result));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__C, carry);
+      _SetFlagsNZC(result, carry);
       // APSR.V unchanged
     }
   }
@@ -20776,7 +24660,7 @@ private:
       return;
 
     //EncodingSpecificOperations
-    uint32_t offset = _Shift(_GetR(m), shiftT, shiftN, GETBITSM(_s.xpsr, XPSR__C));
+    uint32_t offset = _Shift(_GetR(m), shiftT, shiftN, _CarryFlag());
     uint32_t addr   = add ? _GetR(n) + offset : _GetR(n) - offset;
     _Hint_PreloadData(addr);
   }
@@ -20820,7 +24704,7 @@ private:
       return;
 
     //EncodingSpecificOperations
-    uint32_t offset = _Shift(_GetR(m), shiftT, shiftN, GETBITSM(_s.xpsr, XPSR__C));
+    uint32_t offset = _Shift(_GetR(m), shiftT, shiftN, _CarryFlag());
     uint32_t addr   = add ? _GetR(n) + offset : _GetR(n) - offset;
     _Hint_PreloadInstr(addr);
   }
@@ -20898,10 +24782,7 @@ private:
     auto [result, carry, overflow] = _AddWithCarry(~_GetR(n), imm32, true);
     _SetR(d, result);
     if (setflags) {
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__N, GETBIT(result,31));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__Z, _IsZeroBit(result));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__C, carry);
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__V, overflow);
+      _SetFlagsNZCV(result, carry, overflow);
     }
   }
 
@@ -20914,14 +24795,11 @@ private:
       return;
 
     //EncodingSpecificOperations
-    uint32_t shifted = _Shift(_GetR(m), shiftT, shiftN, GETBITSM(_s.xpsr, XPSR__C));
+    uint32_t shifted = _Shift(_GetR(m), shiftT, shiftN, _CarryFlag());
     auto [result, carry, overflow] = _AddWithCarry(~_GetR(n), shifted, true);
     _SetR(d, result);
     if (setflags) {
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__Z, _IsZeroBit(result));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__N, GETBIT(result,31));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__C, carry);
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__V, overflow);
+      _SetFlagsNZCV(result, carry, overflow);
     }
   }
 
@@ -20934,13 +24812,10 @@ private:
       return;
 
     //EncodingSpecificOperations
-    auto [result, carry, overflow] = _AddWithCarry(_GetR(n), ~imm32, GETBITSM(_s.xpsr, XPSR__C));
+    auto [result, carry, overflow] = _AddWithCarry(_GetR(n), ~imm32, _CarryFlag());
     _SetR(d, result);
     if (setflags) {
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__N, GETBIT(result, 31));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__Z, _IsZeroBit(result));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__C, carry);
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__V, overflow);
+      _SetFlagsNZCV(result, carry, overflow);
     }
   }
 
@@ -20953,14 +24828,11 @@ private:
       return;
 
     //EncodingSpecificOperations
-    uint32_t shifted = _Shift(_GetR(m), shiftT, shiftN, GETBITSM(_s.xpsr, XPSR__C));
-    auto [result, carry, overflow] = _AddWithCarry(_GetR(n), ~shifted, GETBITSM(_s.xpsr, XPSR__C));
+    uint32_t shifted = _Shift(_GetR(m), shiftT, shiftN, _CarryFlag());
+    auto [result, carry, overflow] = _AddWithCarry(_GetR(n), ~shifted, _CarryFlag());
     _SetR(d, result);
     if (setflags) {
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__N, GETBIT(result, 31));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__Z, _IsZeroBit(result));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__C, carry);
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__V, overflow);
+      _SetFlagsNZCV(result, carry, overflow);
     }
   }
 
@@ -21076,7 +24948,7 @@ private:
       return;
 
     //EncodingSpecificOperations
-    uint32_t operand = _Shift(_GetR(n), shiftT, shiftN, GETBITSM(_s.xpsr, XPSR__C)); // APSR.C ignored
+    uint32_t operand = _Shift(_GetR(n), shiftT, shiftN, _CarryFlag()); // APSR.C ignored
     auto [result, sat] = _SignedSatQ(operand, saturateTo);
     _SetR(d, _SignExtend(result, saturateTo, 32));
     if (sat)
@@ -21113,6 +24985,7 @@ private:
     if (!applyLimit || offsetAddr >= limit) {
       do {
         _MemA(addr, 4, _Coproc_GetWordToStore(cp, _ThisInstr()));
+        RETURN_IF_TERMINATED();
         addr += 4;
       } while (!_Coproc_DoneStoring(cp, _ThisInstr()));
     }
@@ -21180,6 +25053,7 @@ private:
 
     if (_ExclusiveMonitorsPass(addr, 1)) {
       _MemO(addr, 1, GETBITS(_GetR(t), 0, 7));
+      RETURN_IF_TERMINATED();
       _SetR(d, _ZeroExtend(0, 32));
     } else
       _SetR(d, _ZeroExtend(1, 32));
@@ -21203,6 +25077,7 @@ private:
 
     if (_ExclusiveMonitorsPass(addr, 2)) {
       _MemO(addr, 2, GETBITS(_GetR(t), 0,15));
+      RETURN_IF_TERMINATED();
       _SetR(d, _ZeroExtend(0, 32));
     } else
       _SetR(d, _ZeroExtend(1, 32));
@@ -21226,6 +25101,7 @@ private:
 
     if (_ExclusiveMonitorsPass(addr, 4)) {
       _MemO(addr, 4, _GetR(t));
+      RETURN_IF_TERMINATED();
       _SetR(d, _ZeroExtend(0, 32));
     } else
       _SetR(d, _ZeroExtend(1, 32));
@@ -21253,16 +25129,21 @@ private:
     } else
       doOperation = true;
 
-    for (int i=0; i<15; ++i) {
-      // Memory operation only performed if limit not violated.
-      if (GETBIT(registers, i) && doOperation) {
-        if (i == n && wback && i != _LowestSetBit(registers))
-          _MemA(addr, 4, UNKNOWN_VAL(0)); // encoding T1 only
-        else
-          _MemA(addr, 4, _GetR(i));
+    // Memory operation only performed if limit not violated.
+    if (doOperation) {
+      uint32_t data[16];
+      int      count = 0;
+      for (int i=0; i<15; ++i)
+        if (GETBIT(registers, i)) {
+          if (i == n && wback && i != _LowestSetBit(registers))
+            data[count++] = UNKNOWN_VAL(0); // encoding T1 only
+          else
+            data[count++] = _GetR(i);
+        }
 
-        addr += 4;
-      }
+      auto [excInfo, done] = _MemA_StoreBurst(addr, count, AccType_NORMAL, _FindPriv(), _IsSecure(), data);
+      _RaiseFault(excInfo);
+      RETURN_IF_TERMINATED();
     }
 
     // If the stack pointer is being updated a fault will be raised if the
@@ -21289,12 +25170,18 @@ private:
     else
       applyLimit = false;
 
-    for (int i=0; i<15; ++i)
-      // If R[n] is the SP, memory operation only performed if limit not violated
-      if (GETBIT(registers, i) && (!applyLimit || addr >= limit)) {
-        _MemA(addr, 4, _GetR(i));
-        addr += 4;
-      }
+    // If R[n] is the SP, memory operation only performed if limit not violated
+    if (!applyLimit || addr >= limit) {
+      uint32_t data[16];
+      int      count = 0;
+      for (int i=0; i<15; ++i)
+        if (GETBIT(registers, i))
+          data[count++] = _GetR(i);
+
+      auto [excInfo, done] = _MemA_StoreBurst(addr, count, AccType_NORMAL, _FindPriv(), _IsSecure(), data);
+      _RaiseFault(excInfo);
+      RETURN_IF_TERMINATED();
+    }
 
     if (wback)
       _SetRSPCheck(n, _GetR(n) - 4*_BitCount(registers));
@@ -21321,8 +25208,10 @@ private:
       applyLimit = false;
 
     // Memory operation only performed if limit not violated.
-    if (!applyLimit || offsetAddr >= limit)
+    if (!applyLimit || offsetAddr >= limit) {
       _MemU(addr, 4, _GetR(t));
+      RETURN_IF_TERMINATED();
+    }
 
     // If the stack pointer is being updated, a fault will be raised if the
     // limit is violated.
@@ -21339,7 +25228,7 @@ private:
       return;
 
     //EncodingSpecificOperations
-    uint32_t offset = _Shift(_GetR(m), shiftT, shiftN, GETBITSM(_s.xpsr, XPSR__C));
+    uint32_t offset = _Shift(_GetR(m), shiftT, shiftN, _CarryFlag());
     uint32_t addr   = _GetR(n) + offset;
     _MemU(addr, 4, _GetR(t));
   }
@@ -21407,7 +25296,9 @@ private:
     // Memory operation only performed if limit not violated.
     if (!applyLimit || offsetAddr >= limit) {
       _MemA(addr  , 4, _GetR(t ));
+      RETURN_IF_TERMINATED();
       _MemA(addr+4, 4, _GetR(t2));
+      RETURN_IF_TERMINATED();
     }
 
     // If the stack pointer is being updated a fault will be raised if
@@ -21434,6 +25325,7 @@ private:
 
     if (_ExclusiveMonitorsPass(addr, 4)) {
       _MemA(addr, 4, _GetR(t));
+      RETURN_IF_TERMINATED();
       _SetR(d, _ZeroExtend(0, 32));
     } else
       _SetR(d, _ZeroExtend(1, 32));
@@ -21457,6 +25349,7 @@ private:
 
     if (_ExclusiveMonitorsPass(addr, 1)) {
       _MemA(addr, 1, GETBITS(_GetR(t), 0, 7));
+      RETURN_IF_TERMINATED();
       _SetR(d, _ZeroExtend(0, 32));
     } else
       _SetR(d, _ZeroExtend(1, 32));
@@ -21480,6 +25373,7 @@ private:
 
     if (_ExclusiveMonitorsPass(addr, 2)) {
       _MemA(addr, 2, GETBITS(_GetR(t), 0,15));
+      RETURN_IF_TERMINATED();
       _SetR(d, _ZeroExtend(0, 32));
     } else
       _SetR(d, _ZeroExtend(1, 32));
@@ -21506,8 +25400,10 @@ private:
       applyLimit = false;
 
     // Memory operation only performed if limit not violated.
-    if (!applyLimit || offsetAddr >= limit)
+    if (!applyLimit || offsetAddr >= limit) {
       _MemU(addr, 1, GETBITS(_GetR(t), 0, 7));
+      RETURN_IF_TERMINATED();
+    }
 
     // If the stack pointer is being updated a fault will be raised
     // if the limit is violated.
@@ -21524,7 +25420,7 @@ private:
       return;
 
     //EncodingSpecificOperations
-    uint32_t offset = _Shift(_GetR(m), shiftT, shiftN, GETBITSM(_s.xpsr, XPSR__C));
+    uint32_t offset = _Shift(_GetR(m), shiftT, shiftN, _CarryFlag());
     uint32_t addr   = _GetR(n) + offset;
     _MemU(addr, 1, GETBITS(_GetR(t), 0, 7));
   }
@@ -21550,8 +25446,10 @@ private:
       applyLimit = false;
 
     // Memory operation only performed if limit not violated.
-    if (!applyLimit || offsetAddr >= limit)
+    if (!applyLimit || offsetAddr >= limit) {
       _MemU(addr, 2, GETBITS(_GetR(t), 0,15));
+      RETURN_IF_TERMINATED();
+    }
 
     // If the stack pointer is being updated a fault will be raised if the
     // limit is violated.
@@ -21568,7 +25466,7 @@ private:
       return;
 
     //EncodingSpecificOperations
-    uint32_t offset = _Shift(_GetR(m), shiftT, shiftN, GETBITSM(_s.xpsr, XPSR__C));
+    uint32_t offset = _Shift(_GetR(m), shiftT, shiftN, _CarryFlag());
     uint32_t addr   = _GetR(n) + offset;
     _MemU(addr, 2, GETBITS(_GetR(t), 0,15));
   }
@@ -21585,10 +25483,7 @@ private:
     _SetRSPCheck(d, result);
     TRACE("  newSP=0x%x\n", result);
     if (setflags) {
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__N, GETBIT(result,31));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__Z, _IsZeroBit(result));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__C, carry);
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__V, overflow);
+      _SetFlagsNZCV(result, carry, overflow);
     }
   }
 
@@ -21601,14 +25496,11 @@ private:
       return;
 
     //EncodingSpecificOperations
-    uint32_t shifted = _Shift(_GetR(m), shiftT, shiftN, GETBITSM(_s.xpsr, XPSR__C));
+    uint32_t shifted = _Shift(_GetR(m), shiftT, shiftN, _CarryFlag());
     auto [result, carry, overflow] = _AddWithCarry(_GetSP(), ~shifted, true);
     _SetRSPCheck(d, result);
     if (setflags) {
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__N, GETBIT(result,31));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__Z, _IsZeroBit(result));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__C, carry);
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__V, overflow);
+      _SetFlagsNZCV(result, carry, overflow);
     }
   }
 
@@ -21624,10 +25516,7 @@ private:
     auto [result, carry, overflow] = _AddWithCarry(_GetR(n), ~imm32, true);
     _SetR(d, result);
     if (setflags) {
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__N, GETBIT(result, 31));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__Z, _IsZeroBit(result));
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__C, carry);
-      _s.xpsr = CHGBITSM(_s.xpsr, XPSR__V, overflow);
+      _SetFlagsNZCV(result, carry, overflow);
     }
   }
 
@@ -21640,17 +25529,14 @@ private:
       return;
 
     //EncodingSpecificOperations
-    uint32_t shifted = _Shift(_GetR(m), shiftT, shiftN, GETBITSM(_s.xpsr, XPSR__C));
+    uint32_t shifted = _Shift(_GetR(m), shiftT, shiftN, _CarryFlag());
     auto [result, carry, overflow] = _AddWithCarry(_GetR(n), ~shifted, true);
     if (d == 15)
       _ALUWritePC(result);
     else {
       _SetR(d, result);
       if (setflags) {
-        _s.xpsr = CHGBITSM(_s.xpsr, XPSR__N, GETBIT(result, 31));
-        _s.xpsr = CHGBITSM(_s.xpsr, XPSR__Z, _IsZeroBit(result));
-        _s.xpsr = CHGBITSM(_s.xpsr, XPSR__C, carry);
-        _s.xpsr = CHGBITSM(_s.xpsr, XPSR__V, overflow);
+        _SetFlagsNZCV(result, carry, overflow);
       }
     }
   }
@@ -21705,6 +25591,7 @@ private:
       halfwords = _MemU(_GetR(n) + _LSL(_GetR(m), 1), 2);
     else
       halfwords = _MemU(_GetR(n) + _GetR(m), 1);
+    RETURN_IF_TERMINATED();
 
     _BranchWritePC(_GetPC() + 2*halfwords);
   }
@@ -21719,9 +25606,7 @@ private:
 
     //EncodingSpecificOperations
     uint32_t result = _GetR(n) ^ imm32;
-    _s.xpsr = CHGBITSM(_s.xpsr, XPSR__N, GETBIT(result, 31));
-    _s.xpsr = CHGBITSM(_s.xpsr, XPSR__Z, _IsZeroBit(result));
-    _s.xpsr = CHGBITSM(_s.xpsr, XPSR__C, carry);
+    _SetFlagsNZC(result, carry);
     // APSR.V unchanged
   }
 
@@ -21734,11 +25619,9 @@ private:
       return;
 
     //EncodingSpecfificOperations
-    auto [shifted, carry] = _Shift_C(_GetR(m), shiftT, shiftN, GETBITSM(_s.xpsr, XPSR__C));
+    auto [shifted, carry] = _Shift_C(_GetR(m), shiftT, shiftN, _CarryFlag());
     uint32_t result = _GetR(n) ^ shifted;
-    _s.xpsr = CHGBITSM(_s.xpsr, XPSR__N, GETBIT(result,31));
-    _s.xpsr = CHGBITSM(_s.xpsr, XPSR__Z, _IsZeroBit(result));
-    _s.xpsr = CHGBITSM(_s.xpsr, XPSR__C, carry);
+    _SetFlagsNZC(result, carry);
     // APSR.v unchanged
   }
 
@@ -21753,9 +25636,7 @@ private:
     //EncodingSpecificOperations
     uint32_t result = _GetR(n) & imm32;
 
-    _s.xpsr = CHGBITSM(_s.xpsr, XPSR__N, GETBIT(result, 31));
-    _s.xpsr = CHGBITSM(_s.xpsr, XPSR__Z, _IsZeroBit(result));
-    _s.xpsr = CHGBITSM(_s.xpsr, XPSR__C, carry);
+    _SetFlagsNZC(result, carry);
     // APSR.V unchanged
   }
 
@@ -21768,11 +25649,9 @@ private:
       return;
 
     //EncodingSpecificOperations
-    auto [shifted, carry] = _Shift_C(_GetR(m), shiftT, shiftN, GETBITSM(_s.xpsr, XPSR__C));
+    auto [shifted, carry] = _Shift_C(_GetR(m), shiftT, shiftN, _CarryFlag());
     uint32_t result = _GetR(n) & shifted;
-    _s.xpsr = CHGBITSM(_s.xpsr, XPSR__N, GETBIT(result,31));
-    _s.xpsr = CHGBITSM(_s.xpsr, XPSR__Z, _IsZeroBit(result));
-    _s.xpsr = CHGBITSM(_s.xpsr, XPSR__C, carry);
+    _SetFlagsNZC(result, carry);
     // APSR.V unchanged
   }
 
@@ -21813,7 +25692,7 @@ private:
       return;
 
     //EncodingSpecificOperations
-    THROW_UNDEFINED();
+    _RaiseUndefined();
   }
 
   /* _Exec_UDIV {{{4
@@ -21874,7 +25753,7 @@ private:
       return;
 
     //EncodingSpecificOperations
-    uint32_t operand = _Shift(_GetR(n), shiftT, shiftN, GETBITSM(_s.xpsr, XPSR__C)); // APSR.C ignored
+    uint32_t operand = _Shift(_GetR(n), shiftT, shiftN, _CarryFlag()); // APSR.C ignored
     auto [result, sat] = _UnsignedSatQ(operand, saturateTo);
     _SetR(d, _ZeroExtend(result, 32));
     if (sat)
@@ -21955,6 +25834,20 @@ private:
   int             _procID;
   LocalMonitor    _lm;
   GlobalMonitor  &_gm;
+  CodeWatch       _cw;
+  HostRegions     _hr;
+  FetchCache      _fc;
+  Tlb             _tlb;
+  MemoryAttributes _mair[2][8]{}; // See _UpdateMAIRTable.
+  DecodeCache     _dc;
+  BlockCache      _bc;
+  ExcPriTable     _ep;
+  ExecPriCache    _xp;
+  PendingSet      _ps;
+  IntrCheck       _ic;
+#if JIT_SUPPORTED
+  JitCache        _jit;
+#endif
 };
 
 _MEMU_END_NS(memu)
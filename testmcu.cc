@@ -3,38 +3,23 @@
 #include <signal.h>
 #include <histedit.h>
 #include <stdio.h>
+#include <chrono>
 
 using memu::phys_t;
 
-/* RouterDevice {{{2
- * ============
- * An IDevice which routes to other devices.
+/* UnmappedDevice {{{2
+ * ==============
+ * Handles accesses to addresses with no device mapped, which are BusFaults.
  */
-template<typename T>
-struct RouterDevice :memu::IDevice {
+struct UnmappedDevice final :memu::IDevice {
   int Load(phys_t addr, int size, uint32_t flags, uint32_t &v) override {
-    IDevice *dev = _Resolve(addr);
-    if (!dev) {
-      printf("  B:L%2d %x -> BusFault\n", size, addr);
-      return -1;
-    }
-
-    return dev->Load(addr, size, flags, v);
+    printf("  B:L%2d %x -> BusFault\n", size, addr);
+    return -1;
   }
 
   int Store(phys_t addr, int size, uint32_t flags, uint32_t v) override {
-    IDevice *dev = _Resolve(addr);
-    if (!dev) {
-      printf("  B:S%2d %x <- 0x%x BusFault", size, addr, v);
-      return -1;
-    }
-
-    return dev->Store(addr, size, flags, v);
-  }
-
-private:
-  IDevice *_Resolve(phys_t addr) {
-    return static_cast<T*>(this)->Resolve(addr);
+    printf("  B:S%2d %x <- 0x%x BusFault", size, addr, v);
+    return -1;
   }
 };
 
@@ -56,58 +41,6 @@ protected:
   size_t _len;
 };
 
-/* RamDevice {{{2
- * =========
- */
-struct RamDevice final :RangeDevice {
-  RamDevice(phys_t base, size_t len) :RangeDevice(base, len) {
-    _buf = (uint8_t*)new uint32_t[(len+3)/4];
-    memset(_buf, 0, len);
-  }
-
-  ~RamDevice() {
-    delete[] (uint32_t*)_buf;
-    _buf = nullptr;
-  }
-
-  uint8_t *GetBuf() { return _buf; }
-
-  int Load(phys_t addr, int size, uint32_t flags, uint32_t &v) override {
-    if (addr < _base || addr + size - 1 >= _base + _len)
-      return -1;
-
-    addr -= _base;
-    switch (size) {
-      case 4: v = *(uint32_t*)(_buf + addr); break;
-      case 2: v = *(uint16_t*)(_buf + addr); break;
-      case 1: v = *(uint8_t *)(_buf + addr); break;
-      default: ASSERT(false);
-    }
-
-    TRACE("L%2d 0x%08x -> 0x%x\n", size, addr+_base, v);
-    return 0;
-  }
-
-  int Store(phys_t addr, int size, uint32_t flags, uint32_t v) override {
-    if (addr < _base || addr + size - 1 >= _base + _len)
-      return -1;
-
-    addr -= _base;
-    switch (size) {
-      case 4: *(uint32_t*)(_buf + addr) = v; break;
-      case 2: *(uint16_t*)(_buf + addr) = v; break;
-      case 1: *(uint8_t *)(_buf + addr) = v; break;
-      default: ASSERT(false);
-    }
-
-    TRACE("S%2d 0x%08x <- 0x%x\n", size, addr+_base, v);
-    return 0;
-  }
-
-private:
-  uint8_t *_buf{};
-};
-
 /* UartDevice {{{2
  * ==========
  */
@@ -152,22 +85,365 @@ private:
  *   4000_0000    UART
  *
  */
-struct TestDevice final :RouterDevice<TestDevice> {
-  IDevice *Resolve(phys_t addr) {
-    if (_ram.Decodes(addr))
-      return &_ram;
-
-    if (_uart.Decodes(addr))
-      return &_uart;
-
-    return nullptr;
+struct TestDevice final :memu::PageRouterDevice {
+  TestDevice() :PageRouterDevice(&_unmapped) {
+    Map(_ram.GetBase(), _ram.GetLen(), &_ram);
+    Map(_uart.GetBase(), _uart.GetLen(), &_uart);
   }
 
-  RamDevice &GetRam() { return _ram; }
+  memu::MappedMemoryDevice &GetRam() { return _ram; }
 
 private:
-  RamDevice  _ram{0x2000'0000, 1*1024*1024};
-  UartDevice _uart{0x4000'0000};
+  UnmappedDevice            _unmapped;
+  memu::MappedMemoryDevice  _ram{0x2000'0000, 1*1024*1024};
+  UartDevice                _uart{0x4000'0000};
+};
+
+/* Microbenchmarks {{{2
+ * ===============
+ * Built-in programs selected with -m instead of a program file. Each is
+ * placed at 2000_0040 behind a minimal vector table and ends with UDF, which
+ * locks up the core as there is no HardFault handler (or, if there is one, as
+ * it executes UDF in turn). The HardFault, PendSV and SysTick vectors may be
+ * given as byte offsets of handlers within the program.
+ */
+
+// Conditional execution: 100000 iterations of a loop of 19 instructions, 13
+// of which are IT instructions or in IT blocks.
+static const uint16_t g_benchIT[] = {
+  0xF248, 0x67A0,   //    movw  r7, #0x86A0
+  0xF2C0, 0x0701,   //    movt  r7, #0x0001
+  0x2000,           //    movs  r0, #0
+  0x2100,           //    movs  r1, #0
+  0x2200,           //    movs  r2, #0
+  0x4290,           // 1: cmp   r0, r2
+  0xBFB4,           //    ite   lt
+  0x1CC0,           //    addlt r0, r0, #3
+  0x1E40,           //    subge r0, r0, #1
+  0xF010, 0x0303,   //    ands  r3, r0, #3
+  0xBF06,           //    itte  eq
+  0x1809,           //    addeq r1, r1, r0
+  0x404A,           //    eoreq r2, r1
+  0x1E52,           //    subne r2, r2, #1
+  0x4291,           //    cmp   r1, r2
+  0xBF8A,           //    itet  hi
+  0x4608,           //    movhi r0, r1
+  0x4610,           //    movls r0, r2
+  0x1C49,           //    addhi r1, r1, #1
+  0x07C4,           //    lsls  r4, r0, #31
+  0xBF48,           //    it    mi
+  0x1D52,           //    addmi r2, r2, #5
+  0x1E7F,           //    subs  r7, r7, #1
+  0xD1EB,           //    bne   1b
+  0xDE00,           //    udf   #0
+};
+
+// Data processing: 1000000 iterations of a loop of 12 instructions, 11 of
+// which are unshifted register or immediate ALU operations.
+static const uint16_t g_benchALU[] = {
+  0xF244, 0x2740,   //    movw  r7, #0x4240
+  0xF2C0, 0x070F,   //    movt  r7, #0x000F
+  0x2000,           //    movs  r0, #0
+  0x2101,           //    movs  r1, #1
+  0x2202,           //    movs  r2, #2
+  0x2303,           //    movs  r3, #3
+  0x1840,           // 1: adds  r0, r0, r1
+  0x4042,           //    eors  r2, r0
+  0x1E53,           //    subs  r3, r2, #1
+  0x431C,           //    orrs  r4, r3
+  0x4025,           //    ands  r5, r4
+  0x1949,           //    adds  r1, r1, r5
+  0x4291,           //    cmp   r1, r2
+  0x1AC6,           //    subs  r6, r0, r3
+  0x4074,           //    eors  r4, r6
+  0x3207,           //    adds  r2, #7
+  0x3F01,           //    subs  r7, #1
+  0xD1F3,           //    bne   1b
+  0xDE00,           //    udf   #0
+};
+
+// Mixed: 50000 passes over a 64-word buffer, each word loaded, conditionally
+// adjusted in an IT block, mixed into a running checksum which is stored
+// further along the buffer.
+static const uint16_t g_benchMixed[] = {
+  0xF24C, 0x3750,   //    movw  r7, #50000
+  0xF241, 0x0500,   //    movw  r5, #0x1000
+  0xF2C2, 0x0500,   //    movt  r5, #0x2000
+  0x225A,           //    movs  r2, #0x5a
+  0x4628,           // 2: mov   r0, r5
+  0xF505, 0x7680,   //    add   r6, r5, #256
+  0x6803,           // 1: ldr   r3, [r0]
+  0x3004,           //    adds  r0, #4
+  0x2B80,           //    cmp   r3, #0x80
+  0xBF88,           //    it    hi
+  0x3B80,           //    subhi r3, #0x80
+  0x18D2,           //    adds  r2, r2, r3
+  0x08D4,           //    lsrs  r4, r2, #3
+  0x4062,           //    eors  r2, r4
+  0x63C2,           //    str   r2, [r0, #0x3c]
+  0x42B0,           //    cmp   r0, r6
+  0xD1F4,           //    bne   1b
+  0x3F01,           //    subs  r7, #1
+  0xD1EF,           //    bne   2b
+  0xDE00,           //    udf   #0
+};
+
+// Faults: 20000 iterations of a loop which takes four faults, an UNDEFINED
+// instruction, an unaligned load and store trapped by CCR.UNALIGN_TRP, and a
+// 32-bit UNDEFINED instruction. Each escalates to HardFault, whose handler
+// counts it in R6 and returns past the faulting instruction.
+static const uint16_t g_benchFault[] = {
+  0xF644, 0x6720,   //    movw  r7, #20000
+  0xF64E, 0x5214,   //    movw  r2, #0xED14       ; CCR
+  0xF2CE, 0x0200,   //    movt  r2, #0xE000
+  0x6810,           //    ldr   r0, [r2]
+  0xF040, 0x0008,   //    orr   r0, r0, #8        ; UNALIGN_TRP
+  0x6010,           //    str   r0, [r2]
+  0xF241, 0x0101,   //    movw  r1, #0x1001
+  0xF2C2, 0x0100,   //    movt  r1, #0x2000
+  0x2600,           //    movs  r6, #0
+  0xDE01,           // 1: udf   #1
+  0x6808,           //    ldr   r0, [r1]
+  0x6008,           //    str   r0, [r1]
+  0xF7F0, 0xA002,   //    udf.w #2
+  0x3F01,           //    subs  r7, #1
+  0xD1F8,           //    bne   1b
+  0xDE00,           //    udf   #0
+  0xB14F,           // HardFault: cbz r7, 2f    ; lock up once done
+  0x3601,           //    adds  r6, #1
+  0x9806,           //    ldr   r0, [sp, #24]     ; stacked PC
+  0x8801,           //    ldrh  r1, [r0]
+  0x0AC9,           //    lsrs  r1, r1, #11
+  0x291D,           //    cmp   r1, #0x1d         ; 32-bit instruction?
+  0xBF2C,           //    ite   hs
+  0x3004,           //    addhs r0, #4
+  0x3002,           //    addlo r0, #2
+  0x9006,           //    str   r0, [sp, #24]
+  0x4770,           //    bx    lr
+  0xDE00,           // 2: udf   #0
+};
+
+// Exception entry and return: 100000 iterations of a loop which pends PendSV,
+// whose handler pends SysTick, which is tail-chained to before returning to
+// the loop.
+static const uint16_t g_benchExc[] = {
+  0xF248, 0x67A0,   //    movw  r7, #0x86A0
+  0xF2C0, 0x0701,   //    movt  r7, #0x0001
+  0xF64E, 0x5604,   //    movw  r6, #0xED04       ; ICSR
+  0xF2CE, 0x0600,   //    movt  r6, #0xE000
+  0xF04F, 0x5580,   //    mov   r5, #0x10000000   ; PENDSVSET
+  0xF04F, 0x6480,   //    mov   r4, #0x04000000   ; PENDSTSET
+  0x6035,           // 1: str   r5, [r6]
+  0x1E7F,           //    subs  r7, r7, #1
+  0xD1FC,           //    bne   1b
+  0xDE00,           //    udf   #0
+  0x6034,           // PendSV:  str r4, [r6]
+  0x4770,           //          bx  lr
+  0x1C5B,           // SysTick: adds r3, r3, #1
+  0x4770,           //          bx  lr
+};
+
+static void _LoadBenchmark(TestDevice &dev, const uint16_t *prog, size_t len, uint32_t pendSVOff=0, uint32_t sysTickOff=0, uint32_t hardFaultOff=0) {
+  uint8_t *buf = dev.GetRam().GetBuf();
+  uint32_t vectors[16] = {0x2010'0000, 0x2000'0041};
+  if (hardFaultOff)
+    vectors[3] = 0x2000'0041 + hardFaultOff;
+  if (pendSVOff)
+    vectors[14] = 0x2000'0041 + pendSVOff;
+  if (sysTickOff)
+    vectors[15] = 0x2000'0041 + sysTickOff;
+  memcpy(buf, vectors, sizeof(vectors));
+  memcpy(buf + 0x40, prog, len);
+}
+
+/* Self-tests {{{2
+ * ==========
+ * Built-in programs selected with -t, loaded as for the microbenchmarks. Each
+ * leaves 1 in R7 if the behaviour it checks is correct and 0 otherwise, and
+ * testmcu exits with status 1 unless it is 1. (R0-R3 do not survive the
+ * HardFault entry caused by the final UDF.) A test may instead be a check
+ * which creates and runs its own simulators on the device.
+ */
+
+// A store to NVIC_IPR16 must not change NVIC_IPR0.
+static const uint16_t g_testIpr16[] = {
+  0xF24E, 0x4100,   //    movw  r1, #0xE400       ; NVIC_IPR0
+  0xF2CE, 0x0100,   //    movt  r1, #0xE000
+  0x2700,           //    movs  r7, #0
+  0xF04F, 0x3280,   //    mov   r2, #0x80808080
+  0x640A,           //    str   r2, [r1, #0x40]   ; NVIC_IPR16
+  0x680B,           //    ldr   r3, [r1]
+  0x6C0C,           //    ldr   r4, [r1, #0x40]
+  0xB913,           //    cbnz  r3, 1f
+  0x4294,           //    cmp   r4, r2
+  0xD100,           //    bne   1f
+  0x2701,           //    movs  r7, #1
+  0xDE00,           // 1: udf   #0
+};
+
+// A pending interrupt must not be reported in ICSR.VECTPENDING, or taken,
+// until it is enabled.
+static const uint16_t g_testIrqEnable[] = {
+  0xB672,           //    cpsid i
+  0xF24E, 0x1100,   //    movw  r1, #0xE100       ; NVIC_ISER0
+  0xF2CE, 0x0100,   //    movt  r1, #0xE000
+  0xF64E, 0x5604,   //    movw  r6, #0xED04       ; ICSR
+  0xF2CE, 0x0600,   //    movt  r6, #0xE000
+  0x2700,           //    movs  r7, #0
+  0x2201,           //    movs  r2, #1
+  0xF8C1, 0x2100,   //    str   r2, [r1, #0x100]  ; NVIC_ISPR0: pend IRQ0
+  0x6833,           //    ldr   r3, [r6]
+  0xF3C3, 0x3308,   //    ubfx  r3, r3, #12, #9   ; VECTPENDING
+  0xB933,           //    cbnz  r3, 1f
+  0x600A,           //    str   r2, [r1]          ; enable IRQ0
+  0x6833,           //    ldr   r3, [r6]
+  0xF3C3, 0x3308,   //    ubfx  r3, r3, #12, #9
+  0x2B10,           //    cmp   r3, #16
+  0xD100,           //    bne   1f
+  0x2701,           //    movs  r7, #1
+  0xDE00,           // 1: udf   #0
+};
+
+// An enabled and pending interrupt which targets Non-secure state must be
+// reported in ICSR.VECTPENDING.
+static const uint16_t g_testIrqNS[] = {
+  0xB672,           //    cpsid i
+  0xF24E, 0x1100,   //    movw  r1, #0xE100       ; NVIC_ISER0
+  0xF2CE, 0x0100,   //    movt  r1, #0xE000
+  0xF64E, 0x5604,   //    movw  r6, #0xED04       ; ICSR
+  0xF2CE, 0x0600,   //    movt  r6, #0xE000
+  0x2700,           //    movs  r7, #0
+  0x2201,           //    movs  r2, #1
+  0xF8C1, 0x2280,   //    str   r2, [r1, #0x280]  ; NVIC_ITNS0: IRQ0 targets NS
+  0xF501, 0x3100,   //    add   r1, r1, #0x20000  ; NVIC_ISER0_NS
+  0x600A,           //    str   r2, [r1]          ; enable IRQ0
+  0xF8C1, 0x2100,   //    str   r2, [r1, #0x100]  ; NVIC_ISPR0_NS: pend IRQ0
+  0x6833,           //    ldr   r3, [r6]
+  0xF3C3, 0x3308,   //    ubfx  r3, r3, #12, #9   ; VECTPENDING
+  0x2B10,           //    cmp   r3, #16
+  0xD100,           //    bne   1f
+  0x2701,           //    movs  r7, #1
+  0xDE00,           // 1: udf   #0
+};
+
+// In Non-secure state, an external interrupt which targets Non-secure state
+// must keep the priority set in NVIC_IPRn, and so stay masked by BASEPRI_NS.
+// The Secure part sets IRQ0's priority to 0xC0, makes 2000_00C0-2000_03FF
+// Non-secure and calls the Non-secure part, which sets BASEPRI to 0x80 and
+// enables and pends IRQ0. The Non-secure vector table is at 2000_0200.
+static const uint16_t g_testIrqPriNS[] = {
+  0x2700,           //    movs  r7, #0
+  0x2600,           //    movs  r6, #0
+  0xF24E, 0x1100,   //    movw  r1, #0xE100       ; NVIC_ISER0
+  0xF2CE, 0x0100,   //    movt  r1, #0xE000
+  0x2201,           //    movs  r2, #1
+  0xF8C1, 0x2280,   //    str   r2, [r1, #0x280]  ; NVIC_ITNS0: IRQ0 targets NS
+  0x23C0,           //    movs  r3, #0xC0
+  0xF8C1, 0x3300,   //    str   r3, [r1, #0x300]  ; NVIC_IPR0
+  0xF240, 0x2040,   //    movw  r0, #0x0240
+  0xF2C2, 0x0000,   //    movt  r0, #0x2000
+  0xF240, 0x03E5,   //    movw  r3, #0x00E5       ; NS IRQ0 handler
+  0xF2C2, 0x0300,   //    movt  r3, #0x2000
+  0x6003,           //    str   r3, [r0]
+  0x3840,           //    subs  r0, #0x40
+  0xF64E, 0x5108,   //    movw  r1, #0xED08       ; VTOR_NS
+  0xF2CE, 0x0102,   //    movt  r1, #0xE002
+  0x6008,           //    str   r0, [r1]
+  0xF64E, 0x51D0,   //    movw  r1, #0xEDD0       ; SAU_CTRL
+  0xF2CE, 0x0100,   //    movt  r1, #0xE000
+  0x2200,           //    movs  r2, #0
+  0x608A,           //    str   r2, [r1, #8]      ; SAU_RNR
+  0xF240, 0x02C0,   //    movw  r2, #0x00C0
+  0xF2C2, 0x0200,   //    movt  r2, #0x2000
+  0x60CA,           //    str   r2, [r1, #12]     ; SAU_RBAR
+  0xF240, 0x32E1,   //    movw  r2, #0x03E1
+  0xF2C2, 0x0200,   //    movt  r2, #0x2000
+  0x610A,           //    str   r2, [r1, #16]     ; SAU_RLAR
+  0x2201,           //    movs  r2, #1
+  0x600A,           //    str   r2, [r1]          ; enable the SAU
+  0xF240, 0x4000,   //    movw  r0, #0x0400
+  0xF2C2, 0x0000,   //    movt  r0, #0x2000
+  0xF380, 0x8888,   //    msr   msp_ns, r0
+  0xF240, 0x00C0,   //    movw  r0, #0x00C0
+  0xF2C2, 0x0000,   //    movt  r0, #0x2000
+  0xF3BF, 0x8F4F,   //    dsb
+  0xF3BF, 0x8F6F,   //    isb
+  0x4784,           //    blxns r0
+  0xDE00,           //    udf   #0
+  0xBF00,           //    nop
+  0xBF00,           //    nop
+  0xBF00,           //    nop
+  0x2080,           // NS: movs r0, #0x80       ; 2000_00C0
+  0xF380, 0x8811,   //    msr   basepri, r0
+  0xF24E, 0x1100,   //    movw  r1, #0xE100       ; NVIC_ISER0
+  0xF2CE, 0x0100,   //    movt  r1, #0xE000
+  0x2201,           //    movs  r2, #1
+  0x600A,           //    str   r2, [r1]          ; enable IRQ0
+  0xF8C1, 0x2100,   //    str   r2, [r1, #0x100]  ; NVIC_ISPR0: pend IRQ0
+  0xF3BF, 0x8F4F,   //    dsb
+  0xF3BF, 0x8F6F,   //    isb
+  0xB906,           //    cbnz  r6, 1f
+  0x2701,           //    movs  r7, #1
+  0xDE00,           // 1: udf   #0
+  0x2601,           // IRQ0: movs r6, #1        ; 2000_00E4
+  0x4770,           //    bx    lr
+};
+
+// Two cores share the RAM. Core B runs a loop which sets R1 to 0 until core A
+// replaces the MOVS with one which sets R1 to 5. B must then execute the new
+// instruction, although it has already cached the loop.
+static const uint16_t g_testCodeShare[] = {
+  0x2100,           // B: movs  r1, #0          ; 2000_0040
+  0x1C52,           //    adds  r2, r2, #1
+  0xE7FC,           //    b     B
+  0xF240, 0x0040,   // A: movw  r0, #0x0040     ; 2000_0046
+  0xF2C2, 0x0000,   //    movt  r0, #0x2000
+  0xF242, 0x1305,   //    movw  r3, #0x2105     ; movs r1, #5
+  0x8003,           //    strh  r3, [r0]
+  0xE7FE,           // 1: b     1b
+};
+
+// The 16-bit decode table must agree with the decoder tree.
+static bool _CheckDecode(TestDevice &dev, memu::GlobalMonitor &gm, const memu::SimpleSimulatorConfig &cfg) {
+  memu::Simulator sim(dev, gm, cfg);
+  return sim.CheckDecodeTable();
+}
+
+// Runs g_testCodeShare on two cores, each with its own cached code.
+static bool _CheckCodeShare(TestDevice &dev, memu::GlobalMonitor &gm, const memu::SimpleSimulatorConfig &cfg) {
+  _LoadBenchmark(dev, g_testCodeShare, sizeof(g_testCodeShare));
+  memu::Simulator a(dev, gm, cfg, 0), b(dev, gm, cfg, 1);
+
+  for (int i=0; i<1000; ++i)
+    b.TopLevel();
+  if (b.GetCpuState().r1 != 0)
+    return false;
+
+  a.GetCpuState().pc = 0x2000'0046;
+  a.InvalidateCaches();
+  for (int i=0; i<10; ++i)
+    a.TopLevel();
+
+  for (int i=0; i<1000; ++i)
+    b.TopLevel();
+  return b.GetCpuState().r1 == 5;
+}
+
+struct SelfTest {
+  const char      *name;
+  const char      *desc;
+  const uint16_t  *prog;
+  size_t           len;
+  bool           (*check)(TestDevice &dev, memu::GlobalMonitor &gm, const memu::SimpleSimulatorConfig &cfg) = nullptr;
+};
+
+static const SelfTest g_tests[] = {
+  {"ipr16", "stores to NVIC_IPR16 and above", g_testIpr16, sizeof(g_testIpr16)},
+  {"irqenable", "pending interrupts are only taken once enabled", g_testIrqEnable, sizeof(g_testIrqEnable)},
+  {"irqns", "interrupts targeting Non-secure state are taken", g_testIrqNS, sizeof(g_testIrqNS)},
+  {"irqprins", "interrupt priorities are kept in Non-secure state", g_testIrqPriNS, sizeof(g_testIrqPriNS)},
+  {"decode", "the 16-bit decode table matches the decoder tree", nullptr, 0, _CheckDecode},
+  {"codeshare", "code written by one core is seen by another", nullptr, 0, _CheckCodeShare},
 };
 
 bool g_sigint = false;
@@ -272,30 +548,88 @@ static int _DebugPrompt(memu::Simulator<TestDevice> &sim) {
   return rc;
 }
 
-int main(int argc, char **argv) {
-  if (argc < 2) {
-    fprintf(stderr, "usage: %s <program.bin>\n", argv[0]);
-    return 2;
-  }
+static int _Usage(const char *argv0) {
+  fprintf(stderr, "usage: %s [-e interp|block|jit|threaded] [-b] <program.bin>\n", argv0);
+  fprintf(stderr, "       %s [-e interp|block|jit|threaded] -m it|alu|mixed|exc|fault\n", argv0);
+  fprintf(stderr, "       %s [-e interp|block|jit|threaded] -t <test>\n", argv0);
+  fprintf(stderr, "  -e  execution engine (default: interp)\n");
+  fprintf(stderr, "  -b  report instructions per second on exit\n");
+  fprintf(stderr, "  -m  run a built-in microbenchmark (implies -b):\n");
+  fprintf(stderr, "        it  conditional execution in IT blocks\n");
+  fprintf(stderr, "        alu data processing without conditional execution\n");
+  fprintf(stderr, "        mixed loads, stores, IT blocks and compare-and-branch\n");
+  fprintf(stderr, "        exc PendSV/SysTick exception entry, tail-chain and return\n");
+  fprintf(stderr, "        fault UNDEFINED instructions and alignment faults\n");
+  fprintf(stderr, "  -t  run a built-in self-test, exiting with status 1 if it fails:\n");
+  for (auto &t : g_tests)
+    fprintf(stderr, "        %-10s %s\n", t.name, t.desc);
+  return 2;
+}
 
+int main(int argc, char **argv) {
   TestDevice dev;
   memu::SimpleSimulatorConfig cfg;
+  bool bench = false;
+  std::string micro;
+  const SelfTest *test = nullptr;
+
+  int argi = 1;
+  for (; argi < argc && argv[argi][0] == '-'; ++argi) {
+    std::string opt = argv[argi];
+    if (opt == "-e" && argi+1 < argc) {
+      std::string engine = argv[++argi];
+      if (engine == "interp")
+        cfg.engine = memu::ExecEngine_Interp;
+      else if (engine == "block")
+        cfg.engine = memu::ExecEngine_Block;
+      else if (engine == "jit")
+        cfg.engine = memu::ExecEngine_JIT;
+      else if (engine == "threaded")
+        cfg.engine = memu::ExecEngine_Threaded;
+      else
+        return _Usage(argv[0]);
+    } else if (opt == "-b")
+      bench = true;
+    else if (opt == "-m" && argi+1 < argc) {
+      micro = argv[++argi];
+      if (micro != "it" && micro != "alu" && micro != "mixed" && micro != "exc" && micro != "fault")
+        return _Usage(argv[0]);
+      bench = true;
+    } else if (opt == "-t" && argi+1 < argc) {
+      std::string name = argv[++argi];
+      for (auto &t : g_tests)
+        if (name == t.name)
+          test = &t;
+      if (!test)
+        return _Usage(argv[0]);
+    } else
+      return _Usage(argv[0]);
+  }
 
-  FILE *f = fopen(argv[1], "rb");
-  fseek(f, 0, SEEK_END);
-  size_t flen = ftell(f);
-  fseek(f, 0, SEEK_SET);
-
-  if (flen > dev.GetRam().GetLen())
-    return 1;
-
-  if (fread(dev.GetRam().GetBuf(), 1, flen, f) != flen) {
-    fclose(f);
+  if (argi + (micro.empty() && !test ? 1 : 0) != argc)
+    return _Usage(argv[0]);
+
+  if (micro == "it")
+    _LoadBenchmark(dev, g_benchIT, sizeof(g_benchIT));
+  else if (micro == "alu")
+    _LoadBenchmark(dev, g_benchALU, sizeof(g_benchALU));
+  else if (micro == "mixed")
+    _LoadBenchmark(dev, g_benchMixed, sizeof(g_benchMixed));
+  else if (micro == "exc")
+    _LoadBenchmark(dev, g_benchExc, sizeof(g_benchExc), 0x20, 0x24);
+  else if (micro == "fault")
+    _LoadBenchmark(dev, g_benchFault, sizeof(g_benchFault), 0, 0, 0x2E);
+  else if (test) {
+    if (test->prog)
+      _LoadBenchmark(dev, test->prog, test->len);
+  }
+  else if (int rc = dev.GetRam().MapFile(argv[argi]); rc < 0) {
+    // The program is mapped rather than read, so that its pages are shared
+    // between instances until written.
+    fprintf(stderr, "%s: %s\n", argv[argi], strerror(-rc));
     return 1;
   }
 
-  fclose(f);
-
   cfg.initialVtor = 0x2000'0000;
 
   g_el = el_init(argv[0], stdin, stdout, stderr);
@@ -306,16 +640,25 @@ int main(int argc, char **argv) {
   sigaction(SIGINT, &sa, NULL);
 
   memu::GlobalMonitor gm;
+  if (test && test->check) {
+    bool pass = test->check(dev, gm, cfg);
+    printf("=> %s: %s\n", test->name, pass ? "pass" : "FAIL");
+    return pass ? 0 : 1;
+  }
+
   memu::Simulator sim(dev, gm, cfg);
   memu::IntrBox   intrBox{sim};
+
   uint32_t  i = 0;
+  uint64_t  numInstrs = 0;
+  auto      startTime = std::chrono::steady_clock::now();
   for (;;) {
     if unlikely (g_sigint) {
       g_sigint = false;
       if (_DebugPrompt(sim) > 0)
         break;
     }
-    sim.TopLevel();
+    numInstrs += sim.TopLevel();
 
     auto exitCause = sim.GetExitCause();
     if (exitCause & memu::EXIT_CAUSE__WFI) {
@@ -330,5 +673,17 @@ int main(int argc, char **argv) {
       break;
   }
 
+  if (bench) {
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    printf("=> %llu instructions in %.3fs (%.0f instructions/s)\n",
+      (unsigned long long)numInstrs, secs, numInstrs/secs);
+  }
+
+  if (test) {
+    bool pass = (sim.GetCpuState().r7 == 1);
+    printf("=> %s: %s\n", test->name, pass ? "pass" : "FAIL");
+    return pass ? 0 : 1;
+  }
+
   return 0;
 }